@@ -0,0 +1,219 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Compact binary form of the built-in activation kinds, used to pass redirected activations
+// to another instance without escaping them into an encoded launch Uri or marshaling them
+// through COM (see ValueMarshaling.h).
+//
+// Layout (native byte order, as both ends are on the same machine):
+//
+//   uint32 magic, uint16 version, uint16 kind
+//   Launch, Protocol, StartupTask:  string value (arguments, uri or task id)
+//   File:                           string verb, uint32 count, count x string file
+//
+// where a string is a uint32 count of UTF-16 code units followed by the units, unterminated.
+// The record must account for every byte; anything else, including a version or kind this
+// code doesn't know, is rejected and the sender is expected to use one of the older forms.
+namespace AppLifecycleCore
+{
+    enum class ActivationRecordKind : uint16_t
+    {
+        Launch = 1,
+        File = 2,
+        Protocol = 3,
+        StartupTask = 4,
+    };
+
+    struct ActivationRecord
+    {
+        ActivationRecordKind kind{ ActivationRecordKind::Launch };
+        std::u16string value;
+        std::u16string verb;
+        std::vector<std::u16string> files;
+
+        bool operator==(const ActivationRecord& other) const
+        {
+            return (kind == other.kind) && (value == other.value) && (verb == other.verb) && (files == other.files);
+        }
+    };
+
+    // Changes to the layout must change the version
+    constexpr uint32_t c_activationRecordMagic{ 0x57414C41 };  // 'ALAW'
+    constexpr uint16_t c_activationRecordVersion{ 1 };
+
+    namespace details
+    {
+        inline void AppendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size)
+        {
+            if (size > 0)
+            {
+                const auto offset{ buffer.size() };
+                buffer.resize(offset + size);
+                std::memcpy(buffer.data() + offset, data, size);
+            }
+        }
+
+        template <typename T>
+        void AppendValue(std::vector<uint8_t>& buffer, T value)
+        {
+            AppendBytes(buffer, &value, sizeof(value));
+        }
+
+        inline void AppendString(std::vector<uint8_t>& buffer, const std::u16string& value)
+        {
+            AppendValue(buffer, static_cast<uint32_t>(value.size()));
+            AppendBytes(buffer, value.data(), value.size() * sizeof(char16_t));
+        }
+
+        inline size_t StringSize(const std::u16string& value)
+        {
+            return sizeof(uint32_t) + value.size() * sizeof(char16_t);
+        }
+
+        // Reads from an untrusted buffer; every read is checked against what's left
+        class ActivationRecordReader
+        {
+        public:
+            ActivationRecordReader(const uint8_t* data, size_t size) : m_next(data), m_remaining(size)
+            {
+            }
+
+            template <typename T>
+            bool Read(T& value)
+            {
+                if (m_remaining < sizeof(value))
+                {
+                    return false;
+                }
+                std::memcpy(&value, m_next, sizeof(value));
+                Skip(sizeof(value));
+                return true;
+            }
+
+            bool ReadString(std::u16string& value)
+            {
+                uint32_t length{};
+                if (!Read(length) || (length > m_remaining / sizeof(char16_t)))
+                {
+                    return false;
+                }
+                value.resize(length);
+                if (length > 0)
+                {
+                    std::memcpy(&value[0], m_next, length * sizeof(char16_t));
+                }
+                Skip(length * sizeof(char16_t));
+                return true;
+            }
+
+            size_t Remaining() const
+            {
+                return m_remaining;
+            }
+
+        private:
+            void Skip(size_t size)
+            {
+                m_next += size;
+                m_remaining -= size;
+            }
+
+            const uint8_t* m_next{};
+            size_t m_remaining{};
+        };
+    }
+
+    inline bool IsValidActivationRecordKind(ActivationRecordKind kind)
+    {
+        return (kind >= ActivationRecordKind::Launch) && (kind <= ActivationRecordKind::StartupTask);
+    }
+
+    // Append the record's encoding to buffer
+    inline void AppendActivationRecord(const ActivationRecord& record, std::vector<uint8_t>& buffer)
+    {
+        size_t size{ sizeof(uint32_t) + 2 * sizeof(uint16_t) };
+        if (record.kind == ActivationRecordKind::File)
+        {
+            size += details::StringSize(record.verb) + sizeof(uint32_t);
+            for (const auto& file : record.files)
+            {
+                size += details::StringSize(file);
+            }
+        }
+        else
+        {
+            size += details::StringSize(record.value);
+        }
+        buffer.reserve(buffer.size() + size);
+
+        details::AppendValue(buffer, c_activationRecordMagic);
+        details::AppendValue(buffer, c_activationRecordVersion);
+        details::AppendValue(buffer, static_cast<uint16_t>(record.kind));
+        if (record.kind == ActivationRecordKind::File)
+        {
+            details::AppendString(buffer, record.verb);
+            details::AppendValue(buffer, static_cast<uint32_t>(record.files.size()));
+            for (const auto& file : record.files)
+            {
+                details::AppendString(buffer, file);
+            }
+        }
+        else
+        {
+            details::AppendString(buffer, record.value);
+        }
+    }
+
+    // Returns false if data isn't exactly one well-formed record this version understands
+    inline bool TryReadActivationRecord(const uint8_t* data, size_t size, ActivationRecord& record)
+    {
+        details::ActivationRecordReader reader{ data, size };
+        uint32_t magic{};
+        uint16_t version{};
+        uint16_t kind{};
+        if (!reader.Read(magic) || (magic != c_activationRecordMagic) ||
+            !reader.Read(version) || (version != c_activationRecordVersion) ||
+            !reader.Read(kind) || !IsValidActivationRecordKind(static_cast<ActivationRecordKind>(kind)))
+        {
+            return false;
+        }
+
+        ActivationRecord result;
+        result.kind = static_cast<ActivationRecordKind>(kind);
+        if (result.kind == ActivationRecordKind::File)
+        {
+            // Every file takes at least its length, which bounds the count before allocating
+            uint32_t count{};
+            if (!reader.ReadString(result.verb) || !reader.Read(count) || (count > reader.Remaining() / sizeof(uint32_t)))
+            {
+                return false;
+            }
+            result.files.resize(count);
+            for (auto& file : result.files)
+            {
+                if (!reader.ReadString(file))
+                {
+                    return false;
+                }
+            }
+        }
+        else if (!reader.ReadString(result.value))
+        {
+            return false;
+        }
+
+        if (reader.Remaining() != 0)
+        {
+            return false;
+        }
+        record = std::move(result);
+        return true;
+    }
+}
@@ -102,7 +102,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         m_moduleName = ComputeAppId();
         m_processName = wil::str_printf<std::wstring>(L"%s_%d", m_moduleName.c_str(), processId);
 
-        m_instances.Init(m_moduleName + L"_Module");
+        m_instances.Init(m_moduleName + L"_Instances");
 
         // Wire up the Activated event.
         std::wstring eventName = m_processName + c_activatedEventNameSuffix;
@@ -140,7 +140,10 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
         if (m_isCurrent)
         {
-            m_instances.Insert(processId);
+            m_instances.Insert();
+
+            // Only the current instance looks up (or registers) keys.
+            m_keys.Init(m_moduleName + L"_KeyDirectory");
         }
         else
         {
@@ -157,25 +160,18 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
                 reinterpret_cast<void*>(static_cast<size_t>(m_processId)), INFINITE, WT_EXECUTEONLYONCE));
         }
 
-        m_redirectionArgs.Init(m_processName + L"_RedirectionQueue");
+        m_redirectionArgs.Init(m_processName + L"_RedirectionChannel");
     }
 
     void AppInstance::RemoveInstance(uint32_t processId)
     {
-        auto releaseOnExit = m_dataMutex.acquire();
-        m_instances.Remove(processId);
-    }
-
-    GUID AppInstance::DequeueRedirectionRequestId()
-    {
-        auto releaseOnExit = m_dataMutex.acquire();
-        auto id = m_redirectionArgs.Dequeue();
-        return id;
+        // The list is lock-free so there's no need for m_dataMutex.
+        m_instances.RemoveIfExited(processId);
     }
 
     void AppInstance::EnqueueRedirectionRequestId(GUID id)
     {
-        auto releaseOnExit = m_dataMutex.acquire();
+        // The queue is lock-free so there's no need for m_dataMutex.
         m_redirectionArgs.Enqueue(id);
     }
 
@@ -183,32 +179,65 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
     {
         m_innerActivated.ResetEvent();
 
-        GUID id;
-        while ((id = DequeueRedirectionRequestId()) != GUID_NULL)
+        // Take as many requests as are waiting each time around, not just the one we were woken for.
+        std::vector<RedirectionRequestQueue::Request> requests;
+        while (m_redirectionArgs.Receive(requests))
         {
-            wil::unique_cotaskmem_string idString;
-            THROW_IF_FAILED(StringFromCLSID(id, &idString));
-
-            auto name = wil::str_printf<std::wstring>(c_requestPacketNameFormat, m_processName.c_str(), idString.get());
+            // Free every request's slot (and let its sender go) whether or not it's handled. If one
+            // throws, the rest of the batch must not be left behind in the receiving state.
+            size_t completed{};
+            auto completeOnExit = wil::scope_exit([&]
+            {
+                for (; completed < requests.size(); ++completed)
+                {
+                    m_redirectionArgs.Complete(requests[completed]);
+                }
+            });
 
-            RedirectionRequest request;
-            request.Open(name);
-            auto args = request.UnmarshalArguments();
+            for (const auto& request : requests)
+            {
+                if (request.HasId())
+                {
+                    ProcessRedirectionRequest(RedirectionRequestQueue::GetId(request));
+                }
+                else
+                {
+                    auto args = RedirectionRequest::Unmarshal(request.payload, request.size);
 
-            // Notify the app that the redirection request is here.
-            m_activatedEvent(*this, args);
+                    // Notify the app that the redirection request is here.
+                    m_activatedEvent(*this, args);
+                }
 
-            std::wstring eventName = name + c_activatedEventNameSuffix;
-            wil::unique_event cleanupEvent;
-            cleanupEvent.open(eventName.c_str());
-            if (cleanupEvent)
-            {
-                // If the event is missing, it means the waiter gave up.  Ignore the error.
-                cleanupEvent.SetEvent();
+                m_redirectionArgs.Complete(request);
+                ++completed;
             }
         }
     }
 
+    void AppInstance::ProcessRedirectionRequest(GUID id)
+    {
+        wil::unique_cotaskmem_string idString;
+        THROW_IF_FAILED(StringFromCLSID(id, &idString));
+
+        auto name = wil::str_printf<std::wstring>(c_requestPacketNameFormat, m_processName.c_str(), idString.get());
+
+        RedirectionRequest request;
+        request.Open(name);
+        auto args = request.UnmarshalArguments();
+
+        // Notify the app that the redirection request is here.
+        m_activatedEvent(*this, args);
+
+        std::wstring eventName = name + c_activatedEventNameSuffix;
+        wil::unique_event cleanupEvent;
+        cleanupEvent.open(eventName.c_str());
+        if (cleanupEvent)
+        {
+            // If the event is missing, it means the waiter gave up.  Ignore the error.
+            cleanupEvent.SetEvent();
+        }
+    }
+
     IAsyncAction AppInstance::QueueRequest(AppLifecycle::AppActivationArguments args)
     {
         // Report feature usage.
@@ -226,6 +255,19 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
         auto uninitOnExit = wil::CoInitializeEx();
 
+        // Most requests fit in the instance's channel, which needs no kernel objects of their own.
+        auto payload{ RedirectionRequest::Marshal(args) };
+        if (auto ticket{ m_redirectionArgs.TrySend(payload) })
+        {
+            AllowSetForegroundWindow(m_processId);
+            m_innerActivated.SetEvent();
+
+            // Wait for the other instance to handle the request (or exit) before cleaning up our interest in it.
+            m_redirectionArgs.WaitForCompletion(ticket, m_instanceHandle.get());
+            co_return;
+        }
+
+        // Otherwise the request gets a mapping of its own and only its id goes through the channel.
         GUID id;
         THROW_IF_FAILED(CoCreateGuid(&id));
 
@@ -235,7 +277,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
         RedirectionRequest request;
         request.Open(name);
-        request.MarshalArguments(args);
+        request.Write(payload);
 
         std::wstring eventName = name + c_activatedEventNameSuffix;
         wil::unique_event cleanupEvent;
@@ -280,43 +322,22 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
         IVector<Microsoft::Windows::AppLifecycle::AppInstance> instances{ winrt::single_threaded_vector<Microsoft::Windows::AppLifecycle::AppInstance>() };
 
-        // Grab the list of processes while under the lock, and then drop it since we'll be calling out to other code.
-        std::list<DWORD> pids;
+        // Create the associated AppInstance objects while removing orphaned entries we find.  Entries
+        // whose process has exited, or whose id now belongs to a different process, are orphans.
+        for (const auto& entry : s_current->m_instances.Snapshot())
         {
-            auto releaseOnExit = s_current->m_dataMutex.acquire();
-
-            for (uint32_t index = 0; index < s_current->m_instances.Size(); index++)
+            if (GetCurrentProcessId() == entry.processId)
             {
-                auto pid = s_current->m_instances[index];
-                if (pid == 0)
-                {
-                    continue;
-                }
-
-                pids.push_back(pid);
+                instances.Append(AppInstance::GetCurrent());
             }
-        }
-
-        // Create the associated AppInstance objects while removing orphaned entries we find.
-        for (const auto& pid : pids)
-        {
-            if (GetCurrentProcessId() == pid)
+            else if (SharedProcessList::IsProcessAlive(entry.processId, entry.creationTime))
             {
-                instances.Append(AppInstance::GetCurrent());
+                instances.Append(make<AppInstance>(entry.processId));
             }
             else
             {
-                wil::unique_handle process(::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid));
-                if (process != nullptr)
-                {
-                    instances.Append(make<AppInstance>(pid));
-                }
-                else
-                {
-                    // Remove orphan.
-                    auto releaseOnExit = s_current->m_dataMutex.acquire();
-                    s_current->m_instances.Remove(pid);
-                }
+                // Remove orphan.
+                s_current->m_instances.Remove(entry);
             }
         }
 
@@ -450,6 +471,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         auto releaseOnExit = m_dataMutex.acquire();
         if (m_isCurrent)
         {
+            m_keys.Withdraw(Key().c_str());
             m_key.Reset();
             m_keyCreationMutex.reset();
         }
@@ -563,7 +585,8 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
     bool AppInstance::TrySetKey(std::wstring const& key)
     {
-        auto escapedKey = std::regex_replace(key, std::wregex(L"\\\\"), L"_");
+        std::wstring escapedKey{ key };
+        std::replace(escapedKey.begin(), escapedKey.end(), L'\\', L'_');
         std::wstring mutexName = wil::str_printf<std::wstring>(L"%s_%s_Mutex", m_moduleName.c_str(), escapedKey.c_str());
 
         // We keep the mutex as a live member to ensure all other instances continue
@@ -577,14 +600,39 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             // is still protected by m_dataMutex.
             auto releaseOnExit = m_dataMutex.acquire();
 
+            auto previousKey = Key();
+            if (!previousKey.empty())
+            {
+                m_keys.Withdraw(previousKey.c_str());
+            }
+
             m_key.Resize((key.length() + 1) * sizeof(key.data()[0]));
             THROW_IF_FAILED(StringCchCopy(m_key.Get(), (m_key.Size() / sizeof(wchar_t)), key.c_str()));
+
+            // Keys the directory can't hold are still found by FindForKey, just more slowly.
+            m_keys.Publish(key);
         }
         return currentIsKeyOwner;
     }
 
     Microsoft::Windows::AppLifecycle::AppInstance AppInstance::FindForKey(std::wstring const& key)
     {
+        // The directory knows the owner unless it's gone, or the key didn't fit.
+        auto ownerProcessId = m_keys.Find(key);
+        if (ownerProcessId == GetCurrentProcessId())
+        {
+            return GetCurrent();
+        }
+        else if (ownerProcessId != 0)
+        {
+            wil::unique_handle process(::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, ownerProcessId));
+            if (process != nullptr)
+            {
+                return make<AppInstance>(ownerProcessId);
+            }
+        }
+
+        // Otherwise ask every instance.
         auto instances = GetInstances();
         for (const auto& instance : instances)
         {
@@ -8,6 +8,7 @@
 #include "RedirectionRequest.h"
 #include "SharedProcessList.h"
 #include "RedirectionRequestQueue.h"
+#include "KeyDirectory.h"
 
 namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 {
@@ -49,10 +50,10 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         winrt::Windows::Foundation::IAsyncAction QueueRequest(Microsoft::Windows::AppLifecycle::AppActivationArguments args);
         void RemoveInstance(uint32_t processId);
         void ProcessRedirectionRequests();
+        void ProcessRedirectionRequest(GUID id);
         bool TrySetKey(std::wstring const& key);
         Microsoft::Windows::AppLifecycle::AppInstance FindForKey(std::wstring const& key);
         void EnqueueRedirectionRequestId(GUID id);
-        GUID DequeueRedirectionRequestId();
 
         // Named object prefixes used to scope.
         std::wstring m_moduleName;
@@ -78,6 +79,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         wil::unique_handle m_instanceHandle;
 
         SharedProcessList m_instances;
+        KeyDirectory m_keys;
         RedirectionRequestQueue m_redirectionArgs;
     };
 }
@@ -52,4 +52,20 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
         return { ExtendedActivationKind::Protocol, nullptr };
     }
+
+    inline std::tuple<ExtendedActivationKind, winrt::Windows::Foundation::IInspectable> DecodeActivatedEventArgs(AppLifecycleCore::ActivationRecord const& record)
+    {
+        switch (record.kind)
+        {
+        case AppLifecycleCore::ActivationRecordKind::Launch:
+            return { ExtendedActivationKind::Launch, LaunchActivatedEventArgs::Deserialize(record) };
+        case AppLifecycleCore::ActivationRecordKind::File:
+            return { ExtendedActivationKind::File, FileActivatedEventArgs::Deserialize(record) };
+        case AppLifecycleCore::ActivationRecordKind::Protocol:
+            return { ExtendedActivationKind::Protocol, ProtocolActivatedEventArgs::Deserialize(record) };
+        case AppLifecycleCore::ActivationRecordKind::StartupTask:
+            return { ExtendedActivationKind::StartupTask, StartupActivatedEventArgs::Deserialize(record) };
+        }
+        THROW_HR(E_INVALIDARG);
+    }
 }
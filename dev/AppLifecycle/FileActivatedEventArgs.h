@@ -13,7 +13,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
     constexpr inline PCWSTR c_fileContractId = L"Windows.File";
 
     class FileActivatedEventArgs : public winrt::implements<FileActivatedEventArgs, IFileActivatedEventArgs, ActivatedEventArgsBase,
-        IInternalValueMarshalable>
+        IInternalValueMarshalable, IInternalRecordMarshalable>
     {
     public:
         FileActivatedEventArgs(const winrt::hstring verb, const winrt::hstring file, const bool supportCommandTemplates = false)
@@ -53,6 +53,13 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return make<FileActivatedEventArgs>(verb, file);
         }
 
+        static winrt::Windows::Foundation::IInspectable Deserialize(AppLifecycleCore::ActivationRecord const& record)
+        {
+            // The record can carry a list but only one file is supported (see the constructor)
+            THROW_HR_IF(E_INVALIDARG, record.files.size() != 1);
+            return make<FileActivatedEventArgs>(FromRecordString(record.verb), FromRecordString(record.files.front()));
+        }
+
         // IInternalValueMarshalable
         winrt::Windows::Foundation::Uri Serialize()
         {
@@ -76,6 +83,15 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return winrt::Windows::Foundation::Uri(uri);
         }
 
+        // IInternalRecordMarshalable
+        AppLifecycleCore::ActivationRecord SerializeRecord()
+        {
+            AppLifecycleCore::ActivationRecord record{ AppLifecycleCore::ActivationRecordKind::File };
+            record.verb = ToRecordString(m_verb);
+            record.files.push_back(ToRecordString(m_path));
+            return record;
+        }
+
         // IFileActivatedEventArgs
         IVectorView<IStorageItem> Files()
         {
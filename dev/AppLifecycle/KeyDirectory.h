@@ -0,0 +1,70 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+#include "SharedMemory.h"
+#include "ProcessLiveness.h"
+#include "SharedKeyDirectory.h"
+
+namespace winrt::Microsoft::Windows::AppLifecycle::implementation
+{
+    // Which instance of the app owns which key, in a directory (see SharedKeyDirectory.h) shared
+    // by all of them. Key ownership itself is still decided by the per-key mutex; the directory
+    // is how other instances find the owner without asking every instance for its key.
+    class KeyDirectory
+    {
+        using Directory = AppLifecycleCore::SharedKeyDirectory;
+
+    public:
+        void Init(const std::wstring& name)
+        {
+            m_data.Open(name, Directory::RegionSize() + sizeof(DynamicSharedMemory<uint64_t>));
+            THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), (m_data.MappedSize() < Directory::RegionSize()) || !m_directory.Attach(m_data.Get(), Directory::RegionSize()));
+            m_directory.SetIsOwnerAlive(&IsOwnerAlive);
+
+            FILETIME creation{}, exit{}, kernel{}, user{};
+            THROW_IF_WIN32_BOOL_FALSE(GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user));
+            m_currentOwner = Directory::MakeOwner(GetCurrentProcessId(), ToUInt64(creation));
+        }
+
+        // Record the current process as the key's owner. Returns false if the directory can't hold it.
+        bool Publish(std::wstring const& key)
+        {
+            return m_directory.Publish(ToKey(key), m_currentOwner);
+        }
+
+        void Withdraw(std::wstring const& key)
+        {
+            m_directory.Withdraw(ToKey(key), m_currentOwner);
+        }
+
+        // The process id of the key's owner, or 0 if the directory doesn't know of a running one.
+        uint32_t Find(std::wstring const& key)
+        {
+            return Directory::GetProcessId(m_directory.Find(ToKey(key)));
+        }
+
+    private:
+        static std::u16string_view ToKey(std::wstring const& key)
+        {
+            static_assert(sizeof(wchar_t) == sizeof(char16_t), "Keys are UTF-16");
+            return { reinterpret_cast<const char16_t*>(key.c_str()), key.size() };
+        }
+
+        static uint64_t ToUInt64(FILETIME const& time)
+        {
+            return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        }
+
+        static bool IsOwnerAlive(uint32_t processId, uint32_t startTag)
+        {
+            // A different process that's since been given the same id doesn't count
+            uint64_t creationTime{};
+            return AppLifecycleCore::IsProcessAlive(processId, &creationTime) &&
+                ((creationTime == 0) || (Directory::GetStartTag(Directory::MakeOwner(processId, creationTime)) == startTag));
+        }
+
+        SharedMemory<uint64_t> m_data;
+        Directory m_directory;
+        uint64_t m_currentOwner{};
+    };
+}
@@ -12,7 +12,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
     constexpr PCWSTR c_launchContractId = L"Windows.Launch";
 
     class LaunchActivatedEventArgs : public winrt::implements<LaunchActivatedEventArgs, ILaunchActivatedEventArgs,
-        ActivatedEventArgsBase, IInternalValueMarshalable>
+        ActivatedEventArgsBase, IInternalValueMarshalable, IInternalRecordMarshalable>
     {
     public:
         LaunchActivatedEventArgs(const winrt::hstring args) : m_args(args)
@@ -27,6 +27,11 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return make<LaunchActivatedEventArgs>(args);
         }
 
+        static winrt::Windows::Foundation::IInspectable Deserialize(AppLifecycleCore::ActivationRecord const& record)
+        {
+            return make<LaunchActivatedEventArgs>(FromRecordString(record.value));
+        }
+
         // IInternalValueMarshalable
         winrt::Windows::Foundation::Uri Serialize()
         {
@@ -34,6 +39,12 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return winrt::Windows::Foundation::Uri(uri);
         }
 
+        // IInternalRecordMarshalable
+        AppLifecycleCore::ActivationRecord SerializeRecord()
+        {
+            return { AppLifecycleCore::ActivationRecordKind::Launch, ToRecordString(m_args) };
+        }
+
         // ILaunchActivatedEventArgs
         winrt::hstring Arguments()
         {
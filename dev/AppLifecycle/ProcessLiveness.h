@@ -0,0 +1,39 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+namespace AppLifecycleCore
+{
+    // True if the process is running. If creationTime is given it gets when the process was
+    // created (or 0 if that can't be read), so callers can tell it apart from a process that's
+    // since been given the same id. Used wherever shared memory records a process that may
+    // have died without cleaning up after itself.
+    inline bool IsProcessAlive(uint32_t processId, uint64_t* creationTime = nullptr)
+    {
+        if (creationTime)
+        {
+            *creationTime = 0;
+        }
+
+        const DWORD access{ SYNCHRONIZE | (creationTime ? PROCESS_QUERY_LIMITED_INFORMATION : 0ul) };
+        HANDLE process{ OpenProcess(access, FALSE, processId) };
+        if (!process)
+        {
+            // Access denied means it's there, we just can't touch it
+            return GetLastError() != ERROR_INVALID_PARAMETER;
+        }
+
+        FILETIME creation{}, exit{}, kernel{}, user{};
+        if (creationTime && GetProcessTimes(process, &creation, &exit, &kernel, &user))
+        {
+            *creationTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+        }
+
+        const bool alive{ WaitForSingleObject(process, 0) == WAIT_TIMEOUT };
+        CloseHandle(process);
+        return alive;
+    }
+}
@@ -13,7 +13,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
     constexpr PCWSTR c_protocolContractId = L"Windows.Protocol";
 
     class ProtocolActivatedEventArgs : public winrt::implements<ProtocolActivatedEventArgs, IProtocolActivatedEventArgs, ActivatedEventArgsBase,
-        IInternalValueMarshalable>
+        IInternalValueMarshalable, IInternalRecordMarshalable>
     {
     public:
         ProtocolActivatedEventArgs(const winrt::hstring uri) : m_uri(winrt::Windows::Foundation::Uri(uri))
@@ -28,6 +28,11 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return make<ProtocolActivatedEventArgs>(args);
         }
 
+        static winrt::Windows::Foundation::IInspectable Deserialize(AppLifecycleCore::ActivationRecord const& record)
+        {
+            return make<ProtocolActivatedEventArgs>(FromRecordString(record.value));
+        }
+
         // IInternalValueMarshalable
         winrt::Windows::Foundation::Uri Serialize()
         {
@@ -35,6 +40,12 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return winrt::Windows::Foundation::Uri(uri);
         }
 
+        // IInternalRecordMarshalable
+        AppLifecycleCore::ActivationRecord SerializeRecord()
+        {
+            return { AppLifecycleCore::ActivationRecordKind::Protocol, ToRecordString(m_uri.AbsoluteUri()) };
+        }
+
         // IProtocolActivatedEventArgs
         winrt::Windows::Foundation::Uri Uri()
         {
@@ -0,0 +1,379 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "SharedRegionHeader.h"
+#include "SharedRingBuffer.h"
+
+// Long-lived channel carrying redirection requests to one instance, laid out in a region of
+// shared memory that's created once per instance and reused for every request.
+//
+// Payloads are written straight into preallocated slots: small ones into one of the inline
+// slots, larger ones into one of the fewer, bigger overflow slots. What's queued (in a
+// SharedRingBuffer) is just which slot to read. Requests that don't fit (or find no free
+// slot) can be queued by id instead, for the sender to pass some other way.
+//
+// Each slot's state word carries a generation. The receiver completes a request by freeing
+// its slot for the next generation, which is how the sender knows it's done; there are no
+// per-request objects to create, open or signal.
+namespace AppLifecycleCore
+{
+    namespace details
+    {
+        // Payload slot state: generation in the high 32 bits, tag in the low 32 bits. Any other
+        // tag is the process id of the writer (as in SharedRingBuffer).
+        constexpr uint32_t c_payloadFree{ 0 };
+        constexpr uint32_t c_payloadQueued{ 1 };
+        constexpr uint32_t c_payloadReceiving{ 2 };
+
+        struct RedirectionChannelHeader
+        {
+            std::atomic<uint64_t> tag;          // magic in the high 32 bits, layout version in the low 32 bits
+            std::atomic<uint64_t> completions;  // requests completed, ever
+            std::atomic<uint32_t> freeHint[2];  // per pool, where to start looking for a free slot
+            uint64_t reserved[5];
+        };
+        static_assert(sizeof(RedirectionChannelHeader) == 64, "Shared layout");
+
+        struct PayloadSlot
+        {
+            std::atomic<uint64_t> state;
+            std::atomic<uint32_t> owner;        // process id of the sender, once queued
+            uint32_t size;
+        };
+        static_assert(sizeof(PayloadSlot) == 16, "Shared layout");
+
+        // What's queued: a payload slot, or an id
+        struct RedirectionDescriptor
+        {
+            uint32_t pool;
+            uint32_t slot;
+            uint32_t generation;
+            uint32_t size;
+            uint8_t id[16];
+        };
+    }
+
+    class RedirectionChannel
+    {
+        using Queue = SharedRingBuffer<details::RedirectionDescriptor>;
+
+    public:
+        // Changes to the layout (or the constants) must change the magic or version
+        static constexpr uint32_t c_magic{ 0x43524C41 };    // 'ALRC'
+        static constexpr uint32_t c_version{ 1 };
+
+        static constexpr uint32_t c_queueCapacity{ 1024 };
+        static constexpr uint32_t c_inlinePool{ 0 };
+        static constexpr uint32_t c_inlineSlotCount{ 64 };
+        static constexpr uint32_t c_inlineSlotSize{ 2 * 1024 };
+        static constexpr uint32_t c_overflowPool{ 1 };
+        static constexpr uint32_t c_overflowSlotCount{ 8 };
+        static constexpr uint32_t c_overflowSlotSize{ 64 * 1024 };
+        static constexpr uint32_t c_idPool{ UINT32_MAX };
+
+        using IsProcessAliveFunction = Queue::IsProcessAliveFunction;
+
+        // Identifies a sent request to wait for its completion
+        struct Ticket
+        {
+            uint32_t pool{ c_idPool };
+            uint32_t slot{};
+            uint32_t generation{};
+
+            explicit operator bool() const
+            {
+                return pool != c_idPool;
+            }
+        };
+
+        // A received request. The payload is valid until the request's completed.
+        struct Request
+        {
+            Ticket ticket;
+            const uint8_t* payload{};
+            uint32_t size{};
+            uint8_t id[16]{};
+
+            bool HasId() const
+            {
+                return !ticket;
+            }
+        };
+
+        static constexpr size_t RegionSize()
+        {
+            return sizeof(details::RedirectionChannelHeader) +
+                   Queue::RegionSize(c_queueCapacity) +
+                   (static_cast<size_t>(c_inlineSlotCount) + c_overflowSlotCount) * sizeof(details::PayloadSlot) +
+                   static_cast<size_t>(c_inlineSlotCount) * c_inlineSlotSize +
+                   static_cast<size_t>(c_overflowSlotCount) * c_overflowSlotSize;
+        }
+
+        // Payloads larger than this must be sent by id
+        static constexpr size_t MaxPayloadSize()
+        {
+            return c_overflowSlotSize;
+        }
+
+        RedirectionChannel() = default;
+
+        RedirectionChannel(const RedirectionChannel&) = delete;
+        RedirectionChannel& operator=(const RedirectionChannel&) = delete;
+
+        // Returns false if the region's too small or was set up by someone with a different layout
+        bool Attach(void* region, size_t size)
+        {
+            if (!CanHoldLayout(region, size, RegionSize()))
+            {
+                return false;
+            }
+
+            auto header{ static_cast<details::RedirectionChannelHeader*>(region) };
+            if (!StampRegion(header->tag, c_magic, c_version))
+            {
+                return false;
+            }
+
+            auto next{ static_cast<uint8_t*>(region) + sizeof(details::RedirectionChannelHeader) };
+            if (!m_queue.Attach(next, Queue::RegionSize(c_queueCapacity)) || (m_queue.Capacity() != c_queueCapacity))
+            {
+                return false;
+            }
+            next += Queue::RegionSize(c_queueCapacity);
+
+            m_header = header;
+            m_pools[c_inlinePool].slots = reinterpret_cast<details::PayloadSlot*>(next);
+            m_pools[c_overflowPool].slots = m_pools[c_inlinePool].slots + c_inlineSlotCount;
+            next += (static_cast<size_t>(c_inlineSlotCount) + c_overflowSlotCount) * sizeof(details::PayloadSlot);
+            m_pools[c_inlinePool].payloads = next;
+            m_pools[c_overflowPool].payloads = next + static_cast<size_t>(c_inlineSlotCount) * c_inlineSlotSize;
+            return true;
+        }
+
+        void SetIsProcessAlive(IsProcessAliveFunction isProcessAlive)
+        {
+            m_isProcessAlive = isProcessAlive;
+            m_queue.SetIsProcessAlive(std::move(isProcessAlive));
+        }
+
+        // Sender. Copy the payload into a free slot and queue it. Returns an empty ticket if
+        // it's too big, there's no free slot or the queue's full; send it by id instead.
+        Ticket TrySend(const uint8_t* payload, size_t size, uint32_t processId)
+        {
+            if (size > MaxPayloadSize())
+            {
+                return {};
+            }
+
+            // Small payloads go to the overflow pool if the inline slots are all taken
+            uint32_t pool{ (size <= c_inlineSlotSize) ? c_inlinePool : c_overflowPool };
+            uint32_t slotIndex{};
+            uint32_t generation{};
+            if (!TryClaim(pool, processId, slotIndex, generation))
+            {
+                if ((pool == c_overflowPool) || !TryClaim(c_overflowPool, processId, slotIndex, generation))
+                {
+                    return {};
+                }
+                pool = c_overflowPool;
+            }
+            auto& slot{ m_pools[pool].slots[slotIndex] };
+            if (size > 0)
+            {
+                std::memcpy(Payload(pool, slotIndex), payload, size);
+            }
+            slot.size = static_cast<uint32_t>(size);
+            slot.owner.store(processId, std::memory_order_relaxed);
+            slot.state.store(MakeState(generation, details::c_payloadQueued), std::memory_order_release);
+
+            details::RedirectionDescriptor descriptor{ pool, slotIndex, generation, static_cast<uint32_t>(size), {} };
+            if (!m_queue.TryEnqueue(descriptor, processId))
+            {
+                // Never seen by the receiver so it's still ours to give back
+                uint64_t expected{ MakeState(generation, details::c_payloadQueued) };
+                slot.state.compare_exchange_strong(expected, MakeState(generation, details::c_payloadFree), std::memory_order_release);
+                return {};
+            }
+            return Ticket{ pool, slotIndex, generation };
+        }
+
+        // Sender. Queue an id (of a request passed some other way). Returns false if the queue's full.
+        bool TrySendId(const uint8_t (&id)[16], uint32_t processId)
+        {
+            details::RedirectionDescriptor descriptor{ c_idPool, 0, 0, 0, {} };
+            std::memcpy(descriptor.id, id, sizeof(id));
+            return m_queue.TryEnqueue(descriptor, processId);
+        }
+
+        // Sender. True once the receiver's completed (or given up on) the request.
+        bool IsCompleted(const Ticket& ticket) const
+        {
+            const auto state{ m_pools[ticket.pool].slots[ticket.slot].state.load(std::memory_order_acquire) };
+            return GetGeneration(state) != ticket.generation;
+        }
+
+        // Receiver. Take up to maxCount queued requests, appending them to requests. Each must
+        // be completed once it's been handled. Returns how many were taken.
+        size_t Receive(std::vector<Request>& requests, size_t maxCount)
+        {
+            size_t count{};
+            details::RedirectionDescriptor descriptor{};
+            while ((count < maxCount) && m_queue.TryDequeue(descriptor))
+            {
+                Request request;
+                if (descriptor.pool == c_idPool)
+                {
+                    std::memcpy(request.id, descriptor.id, sizeof(request.id));
+                }
+                else
+                {
+                    if ((descriptor.pool > c_overflowPool) || (descriptor.slot >= m_pools[descriptor.pool].SlotCount()) ||
+                        (descriptor.size > m_pools[descriptor.pool].SlotSize()))
+                    {
+                        continue;
+                    }
+
+                    // Skip it if it was reclaimed from a sender that died
+                    auto& slot{ m_pools[descriptor.pool].slots[descriptor.slot] };
+                    uint64_t expected{ MakeState(descriptor.generation, details::c_payloadQueued) };
+                    if (!slot.state.compare_exchange_strong(expected, MakeState(descriptor.generation, details::c_payloadReceiving), std::memory_order_acq_rel))
+                    {
+                        continue;
+                    }
+                    request.ticket = Ticket{ descriptor.pool, descriptor.slot, descriptor.generation };
+                    request.payload = Payload(descriptor.pool, descriptor.slot);
+                    request.size = descriptor.size;
+                }
+                requests.push_back(request);
+                ++count;
+            }
+            return count;
+        }
+
+        // Receiver. Done with the request; free its slot and let the sender know.
+        void Complete(const Request& request)
+        {
+            if (request.ticket)
+            {
+                auto& slot{ m_pools[request.ticket.pool].slots[request.ticket.slot] };
+                slot.state.store(MakeState(request.ticket.generation + 1, details::c_payloadFree), std::memory_order_release);
+            }
+            m_header->completions.fetch_add(1, std::memory_order_release);
+        }
+
+        // Requests completed, ever. Changes whenever a request's completed.
+        uint64_t CompletionCount() const
+        {
+            return m_header->completions.load(std::memory_order_acquire);
+        }
+
+        uint64_t AbandonedCount() const
+        {
+            return m_queue.AbandonedCount();
+        }
+
+    private:
+        struct Pool
+        {
+            details::PayloadSlot* slots{};
+            uint8_t* payloads{};
+            uint32_t index{};
+
+            uint32_t SlotCount() const
+            {
+                return (index == c_inlinePool) ? c_inlineSlotCount : c_overflowSlotCount;
+            }
+
+            uint32_t SlotSize() const
+            {
+                return (index == c_inlinePool) ? c_inlineSlotSize : c_overflowSlotSize;
+            }
+        };
+
+        static constexpr uint64_t MakeState(uint32_t generation, uint32_t tag)
+        {
+            return (static_cast<uint64_t>(generation) << 32) | tag;
+        }
+
+        static constexpr uint32_t GetGeneration(uint64_t state)
+        {
+            return static_cast<uint32_t>(state >> 32);
+        }
+
+        static constexpr uint32_t GetTag(uint64_t state)
+        {
+            return static_cast<uint32_t>(state);
+        }
+
+        uint8_t* Payload(uint32_t pool, uint32_t slot) const
+        {
+            return m_pools[pool].payloads + static_cast<size_t>(slot) * m_pools[pool].SlotSize();
+        }
+
+        // Claim a free slot, starting at the pool's hint. Slots held by senders that died are
+        // reclaimed on the way.
+        bool TryClaim(uint32_t pool, uint32_t processId, uint32_t& slotIndex, uint32_t& generation)
+        {
+            auto& hint{ m_header->freeHint[pool] };
+            const uint32_t slotCount{ m_pools[pool].SlotCount() };
+            const uint32_t start{ hint.load(std::memory_order_relaxed) % slotCount };
+            for (uint32_t offset=0; offset < slotCount; ++offset)
+            {
+                const uint32_t index{ (start + offset) % slotCount };
+                auto& slot{ m_pools[pool].slots[index] };
+                auto state{ slot.state.load(std::memory_order_acquire) };
+                if (GetTag(state) != details::c_payloadFree)
+                {
+                    if (!TryReclaim(slot, state))
+                    {
+                        continue;
+                    }
+                }
+                if (slot.state.compare_exchange_strong(state, MakeState(GetGeneration(state), processId), std::memory_order_acq_rel))
+                {
+                    hint.store((index + 1) % slotCount, std::memory_order_relaxed);
+                    slotIndex = index;
+                    generation = GetGeneration(state);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // A slot abandoned mid-write, or queued by a sender that's since died (the receiver skips
+        // it), can be freed. state is updated to the free state on success.
+        bool TryReclaim(details::PayloadSlot& slot, uint64_t& state)
+        {
+            const auto tag{ GetTag(state) };
+            if ((tag == details::c_payloadReceiving) || !m_isProcessAlive)
+            {
+                return false;
+            }
+            const auto owner{ (tag == details::c_payloadQueued) ? slot.owner.load(std::memory_order_relaxed) : tag };
+            if (m_isProcessAlive(owner))
+            {
+                return false;
+            }
+            const auto free{ MakeState(GetGeneration(state) + 1, details::c_payloadFree) };
+            if (!slot.state.compare_exchange_strong(state, free, std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            state = free;
+            return true;
+        }
+
+    private:
+        details::RedirectionChannelHeader* m_header{};
+        Queue m_queue;
+        Pool m_pools[2]{ { nullptr, nullptr, c_inlinePool }, { nullptr, nullptr, c_overflowPool } };
+        IsProcessAliveFunction m_isProcessAlive;
+    };
+}
@@ -8,6 +8,15 @@
 
 namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 {
+    // The first byte of a payload says how the rest is marshaled.  The first two values are
+    // what was once written as a bool, so are unchanged.
+    enum class PayloadFormat : uint8_t
+    {
+        ComStream = 0,
+        EncodedLaunchUri = 1,
+        ActivationRecord = 2,
+    };
+
     void RedirectionRequest::Open(const std::wstring& name)
     {
         m_data.Open(name);
@@ -16,6 +25,30 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 
     void RedirectionRequest::MarshalArguments(Microsoft::Windows::AppLifecycle::AppActivationArguments const& args)
     {
+        Write(Marshal(args));
+    }
+
+    void RedirectionRequest::Write(const std::vector<uint8_t>& payload)
+    {
+        m_data.Resize(payload.size());
+        memcpy(m_data.Get(), payload.data(), payload.size());
+    }
+
+    Microsoft::Windows::AppLifecycle::AppActivationArguments RedirectionRequest::UnmarshalArguments()
+    {
+        return Unmarshal(m_data.Get(), m_data.Size());
+    }
+
+    std::vector<uint8_t> RedirectionRequest::Marshal(Microsoft::Windows::AppLifecycle::AppActivationArguments const& args)
+    {
+        // The built-in kinds need neither Uri escaping nor COM.
+        if (auto recordArgs = args.Data().try_as<IInternalRecordMarshalable>())
+        {
+            std::vector<uint8_t> payload{ static_cast<uint8_t>(PayloadFormat::ActivationRecord) };
+            AppLifecycleCore::AppendActivationRecord(recordArgs->SerializeRecord(), payload);
+            return payload;
+        }
+
         auto internalArgs = args.Data().try_as<IInternalValueMarshalable>();
         bool supportInternalValueMarshaling = (internalArgs != nullptr);
         
@@ -36,14 +69,13 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             THROW_IF_FAILED(CoGetMarshalSizeMax(&streamSize, uuidofArgs, unk.get(), MSHCTX_LOCAL, nullptr, MSHLFLAGS_NORMAL));   
         }
 
-        // Add space for the marshaling type data and resize the backing storage.
-        m_data.Resize(sizeof(bool) + streamSize);
+        // Add space for the marshaling type data.
+        std::vector<uint8_t> payload(sizeof(PayloadFormat) + streamSize);
 
         // Mark payload with marshaling type information.
-        bool* marshalingMarker = reinterpret_cast<bool*>(m_data.Get());
-        *marshalingMarker = supportInternalValueMarshaling;
+        payload[0] = static_cast<uint8_t>(supportInternalValueMarshaling ? PayloadFormat::EncodedLaunchUri : PayloadFormat::ComStream);
 
-        uint8_t* streamStart = (m_data.Get() + sizeof(bool));
+        uint8_t* streamStart = (payload.data() + sizeof(PayloadFormat));
 
         if (supportInternalValueMarshaling)
         {
@@ -73,18 +105,31 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             THROW_IF_FAILED(stream->Read(streamStart, static_cast<ULONG>(stats.cbSize.QuadPart), &bytesRead));
             resetStreamOnExit.release();
         }
+        return payload;
     }
 
-    Microsoft::Windows::AppLifecycle::AppActivationArguments RedirectionRequest::UnmarshalArguments()
+    Microsoft::Windows::AppLifecycle::AppActivationArguments RedirectionRequest::Unmarshal(const uint8_t* payload, size_t size)
     {
+        THROW_HR_IF(E_INVALIDARG, size < sizeof(PayloadFormat));
+
         // The first byte holds data about the marshaling type to use.
-        uint8_t* streamStart = (m_data.Get() + sizeof(bool));
-        ULONG streamSize = (static_cast<ULONG>(m_data.Size()) - sizeof(bool));
+        const uint8_t* streamStart = (payload + sizeof(PayloadFormat));
+        ULONG streamSize = (static_cast<ULONG>(size) - sizeof(PayloadFormat));
 
-        bool supportInternalValueMarshaling = *(reinterpret_cast<bool*>(m_data.Get()));
-        if (supportInternalValueMarshaling)
+        const auto format = static_cast<PayloadFormat>(payload[0]);
+        if (format == PayloadFormat::ActivationRecord)
         {
-            std::wstring_view uri_data{ reinterpret_cast<wchar_t*>(streamStart) };
+            AppLifecycleCore::ActivationRecord record;
+            THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), !AppLifecycleCore::TryReadActivationRecord(streamStart, streamSize, record));
+
+            auto [kind, args] = DecodeActivatedEventArgs(record);
+            return make<AppActivationArguments>(args.as<IActivatedEventArgs>());
+        }
+        else if (format == PayloadFormat::EncodedLaunchUri)
+        {
+            // The Uri is null terminated.
+            std::wstring_view uri_data{ reinterpret_cast<const wchar_t*>(streamStart), streamSize / sizeof(wchar_t) };
+            uri_data = uri_data.substr(0, uri_data.find(L'\0'));
 
             ExtendedActivationKind kind;
             winrt::Windows::Foundation::IInspectable args;
@@ -93,6 +138,8 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         }
         else
         {
+            THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), format != PayloadFormat::ComStream);
+
             // Use COM stream marshaling.
             com_ptr<IStream> stream;
             THROW_IF_FAILED(CreateStreamOnHGlobal(nullptr, TRUE, stream.put()));
@@ -18,6 +18,13 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         void MarshalArguments(winrt::Microsoft::Windows::AppLifecycle::AppActivationArguments const& args);
         winrt::Microsoft::Windows::AppLifecycle::AppActivationArguments UnmarshalArguments();
 
+        // Write an already marshaled payload (see Marshal).
+        void Write(const std::vector<uint8_t>& payload);
+
+        // The payload of a request, wherever it's carried.
+        static std::vector<uint8_t> Marshal(winrt::Microsoft::Windows::AppLifecycle::AppActivationArguments const& args);
+        static winrt::Microsoft::Windows::AppLifecycle::AppActivationArguments Unmarshal(const uint8_t* payload, size_t size);
+
     private:
         std::wstring m_name;
         SharedMemory<uint8_t> m_data;
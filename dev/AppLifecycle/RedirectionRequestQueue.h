@@ -2,137 +2,109 @@
 // Licensed under the MIT License. See LICENSE in the project root for license information.
 #pragma once
 #include "SharedMemory.h"
+#include "ProcessLiveness.h"
+#include "RedirectionChannel.h"
 #include "RedirectionRequest.h"
 #include <guiddef.h>
 
 namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 {
+    // Pending redirection requests for an instance, in a channel (see RedirectionChannel.h) shared by
+    // the instance that receives them and any process redirecting to it. It's created once per
+    // instance; requests are written straight into it.
     class RedirectionRequestQueue
     {
-        struct QueueItem
-        {
-            bool inUse{ false };
-            size_t next{ 0 };
-            GUID id{ 0 };
-        };
+        using Channel = AppLifecycleCore::RedirectionChannel;
+
+        // How long a sender waits before looking for its completion again (in case it missed the event)
+        static constexpr DWORD c_completionPollIntervalInMilliseconds{ 100 };
 
     public:
-        void Init(const std::wstring& name)
-        {
-            m_name = name;
+        using Ticket = Channel::Ticket;
+        using Request = Channel::Request;
 
-            // We store the head pointer at the beginning of the memory, and then items in the queue after.
-            m_data.Open(name, (sizeof(QueueItem) * 4096) + sizeof(QueueItem*));
-            m_dataStart = reinterpret_cast<QueueItem*>(m_data.Get() + sizeof(size_t));
-        }
+        // Requests received per call to Receive()
+        static constexpr size_t c_receiveBatchSize{ 16 };
 
-        void Enqueue(const GUID& itemId)
+        void Init(const std::wstring& name)
         {
-            auto newItem = AllocateItem();
-            auto cur = GetHead();
-
-            if (cur != nullptr)
-            {
-                // Zero is never a valid offset, as the offset 0 is our head pointer offset.
-                while (cur->next != 0)
-                {
-                    cur = FromOffset(cur->next);
-                }
-            }
+            m_name = name;
 
-            if (cur == nullptr)
-            {
-                // Enqueueing head.
-                cur = newItem;
-                SetHead(newItem);
-            }
-            else
-            {
-                // Appending to the queue.
-                cur->next = ToOffset(newItem);
-            }
+            m_data.Open(name, Channel::RegionSize() + sizeof(DynamicSharedMemory<uint64_t>));
+            THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), (m_data.MappedSize() < Channel::RegionSize()) || !m_channel.Attach(m_data.Get(), Channel::RegionSize()));
+            m_channel.SetIsProcessAlive([](uint32_t processId) { return AppLifecycleCore::IsProcessAlive(processId); });
 
-            newItem->inUse = true;
-            newItem->id = itemId;
-            newItem->next = 0;
+            // Set whenever a request is completed
+            std::wstring eventName = name + L"_Completed";
+            m_completed.create(wil::EventOptions::ManualReset, eventName.c_str());
         }
 
-        GUID Dequeue()
+        // Queue a request by id, for one whose payload is passed in a mapping of its own
+        void Enqueue(const GUID& itemId)
         {
-            auto head = GetHead();
-            if (head != nullptr)
-            {
-                SetHead(FromOffset(head->next));
-
-                head->inUse = false;
-                head->next = 0;
-
-                return head->id;
-            }
-
-            return GUID_NULL;
+            uint8_t id[16]{};
+            static_assert(sizeof(id) == sizeof(itemId), "GUID");
+            memcpy(id, &itemId, sizeof(id));
+            THROW_HR_IF(E_OUTOFMEMORY, !m_channel.TrySendId(id, GetCurrentProcessId()));
         }
 
-    private:
-        size_t GetBaseAddress()
+        // Queue a request with its payload. Returns an empty ticket if it doesn't fit (right now).
+        Ticket TrySend(const std::vector<uint8_t>& payload)
         {
-            return reinterpret_cast<size_t>(m_data.Get());
+            return m_channel.TrySend(payload.data(), payload.size(), GetCurrentProcessId());
         }
 
-        QueueItem* FromOffset(size_t offset)
+        // Wait for the receiver to complete the request, or for it to exit (process).
+        void WaitForCompletion(const Ticket& ticket, HANDLE process)
         {
-            if (offset == 0)
+            const HANDLE handles[]{ m_completed.get(), process };
+            const DWORD handleCount{ (process != nullptr) ? 2ul : 1ul };
+            while (!m_channel.IsCompleted(ticket))
             {
-                return nullptr;
+                const auto result{ WaitForMultipleObjects(handleCount, handles, FALSE, c_completionPollIntervalInMilliseconds) };
+                if (result == (WAIT_OBJECT_0 + 1))
+                {
+                    return;
+                }
+                THROW_LAST_ERROR_IF(result == WAIT_FAILED);
             }
-
-            return reinterpret_cast<QueueItem*>(GetBaseAddress() + offset);
         }
 
-        size_t ToOffset(QueueItem* item)
+        // Only the instance that owns the queue may receive. Replaces requests with the next batch.
+        bool Receive(std::vector<Request>& requests)
         {
-            size_t offset{ 0 };
-            if (item != nullptr)
+            requests.clear();
+            if (m_channel.Receive(requests, c_receiveBatchSize) == 0)
             {
-                offset = reinterpret_cast<size_t>(item) - GetBaseAddress();
+                return false;
             }
-            return offset;
+
+            // Whoever was waiting on earlier completions has been woken. Anyone who missed it
+            // looks again after c_completionPollIntervalInMilliseconds.
+            m_completed.ResetEvent();
+            return true;
         }
 
-        QueueItem* GetHead()
+        void Complete(const Request& request)
         {
-            void** head = reinterpret_cast<void**>(m_data.Get());
-            if (*head == nullptr)
+            m_channel.Complete(request);
+            if (request.ticket)
             {
-                return nullptr;
+                m_completed.SetEvent();
             }
-
-            return FromOffset(reinterpret_cast<size_t>(*head));
         }
 
-        void SetHead(QueueItem* value)
+        static GUID GetId(const Request& request)
         {
-            // Store as offset, since it's a pointer into shared memory.
-            void** head = reinterpret_cast<void**>(m_data.Get());
-            (*head) = reinterpret_cast<void*>(ToOffset(value));
-        }
-
-        QueueItem* AllocateItem()
-        {
-            QueueItem* upperBounds = reinterpret_cast<QueueItem*>(m_data.Get()) + m_data.Size();
-            auto cur = m_dataStart;
-
-            while (cur < (upperBounds - sizeof(QueueItem)) && cur->inUse)
-            {
-                cur += sizeof(QueueItem);
-            }
-
-            THROW_HR_IF(E_OUTOFMEMORY, cur >= (upperBounds - sizeof(QueueItem)));
-            return cur;
+            GUID id;
+            memcpy(&id, request.id, sizeof(id));
+            return id;
         }
 
+    private:
         std::wstring m_name;
-        QueueItem* m_dataStart{ nullptr };
-        SharedMemory<size_t> m_data;
+        SharedMemory<uint64_t> m_data;
+        Channel m_channel;
+        wil::unique_event m_completed;
     };
 }
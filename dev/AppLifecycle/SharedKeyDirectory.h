@@ -0,0 +1,401 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <thread>
+
+#include "SharedRegionHeader.h"
+
+// Directory of which instance owns which key (see AppInstance::FindOrRegisterForKey), laid
+// out in a caller provided region of shared memory shared by every instance of an app.
+// It's an open addressed hash table; finding a key's owner is a probe or two rather than
+// asking every instance for its key.
+//
+// A slot is bound to a key until the key has no owner: one 64-bit word holding the owning
+// process id and a tag derived from the process' start time, so a reused process id isn't
+// mistaken for the owner. Once its owner withdraws, or is noticed to have gone away without
+// withdrawing (by whoever looks the key up next), the slot is retired: a tombstone that
+// lookups step over (keys added while it was bound may be further along) and that the next
+// key added along the way can take. Each binding bumps the slot's generation, and an unowned
+// slot's owner word is its generation, so anyone holding on to a slot while it's rebound
+// notices (lookups look again) instead of reading, or publishing to, another key's slot.
+// If two processes adding the same key end up in different slots, the first along the
+// probe sequence wins and the other's retired.
+//
+// The directory is an index, not the authority: whoever's deciding ownership publishes to
+// it, and anyone finding nothing (or a key too long or a table too full to hold it) must
+// look the slow way. The region must start out zero-filled, which is the empty directory.
+namespace AppLifecycleCore
+{
+    namespace details
+    {
+        // Key slot state. Any other value is the owner word of the process writing the key.
+        constexpr uint64_t c_keySlotEmpty{ 0 };
+        constexpr uint64_t c_keySlotLive{ 1 };
+        constexpr uint64_t c_keySlotRetired{ 2 };
+
+        constexpr uint32_t c_maxKeyLength{ 256 };
+
+        struct SharedKeyDirectoryHeader
+        {
+            std::atomic<uint64_t> tag;          // magic in the high 32 bits, slot count in the low 32 bits
+            uint64_t reserved[7];
+        };
+        static_assert(sizeof(SharedKeyDirectoryHeader) == 64, "Shared layout");
+
+        struct KeySlot
+        {
+            std::atomic<uint64_t> state;
+            std::atomic<uint64_t> owner;        // the slot's generation if none
+            uint64_t hash;
+            uint32_t length;
+            std::atomic<uint32_t> generation;   // bumped whenever the slot's bound to a key
+            char16_t key[c_maxKeyLength];
+        };
+        static_assert(sizeof(KeySlot) == 32 + (2 * c_maxKeyLength), "Shared layout");
+    }
+
+    class SharedKeyDirectory
+    {
+        using Slot = details::KeySlot;
+
+    public:
+        // Changes to the layout (or how keys are hashed) must change the magic
+        static constexpr uint32_t c_magic{ 0x324B4C41 };    // 'ALK2'
+
+        static constexpr uint32_t c_slotCount{ 512 };
+        static constexpr size_t c_maxKeyLength{ details::c_maxKeyLength };
+
+        // Returns true if the process with this id and start tag (see MakeOwner) is still running
+        using IsOwnerAliveFunction = std::function<bool(uint32_t processId, uint32_t startTag)>;
+
+        static constexpr size_t RegionSize()
+        {
+            return sizeof(details::SharedKeyDirectoryHeader) + (static_cast<size_t>(c_slotCount) * sizeof(Slot));
+        }
+
+        // Identifies a process: its id, and its start time folded to 32 bits
+        static constexpr uint64_t MakeOwner(uint32_t processId, uint64_t startTime)
+        {
+            return (static_cast<uint64_t>(processId) << 32) | static_cast<uint32_t>(startTime ^ (startTime >> 32));
+        }
+
+        static constexpr uint32_t GetProcessId(uint64_t owner)
+        {
+            return static_cast<uint32_t>(owner >> 32);
+        }
+
+        static constexpr uint32_t GetStartTag(uint64_t owner)
+        {
+            return static_cast<uint32_t>(owner);
+        }
+
+        SharedKeyDirectory() = default;
+
+        SharedKeyDirectory(const SharedKeyDirectory&) = delete;
+        SharedKeyDirectory& operator=(const SharedKeyDirectory&) = delete;
+
+        // Returns false if the region's too small or was set up by someone with a different layout
+        bool Attach(void* region, size_t size)
+        {
+            if (!CanHoldLayout(region, size, RegionSize()))
+            {
+                return false;
+            }
+
+            auto header{ static_cast<details::SharedKeyDirectoryHeader*>(region) };
+            if (!StampRegion(header->tag, c_magic, c_slotCount))
+            {
+                return false;
+            }
+
+            m_slots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(region) + sizeof(details::SharedKeyDirectoryHeader));
+            return true;
+        }
+
+        void SetIsOwnerAlive(IsOwnerAliveFunction isOwnerAlive)
+        {
+            m_isOwnerAlive = std::move(isOwnerAlive);
+        }
+
+        // How long to wait on a slot someone else is writing before giving up on the lookup
+        void SetWriteTimeout(std::chrono::steady_clock::duration timeout)
+        {
+            m_writeTimeout = timeout;
+        }
+
+        // Record owner (see MakeOwner) as the key's owner. Returns false if the key's too
+        // long or there's no room for it.
+        bool Publish(std::u16string_view key, uint64_t owner)
+        {
+            for (uint32_t attempt=0; attempt < c_slotCount; ++attempt)
+            {
+                uint32_t generation{};
+                auto slot{ FindSlot(key, owner, generation) };
+                if (slot == nullptr)
+                {
+                    return false;
+                }
+
+                auto previous{ slot->owner.load(std::memory_order_acquire) };
+                if (((GetProcessId(previous) != 0) || (previous == generation)) &&
+                    slot->owner.compare_exchange_strong(previous, owner))
+                {
+                    if (IsBound(*slot, generation))
+                    {
+                        return true;
+                    }
+
+                    // Retired (and maybe rebound) while we were at it. Put back what we replaced.
+                    auto published{ owner };
+                    slot->owner.compare_exchange_strong(published, previous);
+                }
+            }
+            return false;
+        }
+
+        // Clear the key's owner, if it's still owner
+        void Withdraw(std::u16string_view key, uint64_t owner)
+        {
+            uint32_t generation{};
+            if (auto slot{ FindSlot(key, 0, generation) })
+            {
+                if (slot->owner.compare_exchange_strong(owner, generation))
+                {
+                    Retire(*slot, generation);
+                }
+            }
+        }
+
+        // The key's owner, or 0 if it has none (or none that's still running) or the key
+        // can't be found here
+        uint64_t Find(std::u16string_view key)
+        {
+            uint32_t generation{};
+            auto slot{ FindSlot(key, 0, generation) };
+            if (slot == nullptr)
+            {
+                return 0;
+            }
+
+            auto owner{ slot->owner.load(std::memory_order_acquire) };
+            if ((GetProcessId(owner) == 0) || !IsBound(*slot, generation))
+            {
+                return 0;
+            }
+            if (m_isOwnerAlive && !m_isOwnerAlive(GetProcessId(owner), GetStartTag(owner)))
+            {
+                // Gone without withdrawing. Unless someone's replaced it in the meantime.
+                if (slot->owner.compare_exchange_strong(owner, generation))
+                {
+                    Retire(*slot, generation);
+                }
+                return 0;
+            }
+            return owner;
+        }
+
+        // Slots bound to a key
+        uint32_t KeyCount() const
+        {
+            uint32_t count{};
+            for (uint32_t index=0; index < c_slotCount; ++index)
+            {
+                if (m_slots[index].state.load(std::memory_order_acquire) == details::c_keySlotLive)
+                {
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+    private:
+        static uint64_t Hash(std::u16string_view key)
+        {
+            uint64_t hash{ 0xcbf29ce484222325ull };
+            for (auto ch : key)
+            {
+                hash = (hash ^ static_cast<uint16_t>(ch)) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        static bool IsWriter(uint64_t state)
+        {
+            return (state != details::c_keySlotEmpty) && (state != details::c_keySlotLive) && (state != details::c_keySlotRetired);
+        }
+
+        // True if the slot's still bound to the key it was at generation
+        static bool IsBound(const Slot& slot, uint32_t generation)
+        {
+            return (slot.state.load() == details::c_keySlotLive) && (slot.generation.load() == generation);
+        }
+
+        // The slot bound to the key, and the generation it's bound at. If there's none and
+        // writer is nonzero, bind the first retired (or else empty) slot along the key's probe
+        // sequence to it (as writer). Returns nullptr if there's none, no room or it waited too
+        // long on another writer.
+        Slot* FindSlot(std::u16string_view key, uint64_t writer, uint32_t& generation)
+        {
+            if (key.size() > c_maxKeyLength)
+            {
+                return nullptr;
+            }
+
+            const auto hash{ Hash(key) };
+            for (;;)
+            {
+                Slot* reusable{};
+                uint64_t reusableState{};
+                uint32_t probe{};
+                for (; probe < c_slotCount; ++probe)
+                {
+                    auto& slot{ m_slots[(hash + probe) % c_slotCount] };
+                    auto state{ slot.state.load(std::memory_order_acquire) };
+                    if (IsWriter(state))
+                    {
+                        state = WaitForWriter(slot, state);
+                    }
+
+                    if (state == details::c_keySlotLive)
+                    {
+                        const auto slotGeneration{ slot.generation.load(std::memory_order_acquire) };
+                        const bool matches{ (slot.hash == hash) && (slot.length == key.size()) &&
+                                            (std::memcmp(slot.key, key.data(), key.size() * sizeof(char16_t)) == 0) };
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (!IsBound(slot, slotGeneration))
+                        {
+                            // Retired or rebound while we looked. Look again.
+                            --probe;
+                            continue;
+                        }
+                        if (matches)
+                        {
+                            generation = slotGeneration;
+                            return &slot;
+                        }
+                        continue;
+                    }
+                    if (state == details::c_keySlotRetired)
+                    {
+                        if (reusable == nullptr)
+                        {
+                            reusable = &slot;
+                            reusableState = state;
+                        }
+                        continue;
+                    }
+                    if ((state != details::c_keySlotEmpty) || (writer == 0))
+                    {
+                        // Still being written (and we've given up), or the key's not here
+                        return nullptr;
+                    }
+
+                    // End of the line
+                    if (reusable == nullptr)
+                    {
+                        reusable = &slot;
+                        reusableState = state;
+                    }
+                    break;
+                }
+                if ((writer == 0) || (reusable == nullptr))
+                {
+                    return nullptr;
+                }
+
+                // Claim it, or look again if someone beat us to it
+                if (reusable->state.compare_exchange_strong(reusableState, writer, std::memory_order_acq_rel))
+                {
+                    return Bind(*reusable, key, hash, generation);
+                }
+            }
+        }
+
+        Slot* Bind(Slot& slot, std::u16string_view key, uint64_t hash, uint32_t& generation)
+        {
+            // Anyone who sees any of the new key sees the new generation too
+            generation = slot.generation.load(std::memory_order_relaxed) + 1;
+            slot.generation.store(generation, std::memory_order_relaxed);
+            slot.owner.store(generation, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot.hash = hash;
+            slot.length = static_cast<uint32_t>(key.size());
+            if (!key.empty())
+            {
+                std::memcpy(slot.key, key.data(), key.size() * sizeof(char16_t));
+            }
+            slot.state.store(details::c_keySlotLive, std::memory_order_release);
+
+            // Someone adding the same key may have taken a slot further back (one that was
+            // retired after we'd passed it). The first along the probe sequence wins.
+            uint32_t firstGeneration{};
+            auto first{ FindSlot(key, 0, firstGeneration) };
+            if ((first != nullptr) && (first != &slot))
+            {
+                Retire(slot, generation);
+                generation = firstGeneration;
+                return first;
+            }
+            return &slot;
+        }
+
+        // Free the slot for another key, now its key has no owner. Unless it's been published
+        // to (or rebound) in the meantime, in which case it's put back.
+        static void Retire(Slot& slot, uint32_t generation)
+        {
+            if (slot.generation.load() != generation)
+            {
+                return;
+            }
+            auto live{ details::c_keySlotLive };
+            if (!slot.state.compare_exchange_strong(live, details::c_keySlotRetired))
+            {
+                return;
+            }
+            if (slot.owner.load() != generation)
+            {
+                auto retired{ details::c_keySlotRetired };
+                slot.state.compare_exchange_strong(retired, details::c_keySlotLive);
+            }
+        }
+
+        // Wait for the key being written to the slot. A writer that died is evicted (retired,
+        // not emptied, as keys further along may have passed the slot while it was bound to
+        // another). Returns the slot's state at the end, which is its writer's if we gave up.
+        uint64_t WaitForWriter(Slot& slot, uint64_t state)
+        {
+            const auto deadline{ std::chrono::steady_clock::now() + m_writeTimeout };
+            while (IsWriter(state))
+            {
+                if (m_isOwnerAlive && !m_isOwnerAlive(GetProcessId(state), GetStartTag(state)))
+                {
+                    slot.state.compare_exchange_strong(state, details::c_keySlotRetired, std::memory_order_acq_rel);
+                }
+                else if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    return state;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            return state;
+        }
+
+    private:
+        Slot* m_slots{};
+        IsOwnerAliveFunction m_isOwnerAlive;
+        std::chrono::steady_clock::duration m_writeTimeout{ std::chrono::milliseconds(100) };
+    };
+}
@@ -60,6 +60,15 @@ public:
         return m_view.get()->size;
     }
 
+    // Bytes of data actually mapped. Unlike Size() this doesn't trust the region's header,
+    // which may not have been written yet (or may be garbage).
+    size_t MappedSize()
+    {
+        MEMORY_BASIC_INFORMATION info{};
+        THROW_LAST_ERROR_IF(VirtualQuery(m_view.get(), &info, sizeof(info)) == 0);
+        return (info.RegionSize > offsetof(DynamicSharedMemory<T>, data)) ? (info.RegionSize - offsetof(DynamicSharedMemory<T>, data)) : 0;
+    }
+
     T* Get()
     {
         return &m_view.get()->data;
@@ -2,61 +2,113 @@
 // Licensed under the MIT License. See LICENSE in the project root for license information.
 #pragma once
 #include "SharedMemory.h"
-#include "Association.h"
+#include "ProcessLiveness.h"
+#include "SharedProcessTable.h"
 
 namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 {
-    const auto c_maxInstanceCount{ 512 };
-    typedef DWORD SharedProcessListData[c_maxInstanceCount];
-
+    // The running instances of the app, in a table (see SharedProcessTable.h) shared by all of
+    // them. Each segment of the table is a file mapping named after the list. No locks needed.
     class SharedProcessList
     {
+        using Table = AppLifecycleCore::SharedProcessTable;
+
     public:
-        void Init(const std::wstring& filename)
+        using Entry = Table::Entry;
+
+        void Init(const std::wstring& name)
+        {
+            m_name = name;
+            m_segments[0].Open(name, Table::RegionSize() + sizeof(DynamicSharedMemory<uint64_t>));
+            THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), (m_segments[0].MappedSize() < Table::RegionSize()) ||
+                !m_table.Attach(m_segments[0].Get(), Table::RegionSize(), [this](uint32_t segment) { return OpenSegment(segment); }));
+            m_table.SetIsProcessAlive([](uint32_t processId) { return IsProcessAlive(processId, 0); });
+        }
+
+        // Add the current process.
+        void Insert()
         {
-            m_data.Open(filename);
-            m_view = std::move(winrt::array_view<DWORD>(reinterpret_cast<SharedProcessListData>(*m_data.Get())));
+            uint64_t creationTime{};
+            THROW_IF_WIN32_BOOL_FALSE(TryGetCreationTime(GetCurrentProcess(), creationTime));
+
+            Entry entry;
+            THROW_HR_IF(E_OUTOFMEMORY, !m_table.Insert(GetCurrentProcessId(), creationTime, entry));
+        }
+
+        bool Remove(Entry const& entry)
+        {
+            return m_table.Remove(entry);
         }
 
-        void Insert(DWORD processId)
+        // Remove the process' entries, unless it's (still, or again) running.
+        void RemoveIfExited(DWORD processId)
         {
-            for (DWORD index = 0 ; index < m_view.size() ; index++)
+            for (auto const& entry : Snapshot())
             {
-                THROW_HR_IF(E_UNEXPECTED, m_view[index] == processId);
-                if (m_view[index] == 0)
+                if ((entry.processId == processId) && !IsProcessAlive(entry.processId, entry.creationTime))
                 {
-                    m_view[index] = processId;
-                    return;
+                    m_table.Remove(entry);
                 }
             }
+        }
 
-            THROW_HR(E_OUTOFMEMORY);
+        std::vector<Entry> Snapshot()
+        {
+            std::vector<Entry> entries;
+            m_table.Snapshot(entries);
+            return entries;
         }
 
-        void Remove(DWORD processId)
+        // True if the process is running and, if creationTime isn't 0, started then (and so isn't
+        // some other process given the same id since).
+        static bool IsProcessAlive(DWORD processId, uint64_t creationTime)
         {
-            for (DWORD index = 0; index < m_view.size(); index++)
+            if (creationTime == 0)
             {
-                if (m_view[index] == processId)
-                {
-                    m_view[index] = 0;
-                    return;
-                }
+                return AppLifecycleCore::IsProcessAlive(processId);
             }
+            uint64_t actualCreationTime{};
+            return AppLifecycleCore::IsProcessAlive(processId, &actualCreationTime) &&
+                ((actualCreationTime == 0) || (actualCreationTime == creationTime));
         }
 
-        const DWORD Size()
+    private:
+        static BOOL TryGetCreationTime(HANDLE process, uint64_t& creationTime)
         {
-            return m_view.size();
+            FILETIME creation{}, exit{}, kernel{}, user{};
+            if (!GetProcessTimes(process, &creation, &exit, &kernel, &user))
+            {
+                return FALSE;
+            }
+            creationTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+            return TRUE;
         }
 
-        const DWORD operator[](int index)
+        // Segments after the first, mapped the first time anyone here needs them.
+        void* OpenSegment(uint32_t segment)
         {
-            return m_view[index];
+            auto lock = std::scoped_lock(m_segmentsLock);
+            auto& data = m_segments[segment];
+            if (!data.IsValid())
+            {
+                try
+                {
+                    data.Open(wil::str_printf<std::wstring>(L"%s_%u", m_name.c_str(), segment), Table::SegmentSize() + sizeof(DynamicSharedMemory<uint64_t>));
+                    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), data.MappedSize() < Table::SegmentSize());
+                }
+                catch (...)
+                {
+                    LOG_CAUGHT_EXCEPTION();
+                    data.Reset();
+                    return nullptr;
+                }
+            }
+            return data.Get();
         }
 
-    private:
-        SharedMemory<SharedProcessListData> m_data;
-        winrt::array_view<DWORD> m_view;
+        std::wstring m_name;
+        std::mutex m_segmentsLock;
+        SharedMemory<uint64_t> m_segments[Table::c_maxSegmentCount];
+        Table m_table;
     };
 }
@@ -0,0 +1,304 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "SharedRegionHeader.h"
+
+// The running instances of an app, in shared memory every instance maps. Instances add and
+// remove themselves without locks: each slot's state word says whether it's free, being
+// written (and by whom) or live, and carries a generation that changes every time it's
+// freed. An entry names a process by id and creation time, so an entry left behind by a
+// process that's exited isn't mistaken for a later process given the same id, and removing
+// an entry by generation can't remove whatever's taken the slot since.
+//
+// Slots come in segments. The first lives in the region passed to Attach; the rest are
+// added when the ones there are full, each in a region of its own got from the caller (on
+// Windows, a named file mapping per segment). Every region must start out zero-filled.
+namespace AppLifecycleCore
+{
+    namespace details
+    {
+        // Process slot state: generation in the high 32 bits, tag in the low 32 bits. Any other
+        // tag is the process id of the writer (as in SharedRingBuffer).
+        constexpr uint32_t c_processSlotFree{ 0 };
+        constexpr uint32_t c_processSlotLive{ 1 };
+
+        struct SharedProcessTableHeader
+        {
+            std::atomic<uint64_t> tag;          // magic in the high 32 bits, slots per segment in the low 32 bits
+            std::atomic<uint32_t> segmentCount; // segments in use (at least 1)
+            std::atomic<uint32_t> freeHint;     // where to start looking for a free slot
+            std::atomic<uint32_t> highWater;    // one past the highest slot ever used
+            uint32_t reserved1;
+            uint64_t reserved2[5];
+        };
+        static_assert(sizeof(SharedProcessTableHeader) == 64, "Shared layout");
+
+        struct ProcessSlot
+        {
+            std::atomic<uint64_t> state;
+            std::atomic<uint64_t> creationTime;
+            std::atomic<uint32_t> processId;
+            uint32_t reserved;
+        };
+        static_assert(sizeof(ProcessSlot) == 24, "Shared layout");
+    }
+
+    class SharedProcessTable
+    {
+        using Slot = details::ProcessSlot;
+
+    public:
+        // Changes to the layout (or the constants) must change the magic
+        static constexpr uint32_t c_magic{ 0x54504C41 };    // 'ALPT'
+
+        static constexpr uint32_t c_slotsPerSegment{ 512 };
+        static constexpr uint32_t c_maxSegmentCount{ 32 };
+
+        // Returns the region for a segment after the first, of SegmentSize() bytes. It must give
+        // every caller the same segment (mapped once per process, however many ask) and may be
+        // called from any thread. Returns nullptr if it can't.
+        using OpenSegmentFunction = std::function<void*(uint32_t segment)>;
+
+        // Returns true if the process is still running. Used to recover slots left mid-write.
+        using IsProcessAliveFunction = std::function<bool(uint32_t processId)>;
+
+        struct Entry
+        {
+            uint32_t processId{};
+            uint64_t creationTime{};
+            uint32_t index{};                   // slot, across segments
+            uint32_t generation{};
+        };
+
+        // Bytes needed for the first segment (the region passed to Attach)
+        static constexpr size_t RegionSize()
+        {
+            return sizeof(details::SharedProcessTableHeader) + SegmentSize();
+        }
+
+        // Bytes needed for each segment after the first
+        static constexpr size_t SegmentSize()
+        {
+            return static_cast<size_t>(c_slotsPerSegment) * sizeof(Slot);
+        }
+
+        SharedProcessTable() = default;
+
+        SharedProcessTable(const SharedProcessTable&) = delete;
+        SharedProcessTable& operator=(const SharedProcessTable&) = delete;
+
+        // Returns false if the region's too small or was set up by someone with a different layout
+        bool Attach(void* region, size_t size, OpenSegmentFunction openSegment)
+        {
+            if (!CanHoldLayout(region, size, RegionSize()))
+            {
+                return false;
+            }
+
+            auto header{ static_cast<details::SharedProcessTableHeader*>(region) };
+            if (!StampRegion(header->tag, c_magic, c_slotsPerSegment))
+            {
+                return false;
+            }
+            uint32_t segmentCount{};
+            header->segmentCount.compare_exchange_strong(segmentCount, 1);
+
+            m_header = header;
+            m_segments[0].store(reinterpret_cast<Slot*>(static_cast<uint8_t*>(region) + sizeof(details::SharedProcessTableHeader)));
+            m_openSegment = std::move(openSegment);
+            return true;
+        }
+
+        void SetIsProcessAlive(IsProcessAliveFunction isProcessAlive)
+        {
+            m_isProcessAlive = std::move(isProcessAlive);
+        }
+
+        // Add a process. Returns false if there's no room (for c_maxSegmentCount segments
+        // of them, or a segment couldn't be opened).
+        bool Insert(uint32_t processId, uint64_t creationTime, Entry& entry)
+        {
+            for (;;)
+            {
+                const auto segmentCount{ m_header->segmentCount.load(std::memory_order_acquire) };
+                const uint32_t slotCount{ segmentCount * c_slotsPerSegment };
+                const uint32_t start{ m_header->freeHint.load(std::memory_order_relaxed) % slotCount };
+                for (uint32_t offset=0; offset < slotCount; ++offset)
+                {
+                    const uint32_t index{ (start + offset) % slotCount };
+                    auto slot{ SlotAt(index) };
+                    if (slot == nullptr)
+                    {
+                        // Skip the rest of a segment that couldn't be opened
+                        offset += c_slotsPerSegment - 1 - (index % c_slotsPerSegment);
+                        continue;
+                    }
+                    if (TryClaim(*slot, index, processId, creationTime, entry))
+                    {
+                        m_header->freeHint.store(index + 1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+
+                // Full. Add a segment (if no one else has), then look again.
+                if (segmentCount >= c_maxSegmentCount)
+                {
+                    return false;
+                }
+                auto expected{ segmentCount };
+                if (m_header->segmentCount.compare_exchange_strong(expected, segmentCount + 1, std::memory_order_acq_rel))
+                {
+                    m_header->freeHint.store(slotCount, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Remove an entry (from Insert or Snapshot). Returns false if it's already gone.
+        bool Remove(const Entry& entry)
+        {
+            auto slot{ SlotAt(entry.index) };
+            if (slot == nullptr)
+            {
+                return false;
+            }
+            uint64_t expected{ MakeState(entry.generation, details::c_processSlotLive) };
+            if (!slot->state.compare_exchange_strong(expected, MakeState(entry.generation + 1, details::c_processSlotFree), std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            m_header->freeHint.store(entry.index, std::memory_order_relaxed);
+            return true;
+        }
+
+        // The live entries, as of some moment while it ran. Takes no locks and never sees a
+        // half written entry.
+        void Snapshot(std::vector<Entry>& entries)
+        {
+            entries.clear();
+            const uint32_t slotCount{ (std::min)(m_header->highWater.load(std::memory_order_acquire),
+                                                 m_header->segmentCount.load(std::memory_order_acquire) * c_slotsPerSegment) };
+            for (uint32_t index=0; index < slotCount; ++index)
+            {
+                auto slot{ SlotAt(index) };
+                if (slot == nullptr)
+                {
+                    // Couldn't be opened here, so has no one we can see
+                    index += c_slotsPerSegment - 1;
+                    continue;
+                }
+                const auto state{ slot->state.load(std::memory_order_acquire) };
+                if (GetTag(state) != details::c_processSlotLive)
+                {
+                    continue;
+                }
+
+                Entry entry{ slot->processId.load(std::memory_order_relaxed), slot->creationTime.load(std::memory_order_relaxed), index, GetGeneration(state) };
+
+                // Only good if the slot wasn't freed (and perhaps reused) while we read it
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot->state.load(std::memory_order_relaxed) == state)
+                {
+                    entries.push_back(entry);
+                }
+            }
+        }
+
+        uint32_t SegmentCount() const
+        {
+            return m_header->segmentCount.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr uint64_t MakeState(uint32_t generation, uint32_t tag)
+        {
+            return (static_cast<uint64_t>(generation) << 32) | tag;
+        }
+
+        static constexpr uint32_t GetGeneration(uint64_t state)
+        {
+            return static_cast<uint32_t>(state >> 32);
+        }
+
+        static constexpr uint32_t GetTag(uint64_t state)
+        {
+            return static_cast<uint32_t>(state);
+        }
+
+        // The slot at index, opening its segment if it's the first time this process has looked
+        Slot* SlotAt(uint32_t index)
+        {
+            const uint32_t segment{ index / c_slotsPerSegment };
+            if (segment >= c_maxSegmentCount)
+            {
+                return nullptr;
+            }
+            auto slots{ m_segments[segment].load(std::memory_order_acquire) };
+            if (slots == nullptr)
+            {
+                if (!m_openSegment)
+                {
+                    return nullptr;
+                }
+                slots = static_cast<Slot*>(m_openSegment(segment));
+                if (slots == nullptr)
+                {
+                    return nullptr;
+                }
+                m_segments[segment].store(slots, std::memory_order_release);
+            }
+            return slots + (index % c_slotsPerSegment);
+        }
+
+        bool TryClaim(Slot& slot, uint32_t index, uint32_t processId, uint64_t creationTime, Entry& entry)
+        {
+            auto state{ slot.state.load(std::memory_order_acquire) };
+            const auto tag{ GetTag(state) };
+            if (tag == details::c_processSlotLive)
+            {
+                return false;
+            }
+            if (tag != details::c_processSlotFree)
+            {
+                // Left mid-write by a process that's gone? Then it's free (for the next generation).
+                if (!m_isProcessAlive || m_isProcessAlive(tag))
+                {
+                    return false;
+                }
+                if (!slot.state.compare_exchange_strong(state, MakeState(GetGeneration(state) + 1, details::c_processSlotFree), std::memory_order_acq_rel))
+                {
+                    return false;
+                }
+                state = MakeState(GetGeneration(state) + 1, details::c_processSlotFree);
+            }
+
+            const auto generation{ GetGeneration(state) };
+            if (!slot.state.compare_exchange_strong(state, MakeState(generation, processId), std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            slot.processId.store(processId, std::memory_order_relaxed);
+            slot.creationTime.store(creationTime, std::memory_order_relaxed);
+            auto highWater{ m_header->highWater.load(std::memory_order_relaxed) };
+            while ((highWater <= index) && !m_header->highWater.compare_exchange_weak(highWater, index + 1, std::memory_order_acq_rel))
+            {
+            }
+            slot.state.store(MakeState(generation, details::c_processSlotLive), std::memory_order_release);
+            entry = Entry{ processId, creationTime, index, generation };
+            return true;
+        }
+
+    private:
+        details::SharedProcessTableHeader* m_header{};
+        std::atomic<Slot*> m_segments[c_maxSegmentCount]{};
+        OpenSegmentFunction m_openSegment;
+        IsProcessAliveFunction m_isProcessAlive;
+    };
+}
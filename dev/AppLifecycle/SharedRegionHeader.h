@@ -0,0 +1,31 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Helpers for attaching to a layout in a caller provided region of shared memory, shared by
+// the AppLifecycle structures (SharedRingBuffer.h, SharedProcessTable.h, ...) and MRM's
+// shared resolution cache. Every such region starts with a 64-bit tag saying which layout
+// it holds, and starts out zero-filled.
+namespace AppLifecycleCore
+{
+    // True if the region is big enough for the layout and aligned for its 64-bit atomics
+    inline bool CanHoldLayout(const void* region, size_t size, size_t layoutSize)
+    {
+        return (region != nullptr) && ((reinterpret_cast<uintptr_t>(region) % alignof(uint64_t)) == 0) && (size >= layoutSize);
+    }
+
+    // The first process to get here stamps the region: the layout's magic in the high 32 bits
+    // of its tag, and whatever else everyone sharing it must agree on (a version, a capacity)
+    // in the low 32 bits. Everyone else must agree with the stamp or stay out, so this returns
+    // false if the region was stamped for something else.
+    inline bool StampRegion(std::atomic<uint64_t>& tag, uint32_t magic, uint32_t layout)
+    {
+        const uint64_t expected{ (static_cast<uint64_t>(magic) << 32) | layout };
+        uint64_t existing{};
+        return tag.compare_exchange_strong(existing, expected) || (existing == expected);
+    }
+}
@@ -0,0 +1,363 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include "SharedRegionHeader.h"
+
+// Bounded multi-producer, single-consumer queue laid out in a caller provided region of
+// shared memory. Every process that maps the region can enqueue; only the process that
+// owns it dequeues. No locks are taken: producers claim a position by advancing the tail
+// and each slot carries a state word saying which lap (trip around the ring) it's ready
+// for and whether it's free, claimed, being written, ready or abandoned.
+//
+// Producers build their value privately and only copy it into the slot once they've
+// confirmed (with a CAS) that the slot is still theirs, so a producer the consumer gave up
+// on can never scribble over a slot that's since been handed to someone else.
+//
+// Producers that die can't wedge the queue. A claimed slot is abandoned once its producer
+// is known to be gone, or after a timeout (the producer, if it was merely slow, notices
+// and claims another). The timeout also covers a dead producer whose process id has since
+// been reused, which would otherwise look alive forever. A slot being written is only
+// abandoned once its producer is known to be gone: the copy is short, and the slot can't
+// be reused while it might still be in progress.
+//
+// How the region is created and mapped is up to the caller (named file mappings on
+// Windows, POSIX shm in the tests). It must start out zero-filled, which is the empty queue.
+namespace AppLifecycleCore
+{
+    namespace details
+    {
+        // Slot state: lap in the high 32 bits, tag in the low 32 bits. Any other tag is the
+        // process id of the producer that claimed it (user processes never get ids 0-3, nor
+        // ones with the top bit set), with c_slotWriting added while it copies its value in.
+        constexpr uint32_t c_slotFree{ 0 };
+        constexpr uint32_t c_slotReady{ 1 };
+        constexpr uint32_t c_slotAbandoned{ 2 };
+        constexpr uint32_t c_slotWriting{ 0x80000000 };
+
+        constexpr uint64_t MakeSlotState(uint32_t lap, uint32_t tag)
+        {
+            return (static_cast<uint64_t>(lap) << 32) | tag;
+        }
+
+        constexpr uint32_t GetLap(uint64_t state)
+        {
+            return static_cast<uint32_t>(state >> 32);
+        }
+
+        constexpr uint32_t GetTag(uint64_t state)
+        {
+            return static_cast<uint32_t>(state);
+        }
+
+        // Each counter gets its own cache line so producers and the consumer don't contend
+        struct SharedRingBufferHeader
+        {
+            std::atomic<uint64_t> tag;          // magic in the high 32 bits, capacity in the low 32 bits
+            uint64_t reserved1[7];
+            std::atomic<uint64_t> tail;         // next position to claim
+            uint64_t reserved2[7];
+            std::atomic<uint64_t> head;         // next position to consume
+            uint64_t reserved3[7];
+        };
+        static_assert(sizeof(SharedRingBufferHeader) == 192, "Shared layout");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "Atomics in shared memory must be lock-free");
+
+        template <typename T>
+        struct SharedRingBufferSlot
+        {
+            std::atomic<uint64_t> state;
+            T value;
+        };
+    }
+
+    template <typename T>
+    class SharedRingBuffer
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Values are copied between processes");
+
+        using Slot = details::SharedRingBufferSlot<T>;
+
+    public:
+        // Changes to the layout (or T) must change the magic so mismatched processes stay out
+        static constexpr uint32_t c_magic{ 0x32524C41 };    // 'ALR2'
+
+        // Returns true if the process is still running. Used to recover slots left mid-write.
+        using IsProcessAliveFunction = std::function<bool(uint32_t processId)>;
+
+        // A claimed slot. Fill in value, then commit it.
+        struct Reservation
+        {
+            T value{};
+            uint64_t position{};
+            uint32_t processId{};
+
+            explicit operator bool() const
+            {
+                return processId != 0;
+            }
+        };
+
+        // Bytes needed for a queue of capacity (a power of 2) values
+        static constexpr size_t RegionSize(uint32_t capacity)
+        {
+            return sizeof(details::SharedRingBufferHeader) + (static_cast<size_t>(capacity) * sizeof(Slot));
+        }
+
+        SharedRingBuffer() = default;
+
+        SharedRingBuffer(const SharedRingBuffer&) = delete;
+        SharedRingBuffer& operator=(const SharedRingBuffer&) = delete;
+
+        // Uses the largest power of 2 capacity that fits. Returns false if the region's too
+        // small or was set up by someone with a different layout.
+        bool Attach(void* region, size_t size)
+        {
+            if (!CanHoldLayout(region, size, RegionSize(2)))
+            {
+                return false;
+            }
+
+            uint32_t capacity{ 2 };
+            while ((capacity < 0x40000000u) && (RegionSize(capacity * 2) <= size))
+            {
+                capacity *= 2;
+            }
+
+            auto header{ static_cast<details::SharedRingBufferHeader*>(region) };
+            if (!StampRegion(header->tag, c_magic, capacity))
+            {
+                return false;
+            }
+
+            m_header = header;
+            m_slots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(region) + sizeof(details::SharedRingBufferHeader));
+            m_capacity = capacity;
+            m_lapShift = 0;
+            while ((1u << m_lapShift) < capacity)
+            {
+                ++m_lapShift;
+            }
+            return true;
+        }
+
+        uint32_t Capacity() const
+        {
+            return m_capacity;
+        }
+
+        // Values enqueued but not yet dequeued (a snapshot; it can change at any time)
+        size_t Count() const
+        {
+            const auto head{ m_header->head.load(std::memory_order_acquire) };
+            const auto tail{ m_header->tail.load(std::memory_order_acquire) };
+            return (tail > head) ? static_cast<size_t>(tail - head) : 0;
+        }
+
+        // Claim a slot to fill in. Returns an empty reservation if the queue's full.
+        Reservation Reserve(uint32_t processId)
+        {
+            for (;;)
+            {
+                auto position{ m_header->tail.load(std::memory_order_acquire) };
+                auto& slot{ SlotAt(position) };
+                const auto state{ slot.state.load(std::memory_order_acquire) };
+                const auto lap{ Lap(position) };
+                if (state == details::MakeSlotState(lap, details::c_slotFree))
+                {
+                    if (!m_header->tail.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel))
+                    {
+                        continue;
+                    }
+
+                    // The consumer may have given up on us between the two; if so, try again
+                    uint64_t expected{ details::MakeSlotState(lap, details::c_slotFree) };
+                    if (slot.state.compare_exchange_strong(expected, details::MakeSlotState(lap, processId), std::memory_order_acq_rel))
+                    {
+                        return Reservation{ T{}, position, processId };
+                    }
+                }
+                else if (static_cast<int32_t>(details::GetLap(state) - lap) < 0)
+                {
+                    // Not consumed since the last lap
+                    return {};
+                }
+            }
+        }
+
+        // Copy a reservation's value into its slot and make it visible to the consumer. Returns
+        // false, without touching the slot, if the consumer gave up on it (i.e. decided we're
+        // dead); the value should be enqueued again.
+        bool Commit(const Reservation& reservation)
+        {
+            const auto lap{ Lap(reservation.position) };
+            auto& slot{ SlotAt(reservation.position) };
+            uint64_t expected{ details::MakeSlotState(lap, reservation.processId) };
+            if (!slot.state.compare_exchange_strong(expected, details::MakeSlotState(lap, reservation.processId | details::c_slotWriting), std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            slot.value = reservation.value;
+            slot.state.store(details::MakeSlotState(lap, details::c_slotReady), std::memory_order_release);
+            return true;
+        }
+
+        bool TryEnqueue(const T& value, uint32_t processId)
+        {
+            for (;;)
+            {
+                auto reservation{ Reserve(processId) };
+                if (!reservation)
+                {
+                    return false;
+                }
+                reservation.value = value;
+                if (Commit(reservation))
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Consumer only. Returns false if there's nothing (yet) to dequeue.
+        bool TryDequeue(T& value)
+        {
+            for (;;)
+            {
+                const auto position{ m_header->head.load(std::memory_order_relaxed) };
+                auto& slot{ SlotAt(position) };
+                const auto state{ slot.state.load(std::memory_order_acquire) };
+                const auto lap{ Lap(position) };
+                if (details::GetLap(state) != lap)
+                {
+                    return false;
+                }
+
+                const auto tag{ details::GetTag(state) };
+                if (tag == details::c_slotReady)
+                {
+                    value = slot.value;
+                    Release(slot, position);
+                    return true;
+                }
+                if (tag == details::c_slotAbandoned)
+                {
+                    Release(slot, position);
+                    continue;
+                }
+                if (!TryAbandon(slot, position, state))
+                {
+                    return false;
+                }
+            }
+        }
+
+        // How long a claimed position may go uncommitted before the consumer skips it
+        void SetStallTimeout(std::chrono::steady_clock::duration timeout)
+        {
+            m_stallTimeout = timeout;
+        }
+
+        void SetIsProcessAlive(IsProcessAliveFunction isProcessAlive)
+        {
+            m_isProcessAlive = std::move(isProcessAlive);
+        }
+
+        // Slots skipped because their writer died or never showed up
+        uint64_t AbandonedCount() const
+        {
+            return m_abandonedCount;
+        }
+
+    private:
+        Slot& SlotAt(uint64_t position) const
+        {
+            return m_slots[position & (m_capacity - 1)];
+        }
+
+        uint32_t Lap(uint64_t position) const
+        {
+            return static_cast<uint32_t>(position >> m_lapShift);
+        }
+
+        void Release(Slot& slot, uint64_t position)
+        {
+            m_stallPosition = UINT64_MAX;
+            slot.state.store(details::MakeSlotState(Lap(position + m_capacity), details::c_slotFree), std::memory_order_release);
+            m_header->head.store(position + 1, std::memory_order_release);
+        }
+
+        // The slot at head isn't ready. Decide whether to wait for it or give up on it.
+        bool TryAbandon(Slot& slot, uint64_t position, uint64_t state)
+        {
+            const auto tag{ details::GetTag(state) };
+            bool writerGone{};
+            if (tag == details::c_slotFree)
+            {
+                if (m_header->tail.load(std::memory_order_acquire) <= position)
+                {
+                    // Empty
+                    return false;
+                }
+            }
+            else
+            {
+                writerGone = m_isProcessAlive && !m_isProcessAlive(tag & ~details::c_slotWriting);
+                if (!writerGone && ((tag & details::c_slotWriting) != 0))
+                {
+                    // Being copied into. It'll be done shortly, and until then the slot can't
+                    // be handed to anyone else.
+                    return false;
+                }
+            }
+
+            if (!writerGone)
+            {
+                // Claimed, by a process that's yet to show up or that looks alive (though its id
+                // may belong to someone else by now). Give the producer a while before skipping
+                // it; the clock restarts if it makes progress.
+                const auto now{ std::chrono::steady_clock::now() };
+                if ((m_stallPosition != position) || (m_stallState != state))
+                {
+                    m_stallPosition = position;
+                    m_stallState = state;
+                    m_stallSince = now;
+                    return false;
+                }
+                if ((now - m_stallSince) < m_stallTimeout)
+                {
+                    return false;
+                }
+            }
+
+            if (!slot.state.compare_exchange_strong(state, details::MakeSlotState(Lap(position), details::c_slotAbandoned), std::memory_order_acq_rel))
+            {
+                // The producer got there first; look again
+                return true;
+            }
+            ++m_abandonedCount;
+            return true;
+        }
+
+    private:
+        details::SharedRingBufferHeader* m_header{};
+        Slot* m_slots{};
+        uint32_t m_capacity{};
+        uint32_t m_lapShift{};
+
+        // Consumer state, local to the owning process
+        IsProcessAliveFunction m_isProcessAlive;
+        std::chrono::steady_clock::duration m_stallTimeout{ std::chrono::seconds(5) };
+        uint64_t m_stallPosition{ UINT64_MAX };
+        uint64_t m_stallState{};
+        std::chrono::steady_clock::time_point m_stallSince{};
+        uint64_t m_abandonedCount{};
+    };
+}
@@ -12,7 +12,7 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
     constexpr PCWSTR c_startupTaskContractId = L"Windows.StartupTask";
 
     class StartupActivatedEventArgs : public winrt::implements<StartupActivatedEventArgs, IStartupTaskActivatedEventArgs,
-        ActivatedEventArgsBase, IInternalValueMarshalable>
+        ActivatedEventArgsBase, IInternalValueMarshalable, IInternalRecordMarshalable>
     {
     public:
         StartupActivatedEventArgs(const winrt::hstring taskId) : m_taskId(taskId)
@@ -27,6 +27,11 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return make<StartupActivatedEventArgs>(taskId);
         }
 
+        static winrt::Windows::Foundation::IInspectable Deserialize(AppLifecycleCore::ActivationRecord const& record)
+        {
+            return make<StartupActivatedEventArgs>(FromRecordString(record.value));
+        }
+
         // IInternalValueMarshalable
         winrt::Windows::Foundation::Uri Serialize()
         {
@@ -34,6 +39,12 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
             return winrt::Windows::Foundation::Uri(uri);
         }
 
+        // IInternalRecordMarshalable
+        AppLifecycleCore::ActivationRecord SerializeRecord()
+        {
+            return { AppLifecycleCore::ActivationRecordKind::StartupTask, ToRecordString(m_taskId) };
+        }
+
         // IStartupTaskActivatedEventArgs
         winrt::hstring TaskId()
         {
@@ -2,6 +2,8 @@
 // Licensed under the MIT License. See LICENSE in the project root for license information.
 #pragma once
 
+#include "ActivationRecord.h"
+
 namespace winrt::Microsoft::Windows::AppLifecycle::implementation
 {
     static PCWSTR c_launchSchemeName{ L"ms-launch" };
@@ -17,6 +19,25 @@ namespace winrt::Microsoft::Windows::AppLifecycle::implementation
         virtual winrt::Windows::Foundation::Uri Serialize() PURE;
     };
 
+    // Implemented by the built-in activation kinds, which can be marshaled as an ActivationRecord
+    // instead of an encoded launch Uri.  Each also has a static Deserialize taking the record.
+    MIDL_INTERFACE("6F1A4E2B-9C3D-4B8E-A5F7-2D0C8B1E93A4") IInternalRecordMarshalable : IInspectable
+    {
+        virtual AppLifecycleCore::ActivationRecord SerializeRecord() PURE;
+    };
+
+    static_assert(sizeof(wchar_t) == sizeof(char16_t), "ActivationRecord strings are UTF-16");
+
+    inline std::u16string ToRecordString(winrt::hstring const& value)
+    {
+        return { reinterpret_cast<const char16_t*>(value.c_str()), value.size() };
+    }
+
+    inline winrt::hstring FromRecordString(std::u16string const& value)
+    {
+        return { reinterpret_cast<const wchar_t*>(value.c_str()), static_cast<uint32_t>(value.size()) };
+    }
+
     inline std::wstring GenerateEncodedLaunchUri(std::wstring const& appUserModelId, std::wstring const& contractId)
     {
         // Example: ms-encodedlaunch:App/?ContractId=Windows.File&Verb=open&File=%1
@@ -14,47 +14,17 @@
 
 MddCore::PackageDependency MddCore::DataStore::Load(PCWSTR packageDependencyId)
 {
-    std::filesystem::path relativeFilename{ L"DynamicDependency" };
-    relativeFilename /= std::wstring(packageDependencyId) + DataStore::fileExtension;
-
-    auto filename{ GetDataStorePathForUser() };
-    filename /= relativeFilename;
-    wil::unique_hfile file{ OpenFileIfExists(filename.c_str()) };
-    if (!file)
+    auto json{ Load(GetStoreForUser(), GetDataStorePathForUser(), packageDependencyId) };
+    if (json.empty())
     {
-        filename = GetDataStorePathForSystem();
-        filename /= relativeFilename;
-        file.reset(OpenFileIfExists(filename.c_str()));
-        if (!file)
+        json = Load(GetStoreForSystem(), GetDataStorePathForSystem(), packageDependencyId);
+        if (json.empty())
         {
             // Not found
             return PackageDependency();
         }
     }
-
-    LARGE_INTEGER fileSize{};
-    THROW_IF_WIN32_BOOL_FALSE(::GetFileSizeEx(file.get(), &fileSize));
-    const auto dataSize{ fileSize.QuadPart };
-    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), dataSize > INT32_MAX);
-    if (dataSize == 0)
-    {
-        // 0-byte file is invalid. Perhaps power was lost when written but before flushed?
-        // 'Fix' it i.e. delete it and report not-found
-        file.reset();
-        std::filesystem::remove(filename);
-        return PackageDependency();
-    }
-
-    const auto bufferSize{ static_cast<DWORD>(dataSize) + 1 };
-    std::unique_ptr<char[]> bufferUtf8{ std::make_unique<char[]>(bufferSize) };
-
-    DWORD bytesRead{};
-    THROW_IF_WIN32_BOOL_FALSE(::ReadFile(file.get(), bufferUtf8.get(), bufferSize, &bytesRead, nullptr));
-    file.reset();
-    bufferUtf8[bytesRead] = '\0';
-    auto json{ bufferUtf8.get() };
-
-    return MddCore::PackageDependency::FromJSON(json);
+    return MddCore::PackageDependency::FromJSON(json.c_str());
 }
 
 void MddCore::DataStore::Save(
@@ -69,35 +39,129 @@ void MddCore::DataStore::Save(
 
     auto json{ packageDependency.ToJSONUtf8() };
 
-    auto path{ GetDataStorePath(options) };
-    path /= L"DynamicDependency";
-    std::filesystem::create_directory(path);
+    auto& store{ WI_IsFlagSet(options, MddCreatePackageDependencyOptions::ScopeIsSystem) ? GetStoreForSystem() : GetStoreForUser() };
+    store.Save(packageDependency.Id().c_str(), json);
+}
 
-    auto filename{ path / (packageDependency.Id() + DataStore::fileExtension) };
+void MddCore::DataStore::Delete(PCWSTR packageDependencyId)
+{
+    const auto legacyFilename{ std::filesystem::path(L"DynamicDependency") / (std::wstring(packageDependencyId) + DataStore::fileExtension) };
 
-    wil::unique_hfile file{ ::CreateFileW(filename.c_str(), GENERIC_WRITE, FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
-    if (!file)
+    if (!GetStoreForUser().Delete(packageDependencyId) && !DeleteFileIfExists((GetDataStorePathForUser() / legacyFilename).c_str()))
     {
-        THROW_LAST_ERROR_MSG("%ls", filename.c_str());
+        if (!GetStoreForSystem().Delete(packageDependencyId))
+        {
+            DeleteFileIfExists((GetDataStorePathForSystem() / legacyFilename).c_str());
+        }
     }
+}
 
-    DWORD bytesWritten{};
-    THROW_IF_WIN32_BOOL_FALSE_MSG(::WriteFile(file.get(), json.c_str(), static_cast<DWORD>(json.length()), &bytesWritten, nullptr), "%ls", filename.c_str());
+MddCore::PackageDependencyStore& MddCore::DataStore::GetStoreForUser()
+{
+    static MddCore::PackageDependencyStore store{ GetDataStorePathForUser() / L"DynamicDependency" / DataStore::storeFilename };
+    return store;
 }
 
-void MddCore::DataStore::Delete(PCWSTR packageDependencyId)
+MddCore::PackageDependencyStore& MddCore::DataStore::GetStoreForSystem()
+{
+    static MddCore::PackageDependencyStore store{ GetDataStorePathForSystem() / L"DynamicDependency" / DataStore::storeFilename };
+    return store;
+}
+
+std::string MddCore::DataStore::Load(
+    MddCore::PackageDependencyStore& store,
+    const std::filesystem::path& path,
+    PCWSTR packageDependencyId)
+{
+    // Package dependencies used to be saved one per file (<path>\DynamicDependency\<id>.mdd).
+    // If we find one move it to the store
+    struct Store
+    {
+        MddCore::PackageDependencyStore& store;
+
+        std::string Find(const std::wstring& id)
+        {
+            return store.Find(id.c_str());
+        }
+
+        bool TrySave(const std::wstring& id, const std::string& json)
+        {
+            try
+            {
+                store.Save(id.c_str(), json);
+                return true;
+            }
+            CATCH_LOG();
+            return false;
+        }
+    };
+    struct LegacyFiles
+    {
+        std::filesystem::path path;
+
+        std::filesystem::path Filename(const std::wstring& id) const
+        {
+            return path / L"DynamicDependency" / (id + DataStore::fileExtension);
+        }
+
+        std::string Load(const std::wstring& id)
+        {
+            return LoadLegacyFile(Filename(id));
+        }
+
+        void Delete(const std::wstring& id)
+        {
+            try
+            {
+                DeleteFileIfExists(Filename(id).c_str());
+            }
+            CATCH_LOG();
+        }
+    };
+    Store storeAdapter{ store };
+    LegacyFiles legacyFiles{ path };
+    return MddCore::LoadAndMigrate(storeAdapter, legacyFiles, packageDependencyId);
+}
+
+std::string MddCore::DataStore::LoadLegacyFile(const std::filesystem::path& filename)
 {
-    std::filesystem::path relativeFilename{ L"DynamicDependency" };
-    relativeFilename /= std::wstring(packageDependencyId) + DataStore::fileExtension;
+    wil::unique_hfile file{ OpenFileIfExists(filename.c_str()) };
+    if (!file)
+    {
+        // Not found
+        return std::string();
+    }
 
-    auto filename{ GetDataStorePathForUser() };
-    filename /= relativeFilename;
-    if (!DeleteFileIfExists(filename.c_str()))
+    LARGE_INTEGER fileSize{};
+    THROW_IF_WIN32_BOOL_FALSE(::GetFileSizeEx(file.get(), &fileSize));
+    const auto dataSize{ fileSize.QuadPart };
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), dataSize > INT32_MAX);
+    if (dataSize == 0)
     {
-        filename = GetDataStorePathForSystem();
-        filename /= relativeFilename;
-        DeleteFileIfExists(filename.c_str());
+        // 0-byte file is invalid. Perhaps power was lost when written but before flushed?
+        // 'Fix' it i.e. delete it and report not-found
+        file.reset();
+        std::filesystem::remove(filename);
+        return std::string();
     }
+
+    std::string json(static_cast<size_t>(dataSize), '\0');
+    DWORD bytesRead{};
+    THROW_IF_WIN32_BOOL_FALSE(::ReadFile(file.get(), json.data(), static_cast<DWORD>(json.size()), &bytesRead, nullptr));
+    json.resize(bytesRead);
+    return json;
+}
+
+std::filesystem::path MddCore::DataStore::GetCachePathForUser()
+{
+    // AppContainer processes can only reach the user's data store via PackagedCOM (see GetDataStorePathForUser).
+    // That costs more than anything we'd care to cache so there's no cache for them.
+    THROW_HR_IF(E_ACCESSDENIED, wil::get_token_is_app_container());
+
+    auto path{ GetDataStorePathForUserViaApplicationDataManager() };
+    path /= L"DynamicDependency";
+    path /= L"Cache";
+    return path;
 }
 
 bool MddCore::DataStore::DeleteFileIfExists(PCWSTR filename)
@@ -130,18 +194,6 @@ HANDLE MddCore::DataStore::OpenFileIfExists(
     return file.release();
 }
 
-std::filesystem::path MddCore::DataStore::GetDataStorePath(const MddCreatePackageDependencyOptions options)
-{
-    if (WI_IsFlagSet(options, MddCreatePackageDependencyOptions::ScopeIsSystem))
-    {
-        return GetDataStorePathForSystem();
-    }
-    else
-    {
-        return GetDataStorePathForUser();
-    }
-}
-
 std::filesystem::path MddCore::DataStore::GetDataStorePathForSystem()
 {
     wil::unique_cotaskmem_ptr<WCHAR[]> folderPath;
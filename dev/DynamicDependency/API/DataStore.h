@@ -4,6 +4,7 @@
 #pragma once
 
 #include "PackageDependency.h"
+#include "PackageDependencyStore.h"
 
 namespace MddCore
 {
@@ -15,6 +16,7 @@ namespace MddCore
 
     public:
         static constexpr PCWSTR fileExtension{ L".mdd" };
+        static constexpr PCWSTR storeFilename{ L"PackageDependencies.log" };
 
         static MddCore::PackageDependency Load(PCWSTR packageDependencyId);
 
@@ -24,13 +26,26 @@ namespace MddCore
 
         static void Delete(PCWSTR packageDependencyId);
 
+        // Per-user location for data derived from packages e.g. parsed appxmanifest.xml.
+        // Not available to AppContainer processes.
+        static std::filesystem::path GetCachePathForUser();
+
     private:
+        static MddCore::PackageDependencyStore& GetStoreForUser();
+
+        static MddCore::PackageDependencyStore& GetStoreForSystem();
+
+        static std::string Load(
+            MddCore::PackageDependencyStore& store,
+            const std::filesystem::path& path,
+            PCWSTR packageDependencyId);
+
+        static std::string LoadLegacyFile(const std::filesystem::path& filename);
+
         static bool DeleteFileIfExists(PCWSTR filename);
 
         static HANDLE OpenFileIfExists(PCWSTR filename);
 
-        static std::filesystem::path GetDataStorePath(const MddCreatePackageDependencyOptions options);
-
         static std::filesystem::path GetDataStorePathForSystem();
 
         static std::filesystem::path GetDataStorePathForUser();
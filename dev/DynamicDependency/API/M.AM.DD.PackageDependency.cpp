@@ -113,6 +113,48 @@ namespace winrt::Microsoft::Windows::ApplicationModel::DynamicDependency::implem
         return context;
     }
 
+    com_array<winrt::PackageDependencyContext> PackageDependency::AddMany(array_view<winrt::PackageDependency const> packageDependencies, array_view<winrt::AddPackageDependencyOptions const> options, bool allOrNothing)
+    {
+        THROW_HR_IF(E_INVALIDARG, !options.empty() && (options.size() != packageDependencies.size()));
+
+        const auto count{ packageDependencies.size() };
+        std::vector<hstring> ids;
+        ids.reserve(count);
+        std::vector<MddAddPackageDependencyRequest> requests(count);
+        for (uint32_t index=0; index < count; ++index)
+        {
+            ids.push_back(packageDependencies[index].Id());
+            auto& request{ requests[index] };
+            request.packageDependencyId = ids.back().c_str();
+            if (options.empty())
+            {
+                request.rank = MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT;
+                request.options = MddAddPackageDependencyOptions::None;
+            }
+            else
+            {
+                request.rank = options[index].Rank();
+                request.options = ::Microsoft::Windows::ApplicationModel::DynamicDependency::ToAddOptions(options[index]);
+            }
+        }
+
+        const auto mddOptions{ allOrNothing ? MddAddPackageDependenciesOptions::AllOrNothing : MddAddPackageDependenciesOptions::None };
+        std::vector<MddAddPackageDependencyResult> results(count);
+        winrt::check_hresult(MddAddPackageDependencies(count, requests.data(), mddOptions, results.data()));
+
+        com_array<winrt::PackageDependencyContext> contexts(count);
+        for (uint32_t index=0; index < count; ++index)
+        {
+            auto& result{ results[index] };
+            wil::unique_process_heap_string packageFullName(result.packageFullName);
+            if (result.packageDependencyContext)
+            {
+                contexts[index] = winrt::make<implementation::PackageDependencyContext>(result.packageDependencyContext);
+            }
+        }
+        return contexts;
+    }
+
     winrt::PackageDependency PackageDependency::Create(
         PSID userSid,
         PCWSTR packageFamilyName,
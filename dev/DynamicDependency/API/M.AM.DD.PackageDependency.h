@@ -25,6 +25,7 @@ namespace winrt::Microsoft::Windows::ApplicationModel::DynamicDependency::implem
         void Delete();
         winrt::PackageDependencyContext Add();
         winrt::PackageDependencyContext Add(Microsoft::Windows::ApplicationModel::DynamicDependency::AddPackageDependencyOptions const& options);
+        static com_array<winrt::PackageDependencyContext> AddMany(array_view<winrt::PackageDependency const> packageDependencies, array_view<winrt::AddPackageDependencyOptions const> options, bool allOrNothing);
 
     private:
         static winrt::PackageDependency Create(
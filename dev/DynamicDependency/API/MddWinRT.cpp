@@ -43,6 +43,19 @@ HRESULT MddCore::WinRT::GetThreadingModel(
 }
 CATCH_RETURN();
 
+HRESULT MddCore::WinRT::GetThreadingModel(
+    HSTRING className,
+    ABI::Windows::Foundation::ThreadingType& threadingType,
+    MddCore::WinRT::ResolvedClass& resolvedClass) noexcept try
+{
+    if (!MddCore::WinRTModuleManager::GetThreadingType(className, threadingType, &resolvedClass))
+    {
+        return REGDB_E_CLASSNOTREG;
+    }
+    return S_OK;
+}
+CATCH_RETURN();
+
 HRESULT MddCore::WinRT::GetActivationFactory(
     HSTRING className,
     REFIID iid,
@@ -52,3 +65,14 @@ HRESULT MddCore::WinRT::GetActivationFactory(
     return S_OK;
 }
 CATCH_RETURN();
+
+HRESULT MddCore::WinRT::GetActivationFactory(
+    const MddCore::WinRT::ResolvedClass& resolvedClass,
+    HSTRING className,
+    REFIID iid,
+    void** factory) noexcept try
+{
+    *factory = MddCore::WinRTModuleManager::GetActivationFactory(className, iid, &resolvedClass);
+    return S_OK;
+}
+CATCH_RETURN();
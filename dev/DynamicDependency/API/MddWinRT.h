@@ -25,11 +25,30 @@ namespace MddCore::WinRT
         ABI::Windows::Foundation::ThreadingType& threadingType,
         HRESULT errorIfUnknown = REGDB_E_CLASSNOTREG) noexcept;
 
+    // Where GetThreadingModel() found a class, so GetActivationFactory() needn't search for it again.
+    // Only used if the package graph hasn't changed in between; otherwise the class is looked up again.
+    struct ResolvedClass
+    {
+        void* inprocServer{};
+        uint64_t generation{};
+    };
+
     HRESULT GetThreadingModel(
         HSTRING className,
         ABI::Windows::Foundation::ThreadingType& threading_model) noexcept;
 
+    HRESULT GetThreadingModel(
+        HSTRING className,
+        ABI::Windows::Foundation::ThreadingType& threading_model,
+        ResolvedClass& resolvedClass) noexcept;
+
+    HRESULT GetActivationFactory(
+        HSTRING className,
+        REFIID iid,
+        void** factory) noexcept;
+
     HRESULT GetActivationFactory(
+        const ResolvedClass& resolvedClass,
         HSTRING className,
         REFIID iid,
         void** factory) noexcept;
@@ -60,6 +60,31 @@ STDAPI MddAddPackageDependency(
 }
 CATCH_RETURN();
 
+STDAPI MddAddPackageDependencies(
+    UINT32 count,
+    _In_reads_(count) const MddAddPackageDependencyRequest* packageDependencies,
+    MddAddPackageDependenciesOptions options,
+    _Out_writes_(count) MddAddPackageDependencyResult* results) noexcept try
+{
+    RETURN_HR_IF(E_INVALIDARG, (count > 0) && (!packageDependencies || !results));
+    for (UINT32 index=0; index < count; ++index)
+    {
+        results[index] = MddAddPackageDependencyResult{};
+    }
+
+    // Dynamic Dependencies requires a non-packaged process
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED), AppModel::Identity::IsPackagedProcess());
+
+    for (UINT32 index=0; index < count; ++index)
+    {
+        const auto packageDependencyId{ packageDependencies[index].packageDependencyId };
+        RETURN_HR_IF(E_INVALIDARG, !packageDependencyId || (packageDependencyId[0] == L'\0'));
+    }
+
+    return MddCore::PackageGraphManager::AddToPackageGraph(count, packageDependencies, options, results);
+}
+CATCH_RETURN();
+
 STDAPI_(void) MddRemovePackageDependency(
     _In_ MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext) noexcept try
 {
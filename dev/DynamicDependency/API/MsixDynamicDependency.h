@@ -50,6 +50,15 @@ DEFINE_ENUM_FLAG_OPERATORS(MddAddPackageDependencyOptions)
 
 #define MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT 0
 
+enum class MddAddPackageDependenciesOptions : uint32_t
+{
+    None         = 0,
+
+    /// If any package dependency can't be added none are added.
+    AllOrNothing = 0x00000001,
+};
+DEFINE_ENUM_FLAG_OPERATORS(MddAddPackageDependenciesOptions)
+
 enum class MddPackageDependencyProcessorArchitectures : uint32_t
 {
     None       = 0,
@@ -64,6 +73,28 @@ DEFINE_ENUM_FLAG_OPERATORS(MddPackageDependencyProcessorArchitectures)
 
 DECLARE_HANDLE(MDD_PACKAGEDEPENDENCY_CONTEXT);
 
+/// A package dependency to add via MddAddPackageDependencies().
+/// The fields match MddAddPackageDependency()'s parameters.
+struct MddAddPackageDependencyRequest
+{
+    PCWSTR packageDependencyId;
+    INT32 rank;
+    MddAddPackageDependencyOptions options;
+};
+
+/// The result of adding a package dependency via MddAddPackageDependencies().
+struct MddAddPackageDependencyResult
+{
+    /// S_OK if the package dependency was added to the package graph, else the reason it wasn't.
+    HRESULT hr;
+
+    /// Valid until passed to MddRemovePackageDependency(). NULL if not added.
+    MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext;
+
+    /// Allocated via HeapAlloc; use HeapFree to deallocate. NULL if not added.
+    PWSTR packageFullName;
+};
+
 /// Define a package dependency. The criteria for a PackageDependency
 /// (package family name, minimum version, etc)
 /// may match multiple packages, but ensures Deployment won't remove
@@ -161,6 +192,28 @@ STDAPI MddAddPackageDependency(
     _Out_ MDD_PACKAGEDEPENDENCY_CONTEXT* packageDependencyContext,
     _Outptr_opt_result_maybenull_ PWSTR* packageFullName) noexcept;
 
+/// Resolve multiple previously pinned PackageDependencies and add them to the
+/// calling process' package graph as a single update.
+///
+/// This is the moral equivalent of calling MddAddPackageDependency() for each
+/// request, in order, except the package dependencies are resolved concurrently
+/// and the package graph (and DLL search order) is updated once, so the package
+/// graph's generation id only changes once.
+///
+/// Each request's outcome is reported in the corresponding result.
+///
+/// @param count the number of requests (and results)
+/// @param options MddAddPackageDependenciesOptions::AllOrNothing adds no package
+///                dependencies if any can't be added. In that case results for
+///                requests that could have been added have hr=HRESULT_FROM_WIN32(ERROR_CANCELLED).
+/// @return S_OK if all package dependencies were added, S_FALSE if some (but not all)
+///         were added, else the error of the first request that couldn't be added.
+STDAPI MddAddPackageDependencies(
+    UINT32 count,
+    _In_reads_(count) const MddAddPackageDependencyRequest* packageDependencies,
+    MddAddPackageDependenciesOptions options,
+    _Out_writes_(count) MddAddPackageDependencyResult* results) noexcept;
+
 /// Remove a resolved PackageDependency from the current process' package graph
 /// (i.e. undo MddAddPackageDependency). Used at runtime (i.e. the moral equivalent
 /// of Windows' RemoveDllDirectory()).
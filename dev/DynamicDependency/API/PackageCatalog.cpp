@@ -0,0 +1,109 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include "PackageCatalog.h"
+
+#include <wil/registry.h>
+
+struct MddCore::PackageCatalog::ChangeTracker
+{
+    wil::unique_hkey packagesKey;
+    wil::unique_registry_watcher_nothrow watcher;
+};
+
+MddCore::PackageCatalog& MddCore::PackageCatalog::Current()
+{
+    // Intentionally never destroyed. The registry watcher's callback uses the catalog and
+    // can run on a threadpool thread at any time, and static destruction runs under the
+    // loader lock where the watcher can't safely be stopped (waiting for its callbacks
+    // could deadlock)
+    static auto packageCatalog{ new MddCore::PackageCatalog() };
+    return *packageCatalog;
+}
+
+MddCore::PackageCatalog::PackageCatalog() :
+    m_changeTracker(std::make_unique<ChangeTracker>())
+{
+    // Package registrations for the user are recorded under this key. Any change there
+    // (package registered, removed, updated, ...) may change what's in the catalog
+    PCWSTR c_packageRepositoryKey{ L"Software\\Classes\\Local Settings\\Software\\Microsoft\\Windows\\CurrentVersion\\AppModel\\Repository\\Packages" };
+    const auto rc{ RegOpenKeyExW(HKEY_CURRENT_USER, c_packageRepositoryKey, 0, KEY_QUERY_VALUE, &m_changeTracker->packagesKey) };
+    LOG_IF_WIN32_ERROR_MSG(rc, "Unable to open the package repository; resolutions won't be cached");
+    if (rc == ERROR_SUCCESS)
+    {
+        m_changeTracker->watcher = wil::make_registry_watcher_nothrow(HKEY_CURRENT_USER, c_packageRepositoryKey, true, [&](wil::RegistryChangeKind)
+        {
+            ++m_changeId;
+        });
+        LOG_HR_IF_MSG(E_UNEXPECTED, !m_changeTracker->watcher, "Unable to watch the package repository; resolutions won't be cached");
+    }
+}
+
+MddCore::PackageCatalog::~PackageCatalog() = default;
+
+std::vector<std::wstring> MddCore::PackageCatalog::FindPackagesByFamily(const std::wstring& packageFamilyName)
+{
+    UINT32 count{};
+    UINT32 bufferLength{};
+    const LONG rc{ FindPackagesByPackageFamily(packageFamilyName.c_str(), PACKAGE_FILTER_HEAD | PACKAGE_FILTER_DIRECT, &count, nullptr, &bufferLength, nullptr, nullptr) };
+    if (rc == ERROR_SUCCESS)
+    {
+        // The package family has no packages registered to the user
+        return std::vector<std::wstring>();
+    }
+    else if (rc != ERROR_INSUFFICIENT_BUFFER)
+    {
+        THROW_WIN32(rc);
+    }
+
+    auto packageFullNames{ wil::make_unique_cotaskmem<PWSTR[]>(count) };
+    auto buffer{ wil::make_unique_cotaskmem<WCHAR[]>(bufferLength) };
+    THROW_IF_WIN32_ERROR(FindPackagesByPackageFamily(packageFamilyName.c_str(), PACKAGE_FILTER_HEAD | PACKAGE_FILTER_DIRECT, &count, packageFullNames.get(), &bufferLength, buffer.get(), nullptr));
+
+    std::vector<std::wstring> packageFullNamesList;
+    packageFullNamesList.reserve(count);
+    for (UINT32 index=0; index < count; ++index)
+    {
+        const auto packageFullName{ packageFullNames[index] };
+        packageFullNamesList.push_back(std::wstring(packageFullName));
+    }
+    return packageFullNamesList;
+}
+
+bool MddCore::PackageCatalog::IsPackageStatusOK(const std::wstring& packageFullName)
+{
+    winrt::Windows::Management::Deployment::PackageManager packageManager;
+    winrt::hstring currentUser;
+    auto package{ packageManager.FindPackageForUser(currentUser, packageFullName.c_str()) };
+    if (!package)
+    {
+        return false;
+    }
+    return package.Status().VerifyIsOK();
+}
+
+bool MddCore::PackageCatalog::IsTrackingChanges()
+{
+    return static_cast<bool>(m_changeTracker->watcher);
+}
+
+uint64_t MddCore::PackageCatalog::ChangeId()
+{
+    FAIL_FAST_HR_IF_MSG(E_UNEXPECTED, !IsTrackingChanges(), "ChangeId() without IsTrackingChanges()");
+
+    // Registering or removing a package adds or deletes a subkey, which updates the key's last
+    // write time right away; the watcher's notification arrives sometime later
+    FILETIME lastWriteTime{};
+    if (RegQueryInfoKeyW(m_changeTracker->packagesKey.get(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &lastWriteTime) == ERROR_SUCCESS)
+    {
+        const uint64_t packagesLastWriteTime{ (static_cast<uint64_t>(lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime };
+        auto previousLastWriteTime{ m_packagesLastWriteTime.load() };
+        if ((packagesLastWriteTime != previousLastWriteTime) && m_packagesLastWriteTime.compare_exchange_strong(previousLastWriteTime, packagesLastWriteTime))
+        {
+            ++m_changeId;
+        }
+    }
+    return m_changeId;
+}
@@ -0,0 +1,77 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PACKAGECATALOG_H)
+#define PACKAGECATALOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MddCore
+{
+/// The packages available to resolve package dependencies.
+///
+/// This header only depends on the C++ standard library so resolution (see PackageResolution.h)
+/// can be driven and tested with a fake catalog anywhere. The user's catalog is PackageCatalog.cpp.
+class IPackageCatalog
+{
+public:
+    virtual ~IPackageCatalog() = default;
+
+    /// Return the full names of the packages in the family registered for the user.
+    virtual std::vector<std::wstring> FindPackagesByFamily(const std::wstring& packageFamilyName) = 0;
+
+    /// Return true if the package is usable (i.e. its status is OK).
+    virtual bool IsPackageStatusOK(const std::wstring& packageFullName) = 0;
+
+    /// Return true if ChangeId() reflects changes to the catalog. If not, resolutions can't be cached.
+    virtual bool IsTrackingChanges() = 0;
+
+    /// Return a value that increases whenever the catalog's content may have changed.
+    /// Only meaningful if IsTrackingChanges().
+    virtual uint64_t ChangeId() = 0;
+};
+
+/// The user's package repository.
+///
+/// Changes are tracked two ways:
+///   * ChangeId() checks the last write time of the repository's Packages key, which changes
+///     synchronously when a package is registered or removed for the user (a subkey is added
+///     or deleted). So a resolution made right after an install or removal sees it.
+///   * A registry watcher on the whole repository catches other changes, e.g. a package's
+///     status. Its notifications are asynchronous so for a short time after such a change
+///     a cached resolution may still name a package that's since become unusable (just as
+///     an uncached resolution racing the change would).
+/// If the repository can't be watched, IsTrackingChanges() returns false and nothing is cached.
+/// Current() is never destroyed so the watcher lives (and stays safe to call back) for the life of the process.
+class PackageCatalog : public IPackageCatalog
+{
+public:
+    static PackageCatalog& Current();
+
+    std::vector<std::wstring> FindPackagesByFamily(const std::wstring& packageFamilyName) override;
+
+    bool IsPackageStatusOK(const std::wstring& packageFullName) override;
+
+    bool IsTrackingChanges() override;
+
+    uint64_t ChangeId() override;
+
+private:
+    PackageCatalog();
+
+    ~PackageCatalog();
+
+private:
+    struct ChangeTracker;
+
+    std::atomic<uint64_t> m_changeId{};
+    std::atomic<uint64_t> m_packagesLastWriteTime{};
+    std::unique_ptr<ChangeTracker> m_changeTracker;
+};
+}
+
+#endif // PACKAGECATALOG_H
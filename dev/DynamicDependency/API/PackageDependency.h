@@ -224,8 +224,6 @@ public:
         return m_packageFullName;
     }
 
-    std::vector<std::wstring> FindPackagesByFamily() const;
-
     bool IsArchitectureInArchitectures(const MddCore::Architecture architecture) const
     {
         const auto architectureAsArchitectures{ ToArchitectures(architecture) };
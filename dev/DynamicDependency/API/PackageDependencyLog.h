@@ -0,0 +1,228 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PACKAGEDEPENDENCYLOG_H)
+#define PACKAGEDEPENDENCYLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MddCore
+{
+/// The contents of a PackageDependencyStore's log: the record format, and the live package
+/// dependencies replayed from it. PackageDependencyStore does the file I/O.
+///
+/// The log's a sequence of records. Each record sets (or deletes) a package dependency's
+/// definition (JSON, UTF-8). The latest record for an id wins. Every record carries its size
+/// and a checksum so a partially written record at the end of the log is left for later.
+///
+/// @note Not thread safe. PackageDependencyStore serializes access.
+class PackageDependencyLog
+{
+public:
+    enum class RecordType : uint8_t
+    {
+        Save = 1,
+        Delete = 2,
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        RecordType type;
+        uint8_t reserved[3];
+        uint32_t idSize;        // bytes
+        uint32_t jsonSize;      // bytes
+        uint32_t checksum;      // FNV-1a of id + json
+    };
+
+    static constexpr uint32_t c_recordMagic{ 0x3152444D };  // 'MDR1'
+
+    // Compact when the log's at least this big and more than half of it's dead records
+    static constexpr uint64_t c_compactThreshold{ 64 * 1024 };
+
+    /// Ids are case insensitive. Returns the key for an id (e.g. uppercased).
+    using ToKeyFunction = std::wstring (*)(const std::wstring& packageDependencyId);
+
+    PackageDependencyLog(ToKeyFunction toKey) :
+        m_toKey(toKey)
+    {
+    }
+
+    static std::vector<uint8_t> MakeRecord(RecordType type, const std::wstring& id, const std::string& json)
+    {
+        RecordHeader header{};
+        header.magic = c_recordMagic;
+        header.type = type;
+        header.idSize = static_cast<uint32_t>(id.length() * sizeof(wchar_t));
+        header.jsonSize = static_cast<uint32_t>(json.length());
+        header.checksum = Checksum(reinterpret_cast<const uint8_t*>(id.c_str()), header.idSize);
+        header.checksum = Checksum(reinterpret_cast<const uint8_t*>(json.c_str()), header.jsonSize, header.checksum);
+
+        std::vector<uint8_t> record(sizeof(header) + header.idSize + header.jsonSize);
+        std::memcpy(record.data(), &header, sizeof(header));
+        std::memcpy(record.data() + sizeof(header), id.c_str(), header.idSize);
+        std::memcpy(record.data() + sizeof(header) + header.idSize, json.c_str(), header.jsonSize);
+        return record;
+    }
+
+    /// Return the package dependency's definition, or nullptr if not found.
+    const std::string* Find(const std::wstring& packageDependencyId) const
+    {
+        const auto iterator{ m_packageDependencies.find(m_toKey(packageDependencyId)) };
+        return iterator != m_packageDependencies.end() ? &iterator->second : nullptr;
+    }
+
+    size_t Count() const
+    {
+        return m_packageDependencies.size();
+    }
+
+    /// Bytes of the log replayed so far.
+    uint64_t Offset() const
+    {
+        return m_offset;
+    }
+
+    /// Bytes of the log replayed so far holding live records.
+    uint64_t LiveSize() const
+    {
+        return m_liveSize;
+    }
+
+    /// Forget everything e.g. the log was replaced.
+    void Reset()
+    {
+        m_packageDependencies.clear();
+        m_offset = 0;
+        m_liveSize = 0;
+    }
+
+    /// Replay the log's next bytes (starting at Offset()). Stops at an incomplete record, which
+    /// is replayed once the rest of it is passed in (i.e. from Offset() on).
+    ///
+    /// @param onInvalidRecord `void(uint64_t offset, bool isRecoverable)` called for a record
+    ///                        that fails its checksum (skipped) or isn't a record at all (we
+    ///                        can't find our way past it so replay stops there).
+    /// @return the number of bytes replayed.
+    template <typename OnInvalidRecord>
+    size_t Replay(const uint8_t* data, size_t size, OnInvalidRecord&& onInvalidRecord)
+    {
+        size_t used{};
+        while (size - used >= sizeof(RecordHeader))
+        {
+            RecordHeader header{};
+            std::memcpy(&header, data + used, sizeof(header));
+            if (header.magic != c_recordMagic)
+            {
+                onInvalidRecord(m_offset + used, false);
+                break;
+            }
+            const size_t recordSize{ sizeof(header) + static_cast<size_t>(header.idSize) + header.jsonSize };
+            if (size - used < recordSize)
+            {
+                // Incomplete. Someone's still writing it
+                break;
+            }
+
+            const uint8_t* id{ data + used + sizeof(header) };
+            const uint8_t* json{ id + header.idSize };
+            const auto checksum{ Checksum(json, header.jsonSize, Checksum(id, header.idSize)) };
+            if ((checksum == header.checksum) && ((header.idSize % sizeof(wchar_t)) == 0))
+            {
+                std::wstring idString(header.idSize / sizeof(wchar_t), L'\0');
+                std::memcpy(idString.data(), id, header.idSize);
+                auto key{ m_toKey(idString) };
+                auto iterator{ m_packageDependencies.find(key) };
+                if (iterator != m_packageDependencies.end())
+                {
+                    // Superseded
+                    m_liveSize -= sizeof(header) + key.length() * sizeof(wchar_t) + iterator->second.length();
+                    m_packageDependencies.erase(iterator);
+                }
+                if (header.type == RecordType::Save)
+                {
+                    m_packageDependencies.emplace(std::move(key), std::string(reinterpret_cast<const char*>(json), header.jsonSize));
+                    m_liveSize += recordSize;
+                }
+            }
+            else
+            {
+                onInvalidRecord(m_offset + used, true);
+            }
+            used += recordSize;
+        }
+        m_offset += used;
+        return used;
+    }
+
+    /// Return true if the log's worth compacting.
+    bool IsCompactable() const
+    {
+        const auto deadSize{ m_offset - m_liveSize };
+        return (m_offset >= c_compactThreshold) && (deadSize > m_liveSize);
+    }
+
+    /// Return a log holding only the live records.
+    std::vector<uint8_t> Compact() const
+    {
+        std::vector<uint8_t> data;
+        for (const auto& [key, json] : m_packageDependencies)
+        {
+            const auto record{ MakeRecord(RecordType::Save, key, json) };
+            data.insert(data.end(), record.begin(), record.end());
+        }
+        return data;
+    }
+
+private:
+    static uint32_t Checksum(const uint8_t* data, size_t size, uint32_t hash = 2166136261u)
+    {
+        for (size_t index=0; index < size; ++index)
+        {
+            hash = (hash ^ data[index]) * 16777619u;
+        }
+        return hash;
+    }
+
+private:
+    ToKeyFunction m_toKey{};
+
+    // Live package dependencies: key -> json
+    std::unordered_map<std::wstring, std::string> m_packageDependencies;
+
+    uint64_t m_offset{};
+    uint64_t m_liveSize{};
+};
+
+/// Return a package dependency's definition from the store, else from its legacy file (package
+/// dependencies used to be saved one per file, <id>.mdd) moving it into the store.
+///
+/// The legacy file's only deleted once the store has its definition. If saving fails the
+/// definition's still returned and the migration's retried next time.
+///
+/// @param store `std::string Find(id)` and `bool TrySave(id, json)`.
+/// @param legacyFiles `std::string Load(id)` (empty if not found) and `void Delete(id)`.
+template <typename Store, typename LegacyFiles>
+std::string LoadAndMigrate(Store& store, LegacyFiles& legacyFiles, const std::wstring& packageDependencyId)
+{
+    auto json{ store.Find(packageDependencyId) };
+    if (!json.empty())
+    {
+        return json;
+    }
+
+    json = legacyFiles.Load(packageDependencyId);
+    if (!json.empty() && store.TrySave(packageDependencyId, json))
+    {
+        legacyFiles.Delete(packageDependencyId);
+    }
+    return json;
+}
+}
+
+#endif // PACKAGEDEPENDENCYLOG_H
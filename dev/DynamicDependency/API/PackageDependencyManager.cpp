@@ -9,7 +9,17 @@
 #include "PackageGraph.h"
 
 static std::recursive_mutex g_lock;
-std::vector<MddCore::PackageDependency> g_packageDependencies;
+
+// Package dependencies in memory: uppercase id -> package dependency
+// NOTE: Ids are case insensitive. Node-based so pointers to values stay valid as others come and go
+std::unordered_map<std::wstring, MddCore::PackageDependency> g_packageDependencies;
+
+static std::wstring ToPackageDependencyKey(PCWSTR packageDependencyId)
+{
+    std::wstring key{ packageDependencyId };
+    CharUpperBuffW(key.data(), static_cast<DWORD>(key.length()));
+    return key;
+}
 
 bool MddCore::PackageDependencyManager::ExistsPackageDependency(
     PSID user,
@@ -56,7 +66,7 @@ void MddCore::PackageDependencyManager::CreatePackageDependency(
 
     auto lock{ std::unique_lock<std::recursive_mutex>(g_lock) };
 
-    g_packageDependencies.push_back(packageDependency);
+    g_packageDependencies.insert_or_assign(ToPackageDependencyKey(packageDependency.Id().c_str()), packageDependency);
 
     auto id{ wil::make_process_heap_string(packageDependency.Id().c_str()) };
     *packageDependencyId = id.release();
@@ -83,19 +93,24 @@ void MddCore::PackageDependencyManager::DeletePackageDependency(
 
     auto lock{ std::unique_lock<std::recursive_mutex>(g_lock) };
 
-    for (size_t index=0; index < g_packageDependencies.size(); ++index)
-    {
-        const auto& packageDependency{ g_packageDependencies[index] };
-        if (CompareStringOrdinal(packageDependency.Id().c_str(), -1, packageDependencyId, -1, TRUE) == CSTR_EQUAL)
-        {
-            g_packageDependencies.erase(g_packageDependencies.begin() + index);
-            break;
-        }
-    }
+    g_packageDependencies.erase(ToPackageDependencyKey(packageDependencyId));
 
     MddCore::DataStore::Delete(packageDependencyId);
 }
 
+MddCore::PackageDependency MddCore::PackageDependencyManager::CopyPackageDependency(
+    _In_ PCWSTR packageDependencyId)
+{
+    auto lock{ std::unique_lock<std::recursive_mutex>(g_lock) };
+
+    auto packageDependency{ GetPackageDependency(packageDependencyId) };
+    if (!packageDependency)
+    {
+        return MddCore::PackageDependency();
+    }
+    return *packageDependency;
+}
+
 const MddCore::PackageDependency* MddCore::PackageDependencyManager::GetPackageDependency(
     _In_ PCWSTR packageDependencyId)
 {
@@ -112,18 +127,15 @@ const MddCore::PackageDependency* MddCore::PackageDependencyManager::GetPackageD
     _In_ PCWSTR packageDependencyId)
 {
     // Check the in-memory list
-    for (size_t index=0; index < g_packageDependencies.size(); ++index)
+    auto iterator{ g_packageDependencies.find(ToPackageDependencyKey(packageDependencyId)) };
+    if (iterator == g_packageDependencies.end())
     {
-        const auto& packageDependency{ g_packageDependencies[index] };
-        if (CompareStringOrdinal(packageDependency.Id().c_str(), -1, packageDependencyId, -1, TRUE) == CSTR_EQUAL)
-        {
-            // Gotcha!
-            return &packageDependency;
-        }
+        // Not found
+        return nullptr;
     }
 
-    // Not found
-    return nullptr;
+    // Gotcha!
+    return &iterator->second;
 }
 
 /// @warning This method assumes \c packageDependencyId is not in the in-memory list
@@ -147,10 +159,10 @@ const MddCore::PackageDependency* MddCore::PackageDependencyManager::GetPackageD
     }
 
     // Add it to the in-memory list
-    g_packageDependencies.push_back(packageDependency);
+    auto inserted{ g_packageDependencies.insert_or_assign(ToPackageDependencyKey(packageDependencyId), std::move(packageDependency)) };
 
     // Gotcha!
-    return &g_packageDependencies.back();
+    return &inserted.first->second;
 }
 
 void MddCore::PackageDependencyManager::Verify(
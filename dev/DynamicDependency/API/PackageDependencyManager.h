@@ -37,6 +37,10 @@ public:
     static void DeletePackageDependency(
         _In_ PCWSTR packageDependencyId);
 
+    /// Return a copy of the package dependency, or an empty one (!packageDependency) if not found.
+    static MddCore::PackageDependency CopyPackageDependency(
+        _In_ PCWSTR packageDependencyId);
+
 public:
     /// @warning Unlocked data access. Caller's responsible for thread safety.
     static const PackageDependency* GetPackageDependency(
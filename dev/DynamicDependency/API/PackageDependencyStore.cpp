@@ -0,0 +1,194 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include "PackageDependencyStore.h"
+
+std::string MddCore::PackageDependencyStore::Find(PCWSTR packageDependencyId)
+{
+    auto lock{ std::unique_lock<std::mutex>(m_lock) };
+
+    // Catch up with anything appended since we last looked (by us or anyone else)
+    Refresh();
+
+    const auto json{ m_log.Find(packageDependencyId) };
+    return json ? *json : std::string();
+}
+
+void MddCore::PackageDependencyStore::Save(PCWSTR packageDependencyId, const std::string& json)
+{
+    auto lock{ std::unique_lock<std::mutex>(m_lock) };
+
+    Append(PackageDependencyLog::RecordType::Save, packageDependencyId, json);
+    CompactIfNecessary();
+}
+
+bool MddCore::PackageDependencyStore::Delete(PCWSTR packageDependencyId)
+{
+    auto lock{ std::unique_lock<std::mutex>(m_lock) };
+
+    Refresh();
+    if (!m_log.Find(packageDependencyId))
+    {
+        return false;
+    }
+
+    Append(PackageDependencyLog::RecordType::Delete, packageDependencyId, std::string());
+    CompactIfNecessary();
+    return true;
+}
+
+std::wstring MddCore::PackageDependencyStore::ToKey(const std::wstring& packageDependencyId)
+{
+    // Ids are case insensitive
+    std::wstring key{ packageDependencyId };
+    CharUpperBuffW(key.data(), static_cast<DWORD>(key.length()));
+    return key;
+}
+
+void MddCore::PackageDependencyStore::Refresh()
+{
+    wil::unique_hfile file{ ::CreateFileW(m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+    if (!file)
+    {
+        const auto lastError{ GetLastError() };
+        if ((lastError == ERROR_FILE_NOT_FOUND) || (lastError == ERROR_PATH_NOT_FOUND))
+        {
+            // No log = no package dependencies
+            m_log.Reset();
+            m_fileId = {};
+            return;
+        }
+        THROW_WIN32_MSG(lastError, "Error %d opening file %ls", lastError, m_filename.c_str());
+    }
+
+    // If the log was replaced (compacted) since we last looked start over
+    FILE_ID_INFO fileId{};
+    THROW_IF_WIN32_BOOL_FALSE(GetFileInformationByHandleEx(file.get(), FileIdInfo, &fileId, sizeof(fileId)));
+    LARGE_INTEGER fileSize{};
+    THROW_IF_WIN32_BOOL_FALSE(::GetFileSizeEx(file.get(), &fileSize));
+    if ((memcmp(&fileId, &m_fileId, sizeof(fileId)) != 0) || (static_cast<uint64_t>(fileSize.QuadPart) < m_log.Offset()))
+    {
+        m_log.Reset();
+        m_fileId = fileId;
+    }
+
+    Load(file.get(), static_cast<uint64_t>(fileSize.QuadPart));
+}
+
+void MddCore::PackageDependencyStore::Load(HANDLE file, uint64_t fileSize)
+{
+    if (fileSize <= m_log.Offset())
+    {
+        // Nothing new
+        return;
+    }
+    const auto size{ fileSize - m_log.Offset() };
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE), size > INT32_MAX);
+
+    LARGE_INTEGER offset{};
+    offset.QuadPart = static_cast<LONGLONG>(m_log.Offset());
+    THROW_IF_WIN32_BOOL_FALSE(SetFilePointerEx(file, offset, nullptr, FILE_BEGIN));
+    std::unique_ptr<BYTE[]> buffer{ std::make_unique<BYTE[]>(static_cast<size_t>(size)) };
+    DWORD bytesRead{};
+    THROW_IF_WIN32_BOOL_FALSE(::ReadFile(file, buffer.get(), static_cast<DWORD>(size), &bytesRead, nullptr));
+
+    m_log.Replay(buffer.get(), bytesRead, [&](uint64_t recordOffset, bool isRecoverable) {
+        // A corrupt record is skipped. Anything else isn't a record and we can't find our way past it
+        LOG_HR_MSG(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), "%hs %ls @ %llu", isRecoverable ? "Corrupt record" : "Not a record", m_filename.c_str(), recordOffset);
+    });
+}
+
+void MddCore::PackageDependencyStore::Append(PackageDependencyLog::RecordType type, const std::wstring& id, const std::string& json)
+{
+    const auto record{ PackageDependencyLog::MakeRecord(type, id, json) };
+
+    std::filesystem::create_directories(m_filename.parent_path());
+
+    // FILE_APPEND_DATA (without FILE_WRITE_DATA) makes every write an atomic append,
+    // even when multiple processes are writing to the log at the same time.
+    // Compaction holds the log without FILE_SHARE_WRITE so retry (briefly) if we collide with it.
+    wil::unique_hfile file;
+    for (int attempt=0; ; ++attempt)
+    {
+        file.reset(::CreateFileW(m_filename.c_str(), FILE_APPEND_DATA | SYNCHRONIZE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (file)
+        {
+            break;
+        }
+        const auto lastError{ GetLastError() };
+        if ((lastError != ERROR_SHARING_VIOLATION) || (attempt >= 10))
+        {
+            THROW_WIN32_MSG(lastError, "Error %d opening file %ls", lastError, m_filename.c_str());
+        }
+        Sleep(10);
+    }
+
+    DWORD bytesWritten{};
+    THROW_IF_WIN32_BOOL_FALSE_MSG(::WriteFile(file.get(), record.data(), static_cast<DWORD>(record.size()), &bytesWritten, nullptr), "%ls", m_filename.c_str());
+    THROW_HR_IF_MSG(HRESULT_FROM_WIN32(ERROR_WRITE_FAULT), bytesWritten != record.size(), "Wrote %lu of %zu bytes to %ls", bytesWritten, record.size(), m_filename.c_str());
+    file.reset();
+
+    // Pick up our record (and anyone else's)
+    Refresh();
+}
+
+void MddCore::PackageDependencyStore::CompactIfNecessary()
+{
+    if (!m_log.IsCompactable())
+    {
+        return;
+    }
+
+    try
+    {
+        // Hold the log so no one can append to it while we compact it. If someone has it open
+        // for writing we'll leave it to them (or the next delete) to try again
+        wil::unique_hfile file{ ::CreateFileW(m_filename.c_str(), GENERIC_READ | DELETE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+        if (!file)
+        {
+            return;
+        }
+
+        // Make sure we have everything
+        LARGE_INTEGER fileSize{};
+        THROW_IF_WIN32_BOOL_FALSE(::GetFileSizeEx(file.get(), &fileSize));
+        Load(file.get(), static_cast<uint64_t>(fileSize.QuadPart));
+
+        auto temporaryFilename{ m_filename };
+        temporaryFilename += L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+        {
+            const auto data{ m_log.Compact() };
+
+            wil::unique_hfile temporaryFile{ ::CreateFileW(temporaryFilename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+            if (!temporaryFile)
+            {
+                THROW_LAST_ERROR_MSG("%ls", temporaryFilename.c_str());
+            }
+            auto deleteTemporaryFile{ wil::scope_exit([&]() {
+                temporaryFile.reset();
+                ::DeleteFileW(temporaryFilename.c_str());
+            }) };
+            DWORD bytesWritten{};
+            THROW_IF_WIN32_BOOL_FALSE_MSG(::WriteFile(temporaryFile.get(), data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr), "%ls", temporaryFilename.c_str());
+            THROW_HR_IF_MSG(HRESULT_FROM_WIN32(ERROR_WRITE_FAULT), bytesWritten != data.size(), "Wrote %lu of %zu bytes to %ls", bytesWritten, data.size(), temporaryFilename.c_str());
+
+            // The rename must not reach the disk before the data it points at, or a crash
+            // could leave an empty or truncated log in place of the old one
+            THROW_IF_WIN32_BOOL_FALSE_MSG(::FlushFileBuffers(temporaryFile.get()), "%ls", temporaryFilename.c_str());
+            deleteTemporaryFile.release();
+        }
+        if (!::MoveFileExW(temporaryFilename.c_str(), m_filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            const auto lastError{ GetLastError() };
+            ::DeleteFileW(temporaryFilename.c_str());
+            THROW_WIN32_MSG(lastError, "Error %d replacing %ls", lastError, m_filename.c_str());
+        }
+        file.reset();
+
+        // Switch to the compacted log
+        Refresh();
+    }
+    CATCH_LOG();
+}
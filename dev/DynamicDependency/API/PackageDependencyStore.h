@@ -0,0 +1,62 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "PackageDependencyLog.h"
+
+namespace MddCore
+{
+/// All the package dependencies in a data store (user or system), in a single file.
+///
+/// The file's an append-only log of records (see PackageDependencyLog). We read the log once and
+/// keep the live definitions in a hash map keyed by id, reading only what's been appended (by this
+/// or any other process) since the last time we looked. A partially written record at the end of
+/// the log (e.g. another process is in the middle of appending it) is ignored until it's complete.
+///
+/// When the log's mostly dead records it's compacted: the live records are written to a new file
+/// which atomically replaces the log. Processes notice the log was replaced and reload it.
+///
+/// @note Methods are thread safe.
+class PackageDependencyStore
+{
+public:
+    PackageDependencyStore(const std::filesystem::path& filename) :
+        m_filename(filename),
+        m_log(&ToKey)
+    {
+    }
+
+    ~PackageDependencyStore() = default;
+
+    /// Return the package dependency's definition (JSON, UTF-8) or an empty string if not found.
+    std::string Find(PCWSTR packageDependencyId);
+
+    void Save(PCWSTR packageDependencyId, const std::string& json);
+
+    /// Return true if the package dependency was found (and deleted).
+    bool Delete(PCWSTR packageDependencyId);
+
+    /// Return the key for a package dependency id (ids are case insensitive).
+    static std::wstring ToKey(const std::wstring& packageDependencyId);
+
+private:
+    void Refresh();
+
+    void Load(HANDLE file, uint64_t fileSize);
+
+    void Append(PackageDependencyLog::RecordType type, const std::wstring& id, const std::string& json);
+
+    void CompactIfNecessary();
+
+private:
+    std::mutex m_lock;
+    std::filesystem::path m_filename;
+
+    // Live package dependencies (keyed by uppercase id) and how much of the log we've read
+    PackageDependencyLog m_log;
+
+    // The log file we've read
+    FILE_ID_INFO m_fileId{};
+};
+}
@@ -8,9 +8,14 @@
 #include "PackageGraphNode.h"
 #include "PackageDependencyManager.h"
 #include "PackageId.h"
+#include "PackageResolution.h"
+#include "PackageResolutionCache.h"
 #include "WinRTModuleManager.h"
 
-#include <wil/win32_helpers.h>
+namespace MddCore
+{
+static MddCore::PackageResolutionCache g_packageResolutionCache;
+}
 
 HRESULT MddCore::PackageGraph::Add(
     _In_ PCWSTR packageDependencyId,
@@ -19,39 +24,58 @@ HRESULT MddCore::PackageGraph::Add(
     MDD_PACKAGEDEPENDENCY_CONTEXT& packageDependencyContext,
     _Outptr_opt_result_maybenull_ PWSTR* packageFullName)
 {
-    wil::unique_process_heap_string fullName;
-    RETURN_IF_FAILED(ResolvePackageDependency(packageDependencyId, options, fullName));
+    PreparedPackageDependency prepared;
+    RETURN_IF_FAILED(Prepare(packageDependencyId, rank, options, prepared));
+
+    MddCore::ProcessPathEnvironment path;
     MDD_PACKAGEDEPENDENCY_CONTEXT context{};
-    RETURN_IF_FAILED(Add(fullName.get(), rank, options, packageDependencyId, context));
+    RETURN_IF_FAILED(Add(prepared, path, context));
 
     packageDependencyContext = std::move(context);
     if (packageFullName)
     {
-        *packageFullName = fullName.release();
+        *packageFullName = prepared.packageFullName.release();
     }
     return S_OK;
 }
 
-HRESULT MddCore::PackageGraph::Add(
-    _In_ PCWSTR packageFullName,
+HRESULT MddCore::PackageGraph::Prepare(
+    _In_ PCWSTR packageDependencyId,
     INT32 rank,
     MddAddPackageDependencyOptions options,
-    _In_ PCWSTR packageDependencyId,
-    MDD_PACKAGEDEPENDENCY_CONTEXT& context)
+    PreparedPackageDependency& prepared) noexcept try
 {
+    RETURN_IF_FAILED(ResolvePackageDependency(packageDependencyId, options, prepared.packageFullName));
+
     // Load the package's information
-    PackageGraphNode packageGraphNode(packageFullName, rank, packageDependencyId);
-    packageGraphNode.GenerateContext();
+    prepared.packageGraphNode = std::make_shared<PackageGraphNode>(prepared.packageFullName.get(), rank, packageDependencyId);
+    prepared.packageGraphNode->GenerateContext();
 
     // Load the WinRT definitions (if any)
-    std::shared_ptr<MddCore::WinRTPackage> winrtPackage{ packageGraphNode.CreateWinRTPackage() };
-    winrtPackage->ParseAppxManifest();
+    prepared.winrtPackage = prepared.packageGraphNode->CreateWinRTPackage();
+    prepared.winrtPackage->ParseAppxManifest();
+
+    prepared.rank = rank;
+    prepared.options = options;
+    return S_OK;
+}
+CATCH_RETURN();
+
+HRESULT MddCore::PackageGraph::Add(
+    PreparedPackageDependency& prepared,
+    MddCore::IPathEnvironment& path,
+    MDD_PACKAGEDEPENDENCY_CONTEXT& context)
+{
+    const auto rank{ prepared.rank };
+    const auto options{ prepared.options };
+    auto packageGraphNode{ std::move(prepared.packageGraphNode) };
+    auto winrtPackage{ std::move(prepared.winrtPackage) };
 
     // Find the insertion point where to add the new package graph node to the package graph
     size_t index{};
     for (; index < m_packageGraphNodes.size(); ++index)
     {
-        auto& node{ m_packageGraphNodes[index] };
+        const auto& node{ *m_packageGraphNodes[index] };
         if (node.Rank() < rank)
         {
             // Too soon. Keep looking
@@ -76,7 +100,7 @@ HRESULT MddCore::PackageGraph::Add(
                 // Append to items of this rank
                 for (size_t nextIndex=index+1; nextIndex < m_packageGraphNodes.size(); ++nextIndex)
                 {
-                    auto& nextNode{ m_packageGraphNodes[nextIndex] };
+                    const auto& nextNode{ *m_packageGraphNodes[nextIndex] };
                     if (nextNode.Rank() > rank)
                     {
                         // Gotcha!
@@ -102,8 +126,8 @@ HRESULT MddCore::PackageGraph::Add(
     winrtPackage.reset();
 
     // The DLL Search Order must be updated when we update the package graph
-    auto& node{ m_packageGraphNodes[index] };
-    AddToDllSearchOrder(node);
+    auto& node{ *m_packageGraphNodes[index] };
+    AddToDllSearchOrder(index, node, path);
 
     context = node.Context();
     return S_OK;
@@ -116,12 +140,11 @@ HRESULT MddCore::PackageGraph::ResolvePackageDependency(
 {
     packageFullName.reset();
 
-    // Get the package dependency
-    auto foundPackageDependency{ MddCore::PackageDependencyManager::GetPackageDependency(packageDependencyId) };
-    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), !foundPackageDependency);
+    // Get the package dependency. We may be resolving several at once (see Prepare()) so work from a copy
+    const auto packageDependency{ MddCore::PackageDependencyManager::CopyPackageDependency(packageDependencyId) };
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), !packageDependency);
 
     // Is the package dependency already resolved?
-    const auto& packageDependency{ *foundPackageDependency };
     if (!packageDependency.PackageFullName().empty())
     {
         packageFullName = wil::make_process_heap_string(packageDependency.PackageFullName().c_str());
@@ -138,18 +161,69 @@ HRESULT MddCore::PackageGraph::ResolvePackageDependency(
     MddAddPackageDependencyOptions /*options*/,
     wil::unique_process_heap_string& packageFullName)
 {
-    // Determine the packages in the family
-    const auto foundPackageFullNames{ packageDependency.FindPackagesByFamily() };
+    // Have we resolved this before (and the catalog hasn't changed since)?
+    auto bestFit{ MddCore::PackageResolution::Resolve(MddCore::PackageCatalog::Current(), MddCore::g_packageResolutionCache,
+                                                      packageDependency.PackageFamilyName(), packageDependency.MinVersion().Version,
+                                                      static_cast<uint32_t>(packageDependency.Architectures()), MakeFindBestFit(packageDependency)) };
+
+    // Did we fail to find a match?
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), bestFit.empty());
+
+    // We have a winner!
+    packageFullName = std::move(wil::make_process_heap_string(bestFit.c_str()));
+    return S_OK;
+}
+
+std::wstring MddCore::PackageGraph::ResolvePackageDependency(
+    MddCore::IPackageCatalog& packageCatalog,
+    const MddCore::PackageDependency& packageDependency)
+{
+    auto bestFit{ MddCore::PackageResolution::Resolve(packageCatalog, packageDependency.PackageFamilyName(), MakeFindBestFit(packageDependency)) };
+
+    // Did we fail to find a match?
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), bestFit.empty());
+    return bestFit;
+}
 
-    // Find the best fit package in the family (if any)
-    MddCore::PackageId bestFit;
-    winrt::Windows::Management::Deployment::PackageManager packageManager;
-    for (const auto& candidatePackageFullName : foundPackageFullNames)
+std::function<size_t(const std::vector<std::wstring>&, const std::vector<bool>&)> MddCore::PackageGraph::MakeFindBestFit(
+    const MddCore::PackageDependency& packageDependency)
+{
+    // Package ids are parsed the first time they're needed and kept for any retries
+    auto candidates{ std::make_shared<std::vector<MddCore::PackageId>>() };
+    return [&packageDependency, candidates](const std::vector<std::wstring>& packageFullNames, const std::vector<bool>& excluded)
     {
-        auto candidate{ MddCore::PackageId::FromPackageFullName(candidatePackageFullName.c_str()) };
+        if (candidates->empty())
+        {
+            candidates->reserve(packageFullNames.size());
+            for (const auto& packageFullName : packageFullNames)
+            {
+                candidates->push_back(MddCore::PackageId::FromPackageFullName(packageFullName.c_str()));
+            }
+        }
+
+        size_t bestFitIndex{ packageFullNames.size() };
+        (void)FindBestFit(packageDependency, *candidates, excluded, bestFitIndex);
+        return bestFitIndex;
+    };
+}
+
+std::wstring MddCore::PackageGraph::FindBestFit(
+    const MddCore::PackageDependency& packageDependency,
+    const std::vector<MddCore::PackageId>& candidates,
+    const std::vector<bool>& excluded,
+    size_t& bestFitIndex)
+{
+    const MddCore::PackageId* bestFit{};
+    for (size_t index=0; index < candidates.size(); ++index)
+    {
+        if (excluded[index])
+        {
+            continue;
+        }
+        const auto& candidate{ candidates[index] };
 
         // Do we already have a higher version under consideration?
-        if (bestFit && (bestFit.Version().Version > candidate.Version().Version))
+        if (bestFit && (bestFit->Version().Version > candidate.Version().Version))
         {
             continue;
         }
@@ -163,7 +237,7 @@ HRESULT MddCore::PackageGraph::ResolvePackageDependency(
         // Package architecture must meet the architecture filter
         if (packageDependency.Architectures() == MddPackageDependencyProcessorArchitectures::None)
         {
-            if (!IsPackageABetterFitPerArchitecture(bestFit, candidate))
+            if (!IsPackageABetterFitPerArchitecture(bestFit ? *bestFit : MddCore::PackageId(), candidate))
             {
                 continue;
             }
@@ -176,58 +250,36 @@ HRESULT MddCore::PackageGraph::ResolvePackageDependency(
             }
         }
 
-        // Package status must be OK to use a package
-        winrt::hstring currentUser;
-        auto package{ packageManager.FindPackageForUser(currentUser, candidate.PackageFullName()) };
-        auto status{ package.Status() };
-        if (!status.VerifyIsOK())
-        {
-            continue;
-        }
-
         // The new candidate is better than the current champion
-        bestFit = std::move(candidate);
+        bestFit = &candidate;
+        bestFitIndex = index;
     }
-
-    // Did we fail to find a match?
-    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), bestFit.PackageFullName().empty());
-
-    // We have a winner!
-    packageFullName = std::move(wil::make_process_heap_string(bestFit.PackageFullName().c_str()));
-    return S_OK;
+    return bestFit ? bestFit->PackageFullName() : std::wstring();
 }
 
 HRESULT MddCore::PackageGraph::Remove(
     MDD_PACKAGEDEPENDENCY_CONTEXT context)
+{
+    MddCore::ProcessPathEnvironment path;
+    return Remove(context, path);
+}
+
+HRESULT MddCore::PackageGraph::Remove(
+    MDD_PACKAGEDEPENDENCY_CONTEXT context,
+    MddCore::IPathEnvironment& path)
 {
     for (size_t index=0; index < m_packageGraphNodes.size(); ++index)
     {
-        auto& node{ m_packageGraphNodes[index] };
+        const auto& node{ *m_packageGraphNodes[index] };
         if (node.Context() == context)
         {
             // Detach the node from the package graph before updating the DLL Search Order
-            auto detachedNode{ std::move(node) };
+            auto detachedNode{ std::move(m_packageGraphNodes[index]) };
             m_packageGraphNodes.erase(m_packageGraphNodes.begin() + index);
 
             // The DLL Search Order must be updated when we update the package graph
-            RemoveFromDllSearchOrder(detachedNode);
-
-            return S_OK;
-        }
-    }
-    RETURN_WIN32(ERROR_INVALID_HANDLE);
-}
+            RemoveFromDllSearchOrder(index, *detachedNode, path);
 
-HRESULT MddCore::PackageGraph::GetPackageDependencyForContext(
-    _In_ MDD_PACKAGEDEPENDENCY_CONTEXT context,
-    wil::unique_process_heap_string& packageDependencyId)
-{
-    for (size_t index=0; index < m_packageGraphNodes.size(); ++index)
-    {
-        auto& node{ m_packageGraphNodes[index] };
-        if (node.Context() == context)
-        {
-            packageDependencyId = wil::make_process_heap_string(node.Id().c_str());
             return S_OK;
         }
     }
@@ -264,133 +316,20 @@ bool MddCore::PackageGraph::IsPackageABetterFitPerArchitecture(
     return true;
 }
 
-void MddCore::PackageGraph::AddToDllSearchOrder(PackageGraphNode& package)
+void MddCore::PackageGraph::AddToDllSearchOrder(size_t index, PackageGraphNode& package, MddCore::IPathEnvironment& path)
 {
     // Update the PATH environment variable
-    UpdatePath();
+    m_pathList.Insert(index, package.PathList(), path);
 
     // Update the AddDllDirectory list
     package.AddDllDirectories();
 }
 
-void MddCore::PackageGraph::UpdatePath()
-{
-    // PATH is mutable by anyone in the process, at any time.
-    // We can't even guarantee our pathlist is unchanged over the life
-    // of the process. Others could have altered part of out PATH addition.
-    // Unfortunately it's not only possible to dynamically add the same
-    // package to the package graph, there are desirable scenarios for it
-    // (e.g. plugin type scenarios).
-    //
-    // As a pratical matter, we'll follow this algorithm:
-    //
-    //      Remove our previous addition to PATH (if present)
-    //      Prepend our new pathlist to PATH
-    //
-    // We'll assume for 'removal' our previous pathlist is an unmodified
-    // block and if not, we won't try to micromanage removing it piecemeal.
-    // If it's not an unmodified block the app's done something unexpected
-    // and we can't reliably predict exactly what's up or how to respond.
-
-    // Build the package graph path list (semi-colon delimited)
-    std::wstring pathList{ BuildPathList() };
-
-    // Build the new PATH
-    std::wstring newPath;
-
-    // Get the current PATH environment variable
-    auto pathEnvironmentVariable{ wil::TryGetEnvironmentVariableW(L"PATH") };
-    std::wstring path{ !pathEnvironmentVariable ? L"" : pathEnvironmentVariable.get() };
-    if (!pathEnvironmentVariable)
-    {
-        // We are the PATH
-        newPath = pathList;
-    }
-    else
-    {
-        // Remove the previous pathlist from PATH
-        if (m_pathListLastAddedToPath.empty())
-        {
-            // Nothing to remove so use the PATH environment variable as-is
-            newPath = std::move(path);
-        }
-        else
-        {
-            const auto& oldPathList{ m_pathListLastAddedToPath };
-            size_t offset = path.find(oldPathList);
-            for (; offset != std::wstring::npos; offset = path.find(oldPathList, offset + 1))
-            {
-                // Is this a false positive?
-                if ((offset != 0) && (path[offset - 1] != L';'))
-                {
-                    continue;
-                }
-                auto offsetAfterOldPathList{ offset + oldPathList.length() };
-                if ((offsetAfterOldPathList < path.length()) && (path[offsetAfterOldPathList] != L';'))
-                {
-                    continue;
-                }
-
-                // Gotcha!
-
-                // At this point we know...
-                // ...the old pathlist is the start-of-string or prefixed with ";"
-                // ...the old pathlist is the end-of-string or suffixed with ";"
-                // If we have both we need to remove one.
-                // If we're at the start of PATH we need to remove the trailing ";"
-                // If we're at the end of PATH we need to remove the leading ";"
-                // Simplifying matters, if we're not at the end of the string we can remove
-                // the trailer else remove the leader
-
-                // Keep everything before the old pathlist (if anything exists before it)
-                newPath = path.substr(0, offset);
-
-                // Skip the old path list and the trailing ";" (if any)
-                if (offsetAfterOldPathList < path.length())
-                {
-                    newPath += path.substr(offsetAfterOldPathList + 1);
-                }
-
-                // Done!
-                break;
-            }
-        }
-
-        // Prepend the new pathlist to PATH
-        if (!pathList.empty())
-        {
-            newPath = pathList + L";" + newPath;
-        }
-    }
-
-    // Update the PATH enironment variable
-    PCWSTR newPathEnvironmentVariable{ (newPath.length() > 0 ? newPath.c_str() : nullptr) };
-    THROW_IF_WIN32_BOOL_FALSE(SetEnvironmentVariableW(L"PATH", newPathEnvironmentVariable));
-
-    // Remember the path list we added to PATH for future updates
-    m_pathListLastAddedToPath = pathList;
-}
-
-void MddCore::PackageGraph::RemoveFromDllSearchOrder(PackageGraphNode& package)
+void MddCore::PackageGraph::RemoveFromDllSearchOrder(size_t index, PackageGraphNode& package, MddCore::IPathEnvironment& path)
 {
     // Update the AddDllDirectory list
     package.RemoveDllDirectories();
 
     // Update the PATH environment variable
-    UpdatePath();
-}
-
-std::wstring MddCore::PackageGraph::BuildPathList()
-{
-    std::wstring pathlist;
-    for (size_t index=0; index < m_packageGraphNodes.size(); ++index)
-    {
-        const auto& node{ m_packageGraphNodes[index] };
-        if (index > 0)
-        {
-            pathlist += L';';
-        }
-        pathlist += node.PathList();
-    }
-    return pathlist;
+    m_pathList.Remove(index, path);
 }
@@ -6,12 +6,36 @@
 
 #include "MsixDynamicDependency.h"
 
+#include "PackageCatalog.h"
 #include "PackageId.h"
 #include "PackageGraphNode.h"
 #include "PackageDependency.h"
+#include "PathList.h"
 
 namespace MddCore
 {
+/// The process' PATH environment variable
+class ProcessPathEnvironment : public MddCore::IPathEnvironment
+{
+public:
+    bool Get(std::wstring& value) override
+    {
+        auto path{ wil::TryGetEnvironmentVariableW(L"PATH") };
+        if (!path)
+        {
+            return false;
+        }
+        value = path.get();
+        return true;
+    }
+
+    void Set(const std::wstring& value) override
+    {
+        PCWSTR newValue{ (value.length() > 0 ? value.c_str() : nullptr) };
+        THROW_IF_WIN32_BOOL_FALSE(SetEnvironmentVariableW(L"PATH", newValue));
+    }
+};
+
 class PackageGraph
 {
 public:
@@ -26,16 +50,36 @@ public:
         MDD_PACKAGEDEPENDENCY_CONTEXT& packageDependencyContext,
         _Outptr_opt_result_maybenull_ PWSTR* packageFullName);
 
-private:
-    HRESULT Add(
-        _In_ PCWSTR packageFullName,
+public:
+    /// A package dependency resolved and loaded, ready to be added to the package graph.
+    struct PreparedPackageDependency
+    {
+        INT32 rank{};
+        MddAddPackageDependencyOptions options{};
+        wil::unique_process_heap_string packageFullName;
+        std::shared_ptr<MddCore::PackageGraphNode> packageGraphNode;
+        std::shared_ptr<MddCore::WinRTPackage> winrtPackage;
+    };
+
+    /// Resolve and load a package dependency. Doesn't touch the package graph
+    /// so it's safe to prepare any number of package dependencies concurrently.
+    static HRESULT Prepare(
+        _In_ PCWSTR packageDependencyId,
         INT32 rank,
         MddAddPackageDependencyOptions options,
-        _In_ PCWSTR packageDependencyId,
+        PreparedPackageDependency& prepared) noexcept;
+
+    /// Add a prepared package dependency to the package graph.
+    ///
+    /// @param path where to update the DLL search order's PATH. Pass a DeferredPathEnvironment
+    ///             to update PATH once after adding multiple package dependencies.
+    HRESULT Add(
+        PreparedPackageDependency& prepared,
+        MddCore::IPathEnvironment& path,
         MDD_PACKAGEDEPENDENCY_CONTEXT& context);
 
 public:
-    HRESULT ResolvePackageDependency(
+    static HRESULT ResolvePackageDependency(
         PCWSTR packageDependencyId,
         MddAddPackageDependencyOptions options,
         wil::unique_process_heap_string& packageFullName) noexcept;
@@ -45,23 +89,37 @@ public:
         MddAddPackageDependencyOptions options,
         wil::unique_process_heap_string& packageFullName);
 
+    /// Resolve the package dependency against the catalog. No caching.
+    static std::wstring ResolvePackageDependency(
+        MddCore::IPackageCatalog& packageCatalog,
+        const MddCore::PackageDependency& packageDependency);
+
 public:
     HRESULT Remove(
         MDD_PACKAGEDEPENDENCY_CONTEXT context);
 
-public:
-    HRESULT GetPackageDependencyForContext(
-        _In_ MDD_PACKAGEDEPENDENCY_CONTEXT context,
-        wil::unique_process_heap_string& packageDependencyId);
+    HRESULT Remove(
+        MDD_PACKAGEDEPENDENCY_CONTEXT context,
+        MddCore::IPathEnvironment& path);
 
 private:
+    /// FindBestFit() for PackageResolution::Resolve().
+    static std::function<size_t(const std::vector<std::wstring>&, const std::vector<bool>&)> MakeFindBestFit(
+        const MddCore::PackageDependency& packageDependency);
+
+    static std::wstring FindBestFit(
+        const MddCore::PackageDependency& packageDependency,
+        const std::vector<MddCore::PackageId>& candidates,
+        const std::vector<bool>& excluded,
+        size_t& bestFitIndex);
+
     static bool IsPackageABetterFitPerArchitecture(
         const MddCore::PackageId& bestFit,
         const MddCore::PackageId& candidate);
 
-    void AddToDllSearchOrder(PackageGraphNode& package);
+    void AddToDllSearchOrder(size_t index, PackageGraphNode& package, MddCore::IPathEnvironment& path);
 
-    void RemoveFromDllSearchOrder(PackageGraphNode& package);
+    void RemoveFromDllSearchOrder(size_t index, PackageGraphNode& package, MddCore::IPathEnvironment& path);
 
     inline static MddCore::Architecture GetCurrentArchitecture()
     {
@@ -78,19 +136,17 @@ private:
 #endif
     }
 
-    void UpdatePath();
-
-    std::wstring BuildPathList();
-
 public:
-    const std::vector<MddCore::PackageGraphNode>& PackageGraphNodes() const
+    // Nodes are shared with package graph snapshots (see PackageGraphManager),
+    // which may outlive the node's membership in the package graph.
+    const std::vector<std::shared_ptr<MddCore::PackageGraphNode>>& PackageGraphNodes() const
     {
         return m_packageGraphNodes;
     }
 
 private:
-    std::vector<MddCore::PackageGraphNode> m_packageGraphNodes;
-    std::wstring m_pathListLastAddedToPath;
+    std::vector<std::shared_ptr<MddCore::PackageGraphNode>> m_packageGraphNodes;
+    MddCore::PathList m_pathList;
 };
 }
 
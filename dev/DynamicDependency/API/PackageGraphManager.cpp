@@ -8,6 +8,7 @@
 std::recursive_mutex MddCore::PackageGraphManager::s_lock;
 MddCore::PackageGraph MddCore::PackageGraphManager::s_packageGraph;
 volatile ULONG MddCore::PackageGraphManager::s_generationId{};
+std::shared_ptr<const MddCore::PackageGraphManager::PackageGraphSnapshot> MddCore::PackageGraphManager::s_packageGraphSnapshot;
 
 UINT32 MddCore::PackageGraphManager::GetGenerationId()
 {
@@ -45,10 +46,180 @@ HRESULT MddCore::PackageGraphManager::AddToPackageGraph(
 
     RETURN_IF_FAILED(s_packageGraph.Add(packageDependencyId, rank, options, *context, packageFullName));
 
-    IncrementGenerationId();
+    PublishPackageGraphSnapshot(IncrementGenerationId());
     return S_OK;
 }
 
+HRESULT MddCore::PackageGraphManager::AddToPackageGraph(
+    UINT32 count,
+    const MddAddPackageDependencyRequest* packageDependencies,
+    MddAddPackageDependenciesOptions options,
+    MddAddPackageDependencyResult* results)
+{
+    // Resolve and load the package dependencies. That's the expensive part and doesn't need the package graph
+    std::vector<MddCore::PackageGraph::PreparedPackageDependency> prepared(count);
+    PreparePackageDependencies(count, packageDependencies, prepared, results);
+
+    // All or nothing? Don't bother touching the package graph if we know we'll fail
+    const bool allOrNothing{ WI_IsFlagSet(options, MddAddPackageDependenciesOptions::AllOrNothing) };
+    if (allOrNothing)
+    {
+        for (UINT32 index=0; index < count; ++index)
+        {
+            const auto hr{ results[index].hr };
+            if (FAILED(hr))
+            {
+                for (UINT32 cancelIndex=0; cancelIndex < count; ++cancelIndex)
+                {
+                    if (SUCCEEDED(results[cancelIndex].hr))
+                    {
+                        results[cancelIndex].hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+                    }
+                }
+                return hr;
+            }
+        }
+    }
+
+    std::unique_lock<std::recursive_mutex> lock(s_lock);
+
+    // Add them to the package graph, in order, updating PATH once at the end
+    MddCore::ProcessPathEnvironment processPath;
+    MddCore::DeferredPathEnvironment path(processPath);
+    UINT32 addedCount{};
+    UINT32 firstFailureIndex{ count };
+    for (UINT32 index=0; index < count; ++index)
+    {
+        auto& result{ results[index] };
+        if (FAILED(result.hr))
+        {
+            continue;
+        }
+
+        MDD_PACKAGEDEPENDENCY_CONTEXT context{};
+        try
+        {
+            result.hr = s_packageGraph.Add(prepared[index], path, context);
+        }
+        catch (...)
+        {
+            result.hr = LOG_CAUGHT_EXCEPTION();
+        }
+        if (SUCCEEDED(result.hr))
+        {
+            result.packageDependencyContext = context;
+            ++addedCount;
+            continue;
+        }
+
+        if (allOrNothing)
+        {
+            // Undo what we've done
+            for (UINT32 undoIndex=0; undoIndex < index; ++undoIndex)
+            {
+                auto& undoResult{ results[undoIndex] };
+                LOG_IF_FAILED(s_packageGraph.Remove(undoResult.packageDependencyContext, path));
+                undoResult.packageDependencyContext = nullptr;
+                undoResult.hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+            }
+            for (UINT32 cancelIndex=index+1; cancelIndex < count; ++cancelIndex)
+            {
+                results[cancelIndex].hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+            }
+            addedCount = 0;
+            firstFailureIndex = index;
+            break;
+        }
+    }
+
+    // PATH reflects the package graph even if we couldn't update it (the next update will set it right)
+    try
+    {
+        path.Commit();
+    }
+    CATCH_LOG();
+
+    if (addedCount > 0)
+    {
+        PublishPackageGraphSnapshot(IncrementGenerationId());
+    }
+    lock.unlock();
+
+    for (UINT32 index=0; index < count; ++index)
+    {
+        if (results[index].packageDependencyContext)
+        {
+            results[index].packageFullName = prepared[index].packageFullName.release();
+        }
+    }
+
+    if (addedCount == count)
+    {
+        return S_OK;
+    }
+    else if (addedCount > 0)
+    {
+        return S_FALSE;
+    }
+    else if (firstFailureIndex < count)
+    {
+        return results[firstFailureIndex].hr;
+    }
+    for (UINT32 index=0; index < count; ++index)
+    {
+        if (FAILED(results[index].hr))
+        {
+            return results[index].hr;
+        }
+    }
+    return S_OK;
+}
+
+void MddCore::PackageGraphManager::PreparePackageDependencies(
+    UINT32 count,
+    const MddAddPackageDependencyRequest* packageDependencies,
+    std::vector<MddCore::PackageGraph::PreparedPackageDependency>& prepared,
+    MddAddPackageDependencyResult* results)
+{
+    std::atomic<UINT32> next{};
+    auto prepare{ [&]() noexcept
+    {
+        for (UINT32 index=next++; index < count; index=next++)
+        {
+            const auto& packageDependency{ packageDependencies[index] };
+            results[index].hr = MddCore::PackageGraph::Prepare(packageDependency.packageDependencyId, packageDependency.rank, packageDependency.options, prepared[index]);
+        }
+    } };
+
+    // We (the calling thread) do our share of the work too
+    const auto hardwareConcurrency{ std::max(std::thread::hardware_concurrency(), 1u) };
+    const auto threadCount{ std::min({ count, hardwareConcurrency, c_maxPrepareThreads }) };
+    std::vector<std::thread> threads;
+    for (UINT32 thread=1; thread < threadCount; ++thread)
+    {
+        try
+        {
+            threads.emplace_back([&]() noexcept
+            {
+                // Resolving needs COM (e.g. PackageManager)
+                auto coInitialize{ wil::CoInitializeEx_failfast(COINIT_MULTITHREADED) };
+                prepare();
+            });
+        }
+        catch (...)
+        {
+            // Can't get help? We'll just have to do more ourselves
+            LOG_CAUGHT_EXCEPTION();
+            break;
+        }
+    }
+    prepare();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
 void MddCore::PackageGraphManager::RemoveFromPackageGraph(
     MDD_PACKAGEDEPENDENCY_CONTEXT context)
 {
@@ -61,16 +232,44 @@ void MddCore::PackageGraphManager::RemoveFromPackageGraph(
 
     (void) LOG_IF_FAILED(s_packageGraph.Remove(context));
 
-    IncrementGenerationId();
+    PublishPackageGraphSnapshot(IncrementGenerationId());
 }
 
 HRESULT MddCore::PackageGraphManager::GetPackageDependencyForContext(
     _In_ MDD_PACKAGEDEPENDENCY_CONTEXT context,
     wil::unique_process_heap_string& packageDependencyId)
 {
-    std::unique_lock<std::recursive_mutex> lock(s_lock);
+    const auto packageGraph{ GetPackageGraphSnapshot() };
+    if (packageGraph)
+    {
+        for (const auto& node : packageGraph->nodes)
+        {
+            if (node->Context() == context)
+            {
+                packageDependencyId = wil::make_process_heap_string(node->Id().c_str());
+                return S_OK;
+            }
+        }
+    }
+    RETURN_WIN32(ERROR_INVALID_HANDLE);
+}
+
+std::shared_ptr<const MddCore::PackageGraphManager::PackageGraphSnapshot> MddCore::PackageGraphManager::GetPackageGraphSnapshot()
+{
+    return std::atomic_load(&s_packageGraphSnapshot);
+}
+
+void MddCore::PackageGraphManager::PublishPackageGraphSnapshot(
+    const UINT32 generationId)
+{
+    // NOTE: Caller must hold s_lock
+
+    auto packageGraph{ std::make_shared<PackageGraphSnapshot>() };
+    packageGraph->generationId = generationId;
+    const auto& packageGraphNodes{ s_packageGraph.PackageGraphNodes() };
+    packageGraph->nodes.assign(packageGraphNodes.begin(), packageGraphNodes.end());
 
-    return s_packageGraph.GetPackageDependencyForContext(context, packageDependencyId);
+    std::atomic_store(&s_packageGraphSnapshot, std::shared_ptr<const PackageGraphSnapshot>(std::move(packageGraph)));
 }
 
 // On success, bufferLength depends on packageInfoType:
@@ -100,7 +299,9 @@ HRESULT MddCore::PackageGraphManager::GetCurrentPackageInfo3(
         *count = 0;
     }
 
-    std::unique_lock<std::recursive_mutex> lock(s_lock);
+    // Work against the current snapshot of the package graph. We never block on s_lock here
+    // so a slow AddToPackageGraph() or RemoveFromPackageGraph() doesn't stall package info queries.
+    const auto packageGraph{ GetPackageGraphSnapshot() };
 
     // Do we need Static and/or Dynamic items? NOTE: If neither are specified we need both
     const bool filterStatic{ WI_IsFlagSet(flags, PACKAGE_FILTER_STATIC) };
@@ -117,7 +318,7 @@ HRESULT MddCore::PackageGraphManager::GetCurrentPackageInfo3(
     // Then GetCurrentPackageInfo3() always returns APPMODEL_ERROR_NO_PACKAGE
     //
     // Preserve these behaviors for compatibility reasons.
-    if (s_packageGraph.PackageGraphNodes().empty() || (filterStatic && !filterDynamic))
+    if (!packageGraph || packageGraph->nodes.empty() || (filterStatic && !filterDynamic))
     {
         return HRESULT_FROM_WIN32(APPMODEL_ERROR_NO_PACKAGE);
     }
@@ -130,7 +331,7 @@ HRESULT MddCore::PackageGraphManager::GetCurrentPackageInfo3(
         RETURN_HR_IF_EXPECTED(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), insufficientSpace);
 
         UINT32* generationId{ reinterpret_cast<UINT32*>(buffer) };
-        *generationId = GetGenerationId();
+        *generationId = packageGraph->generationId;
         return S_OK;
     }
     RETURN_HR_IF(E_INVALIDARG, (packageInfoType != PackageInfoType_PackageInfoInstallPath) &&
@@ -140,37 +341,13 @@ HRESULT MddCore::PackageGraphManager::GetCurrentPackageInfo3(
                                (packageInfoType != PackageInfoType_PackageInfoUserExternalPath) &&
                                (packageInfoType != PackageInfoType_PackageInfoEffectiveExternalPath));
 
-    // We manage the package graph as a list of nodes, where each contain contains information about 1+ package.
-    //
-    // Find all the packages across the package graph that match our filter criteria (see flags in
-    // https://docs.microsoft.com/windows/win32/api/appmodel/nf-appmodel-getcurrentpackageinfo2).
-    //
-    // Then compute the size needed for all the data.
-    //
-    // The if the buffer's big enough, serialize the data into buffer.
-    //
-    // Either way, set bufferLength with the buffer size needed for all the data.
-
-    wil::unique_cotaskmem_ptr<BYTE[]> staticPackageGraphBuffer;
-    const PACKAGE_INFO* staticPackageInfo{};
-    UINT32 staticPackagesCount{};
-    UINT32 dynamicPackagesCount{};
-
-    std::vector<const MddCore::PackageGraphNode*> matchingPackageInfo;
-
-    for (auto& packageGraphNode : s_packageGraph.PackageGraphNodes())
-    {
-        // Does the node have any matching packages?
-        const auto countMatchingPackages{ packageGraphNode.CountMatchingPackages(flags, packageInfoType) };
-        if (countMatchingPackages > 0)
-        {
-            matchingPackageInfo.push_back(&packageGraphNode);
-            dynamicPackagesCount += countMatchingPackages;
-        }
-    }
+    // Callers ask the same questions over and over (typically twice in a row: once for the size and
+    // again for the data) while the package graph rarely changes. Serialize the answer once per
+    // snapshot and serve repeat queries from that.
+    const auto serializedPackageInfo{ GetSerializedPackageInfo(*packageGraph, flags, packageInfoType) };
 
     // Update the total 'count' (if any)
-    const auto totalPackagesCount{ staticPackagesCount + dynamicPackagesCount };
+    const auto totalPackagesCount{ serializedPackageInfo->count };
     if (count)
     {
         *count = totalPackagesCount;
@@ -204,16 +381,129 @@ HRESULT MddCore::PackageGraphManager::GetCurrentPackageInfo3(
         return S_OK;
     }
 
-    // Compute the buffer length used/needed and fill buffer (if we can)
-    auto bufferNeeded{ SerializePackageInfoToBuffer(flags, packageInfoType, *bufferLength, buffer, matchingPackageInfo, dynamicPackagesCount, staticPackageInfo, staticPackagesCount) };
-    const auto isInsufficientBuffer{ *bufferLength < bufferNeeded };
-    *bufferLength = bufferNeeded;
+    // Set bufferLength with the buffer size needed for all the data and fill buffer (if we can)
+    const auto isInsufficientBuffer{ *bufferLength < serializedPackageInfo->bufferLength };
+    *bufferLength = serializedPackageInfo->bufferLength;
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), isInsufficientBuffer);
 
+    CopySerializedPackageInfoToBuffer(*serializedPackageInfo, buffer);
     return S_OK;
 }
 CATCH_RETURN();
 
+std::shared_ptr<const MddCore::PackageGraphManager::SerializedPackageInfo> MddCore::PackageGraphManager::GetSerializedPackageInfo(
+    const PackageGraphSnapshot& packageGraph,
+    const UINT32 flags,
+    const PackageInfoType packageInfoType)
+{
+    for (const auto& slot : packageGraph.serializedPackageInfo)
+    {
+        auto serializedPackageInfo{ std::atomic_load(&slot) };
+        if (serializedPackageInfo && (serializedPackageInfo->flags == flags) && (serializedPackageInfo->packageInfoType == packageInfoType))
+        {
+            return serializedPackageInfo;
+        }
+    }
+
+    // Not serialized yet. Racing readers may each serialize the same answer; that's harmless as they're identical
+    std::shared_ptr<const SerializedPackageInfo> serializedPackageInfo{ SerializePackageInfo(packageGraph, flags, packageInfoType) };
+
+    // Save it in the first free slot. If they're all in use replace one; the snapshot's readers
+    // only ask a handful of distinct questions and the snapshot is replaced when the graph changes
+    for (auto& slot : packageGraph.serializedPackageInfo)
+    {
+        std::shared_ptr<const SerializedPackageInfo> empty;
+        if (std::atomic_compare_exchange_strong(&slot, &empty, serializedPackageInfo))
+        {
+            return serializedPackageInfo;
+        }
+    }
+    auto& slot{ packageGraph.serializedPackageInfo[(flags ^ static_cast<UINT32>(packageInfoType)) % c_maxSerializedPackageInfo] };
+    std::atomic_store(&slot, serializedPackageInfo);
+    return serializedPackageInfo;
+}
+
+std::shared_ptr<const MddCore::PackageGraphManager::SerializedPackageInfo> MddCore::PackageGraphManager::SerializePackageInfo(
+    const PackageGraphSnapshot& packageGraph,
+    const UINT32 flags,
+    const PackageInfoType packageInfoType)
+{
+    // We manage the package graph as a list of nodes, where each contain contains information about 1+ package.
+    //
+    // Find all the packages across the package graph that match our filter criteria (see flags in
+    // https://docs.microsoft.com/windows/win32/api/appmodel/nf-appmodel-getcurrentpackageinfo2).
+    //
+    // Then compute the size needed for all the data and serialize the data into a buffer of that size.
+
+    wil::unique_cotaskmem_ptr<BYTE[]> staticPackageGraphBuffer;
+    const PACKAGE_INFO* staticPackageInfo{};
+    UINT32 staticPackagesCount{};
+    UINT32 dynamicPackagesCount{};
+
+    std::vector<const MddCore::PackageGraphNode*> matchingPackageInfo;
+
+    for (const auto& packageGraphNode : packageGraph.nodes)
+    {
+        // Does the node have any matching packages?
+        const auto countMatchingPackages{ packageGraphNode->CountMatchingPackages(flags, packageInfoType) };
+        if (countMatchingPackages > 0)
+        {
+            matchingPackageInfo.push_back(packageGraphNode.get());
+            dynamicPackagesCount += countMatchingPackages;
+        }
+    }
+
+    auto serializedPackageInfo{ std::make_shared<SerializedPackageInfo>() };
+    serializedPackageInfo->flags = flags;
+    serializedPackageInfo->packageInfoType = packageInfoType;
+    serializedPackageInfo->count = staticPackagesCount + dynamicPackagesCount;
+    if (serializedPackageInfo->count == 0)
+    {
+        return serializedPackageInfo;
+    }
+
+    // Compute the buffer length needed, then fill our buffer
+    const auto bufferNeeded{ SerializePackageInfoToBuffer(flags, packageInfoType, 0, nullptr, matchingPackageInfo, dynamicPackagesCount, staticPackageInfo, staticPackagesCount) };
+    serializedPackageInfo->buffer = std::make_unique<BYTE[]>(bufferNeeded);
+    serializedPackageInfo->bufferLength = SerializePackageInfoToBuffer(flags, packageInfoType, bufferNeeded, serializedPackageInfo->buffer.get(), matchingPackageInfo, dynamicPackagesCount, staticPackageInfo, staticPackagesCount);
+    FAIL_FAST_HR_IF(E_UNEXPECTED, serializedPackageInfo->bufferLength != bufferNeeded);
+    return serializedPackageInfo;
+}
+
+void MddCore::PackageGraphManager::CopySerializedPackageInfoToBuffer(
+    const SerializedPackageInfo& serializedPackageInfo,
+    void* buffer)
+{
+    const BYTE* fromBuffer{ serializedPackageInfo.buffer.get() };
+    BYTE* toBuffer{ static_cast<BYTE*>(buffer) };
+    memcpy(toBuffer, fromBuffer, serializedPackageInfo.bufferLength);
+
+    // The copied PACKAGE_INFO[] still points at strings in our buffer. Point them at the caller's copy.
+    auto packageInfo{ reinterpret_cast<PACKAGE_INFO*>(toBuffer) };
+    for (UINT32 index=0; index < serializedPackageInfo.count; ++index, ++packageInfo)
+    {
+        RebaseStringInBuffer(packageInfo->path, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageFullName, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageFamilyName, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageId.name, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageId.publisher, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageId.resourceId, fromBuffer, toBuffer);
+        RebaseStringInBuffer(packageInfo->packageId.publisherId, fromBuffer, toBuffer);
+    }
+}
+
+void MddCore::PackageGraphManager::RebaseStringInBuffer(
+    PWSTR& string,
+    const BYTE* fromBuffer,
+    BYTE* toBuffer)
+{
+    if (string)
+    {
+        const auto offset{ reinterpret_cast<const BYTE*>(string) - fromBuffer };
+        string = reinterpret_cast<PWSTR>(toBuffer + offset);
+    }
+}
+
 UINT32 MddCore::PackageGraphManager::SerializePackageInfoToBuffer(
     const UINT32 flags,
     const PackageInfoType packageInfoType,
@@ -32,6 +32,12 @@ public:
         _Out_ MDD_PACKAGEDEPENDENCY_CONTEXT* packageDependencyContext,
         _Outptr_opt_result_maybenull_ PWSTR* packageFullName);
 
+    static HRESULT AddToPackageGraph(
+        UINT32 count,
+        const MddAddPackageDependencyRequest* packageDependencies,
+        MddAddPackageDependenciesOptions options,
+        MddAddPackageDependencyResult* results);
+
     static void RemoveFromPackageGraph(
         MDD_PACKAGEDEPENDENCY_CONTEXT context);
 
@@ -55,6 +61,66 @@ public:
         UINT32* count) noexcept;
 
 private:
+    // Most threads we'll use to prepare package dependencies for AddToPackageGraph()
+    static const UINT32 c_maxPrepareThreads{ 8 };
+
+    static void PreparePackageDependencies(
+        UINT32 count,
+        const MddAddPackageDependencyRequest* packageDependencies,
+        std::vector<MddCore::PackageGraph::PreparedPackageDependency>& prepared,
+        MddAddPackageDependencyResult* results);
+
+private:
+    // GetCurrentPackageInfo3's answer for a (flags, packageInfoType) query against a package graph snapshot,
+    // serialized into a buffer we own. PWSTR fields point into our buffer and are rebased when copied out.
+    struct SerializedPackageInfo
+    {
+        UINT32 flags{};
+        PackageInfoType packageInfoType{};
+        UINT32 count{};
+        UINT32 bufferLength{};
+        std::unique_ptr<BYTE[]> buffer;
+    };
+
+    static const size_t c_maxSerializedPackageInfo{ 8 };
+
+    // An immutable view of the package graph. Readers grab the current snapshot without taking s_lock
+    // and use it for as long as they like. Writers (holding s_lock) update s_packageGraph and then
+    // publish a new snapshot; nodes removed from the package graph live on until the last snapshot
+    // referencing them is released.
+    struct PackageGraphSnapshot
+    {
+        UINT32 generationId{};
+        std::vector<std::shared_ptr<const MddCore::PackageGraphNode>> nodes;
+
+        // Answers serialized against this snapshot, filled in lazily by readers
+        mutable std::shared_ptr<const SerializedPackageInfo> serializedPackageInfo[c_maxSerializedPackageInfo];
+    };
+
+    static std::shared_ptr<const PackageGraphSnapshot> GetPackageGraphSnapshot();
+
+    static void PublishPackageGraphSnapshot(
+        const UINT32 generationId);
+
+    static std::shared_ptr<const SerializedPackageInfo> GetSerializedPackageInfo(
+        const PackageGraphSnapshot& packageGraph,
+        const UINT32 flags,
+        const PackageInfoType packageInfoType);
+
+    static std::shared_ptr<const SerializedPackageInfo> SerializePackageInfo(
+        const PackageGraphSnapshot& packageGraph,
+        const UINT32 flags,
+        const PackageInfoType packageInfoType);
+
+    static void CopySerializedPackageInfoToBuffer(
+        const SerializedPackageInfo& serializedPackageInfo,
+        void* buffer);
+
+    static void RebaseStringInBuffer(
+        PWSTR& string,
+        const BYTE* fromBuffer,
+        BYTE* toBuffer);
+
     static UINT32 SerializePackageInfoToBuffer(
         const UINT32 flags,
         const PackageInfoType packageInfoType,
@@ -81,6 +147,7 @@ private:
     static std::recursive_mutex s_lock;
     static MddCore::PackageGraph s_packageGraph;
     static volatile ULONG s_generationId;
+    static std::shared_ptr<const PackageGraphSnapshot> s_packageGraphSnapshot;
 };
 }
 
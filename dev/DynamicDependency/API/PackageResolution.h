@@ -0,0 +1,81 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PACKAGERESOLUTION_H)
+#define PACKAGERESOLUTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PackageCatalog.h"
+#include "PackageResolutionCache.h"
+
+namespace MddCore::PackageResolution
+{
+/// Resolve a package dependency against the catalog. No caching.
+///
+/// Checking a package's status is expensive so only the best fit's is checked. If it's not OK
+/// it's dropped and the best fit of the rest is tried, and so on.
+///
+/// @param findBestFit `size_t(const std::vector<std::wstring>& packageFullNames, const std::vector<bool>& excluded)`
+///                    returning the index of the best fit among the packages not excluded, or
+///                    packageFullNames.size() if none fits (see PackageGraph::FindBestFit()).
+/// @return the best fit's package full name, or an empty string if no package fits.
+template <typename FindBestFit>
+std::wstring Resolve(
+    MddCore::IPackageCatalog& packageCatalog,
+    const std::wstring& packageFamilyName,
+    FindBestFit&& findBestFit)
+{
+    const auto packageFullNames{ packageCatalog.FindPackagesByFamily(packageFamilyName) };
+    std::vector<bool> excluded(packageFullNames.size());
+    for (;;)
+    {
+        const size_t bestFitIndex{ findBestFit(packageFullNames, excluded) };
+        if (bestFitIndex >= packageFullNames.size())
+        {
+            return std::wstring();
+        }
+
+        // Package status must be OK to use a package
+        if (packageCatalog.IsPackageStatusOK(packageFullNames[bestFitIndex]))
+        {
+            return packageFullNames[bestFitIndex];
+        }
+        excluded[bestFitIndex] = true;
+    }
+}
+
+/// Resolve a package dependency, reusing an earlier resolution of the same criteria if the
+/// catalog hasn't changed since. Catalogs that can't track changes are always asked.
+template <typename FindBestFit>
+std::wstring Resolve(
+    MddCore::IPackageCatalog& packageCatalog,
+    MddCore::PackageResolutionCache& packageResolutionCache,
+    const std::wstring& packageFamilyName,
+    uint64_t minVersion,
+    uint32_t architectures,
+    FindBestFit&& findBestFit)
+{
+    if (!packageCatalog.IsTrackingChanges())
+    {
+        return Resolve(packageCatalog, packageFamilyName, findBestFit);
+    }
+
+    const auto changeId{ packageCatalog.ChangeId() };
+    std::wstring bestFit;
+    if (!packageResolutionCache.Find(packageFamilyName, minVersion, architectures, changeId, bestFit))
+    {
+        bestFit = Resolve(packageCatalog, packageFamilyName, findBestFit);
+        if (!bestFit.empty())
+        {
+            packageResolutionCache.Add(packageFamilyName, minVersion, architectures, changeId, bestFit);
+        }
+    }
+    return bestFit;
+}
+}
+
+#endif // PACKAGERESOLUTION_H
@@ -0,0 +1,115 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PACKAGERESOLUTIONCACHE_H)
+#define PACKAGERESOLUTIONCACHE_H
+
+#include <cstdint>
+#include <cwctype>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace MddCore
+{
+/// Package dependency resolutions i.e. (packageFamilyName, minVersion, architectures) -> packageFullName.
+///
+/// Resolutions are only valid for the catalog content they were resolved against. Every operation
+/// takes the catalog's current change id (see IPackageCatalog::ChangeId()); when the catalog
+/// changes all resolutions are discarded.
+///
+/// @note Methods are thread safe.
+class PackageResolutionCache
+{
+public:
+    PackageResolutionCache() = default;
+
+    ~PackageResolutionCache() = default;
+
+    /// Return true and the package full name if a resolution is known for the package dependency criteria.
+    bool Find(
+        const std::wstring& packageFamilyName,
+        uint64_t minVersion,
+        uint32_t architectures,
+        uint64_t changeId,
+        std::wstring& packageFullName)
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+
+        if (!IsCurrent(changeId))
+        {
+            return false;
+        }
+
+        auto iterator{ m_resolutions.find(Key{ ToUpper(packageFamilyName), minVersion, architectures }) };
+        if (iterator == m_resolutions.end())
+        {
+            return false;
+        }
+        packageFullName = iterator->second;
+        return true;
+    }
+
+    /// Remember a resolution made against the catalog as of changeId.
+    void Add(
+        const std::wstring& packageFamilyName,
+        uint64_t minVersion,
+        uint32_t architectures,
+        uint64_t changeId,
+        const std::wstring& packageFullName)
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+
+        if (!IsCurrent(changeId))
+        {
+            // Resolved against an older catalog. Don't remember it
+            return;
+        }
+
+        m_resolutions.insert_or_assign(Key{ ToUpper(packageFamilyName), minVersion, architectures }, packageFullName);
+    }
+
+    size_t Size()
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        return m_resolutions.size();
+    }
+
+private:
+    // Package family names are case-insensitive
+    using Key = std::tuple<std::wstring, uint64_t, uint32_t>;
+
+    static std::wstring ToUpper(const std::wstring& s)
+    {
+        std::wstring upper{ s };
+        for (auto& c : upper)
+        {
+            c = static_cast<wchar_t>(std::towupper(c));
+        }
+        return upper;
+    }
+
+    /// Return false if changeId is older than what we've seen. Forget everything if it's newer.
+    bool IsCurrent(uint64_t changeId)
+    {
+        if (changeId < m_changeId)
+        {
+            return false;
+        }
+        if (changeId > m_changeId)
+        {
+            m_resolutions.clear();
+            m_changeId = changeId;
+        }
+        return true;
+    }
+
+private:
+    std::mutex m_lock;
+    uint64_t m_changeId{};
+    std::map<Key, std::wstring> m_resolutions;
+};
+}
+
+#endif // PACKAGERESOLUTIONCACHE_H
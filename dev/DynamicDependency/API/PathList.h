@@ -0,0 +1,286 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PATHLIST_H)
+#define PATHLIST_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// This header only depends on the C++ standard library so the PATH maintenance logic
+// can be exercised (and measured) against synthetic environments anywhere.
+namespace MddCore
+{
+/// An environment variable holding a semi-colon delimited list (i.e. PATH)
+class IPathEnvironment
+{
+public:
+    virtual ~IPathEnvironment() = default;
+
+    /// Returns false if the variable doesn't exist
+    virtual bool Get(std::wstring& value) = 0;
+
+    /// An empty value deletes the variable
+    virtual void Set(const std::wstring& value) = 0;
+};
+
+/// The block of paths the package graph prepends to PATH. There's one entry per package graph node,
+/// in package graph order; each entry can itself hold multiple semi-colon delimited paths.
+///
+/// We remember the block we last wrote to PATH (and where each entry is in it) so adding or
+/// removing a node edits only that node's entry in PATH, rather than rebuilding the block and
+/// searching PATH for the old one.
+///
+/// PATH is mutable by anyone in the process, at any time, so we can't assume our block is
+/// unchanged. If it's not where we left it we fall back to removing the old block (if it's
+/// still an unmodified block anywhere in PATH) and prepending the new one. If it's not an
+/// unmodified block the app's done something unexpected and we won't micromanage removing
+/// it piecemeal.
+class PathList
+{
+public:
+    PathList() = default;
+    ~PathList() = default;
+
+    void Insert(
+        size_t index,
+        const std::wstring& entry,
+        IPathEnvironment& environment)
+    {
+        // Make the change to a copy so we're unchanged if updating the environment fails
+        Edit edit;
+        const auto count{ m_lengths.size() };
+        if (count == 0)
+        {
+            edit.text = entry;
+        }
+        else if (index < count)
+        {
+            edit.offset = OffsetOf(index);
+            edit.text = entry + L';';
+        }
+        else
+        {
+            index = count;
+            edit.offset = m_value.length();
+            edit.text = L';' + entry;
+        }
+        auto newValue{ m_value };
+        newValue.replace(edit.offset, edit.length, edit.text);
+
+        Update(edit, newValue, environment);
+
+        m_lengths.insert(m_lengths.begin() + index, entry.length());
+        m_value = std::move(newValue);
+    }
+
+    void Remove(
+        size_t index,
+        IPathEnvironment& environment)
+    {
+        const auto count{ m_lengths.size() };
+        if (index >= count)
+        {
+            return;
+        }
+
+        Edit edit;
+        edit.offset = OffsetOf(index);
+        edit.length = m_lengths[index];
+        if (count > 1)
+        {
+            // Take a delimiter with us: the trailing one, or if we're last the leading one
+            if (index < count - 1)
+            {
+                edit.length += 1;
+            }
+            else
+            {
+                edit.offset -= 1;
+                edit.length += 1;
+            }
+        }
+        auto newValue{ m_value };
+        newValue.erase(edit.offset, edit.length);
+
+        Update(edit, newValue, environment);
+
+        m_lengths.erase(m_lengths.begin() + index);
+        m_value = std::move(newValue);
+    }
+
+    const std::wstring& Value() const
+    {
+        return m_value;
+    }
+
+    size_t Count() const
+    {
+        return m_lengths.size();
+    }
+
+private:
+    // Replace [offset, offset+length) in our block with text
+    struct Edit
+    {
+        size_t offset{};
+        size_t length{};
+        std::wstring text;
+    };
+
+    size_t OffsetOf(size_t index) const
+    {
+        size_t offset{};
+        for (size_t n=0; n < index; ++n)
+        {
+            offset += m_lengths[n] + 1;
+        }
+        return offset;
+    }
+
+    void Update(
+        const Edit& edit,
+        const std::wstring& newValue,
+        IPathEnvironment& environment) const
+    {
+        std::wstring path;
+        if (!environment.Get(path))
+        {
+            // We are the PATH
+            environment.Set(newValue);
+            return;
+        }
+
+        if (IsAtStartOf(path))
+        {
+            // Our block's where we left it. Edit it in place
+            if (newValue.empty())
+            {
+                path.erase(0, m_value.length() < path.length() ? m_value.length() + 1 : m_value.length());
+            }
+            else if (m_value.empty())
+            {
+                path.insert(0, path.empty() ? newValue : newValue + L';');
+            }
+            else
+            {
+                path.replace(edit.offset, edit.length, edit.text);
+            }
+        }
+        else
+        {
+            RemoveFrom(path);
+            if (!newValue.empty())
+            {
+                path.insert(0, path.empty() ? newValue : newValue + L';');
+            }
+        }
+        environment.Set(path);
+    }
+
+    // Is our block at the start of path (and a whole item, not a prefix of a longer one)?
+    bool IsAtStartOf(const std::wstring& path) const
+    {
+        if (m_value.empty())
+        {
+            return true;
+        }
+        return (path.compare(0, m_value.length(), m_value) == 0) &&
+               ((path.length() == m_value.length()) || (path[m_value.length()] == L';'));
+    }
+
+    // Remove our block from wherever it is in path (if present)
+    void RemoveFrom(std::wstring& path) const
+    {
+        if (m_value.empty())
+        {
+            return;
+        }
+
+        for (size_t offset=path.find(m_value); offset != std::wstring::npos; offset=path.find(m_value, offset + 1))
+        {
+            // Is this a false positive?
+            if ((offset != 0) && (path[offset - 1] != L';'))
+            {
+                continue;
+            }
+            const auto offsetAfter{ offset + m_value.length() };
+            if ((offsetAfter < path.length()) && (path[offsetAfter] != L';'))
+            {
+                continue;
+            }
+
+            // Gotcha! Remove it and the trailing ";" or, if we're at the end, the leading ";"
+            if (offsetAfter < path.length())
+            {
+                path.erase(offset, m_value.length() + 1);
+            }
+            else if (offset > 0)
+            {
+                path.erase(offset - 1, m_value.length() + 1);
+            }
+            else
+            {
+                path.clear();
+            }
+            return;
+        }
+    }
+
+private:
+    std::wstring m_value;
+    std::vector<size_t> m_lengths;
+};
+
+/// Buffer changes to an environment variable so a series of PathList edits
+/// reads and writes the real variable once (i.e. Get on first use, Set on Commit).
+class DeferredPathEnvironment : public IPathEnvironment
+{
+public:
+    DeferredPathEnvironment(IPathEnvironment& environment) :
+        m_environment(environment)
+    {
+    }
+
+    ~DeferredPathEnvironment() override = default;
+
+    bool Get(std::wstring& value) override
+    {
+        if (!m_loaded)
+        {
+            m_exists = m_environment.Get(m_value);
+            m_loaded = true;
+        }
+        value = m_value;
+        return m_exists;
+    }
+
+    void Set(const std::wstring& value) override
+    {
+        m_value = value;
+        m_exists = !value.empty();
+        m_loaded = true;
+        m_modified = true;
+    }
+
+    /// Write the buffered value (if changed) to the real environment variable
+    void Commit()
+    {
+        if (m_modified)
+        {
+            m_environment.Set(m_value);
+            m_modified = false;
+        }
+    }
+
+private:
+    IPathEnvironment& m_environment;
+    std::wstring m_value;
+    bool m_exists{};
+    bool m_loaded{};
+    bool m_modified{};
+};
+}
+
+#endif // PATHLIST_H
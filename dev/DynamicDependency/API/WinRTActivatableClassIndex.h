@@ -0,0 +1,83 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINRTACTIVATABLECLASSINDEX_H)
+#define WINRTACTIVATABLECLASSINDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace MddCore
+{
+/// activatableClassId -> its inproc server, across all the package graph's WinRT packages.
+/// When multiple packages define the same class, the first (by rank) wins.
+///
+/// This header only depends on the C++ standard library so the index (and its lock) can be
+/// benchmarked anywhere (see test\DynamicDependency\Perf). WinRTModuleManager provides the
+/// packages and what an inproc server is.
+///
+/// @note Callers must hold Lock() across calls, and for as long as they use what Find() returns.
+template <typename TInprocServer>
+class WinRTActivatableClassIndex
+{
+public:
+    std::unique_lock<std::recursive_mutex> Lock()
+    {
+        return std::unique_lock<std::recursive_mutex>(m_lock);
+    }
+
+    /// Replace the index's content. forEachInprocServer(add) calls add(activatableClassId, inprocServer)
+    /// for every class the package graph's packages define, in rank order (and manifest order within
+    /// a package), so the first definition seen for an activatableClassId is the one that wins.
+    template <typename ForEachInprocServer>
+    void Rebuild(ForEachInprocServer&& forEachInprocServer)
+    {
+        std::map<std::wstring, TInprocServer, std::less<>> inprocServers;
+        forEachInprocServer([&](const std::wstring& activatableClassId, TInprocServer inprocServer)
+        {
+            inprocServers.emplace(activatableClassId, std::move(inprocServer));
+        });
+        m_inprocServers = std::move(inprocServers);
+        ++m_generation;
+    }
+
+    /// Changes every Rebuild(). What Find() returned is valid for as long as this is unchanged.
+    uint64_t Generation() const
+    {
+        return m_generation;
+    }
+
+    /// Return the class' inproc server, or nullptr if the package graph doesn't define it.
+    TInprocServer* Find(std::wstring_view activatableClassId)
+    {
+        if (m_inprocServers.empty())
+        {
+            return nullptr;
+        }
+
+        // std::less<> so we can find HSTRINGs' text without copying it to a std::wstring
+        auto iterator{ m_inprocServers.find(activatableClassId) };
+        if (iterator == m_inprocServers.end())
+        {
+            return nullptr;
+        }
+        return &iterator->second;
+    }
+
+    size_t Size() const
+    {
+        return m_inprocServers.size();
+    }
+
+private:
+    std::recursive_mutex m_lock;
+    std::map<std::wstring, TInprocServer, std::less<>> m_inprocServers;
+    uint64_t m_generation{ 1 };
+};
+}
+
+#endif // WINRTACTIVATABLECLASSINDEX_H
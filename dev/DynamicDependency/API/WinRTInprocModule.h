@@ -38,21 +38,13 @@ public:
         return MddCore::WinRT::ThreadingModel::Unknown;
     }
 
-    void* GetActivationFactory(
-        HSTRING className,
-        const std::wstring& activatableClassId,
-        REFIID iid)
+    wil::com_ptr<IActivationFactory> GetActivationFactory(
+        HSTRING className)
     {
         Load();
 
-        IActivationFactory* ifactory{};
-        THROW_IF_FAILED(m_dllGetActivationFactory(className, &ifactory));
-
-        //TODO optimize for IActivationFactory? See GetActivationFactory() in dev\UndockedRegFreeWinRT\catalog.cpp
-        void* factory{};
-        const auto hr{ ifactory->QueryInterface(iid, &factory) };
-        ifactory->Release();
-        THROW_IF_FAILED_MSG(hr, "Error 0x%X in ifactory->QueryInterface(%ls)", hr, activatableClassId.c_str());
+        wil::com_ptr<IActivationFactory> factory;
+        THROW_IF_FAILED(m_dllGetActivationFactory(className, factory.put()));
         return factory;
     }
 
@@ -0,0 +1,121 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include "WinRTManifestCache.h"
+
+#include "DataStore.h"
+
+namespace MddCore::WinRTManifestCache
+{
+    // Cache files larger than this aren't ours (no manifest defines that many inproc servers)
+    constexpr DWORD c_maxCacheFileSize{ 4 * 1024 * 1024 };
+
+    static std::filesystem::path GetCacheFilename(const Key& key)
+    {
+        // Determined once per process; if it fails we'll try again next time
+        static const std::filesystem::path c_path{ []() {
+            auto path{ MddCore::DataStore::GetCachePathForUser() };
+            path /= L"WinRT";
+            return path;
+        }() };
+
+        auto filename{ c_path };
+        filename /= key.packageFullName + L".winrt";
+        return filename;
+    }
+}
+
+bool MddCore::WinRTManifestCache::GetKey(
+    PCWSTR packageFullName,
+    const std::filesystem::path& manifestFilename,
+    Key& key) noexcept try
+{
+    // No cache for AppContainer processes (see DataStore::GetCachePathForUser)
+    if (wil::get_token_is_app_container())
+    {
+        return false;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (!GetFileAttributesExW(manifestFilename.c_str(), GetFileExInfoStandard, &data))
+    {
+        return false;
+    }
+
+    key.packageFullName = packageFullName;
+    key.manifestSize = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    key.manifestLastWriteTime = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+catch (...)
+{
+    LOG_CAUGHT_EXCEPTION();
+    return false;
+}
+
+bool MddCore::WinRTManifestCache::Load(
+    const Key& key,
+    std::vector<InprocModule>& inprocModules) noexcept try
+{
+    const auto filename{ GetCacheFilename(key) };
+    wil::unique_hfile file{ ::CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+    if (!file)
+    {
+        // Not cached (yet)
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    THROW_IF_WIN32_BOOL_FALSE(::GetFileSizeEx(file.get(), &fileSize));
+    if ((fileSize.QuadPart == 0) || (fileSize.QuadPart > c_maxCacheFileSize))
+    {
+        return false;
+    }
+
+    const auto bufferSize{ static_cast<DWORD>(fileSize.QuadPart) };
+    std::unique_ptr<uint8_t[]> buffer{ std::make_unique<uint8_t[]>(bufferSize) };
+    DWORD bytesRead{};
+    THROW_IF_WIN32_BOOL_FALSE(::ReadFile(file.get(), buffer.get(), bufferSize, &bytesRead, nullptr));
+
+    // Stale (or otherwise unusable) data is ignored. We'll replace it after we parse the manifest
+    return MddCore::WinRTManifestCacheFormat::Deserialize(buffer.get(), bytesRead, key, inprocModules);
+}
+catch (...)
+{
+    LOG_CAUGHT_EXCEPTION();
+    return false;
+}
+
+void MddCore::WinRTManifestCache::Save(
+    const Key& key,
+    const std::vector<InprocModule>& inprocModules) noexcept try
+{
+    const auto data{ MddCore::WinRTManifestCacheFormat::Serialize(key, inprocModules) };
+
+    const auto filename{ GetCacheFilename(key) };
+    std::filesystem::create_directories(filename.parent_path());
+
+    // Write to a temporary file and then move it into place so other processes
+    // never see a partially written file (the checksum catches it anyway)
+    auto temporaryFilename{ filename };
+    temporaryFilename += L"." + std::to_wstring(GetCurrentProcessId()) + L"." + std::to_wstring(GetCurrentThreadId()) + L".tmp";
+    {
+        wil::unique_hfile file{ ::CreateFileW(temporaryFilename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        if (!file)
+        {
+            THROW_LAST_ERROR_MSG("%ls", temporaryFilename.c_str());
+        }
+
+        DWORD bytesWritten{};
+        THROW_IF_WIN32_BOOL_FALSE_MSG(::WriteFile(file.get(), data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr), "%ls", temporaryFilename.c_str());
+    }
+    if (!::MoveFileExW(temporaryFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        const auto lastError{ GetLastError() };
+        ::DeleteFileW(temporaryFilename.c_str());
+        THROW_WIN32_MSG(lastError, "Error %d moving %ls", lastError, filename.c_str());
+    }
+}
+CATCH_LOG();
@@ -0,0 +1,31 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINRTMANIFESTCACHE_H)
+#define WINRTMANIFESTCACHE_H
+
+#include "WinRTManifestCacheFormat.h"
+
+namespace MddCore::WinRTManifestCache
+{
+    using Key = MddCore::WinRTManifestCacheFormat::Key;
+    using InprocModule = MddCore::WinRTManifestCacheFormat::InprocModule;
+
+    /// Identify the manifest's current content (without reading it). Returns false if the manifest can't be found.
+    bool GetKey(
+        PCWSTR packageFullName,
+        const std::filesystem::path& manifestFilename,
+        Key& key) noexcept;
+
+    /// Load the tables previously saved for key. Returns false if there are none (or they're not usable).
+    bool Load(
+        const Key& key,
+        std::vector<InprocModule>& inprocModules) noexcept;
+
+    /// Save the tables for key. Best effort; failures are logged and otherwise ignored.
+    void Save(
+        const Key& key,
+        const std::vector<InprocModule>& inprocModules) noexcept;
+}
+
+#endif // WINRTMANIFESTCACHE_H
@@ -0,0 +1,324 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINRTMANIFESTCACHEFORMAT_H)
+#define WINRTMANIFESTCACHEFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary format of the WinRT inproc server tables parsed from a package's appxmanifest.xml.
+//
+// This header only depends on the C++ standard library so the format can be exercised
+// anywhere, without Windows or a package. File I/O lives in WinRTManifestCache.cpp.
+//
+// All integers are little-endian. Strings are a uint32 count of UTF-16 code units followed by the code units.
+//
+//      uint32  magic
+//      uint32  version
+//      uint32  checksum (FNV-1a of everything after this field)
+//      uint64  manifest size (bytes)
+//      uint64  manifest last write time
+//      string  package full name
+//      uint32  module count
+//      per module:
+//          string  path (as written in the manifest i.e. relative to the package's root)
+//          uint32  activatable class count
+//          per activatable class:
+//              string  activatableClassId
+//              uint8   threading model (MddCore::WinRT::ThreadingModel)
+//
+// Tables are kept in the user's data store, which anything running as the user can write, so
+// Deserialize() only accepts paths that stay inside the package (see IsPackageRelativePath) and
+// threading models that exist.
+namespace MddCore::WinRTManifestCacheFormat
+{
+    constexpr uint32_t c_magic{ 0x5257444D };   // 'MDWR'
+    constexpr uint32_t c_version{ 1 };
+
+    // Identifies the manifest a table was parsed from. If the manifest's size or timestamp changes, the table's stale.
+    struct Key
+    {
+        std::wstring packageFullName;
+        uint64_t manifestSize{};
+        uint64_t manifestLastWriteTime{};
+    };
+
+    struct ActivatableClass
+    {
+        std::wstring activatableClassId;
+        uint8_t threadingModel{};
+    };
+
+    struct InprocModule
+    {
+        std::wstring path;
+        std::vector<ActivatableClass> activatableClasses;
+    };
+
+    // Valid threading models: MddCore::WinRT::ThreadingModel::Both, STA and MTA (not Unknown)
+    constexpr uint8_t c_minThreadingModel{ 1 };
+    constexpr uint8_t c_maxThreadingModel{ 3 };
+
+    /// True if the path stays inside the package's root when appended to it: not rooted, no drive
+    /// or stream (':'), and no '..' segments (nor anything Win32 path normalization turns into one,
+    /// i.e. only dots and spaces).
+    inline bool IsPackageRelativePath(std::wstring_view path)
+    {
+        if (path.empty() || (path.front() == L'\\') || (path.front() == L'/') || (path.find(L':') != std::wstring_view::npos))
+        {
+            return false;
+        }
+        size_t start{};
+        while (start <= path.size())
+        {
+            auto end{ path.find_first_of(L"\\/", start) };
+            if (end == std::wstring_view::npos)
+            {
+                end = path.size();
+            }
+            if (path.substr(start, end - start).find_first_not_of(L". ") == std::wstring_view::npos)
+            {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    namespace details
+    {
+        inline uint32_t Checksum(const uint8_t* data, size_t size)
+        {
+            uint32_t hash{ 2166136261u };
+            for (size_t index=0; index < size; ++index)
+            {
+                hash = (hash ^ data[index]) * 16777619u;
+            }
+            return hash;
+        }
+
+        class Writer
+        {
+        public:
+            void UInt8(uint8_t value)
+            {
+                m_data.push_back(value);
+            }
+
+            void UInt32(uint32_t value)
+            {
+                for (int shift=0; shift < 32; shift += 8)
+                {
+                    m_data.push_back(static_cast<uint8_t>(value >> shift));
+                }
+            }
+
+            void UInt64(uint64_t value)
+            {
+                UInt32(static_cast<uint32_t>(value));
+                UInt32(static_cast<uint32_t>(value >> 32));
+            }
+
+            void String(const std::wstring& value)
+            {
+                UInt32(static_cast<uint32_t>(value.length()));
+                for (const auto c : value)
+                {
+                    m_data.push_back(static_cast<uint8_t>(c));
+                    m_data.push_back(static_cast<uint8_t>(static_cast<uint16_t>(c) >> 8));
+                }
+            }
+
+            std::vector<uint8_t>& Data()
+            {
+                return m_data;
+            }
+
+        private:
+            std::vector<uint8_t> m_data;
+        };
+
+        class Reader
+        {
+        public:
+            Reader(const uint8_t* data, size_t size) :
+                m_data(data),
+                m_size(size)
+            {
+            }
+
+            bool UInt8(uint8_t& value)
+            {
+                if (m_size - m_offset < 1)
+                {
+                    return false;
+                }
+                value = m_data[m_offset++];
+                return true;
+            }
+
+            bool UInt32(uint32_t& value)
+            {
+                if (m_size - m_offset < 4)
+                {
+                    return false;
+                }
+                value = 0;
+                for (int shift=0; shift < 32; shift += 8)
+                {
+                    value |= static_cast<uint32_t>(m_data[m_offset++]) << shift;
+                }
+                return true;
+            }
+
+            bool UInt64(uint64_t& value)
+            {
+                uint32_t low{};
+                uint32_t high{};
+                if (!UInt32(low) || !UInt32(high))
+                {
+                    return false;
+                }
+                value = (static_cast<uint64_t>(high) << 32) | low;
+                return true;
+            }
+
+            bool String(std::wstring& value)
+            {
+                uint32_t length{};
+                if (!UInt32(length) || ((m_size - m_offset) / 2 < length))
+                {
+                    return false;
+                }
+                value.resize(length);
+                for (uint32_t index=0; index < length; ++index, m_offset += 2)
+                {
+                    value[index] = static_cast<wchar_t>(m_data[m_offset] | (m_data[m_offset + 1] << 8));
+                }
+                return true;
+            }
+
+            // Count of items still to be read must be plausible given the data left
+            bool Count(uint32_t& count, size_t minItemSize)
+            {
+                return UInt32(count) && ((m_size - m_offset) / minItemSize >= count);
+            }
+
+            size_t Offset() const
+            {
+                return m_offset;
+            }
+
+            bool AtEnd() const
+            {
+                return m_offset == m_size;
+            }
+
+        private:
+            const uint8_t* m_data{};
+            size_t m_size{};
+            size_t m_offset{};
+        };
+    }
+
+    inline std::vector<uint8_t> Serialize(
+        const Key& key,
+        const std::vector<InprocModule>& inprocModules)
+    {
+        details::Writer writer;
+        writer.UInt32(c_magic);
+        writer.UInt32(c_version);
+        writer.UInt32(0);   // checksum (below)
+        writer.UInt64(key.manifestSize);
+        writer.UInt64(key.manifestLastWriteTime);
+        writer.String(key.packageFullName);
+        writer.UInt32(static_cast<uint32_t>(inprocModules.size()));
+        for (const auto& inprocModule : inprocModules)
+        {
+            writer.String(inprocModule.path);
+            writer.UInt32(static_cast<uint32_t>(inprocModule.activatableClasses.size()));
+            for (const auto& activatableClass : inprocModule.activatableClasses)
+            {
+                writer.String(activatableClass.activatableClassId);
+                writer.UInt8(activatableClass.threadingModel);
+            }
+        }
+
+        auto& data{ writer.Data() };
+        const size_t c_checksumOffset{ 8 };
+        const auto checksum{ details::Checksum(data.data() + c_checksumOffset + 4, data.size() - c_checksumOffset - 4) };
+        for (int shift=0, index=0; shift < 32; shift += 8, ++index)
+        {
+            data[c_checksumOffset + index] = static_cast<uint8_t>(checksum >> shift);
+        }
+        return std::move(data);
+    }
+
+    // Returns false if the data isn't a well-formed table for key (e.g. corrupt, another version, or a stale manifest)
+    // or names a module outside the package.
+    inline bool Deserialize(
+        const uint8_t* data,
+        size_t size,
+        const Key& key,
+        std::vector<InprocModule>& inprocModules)
+    {
+        inprocModules.clear();
+
+        details::Reader reader(data, size);
+        uint32_t magic{};
+        uint32_t version{};
+        uint32_t checksum{};
+        if (!reader.UInt32(magic) || (magic != c_magic) ||
+            !reader.UInt32(version) || (version != c_version) ||
+            !reader.UInt32(checksum) || (checksum != details::Checksum(data + reader.Offset(), size - reader.Offset())))
+        {
+            return false;
+        }
+
+        Key foundKey;
+        if (!reader.UInt64(foundKey.manifestSize) || (foundKey.manifestSize != key.manifestSize) ||
+            !reader.UInt64(foundKey.manifestLastWriteTime) || (foundKey.manifestLastWriteTime != key.manifestLastWriteTime) ||
+            !reader.String(foundKey.packageFullName) || (foundKey.packageFullName != key.packageFullName))
+        {
+            return false;
+        }
+
+        // Smallest possible module = empty path (4) + class count (4). Smallest class = empty id (4) + threading model (1)
+        uint32_t moduleCount{};
+        if (!reader.Count(moduleCount, 8))
+        {
+            return false;
+        }
+        std::vector<InprocModule> foundInprocModules(moduleCount);
+        for (auto& inprocModule : foundInprocModules)
+        {
+            uint32_t activatableClassCount{};
+            if (!reader.String(inprocModule.path) || !IsPackageRelativePath(inprocModule.path) || !reader.Count(activatableClassCount, 5))
+            {
+                return false;
+            }
+            inprocModule.activatableClasses.resize(activatableClassCount);
+            for (auto& activatableClass : inprocModule.activatableClasses)
+            {
+                if (!reader.String(activatableClass.activatableClassId) || !reader.UInt8(activatableClass.threadingModel) ||
+                    (activatableClass.threadingModel < c_minThreadingModel) || (activatableClass.threadingModel > c_maxThreadingModel))
+                {
+                    return false;
+                }
+            }
+        }
+        if (!reader.AtEnd())
+        {
+            return false;
+        }
+
+        inprocModules = std::move(foundInprocModules);
+        return true;
+    }
+}
+
+#endif // WINRTMANIFESTCACHEFORMAT_H
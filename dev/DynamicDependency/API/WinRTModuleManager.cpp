@@ -5,70 +5,80 @@
 
 #include "WinRTModuleManager.h"
 
-std::recursive_mutex MddCore::WinRTModuleManager::s_lock;
+MddCore::WinRTActivatableClassIndex<MddCore::WinRTModuleManager::InprocServer> MddCore::WinRTModuleManager::s_inprocServers;
 std::vector<std::shared_ptr<MddCore::WinRTPackage>> MddCore::WinRTModuleManager::s_winrtPackages;
 
 bool MddCore::WinRTModuleManager::GetThreadingType(
     HSTRING className,
-    ABI::Windows::Foundation::ThreadingType& threadingType)
+    ABI::Windows::Foundation::ThreadingType& threadingType,
+    MddCore::WinRT::ResolvedClass* resolvedClass)
 {
-    auto lock{ std::unique_lock<std::recursive_mutex>(s_lock) };
+    auto lock{ s_inprocServers.Lock() };
 
-    auto threadingModel{ MddCore::WinRTModuleManager::GetThreadingModel(className) };
-    if (threadingModel == MddCore::WinRT::ThreadingModel::Unknown)
+    auto inprocServer{ Find(className) };
+    if (!inprocServer || (inprocServer->threadingModel == MddCore::WinRT::ThreadingModel::Unknown))
     {
         return false;
     }
 
-    THROW_IF_FAILED(ToThreadingType(threadingModel, threadingType));
+    THROW_IF_FAILED(ToThreadingType(inprocServer->threadingModel, threadingType));
+    if (resolvedClass)
+    {
+        resolvedClass->inprocServer = inprocServer;
+        resolvedClass->generation = s_inprocServers.Generation();
+    }
     return true;
-
 }
 
-MddCore::WinRT::ThreadingModel MddCore::WinRTModuleManager::GetThreadingModel(
-    HSTRING className)
+void* MddCore::WinRTModuleManager::GetActivationFactory(
+    HSTRING className,
+    REFIID iid,
+    const MddCore::WinRT::ResolvedClass* resolvedClass)
 {
-    if (!s_winrtPackages.empty())
+    auto lock{ s_inprocServers.Lock() };
+
+    // Use where GetThreadingType() found the class, unless the package graph's changed since
+    InprocServer* inprocServer{};
+    if (resolvedClass && resolvedClass->inprocServer && (resolvedClass->generation == s_inprocServers.Generation()))
     {
-        std::wstring activatableClassId{ WindowsGetStringRawBuffer(className, nullptr) };
-        for (auto& winrtPackage : s_winrtPackages)
+        inprocServer = static_cast<InprocServer*>(resolvedClass->inprocServer);
+    }
+    else
+    {
+        inprocServer = Find(className);
+        if (!inprocServer)
         {
-            auto threadingModel{ winrtPackage->GetThreadingModel(activatableClassId) };
-            if (threadingModel != MddCore::WinRT::ThreadingModel::Unknown)
-            {
-                return threadingModel;
-            }
+            return nullptr;
         }
     }
-    return MddCore::WinRT::ThreadingModel::Unknown;
-}
-
-void* MddCore::WinRTModuleManager::GetActivationFactory(
-    HSTRING className,
-    REFIID iid)
-{
-    auto lock{ std::unique_lock<std::recursive_mutex>(s_lock) };
 
-    if (!s_winrtPackages.empty())
+    auto activationFactory{ inprocServer->activationFactory };
+    if (!activationFactory)
     {
-        std::wstring activatableClassId{ WindowsGetStringRawBuffer(className, nullptr) };
-        for (auto& winrtPackage : s_winrtPackages)
+        activationFactory = inprocServer->inprocModule->GetActivationFactory(className);
+
+        // Agile factories can be handed to any caller on any thread so there's no need to ask the
+        // DLL again next time. Non-agile factories may be tied to the caller's apartment; don't keep them.
+        if (activationFactory.try_query<IAgileObject>())
         {
-            auto factory{ winrtPackage->GetActivationFactory(className, activatableClassId, iid) };
-            if (factory)
-            {
-                return factory;
-            }
+            inprocServer->activationFactory = activationFactory;
         }
     }
-    return nullptr;
+
+    //TODO change to return shared_ptr<inprocModule> rather than void*factory
+    //     so the object (and its DLL) isn't destroyed while upstack is calling the factory*.
+    //     Or perhaps caller's changed to return shared_ptr<winrtPackage>? TBD
+    void* factory{};
+    const auto hr{ activationFactory->QueryInterface(iid, &factory) };
+    THROW_IF_FAILED_MSG(hr, "Error 0x%X in ifactory->QueryInterface(%ls)", hr, WindowsGetStringRawBuffer(className, nullptr));
+    return factory;
 }
 
 void MddCore::WinRTModuleManager::Insert(
     size_t index,
     std::shared_ptr<MddCore::WinRTPackage>& winrtPackage)
 {
-    auto lock{ std::unique_lock<std::recursive_mutex>(s_lock) };
+    auto lock{ s_inprocServers.Lock() };
 
     if (index < s_winrtPackages.size())
     {
@@ -78,4 +88,40 @@ void MddCore::WinRTModuleManager::Insert(
     {
         s_winrtPackages.push_back(std::move(winrtPackage));
     }
+
+    RebuildIndex();
+}
+
+MddCore::WinRTModuleManager::InprocServer* MddCore::WinRTModuleManager::Find(
+    HSTRING className)
+{
+    // NOTE: Caller must hold s_inprocServers.Lock()
+
+    UINT32 length{};
+    auto buffer{ WindowsGetStringRawBuffer(className, &length) };
+    return s_inprocServers.Find(std::wstring_view(buffer, length));
+}
+
+void MddCore::WinRTModuleManager::RebuildIndex()
+{
+    // NOTE: Caller must hold s_inprocServers.Lock()
+
+    // Packages are in rank order and a package's modules are in manifest order.
+    // This also drops any cached factories, as a new package can take over a class.
+    s_inprocServers.Rebuild([](auto&& add)
+    {
+        for (auto& winrtPackage : s_winrtPackages)
+        {
+            for (auto& inprocModule : winrtPackage->InprocModules())
+            {
+                for (const auto& [activatableClassId, threadingModel] : inprocModule.InprocServers())
+                {
+                    InprocServer inprocServer;
+                    inprocServer.inprocModule = &inprocModule;
+                    inprocServer.threadingModel = threadingModel;
+                    add(activatableClassId, std::move(inprocServer));
+                }
+            }
+        }
+    });
 }
@@ -4,6 +4,7 @@
 #if !defined(WINRTMODULEMANAGER_H)
 #define WINRTMODULEMANAGER_H
 
+#include "WinRTActivatableClassIndex.h"
 #include "WinRTPackage.h"
 
 namespace MddCore
@@ -13,23 +14,36 @@ class WinRTModuleManager
 public:
     static bool GetThreadingType(
         HSTRING className,
-        ABI::Windows::Foundation::ThreadingType& threadingType);
+        ABI::Windows::Foundation::ThreadingType& threadingType,
+        MddCore::WinRT::ResolvedClass* resolvedClass = nullptr);
 
-private:
-    static MddCore::WinRT::ThreadingModel GetThreadingModel(
-        HSTRING className);
-
-public:
     static void* GetActivationFactory(
         HSTRING className,
-        REFIID iid);
+        REFIID iid,
+        const MddCore::WinRT::ResolvedClass* resolvedClass = nullptr);
 
     static void Insert(
         size_t index,
         std::shared_ptr<MddCore::WinRTPackage>& winrtPackage);
 
 private:
-    static std::recursive_mutex s_lock;
+    struct InprocServer
+    {
+        MddCore::WinRTInprocModule* inprocModule{};
+        MddCore::WinRT::ThreadingModel threadingModel{};
+
+        // Cached if the factory is agile (so it can be used from any apartment)
+        wil::com_ptr<IActivationFactory> activationFactory;
+    };
+
+    static InprocServer* Find(
+        HSTRING className);
+
+    static void RebuildIndex();
+
+private:
+    // The index's lock guards s_winrtPackages too
+    static MddCore::WinRTActivatableClassIndex<InprocServer> s_inprocServers;
     static std::vector<std::shared_ptr<MddCore::WinRTPackage>> s_winrtPackages;
 };
 }
@@ -5,55 +5,6 @@
 
 #include "WinRTPackage.h"
 
-MddCore::WinRT::ThreadingModel MddCore::WinRTPackage::GetThreadingModel(
-    const std::wstring& activatableClassId)
-{
-    // Find the activation factory
-    if (!m_inprocModules.empty())
-    {
-        for (size_t index = 0; index < m_inprocModules.size(); ++index)
-        {
-            auto& inprocModule{ m_inprocModules[index] };
-
-            auto threadingModel{ inprocModule.Find(activatableClassId) };
-            if (threadingModel != MddCore::WinRT::ThreadingModel::Unknown)
-            {
-                return threadingModel;
-            }
-        }
-    }
-
-    // Not found
-    return MddCore::WinRT::ThreadingModel::Unknown;
-}
-
-void* MddCore::WinRTPackage::GetActivationFactory(
-    HSTRING className,
-    const std::wstring& activatableClassId,
-    REFIID iid)
-{
-    // Find the activation factory
-    if (!m_inprocModules.empty())
-    {
-        for (size_t index = 0; index < m_inprocModules.size(); ++index)
-        {
-            auto& inprocModule{ m_inprocModules[index] };
-
-            auto threadingModel{ inprocModule.Find(activatableClassId) };
-            if (threadingModel != MddCore::WinRT::ThreadingModel::Unknown)
-            {
-                //TODO change to return shared_ptr<inprocModule> rather than void*factory
-                //     so the object (and its DLL) isn't destroyed while upstack is calling the factory*.
-                //     Or perhaps caller's changed to return shared_ptr<winrtPackage>? TBD
-                return inprocModule.GetActivationFactory(className, activatableClassId, iid);
-            }
-        }
-    }
-
-    // Not found
-    return nullptr;
-}
-
 /// Parse a package's appxmanifest for WinRT inproc server definitions e.g.
 /// ~~~~~
 /// <Extension Category="windows.inProcessServer"...>
@@ -73,10 +24,83 @@ void* MddCore::WinRTPackage::GetActivationFactory(
 /// <ActivatableClass>'s attributes:
 ///   * ActivatableClassId=string
 ///   * ThreadingModel = "both" | "STA" | "MTA"
+///
+/// Parsing is done synchronously when adding a package to the package graph, and the same
+/// (framework) packages are added over and over by many processes. So the results are saved
+/// in the user's data store and reused until the manifest changes.
 void MddCore::WinRTPackage::ParseAppxManifest()
 {
     std::filesystem::path filename{ m_packagePath };
     filename /= L"appxmanifest.xml";
+
+    MddCore::WinRTManifestCache::Key key;
+    const bool isCacheable{ MddCore::WinRTManifestCache::GetKey(m_packageFullName.c_str(), filename, key) };
+    if (isCacheable && LoadInprocModulesFromCache(key))
+    {
+        return;
+    }
+
+    ParseAppxManifest(filename);
+
+    if (isCacheable)
+    {
+        SaveInprocModulesToCache(key);
+    }
+}
+
+bool MddCore::WinRTPackage::LoadInprocModulesFromCache(
+    const MddCore::WinRTManifestCache::Key& key)
+{
+    std::vector<MddCore::WinRTManifestCache::InprocModule> cachedInprocModules;
+    if (!MddCore::WinRTManifestCache::Load(key, cachedInprocModules))
+    {
+        return false;
+    }
+
+    // Deserialize only accepts paths inside the package and known threading models, so these can't
+    // point outside m_packagePath (an absolute path would replace it) or at a bogus enumerator
+    for (const auto& cachedInprocModule : cachedInprocModules)
+    {
+        MddCore::WinRTInprocModule winrtInProcModule;
+        std::filesystem::path absoluteFilename{ m_packagePath };
+        absoluteFilename /= cachedInprocModule.path;
+        winrtInProcModule.Path(absoluteFilename);
+        for (const auto& activatableClass : cachedInprocModule.activatableClasses)
+        {
+            winrtInProcModule.AddInprocServer(activatableClass.activatableClassId, static_cast<MddCore::WinRT::ThreadingModel>(activatableClass.threadingModel));
+        }
+        AddInprocModule(winrtInProcModule);
+    }
+    return true;
+}
+
+void MddCore::WinRTPackage::SaveInprocModulesToCache(
+    const MddCore::WinRTManifestCache::Key& key)
+{
+    // Paths are saved relative to the package's root, as they're written in the manifest
+    std::vector<MddCore::WinRTManifestCache::InprocModule> cachedInprocModules;
+    for (const auto& inprocModule : m_inprocModules)
+    {
+        MddCore::WinRTManifestCache::InprocModule cachedInprocModule;
+        cachedInprocModule.path = std::filesystem::path(inprocModule.Path()).lexically_relative(m_packagePath).wstring();
+        if (!MddCore::WinRTManifestCacheFormat::IsPackageRelativePath(cachedInprocModule.path))
+        {
+            // LoadInprocModulesFromCache would reject it anyway
+            return;
+        }
+        for (const auto& [activatableClassId, threadingModel] : inprocModule.InprocServers())
+        {
+            cachedInprocModule.activatableClasses.push_back({ activatableClassId, static_cast<uint8_t>(threadingModel) });
+        }
+        cachedInprocModules.push_back(std::move(cachedInprocModule));
+    }
+
+    MddCore::WinRTManifestCache::Save(key, cachedInprocModules);
+}
+
+void MddCore::WinRTPackage::ParseAppxManifest(
+    const std::filesystem::path& filename)
+{
     wil::com_ptr<IStream> appxManifestStream;
     THROW_IF_FAILED_MSG(SHCreateStreamOnFileEx(filename.c_str(), STGM_READ, FILE_ATTRIBUTE_NORMAL, FALSE, nullptr, appxManifestStream.addressof()), "Error in SHCreateSreamOnFileEx(%ls)", filename.c_str());
 
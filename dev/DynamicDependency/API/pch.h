@@ -13,8 +13,12 @@
 #include <appmodel.h>
 #include <MsixDynamicDependency.h>
 
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <thread>
+#include <unordered_map>
 #include <mutex>
 
 #include <wil/cppwinrt.h>
@@ -3,13 +3,17 @@
 
 #include <Windows.h>
 #include <Pathcch.h>
+#include <aclapi.h> // GetSecurityInfo
+#include <sddl.h> // ConvertSidToStringSid etc.
 #include "wil/win32_helpers.h"
 #include "wil/filesystem.h"
+#include "wil/token_helpers.h"
 #include "mrm/BaseInternal.h"
 #include "mrm/common/platform.h"
 #include "mrm/readers/MrmReaders.h"
 #include "mrm/platform/WindowsCore.h"
 #include "mrm/readers/MrmManagers.h"
+#include "mrm/readers/SharedCache.h"
 
 #include "mrm/common/MrmTraceLogging.h"
 
@@ -19,21 +23,109 @@
 
 using namespace Microsoft::Resources;
 
+typedef struct
+{
+    volatile LONG64 count;
+    volatile LONG64 totalMicroseconds;
+    volatile LONG64 buckets[MRM_LATENCY_BUCKET_COUNT];
+} MrmLatencyCounters;
+
+typedef struct
+{
+    MrmLatencyCounters mapLookup;
+    MrmLatencyCounters decisionEvaluation;
+    MrmLatencyCounters valueExtraction;
+    volatile LONG64 sharedResolutionCacheHits;
+    volatile LONG64 sharedResolutionCacheMisses;
+    volatile LONG64 bytesCopied;
+    ResolverStatistics resolver;
+} MrmStatisticsCounters;
+
 typedef struct
 {
     CoreProfile* profile = nullptr;
     UnifiedResourceView* unifiedView = nullptr;
     const PriFile* priFile = nullptr;
     ProviderResolver* resolver = nullptr;
+    SharedResolutionCache* sharedCache = nullptr;
+    UINT64 priFileIdentity = 0;
+
+    // statistics is null while statistics are disabled; statisticsStorage keeps the counters alive
+    // for the lifetime of the manager once they've been enabled.
+    MrmStatisticsCounters* volatile statistics = nullptr;
+    MrmStatisticsCounters* volatile statisticsStorage = nullptr;
+    UINT64 priLoadMicroseconds = 0;
 } MrmObjects;
 
+typedef struct
+{
+    MrmObjects* resourceManager = nullptr;
+    ProviderResolver* resolver = nullptr;
+    ResourceMapSubtreeEnumerator* enumerator = nullptr;
+} MrmEnumeratorObjects;
+
 constexpr wchar_t ResourceUriPrefix[] = L"ms-resource://";
 constexpr int ResourceUriPrefixLength = ARRAYSIZE(ResourceUriPrefix) - 1;
 constexpr wchar_t c_defaultPriFilename[] = L"resources.pri";
+constexpr wchar_t c_defaultSharedCacheName[] = L"Local\\MrmSharedResolutionCache";
 
 #define INDEX_RESOURCE_ID -1
 #define INDEX_RESOURCE_URI -2
 
+static UINT64 GetElapsedMicroseconds(_In_ const LARGE_INTEGER& start)
+{
+    static const LONGLONG frequency = []() {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }();
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return static_cast<UINT64>(((now.QuadPart - start.QuadPart) * 1000000) / frequency);
+}
+
+static void RecordLatency(_Inout_ MrmLatencyCounters* counters, UINT64 microseconds)
+{
+    int bucket = 0;
+    while ((bucket < MRM_LATENCY_BUCKET_COUNT - 1) && (microseconds >= (1ull << bucket)))
+    {
+        bucket++;
+    }
+
+    InterlockedIncrement64(&counters->count);
+    InterlockedExchangeAdd64(&counters->totalMicroseconds, static_cast<LONG64>(microseconds));
+    InterlockedIncrement64(&counters->buckets[bucket]);
+}
+
+// Times a scope into a latency histogram. Does nothing beyond a null check when given no counters.
+class StatisticsTimer
+{
+public:
+    explicit StatisticsTimer(_In_opt_ MrmLatencyCounters* counters) : m_counters(counters)
+    {
+        if (m_counters != nullptr)
+        {
+            QueryPerformanceCounter(&m_start);
+        }
+    }
+
+    ~StatisticsTimer() { Stop(); }
+
+    void Stop()
+    {
+        if (m_counters != nullptr)
+        {
+            RecordLatency(m_counters, GetElapsedMicroseconds(m_start));
+            m_counters = nullptr;
+        }
+    }
+
+private:
+    MrmLatencyCounters* m_counters;
+    LARGE_INTEGER m_start;
+};
+
 static HRESULT StringResultReleaseOwnershipBuffer(_Inout_ StringResult& result, _Outptr_ PWSTR* buffer)
 {
     size_t localStringLength;
@@ -152,6 +244,86 @@ static HRESULT GetQualifierInfoFromCandidate(
     return hr;
 }
 
+static HRESULT ResolveNamedResource(
+    _In_ ProviderResolver* resolver,
+    _In_ const NamedResourceResult* namedResource,
+    _Out_ ResourceCandidateResult* resourceCandidate)
+{
+    DecisionResult decision;
+    RETURN_IF_FAILED(namedResource->GetDecision(&decision));
+
+    QualifierSetResult qualifierSet;
+    int resultIndex;
+    RETURN_IF_FAILED(resolver->EvaluateDecision(&decision, &resultIndex, &qualifierSet));
+
+    bool isMatch, isDefault, isMatchAsDefault;
+    RETURN_IF_FAILED(resolver->EvaluateQualifierSet(&qualifierSet, &isMatch, &isDefault, &isMatchAsDefault, nullptr));
+
+    if (!isMatch && !isDefault)
+    {
+        return HRESULT_FROM_WIN32(ERROR_MRM_NO_MATCH_OR_DEFAULT_CANDIDATE);
+    }
+
+    RETURN_IF_FAILED(namedResource->GetCandidate(resultIndex, resourceCandidate));
+    return S_OK;
+}
+
+static UINT32 GetSharedCacheMapIdentity(_In_ const NamedResourceResult* namedResource)
+{
+    // FNV-1a over the unique ID of the schema that owns the resource.
+    const IHierarchicalSchema* schema = namedResource->GetParentSchema();
+    PCWSTR uniqueId = (schema != nullptr) ? schema->GetUniqueId() : nullptr;
+
+    UINT32 hash = 2166136261u;
+    for (PCWSTR ch = uniqueId; (ch != nullptr) && (*ch != L'\0'); ch++)
+    {
+        hash = (hash ^ *ch) * 16777619u;
+    }
+    return hash;
+}
+
+static HRESULT ResolveNamedResourceWithSharedCache(
+    _In_ MrmObjects* resourceManagerObjects,
+    _In_ ProviderResolver* resolver,
+    _In_ const NamedResourceResult* namedResource,
+    _Out_ ResourceCandidateResult* resourceCandidate)
+{
+    SharedResolutionCache* sharedCache = resourceManagerObjects->sharedCache;
+
+    SharedResolutionCacheKey key;
+    if ((sharedCache == nullptr) || FAILED(resolver->GetContextSignature(&key.contextSignature)))
+    {
+        return ResolveNamedResource(resolver, namedResource, resourceCandidate);
+    }
+
+    key.fileIdentity = resourceManagerObjects->priFileIdentity;
+    key.mapIdentity = GetSharedCacheMapIdentity(namedResource);
+    key.resourceIndex = namedResource->GetResourceIndexInSchema();
+
+    // Another process may have put anything in the shared region, so GetCandidate's range
+    // check is what makes a hit safe to use.
+    MrmStatisticsCounters* statistics = resourceManagerObjects->statistics;
+
+    int candidateIndex;
+    if (sharedCache->TryGetCandidateIndex(&key, &candidateIndex) && SUCCEEDED(namedResource->GetCandidate(candidateIndex, resourceCandidate)))
+    {
+        if (statistics != nullptr)
+        {
+            InterlockedIncrement64(&statistics->sharedResolutionCacheHits);
+        }
+        return S_OK;
+    }
+
+    if (statistics != nullptr)
+    {
+        InterlockedIncrement64(&statistics->sharedResolutionCacheMisses);
+    }
+
+    RETURN_IF_FAILED(ResolveNamedResource(resolver, namedResource, resourceCandidate));
+    sharedCache->SetCandidateIndex(&key, resourceCandidate->GetCandidateIndex());
+    return S_OK;
+}
+
 static HRESULT LoadResourceCandidate(
     _In_ void* resourceManager,
     _In_opt_ void* resourceContext,
@@ -199,6 +371,15 @@ static HRESULT LoadResourceCandidate(
         resolver = reinterpret_cast<ProviderResolver*>(resourceContext);
     }
 
+    MrmStatisticsCounters* statistics = resourceManagerObjects->statistics;
+    ResolverStatistics* resolverStatistics = (statistics != nullptr) ? &statistics->resolver : nullptr;
+    if (resolver->GetStatistics() != resolverStatistics)
+    {
+        // Contexts pick up (or drop) the manager's counters the first time they're used after a change.
+        resolver->SetStatistics(resolverStatistics);
+    }
+
+    StatisticsTimer mapLookupTimer((statistics != nullptr) ? &statistics->mapLookup : nullptr);
     NamedResourceResult namedResource;
 
     if (index == INDEX_RESOURCE_URI)
@@ -294,22 +475,11 @@ static HRESULT LoadResourceCandidate(
         }
     }
 
-    DecisionResult decision;
-    RETURN_IF_FAILED(namedResource.GetDecision(&decision));
+    mapLookupTimer.Stop();
 
-    QualifierSetResult qualifierSet;
-    int resultIndex;
-    RETURN_IF_FAILED(resolver->EvaluateDecision(&decision, &resultIndex, &qualifierSet));
-
-    bool isMatch, isDefault, isMatchAsDefault;
-    RETURN_IF_FAILED(resolver->EvaluateQualifierSet(&qualifierSet, &isMatch, &isDefault, &isMatchAsDefault, nullptr));
-
-    if (!isMatch && !isDefault)
-    {
-        return HRESULT_FROM_WIN32(ERROR_MRM_NO_MATCH_OR_DEFAULT_CANDIDATE);
-    }
-
-    RETURN_IF_FAILED(namedResource.GetCandidate(resultIndex, resourceCandidate));
+    StatisticsTimer decisionTimer((statistics != nullptr) ? &statistics->decisionEvaluation : nullptr);
+    RETURN_IF_FAILED(ResolveNamedResourceWithSharedCache(resourceManagerObjects, resolver, &namedResource, resourceCandidate));
+    decisionTimer.Stop();
 
     if ((qualifierCount != nullptr) && (qualifierNames != nullptr) && (qualifierValues != nullptr))
     {
@@ -339,6 +509,9 @@ static HRESULT LoadStringResource(
     RETURN_IF_FAILED_WITH_EXPECTED(LoadResourceCandidate(resourceManager, resourceContext, resourceMap, index, resourceIdOrUri, &candidate, nullptr, nullptr, nullptr, nullptr),
         HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND));
 
+    MrmStatisticsCounters* statistics = reinterpret_cast<MrmObjects*>(resourceManager)->statistics;
+    StatisticsTimer extractionTimer((statistics != nullptr) ? &statistics->valueExtraction : nullptr);
+
     StringResult stringResult;
     if (!candidate.TryGetStringValue(&stringResult))
     {
@@ -348,6 +521,10 @@ static HRESULT LoadStringResource(
     // This ensures the string result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
     RETURN_IF_FAILED(StringResultReleaseOwnershipBuffer(stringResult, resourceString));
 
+    if (statistics != nullptr)
+    {
+        InterlockedExchangeAdd64(&statistics->bytesCopied, static_cast<LONG64>((wcslen(*resourceString) + 1) * sizeof(wchar_t)));
+    }
     return S_OK;
 }
 
@@ -366,6 +543,9 @@ static HRESULT LoadEmbeddedResource(
     RETURN_IF_FAILED_WITH_EXPECTED(LoadResourceCandidate(resourceManager, resourceContext, resourceMap, index, resourceIdOrUri, &candidate, nullptr, nullptr, nullptr, nullptr),
         HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND));
 
+    MrmStatisticsCounters* statistics = reinterpret_cast<MrmObjects*>(resourceManager)->statistics;
+    StatisticsTimer extractionTimer((statistics != nullptr) ? &statistics->valueExtraction : nullptr);
+
     BlobResult blobResult;
     if (!candidate.TryGetBlobValue(&blobResult))
     {
@@ -375,49 +555,26 @@ static HRESULT LoadEmbeddedResource(
     // This ensures the blob result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
     RETURN_IF_FAILED(BlobResultReleaseOwnershipBuffer(blobResult, &data->data, &data->size));
 
+    if (statistics != nullptr)
+    {
+        InterlockedExchangeAdd64(&statistics->bytesCopied, data->size);
+    }
     return S_OK;
 }
 
-static HRESULT LoadStringOrEmbeddedResource(
-    _In_ void* resourceManager,
-    _In_opt_ void* resourceContext,
-    _In_opt_ void* resourceMap,
-    int index,
-    _In_opt_ PCWSTR resourceIdOrUri,
+static HRESULT GetStringOrEmbeddedValue(
+    _In_ const ResourceCandidateResult* candidate,
     _Out_ MrmType* resourceType,
     _Outptr_result_maybenull_ PWSTR* resourceString,
-    _Out_ MrmResourceData* data,
-    _Outptr_opt_result_maybenull_ PWSTR* resourceName,
-    _Out_opt_ UINT32* qualifierCount, 
-    _Outptr_opt_result_buffer_(*qualifierCount) PWSTR** qualifierNames,
-    _Outptr_opt_result_buffer_(*qualifierCount) PWSTR** qualifierValues)
+    _Out_ MrmResourceData* data)
 {
-    data->data = nullptr;
-    data->size = 0;
-
-    ResourceCandidateResult candidate;
-    PWSTR localName = nullptr;
-    RETURN_IF_FAILED_WITH_EXPECTED(LoadResourceCandidate(
-        resourceManager, 
-        resourceContext, 
-        resourceMap, 
-        index, 
-        resourceIdOrUri, 
-        &candidate, 
-        &localName,
-        qualifierCount,
-        qualifierNames,
-        qualifierValues), 
-        HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND));
-    std::unique_ptr<wchar_t[], decltype(&MrmFreeResource)> name(localName, MrmFreeResource);
-
     MrmEnvironment::ResourceValueType internalResourceType;
-    RETURN_IF_FAILED(candidate.GetResourceValueType(&internalResourceType));
+    RETURN_IF_FAILED(candidate->GetResourceValueType(&internalResourceType));
 
     if (MrmEnvironment::IsBinaryResourceValueType(internalResourceType))
     {
         BlobResult blobResult;
-        if (!candidate.TryGetBlobValue(&blobResult))
+        if (!candidate->TryGetBlobValue(&blobResult))
         {
             return E_UNEXPECTED;
         }
@@ -431,7 +588,7 @@ static HRESULT LoadStringOrEmbeddedResource(
     else
     {
         StringResult stringResult;
-        if (!candidate.TryGetStringValue(&stringResult))
+        if (!candidate->TryGetStringValue(&stringResult))
         {
             return E_UNEXPECTED;
         }
@@ -453,6 +610,53 @@ static HRESULT LoadStringOrEmbeddedResource(
         }
     }
 
+    return S_OK;
+}
+
+static HRESULT LoadStringOrEmbeddedResource(
+    _In_ void* resourceManager,
+    _In_opt_ void* resourceContext,
+    _In_opt_ void* resourceMap,
+    int index,
+    _In_opt_ PCWSTR resourceIdOrUri,
+    _Out_ MrmType* resourceType,
+    _Outptr_result_maybenull_ PWSTR* resourceString,
+    _Out_ MrmResourceData* data,
+    _Outptr_opt_result_maybenull_ PWSTR* resourceName,
+    _Out_opt_ UINT32* qualifierCount, 
+    _Outptr_opt_result_buffer_(*qualifierCount) PWSTR** qualifierNames,
+    _Outptr_opt_result_buffer_(*qualifierCount) PWSTR** qualifierValues)
+{
+    data->data = nullptr;
+    data->size = 0;
+
+    ResourceCandidateResult candidate;
+    PWSTR localName = nullptr;
+    RETURN_IF_FAILED_WITH_EXPECTED(LoadResourceCandidate(
+        resourceManager, 
+        resourceContext, 
+        resourceMap, 
+        index, 
+        resourceIdOrUri, 
+        &candidate, 
+        &localName,
+        qualifierCount,
+        qualifierNames,
+        qualifierValues), 
+        HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND));
+    std::unique_ptr<wchar_t[], decltype(&MrmFreeResource)> name(localName, MrmFreeResource);
+
+    MrmStatisticsCounters* statistics = reinterpret_cast<MrmObjects*>(resourceManager)->statistics;
+    StatisticsTimer extractionTimer((statistics != nullptr) ? &statistics->valueExtraction : nullptr);
+
+    RETURN_IF_FAILED(GetStringOrEmbeddedValue(&candidate, resourceType, resourceString, data));
+
+    if (statistics != nullptr)
+    {
+        LONG64 bytesCopied = (*resourceString != nullptr) ? static_cast<LONG64>((wcslen(*resourceString) + 1) * sizeof(wchar_t)) : data->size;
+        InterlockedExchangeAdd64(&statistics->bytesCopied, bytesCopied);
+    }
+
     if (resourceName != nullptr)
     {
         *resourceName = name.release();
@@ -483,6 +687,19 @@ static void DestroyResourceManager(_In_ void* resourceManager)
         resourceManagerObjects->resolver = nullptr;
     }
 
+    if (resourceManagerObjects->sharedCache != nullptr)
+    {
+        delete resourceManagerObjects->sharedCache;
+        resourceManagerObjects->sharedCache = nullptr;
+    }
+
+    resourceManagerObjects->statistics = nullptr;
+    if (resourceManagerObjects->statisticsStorage != nullptr)
+    {
+        delete resourceManagerObjects->statisticsStorage;
+        resourceManagerObjects->statisticsStorage = nullptr;
+    }
+
     delete resourceManagerObjects;
 
     return;
@@ -503,6 +720,9 @@ STDAPI MrmCreateResourceManager(_In_ PCWSTR priFileName, _Out_ MrmManagerHandle*
     RETURN_IF_FAILED(CoreProfile::ChooseDefaultProfile(&resourceManagerObjects->profile));
     RETURN_IF_FAILED(UnifiedResourceView::CreateInstance(resourceManagerObjects->profile, &resourceManagerObjects->unifiedView));
 
+    LARGE_INTEGER loadStart;
+    QueryPerformanceCounter(&loadStart);
+
     HRESULT hr = S_OK;
     if (wcschr(priFileName, L'\\') == nullptr)
     {
@@ -519,6 +739,8 @@ STDAPI MrmCreateResourceManager(_In_ PCWSTR priFileName, _Out_ MrmManagerHandle*
     }
     RETURN_IF_FAILED(hr);
 
+    resourceManagerObjects->priLoadMicroseconds = GetElapsedMicroseconds(loadStart);
+
     const IResourceMapBase* primaryMap;
     RETURN_IF_FAILED(resourceManagerObjects->priFile->GetPrimaryResourceMap(&primaryMap));
 
@@ -543,6 +765,196 @@ STDAPI_(void) MrmDestroyResourceManager(MrmManagerHandle resourceManager)
     return;
 }
 
+static DWORD GetIntegrityLevel(_In_ PSID labelSid)
+{
+    UCHAR subAuthorityCount = *GetSidSubAuthorityCount(labelSid);
+    return (subAuthorityCount > 0) ? *GetSidSubAuthority(labelSid, subAuthorityCount - 1) : SECURITY_MANDATORY_UNTRUSTED_RID;
+}
+
+// Anything that can write the shared cache decides which candidates every process sharing it
+// gets, so it's only shared between processes running as the same user at the same integrity
+// level. The section is created so that only they can open it, and one created by anyone else
+// (say, a process at lower integrity that got to the name first) isn't used.
+static HRESULT CreateSharedCacheStorage(_In_opt_ PCWSTR cacheName, _Outptr_ NamedSharedMemoryStorage** result)
+{
+    *result = nullptr;
+
+    wistd::unique_ptr<TOKEN_USER> user;
+    RETURN_IF_FAILED(wil::get_token_information_nothrow(user, GetCurrentProcessToken()));
+    wistd::unique_ptr<TOKEN_MANDATORY_LABEL> label;
+    RETURN_IF_FAILED(wil::get_token_information_nothrow(label, GetCurrentProcessToken()));
+
+    wil::unique_hlocal_string userSid;
+    RETURN_IF_WIN32_BOOL_FALSE(ConvertSidToStringSidW(user->User.Sid, &userSid));
+    wil::unique_hlocal_string integritySid;
+    RETURN_IF_WIN32_BOOL_FALSE(ConvertSidToStringSidW(label->Label.Sid, &integritySid));
+
+    // Owned by and only accessible to the user, and nothing below our integrity level can write it
+    std::wstring sddl = std::wstring(L"O:") + userSid.get() + L"D:P(A;;GA;;;" + userSid.get() + L")S:(ML;;NW;;;" + integritySid.get() + L")";
+    wil::unique_hlocal_security_descriptor securityDescriptor;
+    RETURN_IF_WIN32_BOOL_FALSE(ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1, &securityDescriptor, nullptr));
+    SECURITY_ATTRIBUTES securityAttributes = { sizeof(securityAttributes), securityDescriptor.get(), FALSE };
+
+    // The default cache is named for both so that processes that can't share it don't collide.
+    std::wstring defaultName;
+    if (cacheName == nullptr)
+    {
+        defaultName = std::wstring(c_defaultSharedCacheName) + L"_" + userSid.get() + L"_" + integritySid.get();
+        cacheName = defaultName.c_str();
+    }
+
+    AutoDeletePtr<NamedSharedMemoryStorage> storage;
+    RETURN_IF_FAILED(NamedSharedMemoryStorage::CreateInstance(cacheName, &securityAttributes, SharedResolutionCache::DefaultRegionSizeInBytes, &storage));
+
+    // If the section already existed, whoever created it chose its security.
+    PSID owner = nullptr;
+    PACL sacl = nullptr;
+    wil::unique_hlocal_security_descriptor existingSecurityDescriptor;
+    RETURN_IF_WIN32_ERROR(GetSecurityInfo(
+        storage->GetMappingHandle(),
+        SE_KERNEL_OBJECT,
+        OWNER_SECURITY_INFORMATION | LABEL_SECURITY_INFORMATION,
+        &owner,
+        nullptr,
+        nullptr,
+        &sacl,
+        &existingSecurityDescriptor));
+    RETURN_HR_IF(E_ACCESSDENIED, (owner == nullptr) || !EqualSid(owner, user->User.Sid));
+
+    // Objects without a label are treated as medium integrity.
+    DWORD integrityLevel = SECURITY_MANDATORY_MEDIUM_RID;
+    for (DWORD aceIndex = 0; (sacl != nullptr) && (aceIndex < sacl->AceCount); aceIndex++)
+    {
+        ACE_HEADER* aceHeader = nullptr;
+        RETURN_IF_WIN32_BOOL_FALSE(GetAce(sacl, aceIndex, reinterpret_cast<LPVOID*>(&aceHeader)));
+        if (aceHeader->AceType == SYSTEM_MANDATORY_LABEL_ACE_TYPE)
+        {
+            integrityLevel = GetIntegrityLevel(&reinterpret_cast<SYSTEM_MANDATORY_LABEL_ACE*>(aceHeader)->SidStart);
+            break;
+        }
+    }
+    RETURN_HR_IF(E_ACCESSDENIED, integrityLevel != GetIntegrityLevel(label->Label.Sid));
+
+    *result = storage.Detach();
+    return S_OK;
+}
+
+STDAPI MrmEnableSharedResolutionCache(_In_ MrmManagerHandle resourceManager, _In_opt_ PCWSTR cacheName)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, resourceManager);
+    RETURN_HR_IF(E_INVALIDARG, (cacheName != nullptr) && (*cacheName == L'\0'));
+
+    MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED), resourceManagerObjects->sharedCache != nullptr);
+
+    // Entries are only shared between managers that loaded byte-identical PRI files.
+    const BaseFile* baseFile;
+    RETURN_IF_FAILED(resourceManagerObjects->priFile->GetBaseFile(&baseFile));
+    UINT32 fileSize = baseFile->GetFileHeader()->cbTotal;
+    DEF_CHECKSUM fileChecksum = DefChecksum::ComputeChecksum(0, reinterpret_cast<const BYTE*>(baseFile->GetFileHeader()), fileSize);
+
+    AutoDeletePtr<NamedSharedMemoryStorage> storage;
+    RETURN_IF_FAILED(CreateSharedCacheStorage(cacheName, &storage));
+
+    SharedResolutionCache* sharedCache;
+    RETURN_IF_FAILED(SharedResolutionCache::CreateInstance(storage, true, &sharedCache));
+    storage.Detach();
+
+    resourceManagerObjects->priFileIdentity = (static_cast<UINT64>(fileChecksum) << 32) | fileSize;
+    resourceManagerObjects->sharedCache = sharedCache;
+    return S_OK;
+}
+
+STDAPI MrmEnableStatistics(_In_ MrmManagerHandle resourceManager, BOOL enable)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, resourceManager);
+
+    MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
+    if (!enable)
+    {
+        resourceManagerObjects->statistics = nullptr;
+        resourceManagerObjects->resolver->SetStatistics(nullptr);
+        return S_OK;
+    }
+
+    MrmStatisticsCounters* statisticsStorage = resourceManagerObjects->statisticsStorage;
+    if (statisticsStorage == nullptr)
+    {
+        // Statistics may be enabled on several threads at once; the first to publish its counters wins.
+        MrmStatisticsCounters* newStorage = new (std::nothrow) MrmStatisticsCounters();
+        RETURN_IF_NULL_ALLOC(newStorage);
+        statisticsStorage = static_cast<MrmStatisticsCounters*>(
+            InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&resourceManagerObjects->statisticsStorage), newStorage, nullptr));
+        if (statisticsStorage == nullptr)
+        {
+            statisticsStorage = newStorage;
+        }
+        else
+        {
+            delete newStorage;
+        }
+    }
+
+    // Lookups running on other threads pick the counters up (or stop using them) on their next measurement.
+    resourceManagerObjects->resolver->SetStatistics(&statisticsStorage->resolver);
+    resourceManagerObjects->statistics = statisticsStorage;
+    return S_OK;
+}
+
+static void CopyLatencyCounters(_In_ const MrmLatencyCounters* counters, _Out_ MrmLatencyHistogram* histogram)
+{
+    histogram->count = static_cast<UINT64>(counters->count);
+    histogram->totalMicroseconds = static_cast<UINT64>(counters->totalMicroseconds);
+    for (int i = 0; i < MRM_LATENCY_BUCKET_COUNT; i++)
+    {
+        histogram->buckets[i] = static_cast<UINT64>(counters->buckets[i]);
+    }
+}
+
+STDAPI MrmGetStatistics(_In_ MrmManagerHandle resourceManager, _Out_ MrmStatistics* statistics)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, statistics);
+    ZeroMemory(statistics, sizeof(*statistics));
+    RETURN_HR_IF_NULL(E_INVALIDARG, resourceManager);
+
+    MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
+    statistics->priLoadMicroseconds = resourceManagerObjects->priLoadMicroseconds;
+
+    const MrmStatisticsCounters* counters = resourceManagerObjects->statisticsStorage;
+    if (counters == nullptr)
+    {
+        // Never enabled, so there is nothing to report beyond the load time.
+        return S_OK;
+    }
+
+    CopyLatencyCounters(&counters->mapLookup, &statistics->mapLookup);
+    CopyLatencyCounters(&counters->decisionEvaluation, &statistics->decisionEvaluation);
+    CopyLatencyCounters(&counters->valueExtraction, &statistics->valueExtraction);
+    statistics->sharedResolutionCache.hits = static_cast<UINT64>(counters->sharedResolutionCacheHits);
+    statistics->sharedResolutionCache.misses = static_cast<UINT64>(counters->sharedResolutionCacheMisses);
+    statistics->decisionCache.hits = static_cast<UINT64>(counters->resolver.decisionCacheHits);
+    statistics->decisionCache.misses = static_cast<UINT64>(counters->resolver.decisionCacheMisses);
+    statistics->qualifierSetCache.hits = static_cast<UINT64>(counters->resolver.qualifierSetCacheHits);
+    statistics->qualifierSetCache.misses = static_cast<UINT64>(counters->resolver.qualifierSetCacheMisses);
+    statistics->qualifierCache.hits = static_cast<UINT64>(counters->resolver.qualifierCacheHits);
+    statistics->qualifierCache.misses = static_cast<UINT64>(counters->resolver.qualifierCacheMisses);
+    statistics->bytesCopied = static_cast<UINT64>(counters->bytesCopied);
+    return S_OK;
+}
+
+STDAPI MrmResetStatistics(_In_ MrmManagerHandle resourceManager)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, resourceManager);
+
+    MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
+    if (resourceManagerObjects->statisticsStorage != nullptr)
+    {
+        // Updates racing with the reset may land on either side of it.
+        ZeroMemory(resourceManagerObjects->statisticsStorage, sizeof(*resourceManagerObjects->statisticsStorage));
+    }
+    return S_OK;
+}
+
 STDAPI MrmCreateResourceContext(_In_ MrmManagerHandle resourceManager, _Out_ MrmContextHandle* resourceContext)
 {
     MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
@@ -854,6 +1266,204 @@ STDAPI MrmLoadStringOrEmbeddedResourceByIndexWithQualifierValues(
     return S_OK;
 }
 
+static HRESULT GetResourceMapSubtree(_In_ MrmObjects* resourceManagerObjects, _In_opt_ MrmMapHandle resourceMap, _Out_ const ResourceMapSubtree** mapSubtree)
+{
+    if (resourceMap == nullptr)
+    {
+        const IResourceMapBase* internalResourceMap;
+        RETURN_IF_FAILED(resourceManagerObjects->priFile->GetPrimaryResourceMap(&internalResourceMap));
+
+        *mapSubtree = internalResourceMap->GetRootSubtree();
+    }
+    else
+    {
+        *mapSubtree = reinterpret_cast<ResourceMapSubtree*>(resourceMap);
+    }
+
+    return S_OK;
+}
+
+static HRESULT CreateResourceEnumerator(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_opt_ MrmMapHandle resourceMap,
+    _In_opt_ PCWSTR prefix,
+    MrmPrefixMatchFlags flags,
+    _Out_ MrmResourceEnumeratorHandle* enumerator)
+{
+    *enumerator = nullptr;
+    RETURN_HR_IF_NULL(E_INVALIDARG, resourceManager);
+    RETURN_HR_IF(E_INVALIDARG, (flags & ~MrmPrefixMatch_CaseSensitive) != 0);
+
+    MrmObjects* resourceManagerObjects = reinterpret_cast<MrmObjects*>(resourceManager);
+
+    std::unique_ptr<MrmEnumeratorObjects> enumeratorObjects(new (std::nothrow) MrmEnumeratorObjects());
+    RETURN_IF_NULL_ALLOC(enumeratorObjects);
+
+    enumeratorObjects->resourceManager = resourceManagerObjects;
+    enumeratorObjects->resolver =
+        (resourceContext != nullptr) ? reinterpret_cast<ProviderResolver*>(resourceContext) : resourceManagerObjects->resolver;
+
+    const ResourceMapSubtree* mapSubtree;
+    RETURN_IF_FAILED(GetResourceMapSubtree(resourceManagerObjects, resourceMap, &mapSubtree));
+    if (prefix == nullptr)
+    {
+        RETURN_IF_FAILED(ResourceMapSubtreeEnumerator::CreateInstance(mapSubtree, &enumeratorObjects->enumerator));
+    }
+    else
+    {
+        RETURN_IF_FAILED(ResourceMapSubtreeEnumerator::CreateInstance(
+            mapSubtree, prefix, (flags & MrmPrefixMatch_CaseSensitive) != 0, &enumeratorObjects->enumerator));
+    }
+
+    *enumerator = reinterpret_cast<MrmResourceEnumeratorHandle>(enumeratorObjects.release());
+    return S_OK;
+}
+
+STDAPI MrmCreateResourceEnumerator(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_opt_ MrmMapHandle resourceMap,
+    _Out_ MrmResourceEnumeratorHandle* enumerator)
+{
+    return CreateResourceEnumerator(resourceManager, resourceContext, resourceMap, nullptr, MrmPrefixMatch_Default, enumerator);
+}
+
+STDAPI MrmCreateResourceEnumeratorForPrefix(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_opt_ MrmMapHandle resourceMap,
+    _In_ PCWSTR prefix,
+    MrmPrefixMatchFlags flags,
+    _Out_ MrmResourceEnumeratorHandle* enumerator)
+{
+    *enumerator = nullptr;
+    RETURN_HR_IF_NULL(E_INVALIDARG, prefix);
+
+    return CreateResourceEnumerator(resourceManager, resourceContext, resourceMap, prefix, flags, enumerator);
+}
+
+static HRESULT GetNextResourceEntry(_In_ MrmEnumeratorObjects* enumeratorObjects, _Out_ MrmResourceEntry* entry)
+{
+    ResourceMapSubtreeEnumerator* cursor = enumeratorObjects->enumerator;
+    entry->index = static_cast<UINT32>(cursor->GetCurrentIndex());
+
+    StringResult nameResult;
+    RETURN_IF_FAILED(cursor->GetCurrentName(&nameResult));
+    RETURN_IF_FAILED(StringResultReleaseOwnershipBuffer(nameResult, &entry->resourceName));
+
+    NamedResourceResult namedResource;
+    RETURN_IF_FAILED(cursor->GetCurrentResource(&namedResource));
+
+    ResourceCandidateResult candidate;
+    HRESULT hr = ResolveNamedResourceWithSharedCache(enumeratorObjects->resourceManager, enumeratorObjects->resolver, &namedResource, &candidate);
+    if (hr == HRESULT_FROM_WIN32(ERROR_MRM_NO_MATCH_OR_DEFAULT_CANDIDATE))
+    {
+        // One resource without a value for this context should not end the enumeration.
+        entry->resourceType = MrmType_Unknown;
+        return S_OK;
+    }
+    RETURN_IF_FAILED(hr);
+
+    RETURN_IF_FAILED(GetStringOrEmbeddedValue(&candidate, &entry->resourceType, &entry->resourceString, &entry->data));
+    return S_OK;
+}
+
+STDAPI MrmGetNextResources(
+    _In_ MrmResourceEnumeratorHandle enumerator,
+    UINT32 maxCount,
+    _Out_writes_to_(maxCount, *fetched) MrmResourceEntry* entries,
+    _Out_ UINT32* fetched)
+{
+    *fetched = 0;
+    RETURN_HR_IF_NULL(E_INVALIDARG, enumerator);
+    RETURN_HR_IF(E_INVALIDARG, (maxCount > 0) && (entries == nullptr));
+
+    MrmEnumeratorObjects* enumeratorObjects = reinterpret_cast<MrmEnumeratorObjects*>(enumerator);
+
+    ZeroMemory(entries, maxCount * sizeof(*entries));
+
+    const int startIndex = enumeratorObjects->enumerator->GetCurrentIndex();
+    UINT32 count = 0;
+    HRESULT hr = S_OK;
+    while (count < maxCount)
+    {
+        bool hasCurrent;
+        hr = enumeratorObjects->enumerator->MoveNext(&hasCurrent);
+        if (FAILED(hr) || !hasCurrent)
+        {
+            break;
+        }
+
+        hr = GetNextResourceEntry(enumeratorObjects, &entries[count]);
+        if (FAILED(hr))
+        {
+            break;
+        }
+        count++;
+    }
+
+    if (FAILED(hr))
+    {
+        // Keep the batch all-or-nothing so the caller only ever has complete entries to free, and put the cursor
+        // back where the batch started so the resources it had already moved past aren't skipped.
+        MrmFreeResourceEntries(maxCount, entries);
+        LOG_IF_FAILED(MrmSeekResourceEnumerator(enumerator, static_cast<UINT32>(startIndex + 1)));
+        RETURN_HR(hr);
+    }
+
+    *fetched = count;
+    return (count == maxCount) ? S_OK : S_FALSE;
+}
+
+STDAPI MrmSeekResourceEnumerator(_In_ MrmResourceEnumeratorHandle enumerator, UINT32 index)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, enumerator);
+
+    ResourceMapSubtreeEnumerator* cursor = reinterpret_cast<MrmEnumeratorObjects*>(enumerator)->enumerator;
+
+    // The next call to MrmGetNextResources returns the resource at index, so the cursor is left just before it.
+    if ((cursor->GetCurrentIndex() >= 0) && (index <= static_cast<UINT32>(cursor->GetCurrentIndex())))
+    {
+        cursor->Reset();
+    }
+
+    while (static_cast<INT64>(cursor->GetCurrentIndex()) + 1 < static_cast<INT64>(index))
+    {
+        bool hasCurrent;
+        RETURN_IF_FAILED(cursor->MoveNext(&hasCurrent));
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), !hasCurrent);
+    }
+
+    return S_OK;
+}
+
+STDAPI_(void) MrmFreeResourceEntries(UINT32 count, _In_reads_(count) MrmResourceEntry* entries)
+{
+    if (entries != nullptr)
+    {
+        for (UINT32 i = 0; i < count; i++)
+        {
+            MrmFreeResource(entries[i].resourceName);
+            MrmFreeResource(entries[i].resourceString);
+            MrmFreeResource(entries[i].data.data);
+            ZeroMemory(&entries[i], sizeof(entries[i]));
+        }
+    }
+}
+
+STDAPI_(void) MrmDestroyResourceEnumerator(_In_opt_ MrmResourceEnumeratorHandle enumerator)
+{
+    if (enumerator != nullptr)
+    {
+        MrmEnumeratorObjects* enumeratorObjects = reinterpret_cast<MrmEnumeratorObjects*>(enumerator);
+        delete enumeratorObjects->enumerator;
+        delete enumeratorObjects;
+    }
+
+    return;
+}
+
 STDAPI_(void*) MrmAllocateBuffer(size_t size) { return Def_Alloc(size); }
 
 STDAPI_(void) MrmFreeResource(_In_opt_ void* resource)
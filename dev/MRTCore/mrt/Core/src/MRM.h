@@ -11,6 +11,7 @@ extern "C"
     DECLARE_HANDLE(MrmManagerHandle);
     DECLARE_HANDLE(MrmContextHandle);
     DECLARE_HANDLE(MrmMapHandle);
+    DECLARE_HANDLE(MrmResourceEnumeratorHandle);
 
     enum MrmType
     {
@@ -26,9 +27,69 @@ extern "C"
         void* data;
     };
 
+    enum MrmPrefixMatchFlags
+    {
+        MrmPrefixMatch_Default = 0x0,
+        MrmPrefixMatch_CaseSensitive = 0x1
+    };
+
+#define MRM_LATENCY_BUCKET_COUNT 16
+
+    // Bucket 0 counts operations that took under 1us, bucket i counts [2^(i-1), 2^i) us, and the
+    // last bucket also counts everything slower.
+    struct MrmLatencyHistogram
+    {
+        UINT64 count;
+        UINT64 totalMicroseconds;
+        UINT64 buckets[MRM_LATENCY_BUCKET_COUNT];
+    };
+
+    struct MrmCacheCounters
+    {
+        UINT64 hits;
+        UINT64 misses;
+    };
+
+    struct MrmStatistics
+    {
+        MrmLatencyHistogram mapLookup;
+        MrmLatencyHistogram decisionEvaluation;
+        MrmLatencyHistogram valueExtraction;
+        MrmCacheCounters sharedResolutionCache;
+        MrmCacheCounters decisionCache;
+        MrmCacheCounters qualifierSetCache;
+        MrmCacheCounters qualifierCache;
+        UINT64 bytesCopied;
+        UINT64 priLoadMicroseconds;
+    };
+
+    struct MrmResourceEntry
+    {
+        UINT32 index;
+        MrmType resourceType;
+        PWSTR resourceName;
+        PWSTR resourceString;
+        MrmResourceData data;
+    };
+
     STDAPI MrmCreateResourceManager(_In_ PCWSTR priFileName, _Out_ MrmManagerHandle* resourceManager);
     STDAPI_(void) MrmDestroyResourceManager(_In_opt_ MrmManagerHandle resourceManager);
 
+    // Lets the resource manager, and every context created from it, share resolved candidates with other
+    // processes in the session that load the same PRI file, run as the same user and are at the same
+    // integrity level. cacheName names the shared region; pass nullptr for the default. Fails with
+    // E_ACCESSDENIED if the region already exists and isn't owned by such a process. Call this before
+    // loading resources; it can only be called once per manager.
+    STDAPI MrmEnableSharedResolutionCache(_In_ MrmManagerHandle resourceManager, _In_opt_ PCWSTR cacheName);
+
+    // Lookup statistics are off by default. While they are off each lookup pays a null check per
+    // measurement point and nothing else. Disabling keeps the counters, so they can still be read.
+    // priLoadMicroseconds is recorded when the manager is created, whether or not statistics are on.
+    // Statistics can be enabled and disabled while other threads are loading resources.
+    STDAPI MrmEnableStatistics(_In_ MrmManagerHandle resourceManager, BOOL enable);
+    STDAPI MrmGetStatistics(_In_ MrmManagerHandle resourceManager, _Out_ MrmStatistics* statistics);
+    STDAPI MrmResetStatistics(_In_ MrmManagerHandle resourceManager);
+
     STDAPI MrmCreateResourceContext(_In_ MrmManagerHandle resourceManager, _Out_ MrmContextHandle* resourceContext);
     STDAPI_(void) MrmFreeQualifierNamesOrValues(UINT32 size, _In_reads_(size) PWSTR* names);
     STDAPI MrmGetAllQualifierNames(_In_ MrmContextHandle resourceContext, _Out_ UINT32* size, _Outptr_result_buffer_(*size) PWSTR** names);
@@ -123,6 +184,41 @@ extern "C"
         _Outptr_result_buffer_(*qualifierCount) PWSTR** qualifierNames,
         _Outptr_result_buffer_(*qualifierCount) PWSTR** qualifierValues);
 
+    // Enumerators walk the resources of a resource map in index order without materializing the whole map, resolving
+    // every resource against the same context. The context, if supplied, must outlive the enumerator.
+    STDAPI MrmCreateResourceEnumerator(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_opt_ MrmMapHandle resourceMap,
+        _Out_ MrmResourceEnumeratorHandle* enumerator);
+
+    // Enumerates only the resources whose names, relative to the resource map, start with prefix. A prefix such as
+    // "Errors/Network/" selects a scope directly, and "Settings." matches the final name segment partially. Matching is
+    // case-insensitive like every other lookup unless MrmPrefixMatch_CaseSensitive is passed. Entry indexes are
+    // positions within the matching resources.
+    STDAPI MrmCreateResourceEnumeratorForPrefix(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_opt_ MrmMapHandle resourceMap,
+        _In_ PCWSTR prefix,
+        MrmPrefixMatchFlags flags,
+        _Out_ MrmResourceEnumeratorHandle* enumerator);
+
+    // Returns S_FALSE when fewer than maxCount entries were left. Entries must be released with MrmFreeResourceEntries.
+    // Resources with no candidate for the context are returned with resourceType MrmType_Unknown and no value.
+    // On failure no entries are returned and the enumerator is left where it was, so the batch can be retried.
+    STDAPI MrmGetNextResources(
+        _In_ MrmResourceEnumeratorHandle enumerator,
+        UINT32 maxCount,
+        _Out_writes_to_(maxCount, *fetched) MrmResourceEntry* entries,
+        _Out_ UINT32* fetched);
+
+    // Positions the enumerator so that the next entry returned is the resource at index.
+    STDAPI MrmSeekResourceEnumerator(_In_ MrmResourceEnumeratorHandle enumerator, UINT32 index);
+
+    STDAPI_(void) MrmFreeResourceEntries(UINT32 count, _In_reads_(count) MrmResourceEntry* entries);
+    STDAPI_(void) MrmDestroyResourceEnumerator(_In_opt_ MrmResourceEnumeratorHandle enumerator);
+
     STDAPI_(void*) MrmAllocateBuffer(size_t size);
     STDAPI_(void) MrmFreeResource(_In_opt_ void* resource);
 
@@ -5,6 +5,9 @@
 #include <WexTestClass.h>
 #include "..\src\MRM.h"
 
+#include <string>
+#include <vector>
+
 using namespace WEX::Common;
 using namespace WEX::TestExecution;
 using namespace WEX::Logging;
@@ -500,6 +503,132 @@ public:
         MrmDestroyResourceManager(resourceManager);
     }
 
+    TEST_METHOD(EnumerateResourceMapWithEnumerator)
+    {
+        MrmManagerHandle resourceManager;
+        VERIFY_ARE_EQUAL(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        MrmMapHandle childResourceMap;
+        VERIFY_ARE_EQUAL(MrmGetChildResourceMap(resourceManager, nullptr, L"Microsoft.UI.Xaml", &childResourceMap), S_OK);
+
+        MrmMapHandle childChildResourceMap;
+        VERIFY_ARE_EQUAL(MrmGetChildResourceMap(resourceManager, childResourceMap, L"Resources", &childChildResourceMap), S_OK);
+
+        UINT32 count;
+        VERIFY_ARE_EQUAL(MrmGetResourceCount(resourceManager, childChildResourceMap, &count), S_OK);
+
+        MrmResourceEnumeratorHandle enumerator;
+        VERIFY_ARE_EQUAL(MrmCreateResourceEnumerator(resourceManager, nullptr, childChildResourceMap, &enumerator), S_OK);
+
+        // The enumerator must return the same names and values, in the same order, as the index based API.
+        MrmResourceEntry entries[10];
+        UINT32 fetched;
+        UINT32 total = 0;
+        HRESULT hr;
+        do
+        {
+            hr = MrmGetNextResources(enumerator, ARRAYSIZE(entries), entries, &fetched);
+            VERIFY_SUCCEEDED(hr);
+
+            for (UINT32 i = 0; i < fetched; i++)
+            {
+                VERIFY_ARE_EQUAL(entries[i].index, total);
+
+                MrmType resourceType;
+                wchar_t* resourceString = nullptr;
+                wchar_t* resourceName = nullptr;
+                MrmResourceData resourceData {};
+                VERIFY_ARE_EQUAL(MrmLoadStringOrEmbeddedResourceByIndex(resourceManager, nullptr, childChildResourceMap, total, &resourceType, &resourceName, &resourceString, &resourceData), S_OK);
+
+                VERIFY_IS_TRUE(entries[i].resourceType == resourceType);
+                VerifyStringEqual(resourceName, entries[i].resourceName);
+                VerifyStringEqual(resourceString, entries[i].resourceString);
+
+                MrmFreeResource(resourceString);
+                MrmFreeResource(resourceName);
+                total++;
+            }
+
+            MrmFreeResourceEntries(fetched, entries);
+        } while (hr == S_OK);
+
+        VERIFY_ARE_EQUAL(total, count);
+
+        // Seeking positions the enumerator on an arbitrary index, forwards or backwards.
+        VERIFY_ARE_EQUAL(MrmSeekResourceEnumerator(enumerator, 77), S_OK);
+        VERIFY_ARE_EQUAL(MrmGetNextResources(enumerator, 1, entries, &fetched), S_OK);
+        VERIFY_ARE_EQUAL(fetched, 1u);
+        VerifyStringEqual(entries[0].resourceName, L"ValueStringValueSliderWithoutColorName");
+        VerifyStringEqual(entries[0].resourceString, L"%1!u!");
+        MrmFreeResourceEntries(fetched, entries);
+
+        VERIFY_ARE_EQUAL(MrmSeekResourceEnumerator(enumerator, 2), S_OK);
+        VERIFY_ARE_EQUAL(MrmGetNextResources(enumerator, 1, entries, &fetched), S_OK);
+        VerifyStringEqual(entries[0].resourceName, L"AutomationNameBlueTextBox");
+        VerifyStringEqual(entries[0].resourceString, L"Blue");
+        MrmFreeResourceEntries(fetched, entries);
+
+        VERIFY_ARE_EQUAL(MrmSeekResourceEnumerator(enumerator, count + 1), HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND));
+
+        MrmDestroyResourceEnumerator(enumerator);
+        MrmDestroyResourceManager(resourceManager);
+    }
+
+    TEST_METHOD(EnumerateResourcesByPrefix)
+    {
+        MrmManagerHandle resourceManager;
+        VERIFY_ARE_EQUAL(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        const PCWSTR prefixes[] = {
+            L"Microsoft.UI.Xaml/Resources/AutomationName",
+            L"microsoft.ui.xaml/resources/automationname*",
+            L"Microsoft.UI.Xaml/Resources/",
+            L"Files/Controls/A",
+            L"resources/IDS_",
+            L"DoesNotExist/",
+            L"Microsoft.UI.Xaml/Resources/Zzz" };
+
+        for (PCWSTR prefix : prefixes)
+        {
+            // The prefix enumerator must find exactly what enumerating every resource and filtering by name finds.
+            std::vector<std::wstring> expected;
+            LARGE_INTEGER start, end, frequency;
+            QueryPerformanceFrequency(&frequency);
+            QueryPerformanceCounter(&start);
+            GetResourceNamesByFilter(resourceManager, prefix, expected);
+            QueryPerformanceCounter(&end);
+            LONGLONG filterTicks = end.QuadPart - start.QuadPart;
+
+            std::vector<std::wstring> actual;
+            QueryPerformanceCounter(&start);
+            GetResourceNamesByPrefix(resourceManager, prefix, MrmPrefixMatch_Default, actual);
+            QueryPerformanceCounter(&end);
+            LONGLONG prefixTicks = end.QuadPart - start.QuadPart;
+
+            VERIFY_ARE_EQUAL(expected.size(), actual.size());
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                VerifyStringEqual(expected[i].c_str(), actual[i].c_str());
+            }
+
+            Log::Comment(String().Format(L"%s: %u matches, enumerate-and-filter %lld us, prefix search %lld us",
+                prefix, static_cast<UINT32>(actual.size()), filterTicks * 1000000 / frequency.QuadPart, prefixTicks * 1000000 / frequency.QuadPart));
+        }
+
+        std::vector<std::wstring> names;
+        GetResourceNamesByPrefix(resourceManager, L"Microsoft.UI.Xaml/Resources/AutomationName", MrmPrefixMatch_CaseSensitive, names);
+        VERIFY_IS_TRUE(names.size() > 0);
+        VerifyStringEqual(L"Microsoft.UI.Xaml/Resources/AutomationNameAlphaSlider", names[0].c_str());
+
+        GetResourceNamesByPrefix(resourceManager, L"microsoft.ui.xaml/resources/automationname", MrmPrefixMatch_CaseSensitive, names);
+        VERIFY_ARE_EQUAL(names.size(), 0u);
+
+        GetResourceNamesByPrefix(resourceManager, L"Microsoft.UI.Xaml/Resources/automationname", MrmPrefixMatch_CaseSensitive, names);
+        VERIFY_ARE_EQUAL(names.size(), 0u);
+
+        MrmDestroyResourceManager(resourceManager);
+    }
+
     TEST_METHOD(ReadResourceStringWithQualifierValue)
     {
         MrmManagerHandle resourceManager;
@@ -566,6 +695,104 @@ public:
         MrmDestroyResourceManager(resourceManager);
     }
 
+    TEST_METHOD(SharedResolutionCache)
+    {
+        // Two managers over the same PRI stand in for two processes sharing the region.
+        wchar_t cacheName[64];
+        swprintf_s(cacheName, L"Local\\MrmTests_SharedResolutionCache_%u_%u", GetCurrentProcessId(), GetTickCount());
+
+        MrmManagerHandle firstManager;
+        VERIFY_ARE_EQUAL(MrmCreateResourceManager(L".\\resources.pri", &firstManager), S_OK);
+        VERIFY_ARE_EQUAL(MrmEnableSharedResolutionCache(firstManager, cacheName), S_OK);
+        VERIFY_ARE_EQUAL(MrmEnableSharedResolutionCache(firstManager, cacheName), HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED));
+
+        MrmManagerHandle secondManager;
+        VERIFY_ARE_EQUAL(MrmCreateResourceManager(L".\\resources.pri", &secondManager), S_OK);
+        VERIFY_ARE_EQUAL(MrmEnableSharedResolutionCache(secondManager, cacheName), S_OK);
+
+        MrmContextHandle firstContext;
+        VERIFY_ARE_EQUAL(MrmCreateResourceContext(firstManager, &firstContext), S_OK);
+        MrmContextHandle secondContext;
+        VERIFY_ARE_EQUAL(MrmCreateResourceContext(secondManager, &secondContext), S_OK);
+
+        // Populate from the first manager and read back through the second, then change the
+        // context so a cached en-US answer must not be reused for en-GB.
+        PCWSTR languages[] = { L"en-US", L"en-GB", L"en-US" };
+        PCWSTR expected[] = { L"Equalizer", L"Equaliser", L"Equalizer" };
+        for (int i = 0; i < ARRAYSIZE(languages); i++)
+        {
+            VERIFY_ARE_EQUAL(MrmSetQualifier(firstContext, L"Language", languages[i]), S_OK);
+            VERIFY_ARE_EQUAL(MrmSetQualifier(secondContext, L"Language", languages[i]), S_OK);
+
+            wchar_t* resourceString;
+            VERIFY_ARE_EQUAL(MrmLoadStringResource(firstManager, firstContext, nullptr, L"resources/IDS_WHATS_NEW_1710_2_EQUALIZER_TITLE", &resourceString), S_OK);
+            VerifyStringEqual(expected[i], resourceString);
+            MrmFreeResource(resourceString);
+
+            VERIFY_ARE_EQUAL(MrmLoadStringResource(secondManager, secondContext, nullptr, L"resources/IDS_WHATS_NEW_1710_2_EQUALIZER_TITLE", &resourceString), S_OK);
+            VerifyStringEqual(expected[i], resourceString);
+            MrmFreeResource(resourceString);
+        }
+
+        MrmDestroyResourceContext(secondContext);
+        MrmDestroyResourceContext(firstContext);
+        MrmDestroyResourceManager(secondManager);
+        MrmDestroyResourceManager(firstManager);
+    }
+
+    TEST_METHOD(LookupStatistics)
+    {
+        MrmManagerHandle resourceManager;
+        VERIFY_ARE_EQUAL(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        MrmStatistics statistics;
+        VERIFY_ARE_EQUAL(MrmGetStatistics(resourceManager, &statistics), S_OK);
+        VERIFY_ARE_EQUAL(0ull, statistics.mapLookup.count);
+
+        VERIFY_ARE_EQUAL(MrmEnableStatistics(resourceManager, TRUE), S_OK);
+        for (int i = 0; i < 2; i++)
+        {
+            wchar_t* resourceString;
+            VERIFY_ARE_EQUAL(MrmLoadStringResource(resourceManager, nullptr, nullptr, L"resources/IDS_MANIFEST_MUSIC_APP_NAME", &resourceString), S_OK);
+            VerifyStringEqual(L"Groove Music", resourceString);
+            MrmFreeResource(resourceString);
+        }
+
+        VERIFY_ARE_EQUAL(MrmGetStatistics(resourceManager, &statistics), S_OK);
+        VERIFY_ARE_EQUAL(2ull, statistics.mapLookup.count);
+        VERIFY_ARE_EQUAL(2ull, statistics.decisionEvaluation.count);
+        VERIFY_ARE_EQUAL(2ull, statistics.valueExtraction.count);
+        VERIFY_ARE_EQUAL(2ull * sizeof(L"Groove Music"), statistics.bytesCopied);
+
+        // The second lookup of the same resource must come out of the decision cache.
+        VERIFY_ARE_EQUAL(2ull, statistics.decisionCache.hits + statistics.decisionCache.misses);
+        VERIFY_IS_GREATER_THAN_OR_EQUAL(statistics.decisionCache.hits, 1ull);
+
+        UINT64 bucketTotal = 0;
+        for (int i = 0; i < MRM_LATENCY_BUCKET_COUNT; i++)
+        {
+            bucketTotal += statistics.mapLookup.buckets[i];
+        }
+        VERIFY_ARE_EQUAL(statistics.mapLookup.count, bucketTotal);
+
+        VERIFY_ARE_EQUAL(MrmResetStatistics(resourceManager), S_OK);
+        VERIFY_ARE_EQUAL(MrmGetStatistics(resourceManager, &statistics), S_OK);
+        VERIFY_ARE_EQUAL(0ull, statistics.mapLookup.count);
+        VERIFY_ARE_EQUAL(0ull, statistics.decisionCache.hits);
+
+        // Nothing is counted while disabled.
+        VERIFY_ARE_EQUAL(MrmEnableStatistics(resourceManager, FALSE), S_OK);
+        wchar_t* resourceString;
+        VERIFY_ARE_EQUAL(MrmLoadStringResource(resourceManager, nullptr, nullptr, L"resources/IDS_MANIFEST_MUSIC_APP_NAME", &resourceString), S_OK);
+        MrmFreeResource(resourceString);
+
+        VERIFY_ARE_EQUAL(MrmGetStatistics(resourceManager, &statistics), S_OK);
+        VERIFY_ARE_EQUAL(0ull, statistics.mapLookup.count);
+        VERIFY_ARE_EQUAL(0ull, statistics.decisionCache.hits + statistics.decisionCache.misses);
+
+        MrmDestroyResourceManager(resourceManager);
+    }
+
     TEST_METHOD(RepeatedCalls)
     {
         MrmManagerHandle resourceManager;
@@ -617,6 +844,70 @@ public:
     }
 
 private:
+    void GetResourceNamesByFilter(MrmManagerHandle resourceManager, PCWSTR prefix, std::vector<std::wstring>& names)
+    {
+        names.clear();
+
+        size_t prefixLength = wcslen(prefix);
+        if ((prefixLength > 0) && (prefix[prefixLength - 1] == L'*'))
+        {
+            prefixLength--;
+        }
+
+        UINT32 count;
+        VERIFY_ARE_EQUAL(MrmGetResourceCount(resourceManager, nullptr, &count), S_OK);
+
+        for (UINT32 i = 0; i < count; i++)
+        {
+            MrmType resourceType;
+            wchar_t* resourceString = nullptr;
+            wchar_t* resourceName = nullptr;
+            MrmResourceData resourceData {};
+            if (SUCCEEDED(MrmLoadStringOrEmbeddedResourceByIndex(resourceManager, nullptr, nullptr, i, &resourceType, &resourceName, &resourceString, &resourceData)))
+            {
+                if ((wcslen(resourceName) >= prefixLength) &&
+                    (CompareStringOrdinal(resourceName, static_cast<int>(prefixLength), prefix, static_cast<int>(prefixLength), TRUE) == CSTR_EQUAL))
+                {
+                    names.push_back(resourceName);
+                }
+
+                MrmFreeResource(resourceString);
+                MrmFreeResource(resourceData.data);
+                MrmFreeResource(resourceName);
+            }
+        }
+    }
+
+    void GetResourceNamesByPrefix(MrmManagerHandle resourceManager, PCWSTR prefix, MrmPrefixMatchFlags flags, std::vector<std::wstring>& names)
+    {
+        names.clear();
+
+        MrmResourceEnumeratorHandle enumerator;
+        VERIFY_ARE_EQUAL(MrmCreateResourceEnumeratorForPrefix(resourceManager, nullptr, nullptr, prefix, flags, &enumerator), S_OK);
+
+        MrmResourceEntry entries[16];
+        UINT32 fetched;
+        UINT32 position = 0;
+        HRESULT hr;
+        do
+        {
+            hr = MrmGetNextResources(enumerator, ARRAYSIZE(entries), entries, &fetched);
+            VERIFY_SUCCEEDED(hr);
+
+            for (UINT32 i = 0; i < fetched; i++)
+            {
+                VERIFY_ARE_EQUAL(entries[i].index, position++);
+                if (entries[i].resourceType != MrmType_Unknown)
+                {
+                    names.push_back(entries[i].resourceName);
+                }
+            }
+            MrmFreeResourceEntries(fetched, entries);
+        } while (hr == S_OK);
+
+        MrmDestroyResourceEnumerator(enumerator);
+    }
+
     void VerifyQualifierValue(UINT32 qualifierCount, PWSTR* qualifierNames, PWSTR* qualifierValues, PCWSTR name, PCWSTR expectedValue)
     {
         VERIFY_IS_GREATER_THAN(qualifierCount, 0u);
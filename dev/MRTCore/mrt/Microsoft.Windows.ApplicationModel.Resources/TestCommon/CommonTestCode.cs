@@ -304,6 +304,23 @@ namespace CommonTestCode
             candidate = value.Value;
             Verify.AreEqual(candidate.ValueAsString, "%1!u!");
             Verify.AreEqual(candidate.Kind, ResourceCandidateKind.String);
+
+            // In-order iteration and random access resolve the same resources, in any mix
+            var keys = new string[count];
+            for (uint i = 0; i < count; i++)
+            {
+                keys[i] = resourceMapResources.GetValueByIndex(i).Key;
+            }
+            Verify.AreEqual(keys[0], "AutomationNameAlphaSlider");
+            Verify.AreEqual(keys[77], "ValueStringValueSliderWithoutColorName");
+            for (uint i = count; i > 0; i--)
+            {
+                Verify.AreEqual(resourceMapResources.GetValueByIndex(i - 1).Key, keys[i - 1]);
+            }
+            Verify.AreEqual(resourceMapResources.GetValueByIndex(0).Key, keys[0]);
+            Verify.AreEqual(resourceMapResources.GetValueByIndex(40).Key, keys[40]);
+            Verify.AreEqual(resourceMapResources.GetValueByIndex(1).Key, keys[1]);
+            Verify.AreEqual(resourceMapResources.GetValueByIndex(2).Key, keys[2]);
         }
     }
 
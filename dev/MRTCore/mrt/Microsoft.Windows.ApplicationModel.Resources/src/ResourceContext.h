@@ -18,10 +18,12 @@ struct ResourceContext : ResourceContextT<ResourceContext>
     void Apply();
     MrmContextHandle GetContextHandle() { return m_resourceContext; }
 
+    // The languages a newly created context applies (the application's, including any override).
+    static hstring GetLangugageContext();
+
 private:
     void InitializeQualifierNames();
     void InitializeQualifierValueMap();
-    hstring GetLangugageContext();
 
     MrmContextHandle m_resourceContext = nullptr;
     com_array<hstring> m_qualifierNames;
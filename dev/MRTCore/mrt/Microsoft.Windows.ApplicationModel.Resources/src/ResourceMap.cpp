@@ -13,6 +13,12 @@ using namespace winrt::Windows::Foundation::Collections;
 
 namespace winrt::Microsoft::Windows::ApplicationModel::Resources::implementation
 {
+ResourceMap::~ResourceMap()
+{
+    MrmFreeResourceEntries(m_cursorEntryCount, m_cursorEntries.data());
+    MrmDestroyResourceEnumerator(m_cursor);
+}
+
 uint32_t ResourceMap::ResourceCount()
 {
     if (m_resourceManagerHandle == nullptr)
@@ -166,6 +172,68 @@ Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate ResourceMap::
     return GetValueImpl(&context, resource, true);
 }
 
+IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::MakeValuePair(
+    Resources::ResourceContext const& context,
+    uint32_t index,
+    MrmType resourceType,
+    wchar_t* resourceName,
+    wchar_t* resourceString,
+    MrmResourceData resourceData)
+{
+    // Take ownership of the buffers before anything can throw.
+    string_resoure_ptr resourceNameContainter(resourceName);
+    string_resoure_ptr resourceStringContainer(resourceString);
+    embedded_resoure_ptr resourceDataContainer(resourceData.data);
+
+    // Candidates which are not addressed by index in this map are refetched by name for their qualifier values.
+    hstring resourceId = (index == static_cast<uint32_t>(-1)) ? hstring(resourceNameContainter.get()) : hstring();
+
+    Resources::ResourceCandidate candidate = nullptr;
+    switch (resourceType)
+    {
+    case MrmType_Embedded:
+    {
+        candidate = winrt::make<ResourceCandidate>(
+            m_resourceManagerHandle,
+            context,
+            m_resourceMapHandle,
+            index,
+            resourceId,
+            winrt::array_view<uint8_t>(reinterpret_cast<byte*>(resourceDataContainer.get()), reinterpret_cast<byte*>(resourceDataContainer.get()) + resourceData.size));
+        break;
+    }
+    case MrmType_String:
+    {
+        candidate = winrt::make<ResourceCandidate>(
+            m_resourceManagerHandle,
+            context,
+            m_resourceMapHandle,
+            index,
+            resourceId,
+            ResourceCandidateKind::String,
+            winrt::to_hstring(resourceStringContainer.get()));
+        break;
+    }
+    case MrmType_Path:
+    {
+        candidate = winrt::make<ResourceCandidate>(
+            m_resourceManagerHandle,
+            context,
+            m_resourceMapHandle,
+            index,
+            resourceId,
+            ResourceCandidateKind::FilePath,
+            winrt::to_hstring(resourceStringContainer.get()));
+        break;
+    }
+    default:
+        // Should never happen.
+        winrt::throw_hresult(E_UNEXPECTED);
+    }
+
+    return winrt::make<winrt::impl::key_value_pair<IKeyValuePair<hstring, Resources::ResourceCandidate>>>(resourceNameContainter.get(), candidate);
+}
+
 IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::GetValueByIndexImpl(
     const Resources::ResourceContext* context,
     uint32_t index)
@@ -191,63 +259,166 @@ IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::GetValueByInde
         &resourceString,
         &resourceData));
 
-    string_resoure_ptr resourceNameContainter(resourceName);
+    return MakeValuePair(resourceContext, index, resourceType, resourceName, resourceString, resourceData);
+}
 
-    switch (resourceType)
-    {
-    case MrmType_Embedded:
-    {
-        embedded_resoure_ptr resourceContainer(resourceData.data);
-        Resources::ResourceCandidate candidate = winrt::make<ResourceCandidate>(
-            m_resourceManagerHandle,
-            resourceContext,
-            m_resourceMapHandle,
-            index,
-            hstring(),
-            winrt::array_view<uint8_t>(reinterpret_cast<byte*>(resourceContainer.get()), reinterpret_cast<byte*>(resourceContainer.get()) + resourceData.size));
+IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::GetValueByIndexFromCursor(uint32_t index)
+{
+    std::unique_lock<std::mutex> lock(m_cursorLock);
 
-        return winrt::make<winrt::impl::key_value_pair<IKeyValuePair<hstring, Resources::ResourceCandidate>>>(resourceName, candidate);
+    // The cursor only serves iteration: index 0 starts a pass and every later call asks for the index after the last.
+    // Anything else is random access, which would mean seeking the cursor (linear in the map's size), so resolve it
+    // like an explicit context would be.
+    if ((index != 0) && ((m_cursor == nullptr) || (index != m_cursorNextIndex)))
+    {
+        lock.unlock();
+        return GetValueByIndexImpl(nullptr, index);
     }
-    case MrmType_String:
+
+    // A direct lookup creates a context with the application's current languages. The cursor must resolve the same,
+    // so a language override set mid-iteration restarts the pass (at this index) with a new context.
+    hstring languages = Resources::implementation::ResourceContext::GetLangugageContext();
+    bool restart = (m_cursor == nullptr) || (index == 0) || (languages != m_cursorLanguages);
+
+    // Entries in a batch have consecutive indexes, so the batch either holds the requested index or must be refilled.
+    bool inBatch = !restart && (m_cursorEntryCount > 0) && (index >= m_cursorEntries[0].index) &&
+                   (index - m_cursorEntries[0].index < m_cursorEntryCount) &&
+                   (m_cursorEntries[index - m_cursorEntries[0].index].resourceName != nullptr);
+    if (!inBatch)
     {
-        string_resoure_ptr resourceContainer(resourceString);
-        Resources::ResourceCandidate candidate =
-            winrt::make<ResourceCandidate>(
+        // Until the batch is refilled the cursor's position is unknown, so only a new pass can use it.
+        MrmFreeResourceEntries(m_cursorEntryCount, m_cursorEntries.data());
+        m_cursorEntryCount = 0;
+        m_cursorNextIndex = 0;
+
+        if (restart)
+        {
+            Resources::ResourceContext resourceContext = m_resourceManager.CreateResourceContext();
+            resourceContext.as<Resources::implementation::ResourceContext>()->Apply();
+
+            MrmResourceEnumeratorHandle cursor = nullptr;
+            winrt::check_hresult(MrmCreateResourceEnumerator(
                 m_resourceManagerHandle,
-                resourceContext,
+                resourceContext.as<Resources::implementation::ResourceContext>()->GetContextHandle(),
                 m_resourceMapHandle,
-                index,
-                hstring(),
-                ResourceCandidateKind::String, 
-                winrt::to_hstring(resourceContainer.get()));
+                &cursor));
+
+            MrmDestroyResourceEnumerator(m_cursor);
+            m_cursor = cursor;
+            m_cursorContext = resourceContext;
+            m_cursorLanguages = languages;
+
+            if (index != 0)
+            {
+                winrt::check_hresult(MrmSeekResourceEnumerator(m_cursor, index));
+            }
+        }
 
-        return winrt::make<winrt::impl::key_value_pair<IKeyValuePair<hstring, Resources::ResourceCandidate>>>(resourceName, candidate);
+        UINT32 fetched = 0;
+        winrt::check_hresult(MrmGetNextResources(m_cursor, c_cursorBatchSize, m_cursorEntries.data(), &fetched));
+        if (fetched == 0)
+        {
+            winrt::throw_hresult(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND));
+        }
+        m_cursorEntryCount = fetched;
     }
-    case MrmType_Path:
+    m_cursorNextIndex = index + 1;
+
+    MrmResourceEntry& entry = m_cursorEntries[index - m_cursorEntries[0].index];
+    if (entry.resourceType == MrmType_Unknown)
     {
-        string_resoure_ptr resourceContainer(resourceString);
-        Resources::ResourceCandidate candidate =
-            winrt::make<ResourceCandidate>(
-                m_resourceManagerHandle,
-                resourceContext,
-                m_resourceMapHandle,
-                index,
-                hstring(),
-                ResourceCandidateKind::FilePath, 
-                winrt::to_hstring(resourceContainer.get()));
-
-        return winrt::make<winrt::impl::key_value_pair<
-            winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate>>>(
-            resourceName, candidate);
+        winrt::throw_hresult(HRESULT_FROM_WIN32(ERROR_MRM_NO_MATCH_OR_DEFAULT_CANDIDATE));
     }
+
+    MrmResourceEntry taken = entry;
+    entry.resourceName = nullptr;
+    entry.resourceString = nullptr;
+    entry.data = {};
+
+    return MakeValuePair(m_cursorContext, index, taken.resourceType, taken.resourceName, taken.resourceString, taken.data);
+}
+
+IVectorView<IKeyValuePair<hstring, Resources::ResourceCandidate>> ResourceMap::GetValuesByPrefixImpl(
+    const Resources::ResourceContext* context,
+    hstring const& prefix)
+{
+    std::vector<IKeyValuePair<hstring, Resources::ResourceCandidate>> values;
+    if (m_resourceManagerHandle == nullptr)
+    {
+        // Resources not managed by MRT can only be found by name through the ResourceNotFound event.
+        return winrt::single_threaded_vector(std::move(values)).GetView();
     }
-    // Should never happen.
-    winrt::throw_hresult(E_UNEXPECTED);
+
+    // Always use a context as we override the languages.
+    Resources::ResourceContext resourceContext = (context != nullptr) ? *context : m_resourceManager.CreateResourceContext();
+    resourceContext.as<Resources::implementation::ResourceContext>()->Apply();
+
+    MrmResourceEnumeratorHandle enumerator = nullptr;
+    winrt::check_hresult(MrmCreateResourceEnumeratorForPrefix(
+        m_resourceManagerHandle,
+        resourceContext.as<Resources::implementation::ResourceContext>()->GetContextHandle(),
+        m_resourceMapHandle,
+        prefix.c_str(),
+        MrmPrefixMatch_Default,
+        &enumerator));
+    resource_enumerator_ptr enumeratorContainer(enumerator);
+
+    std::array<MrmResourceEntry, c_cursorBatchSize> entries{};
+    HRESULT hr;
+    do
+    {
+        UINT32 fetched = 0;
+        hr = MrmGetNextResources(enumerator, static_cast<UINT32>(entries.size()), entries.data(), &fetched);
+        winrt::check_hresult(hr);
+
+        for (UINT32 i = 0; i < fetched; i++)
+        {
+            MrmResourceEntry taken = entries[i];
+            entries[i] = {};
+
+            if (taken.resourceType == MrmType_Unknown)
+            {
+                // No candidate for this context.
+                MrmFreeResourceEntries(1, &taken);
+                continue;
+            }
+
+            try
+            {
+                values.push_back(MakeValuePair(
+                    resourceContext, static_cast<uint32_t>(-1), taken.resourceType, taken.resourceName, taken.resourceString, taken.data));
+            }
+            catch (...)
+            {
+                MrmFreeResourceEntries(fetched, entries.data());
+                throw;
+            }
+        }
+    } while (hr == S_OK);
+
+    return winrt::single_threaded_vector(std::move(values)).GetView();
+}
+
+IVectorView<IKeyValuePair<hstring, Resources::ResourceCandidate>> ResourceMap::GetValuesByPrefix(hstring const& prefix)
+{
+    return GetValuesByPrefixImpl(nullptr, prefix);
+}
+
+IVectorView<IKeyValuePair<hstring, Resources::ResourceCandidate>> ResourceMap::GetValuesByPrefix(
+    hstring const& prefix,
+    Resources::ResourceContext const& context)
+{
+    return GetValuesByPrefixImpl(&context, prefix);
 }
 
 IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::GetValueByIndex(uint32_t index)
 {
-    return GetValueByIndexImpl(nullptr, index);
+    if (m_resourceManagerHandle == nullptr)
+    {
+        return GetValueByIndexImpl(nullptr, index);
+    }
+
+    return GetValueByIndexFromCursor(index);
 }
 
 IKeyValuePair<hstring, Resources::ResourceCandidate> ResourceMap::GetValueByIndex(uint32_t index, Resources::ResourceContext const& context)
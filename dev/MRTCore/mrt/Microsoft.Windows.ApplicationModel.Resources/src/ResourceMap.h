@@ -18,7 +18,8 @@ struct ResourceMap : ResourceMapT<ResourceMap>
         m_resourceManager(resourceManager), m_resourceManagerHandle(resourceManagerHandle), m_resourceMapHandle(resourceMapHandle)
     {}
 
-    ~ResourceMap() {} // The resource manager owns all the resource maps so nothing to destroy;
+    // The resource manager owns all the resource maps so only the enumeration cursor needs to be destroyed.
+    ~ResourceMap();
 
     uint32_t ResourceCount();
 
@@ -41,6 +42,13 @@ struct ResourceMap : ResourceMapT<ResourceMap>
     Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate TryGetValue(hstring const& resource);
     Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate TryGetValue(hstring const& resource, Microsoft::Windows::ApplicationModel::Resources::ResourceContext const& context);
 
+    winrt::Windows::Foundation::Collections::IVectorView<winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate>> GetValuesByPrefix(
+        hstring const& prefix);
+
+    winrt::Windows::Foundation::Collections::IVectorView<winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate>> GetValuesByPrefix(
+        hstring const& prefix,
+        Microsoft::Windows::ApplicationModel::Resources::ResourceContext const& context);
+
 private:
     Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate GetValueImpl(
         const Microsoft::Windows::ApplicationModel::Resources::ResourceContext* context,
@@ -49,6 +57,21 @@ private:
 
     Microsoft::Windows::ApplicationModel::Resources::ResourceMap GetSubtreeImpl(hstring const& reference, bool treatNotFoundAsOk);
 
+    winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate> MakeValuePair(
+        Microsoft::Windows::ApplicationModel::Resources::ResourceContext const& context,
+        uint32_t index,
+        MrmType resourceType,
+        wchar_t* resourceName,
+        wchar_t* resourceString,
+        MrmResourceData resourceData);
+
+    winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate> GetValueByIndexFromCursor(
+        uint32_t index);
+
+    winrt::Windows::Foundation::Collections::IVectorView<winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate>> GetValuesByPrefixImpl(
+        const Microsoft::Windows::ApplicationModel::Resources::ResourceContext* context,
+        hstring const& prefix);
+
     winrt::Windows::Foundation::Collections::IKeyValuePair<hstring, Microsoft::Windows::ApplicationModel::Resources::ResourceCandidate> GetValueByIndexImpl(
         const Microsoft::Windows::ApplicationModel::Resources::ResourceContext* context,
         uint32_t index);
@@ -57,6 +80,18 @@ private:
     MrmManagerHandle m_resourceManagerHandle = nullptr;
     MrmMapHandle m_resourceMapHandle = nullptr;
     uint32_t m_resourceCount = static_cast<uint32_t>(-1);
+
+    // In-order GetValueByIndex calls without an explicit context (i.e. First()/GetMany() iteration) are served from a
+    // cursor which resolves resources in batches against one shared context. A new context is created whenever
+    // iteration restarts at index 0 or the application's languages change. Other indexes are resolved directly.
+    static constexpr uint32_t c_cursorBatchSize = 32;
+    std::mutex m_cursorLock;
+    MrmResourceEnumeratorHandle m_cursor = nullptr;
+    Microsoft::Windows::ApplicationModel::Resources::ResourceContext m_cursorContext = nullptr;
+    hstring m_cursorLanguages;
+    uint32_t m_cursorNextIndex = 0;
+    std::array<MrmResourceEntry, c_cursorBatchSize> m_cursorEntries{};
+    uint32_t m_cursorEntryCount = 0;
 };
 
 } // namespace winrt::Microsoft::Windows::ApplicationModel::Resources::implementation
@@ -3,6 +3,9 @@
 
 #pragma once
 #include <unknwn.h>
+#include <array>
+#include <vector>
+#include <mutex>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Foundation.Collections.h>
 #include "..\..\core\src\MRM.h"
@@ -17,5 +20,11 @@ struct EmbeddedResourceFreer
     void operator()(void* resource) { MrmFreeResource(resource); }
 };
 
+struct ResourceEnumeratorDestroyer
+{
+    void operator()(MrmResourceEnumeratorHandle enumerator) { MrmDestroyResourceEnumerator(enumerator); }
+};
+
 using string_resoure_ptr = std::unique_ptr<wchar_t, StringResourceFreer>;
 using embedded_resoure_ptr = std::unique_ptr<void, EmbeddedResourceFreer>;
+using resource_enumerator_ptr = std::unique_ptr<std::remove_pointer_t<MrmResourceEnumeratorHandle>, ResourceEnumeratorDestroyer>;
@@ -0,0 +1,323 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <windows.h>
+#include <WexTestClass.h>
+#include "mrm/BaseInternal.h"
+#include "mrm/readers/SharedCache.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace WEX::Common;
+using namespace WEX::TestExecution;
+using namespace WEX::Logging;
+using namespace Microsoft::Resources;
+
+namespace UnitTests
+{
+
+/*!
+ * Heap-backed ISharedCacheStorage.  Caches over the same storage stand in for
+ * processes sharing a named region.
+ */
+class HeapCacheStorage : public ISharedCacheStorage
+{
+public:
+    HeapCacheStorage(_In_ UINT32 cbRegion) : m_region(cbRegion, 0) {}
+
+    void* GetRegion() const { return const_cast<BYTE*>(m_region.data()); }
+    UINT32 GetRegionSizeInBytes() const { return static_cast<UINT32>(m_region.size()); }
+
+    // Overwrite the first occurrence of one int in the region with another; returns false if it isn't there
+    bool Replace(_In_ int from, _In_ int to)
+    {
+        for (size_t offset = 0; offset + sizeof(int) <= m_region.size(); offset += sizeof(int))
+        {
+            if (memcmp(&m_region[offset], &from, sizeof(int)) == 0)
+            {
+                memcpy(&m_region[offset], &to, sizeof(int));
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<BYTE> m_region;
+};
+
+/*!
+ * SharedResolutionCache that can start a write and never finish it (i.e. crash
+ * while it owns the slot), and whose view of other writers' processes the test
+ * controls.
+ */
+class TestSharedResolutionCache : public SharedResolutionCache
+{
+public:
+    static HRESULT CreateInstance(_In_ ISharedCacheStorage* pStorage, _In_ UINT32 abandonTimeoutInMs, _Outptr_ TestSharedResolutionCache** result)
+    {
+        *result = nullptr;
+        AutoDeletePtr<TestSharedResolutionCache> pRtrn = new TestSharedResolutionCache();
+        RETURN_IF_NULL_ALLOC(pRtrn);
+        RETURN_IF_FAILED(pRtrn->Init(pStorage, false));
+        pRtrn->m_abandonTimeoutInMs = abandonTimeoutInMs;
+        *result = pRtrn.Detach();
+        return S_OK;
+    }
+
+    // Take the slot a write of the key would use, without releasing it.  Returns the
+    // slot, or nullptr if it couldn't be taken.
+    void* BeginWrite(_In_ const SharedResolutionCacheKey* pKey, _Out_ UINT64* pLockOut)
+    {
+        Slot* pSlot = FindSlotForWrite(pKey);
+        return TryLockSlot(pSlot, pLockOut) ? pSlot : nullptr;
+    }
+
+    bool EndWrite(_In_ void* pSlot, _In_ UINT64 lock) { return UnlockSlot(static_cast<Slot*>(pSlot), lock); }
+
+    bool otherProcessesExited = false;
+
+protected:
+    bool IsProcessRunning(_In_ UINT32 /*processId*/) const override { return !otherProcessesExited; }
+};
+
+class SharedResolutionCacheUnitTests : public WEX::TestClass<SharedResolutionCacheUnitTests>
+{
+public:
+    TEST_CLASS(SharedResolutionCacheUnitTests);
+
+    TEST_METHOD(SharedAcrossCaches);
+    TEST_METHOD(CrashedWriterIsRecoveredWhenItsProcessExits);
+    TEST_METHOD(CrashedWriterIsRecoveredAfterTimeout);
+    TEST_METHOD(TakenOverWriterDoesNotPublish);
+    TEST_METHOD(TornEntryIsAMiss);
+    TEST_METHOD(ConcurrentReadersAndWriters);
+
+private:
+    static SharedResolutionCacheKey MakeKey(_In_ int resourceIndex)
+    {
+        SharedResolutionCacheKey key;
+        key.fileIdentity = 0x1234567800000000ull | static_cast<UINT32>(resourceIndex);
+        key.contextSignature = 0xfeedface;
+        key.mapIdentity = 7;
+        key.resourceIndex = resourceIndex;
+        return key;
+    }
+
+    // The candidate index the concurrent test's writers store for a key.
+    static int ExpectedCandidateIndex(_In_ int resourceIndex) { return (resourceIndex * 31) % 1000; }
+};
+
+void SharedResolutionCacheUnitTests::SharedAcrossCaches()
+{
+    HeapCacheStorage storage(SharedResolutionCache::DefaultRegionSizeInBytes);
+    AutoDeletePtr<SharedResolutionCache> pFirst;
+    AutoDeletePtr<SharedResolutionCache> pSecond;
+    VERIFY_SUCCEEDED(SharedResolutionCache::CreateInstance(&storage, false, &pFirst));
+    VERIFY_SUCCEEDED(SharedResolutionCache::CreateInstance(&storage, false, &pSecond));
+
+    SharedResolutionCacheKey key = MakeKey(42);
+    int candidateIndex;
+    VERIFY_IS_FALSE(pSecond->TryGetCandidateIndex(&key, &candidateIndex));
+
+    pFirst->SetCandidateIndex(&key, 3);
+    VERIFY_IS_TRUE(pSecond->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(3, candidateIndex);
+
+    pSecond->SetCandidateIndex(&key, 4);
+    VERIFY_IS_TRUE(pFirst->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(4, candidateIndex);
+
+    SharedResolutionCacheKey otherKey = MakeKey(43);
+    VERIFY_IS_FALSE(pFirst->TryGetCandidateIndex(&otherKey, &candidateIndex));
+    VERIFY_ARE_EQUAL(-1, candidateIndex);
+}
+
+void SharedResolutionCacheUnitTests::CrashedWriterIsRecoveredWhenItsProcessExits()
+{
+    HeapCacheStorage storage(SharedResolutionCache::DefaultRegionSizeInBytes);
+    AutoDeletePtr<TestSharedResolutionCache> pCrashed;
+    AutoDeletePtr<TestSharedResolutionCache> pSurvivor;
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, INFINITE, &pCrashed));
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, INFINITE, &pSurvivor));
+
+    SharedResolutionCacheKey key = MakeKey(42);
+    UINT64 crashedLock;
+    void* pCrashedSlot = pCrashed->BeginWrite(&key, &crashedLock);
+    VERIFY_IS_NOT_NULL(pCrashedSlot);
+
+    // While its owner's running the slot's left alone; writes go to a neighbour
+    UINT64 lock;
+    void* pSlot = pSurvivor->BeginWrite(&key, &lock);
+    VERIFY_IS_NOT_NULL(pSlot);
+    VERIFY_ARE_NOT_EQUAL(pCrashedSlot, pSlot);
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlot, lock));
+
+    // Once it's gone the next writer takes the slot over...
+    pSurvivor->otherProcessesExited = true;
+    pSlot = pSurvivor->BeginWrite(&key, &lock);
+    VERIFY_ARE_EQUAL(pCrashedSlot, pSlot);
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlot, lock));
+
+    // ...and it's an ordinary slot again
+    pSurvivor->otherProcessesExited = false;
+    pSurvivor->SetCandidateIndex(&key, 6);
+    int candidateIndex;
+    VERIFY_IS_TRUE(pCrashed->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(6, candidateIndex);
+    pSlot = pSurvivor->BeginWrite(&key, &lock);
+    VERIFY_ARE_EQUAL(pCrashedSlot, pSlot);
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlot, lock));
+}
+
+void SharedResolutionCacheUnitTests::CrashedWriterIsRecoveredAfterTimeout()
+{
+    // The owner's process id was reused (or it hung): it looks alive but never finishes
+    const UINT32 c_abandonTimeoutInMs = 50;
+    HeapCacheStorage storage(SharedResolutionCache::DefaultRegionSizeInBytes);
+    AutoDeletePtr<TestSharedResolutionCache> pCrashed;
+    AutoDeletePtr<TestSharedResolutionCache> pSurvivor;
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, c_abandonTimeoutInMs, &pCrashed));
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, c_abandonTimeoutInMs, &pSurvivor));
+
+    SharedResolutionCacheKey key = MakeKey(42);
+    UINT64 crashedLock;
+    void* pCrashedSlot = pCrashed->BeginWrite(&key, &crashedLock);
+    VERIFY_IS_NOT_NULL(pCrashedSlot);
+
+    UINT64 lock;
+    void* pSlot = pSurvivor->BeginWrite(&key, &lock);
+    VERIFY_ARE_NOT_EQUAL(pCrashedSlot, pSlot);
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlot, lock));
+
+    Sleep(c_abandonTimeoutInMs * 4);
+    pSlot = pSurvivor->BeginWrite(&key, &lock);
+    VERIFY_ARE_EQUAL(pCrashedSlot, pSlot);
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlot, lock));
+}
+
+void SharedResolutionCacheUnitTests::TakenOverWriterDoesNotPublish()
+{
+    HeapCacheStorage storage(SharedResolutionCache::DefaultRegionSizeInBytes);
+    AutoDeletePtr<TestSharedResolutionCache> pSlow;
+    AutoDeletePtr<TestSharedResolutionCache> pSurvivor;
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, INFINITE, &pSlow));
+    VERIFY_SUCCEEDED(TestSharedResolutionCache::CreateInstance(&storage, INFINITE, &pSurvivor));
+
+    SharedResolutionCacheKey key = MakeKey(42);
+    UINT64 slowLock;
+    void* pSlowSlot = pSlow->BeginWrite(&key, &slowLock);
+    VERIFY_IS_NOT_NULL(pSlowSlot);
+
+    pSurvivor->otherProcessesExited = true;
+    UINT64 survivorLock;
+    VERIFY_ARE_EQUAL(pSlowSlot, pSurvivor->BeginWrite(&key, &survivorLock));
+    VERIFY_ARE_NOT_EQUAL(slowLock, survivorLock);
+
+    // The writer we gave up on wakes up.  Finishing its write mustn't unlock the slot
+    // while the new owner's still writing it
+    VERIFY_IS_FALSE(pSlow->EndWrite(pSlowSlot, slowLock));
+    VERIFY_IS_TRUE(pSurvivor->EndWrite(pSlowSlot, survivorLock));
+
+    int candidateIndex;
+    pSurvivor->otherProcessesExited = false;
+    pSurvivor->SetCandidateIndex(&key, 9);
+    VERIFY_IS_TRUE(pSlow->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(9, candidateIndex);
+}
+
+void SharedResolutionCacheUnitTests::TornEntryIsAMiss()
+{
+    HeapCacheStorage storage(SharedResolutionCache::DefaultRegionSizeInBytes);
+    AutoDeletePtr<SharedResolutionCache> pCache;
+    VERIFY_SUCCEEDED(SharedResolutionCache::CreateInstance(&storage, false, &pCache));
+
+    SharedResolutionCacheKey key = MakeKey(42);
+    const int c_candidateIndex = 0x2468ace;
+    pCache->SetCandidateIndex(&key, c_candidateIndex);
+    int candidateIndex;
+    VERIFY_IS_TRUE(pCache->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(c_candidateIndex, candidateIndex);
+
+    // A writer we'd given up on stores its candidate over ours after we'd published, so the
+    // slot's sequence is stable but its key and candidate come from different writers
+    VERIFY_IS_TRUE(storage.Replace(c_candidateIndex + 1, 5));
+    VERIFY_IS_FALSE(pCache->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(-1, candidateIndex);
+
+    // Writing the key again repairs it
+    pCache->SetCandidateIndex(&key, 6);
+    VERIFY_IS_TRUE(pCache->TryGetCandidateIndex(&key, &candidateIndex));
+    VERIFY_ARE_EQUAL(6, candidateIndex);
+}
+
+void SharedResolutionCacheUnitTests::ConcurrentReadersAndWriters()
+{
+    // A small region so writers contend for (and evict) the same slots
+    const int c_threads = 4;
+    const int c_keys = 256;
+    const int c_iterations = 20000;
+    HeapCacheStorage storage(4096);
+
+    AutoDeletePtr<SharedResolutionCache> caches[c_threads * 2];
+    for (auto& cache : caches)
+    {
+        VERIFY_SUCCEEDED(SharedResolutionCache::CreateInstance(&storage, false, &cache));
+    }
+
+    std::atomic<int> hits{ 0 };
+    std::atomic<int> wrongHits{ 0 };
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < c_threads; thread++)
+    {
+        SharedResolutionCache* pWriter = caches[thread];
+        threads.emplace_back([=]() {
+            for (int iteration = 0; iteration < c_iterations; iteration++)
+            {
+                int resourceIndex = (iteration * 7 + thread) % c_keys;
+                SharedResolutionCacheKey key = MakeKey(resourceIndex);
+                pWriter->SetCandidateIndex(&key, ExpectedCandidateIndex(resourceIndex));
+            }
+        });
+
+        SharedResolutionCache* pReader = caches[c_threads + thread];
+        threads.emplace_back([=, &hits, &wrongHits]() {
+            for (int iteration = 0; iteration < c_iterations; iteration++)
+            {
+                int resourceIndex = (iteration * 13 + thread) % c_keys;
+                SharedResolutionCacheKey key = MakeKey(resourceIndex);
+                int candidateIndex;
+                if (pReader->TryGetCandidateIndex(&key, &candidateIndex))
+                {
+                    ++hits;
+                    if (candidateIndex != ExpectedCandidateIndex(resourceIndex))
+                    {
+                        ++wrongHits;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    Log::Comment(String().Format(L"%d hits", hits.load()));
+
+    // Readers only ever see whole entries
+    VERIFY_ARE_EQUAL(0, wrongHits.load());
+
+    // ...and every writer released every slot it took
+    for (int resourceIndex = 0; resourceIndex < c_keys; resourceIndex++)
+    {
+        SharedResolutionCacheKey key = MakeKey(resourceIndex);
+        caches[0]->SetCandidateIndex(&key, ExpectedCandidateIndex(resourceIndex));
+        int candidateIndex;
+        VERIFY_IS_TRUE(caches[1]->TryGetCandidateIndex(&key, &candidateIndex));
+        VERIFY_ARE_EQUAL(ExpectedCandidateIndex(resourceIndex), candidateIndex);
+    }
+}
+
+} // namespace UnitTests
@@ -104,6 +104,34 @@ TestReverseFileMap::VerifyCandidate(
         VERIFY_SUCCEEDED(pReverseMap->GetCandidateInfo(candidateRevMapIndex, &gotQualifierSetIndex, &gotNamedResourceIndex));
         VERIFY(wantQualifierSetIndex == gotQualifierSetIndex);
         VERIFY(wantNamedResourceIndex == gotNamedResourceIndex);
+
+        // The batch lookup must agree, including for the alternate separator and
+        // for values that aren't in the map.
+        StringResult alternateValue;
+        VERIFY_SUCCEEDED(alternateValue.SetCopy(pWantCandidateValue));
+        PWSTR pAlternate;
+        size_t cchAlternate;
+        VERIFY_SUCCEEDED(alternateValue.GetWritableRef(&pAlternate, &cchAlternate));
+        for (size_t i = 0; (i < cchAlternate) && (pAlternate[i] != L'\0'); i++)
+        {
+            if (pAlternate[i] == L'/')
+            {
+                pAlternate[i] = L'\\';
+            }
+            else if (pAlternate[i] == L'\\')
+            {
+                pAlternate[i] = L'/';
+            }
+        }
+
+        PCWSTR values[] = { pWantCandidateValue, alternateValue.GetRef(), L"NoSuchFolder\\NoSuchFile.png" };
+        int indices[ARRAYSIZE(values)];
+        int numFound;
+        VERIFY_SUCCEEDED(pReverseMap->TryGetReverseMapCandidateIndices(ARRAYSIZE(values), values, indices, &numFound));
+        VERIFY_ARE_EQUAL(2, numFound);
+        VERIFY_ARE_EQUAL(candidateRevMapIndex, indices[0]);
+        VERIFY_ARE_EQUAL(candidateRevMapIndex, indices[1]);
+        VERIFY_ARE_EQUAL(-1, indices[2]);
     }
     else
     {
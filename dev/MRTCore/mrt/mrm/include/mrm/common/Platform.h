@@ -44,6 +44,14 @@ extern "C"
 
     HANDLE _DefGetCurrentProcess();
 
+    ULONG _DefGetCurrentProcessId();
+
+    // Milliseconds since the system started; comparable across processes
+    ULONGLONG _DefGetTickCount64();
+
+    // FALSE only if there's definitely no such process (e.g. it exited)
+    BOOLEAN _DefIsProcessRunning(__in ULONG ProcessId);
+
     HRESULT _DefGetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER pFileSize);
 
     DEFRESULT _DefGetLastError();
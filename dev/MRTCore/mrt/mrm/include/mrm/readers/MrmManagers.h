@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "mrm/Collections.h"
 #include "mrm/build/MrmBuilders.h"
 
@@ -994,6 +996,18 @@ public:
     virtual HRESULT GetQualifierProvider(_In_ PCWSTR qualifierName, _Out_ const IQualifierValueProvider** provider) const = 0;
 };
 
+// Cache counters a ResolverBase maintains while statistics are attached to it.
+// Updated with interlocked operations, so they can be read at any time.
+struct ResolverStatistics
+{
+    volatile LONG64 decisionCacheHits;
+    volatile LONG64 decisionCacheMisses;
+    volatile LONG64 qualifierSetCacheHits;
+    volatile LONG64 qualifierSetCacheMisses;
+    volatile LONG64 qualifierCacheHits;
+    volatile LONG64 qualifierCacheMisses;
+};
+
 class ResolverBase : public IResolver
 {
 public:
@@ -1010,6 +1024,18 @@ public:
 
     UINT64 GetGeneration() const { return m_generation; }
 
+    // Hash of the names and current values of every qualifier in the environment.
+    // Resolvers with equal signatures over the same decision info make the same
+    // decisions, whichever process they live in.
+    HRESULT GetContextSignature(_Out_ UINT64* pSignatureOut) const;
+
+    // Statistics are off (nullptr) by default; the caller owns the counters and must
+    // keep them alive while they are attached, and for as long as any thread might
+    // still be using the resolver after they're detached. Statistics can be attached
+    // and detached while other threads are resolving.
+    ResolverStatistics* GetStatistics() const { return m_pStatistics.load(std::memory_order_acquire); }
+    void SetStatistics(_In_opt_ ResolverStatistics* pStatistics) { m_pStatistics.store(pStatistics, std::memory_order_release); }
+
     virtual HRESULT GetQualifierValue(_In_ PCWSTR pQualifier, _Inout_ StringResult* pValue) const = 0;
 
     virtual HRESULT GetQualifierValue(_In_ Atom qualifier, _Inout_ StringResult* pValue) const = 0;
@@ -1046,6 +1072,11 @@ protected:
     const IDecisionInfo* m_pDecisions;
     UINT64 m_generation;
 
+    mutable UINT64 m_contextSignature;
+    mutable UINT64 m_contextSignatureGeneration;
+
+    std::atomic<ResolverStatistics*> m_pStatistics;
+
     mutable DecisionInfoCache* m_pCache;
     mutable SRWLOCK m_srwLock;
     mutable SRWLOCK m_srwQualifierSetLock;
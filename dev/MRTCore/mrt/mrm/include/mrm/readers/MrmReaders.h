@@ -492,6 +492,7 @@ private:
 };
 
 class IFileSectionResolver;
+class ReverseFileMapPathIndex;
 
 class ReverseFileMap : public FileSectionBase
 {
@@ -504,6 +505,14 @@ public:
 
     bool TryGetReverseMapCandidateIndex(_In_ PCWSTR pCandidateValue, _Out_ int* pReverseMapIndexOut) const;
 
+    // Resolves many candidate values in one call.  Values that are not in the map
+    // get an index of -1.
+    _Check_return_ HRESULT TryGetReverseMapCandidateIndices(
+        _In_ int numCandidateValues,
+        _In_reads_(numCandidateValues) const PCWSTR* ppCandidateValues,
+        _Out_writes_(numCandidateValues) int* pReverseMapIndicesOut,
+        _Out_opt_ int* pNumFoundOut) const;
+
     _Success_(return ) _Check_return_ HRESULT
         GetCandidateInfo(_In_ int reverseMapIndex, _Out_ int* pQualifierSetIndexOut, _Out_ int* pNamedResourceIndexOut) const;
 
@@ -517,9 +526,14 @@ private:
     const HierarchicalNames* m_pNames;
     int m_cbSection;
 
+    // Hashed full-path index over m_pNames, built on first lookup.
+    mutable ReverseFileMapPathIndex* m_pPathIndex;
+
     ReverseFileMap();
 
     HRESULT Init(_In_opt_ const IFileSection* pSection, _In_reads_bytes_(cbData) const void* pData, _In_ int cbData);
+
+    HRESULT GetOrCreatePathIndex(_Outptr_ const ReverseFileMapPathIndex** result) const;
 };
 
 class IRawResourceMap;
@@ -795,6 +809,90 @@ protected:
     mutable UINT16 m_currentMinorVersion;
 };
 
+// Walks the descendent resources of a subtree in the same order as
+// ResourceMapSubtree::GetDescendentResource, without materializing the
+// descendent index arrays.  Only a stack of open scopes is kept, so the
+// cost of starting an enumeration does not depend on the size of the map.
+class ResourceMapSubtreeEnumerator : public DefObject
+{
+public:
+    static HRESULT CreateInstance(_In_ const ResourceMapSubtree* pSubtree, _Outptr_ ResourceMapSubtreeEnumerator** result);
+
+    // Enumerates only the descendent resources whose names, relative to pSubtree,
+    // start with pPrefix.  The scope portion of the prefix is resolved directly and
+    // the final segment is matched against the sorted children of that scope, so the
+    // cost does not depend on the number of non-matching resources.  Matching is
+    // case-insensitive, like Contains, unless caseSensitive is set.  A trailing '*'
+    // is accepted and ignored.
+    static HRESULT CreateInstance(
+        _In_ const ResourceMapSubtree* pSubtree,
+        _In_ PCWSTR pPrefix,
+        _In_ bool caseSensitive,
+        _Outptr_ ResourceMapSubtreeEnumerator** result);
+
+    virtual ~ResourceMapSubtreeEnumerator();
+
+    void Reset();
+
+    // Advances to the next descendent resource.  *pHasCurrentOut is false once
+    // every descendent resource has been visited.
+    HRESULT MoveNext(_Out_ bool* pHasCurrentOut);
+
+    // Position of the current resource in enumeration order.  For an unfiltered
+    // enumerator this matches the index accepted by
+    // ResourceMapSubtree::GetDescendentResource.
+    int GetCurrentIndex() const { return m_currentIndex; }
+
+    int GetCurrentIndexInSchema() const { return m_currentItemIndex; }
+
+    HRESULT GetCurrentResource(_Inout_ NamedResourceResult* pItemOut) const;
+
+    // Gets the name of the current resource relative to the enumerated scope
+    HRESULT GetCurrentName(_Inout_ StringResult* pNameOut) const;
+
+    bool IsValid() const;
+
+protected:
+    struct ScopeFrame
+    {
+        int scopeIndex;
+        int endChild;
+        int nextChild;
+    };
+
+    ResourceMapSubtreeEnumerator();
+
+    HRESULT Init(_In_ const ResourceMapSubtree* pSubtree, _In_opt_ PCWSTR pPrefix, _In_ bool caseSensitive);
+
+    HRESULT InitPrefixRange(_In_ PCWSTR pPrefix);
+
+    HRESULT FindChildPrefixBound(_In_ bool upper, _Out_ int* pChildOut) const;
+
+    bool ChildMatchesPrefixExactCase(_In_ int childIndex) const;
+
+    HRESULT PushScope(_In_ int scopeIndex, _In_ int firstChild, _In_ int endChild);
+
+    const IResourceMapBase* m_pFullMap;
+    const IHierarchicalSchema* m_pSchema;
+    int m_rootScopeIndex;
+    UINT64 m_initGeneration;
+
+    // The children [m_firstChild, m_endChild) of m_startScopeIndex are the roots of
+    // the enumeration.  Without a prefix this is every child of m_rootScopeIndex.
+    int m_startScopeIndex;
+    int m_firstChild;
+    int m_endChild;
+    bool m_caseSensitive;
+    StringResult m_strPartialSegment;
+
+    _Field_size_(m_sizeStack) ScopeFrame* m_pStack;
+    int m_sizeStack;
+    int m_numStack;
+
+    int m_currentIndex;
+    int m_currentItemIndex;
+};
+
 class IFileSectionResolver;
 class ResourceMapFileData;
 
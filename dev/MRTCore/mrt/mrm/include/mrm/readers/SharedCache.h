@@ -0,0 +1,93 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "mrm/readers/SharedResolutionTable.h"
+
+namespace Microsoft::Resources
+{
+
+/*!
+ * Backing store for a SharedResolutionCache.  The cache only needs a fixed-size,
+ * zero-initialized region that every participating process can map; how the region
+ * is named and mapped is up to the implementation.
+ */
+class ISharedCacheStorage
+{
+public:
+    virtual ~ISharedCacheStorage() {}
+
+    virtual void* GetRegion() const = 0;
+    virtual UINT32 GetRegionSizeInBytes() const = 0;
+};
+
+/*!
+ * ISharedCacheStorage over a named, pagefile-backed file mapping.  Every storage
+ * opened with the same name in the same session shares the same region.  The
+ * security attributes only apply if this storage creates the mapping; callers
+ * that care who else can write it should check the mapping's security afterwards.
+ */
+class NamedSharedMemoryStorage : public DefObject, public ISharedCacheStorage
+{
+public:
+    using DefObject::operator delete;
+
+    static HRESULT CreateInstance(
+        _In_ PCWSTR pName,
+        _In_opt_ PSECURITY_ATTRIBUTES pSecurityAttributes,
+        _In_ UINT32 cbRegion,
+        _Outptr_ NamedSharedMemoryStorage** result);
+
+    virtual ~NamedSharedMemoryStorage();
+
+    void* GetRegion() const { return m_pView; }
+    UINT32 GetRegionSizeInBytes() const { return m_cbRegion; }
+
+    HANDLE GetMappingHandle() const { return m_hMapping; }
+
+protected:
+    NamedSharedMemoryStorage();
+
+    HRESULT Init(_In_ PCWSTR pName, _In_opt_ PSECURITY_ATTRIBUTES pSecurityAttributes, _In_ UINT32 cbRegion);
+
+    HANDLE m_hMapping;
+    void* m_pView;
+    UINT32 m_cbRegion;
+};
+
+/*!
+ * SharedResolutionTable (see SharedResolutionTable.h) laid out in an
+ * ISharedCacheStorage region so that processes resolving the same PRI file under
+ * the same context can reuse each other's decisions.
+ */
+class SharedResolutionCache : public DefObject, public SharedResolutionTable
+{
+public:
+    using DefObject::operator delete;
+
+    static const UINT32 DefaultRegionSizeInBytes = 256 * 1024;
+
+    static HRESULT CreateInstance(
+        _In_ ISharedCacheStorage* pStorage,
+        _In_ bool bTakeOwnership,
+        _Outptr_ SharedResolutionCache** result);
+
+    virtual ~SharedResolutionCache();
+
+protected:
+    SharedResolutionCache();
+
+    HRESULT Init(_In_ ISharedCacheStorage* pStorage, _In_ bool bTakeOwnership);
+
+    UINT32 CurrentProcessId() const override;
+
+    UINT64 TickCountInMs() const override;
+
+    bool IsProcessRunning(_In_ UINT32 processId) const override;
+
+    ISharedCacheStorage* m_pStorage;
+    bool m_bOwnStorage;
+};
+
+} // namespace Microsoft::Resources
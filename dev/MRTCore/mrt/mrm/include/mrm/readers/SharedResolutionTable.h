@@ -0,0 +1,362 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include "SharedRegionHeader.h" // dev\AppLifecycle
+
+namespace Microsoft::Resources
+{
+
+/*!
+ * Identifies one resolution: which PRI file, under which qualifier values, for
+ * which resource in which map.
+ */
+struct SharedResolutionCacheKey
+{
+    uint64_t fileIdentity;
+    uint64_t contextSignature;
+    uint32_t mapIdentity;
+    int resourceIndex;
+};
+
+/*!
+ * Bounded, lock-free table of winning candidate indexes, laid out in a region of
+ * memory that every participating process maps.  This is the shared part of
+ * SharedResolutionCache; it only depends on the C++ standard library so that the
+ * protocol can be exercised anywhere (e.g. across processes sharing POSIX shm).
+ * Derived classes supply the platform: process ids, a clock and whether a process
+ * is still running.
+ *
+ * Readers never block.  Each slot carries a sequence number that writers make odd
+ * while they update it; a reader that sees the sequence change, or see it odd,
+ * treats the slot as a miss.  Writers that lose a race simply skip the update.
+ * Entries are hints: callers must validate a returned candidate index before use.
+ *
+ * A writer that dies while it owns a slot would leave it odd forever, so a slot
+ * also records its owner's process id and when it was taken.  Another writer
+ * takes over a slot whose owner is gone, or that has been owned for longer than
+ * any update takes (which also covers the owner's process id being reused).
+ * An owner that was merely slow may still be writing when that happens, so every
+ * entry carries a check over its key and candidate that readers verify; a slot
+ * that ends up with parts of two writers' entries is a miss.
+ *
+ * The region must start out zero-filled.  Anything that changes the layout below,
+ * or how keys are hashed, must change Magic so that processes running different
+ * versions never read each other's slots.
+ */
+class SharedResolutionTable
+{
+public:
+    static constexpr uint32_t Magic = 0x4d524333; // 'MRC3'
+
+    // How long a writer can own a slot before others assume it's never coming back.
+    static constexpr uint32_t DefaultAbandonTimeoutInMs = 10 * 1000;
+
+    virtual ~SharedResolutionTable() {}
+
+    // Uses the largest power of two number of slots that fits.  Returns false if the
+    // region is too small or was laid out by a different version.
+    bool Attach(void* pRegion, size_t cbRegion)
+    {
+        if (!AppLifecycleCore::CanHoldLayout(pRegion, cbRegion, sizeof(Header) + (ProbeLength * sizeof(Slot))))
+        {
+            return false;
+        }
+
+        // Use the largest power of two that fits so probing can wrap with a mask.
+        uint32_t numSlots = 1;
+        while ((numSlots < 0x40000000u) && ((numSlots * 2) <= ((cbRegion - sizeof(Header)) / sizeof(Slot))))
+        {
+            numSlots *= 2;
+        }
+
+        Header* pHeader = static_cast<Header*>(pRegion);
+        if (!AppLifecycleCore::StampRegion(pHeader->tag, Magic, numSlots))
+        {
+            return false;
+        }
+
+        m_pSlots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(pRegion) + sizeof(Header));
+        m_numSlots = numSlots;
+        return true;
+    }
+
+    bool TryGetCandidateIndex(const SharedResolutionCacheKey* pKey, int* pCandidateIndexOut) const
+    {
+        *pCandidateIndexOut = -1;
+
+        const uint32_t hash = HashKey(pKey);
+        for (uint32_t probe = 0; probe < ProbeLength; probe++)
+        {
+            const Slot* pSlot = &m_pSlots[(hash + probe) & (m_numSlots - 1)];
+
+            const uint64_t lock = pSlot->lock.load(std::memory_order_acquire);
+            if ((SequenceOf(lock) & 1) != 0)
+            {
+                // Being written right now.
+                continue;
+            }
+
+            const int candidateIndexPlusOne = pSlot->candidateIndexPlusOne.load(std::memory_order_relaxed);
+            const uint64_t fileIdentity = pSlot->fileIdentity.load(std::memory_order_relaxed);
+            const uint64_t contextSignature = pSlot->contextSignature.load(std::memory_order_relaxed);
+            const uint32_t mapIdentity = pSlot->mapIdentity.load(std::memory_order_relaxed);
+            const int resourceIndex = pSlot->resourceIndex.load(std::memory_order_relaxed);
+            const uint64_t check = pSlot->check.load(std::memory_order_relaxed);
+
+            // The copy is only good if no writer touched the slot while we read it.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (pSlot->lock.load(std::memory_order_relaxed) != lock)
+            {
+                continue;
+            }
+
+            if ((candidateIndexPlusOne > 0) && (fileIdentity == pKey->fileIdentity) && (contextSignature == pKey->contextSignature) &&
+                (mapIdentity == pKey->mapIdentity) && (resourceIndex == pKey->resourceIndex) &&
+                (check == EntryCheck(fileIdentity, contextSignature, mapIdentity, resourceIndex, candidateIndexPlusOne)))
+            {
+                *pCandidateIndexOut = candidateIndexPlusOne - 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SetCandidateIndex(const SharedResolutionCacheKey* pKey, int candidateIndex)
+    {
+        if ((candidateIndex < 0) || (candidateIndex == INT_MAX))
+        {
+            return;
+        }
+
+        Slot* pTarget = FindSlotForWrite(pKey);
+        uint64_t lock;
+        if (!TryLockSlot(pTarget, &lock))
+        {
+            // Someone else is writing this slot; the cache is best-effort, so let them win.
+            return;
+        }
+
+        pTarget->fileIdentity.store(pKey->fileIdentity, std::memory_order_relaxed);
+        pTarget->contextSignature.store(pKey->contextSignature, std::memory_order_relaxed);
+        pTarget->mapIdentity.store(pKey->mapIdentity, std::memory_order_relaxed);
+        pTarget->resourceIndex.store(pKey->resourceIndex, std::memory_order_relaxed);
+        pTarget->candidateIndexPlusOne.store(candidateIndex + 1, std::memory_order_relaxed);
+        pTarget->check.store(
+            EntryCheck(pKey->fileIdentity, pKey->contextSignature, pKey->mapIdentity, pKey->resourceIndex, candidateIndex + 1),
+            std::memory_order_relaxed);
+
+        UnlockSlot(pTarget, lock);
+    }
+
+    uint32_t GetNumSlots() const { return m_numSlots; }
+
+protected:
+    struct Header
+    {
+        std::atomic<uint64_t> tag; // magic in the high 32 bits, slot count in the low 32 bits
+        uint64_t reserved[3];
+    };
+
+    struct Slot
+    {
+        std::atomic<uint64_t> lock; // sequence in the low 32 bits (odd while a writer owns the slot), owner's process id in the high 32 bits
+        std::atomic<uint64_t> lockedAt; // sequence it was taken at in the high 32 bits, tick count (ms) it was taken at in the low 32 bits
+        std::atomic<int> candidateIndexPlusOne; // 0 means the slot is empty
+        std::atomic<int> resourceIndex;
+        std::atomic<uint64_t> fileIdentity;
+        std::atomic<uint64_t> contextSignature;
+        std::atomic<uint32_t> mapIdentity;
+        uint32_t reserved;
+        std::atomic<uint64_t> check; // EntryCheck of the fields above, so torn entries can be spotted
+    };
+
+    static_assert(sizeof(Header) == 32, "Shared layout");
+    static_assert(sizeof(Slot) == 56, "Shared layout");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Atomics in shared memory must be lock-free");
+
+    // Number of adjacent slots searched for a key before giving up.
+    static constexpr uint32_t ProbeLength = 4;
+
+    static uint32_t SequenceOf(uint64_t lock) { return static_cast<uint32_t>(lock & 0xffffffff); }
+
+    static uint32_t OwnerOf(uint64_t lock) { return static_cast<uint32_t>(lock >> 32); }
+
+    static uint64_t MakeLock(uint32_t sequence, uint32_t owner) { return (static_cast<uint64_t>(owner) << 32) | sequence; }
+
+    // A lockedAt only describes the lock whose sequence it carries; anything else is left
+    // over from an earlier owner.  Ticks are truncated to 32 bits, which is plenty to
+    // measure a timeout with.
+    static uint64_t MakeLockedAt(uint32_t sequence, uint64_t ticks)
+    {
+        return (static_cast<uint64_t>(sequence) << 32) | static_cast<uint32_t>(ticks);
+    }
+
+    static uint32_t SequenceOfLockedAt(uint64_t lockedAt) { return static_cast<uint32_t>(lockedAt >> 32); }
+
+    static uint32_t TicksOfLockedAt(uint64_t lockedAt) { return static_cast<uint32_t>(lockedAt & 0xffffffff); }
+
+    static uint32_t HashKey(const SharedResolutionCacheKey* pKey)
+    {
+        uint64_t hash = pKey->fileIdentity;
+        hash = (hash ^ pKey->contextSignature) * 0x100000001b3ull;
+        hash = (hash ^ pKey->mapIdentity) * 0x100000001b3ull;
+        hash = (hash ^ static_cast<uint32_t>(pKey->resourceIndex)) * 0x100000001b3ull;
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    // A writer that was taken over may still be storing its entry while the new owner stores
+    // another, so a slot can end up with one writer's key and the other's candidate even though
+    // its sequence says it's stable.  Readers only trust an entry whose check matches.
+    static uint64_t EntryCheck(uint64_t fileIdentity, uint64_t contextSignature, uint32_t mapIdentity, int resourceIndex, int candidateIndexPlusOne)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hash = (hash ^ fileIdentity) * 0x100000001b3ull;
+        hash = (hash ^ contextSignature) * 0x100000001b3ull;
+        hash = (hash ^ mapIdentity) * 0x100000001b3ull;
+        hash = (hash ^ static_cast<uint32_t>(resourceIndex)) * 0x100000001b3ull;
+        hash = (hash ^ static_cast<uint32_t>(candidateIndexPlusOne)) * 0x100000001b3ull;
+        return hash ^ (hash >> 29);
+    }
+
+    Slot* FindSlotForWrite(const SharedResolutionCacheKey* pKey) const
+    {
+        const uint32_t hash = HashKey(pKey);
+
+        // Prefer a slot that already holds this key, then an empty (or abandoned) one.  If
+        // the neighbourhood is full, evict the slot picked by the high bits of the hash.
+        Slot* pTarget = nullptr;
+        for (uint32_t probe = 0; probe < ProbeLength; probe++)
+        {
+            Slot* pSlot = &m_pSlots[(hash + probe) & (m_numSlots - 1)];
+
+            const uint64_t lock = pSlot->lock.load(std::memory_order_acquire);
+            if ((SequenceOf(lock) & 1) != 0)
+            {
+                uint64_t lockedAt;
+                if ((pTarget == nullptr) && IsAbandoned(pSlot, lock, &lockedAt))
+                {
+                    pTarget = pSlot;
+                }
+                continue;
+            }
+
+            const int candidateIndexPlusOne = pSlot->candidateIndexPlusOne.load(std::memory_order_relaxed);
+            if ((candidateIndexPlusOne > 0) && (pSlot->fileIdentity.load(std::memory_order_relaxed) == pKey->fileIdentity) &&
+                (pSlot->contextSignature.load(std::memory_order_relaxed) == pKey->contextSignature) &&
+                (pSlot->mapIdentity.load(std::memory_order_relaxed) == pKey->mapIdentity) &&
+                (pSlot->resourceIndex.load(std::memory_order_relaxed) == pKey->resourceIndex))
+            {
+                return pSlot;
+            }
+
+            if ((pTarget == nullptr) && (candidateIndexPlusOne == 0))
+            {
+                pTarget = pSlot;
+            }
+        }
+
+        if (pTarget == nullptr)
+        {
+            pTarget = &m_pSlots[(hash + (hash >> 30)) & (m_numSlots - 1)];
+        }
+        return pTarget;
+    }
+
+    bool IsAbandoned(Slot* pSlot, uint64_t lock, uint64_t* pLockedAtOut) const
+    {
+        *pLockedAtOut = pSlot->lockedAt.load(std::memory_order_acquire);
+
+        const uint32_t owner = OwnerOf(lock);
+        if ((owner != 0) && !IsProcessRunning(owner))
+        {
+            return true;
+        }
+
+        const uint64_t now = TickCountInMs();
+        if (SequenceOfLockedAt(*pLockedAtOut) != SequenceOf(lock))
+        {
+            // The owner hasn't said when it took the slot yet (or died before it could),
+            // so start the clock now.
+            uint64_t expected = *pLockedAtOut;
+            pSlot->lockedAt.compare_exchange_strong(expected, MakeLockedAt(SequenceOf(lock), now));
+            return false;
+        }
+
+        // The owner's process id may have been reused, so an owner that's apparently
+        // still running but has held the slot for far longer than an update takes has
+        // abandoned it too.
+        return (static_cast<uint32_t>(now) - TicksOfLockedAt(*pLockedAtOut)) > m_abandonTimeoutInMs;
+    }
+
+    bool TryLockSlot(Slot* pSlot, uint64_t* pLockOut)
+    {
+        *pLockOut = 0;
+
+        uint64_t lock = pSlot->lock.load(std::memory_order_acquire);
+        const uint32_t sequence = SequenceOf(lock);
+        const uint64_t now = TickCountInMs();
+        uint64_t newLock;
+        if ((sequence & 1) == 0)
+        {
+            newLock = MakeLock(sequence + 1, CurrentProcessId());
+            if (!pSlot->lock.compare_exchange_strong(lock, newLock, std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            pSlot->lockedAt.store(MakeLockedAt(sequence + 1, now), std::memory_order_release);
+        }
+        else
+        {
+            uint64_t lockedAt;
+            if (!IsAbandoned(pSlot, lock, &lockedAt))
+            {
+                return false;
+            }
+
+            // Restart the clock before taking over so no one else thinks we've abandoned
+            // it too.  The sequence stays odd; it's still being written, just by us.
+            if (!pSlot->lockedAt.compare_exchange_strong(lockedAt, MakeLockedAt(sequence + 2, now), std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            newLock = MakeLock(sequence + 2, CurrentProcessId());
+            if (!pSlot->lock.compare_exchange_strong(lock, newLock, std::memory_order_acq_rel))
+            {
+                return false;
+            }
+        }
+
+        // Readers that see any of the entry we're about to write must also see the slot odd.
+        std::atomic_thread_fence(std::memory_order_release);
+
+        *pLockOut = newLock;
+        return true;
+    }
+
+    bool UnlockSlot(Slot* pSlot, uint64_t lock)
+    {
+        // If someone decided we'd abandoned the slot and took it over this fails, leaving
+        // the slot for them to publish.
+        return pSlot->lock.compare_exchange_strong(lock, MakeLock(SequenceOf(lock) + 1, 0), std::memory_order_acq_rel);
+    }
+
+    virtual uint32_t CurrentProcessId() const = 0;
+
+    // Milliseconds on a clock that every process sharing the region agrees on.
+    virtual uint64_t TickCountInMs() const = 0;
+
+    virtual bool IsProcessRunning(uint32_t processId) const = 0;
+
+    Slot* m_pSlots = nullptr;
+    uint32_t m_numSlots = 0;
+    uint32_t m_abandonTimeoutInMs = DefaultAbandonTimeoutInMs;
+};
+
+} // namespace Microsoft::Resources
@@ -660,6 +660,48 @@ extern "C"
     HANDLE
     _DefGetCurrentProcess() { return NtCurrentProcess(); }
 
+    ULONG
+    _DefGetCurrentProcessId() { return HandleToULong(NtCurrentTeb()->ClientId.UniqueProcess); }
+
+    ULONGLONG
+    _DefGetTickCount64()
+    {
+        LARGE_INTEGER Counter;
+        LARGE_INTEGER Frequency;
+
+        NtQueryPerformanceCounter(&Counter, &Frequency);
+        if (Frequency.QuadPart < 1000)
+        {
+            return 0;
+        }
+        return static_cast<ULONGLONG>(Counter.QuadPart) / static_cast<ULONGLONG>(Frequency.QuadPart / 1000);
+    }
+
+    BOOLEAN
+    _DefIsProcessRunning(__in ULONG ProcessId)
+    {
+        NTSTATUS Status;
+        HANDLE Process;
+        CLIENT_ID ClientId;
+        OBJECT_ATTRIBUTES Obja;
+        LARGE_INTEGER Timeout;
+
+        ClientId.UniqueProcess = ULongToHandle(ProcessId);
+        ClientId.UniqueThread = nullptr;
+        InitializeObjectAttributes(&Obja, nullptr, 0, nullptr, nullptr);
+        Status = NtOpenProcess(&Process, SYNCHRONIZE, &Obja, &ClientId);
+        if (!NT_SUCCESS(Status))
+        {
+            // Access denied etc. means there's a process we can't see
+            return (Status != STATUS_INVALID_CID) ? TRUE : FALSE;
+        }
+
+        Timeout.QuadPart = 0;
+        Status = NtWaitForSingleObject(Process, FALSE, &Timeout);
+        NtClose(Process);
+        return (Status == STATUS_TIMEOUT) ? TRUE : FALSE;
+    }
+
     HRESULT
     _DefGetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER pFileSize)
     {
@@ -948,6 +990,8 @@ extern "C"
 
 #else // !DEF_RTL
 
+#include "ProcessLiveness.h" // dev\AppLifecycle
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -1009,6 +1053,15 @@ extern "C"
     HANDLE
     _DefGetCurrentProcess() { return GetCurrentProcess(); }
 
+    ULONG
+    _DefGetCurrentProcessId() { return GetCurrentProcessId(); }
+
+    ULONGLONG
+    _DefGetTickCount64() { return GetTickCount64(); }
+
+    BOOLEAN
+    _DefIsProcessRunning(__in ULONG ProcessId) { return AppLifecycleCore::IsProcessAlive(ProcessId) ? TRUE : FALSE; }
+
     HRESULT
     _DefGetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER pFileSize)
     {
@@ -1096,7 +1096,13 @@ private:
 };
 
 ResolverBase::ResolverBase(_In_ const UnifiedEnvironment* pEnvironment, _In_ const IDecisionInfo* pDecisions) :
-    m_pEnvironment(pEnvironment), m_pDecisions(pDecisions), m_pCache(NULL)
+    m_pEnvironment(pEnvironment),
+    m_pDecisions(pDecisions),
+    m_generation(1),
+    m_contextSignature(0),
+    m_contextSignatureGeneration(0),
+    m_pStatistics(nullptr),
+    m_pCache(NULL)
 {
     ::InitializeSRWLock(&m_srwLock);
     ::InitializeSRWLock(&m_srwQualifierSetLock);
@@ -1125,6 +1131,7 @@ void ResolverBase::Reset()
             {
                 // the cache doesn't do anythnig interesting with per-qualifier reset yet so just reset the whole thing.
                 m_pCache->Reset();
+                m_generation++;
             }
         }
     }
@@ -1146,6 +1153,7 @@ HRESULT ResolverBase::Reset(__in_ecount(numQualifierNames) Atom* pQualifierNames
             {
                 // the cache doesn't do anythnig interesting with per-qualifier reset yet so just reset the whole thing.
                 m_pCache->Reset();
+                m_generation++;
             }
         }
     }
@@ -1153,6 +1161,65 @@ HRESULT ResolverBase::Reset(__in_ecount(numQualifierNames) Atom* pQualifierNames
     return S_OK;
 }
 
+HRESULT ResolverBase::GetContextSignature(_Out_ UINT64* pSignatureOut) const
+{
+    *pSignatureOut = 0;
+
+    UINT64 generation;
+    {
+        AutoReaderWriterLock autoLock(&m_srwLock, true);
+        generation = m_generation;
+        if (m_contextSignatureGeneration == generation)
+        {
+            *pSignatureOut = m_contextSignature;
+            return S_OK;
+        }
+    }
+
+    AutoDeletePtr<DynamicArray<Atom>> pQualifierNames;
+    RETURN_IF_FAILED(m_pEnvironment->GetAllAtoms(UnifiedEnvironment::QualifierNames, &pQualifierNames));
+
+    // FNV-1a over each qualifier's name and value, in environment order.  Values such as
+    // language lists can contain any separator, so each string is hashed after its length,
+    // and a qualifier without a value is told apart from one whose value is empty.
+    UINT64 signature = 0xcbf29ce484222325ull;
+    StringResult name;
+    StringResult value;
+    for (UINT32 i = 0; i < pQualifierNames->Count(); i++)
+    {
+        Atom qualifier;
+        RETURN_IF_FAILED(pQualifierNames->Get(i, &qualifier));
+        RETURN_IF_FAILED(m_pEnvironment->GetName(UnifiedEnvironment::QualifierNames, qualifier, &name));
+
+        HRESULT hr = GetQualifierValue(qualifier, &value);
+        RETURN_HR_IF(hr, FAILED(hr) && (hr != HRESULT_FROM_WIN32(ERROR_NOT_FOUND)));
+
+        PCWSTR parts[] = {name.GetRef(), (SUCCEEDED(hr) ? value.GetRef() : nullptr)};
+        for (PCWSTR pPart : parts)
+        {
+            UINT64 length = (pPart != nullptr) ? wcslen(pPart) : ULLONG_MAX;
+            signature = (signature ^ length) * 0x100000001b3ull;
+            for (PCWSTR pCh = pPart; (pCh != nullptr) && (*pCh != L'\0'); pCh++)
+            {
+                signature = (signature ^ *pCh) * 0x100000001b3ull;
+            }
+        }
+    }
+
+    {
+        // Only publish if no qualifier changed while we were computing.
+        AutoReaderWriterLock autoLock(&m_srwLock);
+        if (m_generation == generation)
+        {
+            m_contextSignature = signature;
+            m_contextSignatureGeneration = generation;
+        }
+    }
+
+    *pSignatureOut = signature;
+    return S_OK;
+}
+
 HRESULT ResolverBase::EvaluateQualifier(_In_ const IQualifier* pQualifier, _Out_ double* pScoreOut, _Out_ double* pFallbackScoreOut) const
 {
     UINT16 score = 0;
@@ -1168,11 +1235,21 @@ HRESULT ResolverBase::EvaluateQualifier(_In_ const IQualifier* pQualifier, _Out_
 HRESULT ResolverBase::EvaluateQualifier(_In_ const IQualifier* pQualifier, _Out_ UINT16* pScoreOut, _Out_ UINT16* pFallbackScoreOut) const
 {
     // Have we seen this qualifier before?
+    ResolverStatistics* pStatistics = GetStatistics();
     if (SUCCEEDED(m_pCache->GetQualifierScores(pQualifier, pScoreOut, pFallbackScoreOut)))
     {
+        if (pStatistics != nullptr)
+        {
+            InterlockedIncrement64(&pStatistics->qualifierCacheHits);
+        }
         return S_OK;
     }
 
+    if (pStatistics != nullptr)
+    {
+        InterlockedIncrement64(&pStatistics->qualifierCacheMisses);
+    }
+
     double score = 0.0;
     double fallbackScore;
     RETURN_IF_FAILED(pQualifier->GetFallbackScore(&fallbackScore));
@@ -1225,11 +1302,21 @@ HRESULT ResolverBase::EvaluateQualifierSet(
     _Out_opt_ UINT16* pScoreOut = NULL) const
 {
     // Have we seen this qualifier set before
+    ResolverStatistics* pStatistics = GetStatistics();
     if (SUCCEEDED(m_pCache->GetQualifierSetResults(pQualifierSet, pbIsMatchOut, pbIsDefaultOut, pbIsMatchOrDefaultOut, pScoreOut)))
     {
+        if (pStatistics != nullptr)
+        {
+            InterlockedIncrement64(&pStatistics->qualifierSetCacheHits);
+        }
         return S_OK;
     }
 
+    if (pStatistics != nullptr)
+    {
+        InterlockedIncrement64(&pStatistics->qualifierSetCacheMisses);
+    }
+
     // Nope.  Try to evaluate it.
     bool bIsMatch = true;
     bool bIsDefault = true;
@@ -1319,10 +1406,21 @@ HRESULT ResolverBase::EvaluateDecision(
 {
     AutoReaderWriterLock autoLock(&m_srwLock); // protect pResults object for potential race condition
 
+    ResolverStatistics* pStatistics = GetStatistics();
     if (SUCCEEDED(m_pCache->GetDecisionResults(pDecision, numResults, pResultIndexesOut, pResultSetIndexesOut)))
     {
+        if (pStatistics != nullptr)
+        {
+            InterlockedIncrement64(&pStatistics->decisionCacheHits);
+        }
         return S_OK;
     }
+
+    if (pStatistics != nullptr)
+    {
+        InterlockedIncrement64(&pStatistics->decisionCacheMisses);
+    }
+
     int numSets = 0;
     DecisionInfoCache::DecisionPerSetInfo* pResults;
     RETURN_IF_FAILED(m_pCache->BeginSetDecisionResults(pDecision, &pResults, &numSets));
@@ -1730,6 +1828,13 @@ HRESULT ProviderResolver::SetQualifier(_In_ Atom qualifier, _In_ PCWSTR pNewValu
 
     RETURN_IF_FAILED(m_pQualifiers->SetQualifierValue(qualifier, pNewValue, true));
 
+    {
+        // Reset() bumped the generation before the new value landed; bump it again
+        // so nothing computed in between (e.g. a context signature) outlives it.
+        AutoReaderWriterLock autoLock(&m_srwLock);
+        m_generation++;
+    }
+
     return S_OK;
 }
 
@@ -1319,6 +1319,332 @@ bool ResourceMapSubtree::IsValid() const
     return true;
 }
 
+ResourceMapSubtreeEnumerator::ResourceMapSubtreeEnumerator() :
+    m_pFullMap(nullptr),
+    m_pSchema(nullptr),
+    m_rootScopeIndex(-1),
+    m_initGeneration(0),
+    m_startScopeIndex(-1),
+    m_firstChild(0),
+    m_endChild(0),
+    m_caseSensitive(false),
+    m_pStack(nullptr),
+    m_sizeStack(0),
+    m_numStack(0),
+    m_currentIndex(-1),
+    m_currentItemIndex(-1)
+{}
+
+ResourceMapSubtreeEnumerator::~ResourceMapSubtreeEnumerator()
+{
+    if (m_pStack != nullptr)
+    {
+        Def_Free(m_pStack);
+        m_pStack = nullptr;
+    }
+    m_sizeStack = 0;
+    m_numStack = 0;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::CreateInstance(_In_ const ResourceMapSubtree* pSubtree, _Outptr_ ResourceMapSubtreeEnumerator** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF_NULL_EXPECTED(E_INVALIDARG, pSubtree);
+
+    AutoDeletePtr<ResourceMapSubtreeEnumerator> pRtrn = new ResourceMapSubtreeEnumerator();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+
+    RETURN_IF_FAILED(pRtrn->Init(pSubtree, nullptr, false));
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::CreateInstance(
+    _In_ const ResourceMapSubtree* pSubtree,
+    _In_ PCWSTR pPrefix,
+    _In_ bool caseSensitive,
+    _Outptr_ ResourceMapSubtreeEnumerator** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF_NULL_EXPECTED(E_INVALIDARG, pSubtree);
+    RETURN_HR_IF_NULL_EXPECTED(E_INVALIDARG, pPrefix);
+
+    AutoDeletePtr<ResourceMapSubtreeEnumerator> pRtrn = new ResourceMapSubtreeEnumerator();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+
+    RETURN_IF_FAILED(pRtrn->Init(pSubtree, pPrefix, caseSensitive));
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::Init(_In_ const ResourceMapSubtree* pSubtree, _In_opt_ PCWSTR pPrefix, _In_ bool caseSensitive)
+{
+    m_pFullMap = pSubtree->GetFullResourceMap();
+    m_pSchema = m_pFullMap->GetSchema();
+    m_rootScopeIndex = pSubtree->GetIndexInSchema();
+    m_initGeneration = m_pFullMap->GetCurrentGeneration();
+    m_caseSensitive = caseSensitive;
+
+    RETURN_HR_IF_EXPECTED(
+        HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (m_rootScopeIndex < 0) || (m_rootScopeIndex > m_pSchema->GetNumScopes() - 1));
+
+    m_startScopeIndex = m_rootScopeIndex;
+    m_firstChild = 0;
+
+    StringResult name;
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !m_pSchema->TryGetScopeInfo(m_rootScopeIndex, &name, &m_endChild));
+
+    if (!DefString_IsEmpty(pPrefix))
+    {
+        RETURN_IF_FAILED(InitPrefixRange(pPrefix));
+    }
+
+    Reset();
+    return S_OK;
+}
+
+static bool IsScopePathSeparator(_In_ WCHAR ch) { return (ch == L'/') || (ch == L'\\'); }
+
+// Contains() matches scope names case-insensitively; this confirms the exact case of a path it found.
+static bool ScopePathEqualsExactCase(_In_ PCWSTR pFoundPath, _In_ PCWSTR pRequestedPath)
+{
+    if (IsScopePathSeparator(pRequestedPath[0]))
+    {
+        pRequestedPath++;
+    }
+
+    for (; (*pFoundPath != L'\0') && (*pRequestedPath != L'\0'); pFoundPath++, pRequestedPath++)
+    {
+        if ((*pFoundPath != *pRequestedPath) && !(IsScopePathSeparator(*pFoundPath) && IsScopePathSeparator(*pRequestedPath)))
+        {
+            return false;
+        }
+    }
+
+    return (*pFoundPath == L'\0') && (*pRequestedPath == L'\0');
+}
+
+HRESULT ResourceMapSubtreeEnumerator::InitPrefixRange(_In_ PCWSTR pPrefix)
+{
+    size_t cchPrefix = wcslen(pPrefix);
+    if ((cchPrefix > 0) && (pPrefix[cchPrefix - 1] == L'*'))
+    {
+        cchPrefix--;
+    }
+
+    // Everything up to the last separator names a scope, the rest is a partial segment.
+    size_t cchScope = cchPrefix;
+    while ((cchScope > 0) && !IsScopePathSeparator(pPrefix[cchScope - 1]))
+    {
+        cchScope--;
+    }
+
+    RETURN_IF_FAILED(m_strPartialSegment.SetCopy(&pPrefix[cchScope]));
+    PWSTR pPartial;
+    size_t cchPartial;
+    RETURN_IF_FAILED(m_strPartialSegment.GetWritableRef(&pPartial, &cchPartial));
+    pPartial[cchPrefix - cchScope] = L'\0';
+
+    if (cchScope > 1)
+    {
+        StringResult strScopePath;
+        RETURN_IF_FAILED(strScopePath.SetCopy(pPrefix));
+        PWSTR pScopePath;
+        size_t cchScopePath;
+        RETURN_IF_FAILED(strScopePath.GetWritableRef(&pScopePath, &cchScopePath));
+        pScopePath[cchScope - 1] = L'\0';
+
+        int scopeIndex = -1;
+        StringResult strFoundName;
+        if (!m_pSchema->Contains(pScopePath, m_rootScopeIndex, &scopeIndex, nullptr) || (scopeIndex < 0) ||
+            (m_caseSensitive && (!m_pSchema->TryGetRelativeScopeName(m_rootScopeIndex, scopeIndex, &strFoundName) ||
+                                 !ScopePathEqualsExactCase(strFoundName.GetRef(), pScopePath))))
+        {
+            // Nothing can match under a scope that does not exist.
+            m_firstChild = m_endChild = 0;
+            return S_OK;
+        }
+
+        StringResult name;
+        m_startScopeIndex = scopeIndex;
+        m_firstChild = 0;
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !m_pSchema->TryGetScopeInfo(m_startScopeIndex, &name, &m_endChild));
+    }
+
+    if (m_strPartialSegment.GetRef()[0] != L'\0')
+    {
+        int firstChild, endChild;
+        RETURN_IF_FAILED(FindChildPrefixBound(false, &firstChild));
+        RETURN_IF_FAILED(FindChildPrefixBound(true, &endChild));
+        m_firstChild = firstChild;
+        m_endChild = max(firstChild, endChild);
+    }
+
+    return S_OK;
+}
+
+// Children of a scope are sorted by CompareSegments, so the children whose names start
+// with the partial segment are contiguous.  Comparing only the first characters of each
+// child name against the partial segment gives an ordering that is monotonic in the
+// child index, which lets both ends of the range be found with a binary search.
+HRESULT ResourceMapSubtreeEnumerator::FindChildPrefixBound(_In_ bool upper, _Out_ int* pChildOut) const
+{
+    PCWSTR pPartial = m_strPartialSegment.GetRef();
+    int cchPartial = static_cast<int>(wcslen(pPartial));
+
+    int low = m_firstChild;
+    int high = m_endChild;
+    while (low < high)
+    {
+        int mid = low + ((high - low) / 2);
+
+        StringResult childName;
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !m_pSchema->TryGetScopeChildName(m_startScopeIndex, mid, &childName));
+
+        PCWSTR pChildName = childName.GetRef();
+        int cchCompare = min(static_cast<int>(wcslen(pChildName)), cchPartial);
+        int diff = CompareStringOrdinal(pChildName, cchCompare, pPartial, cchPartial, TRUE) - 2;
+
+        if ((diff < 0) || (upper && (diff == 0)))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    *pChildOut = low;
+    return S_OK;
+}
+
+bool ResourceMapSubtreeEnumerator::ChildMatchesPrefixExactCase(_In_ int childIndex) const
+{
+    PCWSTR pPartial = m_strPartialSegment.GetRef();
+    if (pPartial[0] == L'\0')
+    {
+        return true;
+    }
+
+    StringResult childName;
+    if (!m_pSchema->TryGetScopeChildName(m_startScopeIndex, childIndex, &childName))
+    {
+        return false;
+    }
+
+    return (wcsncmp(childName.GetRef(), pPartial, wcslen(pPartial)) == 0);
+}
+
+void ResourceMapSubtreeEnumerator::Reset()
+{
+    m_numStack = 0;
+    m_currentIndex = -1;
+    m_currentItemIndex = -1;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::PushScope(_In_ int scopeIndex, _In_ int firstChild, _In_ int endChild)
+{
+    // A well-formed schema cannot nest deeper than it has scopes
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_numStack >= m_pSchema->GetNumScopes());
+
+    if (m_numStack >= m_sizeStack)
+    {
+        int sizeNew = ((m_sizeStack > 0) ? (m_sizeStack * 2) : 8);
+        RETURN_HR_IF(E_OUTOFMEMORY, !_DefArray_TryEnsureSize(&m_pStack, ScopeFrame, m_sizeStack, sizeNew));
+        m_sizeStack = sizeNew;
+    }
+
+    if (endChild < 0)
+    {
+        StringResult name;
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !m_pSchema->TryGetScopeInfo(scopeIndex, &name, &endChild));
+    }
+
+    m_pStack[m_numStack].scopeIndex = scopeIndex;
+    m_pStack[m_numStack].endChild = endChild;
+    m_pStack[m_numStack].nextChild = firstChild;
+    m_numStack++;
+    return S_OK;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::MoveNext(_Out_ bool* pHasCurrentOut)
+{
+    *pHasCurrentOut = false;
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_MAP_NOT_FOUND), !IsValid());
+
+    if ((m_currentIndex < 0) && (m_numStack == 0))
+    {
+        RETURN_IF_FAILED(PushScope(m_startScopeIndex, m_firstChild, m_endChild));
+    }
+
+    while (m_numStack > 0)
+    {
+        ScopeFrame* pFrame = &m_pStack[m_numStack - 1];
+        if (pFrame->nextChild >= pFrame->endChild)
+        {
+            m_numStack--;
+            continue;
+        }
+
+        int childIndex = pFrame->nextChild++;
+        if (m_caseSensitive && (m_numStack == 1) && !ChildMatchesPrefixExactCase(childIndex))
+        {
+            continue;
+        }
+
+        int childScopeIndex = -1;
+        int childItemIndex = -1;
+        RETURN_HR_IF(
+            HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE),
+            !m_pSchema->TryGetScopeChild(pFrame->scopeIndex, childIndex, &childScopeIndex, &childItemIndex));
+
+        if (childScopeIndex >= 0)
+        {
+            // Descend before moving on to siblings, matching GetDescendents
+            RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), childScopeIndex == pFrame->scopeIndex);
+            RETURN_IF_FAILED(PushScope(childScopeIndex, 0, -1));
+            continue;
+        }
+
+        m_currentIndex++;
+        m_currentItemIndex = childItemIndex;
+        *pHasCurrentOut = true;
+        return S_OK;
+    }
+
+    // Leave the enumerator positioned after the last resource
+    m_currentItemIndex = -1;
+    return S_OK;
+}
+
+HRESULT ResourceMapSubtreeEnumerator::GetCurrentResource(_Inout_ NamedResourceResult* pItemOut) const
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), m_currentItemIndex < 0);
+
+    return m_pFullMap->GetResourceByIndex(m_currentItemIndex, pItemOut);
+}
+
+HRESULT ResourceMapSubtreeEnumerator::GetCurrentName(_Inout_ StringResult* pNameOut) const
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), m_currentItemIndex < 0);
+
+    if (m_pSchema->TryGetRelativeItemName(m_rootScopeIndex, m_currentItemIndex, pNameOut))
+    {
+        return S_OK;
+    }
+
+    return HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND);
+}
+
+bool ResourceMapSubtreeEnumerator::IsValid() const
+{
+    return (m_pFullMap != nullptr) && (m_initGeneration == m_pFullMap->GetCurrentGeneration());
+}
+
 HRESULT ResourceMapBase::CreateInstance(
     _In_ const IFileSectionResolver* pSections,
     _In_ const ISchemaCollection* pSchemaCollection,
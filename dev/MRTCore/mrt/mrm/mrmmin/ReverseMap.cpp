@@ -6,6 +6,199 @@
 namespace Microsoft::Resources
 {
 
+// In-memory hash of every full path in a reverse map's names section.  Paths are
+// hashed and compared the same way HierarchicalNames::Contains matches them: case
+// is ignored, '/' and '\\' are equivalent and a single leading separator is ignored.
+class ReverseFileMapPathIndex : public DefObject
+{
+public:
+    static HRESULT CreateInstance(_In_ const HierarchicalNames* pNames, _Outptr_ ReverseFileMapPathIndex** result);
+
+    ~ReverseFileMapPathIndex();
+
+    bool TryFind(_In_ PCWSTR pPath, _Out_ int* pItemIndexOut) const;
+
+private:
+    struct Slot
+    {
+        UINT32 hash;
+        int itemIndex;
+        UINT32 pathOffset;
+        UINT32 cchPath;
+    };
+
+    Slot* m_pSlots;
+    UINT32 m_numSlots;
+    WCHAR* m_pPaths;
+    UINT32 m_cchPaths;
+    UINT32 m_sizePaths;
+
+    ReverseFileMapPathIndex() : m_pSlots(nullptr), m_numSlots(0), m_pPaths(nullptr), m_cchPaths(0), m_sizePaths(0) {}
+
+    HRESULT Init(_In_ const HierarchicalNames* pNames);
+
+    static WCHAR NormalizePathChar(_In_ WCHAR ch) { return (ch == L'\\') ? L'/' : static_cast<WCHAR>(towupper(ch)); }
+
+    static PCWSTR SkipLeadingSeparator(_In_ PCWSTR pPath) { return ((pPath[0] == L'/') || (pPath[0] == L'\\')) ? pPath + 1 : pPath; }
+
+    static UINT32 HashPath(_In_ PCWSTR pPath, _Out_ UINT32* pcchOut);
+
+    bool PathEquals(_In_ const Slot* pSlot, _In_reads_(cchPath) PCWSTR pPath, _In_ UINT32 cchPath) const;
+};
+
+UINT32 ReverseFileMapPathIndex::HashPath(_In_ PCWSTR pPath, _Out_ UINT32* pcchOut)
+{
+    // FNV-1a over the normalized characters
+    UINT32 hash = 2166136261u;
+    UINT32 cch = 0;
+    for (; pPath[cch] != L'\0'; cch++)
+    {
+        hash = (hash ^ NormalizePathChar(pPath[cch])) * 16777619u;
+    }
+    *pcchOut = cch;
+    return hash;
+}
+
+bool ReverseFileMapPathIndex::PathEquals(_In_ const Slot* pSlot, _In_reads_(cchPath) PCWSTR pPath, _In_ UINT32 cchPath) const
+{
+    if (pSlot->cchPath != cchPath)
+    {
+        return false;
+    }
+
+    PCWSTR pStored = &m_pPaths[pSlot->pathOffset];
+    for (UINT32 i = 0; i < cchPath; i++)
+    {
+        if (NormalizePathChar(pStored[i]) != NormalizePathChar(pPath[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+HRESULT ReverseFileMapPathIndex::Init(_In_ const HierarchicalNames* pNames)
+{
+    int numItems = pNames->GetNumItems();
+
+    // Keep the load factor at or below one half so probe sequences stay short
+    m_numSlots = 16;
+    while (m_numSlots < static_cast<UINT32>(numItems) * 2)
+    {
+        RETURN_HR_IF(E_OUTOFMEMORY, m_numSlots > (UINT32_MAX / 2));
+        m_numSlots *= 2;
+    }
+
+    m_pSlots = _DefArray_AllocZeroed(Slot, m_numSlots);
+    RETURN_IF_NULL_ALLOC(m_pSlots);
+    for (UINT32 i = 0; i < m_numSlots; i++)
+    {
+        m_pSlots[i].itemIndex = -1;
+    }
+
+    StringResult name;
+    for (int itemIndex = 0; itemIndex < numItems; itemIndex++)
+    {
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !pNames->TryGetItemInfo(itemIndex, &name));
+
+        PCWSTR pPath = SkipLeadingSeparator(name.GetRef());
+        UINT32 cchPath;
+        UINT32 hash = HashPath(pPath, &cchPath);
+
+        UINT32 slotIndex = hash & (m_numSlots - 1);
+        bool duplicate = false;
+        while (m_pSlots[slotIndex].itemIndex >= 0)
+        {
+            if ((m_pSlots[slotIndex].hash == hash) && PathEquals(&m_pSlots[slotIndex], pPath, cchPath))
+            {
+                // Contains() resolves to the first match, so the first item wins
+                duplicate = true;
+                break;
+            }
+            slotIndex = (slotIndex + 1) & (m_numSlots - 1);
+        }
+
+        if (duplicate)
+        {
+            continue;
+        }
+
+        if (m_cchPaths + cchPath > m_sizePaths)
+        {
+            UINT32 sizeNew = ((m_sizePaths > 0) ? m_sizePaths : 256);
+            while (sizeNew < m_cchPaths + cchPath)
+            {
+                RETURN_HR_IF(E_OUTOFMEMORY, sizeNew > (UINT32_MAX / 2));
+                sizeNew *= 2;
+            }
+            RETURN_HR_IF(E_OUTOFMEMORY, !_DefArray_TryEnsureSize(&m_pPaths, WCHAR, m_sizePaths, sizeNew));
+            m_sizePaths = sizeNew;
+        }
+
+        CopyMemory(&m_pPaths[m_cchPaths], pPath, cchPath * sizeof(WCHAR));
+
+        m_pSlots[slotIndex].hash = hash;
+        m_pSlots[slotIndex].itemIndex = itemIndex;
+        m_pSlots[slotIndex].pathOffset = m_cchPaths;
+        m_pSlots[slotIndex].cchPath = cchPath;
+        m_cchPaths += cchPath;
+    }
+
+    return S_OK;
+}
+
+HRESULT ReverseFileMapPathIndex::CreateInstance(_In_ const HierarchicalNames* pNames, _Outptr_ ReverseFileMapPathIndex** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF_NULL(E_INVALIDARG, pNames);
+
+    AutoDeletePtr<ReverseFileMapPathIndex> pRtrn = new ReverseFileMapPathIndex();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+    RETURN_IF_FAILED(pRtrn->Init(pNames));
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+ReverseFileMapPathIndex::~ReverseFileMapPathIndex()
+{
+    if (m_pSlots != nullptr)
+    {
+        Def_Free(m_pSlots);
+        m_pSlots = nullptr;
+    }
+
+    if (m_pPaths != nullptr)
+    {
+        Def_Free(m_pPaths);
+        m_pPaths = nullptr;
+    }
+}
+
+bool ReverseFileMapPathIndex::TryFind(_In_ PCWSTR pPath, _Out_ int* pItemIndexOut) const
+{
+    *pItemIndexOut = -1;
+
+    if (DefString_IsEmpty(pPath))
+    {
+        return false;
+    }
+
+    pPath = SkipLeadingSeparator(pPath);
+    UINT32 cchPath;
+    UINT32 hash = HashPath(pPath, &cchPath);
+
+    for (UINT32 slotIndex = hash & (m_numSlots - 1); m_pSlots[slotIndex].itemIndex >= 0; slotIndex = (slotIndex + 1) & (m_numSlots - 1))
+    {
+        if ((m_pSlots[slotIndex].hash == hash) && PathEquals(&m_pSlots[slotIndex], pPath, cchPath))
+        {
+            *pItemIndexOut = m_pSlots[slotIndex].itemIndex;
+            return true;
+        }
+    }
+    return false;
+}
+
 HRESULT ReverseFileMap::Init(__in_opt const IFileSection* pSection, __in_bcount(cbData) const void* pData, __in int cbData)
 {
     RETURN_IF_FAILED(FileSectionBase::Init(pSection, pData, cbData));
@@ -66,19 +259,90 @@ HRESULT ReverseFileMap::CreateInstance(__in_bcount(cbData) const void* pData, __
     return S_OK;
 }
 
-ReverseFileMap::ReverseFileMap() : m_pHeader(NULL), m_pEntries(NULL), m_pNames(NULL) {}
+ReverseFileMap::ReverseFileMap() : m_pHeader(NULL), m_pEntries(NULL), m_pNames(NULL), m_pPathIndex(NULL) {}
 
-ReverseFileMap::~ReverseFileMap() { delete m_pNames; }
+ReverseFileMap::~ReverseFileMap()
+{
+    delete m_pPathIndex;
+    delete m_pNames;
+}
 
 const DEFFILE_SECTION_TYPEID ReverseFileMap::GetSectionTypeId() { return gReverseFileMapSectionType; }
 
+HRESULT ReverseFileMap::GetOrCreatePathIndex(_Outptr_ const ReverseFileMapPathIndex** result) const
+{
+    *result = m_pPathIndex;
+    if (*result != nullptr)
+    {
+        return S_OK;
+    }
+
+    // Build outside of any lock and publish with a single exchange.  If another
+    // thread got there first, use its index and discard ours.
+    ReverseFileMapPathIndex* pIndex;
+    RETURN_IF_FAILED(ReverseFileMapPathIndex::CreateInstance(m_pNames, &pIndex));
+
+    PVOID pExisting = InterlockedCompareExchangePointer(reinterpret_cast<PVOID*>(&m_pPathIndex), pIndex, nullptr);
+    if (pExisting != nullptr)
+    {
+        delete pIndex;
+        pIndex = static_cast<ReverseFileMapPathIndex*>(pExisting);
+    }
+
+    *result = pIndex;
+    return S_OK;
+}
+
 bool ReverseFileMap::TryGetReverseMapCandidateIndex(__in PCWSTR pCandidateValue, __out int* pReverseMapIndexOut) const
 {
+    const ReverseFileMapPathIndex* pIndex;
+    if (SUCCEEDED(GetOrCreatePathIndex(&pIndex)))
+    {
+        return pIndex->TryFind(pCandidateValue, pReverseMapIndexOut);
+    }
+
+    // Couldn't build the index (e.g. out of memory), so walk the names directly.
     int scopeIndexOut;
     int nameIndexOut;
     return m_pNames->Contains(pCandidateValue, &scopeIndexOut, pReverseMapIndexOut, &nameIndexOut);
 }
 
+HRESULT ReverseFileMap::TryGetReverseMapCandidateIndices(
+    _In_ int numCandidateValues,
+    _In_reads_(numCandidateValues) const PCWSTR* ppCandidateValues,
+    _Out_writes_(numCandidateValues) int* pReverseMapIndicesOut,
+    _Out_opt_ int* pNumFoundOut) const
+{
+    if (pNumFoundOut != nullptr)
+    {
+        *pNumFoundOut = 0;
+    }
+    RETURN_HR_IF(E_INVALIDARG, numCandidateValues < 0);
+    RETURN_HR_IF(E_INVALIDARG, (numCandidateValues > 0) && ((ppCandidateValues == nullptr) || (pReverseMapIndicesOut == nullptr)));
+
+    const ReverseFileMapPathIndex* pIndex;
+    RETURN_IF_FAILED(GetOrCreatePathIndex(&pIndex));
+
+    int numFound = 0;
+    for (int i = 0; i < numCandidateValues; i++)
+    {
+        if ((ppCandidateValues[i] != nullptr) && pIndex->TryFind(ppCandidateValues[i], &pReverseMapIndicesOut[i]))
+        {
+            numFound++;
+        }
+        else
+        {
+            pReverseMapIndicesOut[i] = -1;
+        }
+    }
+
+    if (pNumFoundOut != nullptr)
+    {
+        *pNumFoundOut = numFound;
+    }
+    return S_OK;
+}
+
 HRESULT
 ReverseFileMap::GetCandidateInfo(_In_ int reverseMapIndex, _Out_ int* pQualifierSetIndexOut, _Out_ int* pNamedResourceIndexOut) const
 {
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+
+namespace Microsoft::Resources
+{
+
+NamedSharedMemoryStorage::NamedSharedMemoryStorage() : m_hMapping(nullptr), m_pView(nullptr), m_cbRegion(0) {}
+
+NamedSharedMemoryStorage::~NamedSharedMemoryStorage()
+{
+    if (m_pView != nullptr)
+    {
+        _DefUnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+
+    if (m_hMapping != nullptr)
+    {
+        _DefCloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+}
+
+HRESULT NamedSharedMemoryStorage::Init(_In_ PCWSTR pName, _In_opt_ PSECURITY_ATTRIBUTES pSecurityAttributes, _In_ UINT32 cbRegion)
+{
+    // Pagefile-backed sections are zero-filled when first created, which is the
+    // empty state for every consumer of this storage.
+    RETURN_IF_FAILED(_DefCreateFileMapping(INVALID_HANDLE_VALUE, pSecurityAttributes, PAGE_READWRITE, 0, cbRegion, pName, &m_hMapping));
+
+    // If the section already existed it may be smaller than requested, in which
+    // case the map fails and the caller goes without.
+    RETURN_IF_FAILED(_DefMapViewOfFile(m_hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, cbRegion, &m_pView));
+
+    m_cbRegion = cbRegion;
+    return S_OK;
+}
+
+HRESULT NamedSharedMemoryStorage::CreateInstance(
+    _In_ PCWSTR pName,
+    _In_opt_ PSECURITY_ATTRIBUTES pSecurityAttributes,
+    _In_ UINT32 cbRegion,
+    _Outptr_ NamedSharedMemoryStorage** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pName) || (cbRegion == 0));
+
+    AutoDeletePtr<NamedSharedMemoryStorage> pRtrn = new NamedSharedMemoryStorage();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+    RETURN_IF_FAILED(pRtrn->Init(pName, pSecurityAttributes, cbRegion));
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+SharedResolutionCache::SharedResolutionCache() : m_pStorage(nullptr), m_bOwnStorage(false) {}
+
+SharedResolutionCache::~SharedResolutionCache()
+{
+    if (m_bOwnStorage)
+    {
+        delete m_pStorage;
+    }
+    m_pStorage = nullptr;
+    m_pSlots = nullptr;
+}
+
+HRESULT SharedResolutionCache::Init(_In_ ISharedCacheStorage* pStorage, _In_ bool bTakeOwnership)
+{
+    void* pRegion = pStorage->GetRegion();
+    UINT32 cbRegion = pStorage->GetRegionSizeInBytes();
+    RETURN_HR_IF(E_INVALIDARG, (pRegion == nullptr) || (cbRegion < sizeof(Header) + (ProbeLength * sizeof(Slot))));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), !Attach(pRegion, cbRegion));
+
+    m_pStorage = pStorage;
+    m_bOwnStorage = bTakeOwnership;
+    return S_OK;
+}
+
+HRESULT SharedResolutionCache::CreateInstance(
+    _In_ ISharedCacheStorage* pStorage,
+    _In_ bool bTakeOwnership,
+    _Outptr_ SharedResolutionCache** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF_NULL(E_INVALIDARG, pStorage);
+
+    AutoDeletePtr<SharedResolutionCache> pRtrn = new SharedResolutionCache();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+    RETURN_IF_FAILED(pRtrn->Init(pStorage, bTakeOwnership));
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+UINT32 SharedResolutionCache::CurrentProcessId() const { return _DefGetCurrentProcessId(); }
+
+UINT64 SharedResolutionCache::TickCountInMs() const { return _DefGetTickCount64(); }
+
+bool SharedResolutionCache::IsProcessRunning(_In_ UINT32 processId) const
+{
+    return (processId == _DefGetCurrentProcessId()) || _DefIsProcessRunning(processId);
+}
+
+} // namespace Microsoft::Resources
\ No newline at end of file
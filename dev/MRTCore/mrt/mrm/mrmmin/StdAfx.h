@@ -21,3 +21,4 @@
 #include "mrm/readers/Atoms.h"
 #include "mrm/Results.h"
 #include "mrm/readers/MrmManagers.h"
+#include "mrm/readers/SharedCache.h"
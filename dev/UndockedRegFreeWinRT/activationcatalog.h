@@ -0,0 +1,474 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(ACTIVATIONCATALOG_H)
+#define ACTIVATIONCATALOG_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compiled activation catalog: the activatable classes declared by an exe's reg-free WinRT
+// manifests, in a form that can be mapped and searched in place instead of parsing XML at
+// every process start.
+//
+// This header only depends on the C++ standard library so the format can be built and
+// tested anywhere. Loading and saving files lives in catalog.cpp.
+//
+// All integers are little-endian. Offsets are in bytes from the start of the catalog;
+// strings are UTF-16 code units in a pool, referred to by (index, length) in code units.
+//
+//      uint32  magic
+//      uint32  version
+//      uint32  checksum (FNV-1a of everything after this field)
+//      uint32  source count, sources offset
+//      uint32  module count, modules offset
+//      uint32  class count, classes offset
+//      uint32  strings offset, string pool length
+//      sources[]:  { uint32 path index, uint32 path length, uint64 manifest hash }
+//      modules[]:  { uint32 path index, uint32 path length }
+//      classes[]:  { uint32 id index, uint32 id length, uint32 module, uint32 threading model }
+//                  sorted by activatableClassId (ordinal) so lookups are a binary search
+//      strings[]:  uint16
+//
+// Sources are the manifests the catalog was compiled from; if any's content no longer
+// hashes the same the catalog is stale. Module paths are interned, one per <file>.
+//
+// Catalogs live where anything running as the user can write them, so their module paths are
+// only trusted if they're confined to the exe's directory (see IsConfinedModulePath).
+namespace UndockedRegFreeWinRT::ActivationCatalog
+{
+    constexpr uint32_t c_magic{ 0x43465255 };   // 'URFC'
+    constexpr uint32_t c_version{ 1 };
+
+    struct Source
+    {
+        std::wstring path;
+        uint64_t hash{};
+    };
+
+    struct ActivatableClass
+    {
+        std::wstring activatableClassId;
+        std::wstring moduleName;
+        uint8_t threadingModel{};           // ABI::Windows::Foundation::ThreadingType
+    };
+
+    // Highest ThreadingType (ThreadingType_MTA) a catalog may hold
+    constexpr uint32_t c_maxThreadingModel{ 2 };
+
+    /// Hash of a manifest's content, to record in (and validate) a Source.
+    inline uint64_t HashManifest(const uint8_t* data, size_t size)
+    {
+        uint64_t hash{ 14695981039346656037ull };
+        for (size_t index=0; index < size; ++index)
+        {
+            hash = (hash ^ data[index]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /// True if a module path from a catalog stays inside the directory it's relative to:
+    /// not rooted, no drive or stream (':'), and no '..' segments (nor anything Win32 path
+    /// normalization turns into one, i.e. only dots and spaces). Anything else could name
+    /// a DLL anywhere, and catalog.cpp won't load it.
+    inline bool IsConfinedModulePath(std::wstring_view path)
+    {
+        if (path.empty() || (path.front() == L'\\') || (path.front() == L'/') || (path.find(L':') != std::wstring_view::npos))
+        {
+            return false;
+        }
+        size_t start{};
+        while (start <= path.size())
+        {
+            auto end{ path.find_first_of(L"\\/", start) };
+            if (end == std::wstring_view::npos)
+            {
+                end = path.size();
+            }
+            const auto segment{ path.substr(start, end - start) };
+            if (segment.find_first_not_of(L". ") == std::wstring_view::npos)
+            {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    namespace details
+    {
+        constexpr size_t c_headerSize{ 11 * 4 };
+        constexpr size_t c_sourceSize{ 16 };
+        constexpr size_t c_moduleSize{ 8 };
+        constexpr size_t c_classSize{ 16 };
+
+        inline uint32_t Checksum(const uint8_t* data, size_t size)
+        {
+            uint32_t hash{ 2166136261u };
+            for (size_t index=0; index < size; ++index)
+            {
+                hash = (hash ^ data[index]) * 16777619u;
+            }
+            return hash;
+        }
+
+        inline uint32_t ReadUInt32(const uint8_t* data)
+        {
+            return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                   (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+        inline void WriteUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+        {
+            for (int shift=0; shift < 32; shift += 8)
+            {
+                data[offset++] = static_cast<uint8_t>(value >> shift);
+            }
+        }
+
+        // Interns strings in the pool, as UTF-16 code units
+        class StringPool
+        {
+        public:
+            std::pair<uint32_t, uint32_t> Add(const std::wstring& string)
+            {
+                auto iterator{ m_strings.find(string) };
+                if (iterator != m_strings.end())
+                {
+                    return iterator->second;
+                }
+                const std::pair<uint32_t, uint32_t> reference{ static_cast<uint32_t>(m_units.size()), static_cast<uint32_t>(string.size()) };
+                for (const auto c : string)
+                {
+                    m_units.push_back(static_cast<uint16_t>(c));
+                }
+                m_strings.emplace(string, reference);
+                return reference;
+            }
+
+            const std::vector<uint16_t>& Units() const
+            {
+                return m_units;
+            }
+
+        private:
+            std::unordered_map<std::wstring, std::pair<uint32_t, uint32_t>> m_strings;
+            std::vector<uint16_t> m_units;
+        };
+
+        // Ordinal comparison of UTF-16 code units, as stored
+        inline int Compare(std::wstring_view left, std::wstring_view right)
+        {
+            const size_t length{ std::min(left.size(), right.size()) };
+            for (size_t index=0; index < length; ++index)
+            {
+                const auto l{ static_cast<uint16_t>(left[index]) };
+                const auto r{ static_cast<uint16_t>(right[index]) };
+                if (l != r)
+                {
+                    return (l < r) ? -1 : 1;
+                }
+            }
+            return (left.size() == right.size()) ? 0 : ((left.size() < right.size()) ? -1 : 1);
+        }
+    }
+
+    /// Compile the activatable classes declared by the sources into a catalog.
+    ///
+    /// @return false if an activatableClassId is declared more than once (as the manifests
+    ///         are then invalid; see ERROR_SXS_DUPLICATE_ACTIVATABLE_CLASS).
+    inline bool Compile(
+        const std::vector<Source>& sources,
+        const std::vector<ActivatableClass>& activatableClasses,
+        std::vector<uint8_t>& catalog)
+    {
+        catalog.clear();
+
+        std::vector<const ActivatableClass*> sorted;
+        sorted.reserve(activatableClasses.size());
+        for (const auto& activatableClass : activatableClasses)
+        {
+            sorted.push_back(&activatableClass);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto* left, const auto* right) {
+            return details::Compare(left->activatableClassId, right->activatableClassId) < 0;
+        });
+        for (size_t index=1; index < sorted.size(); ++index)
+        {
+            if (details::Compare(sorted[index - 1]->activatableClassId, sorted[index]->activatableClassId) == 0)
+            {
+                return false;
+            }
+        }
+
+        details::StringPool strings;
+        std::unordered_map<std::wstring, uint32_t> moduleIndexes;
+        std::vector<std::pair<uint32_t, uint32_t>> modules;
+        std::vector<uint32_t> classModules;
+        classModules.reserve(sorted.size());
+        for (const auto* activatableClass : sorted)
+        {
+            auto [iterator, added]{ moduleIndexes.emplace(activatableClass->moduleName, static_cast<uint32_t>(modules.size())) };
+            if (added)
+            {
+                modules.push_back(strings.Add(activatableClass->moduleName));
+            }
+            classModules.push_back(iterator->second);
+        }
+
+        const size_t sourcesOffset{ details::c_headerSize };
+        const size_t modulesOffset{ sourcesOffset + sources.size() * details::c_sourceSize };
+        const size_t classesOffset{ modulesOffset + modules.size() * details::c_moduleSize };
+        const size_t stringsOffset{ classesOffset + sorted.size() * details::c_classSize };
+
+        // Strings are added as the tables are written, so the pool's size isn't known until the end
+        std::vector<uint8_t> data(stringsOffset);
+        size_t offset{ sourcesOffset };
+        for (const auto& source : sources)
+        {
+            const auto path{ strings.Add(source.path) };
+            details::WriteUInt32(data, offset, path.first);
+            details::WriteUInt32(data, offset + 4, path.second);
+            details::WriteUInt32(data, offset + 8, static_cast<uint32_t>(source.hash));
+            details::WriteUInt32(data, offset + 12, static_cast<uint32_t>(source.hash >> 32));
+            offset += details::c_sourceSize;
+        }
+        for (const auto& module : modules)
+        {
+            details::WriteUInt32(data, offset, module.first);
+            details::WriteUInt32(data, offset + 4, module.second);
+            offset += details::c_moduleSize;
+        }
+        for (size_t index=0; index < sorted.size(); ++index)
+        {
+            const auto id{ strings.Add(sorted[index]->activatableClassId) };
+            details::WriteUInt32(data, offset, id.first);
+            details::WriteUInt32(data, offset + 4, id.second);
+            details::WriteUInt32(data, offset + 8, classModules[index]);
+            details::WriteUInt32(data, offset + 12, sorted[index]->threadingModel);
+            offset += details::c_classSize;
+        }
+        for (const auto unit : strings.Units())
+        {
+            data.push_back(static_cast<uint8_t>(unit));
+            data.push_back(static_cast<uint8_t>(unit >> 8));
+        }
+
+        const uint32_t header[]{
+            c_magic, c_version, 0,
+            static_cast<uint32_t>(sources.size()), static_cast<uint32_t>(sourcesOffset),
+            static_cast<uint32_t>(modules.size()), static_cast<uint32_t>(modulesOffset),
+            static_cast<uint32_t>(sorted.size()), static_cast<uint32_t>(classesOffset),
+            static_cast<uint32_t>(stringsOffset), static_cast<uint32_t>(strings.Units().size()) };
+        for (size_t index=0; index < std::size(header); ++index)
+        {
+            details::WriteUInt32(data, index * 4, header[index]);
+        }
+        const size_t c_checksumOffset{ 8 };
+        details::WriteUInt32(data, c_checksumOffset, details::Checksum(data.data() + c_checksumOffset + 4, data.size() - c_checksumOffset - 4));
+
+        catalog = std::move(data);
+        return true;
+    }
+
+    /// A compiled catalog, searched in place.
+    ///
+    /// Open() validates the whole catalog (including that the classes are sorted) so the
+    /// accessors don't have to. The data must outlive the View.
+    class View
+    {
+    public:
+        /// @return false if the data isn't a well-formed catalog (e.g. corrupt, or another version).
+        bool Open(const uint8_t* data, size_t size)
+        {
+            *this = View{};
+            if ((data == nullptr) || (size < details::c_headerSize))
+            {
+                return false;
+            }
+
+            uint32_t header[11]{};
+            for (size_t index=0; index < std::size(header); ++index)
+            {
+                header[index] = details::ReadUInt32(data + index * 4);
+            }
+            if ((header[0] != c_magic) || (header[1] != c_version) ||
+                (header[2] != details::Checksum(data + 12, size - 12)))
+            {
+                return false;
+            }
+
+            auto fits = [&](uint32_t offset, uint64_t count, size_t itemSize) {
+                return (offset <= size) && (count * itemSize <= size - offset);
+            };
+            if (!fits(header[4], header[3], details::c_sourceSize) ||
+                !fits(header[6], header[5], details::c_moduleSize) ||
+                !fits(header[8], header[7], details::c_classSize) ||
+                !fits(header[9], header[10], sizeof(uint16_t)))
+            {
+                return false;
+            }
+
+            View view;
+            view.m_sourceCount = header[3];
+            view.m_sources = data + header[4];
+            view.m_moduleCount = header[5];
+            view.m_modules = data + header[6];
+            view.m_classCount = header[7];
+            view.m_classes = data + header[8];
+            view.m_strings = data + header[9];
+            view.m_stringsLength = header[10];
+
+            for (uint32_t index=0; index < view.m_sourceCount; ++index)
+            {
+                if (!view.IsString(view.m_sources + index * details::c_sourceSize))
+                {
+                    return false;
+                }
+            }
+            for (uint32_t index=0; index < view.m_moduleCount; ++index)
+            {
+                if (!view.IsString(view.m_modules + index * details::c_moduleSize))
+                {
+                    return false;
+                }
+            }
+            for (uint32_t index=0; index < view.m_classCount; ++index)
+            {
+                const uint8_t* activatableClass{ view.m_classes + index * details::c_classSize };
+                if (!view.IsString(activatableClass) || (details::ReadUInt32(activatableClass + 8) >= view.m_moduleCount) ||
+                    (details::ReadUInt32(activatableClass + 12) > c_maxThreadingModel) ||
+                    ((index > 0) && (view.CompareClassId(index - 1, view.GetActivatableClassId(index)) >= 0)))
+                {
+                    return false;
+                }
+            }
+
+            *this = view;
+            return true;
+        }
+
+        uint32_t SourceCount() const
+        {
+            return m_sourceCount;
+        }
+
+        Source GetSource(uint32_t index) const
+        {
+            const uint8_t* source{ m_sources + index * details::c_sourceSize };
+            return Source{ GetString(source), details::ReadUInt32(source + 8) | (static_cast<uint64_t>(details::ReadUInt32(source + 12)) << 32) };
+        }
+
+        uint32_t ModuleCount() const
+        {
+            return m_moduleCount;
+        }
+
+        std::wstring GetModule(uint32_t index) const
+        {
+            return GetString(m_modules + index * details::c_moduleSize);
+        }
+
+        uint32_t ClassCount() const
+        {
+            return m_classCount;
+        }
+
+        std::wstring GetActivatableClassId(uint32_t index) const
+        {
+            return GetString(m_classes + index * details::c_classSize);
+        }
+
+        ActivatableClass GetActivatableClass(uint32_t index) const
+        {
+            const uint8_t* activatableClass{ m_classes + index * details::c_classSize };
+            const uint32_t module{ details::ReadUInt32(activatableClass + 8) };
+            return ActivatableClass{ GetString(activatableClass), GetString(m_modules + module * details::c_moduleSize),
+                                     static_cast<uint8_t>(details::ReadUInt32(activatableClass + 12)) };
+        }
+
+        /// The index of the class, or -1 if the catalog doesn't declare it.
+        int32_t Find(std::wstring_view activatableClassId) const
+        {
+            uint32_t low{};
+            uint32_t high{ m_classCount };
+            while (low < high)
+            {
+                const uint32_t middle{ low + (high - low) / 2 };
+                const int comparison{ CompareClassId(middle, activatableClassId) };
+                if (comparison == 0)
+                {
+                    return static_cast<int32_t>(middle);
+                }
+                else if (comparison < 0)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+            return -1;
+        }
+
+    private:
+        bool IsString(const uint8_t* reference) const
+        {
+            const uint64_t index{ details::ReadUInt32(reference) };
+            const uint64_t length{ details::ReadUInt32(reference + 4) };
+            return index + length <= m_stringsLength;
+        }
+
+        std::wstring GetString(const uint8_t* reference) const
+        {
+            const uint32_t index{ details::ReadUInt32(reference) };
+            const uint32_t length{ details::ReadUInt32(reference + 4) };
+            std::wstring string(length, L'\0');
+            for (uint32_t unit=0; unit < length; ++unit)
+            {
+                const uint8_t* data{ m_strings + (index + unit) * sizeof(uint16_t) };
+                string[unit] = static_cast<wchar_t>(data[0] | (data[1] << 8));
+            }
+            return string;
+        }
+
+        // Compare class index's id to the string, as details::Compare()
+        int CompareClassId(uint32_t index, std::wstring_view string) const
+        {
+            const uint8_t* activatableClass{ m_classes + index * details::c_classSize };
+            const uint8_t* units{ m_strings + details::ReadUInt32(activatableClass) * sizeof(uint16_t) };
+            const size_t length{ details::ReadUInt32(activatableClass + 4) };
+            const size_t commonLength{ std::min(length, string.size()) };
+            for (size_t unit=0; unit < commonLength; ++unit)
+            {
+                const auto l{ static_cast<uint16_t>(units[unit * 2] | (units[unit * 2 + 1] << 8)) };
+                const auto r{ static_cast<uint16_t>(string[unit]) };
+                if (l != r)
+                {
+                    return (l < r) ? -1 : 1;
+                }
+            }
+            return (length == string.size()) ? 0 : ((length < string.size()) ? -1 : 1);
+        }
+
+    private:
+        uint32_t m_sourceCount{};
+        const uint8_t* m_sources{};
+        uint32_t m_moduleCount{};
+        const uint8_t* m_modules{};
+        uint32_t m_classCount{};
+        const uint8_t* m_classes{};
+        const uint8_t* m_strings{};
+        uint32_t m_stringsLength{};
+    };
+}
+
+#endif // ACTIVATIONCATALOG_H
@@ -5,6 +5,7 @@
 
 #include "catalog.h"
 #include "TypeResolution.h"
+#include "activationcatalog.h"
 
 #include <activation.h>
 #include <shlwapi.h>
@@ -12,7 +13,8 @@
 
 #include <wrl.h>
 
-#include <../DynamicDependency/API/MddWinRT.h>
+#include <atomic>
+#include <filesystem>
 
 using namespace std;
 using namespace Microsoft::WRL;
@@ -24,18 +26,34 @@ extern "C"
     typedef HRESULT(__stdcall* activation_factory_type)(HSTRING, IActivationFactory**);
 }
 
-// Intentionally no class factory cache here. That would be excessive since
-// other layers already cache.
+// Class factories are only cached if the process opts in (see UrfwEnableFactoryCache).
+// Other layers usually cache already, and only agile factories can be cached as
+// they're the only ones that can be handed to callers in any apartment.
+//
+// Bit 0 is set while caching's enabled. The rest is a generation, bumped by every
+// WinRTEnableFactoryCache_SxS(), so a factory obtained under an earlier setting is
+// never published to (or served from) a component's cache.
+static std::atomic<uint64_t> g_factoryCacheState{ 0 };
+constexpr uint64_t c_factoryCacheEnabled{ 1 };
+
 struct component
 {
+    wstring activatable_class;
     wstring module_name;
     wstring xmlns;
     HMODULE handle = nullptr;
-    activation_factory_type get_activation_factory;
+    std::atomic<activation_factory_type> get_activation_factory{};
     ABI::Windows::Foundation::ThreadingType threading_model;
 
+    std::mutex load_lock;
+    wil::srwlock factory_lock;
+    wil::com_ptr<IActivationFactory> cached_factory;
+    uint64_t cached_factory_state{};    // g_factoryCacheState when cached_factory was published
+
     ~component()
     {
+        // The factory's code lives in the module so let go of it first
+        cached_factory.reset();
         if (handle)
         {
             FreeLibrary(handle);
@@ -44,39 +62,124 @@ struct component
 
     HRESULT LoadModule()
     {
-        if (handle == nullptr)
+        // get_activation_factory is set after handle so if we see it the module's loaded
+        if (this->get_activation_factory.load(std::memory_order_acquire) != nullptr)
+        {
+            return S_OK;
+        }
+
+        auto lock{ std::lock_guard<std::mutex>(load_lock) };
+        if (this->get_activation_factory.load(std::memory_order_relaxed) != nullptr)
+        {
+            return S_OK;
+        }
+
+        wil::unique_hmodule module{ LoadLibraryExW(module_name.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH) };
+        RETURN_LAST_ERROR_IF_NULL(module);
+        auto dllGetActivationFactory{ reinterpret_cast<activation_factory_type>(GetProcAddress(module.get(), "DllGetActivationFactory")) };
+        RETURN_LAST_ERROR_IF_NULL(dllGetActivationFactory);
+
+        handle = module.release();
+        this->get_activation_factory.store(dllGetActivationFactory, std::memory_order_release);
+        return S_OK;
+    }
+
+    HRESULT GetActivationFactory(HSTRING className, REFIID  iid, void** factory)
+    {
+        const auto cache_state{ g_factoryCacheState.load(std::memory_order_acquire) };
+        const bool cache_enabled{ (cache_state & c_factoryCacheEnabled) != 0 };
+        if (cache_enabled)
         {
-            handle = LoadLibraryExW(module_name.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH);
-            if (handle == nullptr)
+            auto lock{ factory_lock.lock_shared() };
+            if (cached_factory && (cached_factory_state == cache_state))
             {
-                return HRESULT_FROM_WIN32(GetLastError());
+                return cached_factory->QueryInterface(iid, factory);
             }
-            this->get_activation_factory = (activation_factory_type)GetProcAddress(handle, "DllGetActivationFactory");
-            if (this->get_activation_factory == nullptr)
+        }
+
+        RETURN_IF_FAILED(LoadModule());
+
+        wil::com_ptr<IActivationFactory> ifactory;
+        RETURN_IF_FAILED(this->get_activation_factory.load(std::memory_order_acquire)(className, ifactory.put()));
+        if (cache_enabled && ifactory.try_query<IAgileObject>())
+        {
+            wil::com_ptr<IActivationFactory> stale_factory;
+            auto lock{ factory_lock.lock_exclusive() };
+
+            // Only publish if the setting's unchanged since we looked. WinRTEnableFactoryCache_SxS()
+            // changes it before dropping cached factories (under this lock), so either it sees and
+            // drops ours or we see its change here and don't publish.
+            auto expected_state{ cache_state };
+            if (g_factoryCacheState.compare_exchange_strong(expected_state, cache_state, std::memory_order_acq_rel) &&
+                (!cached_factory || (cached_factory_state != cache_state)))
             {
-                return HRESULT_FROM_WIN32(GetLastError());
+                stale_factory = std::exchange(cached_factory, ifactory);
+                cached_factory_state = cache_state;
             }
         }
-        return (handle != nullptr && this->get_activation_factory != nullptr) ? S_OK : E_FAIL;
+        return ifactory->QueryInterface(iid, factory);
     }
+};
 
-    HRESULT GetActivationFactory(HSTRING className, REFIID  iid, void** factory)
+// activatableClassId -> its component. Keys refer to the component's activatable_class
+// so lookups can use an HSTRING's buffer as-is. Only written while loading the catalog.
+static unordered_map<wstring_view, shared_ptr<component>> g_types;
+
+// Compiled catalogs larger than this aren't ours
+constexpr DWORD c_maxCompiledCatalogSize{ 64 * 1024 * 1024 };
+
+// Manifests larger than this aren't hashed (and so never get a compiled catalog)
+constexpr DWORD c_maxManifestSize{ 16 * 1024 * 1024 };
+
+// A compiled catalog (see activationcatalog.h) used instead of g_types. It's mapped for the
+// life of the process and components are created the first time their class is looked up.
+struct compiled_catalog
+{
+    std::filesystem::path exe_directory;
+    wil::unique_handle mapping;
+    wil::unique_mapview_ptr<uint8_t> view;
+    UndockedRegFreeWinRT::ActivationCatalog::View catalog;
+    std::unique_ptr<std::atomic<component*>[]> components;
+
+    ~compiled_catalog()
     {
-        RETURN_IF_FAILED(LoadModule());
+        if (components)
+        {
+            for (uint32_t index = 0; index < catalog.ClassCount(); ++index)
+            {
+                delete components[index].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    component* GetComponent(uint32_t index) noexcept try
+    {
+        auto this_component = components[index].load(std::memory_order_acquire);
+        if (this_component != nullptr)
+        {
+            return this_component;
+        }
 
-        IActivationFactory* ifactory = nullptr;
-        HRESULT hr = this->get_activation_factory(className, &ifactory);
-        // optimize for IActivationFactory?
-        if (SUCCEEDED(hr))
+        const auto activatableClass{ catalog.GetActivatableClass(index) };
+        auto new_component = std::make_unique<component>();
+        new_component->activatable_class = activatableClass.activatableClassId;
+        // OpenCompiledCatalog checked it's confined to the exe's directory
+        new_component->module_name = (exe_directory / activatableClass.moduleName).wstring();
+        new_component->threading_model = static_cast<ABI::Windows::Foundation::ThreadingType>(activatableClass.threadingModel);
+        if (!components[index].compare_exchange_strong(this_component, new_component.get(), std::memory_order_acq_rel))
         {
-            hr = ifactory->QueryInterface(iid, factory);
-            ifactory->Release();
+            // Someone else got there first
+            return this_component;
         }
-        return hr;
+        return new_component.release();
+    }
+    catch (...)
+    {
+        LOG_CAUGHT_EXCEPTION();
+        return nullptr;
     }
 };
-
-static unordered_map<wstring, shared_ptr<component>> g_types;
+static std::unique_ptr<compiled_catalog> g_compiledCatalog;
 
 HRESULT LoadManifestFromPath(std::wstring path)
 {
@@ -101,26 +204,34 @@ HRESULT LoadFromSxSManifest(PCWSTR path)
     return WinRTLoadComponentFromFilePath(path);
 }
 
-HRESULT LoadFromEmbeddedManifest(PCWSTR path)
+static HRESULT GetEmbeddedManifest(HMODULE handle, std::string_view& manifest)
 {
-    wil::unique_hmodule handle(LoadLibraryExW(path, nullptr, LOAD_LIBRARY_AS_DATAFILE_EXCLUSIVE));
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), !handle);
-
     // Try both just to be on the safe side
-    HRSRC hrsc = FindResourceW(handle.get(), MAKEINTRESOURCEW(1), RT_MANIFEST);
+    HRSRC hrsc = FindResourceW(handle, MAKEINTRESOURCEW(1), RT_MANIFEST);
     if (!hrsc)
     {
-        hrsc = FindResourceW(handle.get(), MAKEINTRESOURCEW(2), RT_MANIFEST);
+        hrsc = FindResourceW(handle, MAKEINTRESOURCEW(2), RT_MANIFEST);
         RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), !hrsc);
     }
-    HGLOBAL embeddedManifest = LoadResource(handle.get(), hrsc);
+    HGLOBAL embeddedManifest = LoadResource(handle, hrsc);
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), !embeddedManifest);
 
-    DWORD length = SizeofResource(handle.get(), hrsc);
+    DWORD length = SizeofResource(handle, hrsc);
     void* data = LockResource(embeddedManifest);
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), !data);
 
-    return WinRTLoadComponentFromString(std::string_view((char*)data, length));
+    manifest = std::string_view((char*)data, length);
+    return S_OK;
+}
+
+HRESULT LoadFromEmbeddedManifest(PCWSTR path)
+{
+    wil::unique_hmodule handle(LoadLibraryExW(path, nullptr, LOAD_LIBRARY_AS_DATAFILE_EXCLUSIVE));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), !handle);
+
+    std::string_view manifest;
+    RETURN_IF_FAILED(GetEmbeddedManifest(handle.get(), manifest));
+    return WinRTLoadComponentFromString(manifest);
 }
 
 HRESULT WinRTLoadComponentFromFilePath(PCWSTR manifestPath)
@@ -294,73 +405,359 @@ HRESULT ParseActivatableClassTag(IXmlReader* xmlReader, PCWSTR fileName)
     {
         return HRESULT_FROM_WIN32(ERROR_SXS_DUPLICATE_ACTIVATABLE_CLASS);
     }
-    g_types[activatableClass] = this_component;
+    this_component->activatable_class = activatableClass;
+    g_types.emplace(this_component->activatable_class, this_component);
     return S_OK;
 }
 
-HRESULT WinRTGetThreadingModel(HSTRING activatableClassId, ABI::Windows::Foundation::ThreadingType* threading_model)
+HRESULT WinRTResolveActivatableClass(HSTRING activatableClassId, WinRTActivatableClass& activatableClass)
 {
-    HRESULT hr{ WinRTGetThreadingModel_PackageGraph(activatableClassId, threading_model) };
+    // The package graph takes precedence over the SxS manifest
+    activatableClass = {};
+    HRESULT hr{ WinRTGetThreadingModel_PackageGraph(activatableClassId, &activatableClass.threading_model, &activatableClass.package_graph_class) };
     if (hr == REGDB_E_CLASSNOTREG)  // Not found
     {
-        hr = WinRTGetThreadingModel_SxS(activatableClassId, threading_model);
+        auto sxs_component = WinRTFindComponent_SxS(activatableClassId);
+        if (sxs_component == nullptr)
+        {
+            return REGDB_E_CLASSNOTREG;
+        }
+        activatableClass.threading_model = sxs_component->threading_model;
+        activatableClass.sxs_component = sxs_component;
+        return S_OK;
     }
     return hr;
 }
 
-HRESULT WinRTGetThreadingModel_PackageGraph(HSTRING activatableClassId, ABI::Windows::Foundation::ThreadingType* threading_model)
+HRESULT WinRTGetThreadingModel_PackageGraph(
+    HSTRING activatableClassId,
+    ABI::Windows::Foundation::ThreadingType* threading_model,
+    MddCore::WinRT::ResolvedClass* resolved_class)
 {
+    if (resolved_class)
+    {
+        return MddCore::WinRT::GetThreadingModel(activatableClassId, *threading_model, *resolved_class);
+    }
     return MddCore::WinRT::GetThreadingModel(activatableClassId, *threading_model);
 }
 
-HRESULT WinRTGetThreadingModel_SxS(HSTRING activatableClassId, ABI::Windows::Foundation::ThreadingType* threading_model)
+component* WinRTFindComponent_SxS(HSTRING activatableClassId)
 {
-    auto raw_class_name = WindowsGetStringRawBuffer(activatableClassId, nullptr);
-    auto component_iter = g_types.find(raw_class_name);
+    if (g_compiledCatalog)
+    {
+        UINT32 raw_class_name_length{};
+        auto raw_class_name = WindowsGetStringRawBuffer(activatableClassId, &raw_class_name_length);
+        const auto index{ g_compiledCatalog->catalog.Find(wstring_view(raw_class_name, raw_class_name_length)) };
+        if (index < 0)
+        {
+            return nullptr;
+        }
+        return g_compiledCatalog->GetComponent(static_cast<uint32_t>(index));
+    }
+
+    if (g_types.empty())
+    {
+        return nullptr;
+    }
+
+    UINT32 raw_class_name_length{};
+    auto raw_class_name = WindowsGetStringRawBuffer(activatableClassId, &raw_class_name_length);
+    auto component_iter = g_types.find(wstring_view(raw_class_name, raw_class_name_length));
     if (component_iter != g_types.end())
     {
-        *threading_model = component_iter->second->threading_model;
-        return S_OK;
+        return component_iter->second.get();
     }
-    return REGDB_E_CLASSNOTREG;
+    return nullptr;
 }
 
 HRESULT WinRTGetActivationFactory(
+    const WinRTActivatableClass& activatableClass,
     HSTRING activatableClassId,
     REFIID iid,
     void** factory)
 {
-    RETURN_IF_FAILED(WinRTGetActivationFactory_PackageGraph(activatableClassId, iid, factory));
-    if (*factory == nullptr)    // Not found
+    *factory = nullptr;
+    if (activatableClass.sxs_component != nullptr)
     {
-        RETURN_IF_FAILED(WinRTGetActivationFactory_SxS(activatableClassId, iid, factory));
+        return activatableClass.sxs_component->GetActivationFactory(activatableClassId, iid, factory);
     }
-    return S_OK;
 
+    // Reuse where WinRTResolveActivatableClass() found the class rather than searching the package graph again
+    RETURN_IF_FAILED(WinRTGetActivationFactory_PackageGraph(activatableClassId, iid, factory, &activatableClass.package_graph_class));
+    RETURN_HR_IF(REGDB_E_CLASSNOTREG, *factory == nullptr);
+    return S_OK;
 }
 
 HRESULT WinRTGetActivationFactory_PackageGraph(
     HSTRING activatableClassId,
     REFIID iid,
-    void** factory)
+    void** factory,
+    const MddCore::WinRT::ResolvedClass* resolved_class)
 {
+    if (resolved_class)
+    {
+        RETURN_IF_FAILED(MddCore::WinRT::GetActivationFactory(*resolved_class, activatableClassId, iid, factory));
+        return S_OK;
+    }
     RETURN_IF_FAILED(MddCore::WinRT::GetActivationFactory(activatableClassId, iid, factory));
     return S_OK;
 }
 
-HRESULT WinRTGetActivationFactory_SxS(
-    HSTRING activatableClassId,
-    REFIID iid,
-    void** factory)
+void WinRTEnableFactoryCache_SxS(bool enable) noexcept
 {
-    auto raw_class_name = WindowsGetStringRawBuffer(activatableClassId, nullptr);
-    auto component_iter = g_types.find(raw_class_name);
-    if (component_iter != g_types.end())
+    // New generation (and setting). Components check it before serving or publishing a cached factory.
+    auto state{ g_factoryCacheState.load(std::memory_order_relaxed) };
+    uint64_t new_state{};
+    do
     {
-        return component_iter->second->GetActivationFactory(activatableClassId, iid, factory);
+        new_state = ((state | c_factoryCacheEnabled) + 1) | (enable ? c_factoryCacheEnabled : 0);
+    } while (!g_factoryCacheState.compare_exchange_weak(state, new_state, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    // Turning it off drops what's been cached so far
+    if (!enable)
+    {
+        auto drop_cached_factory = [](component* this_component)
+        {
+            wil::com_ptr<IActivationFactory> cached_factory;
+            {
+                auto lock{ this_component->factory_lock.lock_exclusive() };
+                cached_factory = std::move(this_component->cached_factory);
+            }
+        };
+        for (auto& type : g_types)
+        {
+            drop_cached_factory(type.second.get());
+        }
+        if (g_compiledCatalog)
+        {
+            for (uint32_t index = 0; index < g_compiledCatalog->catalog.ClassCount(); ++index)
+            {
+                auto this_component = g_compiledCatalog->components[index].load(std::memory_order_acquire);
+                if (this_component != nullptr)
+                {
+                    drop_cached_factory(this_component);
+                }
+            }
+        }
+    }
+}
+
+// The user's cache can be written by anything running as the user, at medium integrity,
+// so only processes at that same level read (or write) it. Elevated processes and anything
+// else running above medium always parse their manifests, as do AppContainer processes.
+static bool IsUserCacheTrusted()
+{
+    if (wil::get_token_is_app_container())
+    {
+        return false;
+    }
+
+    TOKEN_ELEVATION elevation{};
+    DWORD size{};
+    if (!GetTokenInformation(GetCurrentProcessToken(), TokenElevation, &elevation, sizeof(elevation), &size) || elevation.TokenIsElevated)
+    {
+        return false;
+    }
+
+    wistd::unique_ptr<TOKEN_MANDATORY_LABEL> label;
+    if (FAILED(wil::get_token_information_nothrow(label, GetCurrentProcessToken())))
+    {
+        return false;
+    }
+    const auto subAuthorityCount{ *GetSidSubAuthorityCount(label->Label.Sid) };
+    return (subAuthorityCount > 0) && (*GetSidSubAuthority(label->Label.Sid, subAuthorityCount - 1) == SECURITY_MANDATORY_MEDIUM_RID);
+}
+
+// Where the exe's compiled catalog is cached for the user (written on first run).
+// Returns false if this process doesn't use one (see IsUserCacheTrusted).
+static bool GetCompiledCatalogPath(PCWSTR exePath, std::filesystem::path& path)
+{
+    if (!IsUserCacheTrusted())
+    {
+        return false;
+    }
+
+    // This runs from DllMain so no asking ApplicationDataManager (see DataStore::GetCachePathForUser)
+    WCHAR localAppData[MAX_PATH]{};
+    const auto length{ GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData, ARRAYSIZE(localAppData)) };
+    if ((length == 0) || (length >= ARRAYSIZE(localAppData)))
+    {
+        return false;
+    }
+
+    // Named for the exe's path (case-insensitive) so each exe gets its own
+    std::wstring key{ exePath };
+    CharLowerBuffW(key.data(), static_cast<DWORD>(key.size()));
+    const auto hash{ UndockedRegFreeWinRT::ActivationCatalog::HashManifest(
+        reinterpret_cast<const uint8_t*>(key.data()), key.size() * sizeof(key[0])) };
+    WCHAR filename[17 + ARRAYSIZE(L".urfwcatalog")]{};
+    FAIL_FAST_IF_FAILED(StringCchPrintfW(filename, ARRAYSIZE(filename), L"%016I64x.urfwcatalog", hash));
+
+    path = localAppData;
+    path /= L"Microsoft";
+    path /= L"WindowsAppRuntime";
+    path /= L"URFW";
+    path /= filename;
+    return true;
+}
+
+// Manifest paths are recorded absolute so a catalog doesn't depend on the current directory
+static std::filesystem::path ResolveManifestPath(const std::filesystem::path& exeDirectory, const std::wstring& path)
+{
+    std::filesystem::path manifestPath{ path };
+    return manifestPath.is_absolute() ? manifestPath : (exeDirectory / manifestPath);
+}
+
+// Hash of a manifest's content as LoadManifestFromPath reads it (see ActivationCatalog::HashManifest)
+static HRESULT HashManifestFromPath(const std::wstring& path, uint64_t& hash)
+{
+    const auto extension{ path.size() < 4 ? std::wstring_view{} : std::wstring_view(path).substr(path.size() - 4) };
+    if ((CompareStringOrdinal(extension.data(), static_cast<int>(extension.size()), L".exe", -1, TRUE) == CSTR_EQUAL) ||
+        (CompareStringOrdinal(extension.data(), static_cast<int>(extension.size()), L".dll", -1, TRUE) == CSTR_EQUAL))
+    {
+        wil::unique_hmodule handle(LoadLibraryExW(path.c_str(), nullptr, LOAD_LIBRARY_AS_DATAFILE_EXCLUSIVE));
+        RETURN_LAST_ERROR_IF(!handle);
+        std::string_view manifest;
+        RETURN_IF_FAILED(GetEmbeddedManifest(handle.get(), manifest));
+        hash = UndockedRegFreeWinRT::ActivationCatalog::HashManifest(reinterpret_cast<const uint8_t*>(manifest.data()), manifest.size());
+        return S_OK;
+    }
+
+    wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+    RETURN_LAST_ERROR_IF(!file);
+    LARGE_INTEGER fileSize{};
+    RETURN_IF_WIN32_BOOL_FALSE(GetFileSizeEx(file.get(), &fileSize));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE), fileSize.QuadPart > c_maxManifestSize);
+    std::vector<uint8_t> manifest(static_cast<size_t>(fileSize.QuadPart));
+    DWORD bytesRead{};
+    RETURN_IF_WIN32_BOOL_FALSE(ReadFile(file.get(), manifest.data(), static_cast<DWORD>(manifest.size()), &bytesRead, nullptr));
+    hash = UndockedRegFreeWinRT::ActivationCatalog::HashManifest(manifest.data(), bytesRead);
+    return S_OK;
+}
+
+static std::unique_ptr<compiled_catalog> OpenCompiledCatalog(const std::filesystem::path& path, const std::filesystem::path& exeDirectory)
+{
+    wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+    if (!file)
+    {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file.get(), &fileSize) || (fileSize.QuadPart == 0) || (fileSize.QuadPart > c_maxCompiledCatalogSize))
+    {
+        return nullptr;
     }
-    return REGDB_E_CLASSNOTREG;
+
+    auto compiledCatalog{ std::make_unique<compiled_catalog>() };
+    compiledCatalog->mapping.reset(CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!compiledCatalog->mapping)
+    {
+        return nullptr;
+    }
+    compiledCatalog->view.reset(static_cast<uint8_t*>(MapViewOfFile(compiledCatalog->mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+    if (!compiledCatalog->view ||
+        !compiledCatalog->catalog.Open(compiledCatalog->view.get(), static_cast<size_t>(fileSize.QuadPart)))
+    {
+        return nullptr;
+    }
+
+    // Stale if any manifest it was compiled from has changed (or is gone)
+    for (uint32_t index = 0; index < compiledCatalog->catalog.SourceCount(); ++index)
+    {
+        const auto source{ compiledCatalog->catalog.GetSource(index) };
+        uint64_t hash{};
+        if (FAILED(HashManifestFromPath(ResolveManifestPath(exeDirectory, source.path).wstring(), hash)) || (hash != source.hash))
+        {
+            return nullptr;
+        }
+    }
+
+    // Matching hashes only say the manifests haven't changed, not that the catalog came from
+    // them, so its modules are only loaded from the exe's directory
+    for (uint32_t index = 0; index < compiledCatalog->catalog.ModuleCount(); ++index)
+    {
+        if (!UndockedRegFreeWinRT::ActivationCatalog::IsConfinedModulePath(compiledCatalog->catalog.GetModule(index)))
+        {
+            return nullptr;
+        }
+    }
+    compiledCatalog->exe_directory = exeDirectory;
+    compiledCatalog->components = std::make_unique<std::atomic<component*>[]>(compiledCatalog->catalog.ClassCount());
+    return compiledCatalog;
+}
+
+HRESULT WinRTLoadCompiledCatalog(PCWSTR exePath) try
+{
+    std::filesystem::path path;
+    if (!GetCompiledCatalogPath(exePath, path))
+    {
+        return S_FALSE;
+    }
+    auto compiledCatalog{ OpenCompiledCatalog(path, std::filesystem::path(exePath).parent_path()) };
+    if (!compiledCatalog)
+    {
+        return S_FALSE;
+    }
+    g_types.clear();
+    g_compiledCatalog = std::move(compiledCatalog);
+    return S_OK;
+}
+CATCH_RETURN();
+
+HRESULT WinRTSaveCompiledCatalog(PCWSTR exePath, const std::vector<std::wstring>& manifestPaths) try
+{
+    std::filesystem::path filename;
+    if (!GetCompiledCatalogPath(exePath, filename))
+    {
+        return S_FALSE;
+    }
+    const auto exeDirectory{ std::filesystem::path(exePath).parent_path() };
+
+    // A catalog's modules are loaded from the exe's directory (see OpenCompiledCatalog), so
+    // manifests naming a module anywhere else (or that only the search path finds) don't get one
+    std::vector<UndockedRegFreeWinRT::ActivationCatalog::ActivatableClass> activatableClasses;
+    activatableClasses.reserve(g_types.size());
+    for (const auto& type : g_types)
+    {
+        if (!UndockedRegFreeWinRT::ActivationCatalog::IsConfinedModulePath(type.second->module_name) ||
+            (GetFileAttributesW((exeDirectory / type.second->module_name).c_str()) == INVALID_FILE_ATTRIBUTES))
+        {
+            return S_FALSE;
+        }
+        activatableClasses.push_back({ type.second->activatable_class, type.second->module_name, static_cast<uint8_t>(type.second->threading_model) });
+    }
+
+    std::vector<UndockedRegFreeWinRT::ActivationCatalog::Source> sources;
+    for (const auto& manifestPath : manifestPaths)
+    {
+        UndockedRegFreeWinRT::ActivationCatalog::Source source{ ResolveManifestPath(exeDirectory, manifestPath).wstring() };
+        RETURN_IF_FAILED(HashManifestFromPath(source.path, source.hash));
+        sources.push_back(std::move(source));
+    }
+    std::vector<uint8_t> data;
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_SXS_DUPLICATE_ACTIVATABLE_CLASS), !UndockedRegFreeWinRT::ActivationCatalog::Compile(sources, activatableClasses, data));
+
+    std::filesystem::create_directories(filename.parent_path());
+
+    // Write to a temporary file and then move it into place so other processes
+    // never see a partially written file (the checksum catches it anyway)
+    auto temporaryFilename{ filename };
+    temporaryFilename += L"." + std::to_wstring(GetCurrentProcessId()) + L"." + std::to_wstring(GetCurrentThreadId()) + L".tmp";
+    {
+        wil::unique_hfile file{ CreateFileW(temporaryFilename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        RETURN_LAST_ERROR_IF(!file);
+        DWORD bytesWritten{};
+        RETURN_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr));
+    }
+    if (!MoveFileExW(temporaryFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        const auto lastError{ GetLastError() };
+        DeleteFileW(temporaryFilename.c_str());
+        RETURN_WIN32(lastError);
+    }
+    return S_OK;
 }
+CATCH_RETURN();
 
 HRESULT WinRTGetMetadataFile(
     const HSTRING name,
@@ -5,8 +5,17 @@
 #include <cor.h>
 #include <xmllite.h>
 
+#include <../DynamicDependency/API/MddWinRT.h>
+
 HRESULT LoadManifestFromPath(std::wstring path);
 
+// Load the exe's compiled catalog instead of its manifests, if there's one that's current.
+// Returns S_FALSE if there isn't.
+HRESULT WinRTLoadCompiledCatalog(PCWSTR exePath);
+
+// Compile what's been loaded from the manifests into a catalog for next time
+HRESULT WinRTSaveCompiledCatalog(PCWSTR exePath, const std::vector<std::wstring>& manifestPaths);
+
 HRESULT LoadFromSxSManifest(PCWSTR path);
 
 HRESULT LoadFromEmbeddedManifest(PCWSTR path);
@@ -21,19 +30,35 @@ HRESULT ParseFileTag(IXmlReader* xmlReader);
 
 HRESULT ParseActivatableClassTag(IXmlReader* xmlReader, PCWSTR fileName);
 
-HRESULT WinRTGetThreadingModel(
+struct component;
+
+// Where an activatableClassId is implemented and its threading model, found with
+// one lookup so activation doesn't have to search again for the factory.
+struct WinRTActivatableClass
+{
+    ABI::Windows::Foundation::ThreadingType threading_model{};
+
+    // The class' component in the SxS manifest, or nullptr if it's in the package graph
+    component* sxs_component{};
+
+    // Where the package graph has the class (if sxs_component is nullptr)
+    MddCore::WinRT::ResolvedClass package_graph_class{};
+};
+
+HRESULT WinRTResolveActivatableClass(
     HSTRING activatableClassId,
-    ABI::Windows::Foundation::ThreadingType* threading_model);
+    WinRTActivatableClass& activatableClass);
 
 HRESULT WinRTGetThreadingModel_PackageGraph(
     HSTRING activatableClassId,
-    ABI::Windows::Foundation::ThreadingType* threading_model);
+    ABI::Windows::Foundation::ThreadingType* threading_model,
+    MddCore::WinRT::ResolvedClass* resolved_class = nullptr);
 
-HRESULT WinRTGetThreadingModel_SxS(
-    HSTRING activatableClassId,
-    ABI::Windows::Foundation::ThreadingType* threading_model);
+component* WinRTFindComponent_SxS(
+    HSTRING activatableClassId);
 
 HRESULT WinRTGetActivationFactory(
+    const WinRTActivatableClass& activatableClass,
     HSTRING activatableClassId,
     REFIID  iid,
     void** factory);
@@ -41,12 +66,10 @@ HRESULT WinRTGetActivationFactory(
 HRESULT WinRTGetActivationFactory_PackageGraph(
     HSTRING activatableClassId,
     REFIID  iid,
-    void** factory);
+    void** factory,
+    const MddCore::WinRT::ResolvedClass* resolved_class = nullptr);
 
-HRESULT WinRTGetActivationFactory_SxS(
-    HSTRING activatableClassId,
-    REFIID  iid,
-    void** factory);
+void WinRTEnableFactoryCache_SxS(bool enable) noexcept;
 
 HRESULT WinRTGetMetadataFile(
     const HSTRING name,
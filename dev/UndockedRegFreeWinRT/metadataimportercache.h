@@ -0,0 +1,256 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(METADATAIMPORTERCACHE_H)
+#define METADATAIMPORTERCACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace UndockedRegFreeWinRT
+{
+/// Metadata importers by file path, most recently used first.
+///
+/// Hits only take a shared lock. Rather than move the entry to the front of the list they stamp
+/// it as used, and eviction sends entries used since they were last placed back to the front for
+/// another pass. That approximates strict LRU order without making readers contend.
+///
+/// The capacity adapts between the initial and maximum capacity. A miss on a file that was
+/// recently evicted means the working set is bigger than the cache so the capacity doubles
+/// (up to the maximum). Set both the same to disable this.
+///
+/// TImporter is a copyable, reference counted handle to an importer e.g. wil::com_ptr_nothrow<IMetaDataImport2>.
+///
+/// @note Methods are thread safe.
+template <typename TImporter>
+class MetaDataImporterCache
+{
+public:
+    static constexpr size_t c_defaultInitialCapacity{ 8 };
+    static constexpr size_t c_defaultMaxCapacity{ 64 };
+
+    struct Statistics
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size;
+        size_t capacity;
+    };
+
+public:
+    explicit MetaDataImporterCache(
+        size_t initialCapacity = c_defaultInitialCapacity,
+        size_t maxCapacity = c_defaultMaxCapacity)
+    {
+        SetCapacity(initialCapacity, maxCapacity);
+    }
+
+    MetaDataImporterCache(const MetaDataImporterCache&) = delete;
+    MetaDataImporterCache& operator=(const MetaDataImporterCache&) = delete;
+
+    ~MetaDataImporterCache() = default;
+
+    void SetCapacity(size_t initialCapacity, size_t maxCapacity)
+    {
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        m_capacity = std::max<size_t>(initialCapacity, 1);
+        m_maxCapacity = std::max(maxCapacity, m_capacity);
+        TrimToCapacity();
+    }
+
+    /// Return the importer for the file, opening it if it's not cached.
+    ///
+    /// open(path, importer) returns a negative status (e.g. a failure HRESULT) if the file
+    /// can't be opened. That's returned to the caller and nothing's cached. The file is opened
+    /// without holding the lock so a slow open doesn't block hits on other files.
+    template <typename TOpen>
+    int32_t GetOrOpen(
+        const std::wstring& path,
+        TOpen&& open,
+        TImporter& importer)
+    {
+        {
+            auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+            auto iterator{ m_entries.find(path) };
+            if (iterator != m_entries.end())
+            {
+                iterator->second.lastUsed.store(++m_tick, std::memory_order_relaxed);
+                importer = iterator->second.importer;
+                ++m_hits;
+                return 0;
+            }
+        }
+
+        ++m_misses;
+        TImporter opened{};
+        const int32_t status{ static_cast<int32_t>(open(path, opened)) };
+        if (status < 0)
+        {
+            return status;
+        }
+
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        auto iterator{ m_entries.find(path) };
+        if (iterator != m_entries.end())
+        {
+            // Someone else opened it while we were. Use theirs and let ours go
+            importer = iterator->second.importer;
+            return 0;
+        }
+
+        if (ForgetEvicted(path))
+        {
+            m_capacity = std::min(m_capacity * 2, m_maxCapacity);
+        }
+
+        auto& [key, entry]{ *m_entries.try_emplace(path).first };
+        entry.key = &key;
+        entry.importer = opened;
+        entry.placed = ++m_tick;
+        entry.lastUsed.store(entry.placed, std::memory_order_relaxed);
+        PushFront(&entry);
+        TrimToCapacity();
+
+        importer = std::move(opened);
+        return 0;
+    }
+
+    void Clear()
+    {
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        m_entries.clear();
+        m_head = nullptr;
+        m_tail = nullptr;
+        m_evicted.clear();
+        m_evictedOrder.clear();
+    }
+
+    Statistics GetStatistics()
+    {
+        auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+        return Statistics{ m_hits.load(), m_misses.load(), m_evictions.load(), m_entries.size(), m_capacity };
+    }
+
+private:
+    struct Entry
+    {
+        const std::wstring* key{};
+        TImporter importer{};
+
+        // Tick when the entry was last put at the front of the list, and when it was last used
+        uint64_t placed{};
+        std::atomic<uint64_t> lastUsed{};
+
+        Entry* previous{};
+        Entry* next{};
+    };
+
+    void PushFront(Entry* entry)
+    {
+        // NOTE: Caller must hold m_lock exclusively
+
+        entry->previous = nullptr;
+        entry->next = m_head;
+        if (m_head)
+        {
+            m_head->previous = entry;
+        }
+        m_head = entry;
+        if (!m_tail)
+        {
+            m_tail = entry;
+        }
+    }
+
+    void Unlink(Entry* entry)
+    {
+        // NOTE: Caller must hold m_lock exclusively
+
+        (entry->previous ? entry->previous->next : m_head) = entry->next;
+        (entry->next ? entry->next->previous : m_tail) = entry->previous;
+        entry->previous = nullptr;
+        entry->next = nullptr;
+    }
+
+    void TrimToCapacity()
+    {
+        // NOTE: Caller must hold m_lock exclusively
+
+        // Every entry gets at most one more pass so this terminates even if they've all been used
+        size_t passes{};
+        while (m_entries.size() > m_capacity)
+        {
+            Entry* entry{ m_tail };
+            const auto lastUsed{ entry->lastUsed.load(std::memory_order_relaxed) };
+            if ((lastUsed != entry->placed) && (passes < m_entries.size()))
+            {
+                Unlink(entry);
+                entry->placed = lastUsed;
+                PushFront(entry);
+                ++passes;
+                continue;
+            }
+
+            Unlink(entry);
+            RememberEvicted(*entry->key);
+            m_entries.erase(*entry->key);
+            ++m_evictions;
+        }
+    }
+
+    void RememberEvicted(const std::wstring& path)
+    {
+        // NOTE: Caller must hold m_lock exclusively
+
+        // Only as many as the cache could grow to hold; anything older wouldn't fit anyway
+        if (m_evicted.insert(path).second)
+        {
+            m_evictedOrder.push_back(path);
+        }
+        while (m_evictedOrder.size() > m_maxCapacity)
+        {
+            m_evicted.erase(m_evictedOrder.front());
+            m_evictedOrder.pop_front();
+        }
+    }
+
+    bool ForgetEvicted(const std::wstring& path)
+    {
+        // NOTE: Caller must hold m_lock exclusively
+
+        if (m_evicted.erase(path) == 0)
+        {
+            return false;
+        }
+        m_evictedOrder.erase(std::find(m_evictedOrder.begin(), m_evictedOrder.end(), path));
+        return true;
+    }
+
+private:
+    std::shared_mutex m_lock;
+    std::unordered_map<std::wstring, Entry> m_entries;
+    Entry* m_head{};
+    Entry* m_tail{};
+    size_t m_capacity{};
+    size_t m_maxCapacity{};
+
+    // Recently evicted files, oldest first
+    std::unordered_set<std::wstring> m_evicted;
+    std::deque<std::wstring> m_evictedOrder;
+
+    std::atomic<uint64_t> m_tick{};
+    std::atomic<uint64_t> m_hits{};
+    std::atomic<uint64_t> m_misses{};
+    std::atomic<uint64_t> m_evictions{};
+};
+}
+
+#endif // METADATAIMPORTERCACHE_H
@@ -9,8 +9,6 @@
 #include <wrl.h>
 
 #define METADATA_FILE_EXTENSION L"winmd"
-#define METADATA_FILE_PATH_FORMAT L"%s%s."  METADATA_FILE_EXTENSION
-#define METADATA_FILE_SEARCH_FORMAT L"%s%s*."  METADATA_FILE_EXTENSION
 
 namespace UndockedRegFreeWinRT
 {
@@ -205,171 +203,205 @@ namespace UndockedRegFreeWinRT
         return hr;
     }
 
-    HRESULT FindTypeInDirectory(
-        _In_ IMetaDataDispenserEx* pMetaDataDispenser,
-        _In_ PCWSTR pszFullName,
-        _In_ PCWSTR pszDirectoryPath,
-        _Out_opt_ HSTRING* phstrMetaDataFilePath,
-        _COM_Outptr_opt_result_maybenull_ IMetaDataImport2** ppMetaDataImport,
-        _Out_opt_ mdTypeDef* pmdTypeDef)
+    // The *.winmd files in a directory on disk, for WinMDTypeIndex
+    class WinMDDirectory : public IWinMDDirectory
     {
-        HRESULT hr;
-
-        wchar_t szCandidateFilePath[MAX_PATH + 1] = { 0 };
-        wchar_t szCandidateFileName[MAX_PATH + 1] = { 0 };
-        PWSTR pszLastDot;
+    public:
+        // The path ends with a backslash
+        explicit WinMDDirectory(std::wstring path) :
+            m_path(std::move(path))
+        {
+        }
 
-        hr = StringCchCopy(szCandidateFileName, ARRAYSIZE(szCandidateFileName), pszFullName);
+        uint64_t GetLastWriteTime() override
+        {
+            WIN32_FILE_ATTRIBUTE_DATA data{};
+            if (!GetFileAttributesExW(m_path.c_str(), GetFileExInfoStandard, &data))
+            {
+                return 0;
+            }
+            return ToUInt64(data.ftLastWriteTime);
+        }
 
-        if (SUCCEEDED(hr))
+        std::vector<File> GetFiles() override
         {
-            // To resolve type SomeNamespace.B.C, first check if SomeNamespace.B.C is a type or
-            // a namespace in the metadata files in the directory in this order:
-            // 1. SomeNamespace.B.C.WinMD
-            // 2. SomeNamespace.B.WinMD
-            // 3. SomeNamespace.WinMD
+            std::vector<File> files;
+            WIN32_FIND_DATAW findData{};
+            const auto searchPath{ m_path + L"*." METADATA_FILE_EXTENSION };
+            wil::unique_hfind findHandle{ FindFirstFileExW(searchPath.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH) };
+            if (!findHandle)
+            {
+                return files;
+            }
             do
             {
-                pszLastDot = nullptr;
-
-                hr = StringCchPrintfEx(
-                    szCandidateFilePath,
-                    ARRAYSIZE(szCandidateFilePath),
-                    nullptr,
-                    nullptr,
-                    0,
-                    METADATA_FILE_PATH_FORMAT,
-                    pszDirectoryPath,
-                    szCandidateFileName);
-
-                if (SUCCEEDED(hr))
+                if (WI_IsFlagClear(findData.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY))
                 {
-                    hr = FindTypeInMetaDataFile(
-                        pMetaDataDispenser,
-                        pszFullName,
-                        szCandidateFilePath,
-                        TRO_RESOLVE_TYPE_AND_NAMESPACE,
-                        ppMetaDataImport,
-                        pmdTypeDef);
-
-                    if (SUCCEEDED(hr))
-                    {
-                        if (phstrMetaDataFilePath != nullptr)
-                        {
-                            hr = WindowsCreateString(
-                                szCandidateFilePath,
-                                static_cast<UINT32>(wcslen(szCandidateFilePath)),
-                                phstrMetaDataFilePath);
-                        }
-                        break;
-                    }
+                    const uint64_t size{ (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow };
+                    files.push_back(File{ findData.cFileName, ToUInt64(findData.ftLastWriteTime), size });
                 }
+            } while (FindNextFileW(findHandle.get(), &findData));
+            return files;
+        }
 
-                hr = RO_E_METADATA_NAME_NOT_FOUND;
-                pszLastDot = wcsrchr(szCandidateFileName, '.');
+        bool ReadTypeDefs(const std::wstring& fileName, std::vector<WinMD::TypeDef>& typeDefs) override
+        {
+            const auto path{ m_path + fileName };
+            wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+            if (!file)
+            {
+                return false;
+            }
+            LARGE_INTEGER size{};
+            if (!GetFileSizeEx(file.get(), &size) || (size.QuadPart == 0) || (size.HighPart != 0))
+            {
+                return false;
+            }
+            wil::unique_handle mapping{ CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr) };
+            if (!mapping)
+            {
+                return false;
+            }
+            wil::unique_mapview_ptr<uint8_t> view{ static_cast<uint8_t*>(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0)) };
+            if (!view)
+            {
+                return false;
+            }
+            return WinMD::ReadTypeDefs(view.get(), static_cast<size_t>(size.QuadPart), typeDefs);
+        }
 
-                if (pszLastDot != nullptr)
-                {
-                    *pszLastDot = '\0';
-                }
-            } while (pszLastDot != nullptr);
+    private:
+        static uint64_t ToUInt64(const FILETIME& fileTime)
+        {
+            return (static_cast<uint64_t>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+        }
 
-            // If name was not found when searching in the "upward direction", then
-            // the name might be a namespace name in a down-level file.
-            if (hr == RO_E_METADATA_NAME_NOT_FOUND)
-            {
-                wchar_t szFilePathSearchTemplate[MAX_PATH + 1] = { 0 };
-
-                hr = StringCchPrintfEx(
-                    szFilePathSearchTemplate,
-                    ARRAYSIZE(szFilePathSearchTemplate),
-                    nullptr,
-                    nullptr,
-                    0,
-                    METADATA_FILE_SEARCH_FORMAT,
-                    pszDirectoryPath,
-                    pszFullName);
+    private:
+        std::wstring m_path;
+    };
 
-                if (SUCCEEDED(hr))
-                {
-                    WIN32_FIND_DATA fd;
-                    HANDLE hFindFile;
+    // Indexes are created on first use and live for the life of the process
+    static WinMDTypeIndex& GetWinMDTypeIndex(PCWSTR pszDirectoryPath)
+    {
+        static wil::srwlock s_lock;
+        static auto s_typeIndexes{ new std::unordered_map<std::wstring, std::unique_ptr<WinMDTypeIndex>>() };
 
-                    // Search in all files in the directory whose name begin with the input string.
-                    hFindFile = FindFirstFile(szFilePathSearchTemplate, &fd);
+        std::wstring directory{ pszDirectoryPath };
+        if (directory.empty() || (directory.back() != L'\\'))
+        {
+            directory.push_back(L'\\');
+        }
+        {
+            auto lock{ s_lock.lock_shared() };
+            auto iterator{ s_typeIndexes->find(directory) };
+            if (iterator != s_typeIndexes->end())
+            {
+                return *iterator->second;
+            }
+        }
 
-                    if (hFindFile != INVALID_HANDLE_VALUE)
-                    {
-                        PWSTR pszFilePathPart;
-                        size_t cchRemaining;
+        auto lock{ s_lock.lock_exclusive() };
+        auto& typeIndex{ (*s_typeIndexes)[directory] };
+        if (!typeIndex)
+        {
+            typeIndex = std::make_unique<WinMDTypeIndex>(std::make_unique<WinMDDirectory>(directory));
+        }
+        return *typeIndex;
+    }
 
-                        do
-                        {
-                            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-                            {
-                                continue;
-                            }
+    // Open the importer for a type the index found. The index read the file itself, so
+    // make sure the importer agrees before handing out the token.
+    static HRESULT OpenTypeInMetaDataFile(
+        _In_ IMetaDataDispenserEx* pMetaDataDispenser,
+        _In_ PCWSTR pszFullName,
+        _In_ PCWSTR pszFilePath,
+        _In_ mdTypeDef typeDef,
+        _COM_Outptr_opt_result_maybenull_ IMetaDataImport2** ppMetaDataImport,
+        _Out_opt_ mdTypeDef* pmdTypeDef)
+    {
+        MetaDataImportersLRUCache* pMetaDataImporterCache = MetaDataImportersLRUCache::GetMetaDataImportersLRUCacheInstance();
+        if (pMetaDataImporterCache == nullptr)
+        {
+            return E_OUTOFMEMORY;
+        }
+        Microsoft::WRL::ComPtr<IMetaDataImport2> spMetaDataImport;
+        HRESULT hr = pMetaDataImporterCache->GetMetaDataImporter(pMetaDataDispenser, pszFilePath, &spMetaDataImport);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
 
-                            pszFilePathPart = szCandidateFilePath;
-                            cchRemaining = ARRAYSIZE(szCandidateFilePath);
-                            hr = StringCchCopyEx(
-                                pszFilePathPart,
-                                cchRemaining,
-                                pszDirectoryPath,
-                                &pszFilePathPart,
-                                &cchRemaining,
-                                0);
-
-                            if (SUCCEEDED(hr))
-                            {
-                                hr = StringCchCopyEx(
-                                    pszFilePathPart,
-                                    cchRemaining,
-                                    fd.cFileName,
-                                    &pszFilePathPart,
-                                    &cchRemaining,
-                                    0);
-                            }
+        wchar_t pszRetrievedName[g_uiMaxTypeName];
+        DWORD dwTypeDefProps;
+        hr = spMetaDataImport->GetTypeDefProps(typeDef, pszRetrievedName, ARRAYSIZE(pszRetrievedName), nullptr, &dwTypeDefProps, nullptr);
+        if (FAILED(hr) || !IsTdWindowsRuntime(dwTypeDefProps) || (wcscmp(pszRetrievedName, pszFullName) != 0))
+        {
+            return FindTypeInMetaDataFile(pMetaDataDispenser, pszFullName, pszFilePath, TRO_RESOLVE_TYPE, ppMetaDataImport, pmdTypeDef);
+        }
 
-                            if (SUCCEEDED(hr))
-                            {
-                                hr = FindTypeInMetaDataFile(
-                                    pMetaDataDispenser,
-                                    pszFullName,
-                                    szCandidateFilePath,
-                                    TRO_RESOLVE_NAMESPACE,
-                                    ppMetaDataImport,
-                                    pmdTypeDef);
-
-                                if (hr == S_OK)
-                                {
-                                    hr = E_UNEXPECTED;
-                                    break;
-                                }
+        if (pmdTypeDef != nullptr)
+        {
+            *pmdTypeDef = typeDef;
+        }
+        if (ppMetaDataImport != nullptr)
+        {
+            *ppMetaDataImport = spMetaDataImport.Detach();
+        }
+        return S_OK;
+    }
 
-                                if (hr == RO_E_METADATA_NAME_IS_NAMESPACE)
-                                {
-                                    break;
-                                }
-                            }
-                        } while (FindNextFile(hFindFile, &fd));
+    HRESULT FindTypeInDirectory(
+        _In_ IMetaDataDispenserEx* pMetaDataDispenser,
+        _In_ PCWSTR pszFullName,
+        _In_ PCWSTR pszDirectoryPath,
+        _Out_opt_ HSTRING* phstrMetaDataFilePath,
+        _COM_Outptr_opt_result_maybenull_ IMetaDataImport2** ppMetaDataImport,
+        _Out_opt_ mdTypeDef* pmdTypeDef) try
+    {
+        // To resolve type SomeNamespace.B.C, check if SomeNamespace.B.C is a type in the metadata
+        // files in the directory in this order:
+        // 1. SomeNamespace.B.C.WinMD
+        // 2. SomeNamespace.B.WinMD
+        // 3. SomeNamespace.WinMD
+        // or else if it's a namespace in any SomeNamespace.B.C*.WinMD. The index knows without
+        // opening (or looking for) any of them.
+        const auto location{ GetWinMDTypeIndex(pszDirectoryPath).Find(pszFullName) };
+        if (location.kind == WinMDTypeLocation::Kind::Namespace)
+        {
+            return RO_E_METADATA_NAME_IS_NAMESPACE;
+        }
+        else if (location.kind == WinMDTypeLocation::Kind::NotFound)
+        {
+            return RO_E_METADATA_NAME_NOT_FOUND;
+        }
 
-                        FindClose(hFindFile);
-                    }
-                    else
-                    {
-                        hr = RO_E_METADATA_NAME_NOT_FOUND;
-                    }
-                }
+        const std::wstring filePath{ std::wstring(pszDirectoryPath) + location.fileName };
+        if ((ppMetaDataImport != nullptr) || (pmdTypeDef != nullptr))
+        {
+            const HRESULT hr = OpenTypeInMetaDataFile(pMetaDataDispenser, pszFullName, filePath.c_str(), location.token, ppMetaDataImport, pmdTypeDef);
+            if (FAILED(hr))
+            {
+                return (hr == E_OUTOFMEMORY) ? hr : RO_E_METADATA_NAME_NOT_FOUND;
             }
         }
-
-        if (hr == STRSAFE_E_INSUFFICIENT_BUFFER)
+        if (phstrMetaDataFilePath != nullptr)
         {
-            hr = RO_E_METADATA_NAME_NOT_FOUND;
+            RETURN_IF_FAILED(WindowsCreateString(filePath.c_str(), static_cast<UINT32>(filePath.size()), phstrMetaDataFilePath));
         }
+        return S_OK;
+    }
+    CATCH_RETURN();
 
-        return hr;
+    bool MayResolveNamespaceInDirectory(
+        _In_ PCWSTR pszNamespace,
+        _In_ PCWSTR pszDirectoryPath) noexcept try
+    {
+        return GetWinMDTypeIndex(pszDirectoryPath).MayResolveNamespace(pszNamespace);
+    }
+    catch (...)
+    {
+        LOG_CAUGHT_EXCEPTION();
+        return true;
     }
 
     HRESULT FindTypeInDirectoryWithNormalization(
@@ -507,168 +539,35 @@ namespace UndockedRegFreeWinRT
     HRESULT MetaDataImportersLRUCache::GetMetaDataImporter(
         _In_ IMetaDataDispenserEx* pMetaDataDispenser,
         _In_ PCWSTR pszCandidateFilePath,
-        _Outptr_opt_ IMetaDataImport2** ppMetaDataImporter)
+        _Outptr_opt_ IMetaDataImport2** ppMetaDataImporter) try
     {
         if (ppMetaDataImporter == nullptr)
         {
             return ERROR_BAD_ARGUMENTS;
         }
 
-        HRESULT hr = S_OK;
         *ppMetaDataImporter = nullptr;
 
-        EnterCriticalSection(&_csCacheLock);
-
-        if (IsFilePathCached(pszCandidateFilePath))
-        {
-            // Get metadata importer from cache.
-            *ppMetaDataImporter = _metadataImportersMap[pszCandidateFilePath];
-            IMetaDataImport2* value = *ppMetaDataImporter;
-            if (value != nullptr)
-            {
-                value->AddRef();
-            }
-        }
-        else
-        {
-            // Importer was not found in cache.
-            hr = GetNewMetaDataImporter(
-                pMetaDataDispenser,
-                pszCandidateFilePath,
-                ppMetaDataImporter);
-        }
-
-        LeaveCriticalSection(&_csCacheLock);
-
-        return hr;
-    }
-
-    HRESULT MetaDataImportersLRUCache::GetNewMetaDataImporter(
-        _In_ IMetaDataDispenserEx* pMetaDataDispenser,
-        _In_ PCWSTR pszCandidateFilePath,
-        _Outptr_opt_ IMetaDataImport2** ppMetaDataImporter)
-    {
-        if (ppMetaDataImporter == nullptr)
-        {
-            return ERROR_BAD_ARGUMENTS;
-        }
-
-        HRESULT hr;
-
-        hr = pMetaDataDispenser->OpenScope(
+        // Not finding a candidate file is routine while probing so failures aren't logged
+        wil::com_ptr_nothrow<IMetaDataImport2> spMetaDataImporter;
+        HRESULT hr = _cache.GetOrOpen(
             pszCandidateFilePath,
-            ofReadOnly,
-            IID_IMetaDataImport2,
-            reinterpret_cast<IUnknown**>(ppMetaDataImporter));
-
-        if (SUCCEEDED(hr))
-        {
-           _metadataImportersMap.emplace(
-                pszCandidateFilePath,
-                *ppMetaDataImporter);
-           IMetaDataImport2* value = *ppMetaDataImporter;
-           if (value != nullptr)
-           {
-               value->AddRef();
-           }
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = AddNewFilePathToList(pszCandidateFilePath);
-        }
-
-        return hr;
-    }
-
-    HRESULT MetaDataImportersLRUCache::AddNewFilePathToList(PCWSTR pszFilePath)
-    {
-        HRESULT hr = RemoveLeastRecentlyUsedItemIfListIsFull();
-
-        if (SUCCEEDED(hr))
-        {
-            // Make room for new element.
-            for (int i = g_dwMetaDataImportersLRUCacheSize - 2; i >= 0; i--)
+            [&](const std::wstring& filePath, wil::com_ptr_nothrow<IMetaDataImport2>& spOpened)
             {
-                _arFilePaths[i + 1] = _arFilePaths[i];
-            }
-
-            _arFilePaths[0] = AllocateAndCopyString(pszFilePath);
-
-            if (_arFilePaths[0] == nullptr)
-            {
-                hr = E_OUTOFMEMORY;
-            }
-        }
-
-        return hr;
-    }
-
-    bool MetaDataImportersLRUCache::IsFilePathCached(PCWSTR pszFilePath)
-    {
-        int filePathIndex = GetFilePathIndex(pszFilePath);
-
-        if (filePathIndex != -1)
-        {
-            MoveElementToFrontOfList(filePathIndex);
-            return true;
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    int MetaDataImportersLRUCache::GetFilePathIndex(PCWSTR pszFilePath)
-    {
-        int filePathIndex = -1;
-
-        for (int i = 0; (i < g_dwMetaDataImportersLRUCacheSize) && (_arFilePaths[i] != nullptr); i++)
+                return pMetaDataDispenser->OpenScope(
+                    filePath.c_str(),
+                    ofReadOnly,
+                    IID_IMetaDataImport2,
+                    reinterpret_cast<IUnknown**>(spOpened.put()));
+            },
+            spMetaDataImporter);
+        if (FAILED(hr))
         {
-            if (wcscmp(pszFilePath, _arFilePaths[i]) == 0)
-            {
-                filePathIndex = i;
-                break;
-            }
-        }
-
-        return filePathIndex;
-    }
-
-    void MetaDataImportersLRUCache::MoveElementToFrontOfList(int elementIndex)
-    {
-        PWSTR pszFoundFilePath = _arFilePaths[elementIndex];
-
-        for (int i = elementIndex - 1; i >= 0; i--)
-        {
-            _arFilePaths[i + 1] = _arFilePaths[i];
-        }
-
-        _arFilePaths[0] = pszFoundFilePath;
-    }
-
-    HRESULT MetaDataImportersLRUCache::RemoveLeastRecentlyUsedItemIfListIsFull()
-    {
-        HRESULT hr = S_OK;
-        PWSTR pszLastFilePathInList = _arFilePaths[g_dwMetaDataImportersLRUCacheSize - 1];
-
-        if (pszLastFilePathInList != nullptr)
-        {
-            IMetaDataImport2* value = _metadataImportersMap[pszLastFilePathInList];
-            if (value != nullptr)
-            {
-                value->Release();
-                value = nullptr;
-            }
-            if (!_metadataImportersMap.erase(pszLastFilePathInList))
-            {
-                hr = E_UNEXPECTED;
-            }
-
-            delete[] pszLastFilePathInList;
-            _arFilePaths[g_dwMetaDataImportersLRUCacheSize - 1] = nullptr;
+            return hr;
         }
 
-        return hr;
+        *ppMetaDataImporter = spMetaDataImporter.detach();
+        return S_OK;
     }
+    CATCH_RETURN();
 }
@@ -5,6 +5,9 @@
 
 #include <RoMetadataApi.h>
 
+#include "metadataimportercache.h"
+#include "winmdtypeindex.h"
+
 namespace UndockedRegFreeWinRT
 {
     typedef enum
@@ -34,6 +37,11 @@ namespace UndockedRegFreeWinRT
         _COM_Outptr_opt_result_maybenull_ IMetaDataImport2** ppMetaDataImport,
         _Out_opt_ mdTypeDef* pmdTypeDef);
 
+    // False if no .winmd in the directory could contribute to RoResolveNamespace(pszNamespace).
+    bool MayResolveNamespaceInDirectory(
+        _In_ PCWSTR pszNamespace,
+        _In_ PCWSTR pszDirectoryPath) noexcept;
+
     HRESULT FindTypeInDirectoryWithNormalization(
         _In_ IMetaDataDispenserEx* pMetaDataDispenser,
         _In_ PCWSTR pszFullName,
@@ -49,28 +57,9 @@ namespace UndockedRegFreeWinRT
         _COM_Outptr_opt_result_maybenull_ IMetaDataImport2** ppMetaDataImport,
         _Out_opt_ mdTypeDef* pmdTypeDef);
 
-    inline PWSTR AllocateAndCopyString(_In_ PCWSTR pszKey)
-    {
-        size_t length = wcslen(pszKey);
-        PWSTR pszKeyCopy = nullptr;
-
-        if (length <= MAX_PATH)
-        {
-            pszKeyCopy = new WCHAR[length + 1];
-            if (pszKeyCopy != nullptr)
-            {
-                SUCCEEDED(StringCchCopyW(pszKeyCopy, length + 1, pszKey));
-            }
-        }
-
-        return pszKeyCopy;
-    }
-
     //
     // Metada importers LRU cache. Singleton.
     //
-    const DWORD g_dwMetaDataImportersLRUCacheSize = 5;
-
     class MetaDataImportersLRUCache
     {
     public:
@@ -81,48 +70,23 @@ namespace UndockedRegFreeWinRT
             _In_ PCWSTR pszCandidateFilePath,
             _Outptr_opt_ IMetaDataImport2** ppMetaDataImporter);
 
-    private:
-        MetaDataImportersLRUCache()
+        MetaDataImporterCache<wil::com_ptr_nothrow<IMetaDataImport2>>::Statistics GetStatistics()
         {
-            InitializeCriticalSection(&_csCacheLock);
-            ZeroMemory(_arFilePaths, sizeof(_arFilePaths));
+            return _cache.GetStatistics();
         }
 
-        ~MetaDataImportersLRUCache()
-        {
-            _metadataImportersMap.clear();
-            for (int i = 0; i < g_dwMetaDataImportersLRUCacheSize; i++)
-            {
-                if (_arFilePaths[i] != nullptr)
-                {
-                    delete[] _arFilePaths[i];
-                    _arFilePaths[i] = nullptr;
-                }
-            }
-
-            DeleteCriticalSection(&_csCacheLock);
-        }
+    private:
+        MetaDataImportersLRUCache() = default;
+
+        ~MetaDataImportersLRUCache() = default;
 
         static BOOL CALLBACK ConstructLRUCacheIfNecessary(
             PINIT_ONCE /*initOnce*/,
             PVOID /*parameter*/,
             PVOID* /*context*/);
 
-        HRESULT GetNewMetaDataImporter(
-            _In_ IMetaDataDispenserEx* pMetaDataDispenser,
-            _In_ PCWSTR pszCandidateFilePath,
-            _Outptr_opt_ IMetaDataImport2** ppMetaDataImporter);
-
-        bool IsFilePathCached(PCWSTR pszFilePath);
-        int GetFilePathIndex(PCWSTR pszFilePath);
-        void MoveElementToFrontOfList(int elementIndex);
-        HRESULT AddNewFilePathToList(PCWSTR pszFilePath);
-        HRESULT RemoveLeastRecentlyUsedItemIfListIsFull();
-
         static INIT_ONCE s_initOnce;
         static MetaDataImportersLRUCache* s_pMetaDataImportersLRUCacheInstance;
-        std::unordered_map<std::wstring, IMetaDataImport2*> _metadataImportersMap;
-        PWSTR _arFilePaths[g_dwMetaDataImportersLRUCacheSize];
-        CRITICAL_SECTION _csCacheLock;
+        MetaDataImporterCache<wil::com_ptr_nothrow<IMetaDataImport2>> _cache;
     };
 }
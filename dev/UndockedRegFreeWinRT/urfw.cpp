@@ -9,6 +9,9 @@
 #include <activation.h>
 #include <VersionHelpers.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "urfw.h"
 
 #include "catalog.h"
@@ -88,11 +91,19 @@ HRESULT EnsureMTAInitialized()
 {
     TP_CALLBACK_ENVIRON callBackEnviron;
     InitializeThreadpoolEnvironment(&callBackEnviron);
+    auto destroyCallBackEnviron = wil::scope_exit([&]
+    {
+        DestroyThreadpoolEnvironment(&callBackEnviron);
+    });
     PTP_POOL pool = CreateThreadpool(nullptr);
     if (pool == nullptr)
     {
         return HRESULT_FROM_WIN32(GetLastError());
     }
+    auto closePool = wil::scope_exit([&]
+    {
+        CloseThreadpool(pool);
+    });
     SetThreadpoolThreadMaximum(pool, 1);
     if (!SetThreadpoolThreadMinimum(pool, 1))
     {
@@ -103,6 +114,12 @@ HRESULT EnsureMTAInitialized()
     {
         return HRESULT_FROM_WIN32(GetLastError());
     }
+    auto closeCleanupGroup = wil::scope_exit([&]
+    {
+        // Waits for the work to finish and releases it
+        CloseThreadpoolCleanupGroupMembers(cleanupgroup, FALSE, nullptr);
+        CloseThreadpoolCleanupGroup(cleanupgroup);
+    });
     SetThreadpoolCallbackPool(&callBackEnviron, pool);
     SetThreadpoolCallbackCleanupGroup(&callBackEnviron,
         cleanupgroup,
@@ -116,11 +133,131 @@ HRESULT EnsureMTAInitialized()
         return HRESULT_FROM_WIN32(GetLastError());
     }
     SubmitThreadpoolWork(ensureMTAInitializedWork);
-    CloseThreadpoolCleanupGroupMembers(cleanupgroup, FALSE, nullptr);
     return S_OK;
 }
 
-HRESULT GetActivationLocation(HSTRING activatableClassId, ActivationLocation &activationLocation)
+/*
+Cross apartment activations of MTA classes run in the MTA's default context. The MTA
+is initialized and kept alive the first time one is needed and then for the life of
+the process, so later activations only pay for the context transition and marshaling.
+The MTA usage and the default context are intentionally never released; there's no safe
+place to do that as UrfwShutdown (and static destruction) runs under the loader lock.
+*/
+class MTAActivator
+{
+public:
+    struct Activation
+    {
+        const WinRTActivatableClass* activatableClass;
+        HSTRING activatableClassId;
+
+        // Activate an instance, or only get the class' activation factory
+        bool factoryOnly;
+
+        // Output: the activated object (or factory) marshaled back to the caller's apartment
+        IStream* stream;
+    };
+
+    // Run all the activations in the MTA in a single context transition.
+    // On failure no activations are returned and none are left marshaled.
+    static HRESULT Activate(Activation* activations, size_t count)
+    {
+        wil::com_ptr<IContextCallback> defaultContext;
+        RETURN_IF_FAILED(GetDefaultContext(defaultContext));
+
+        struct Batch
+        {
+            Activation* activations;
+            size_t count;
+        };
+        Batch batch{ activations, count };
+        ComCallData data{};
+        data.pUserDefined = &batch;
+        const HRESULT hr{ defaultContext->ContextCallback(
+            [](_In_ ComCallData* pComCallData) -> HRESULT
+            {
+                Batch* batch = reinterpret_cast<Batch*>(pComCallData->pUserDefined);
+                for (size_t index = 0; index < batch->count; ++index)
+                {
+                    Activation& activation = batch->activations[index];
+                    Microsoft::WRL::ComPtr<IActivationFactory> pFactory;
+                    RETURN_IF_FAILED(WinRTGetActivationFactory(*activation.activatableClass, activation.activatableClassId, __uuidof(IActivationFactory), (void**)&pFactory));
+                    if (activation.factoryOnly)
+                    {
+                        RETURN_IF_FAILED(CoMarshalInterThreadInterfaceInStream(IID_IActivationFactory, pFactory.Get(), &activation.stream));
+                    }
+                    else
+                    {
+                        Microsoft::WRL::ComPtr<IInspectable> instance;
+                        RETURN_IF_FAILED(pFactory->ActivateInstance(&instance));
+                        RETURN_IF_FAILED(CoMarshalInterThreadInterfaceInStream(IID_IInspectable, instance.Get(), &activation.stream));
+                    }
+                }
+                return S_OK;
+            },
+            &data, IID_ICallbackWithNoReentrancyToApplicationSTA, 5, nullptr) }; // 5 is meaningless.
+        if (FAILED(hr))
+        {
+            ReleaseStreams(activations, count);
+            RETURN_HR(hr);
+        }
+        return S_OK;
+    }
+
+    // Release the marshaled objects of activations that won't be unmarshaled
+    static void ReleaseStreams(Activation* activations, size_t count)
+    {
+        for (size_t index = 0; index < count; ++index)
+        {
+            if (activations[index].stream)
+            {
+                LOG_IF_FAILED(CoReleaseMarshalData(activations[index].stream));
+                activations[index].stream->Release();
+                activations[index].stream = nullptr;
+            }
+        }
+    }
+
+private:
+    static HRESULT GetDefaultContext(wil::com_ptr<IContextCallback>& defaultContext)
+    {
+        {
+            auto lock{ s_lock.lock_shared() };
+            if (s_defaultContext)
+            {
+                defaultContext = s_defaultContext;
+                return S_OK;
+            }
+        }
+
+        auto lock{ s_lock.lock_exclusive() };
+        if (!s_defaultContext)
+        {
+            if (!s_mtaUsageCookie)
+            {
+                RETURN_IF_FAILED(CoIncrementMTAUsage(&s_mtaUsageCookie));
+            }
+            RETURN_IF_FAILED(EnsureMTAInitialized());
+
+            // Context objects are agile so this one can be shared by all callers.
+            // Deliberately leaked (see above) so it's a raw pointer, not a com_ptr
+            RETURN_IF_FAILED(CoGetDefaultContext(APTTYPE_MTA, IID_PPV_ARGS(&s_defaultContext)));
+        }
+        defaultContext = s_defaultContext;
+        return S_OK;
+    }
+
+private:
+    static wil::srwlock s_lock;
+    static CO_MTA_USAGE_COOKIE s_mtaUsageCookie;
+    static IContextCallback* s_defaultContext;
+};
+
+wil::srwlock MTAActivator::s_lock;
+CO_MTA_USAGE_COOKIE MTAActivator::s_mtaUsageCookie{};
+IContextCallback* MTAActivator::s_defaultContext{};
+
+HRESULT GetActivationLocation(HSTRING activatableClassId, WinRTActivatableClass& activatableClass, ActivationLocation &activationLocation)
 {
     // We don't override inbox (Windows.*) runtimeclasses
     UINT32 activatableClassIdAsStringLength{};
@@ -142,8 +279,7 @@ HRESULT GetActivationLocation(HSTRING activatableClassId, ActivationLocation &ac
     APTTYPEQUALIFIER aptQualifier{};
     RETURN_IF_FAILED(CoGetApartmentType(&aptType, &aptQualifier));
 
-    ABI::Windows::Foundation::ThreadingType threading_model;
-    const HRESULT hr{ WinRTGetThreadingModel(activatableClassId, &threading_model) };
+    const HRESULT hr{ WinRTResolveActivatableClass(activatableClassId, activatableClass) };
     if (FAILED(hr))
     {
         if (hr == REGDB_E_CLASSNOTREG)  // Not found
@@ -152,7 +288,7 @@ HRESULT GetActivationLocation(HSTRING activatableClassId, ActivationLocation &ac
         }
         RETURN_HR_MSG(hr, "URFW: ActivatableClassId=%ls", activatableClassIdAsString);
     }
-    switch (threading_model)
+    switch (activatableClass.threading_model)
     {
     case ABI::Windows::Foundation::ThreadingType_BOTH:
         activationLocation = ActivationLocation::CurrentApartment;
@@ -184,8 +320,9 @@ HRESULT GetActivationLocation(HSTRING activatableClassId, ActivationLocation &ac
 
 HRESULT WINAPI RoActivateInstanceDetour(HSTRING activatableClassId, IInspectable** instance)
 {
+    WinRTActivatableClass activatableClass;
     ActivationLocation location;
-    HRESULT hr = GetActivationLocation(activatableClassId, location);
+    HRESULT hr = GetActivationLocation(activatableClassId, activatableClass, location);
     if (hr == REGDB_E_CLASSNOTREG)
     {
         return TrueRoActivateInstance(activatableClassId, instance);
@@ -196,44 +333,22 @@ HRESULT WINAPI RoActivateInstanceDetour(HSTRING activatableClassId, IInspectable
     if (location == ActivationLocation::CurrentApartment)
     {
         Microsoft::WRL::ComPtr<IActivationFactory> pFactory;
-        RETURN_IF_FAILED(WinRTGetActivationFactory(activatableClassId, __uuidof(IActivationFactory), (void**)&pFactory));
+        RETURN_IF_FAILED(WinRTGetActivationFactory(activatableClass, activatableClassId, __uuidof(IActivationFactory), (void**)&pFactory));
         return pFactory->ActivateInstance(instance);
     }
 
     // Cross apartment MTA activation
-    struct CrossApartmentMTAActData {
-        HSTRING activatableClassId;
-        IStream *stream;
-    };
-
-    CrossApartmentMTAActData cbdata{ activatableClassId };
-    CO_MTA_USAGE_COOKIE mtaUsageCookie;
-    RETURN_IF_FAILED(CoIncrementMTAUsage(&mtaUsageCookie));
-    RETURN_IF_FAILED(EnsureMTAInitialized());
-    Microsoft::WRL::ComPtr<IContextCallback> defaultContext;
-    ComCallData data;
-    data.pUserDefined = &cbdata;
-    RETURN_IF_FAILED(CoGetDefaultContext(APTTYPE_MTA, IID_PPV_ARGS(&defaultContext)));
-    RETURN_IF_FAILED(defaultContext->ContextCallback(
-        [](_In_ ComCallData* pComCallData) -> HRESULT
-        {
-            CrossApartmentMTAActData* data = reinterpret_cast<CrossApartmentMTAActData*>(pComCallData->pUserDefined);
-            Microsoft::WRL::ComPtr<IInspectable> instance;
-            Microsoft::WRL::ComPtr<IActivationFactory> pFactory;
-            RETURN_IF_FAILED(WinRTGetActivationFactory(data->activatableClassId, __uuidof(IActivationFactory), (void**)&pFactory));
-            RETURN_IF_FAILED(pFactory->ActivateInstance(&instance));
-            RETURN_IF_FAILED(CoMarshalInterThreadInterfaceInStream(IID_IInspectable, instance.Get(), &data->stream));
-            return S_OK;
-        },
-        &data, IID_ICallbackWithNoReentrancyToApplicationSTA, 5, nullptr)); // 5 is meaningless.
-    RETURN_IF_FAILED(CoGetInterfaceAndReleaseStream(cbdata.stream, IID_IInspectable, (LPVOID*)instance));
+    MTAActivator::Activation activation{ &activatableClass, activatableClassId, false };
+    RETURN_IF_FAILED(MTAActivator::Activate(&activation, 1));
+    RETURN_IF_FAILED(CoGetInterfaceAndReleaseStream(activation.stream, IID_IInspectable, (LPVOID*)instance));
     return S_OK;
 }
 
 HRESULT WINAPI RoGetActivationFactoryDetour(HSTRING activatableClassId, REFIID iid, void** factory)
 {
+    WinRTActivatableClass activatableClass;
     ActivationLocation location;
-    HRESULT hr = GetActivationLocation(activatableClassId, location);
+    HRESULT hr = GetActivationLocation(activatableClassId, activatableClass, location);
     if (hr == REGDB_E_CLASSNOTREG)
     {
         return TrueRoGetActivationFactory(activatableClassId, iid, factory);
@@ -243,33 +358,13 @@ HRESULT WINAPI RoGetActivationFactoryDetour(HSTRING activatableClassId, REFIID i
     // Activate in current apartment
     if (location == ActivationLocation::CurrentApartment)
     {
-        RETURN_IF_FAILED(WinRTGetActivationFactory(activatableClassId, iid, factory));
+        RETURN_IF_FAILED(WinRTGetActivationFactory(activatableClass, activatableClassId, iid, factory));
         return S_OK;
     }
     // Cross apartment MTA activation
-    struct CrossApartmentMTAActData {
-        HSTRING activatableClassId;
-        IStream* stream;
-    };
-    CrossApartmentMTAActData cbdata{ activatableClassId };
-    CO_MTA_USAGE_COOKIE mtaUsageCookie;
-    RETURN_IF_FAILED(CoIncrementMTAUsage(&mtaUsageCookie));
-    RETURN_IF_FAILED(EnsureMTAInitialized());
-    Microsoft::WRL::ComPtr<IContextCallback> defaultContext;
-    ComCallData data;
-    data.pUserDefined = &cbdata;
-    RETURN_IF_FAILED(CoGetDefaultContext(APTTYPE_MTA, IID_PPV_ARGS(&defaultContext)));
-    defaultContext->ContextCallback(
-        [](_In_ ComCallData* pComCallData) -> HRESULT
-        {
-            CrossApartmentMTAActData* data = reinterpret_cast<CrossApartmentMTAActData*>(pComCallData->pUserDefined);
-            Microsoft::WRL::ComPtr<IActivationFactory> pFactory;
-            RETURN_IF_FAILED(WinRTGetActivationFactory(data->activatableClassId, __uuidof(IActivationFactory), (void**)&pFactory));
-            RETURN_IF_FAILED(CoMarshalInterThreadInterfaceInStream(IID_IActivationFactory, pFactory.Get(), &data->stream));
-            return S_OK;
-        },
-        &data, IID_ICallbackWithNoReentrancyToApplicationSTA, 5, nullptr); // 5 is meaningless.
-    RETURN_IF_FAILED(CoGetInterfaceAndReleaseStream(cbdata.stream, IID_IActivationFactory, factory));
+    MTAActivator::Activation activation{ &activatableClass, activatableClassId, true };
+    RETURN_IF_FAILED(MTAActivator::Activate(&activation, 1));
+    RETURN_IF_FAILED(CoGetInterfaceAndReleaseStream(activation.stream, iid, factory));
     return S_OK;
 }
 
@@ -299,14 +394,20 @@ HRESULT WINAPI RoResolveNamespaceDetour(
     DWORD* subNamespacesCount,
     HSTRING** subNamespaces)
 {
+    // Only look next to the exe if there's something there to find; most apps have no .winmd
+    // there, or none for the namespace, and resolving it twice is expensive.
+    HRESULT hr = RO_E_METADATA_NAME_NOT_FOUND;
     PCWSTR exeFilePath = nullptr;
-    UndockedRegFreeWinRT::GetProcessExeDir(&exeFilePath);
-    auto pathReference = Microsoft::WRL::Wrappers::HStringReference(exeFilePath);
-    HSTRING packageGraphDirectories[] = { pathReference.Get() };
-    HRESULT hr = TrueRoResolveNamespace(name, pathReference.Get(),
-        ARRAYSIZE(packageGraphDirectories), packageGraphDirectories,
-        metaDataFilePathsCount, metaDataFilePaths,
-        subNamespacesCount, subNamespaces);
+    if (SUCCEEDED(UndockedRegFreeWinRT::GetProcessExeDir(&exeFilePath)) &&
+        UndockedRegFreeWinRT::MayResolveNamespaceInDirectory(WindowsGetStringRawBuffer(name, nullptr), exeFilePath))
+    {
+        auto pathReference = Microsoft::WRL::Wrappers::HStringReference(exeFilePath);
+        HSTRING packageGraphDirectories[] = { pathReference.Get() };
+        hr = TrueRoResolveNamespace(name, pathReference.Get(),
+            ARRAYSIZE(packageGraphDirectories), packageGraphDirectories,
+            metaDataFilePathsCount, metaDataFilePaths,
+            subNamespacesCount, subNamespaces);
+    }
     if (FAILED(hr))
     {
         hr = TrueRoResolveNamespace(name, windowsMetaDataDir,
@@ -325,6 +426,13 @@ HRESULT ExtRoLoadCatalog()
         return HRESULT_FROM_WIN32(GetLastError());
     }
     std::wstring manifestPath(filePath);
+
+    // A compiled catalog that's still current saves creating the activation context and parsing its manifests
+    if (WinRTLoadCompiledCatalog(filePath) == S_OK)
+    {
+        return S_OK;
+    }
+
     HANDLE hActCtx = INVALID_HANDLE_VALUE;
     auto exit = wil::scope_exit([&]
     {
@@ -375,6 +483,7 @@ HRESULT ExtRoLoadCatalog()
         bufferSize,
         nullptr));
 
+    std::vector<std::wstring> manifestPaths;
     for (DWORD index = 1; index <= actCtxInfo->ulAssemblyCount; index++)
     {
         bufferSize = 0;
@@ -403,6 +512,13 @@ HRESULT ExtRoLoadCatalog()
             bufferSize,
             nullptr));
         RETURN_IF_FAILED(LoadManifestFromPath(asmInfo->lpAssemblyManifestPath));
+        manifestPaths.emplace_back(asmInfo->lpAssemblyManifestPath);
+    }
+
+    // Without any manifests there's nothing a catalog could be validated against
+    if (!manifestPaths.empty())
+    {
+        LOG_IF_FAILED(WinRTSaveCompiledCatalog(filePath, manifestPaths));
     }
     return S_OK;
 }
@@ -432,6 +548,72 @@ void UrfwShutdown() noexcept
     DetourDetach(&(PVOID&)TrueRoResolveNamespace, RoResolveNamespaceDetour);
 }
 
+extern "C" HRESULT WINAPI UrfwActivateInstances(UINT32 count, const HSTRING* activatableClassIds, IInspectable** instances) noexcept try
+{
+    RETURN_HR_IF(E_INVALIDARG, (count > 0) && ((activatableClassIds == nullptr) || (instances == nullptr)));
+    std::fill(instances, instances + count, nullptr);
+
+    std::vector<WinRTActivatableClass> activatableClasses(count);
+    std::vector<ActivationLocation> locations(count);
+    std::vector<MTAActivator::Activation> mtaActivations;
+    std::vector<UINT32> mtaActivationIndexes;
+    auto releaseInstances = wil::scope_exit([&]
+    {
+        MTAActivator::ReleaseStreams(mtaActivations.data(), mtaActivations.size());
+        for (UINT32 index = 0; index < count; ++index)
+        {
+            if (instances[index])
+            {
+                instances[index]->Release();
+                instances[index] = nullptr;
+            }
+        }
+    });
+
+    // Classes that must be activated in the MTA are done together in one context transition
+    for (UINT32 index = 0; index < count; ++index)
+    {
+        const HRESULT hr{ GetActivationLocation(activatableClassIds[index], activatableClasses[index], locations[index]) };
+        if (hr == REGDB_E_CLASSNOTREG)
+        {
+            RETURN_IF_FAILED(TrueRoActivateInstance(activatableClassIds[index], &instances[index]));
+            continue;
+        }
+        RETURN_IF_FAILED(hr);
+
+        if (locations[index] == ActivationLocation::CurrentApartment)
+        {
+            Microsoft::WRL::ComPtr<IActivationFactory> pFactory;
+            RETURN_IF_FAILED(WinRTGetActivationFactory(activatableClasses[index], activatableClassIds[index], __uuidof(IActivationFactory), (void**)&pFactory));
+            RETURN_IF_FAILED(pFactory->ActivateInstance(&instances[index]));
+        }
+        else
+        {
+            mtaActivations.push_back({ &activatableClasses[index], activatableClassIds[index], false });
+            mtaActivationIndexes.push_back(index);
+        }
+    }
+
+    if (!mtaActivations.empty())
+    {
+        RETURN_IF_FAILED(MTAActivator::Activate(mtaActivations.data(), mtaActivations.size()));
+        for (size_t index = 0; index < mtaActivations.size(); ++index)
+        {
+            auto stream{ std::exchange(mtaActivations[index].stream, nullptr) };
+            RETURN_IF_FAILED(CoGetInterfaceAndReleaseStream(stream, IID_IInspectable, (LPVOID*)&instances[mtaActivationIndexes[index]]));
+        }
+    }
+
+    releaseInstances.release();
+    return S_OK;
+}
+CATCH_RETURN();
+
+extern "C" void WINAPI UrfwEnableFactoryCache(BOOL enable) noexcept
+{
+    WinRTEnableFactoryCache_SxS(!!enable);
+}
+
 extern "C" void WINAPI winrtact_Initialize()
 {
     return;
@@ -8,4 +8,13 @@ HRESULT UrfwInitialize() noexcept;
 
 void UrfwShutdown() noexcept;
 
+// Activate several classes at once. Classes that must be activated in the MTA
+// are activated together in one cross-apartment call. All or nothing: on failure
+// no instances are returned.
+extern "C" HRESULT WINAPI UrfwActivateInstances(UINT32 count, const HSTRING* activatableClassIds, IInspectable** instances) noexcept;
+
+// Opt in (or back out) of caching agile activation factories for classes in the
+// process' SxS manifest. Off by default.
+extern "C" void WINAPI UrfwEnableFactoryCache(BOOL enable) noexcept;
+
 #endif // URFW_H
@@ -0,0 +1,413 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINMDREADER_H)
+#define WINMDREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace UndockedRegFreeWinRT::WinMD
+{
+/// CorTypeAttr values used when interpreting TypeDef::flags.
+constexpr uint32_t c_tdVisibilityMask{ 0x00000007 };
+constexpr uint32_t c_tdPublic{ 0x00000001 };
+constexpr uint32_t c_tdWindowsRuntime{ 0x00004000 };
+
+/// A row in the TypeDef table.
+struct TypeDef
+{
+    std::wstring name;      // Namespace.Name, or just Name if the type has no namespace
+    uint32_t flags;         // CorTypeAttr
+    uint32_t token;         // mdTypeDef
+};
+
+inline bool IsNested(uint32_t flags)
+{
+    // tdNestedPublic...tdNestedFamORAssem
+    return (flags & c_tdVisibilityMask) > c_tdPublic;
+}
+
+namespace Details
+{
+    /// Bounds checked little-endian reads from a byte range.
+    class ByteReader
+    {
+    public:
+        ByteReader(const uint8_t* data, size_t size) :
+            m_data(data),
+            m_size(size)
+        {
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+        bool Contains(size_t offset, size_t length) const
+        {
+            return (offset <= m_size) && (length <= m_size - offset);
+        }
+
+        bool Read(size_t offset, size_t length, uint32_t& value) const
+        {
+            if (!Contains(offset, length))
+            {
+                return false;
+            }
+            value = 0;
+            for (size_t index=0; index < length; ++index)
+            {
+                value |= static_cast<uint32_t>(m_data[offset + index]) << (8 * index);
+            }
+            return true;
+        }
+
+        bool Read(size_t offset, uint32_t& value) const
+        {
+            return Read(offset, sizeof(uint32_t), value);
+        }
+
+        bool Read(size_t offset, uint64_t& value) const
+        {
+            uint32_t low{};
+            uint32_t high{};
+            if (!Read(offset, low) || !Read(offset + sizeof(uint32_t), high))
+            {
+                return false;
+            }
+            value = (static_cast<uint64_t>(high) << 32) | low;
+            return true;
+        }
+
+        const uint8_t* At(size_t offset) const
+        {
+            return m_data + offset;
+        }
+
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+    };
+
+    /// Append the null terminated UTF-8 string at offset in #Strings.
+    inline bool AppendString(const ByteReader& strings, uint32_t offset, std::wstring& string)
+    {
+        if (offset >= strings.Size())
+        {
+            return false;
+        }
+        const uint8_t* next{ strings.At(offset) };
+        const uint8_t* end{ strings.At(strings.Size()) };
+        while (next < end)
+        {
+            uint32_t codePoint{ *next++ };
+            if (codePoint == 0)
+            {
+                return true;
+            }
+
+            size_t continuationBytes{};
+            if (codePoint >= 0xF0)
+            {
+                codePoint &= 0x07;
+                continuationBytes = 3;
+            }
+            else if (codePoint >= 0xE0)
+            {
+                codePoint &= 0x0F;
+                continuationBytes = 2;
+            }
+            else if (codePoint >= 0xC0)
+            {
+                codePoint &= 0x1F;
+                continuationBytes = 1;
+            }
+            else if (codePoint >= 0x80)
+            {
+                codePoint = 0xFFFD;
+            }
+            for (; (continuationBytes > 0) && (next < end) && ((*next & 0xC0) == 0x80); --continuationBytes)
+            {
+                codePoint = (codePoint << 6) | (*next++ & 0x3F);
+            }
+            if ((continuationBytes > 0) || (codePoint > 0x10FFFF))
+            {
+                codePoint = 0xFFFD;
+            }
+
+            if ((sizeof(wchar_t) == 2) && (codePoint > 0xFFFF))
+            {
+                codePoint -= 0x10000;
+                string.push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+                string.push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+            }
+            else
+            {
+                string.push_back(static_cast<wchar_t>(codePoint));
+            }
+        }
+
+        // Ran off the end of the heap without finding the terminator
+        return false;
+    }
+
+    /// Map an RVA to a file offset via the PE section table.
+    inline bool RvaToOffset(const ByteReader& image, size_t sectionTable, uint32_t sectionCount, uint32_t rva, size_t& offset)
+    {
+        constexpr size_t c_sectionHeaderSize{ 40 };
+        for (uint32_t section=0; section < sectionCount; ++section)
+        {
+            const size_t header{ sectionTable + section * c_sectionHeaderSize };
+            uint32_t virtualSize{};
+            uint32_t virtualAddress{};
+            uint32_t sizeOfRawData{};
+            uint32_t pointerToRawData{};
+            if (!image.Read(header + 8, virtualSize) ||
+                !image.Read(header + 12, virtualAddress) ||
+                !image.Read(header + 16, sizeOfRawData) ||
+                !image.Read(header + 20, pointerToRawData))
+            {
+                return false;
+            }
+
+            const uint32_t extent{ (virtualSize > sizeOfRawData) ? virtualSize : sizeOfRawData };
+            if ((rva >= virtualAddress) && (rva - virtualAddress < extent))
+            {
+                offset = static_cast<size_t>(pointerToRawData) + (rva - virtualAddress);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+/// Read the TypeDef table of the ECMA-335 metadata in a PE image (e.g. a .winmd file).
+///
+/// This reads only what type resolution needs: each type's name, flags and token. It's
+/// std-only so it builds (and can be tested) anywhere; callers map or read the file.
+///
+/// @return false if the image isn't a well formed PE file containing CLI metadata.
+inline bool ReadTypeDefs(const uint8_t* data, size_t size, std::vector<TypeDef>& typeDefs)
+{
+    using Details::ByteReader;
+    typeDefs.clear();
+
+    const ByteReader image{ data, size };
+
+    // DOS header -> PE signature -> COFF header -> optional header -> data directories
+    uint32_t signature{};
+    if (!image.Read(0, 2, signature) || (signature != 0x5A4D))     // "MZ"
+    {
+        return false;
+    }
+    uint32_t peHeader{};
+    if (!image.Read(0x3C, peHeader) || !image.Read(peHeader, signature) || (signature != 0x00004550))  // "PE\0\0"
+    {
+        return false;
+    }
+    const size_t coffHeader{ static_cast<size_t>(peHeader) + 4 };
+    uint32_t sectionCount{};
+    uint32_t optionalHeaderSize{};
+    if (!image.Read(coffHeader + 2, 2, sectionCount) || !image.Read(coffHeader + 16, 2, optionalHeaderSize))
+    {
+        return false;
+    }
+    const size_t optionalHeader{ coffHeader + 20 };
+    const size_t sectionTable{ optionalHeader + optionalHeaderSize };
+    uint32_t magic{};
+    if (!image.Read(optionalHeader, 2, magic))
+    {
+        return false;
+    }
+    size_t dataDirectories{};
+    if (magic == 0x10B)         // PE32
+    {
+        dataDirectories = optionalHeader + 96;
+    }
+    else if (magic == 0x20B)    // PE32+
+    {
+        dataDirectories = optionalHeader + 112;
+    }
+    else
+    {
+        return false;
+    }
+    uint32_t dataDirectoryCount{};
+    constexpr uint32_t c_comDescriptorDirectory{ 14 };
+    if (!image.Read(dataDirectories - 4, dataDirectoryCount) || (dataDirectoryCount <= c_comDescriptorDirectory))
+    {
+        return false;
+    }
+
+    // CLI header -> metadata root
+    uint32_t cliHeaderRva{};
+    size_t cliHeader{};
+    if (!image.Read(dataDirectories + c_comDescriptorDirectory * 8, cliHeaderRva) ||
+        !Details::RvaToOffset(image, sectionTable, sectionCount, cliHeaderRva, cliHeader))
+    {
+        return false;
+    }
+    uint32_t metadataRva{};
+    uint32_t metadataSize{};
+    size_t metadataOffset{};
+    if (!image.Read(cliHeader + 8, metadataRva) ||
+        !image.Read(cliHeader + 12, metadataSize) ||
+        !Details::RvaToOffset(image, sectionTable, sectionCount, metadataRva, metadataOffset) ||
+        !image.Contains(metadataOffset, metadataSize))
+    {
+        return false;
+    }
+    const ByteReader metadata{ image.At(metadataOffset), metadataSize };
+
+    uint32_t versionLength{};
+    if (!metadata.Read(0, signature) || (signature != 0x424A5342) ||    // "BSJB"
+        !metadata.Read(12, versionLength))
+    {
+        return false;
+    }
+    size_t streamHeader{ 16 + ((static_cast<size_t>(versionLength) + 3) & ~size_t{ 3 }) };
+    uint32_t streamCount{};
+    if (!metadata.Read(streamHeader + 2, 2, streamCount))
+    {
+        return false;
+    }
+    streamHeader += 4;
+
+    // Stream headers are { offset, size, null terminated name padded to 4 bytes }
+    ByteReader tables{ nullptr, 0 };
+    ByteReader strings{ nullptr, 0 };
+    for (uint32_t stream=0; stream < streamCount; ++stream)
+    {
+        uint32_t streamOffset{};
+        uint32_t streamSize{};
+        if (!metadata.Read(streamHeader, streamOffset) ||
+            !metadata.Read(streamHeader + 4, streamSize) ||
+            !metadata.Contains(streamOffset, streamSize))
+        {
+            return false;
+        }
+
+        std::string name;
+        size_t nameOffset{ streamHeader + 8 };
+        for (; metadata.Contains(nameOffset, 1) && (*metadata.At(nameOffset) != 0); ++nameOffset)
+        {
+            name.push_back(static_cast<char>(*metadata.At(nameOffset)));
+        }
+        streamHeader = (nameOffset + 1 + 3) & ~size_t{ 3 };
+
+        const ByteReader streamData{ metadata.At(streamOffset), streamSize };
+        if ((name == "#~") || (name == "#-"))
+        {
+            tables = streamData;
+        }
+        else if (name == "#Strings")
+        {
+            strings = streamData;
+        }
+    }
+    if ((tables.Size() == 0) || (strings.Size() == 0))
+    {
+        return false;
+    }
+
+    // #~ header: reserved(4) major(1) minor(1) heapSizes(1) reserved(1) valid(8) sorted(8) rows[]
+    uint32_t heapSizes{};
+    uint64_t valid{};
+    if (!tables.Read(6, 1, heapSizes) || !tables.Read(8, valid))
+    {
+        return false;
+    }
+    uint32_t rows[64]{};
+    size_t offset{ 24 };
+    for (uint32_t table=0; table < 64; ++table)
+    {
+        if ((valid & (uint64_t{ 1 } << table)) != 0)
+        {
+            if (!tables.Read(offset, rows[table]))
+            {
+                return false;
+            }
+            offset += 4;
+        }
+    }
+    if ((heapSizes & 0x40) != 0)
+    {
+        // Extra data (uncompressed #- streams only)
+        offset += 4;
+    }
+
+    enum : uint32_t
+    {
+        ModuleTable = 0x00,
+        TypeRefTable = 0x01,
+        TypeDefTable = 0x02,
+        FieldTable = 0x04,
+        MethodDefTable = 0x06,
+        ModuleRefTable = 0x1A,
+        TypeSpecTable = 0x1B,
+        AssemblyRefTable = 0x23,
+    };
+    const size_t stringIndex{ (heapSizes & 0x01) ? 4u : 2u };
+    const size_t guidIndex{ (heapSizes & 0x02) ? 4u : 2u };
+    auto tableIndex = [&](uint32_t table) -> size_t
+    {
+        return (rows[table] < 0x10000) ? 2 : 4;
+    };
+    auto codedIndex = [&](std::initializer_list<uint32_t> tagged, uint32_t tagBits) -> size_t
+    {
+        uint32_t maxRows{};
+        for (auto table : tagged)
+        {
+            maxRows = (rows[table] > maxRows) ? rows[table] : maxRows;
+        }
+        return (maxRows < (uint32_t{ 1 } << (16 - tagBits))) ? 2 : 4;
+    };
+
+    // The Module and TypeRef tables precede TypeDef
+    const size_t moduleRowSize{ 2 + stringIndex + 3 * guidIndex };
+    const size_t typeRefRowSize{ codedIndex({ ModuleTable, ModuleRefTable, AssemblyRefTable, TypeRefTable }, 2) + 2 * stringIndex };
+    const size_t typeDefRowSize{ 4 + 2 * stringIndex + codedIndex({ TypeDefTable, TypeRefTable, TypeSpecTable }, 2) + tableIndex(FieldTable) + tableIndex(MethodDefTable) };
+    offset += rows[ModuleTable] * moduleRowSize + rows[TypeRefTable] * typeRefRowSize;
+    if (!tables.Contains(offset, static_cast<size_t>(rows[TypeDefTable]) * typeDefRowSize))
+    {
+        return false;
+    }
+
+    typeDefs.reserve(rows[TypeDefTable]);
+    for (uint32_t row=0; row < rows[TypeDefTable]; ++row, offset += typeDefRowSize)
+    {
+        uint32_t flags{};
+        uint32_t nameIndex{};
+        uint32_t namespaceIndex{};
+        tables.Read(offset, flags);
+        tables.Read(offset + 4, stringIndex, nameIndex);
+        tables.Read(offset + 4 + stringIndex, stringIndex, namespaceIndex);
+
+        TypeDef typeDef{ {}, flags, 0x02000000 | (row + 1) };
+        if (namespaceIndex != 0)
+        {
+            if (!Details::AppendString(strings, namespaceIndex, typeDef.name))
+            {
+                return false;
+            }
+            if (!typeDef.name.empty())
+            {
+                typeDef.name.push_back(L'.');
+            }
+        }
+        if (!Details::AppendString(strings, nameIndex, typeDef.name))
+        {
+            return false;
+        }
+        typeDefs.push_back(std::move(typeDef));
+    }
+    return true;
+}
+}
+
+#endif // WINMDREADER_H
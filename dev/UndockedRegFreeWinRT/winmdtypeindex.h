@@ -0,0 +1,381 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINMDTYPEINDEX_H)
+#define WINMDTYPEINDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cwctype>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "winmdreader.h"
+
+namespace UndockedRegFreeWinRT
+{
+/// The *.winmd files in a directory, as seen by a WinMDTypeIndex.
+class IWinMDDirectory
+{
+public:
+    struct File
+    {
+        std::wstring name;          // File name without the directory e.g. L"Contoso.Widgets.winmd"
+        uint64_t lastWriteTime;
+        uint64_t size;
+
+        bool operator==(const File& other) const
+        {
+            return (lastWriteTime == other.lastWriteTime) && (size == other.size) && (name == other.name);
+        }
+    };
+
+public:
+    virtual ~IWinMDDirectory() = default;
+
+    /// The directory's last write time. This changes when files are added to, removed from or renamed in the directory.
+    virtual uint64_t GetLastWriteTime() = 0;
+
+    /// The *.winmd files in the directory.
+    virtual std::vector<File> GetFiles() = 0;
+
+    /// Read a file's TypeDef table (see WinMD::ReadTypeDefs()).
+    /// @return false if the file can't be read or doesn't contain metadata.
+    virtual bool ReadTypeDefs(const std::wstring& fileName, std::vector<WinMD::TypeDef>& typeDefs) = 0;
+};
+
+/// Where WinMDTypeIndex::Find() found a name.
+struct WinMDTypeLocation
+{
+    enum class Kind
+    {
+        NotFound,
+        Type,
+        Namespace,
+    };
+
+    Kind kind;
+    std::wstring fileName;          // Type only
+    uint32_t token;                 // Type only; the mdTypeDef in fileName
+};
+
+/// Types and namespaces defined by the .winmd files in a directory.
+///
+/// Find() answers the same question FindTypeInDirectory() used to answer by probing files
+/// (Name.winmd, then each parent namespace's .winmd, then a Name*.winmd search for namespaces)
+/// but from an in-memory index, built lazily on first use by reading each file's TypeDef table
+/// once. Results, including names that weren't found, are cached until the index is rebuilt.
+///
+/// The index is rebuilt when the directory's last write time changes (a .winmd was added,
+/// removed or renamed). Files rewritten in place don't touch the directory so each file's last
+/// write time and size are also rechecked, at most once per revalidation interval. Rebuilds
+/// only reread files that changed.
+///
+/// Names are case sensitive (as metadata is) but file names aren't.
+///
+/// @note Methods are thread safe.
+class WinMDTypeIndex
+{
+public:
+    static constexpr std::chrono::milliseconds c_defaultRevalidationInterval{ 1000 };
+    static constexpr size_t c_maxCachedResults{ 4096 };
+
+    struct Statistics
+    {
+        uint64_t builds;
+        uint64_t filesRead;
+        uint64_t hits;
+        uint64_t misses;
+        size_t files;
+        size_t types;
+    };
+
+public:
+    explicit WinMDTypeIndex(
+        std::unique_ptr<IWinMDDirectory> directory,
+        std::chrono::milliseconds revalidationInterval = c_defaultRevalidationInterval) :
+        m_directory(std::move(directory)),
+        m_revalidationInterval(revalidationInterval)
+    {
+    }
+
+    WinMDTypeIndex(const WinMDTypeIndex&) = delete;
+    WinMDTypeIndex& operator=(const WinMDTypeIndex&) = delete;
+
+    ~WinMDTypeIndex() = default;
+
+    /// Find a type (or namespace) by its full name e.g. L"Contoso.Widgets.Widget".
+    WinMDTypeLocation Find(const std::wstring& name)
+    {
+        Refresh();
+
+        uint64_t generation{};
+        WinMDTypeLocation location{};
+        {
+            auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+            auto iterator{ m_results.find(name) };
+            if (iterator != m_results.end())
+            {
+                ++m_hits;
+                return iterator->second;
+            }
+            location = Resolve(name);
+            generation = m_generation;
+        }
+        ++m_misses;
+
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        if (generation == m_generation)
+        {
+            if (m_results.size() >= c_maxCachedResults)
+            {
+                m_results.clear();
+            }
+            m_results.emplace(name, location);
+        }
+        return location;
+    }
+
+    /// Could RoResolveNamespace() find anything for the namespace in this directory? False
+    /// only if no .winmd defines a type in (or under) the namespace and none is named as if
+    /// it might, so asking is pointless.
+    bool MayResolveNamespace(const std::wstring& name)
+    {
+        if (name.empty())
+        {
+            return true;
+        }
+
+        Refresh();
+
+        auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+        if (m_namespaces.count(name) != 0)
+        {
+            return true;
+        }
+        const std::wstring lowerName{ ToLower(name) };
+        for (const auto& [stem, file] : m_filesByStem)
+        {
+            if (IsSameOrChildNamespace(stem, lowerName) || IsSameOrChildNamespace(lowerName, stem))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Discard the index; the next call rebuilds it, rereading every file.
+    void Invalidate()
+    {
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        m_built = false;
+        m_files.clear();
+        m_filesByStem.clear();
+        m_namespaces.clear();
+        m_results.clear();
+        ++m_generation;
+    }
+
+    Statistics GetStatistics()
+    {
+        auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+        size_t types{};
+        for (const auto& file : m_files)
+        {
+            types += file->types.size();
+        }
+        return Statistics{ m_builds.load(), m_filesRead.load(), m_hits.load(), m_misses.load(), m_files.size(), types };
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct IndexedType
+    {
+        uint32_t flags;
+        uint32_t token;
+    };
+
+    struct IndexedFile
+    {
+        IWinMDDirectory::File file;
+        std::unordered_map<std::wstring, IndexedType> types;
+        std::unordered_set<std::wstring> namespaces;
+    };
+
+    static std::wstring ToLower(std::wstring string)
+    {
+        for (auto& c : string)
+        {
+            c = static_cast<wchar_t>(std::towlower(c));
+        }
+        return string;
+    }
+
+    static bool IsSameOrChildNamespace(const std::wstring& name, const std::wstring& parent)
+    {
+        return (name.compare(0, parent.size(), parent) == 0) &&
+               ((name.size() == parent.size()) || (name[parent.size()] == L'.'));
+    }
+
+    std::shared_ptr<const IndexedFile> ReadFile(const IWinMDDirectory::File& file)
+    {
+        auto indexedFile{ std::make_shared<IndexedFile>() };
+        indexedFile->file = file;
+        ++m_filesRead;
+
+        // A file that isn't metadata is indexed as empty, as if it defined nothing
+        std::vector<WinMD::TypeDef> typeDefs;
+        if (m_directory->ReadTypeDefs(file.name, typeDefs))
+        {
+            for (const auto& typeDef : typeDefs)
+            {
+                // Only top level types can be found by name. The first definition wins, as it does for FindTypeDefByName()
+                if (!WinMD::IsNested(typeDef.flags))
+                {
+                    indexedFile->types.emplace(typeDef.name, IndexedType{ typeDef.flags, typeDef.token });
+                }
+
+                // A name is a namespace if it prefixes the name of a Windows Runtime type
+                if ((typeDef.flags & WinMD::c_tdWindowsRuntime) != 0)
+                {
+                    for (auto dot{ typeDef.name.find(L'.') }; dot != std::wstring::npos; dot = typeDef.name.find(L'.', dot + 1))
+                    {
+                        indexedFile->namespaces.insert(typeDef.name.substr(0, dot));
+                    }
+                }
+            }
+        }
+        return indexedFile;
+    }
+
+    void Refresh()
+    {
+        const auto now{ Clock::now() };
+        const uint64_t directoryLastWriteTime{ m_directory->GetLastWriteTime() };
+        {
+            auto lock{ std::shared_lock<std::shared_mutex>(m_lock) };
+            if (m_built && (directoryLastWriteTime == m_directoryLastWriteTime) && (now - m_lastValidated < m_revalidationInterval))
+            {
+                return;
+            }
+        }
+
+        // One thread (re)builds at a time. Lookups keep using the current index until the new one's ready
+        auto buildLock{ std::lock_guard<std::mutex>(m_buildLock) };
+
+        auto files{ m_directory->GetFiles() };
+        std::unordered_map<std::wstring, std::shared_ptr<const IndexedFile>> previousFiles;
+        {
+            auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+            if (m_built && (m_files.size() == files.size()) &&
+                std::equal(files.begin(), files.end(), m_files.begin(), [](const auto& file, const auto& indexedFile) { return file == indexedFile->file; }))
+            {
+                // Nothing changed
+                m_directoryLastWriteTime = directoryLastWriteTime;
+                m_lastValidated = now;
+                return;
+            }
+            for (const auto& indexedFile : m_files)
+            {
+                previousFiles.emplace(indexedFile->file.name, indexedFile);
+            }
+        }
+
+        std::vector<std::shared_ptr<const IndexedFile>> indexedFiles;
+        std::unordered_map<std::wstring, std::shared_ptr<const IndexedFile>> filesByStem;
+        std::unordered_set<std::wstring> namespaces;
+        indexedFiles.reserve(files.size());
+        for (const auto& file : files)
+        {
+            auto previous{ previousFiles.find(file.name) };
+            auto indexedFile{ ((previous != previousFiles.end()) && (previous->second->file == file)) ? previous->second : ReadFile(file) };
+
+            std::wstring stem{ ToLower(file.name) };
+            constexpr size_t c_extensionLength{ 6 };    // ".winmd"
+            stem.resize((stem.size() > c_extensionLength) ? stem.size() - c_extensionLength : 0);
+            filesByStem.emplace(std::move(stem), indexedFile);
+            namespaces.insert(indexedFile->namespaces.begin(), indexedFile->namespaces.end());
+            indexedFiles.push_back(std::move(indexedFile));
+        }
+
+        auto lock{ std::unique_lock<std::shared_mutex>(m_lock) };
+        m_files = std::move(indexedFiles);
+        m_filesByStem = std::move(filesByStem);
+        m_namespaces = std::move(namespaces);
+        m_results.clear();
+        ++m_generation;
+        ++m_builds;
+        m_built = true;
+        m_directoryLastWriteTime = directoryLastWriteTime;
+        m_lastValidated = now;
+    }
+
+    WinMDTypeLocation Resolve(const std::wstring& name) const
+    {
+        // NOTE: Caller must hold m_lock
+
+        // A type is defined in the file named after it or after one of its namespaces, most specific first.
+        // Non-Windows Runtime types don't count
+        const std::wstring lowerName{ ToLower(name) };
+        for (auto length{ lowerName.size() }; length != std::wstring::npos; length = lowerName.rfind(L'.', length - 1))
+        {
+            auto file{ m_filesByStem.find(lowerName.substr(0, length)) };
+            if (file != m_filesByStem.end())
+            {
+                auto type{ file->second->types.find(name) };
+                if ((type != file->second->types.end()) && ((type->second.flags & WinMD::c_tdWindowsRuntime) != 0))
+                {
+                    return WinMDTypeLocation{ WinMDTypeLocation::Kind::Type, file->second->file.name, type->second.token };
+                }
+            }
+            if (length == 0)
+            {
+                break;
+            }
+        }
+
+        // A namespace is defined by any file whose name starts with it (Name*.winmd)
+        if (m_namespaces.count(name) != 0)
+        {
+            for (const auto& [stem, file] : m_filesByStem)
+            {
+                if ((stem.compare(0, lowerName.size(), lowerName) == 0) && (file->namespaces.count(name) != 0))
+                {
+                    return WinMDTypeLocation{ WinMDTypeLocation::Kind::Namespace, {}, 0 };
+                }
+            }
+        }
+        return WinMDTypeLocation{ WinMDTypeLocation::Kind::NotFound, {}, 0 };
+    }
+
+private:
+    std::unique_ptr<IWinMDDirectory> m_directory;
+    std::chrono::milliseconds m_revalidationInterval;
+    std::mutex m_buildLock;
+
+    std::shared_mutex m_lock;
+    bool m_built{};
+    uint64_t m_generation{};
+    uint64_t m_directoryLastWriteTime{};
+    Clock::time_point m_lastValidated{};
+    std::vector<std::shared_ptr<const IndexedFile>> m_files;
+    std::unordered_map<std::wstring, std::shared_ptr<const IndexedFile>> m_filesByStem;     // By lowercase name without .winmd
+    std::unordered_set<std::wstring> m_namespaces;
+    std::unordered_map<std::wstring, WinMDTypeLocation> m_results;
+
+    std::atomic<uint64_t> m_builds{};
+    std::atomic<uint64_t> m_filesRead{};
+    std::atomic<uint64_t> m_hits{};
+    std::atomic<uint64_t> m_misses{};
+};
+}
+
+#endif // WINMDTYPEINDEX_H
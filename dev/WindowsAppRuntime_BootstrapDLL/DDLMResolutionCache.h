@@ -0,0 +1,205 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(DDLMRESOLUTIONCACHE_H)
+#define DDLMRESOLUTIONCACHE_H
+
+#include <cstdint>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+namespace MddBootstrap
+{
+/// What MddBootstrapInitialize() was asked for, i.e. what a DDLM resolution was made for.
+struct DDLMResolutionCriteria
+{
+    uint32_t majorMinorVersion{};
+    std::wstring versionTag;
+    uint64_t minVersion{};
+    uint32_t architecture{};
+    bool viaEnumeration{};
+
+    // Test qualifiers (see MddBootstrapTestInitialize()). Empty if not testing
+    std::wstring ddlmPackageNamePrefix;
+    std::wstring ddlmPackagePublisherId;
+
+    /// Return a string uniquely identifying the criteria e.g. "1.2;preview;0001000200030004;9;E;;"
+    std::wstring ToString() const
+    {
+        wchar_t buffer[64]{};
+        swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"%u.%u;", static_cast<unsigned>(majorMinorVersion >> 16), static_cast<unsigned>(majorMinorVersion & 0xFFFF));
+        std::wstring s{ buffer };
+        s += versionTag;
+        swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L";%016llX;%u;", static_cast<unsigned long long>(minVersion), static_cast<unsigned>(architecture));
+        s += buffer;
+        s += viaEnumeration ? L"E;" : L"X;";
+        s += ddlmPackageNamePrefix;
+        s += L';';
+        s += ddlmPackagePublisherId;
+        return s;
+    }
+};
+
+/// The DDLM (and its framework) selected for a DDLMResolutionCriteria.
+struct DDLMResolution
+{
+    // The package catalog's stamp (see IDDLMPackageCatalog::Stamp()) when the resolution was made
+    uint64_t catalogStamp{};
+
+    std::wstring ddlmPackageFamilyName;
+    std::wstring ddlmPackageFullName;
+    std::wstring ddlmPackagePath;
+
+    // The DDLM's COM server. Only used (and required) by the AppExtension algorithm
+    std::wstring ddlmClsid;
+
+    std::wstring frameworkPackageFamilyName;
+    std::wstring frameworkPackageFullName;
+    std::wstring frameworkPackagePath;
+};
+
+/// The package information needed to validate a DDLMResolution.
+class IDDLMPackageCatalog
+{
+public:
+    virtual ~IDDLMPackageCatalog() = default;
+
+    /// Return a value that changes whenever packages are registered or unregistered for the user, or 0 if unknown.
+    virtual uint64_t Stamp() = 0;
+
+    /// Return true and the package's install path if the package is registered for the user.
+    virtual bool TryGetPackagePath(const std::wstring& packageFullName, std::wstring& packagePath) = 0;
+
+    /// Return true if the package (installed at packagePath) is registered for the user and its status is OK.
+    ///
+    /// @note Called on every cache hit so this should be cheap. The package passed a full check when
+    ///       the resolution was made; this only needs to catch changes the catalog stamp doesn't.
+    virtual bool IsPackageStatusOK(const std::wstring& packageFullName, const std::wstring& packagePath) = 0;
+};
+
+/// Persisted DDLM resolutions are stored as text: a format version followed by one field per line.
+///
+/// @note A resolution is a hint. It MUST pass IsUsable() before use; if it doesn't
+///       the caller does the full search (and saves the new winner).
+class DDLMResolutionCache
+{
+public:
+    static constexpr wchar_t c_formatVersion[]{ L"DDLM1" };
+
+    static std::wstring Serialize(const DDLMResolution& resolution)
+    {
+        wchar_t stamp[16 + 1]{};
+        swprintf(stamp, sizeof(stamp) / sizeof(stamp[0]), L"%016llX", static_cast<unsigned long long>(resolution.catalogStamp));
+
+        std::wstring s{ c_formatVersion };
+        for (const auto& field : { std::wstring(stamp),
+                                   resolution.ddlmPackageFamilyName, resolution.ddlmPackageFullName, resolution.ddlmPackagePath,
+                                   resolution.ddlmClsid,
+                                   resolution.frameworkPackageFamilyName, resolution.frameworkPackageFullName, resolution.frameworkPackagePath })
+        {
+            s += L'\n';
+            s += field;
+        }
+        return s;
+    }
+
+    /// Return false if text isn't a well formed resolution (e.g. written by a different version of this code).
+    static bool Deserialize(const std::wstring& text, DDLMResolution& resolution)
+    {
+        std::vector<std::wstring> fields;
+        size_t offset{};
+        for (;;)
+        {
+            const auto end{ text.find(L'\n', offset) };
+            fields.push_back(text.substr(offset, end == std::wstring::npos ? std::wstring::npos : end - offset));
+            if (end == std::wstring::npos)
+            {
+                break;
+            }
+            offset = end + 1;
+        }
+        if ((fields.size() != 9) || (fields[0] != c_formatVersion))
+        {
+            return false;
+        }
+
+        const auto& stamp{ fields[1] };
+        wchar_t* stampEnd{};
+        const auto catalogStamp{ wcstoull(stamp.c_str(), &stampEnd, 16) };
+        if ((stamp.length() != 16) || (stampEnd != stamp.c_str() + stamp.length()))
+        {
+            return false;
+        }
+
+        DDLMResolution parsed;
+        parsed.catalogStamp = catalogStamp;
+        parsed.ddlmPackageFamilyName = std::move(fields[2]);
+        parsed.ddlmPackageFullName = std::move(fields[3]);
+        parsed.ddlmPackagePath = std::move(fields[4]);
+        parsed.ddlmClsid = std::move(fields[5]);
+        parsed.frameworkPackageFamilyName = std::move(fields[6]);
+        parsed.frameworkPackageFullName = std::move(fields[7]);
+        parsed.frameworkPackagePath = std::move(fields[8]);
+        resolution = std::move(parsed);
+        return true;
+    }
+
+    /// Return true if the resolution is complete for the criteria and still matches the catalog.
+    ///
+    /// The catalog stamp catches packages registered since the resolution was made (which may be
+    /// a better fit). The path and status checks catch packages that were removed, moved (e.g. to
+    /// a different volume) or damaged since then.
+    static bool IsUsable(const DDLMResolutionCriteria& criteria, const DDLMResolution& resolution, IDDLMPackageCatalog& catalog)
+    {
+        if (resolution.ddlmPackageFullName.empty() || resolution.ddlmPackagePath.empty() ||
+            resolution.frameworkPackageFamilyName.empty() || resolution.frameworkPackageFullName.empty() || resolution.frameworkPackagePath.empty())
+        {
+            return false;
+        }
+        if (criteria.viaEnumeration ? resolution.ddlmPackageFamilyName.empty() : resolution.ddlmClsid.empty())
+        {
+            return false;
+        }
+
+        const auto stamp{ catalog.Stamp() };
+        if ((stamp == 0) || (stamp != resolution.catalogStamp))
+        {
+            return false;
+        }
+
+        return IsPackageUsable(resolution.ddlmPackageFullName, resolution.ddlmPackagePath, catalog) &&
+               IsPackageUsable(resolution.frameworkPackageFullName, resolution.frameworkPackagePath, catalog);
+    }
+
+private:
+    static bool IsPackageUsable(const std::wstring& packageFullName, const std::wstring& expectedPackagePath, IDDLMPackageCatalog& catalog)
+    {
+        std::wstring packagePath;
+        if (!catalog.TryGetPackagePath(packageFullName, packagePath) || !IsEqualNoCase(packagePath, expectedPackagePath))
+        {
+            return false;
+        }
+        return catalog.IsPackageStatusOK(packageFullName, packagePath);
+    }
+
+    static bool IsEqualNoCase(const std::wstring& s1, const std::wstring& s2)
+    {
+        if (s1.length() != s2.length())
+        {
+            return false;
+        }
+        for (size_t index = 0; index < s1.length(); ++index)
+        {
+            if (std::towupper(s1[index]) != std::towupper(s2[index]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+}
+
+#endif // DDLMRESOLUTIONCACHE_H
@@ -10,8 +10,19 @@
 
 #include "IDynamicDependencyLifetimeManager.h"
 
+#include "DDLMResolutionCache.h"
+
 #include <filesystem>
 
+/// IDDLMPackageCatalog over the packages registered for the current user
+class DDLMPackageCatalog : public MddBootstrap::IDDLMPackageCatalog
+{
+public:
+    uint64_t Stamp() override;
+    bool TryGetPackagePath(const std::wstring& packageFullName, std::wstring& packagePath) override;
+    bool IsPackageStatusOK(const std::wstring& packageFullName, const std::wstring& packagePath) override;
+};
+
 wil::unique_cotaskmem_ptr<BYTE[]> GetFrameworkPackageInfoForPackage(PCWSTR packageFullName, const PACKAGE_INFO*& frameworkPackageInfo);
 DLL_DIRECTORY_COOKIE AddFrameworkToPath(PCWSTR path);
 void RemoveFrameworkFromPath(PCWSTR frameworkPath);
@@ -22,19 +33,20 @@ void CreateLifetimeManager(
     PACKAGE_VERSION minVersion,
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
     wil::unique_event& endTheLifetimeManagerEvent,
-    wil::unique_cotaskmem_string& ddlmPackageFullName);
+    MddBootstrap::DDLMResolution& resolution);
+void CreateLifetimeManagerForResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::DDLMResolution& resolution,
+    wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
+    wil::unique_event& endTheLifetimeManagerEvent);
 void CreateLifetimeManagerViaAppExtension(
-    UINT32 majorMinorVersion,
-    PCWSTR versionTag,
-    PACKAGE_VERSION minVersion,
+    const CLSID& appDynamicDependencyLifetimeManagerClsid,
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
     wil::unique_cotaskmem_string& ddlmPackageFullName);
 void CreateLifetimeManagerViaEnumeration(
-    UINT32 majorMinorVersion,
-    PCWSTR versionTag,
-    PACKAGE_VERSION minVersion,
-    wil::unique_event& endTheLifetimeManagerEvent,
-    wil::unique_cotaskmem_string& ddlmPackageFullName);
+    PCWSTR ddlmPackageFamilyName,
+    PCWSTR ddlmPackageFullName,
+    wil::unique_event& endTheLifetimeManagerEvent);
 CLSID FindDDLMViaAppExtension(
     UINT32 majorMinorVersion,
     PCWSTR versionTag,
@@ -46,6 +58,20 @@ void FindDDLMViaEnumeration(
     std::wstring& ddlmPackageFamilyName,
     std::wstring& ddlmPackageFullName);
 CLSID GetClsid(const winrt::Windows::ApplicationModel::AppExtensions::AppExtension& appExtension);
+MddBootstrap::DDLMResolutionCriteria GetDDLMResolutionCriteria(
+    UINT32 majorMinorVersion,
+    PCWSTR versionTag,
+    PACKAGE_VERSION minVersion,
+    bool viaEnumeration);
+bool LoadDDLMResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::IDDLMPackageCatalog& catalog,
+    MddBootstrap::DDLMResolution& resolution);
+void SaveDDLMResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::IDDLMPackageCatalog& catalog,
+    MddBootstrap::DDLMResolution& resolution);
+void DeleteDDLMResolution(const MddBootstrap::DDLMResolutionCriteria& criteria);
 
 IDynamicDependencyLifetimeManager* g_lifetimeManager{};
 wil::unique_event g_endTheLifetimeManagerEvent;
@@ -69,18 +95,16 @@ STDAPI MddBootstrapInitialize(
     FAIL_FAST_HR_IF(HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED), g_packageDependencyId != nullptr);
     FAIL_FAST_HR_IF(HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED), g_packageDependencyContext != nullptr);
 
-    wil::unique_cotaskmem_string packageFullName;
+    MddBootstrap::DDLMResolution resolution;
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager> lifetimeManager;
     wil::unique_event endTheLifetimeManagerEvent;
-    CreateLifetimeManager(majorMinorVersion, versionTag, minVersion, lifetimeManager, endTheLifetimeManagerEvent, packageFullName);
-
-    const PACKAGE_INFO* frameworkPackageInfo{};
-    auto packageInfoBuffer{ GetFrameworkPackageInfoForPackage(packageFullName.get(), frameworkPackageInfo) };
+    CreateLifetimeManager(majorMinorVersion, versionTag, minVersion, lifetimeManager, endTheLifetimeManagerEvent, resolution);
+    PCWSTR frameworkPackagePath{ resolution.frameworkPackagePath.c_str() };
 
     // Temporarily add the framework's package directory to PATH so LoadLibrary can find it and any colocated imports
-    wil::unique_dll_directory_cookie dllDirectoryCookie{ AddFrameworkToPath(frameworkPackageInfo->path) };
+    wil::unique_dll_directory_cookie dllDirectoryCookie{ AddFrameworkToPath(frameworkPackagePath) };
 
-    auto windowsAppRuntimeDllFilename{ std::wstring(frameworkPackageInfo->path) + L"\\Microsoft.WindowsAppRuntime.dll" };
+    auto windowsAppRuntimeDllFilename{ resolution.frameworkPackagePath + L"\\Microsoft.WindowsAppRuntime.dll" };
     wil::unique_hmodule windowsAppRuntimeDll(LoadLibraryEx(windowsAppRuntimeDllFilename.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH));
     if (!windowsAppRuntimeDll)
     {
@@ -92,14 +116,14 @@ STDAPI MddBootstrapInitialize(
     const auto lifetimeKind{ MddPackageDependencyLifetimeKind::Process };
     const MddCreatePackageDependencyOptions createOptions{};
     wil::unique_process_heap_string packageDependencyId;
-    THROW_IF_FAILED(MddTryCreatePackageDependency(nullptr, frameworkPackageInfo->packageFamilyName, minVersion, architectureFilter, lifetimeKind, nullptr, createOptions, &packageDependencyId));
+    THROW_IF_FAILED(MddTryCreatePackageDependency(nullptr, resolution.frameworkPackageFamilyName.c_str(), minVersion, architectureFilter, lifetimeKind, nullptr, createOptions, &packageDependencyId));
     //
     const MddAddPackageDependencyOptions addOptions{};
     MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext{};
     THROW_IF_FAILED(MddAddPackageDependency(packageDependencyId.get(), MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT, addOptions, &packageDependencyContext, nullptr));
 
     // Remove out temporary path addition
-    RemoveFrameworkFromPath(frameworkPackageInfo->path);
+    RemoveFrameworkFromPath(frameworkPackagePath);
     dllDirectoryCookie.reset();
 
     g_lifetimeManager = lifetimeManager.detach();
@@ -316,27 +340,90 @@ void CreateLifetimeManager(
     PACKAGE_VERSION minVersion,
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
     wil::unique_event& endTheLifetimeManagerEvent,
-    wil::unique_cotaskmem_string& ddlmPackageFullName)
+    MddBootstrap::DDLMResolution& resolution)
 {
-    if (IsLifetimeManagerViaEnumeration())
+    const auto criteria{ GetDDLMResolutionCriteria(majorMinorVersion, versionTag, minVersion, IsLifetimeManagerViaEnumeration()) };
+
+    // Finding the DDLM is expensive (enumerating packages or AppExtensions) so try the one we found last time
+    DDLMPackageCatalog catalog;
+    MddBootstrap::DDLMResolution cachedResolution;
+    if (LoadDDLMResolution(criteria, catalog, cachedResolution))
     {
-        CreateLifetimeManagerViaEnumeration(majorMinorVersion, versionTag, minVersion, endTheLifetimeManagerEvent, ddlmPackageFullName);
+        try
+        {
+            CreateLifetimeManagerForResolution(criteria, cachedResolution, lifetimeManager, endTheLifetimeManagerEvent);
+            resolution = std::move(cachedResolution);
+            return;
+        }
+        catch (...)
+        {
+            // Something changed we couldn't detect. Forget it and do it the hard way
+            LOG_CAUGHT_EXCEPTION();
+            DeleteDDLMResolution(criteria);
+        }
+    }
+
+    // Find the best fit DDLM. Note the catalog's stamp before we start so any
+    // change while we're looking invalidates what we find
+    MddBootstrap::DDLMResolution newResolution;
+    newResolution.catalogStamp = catalog.Stamp();
+    if (criteria.viaEnumeration)
+    {
+        FindDDLMViaEnumeration(majorMinorVersion, versionTag, minVersion, newResolution.ddlmPackageFamilyName, newResolution.ddlmPackageFullName);
+    }
+    else
+    {
+        const auto clsid{ FindDDLMViaAppExtension(majorMinorVersion, versionTag, minVersion) };
+        WCHAR clsidAsString[39]{};
+        FAIL_FAST_IF(StringFromGUID2(clsid, clsidAsString, ARRAYSIZE(clsidAsString)) == 0);
+        newResolution.ddlmClsid = clsidAsString;
+    }
+    CreateLifetimeManagerForResolution(criteria, newResolution, lifetimeManager, endTheLifetimeManagerEvent);
+
+    const PACKAGE_INFO* frameworkPackageInfo{};
+    auto packageInfoBuffer{ GetFrameworkPackageInfoForPackage(newResolution.ddlmPackageFullName.c_str(), frameworkPackageInfo) };
+    newResolution.frameworkPackageFamilyName = frameworkPackageInfo->packageFamilyName;
+    newResolution.frameworkPackageFullName = frameworkPackageInfo->packageFullName;
+    newResolution.frameworkPackagePath = frameworkPackageInfo->path;
+
+    SaveDDLMResolution(criteria, catalog, newResolution);
+    resolution = std::move(newResolution);
+}
+
+void CreateLifetimeManagerForResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::DDLMResolution& resolution,
+    wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
+    wil::unique_event& endTheLifetimeManagerEvent)
+{
+    if (criteria.viaEnumeration)
+    {
+        CreateLifetimeManagerViaEnumeration(resolution.ddlmPackageFamilyName.c_str(), resolution.ddlmPackageFullName.c_str(), endTheLifetimeManagerEvent);
     }
     else
     {
-        CreateLifetimeManagerViaAppExtension(majorMinorVersion, versionTag, minVersion, lifetimeManager, ddlmPackageFullName);
+        CLSID clsid{};
+        THROW_IF_FAILED_MSG(IIDFromString(resolution.ddlmClsid.c_str(), &clsid), "%ls", resolution.ddlmClsid.c_str());
+
+        wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager> appExtensionLifetimeManager;
+        wil::unique_cotaskmem_string packageFullName;
+        CreateLifetimeManagerViaAppExtension(clsid, appExtensionLifetimeManager, packageFullName);
+
+        // A previously found CLSID must still be served by the same DDLM package
+        THROW_HR_IF_MSG(E_UNEXPECTED, !resolution.ddlmPackageFullName.empty() &&
+                                      (CompareStringOrdinal(resolution.ddlmPackageFullName.c_str(), -1, packageFullName.get(), -1, TRUE) != CSTR_EQUAL),
+                        "CLSID:%ls Expected:%ls Actual:%ls", resolution.ddlmClsid.c_str(), resolution.ddlmPackageFullName.c_str(), packageFullName.get());
+
+        lifetimeManager = std::move(appExtensionLifetimeManager);
+        resolution.ddlmPackageFullName = packageFullName.get();
     }
 }
 
 void CreateLifetimeManagerViaAppExtension(
-    UINT32 majorMinorVersion,
-    PCWSTR versionTag,
-    PACKAGE_VERSION minVersion,
+    const CLSID& appDynamicDependencyLifetimeManagerClsid,
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager>& lifetimeManager,
     wil::unique_cotaskmem_string& ddlmPackageFullName)
 {
-    const auto appDynamicDependencyLifetimeManagerClsid{ FindDDLMViaAppExtension(majorMinorVersion, versionTag, minVersion) };
-
     wil::com_ptr_nothrow<IDynamicDependencyLifetimeManager> dynamicDependencyLifetimeManager{
         wil::CoCreateInstance<IDynamicDependencyLifetimeManager>(appDynamicDependencyLifetimeManagerClsid, CLSCTX_LOCAL_SERVER)
     };
@@ -351,29 +438,23 @@ void CreateLifetimeManagerViaAppExtension(
 }
 
 void CreateLifetimeManagerViaEnumeration(
-    UINT32 majorMinorVersion,
-    PCWSTR versionTag,
-    PACKAGE_VERSION minVersion,
-    wil::unique_event& endTheLifetimeManagerEvent,
-    wil::unique_cotaskmem_string& ddlmPackageFullName)
+    PCWSTR ddlmPackageFamilyName,
+    PCWSTR ddlmPackageFullName,
+    wil::unique_event& endTheLifetimeManagerEvent)
 {
-    std::wstring packageFamilyName;
-    std::wstring packageFullName;
-    FindDDLMViaEnumeration(majorMinorVersion, versionTag, minVersion, packageFamilyName, packageFullName);
-
     // Create the named event used later to signal to the lifetime manager it's time to quit
     // The named event has the syntax: "<processid>;<packagefullname>;<uniqueid>"
     GUID uniqueId{};
     THROW_IF_FAILED(CoCreateGuid(&uniqueId));
     const auto c_uniqueIdAsString{ winrt::to_hstring(uniqueId) };
-    auto eventName{ wil::str_printf<wil::unique_cotaskmem_string>(L"%u;%s;%s", GetCurrentProcessId(), packageFullName.c_str(), c_uniqueIdAsString.c_str()) };
+    auto eventName{ wil::str_printf<wil::unique_cotaskmem_string>(L"%u;%s;%s", GetCurrentProcessId(), ddlmPackageFullName, c_uniqueIdAsString.c_str()) };
     wil::unique_event event;
     event.create(wil::EventOptions::ManualReset, eventName.get());
 
     WCHAR lifetimeManagerApplicationUserModelId[APPLICATION_USER_MODEL_ID_MAX_LENGTH]{};
     uint32_t lifetimeManagerApplicationUserModelIdLength{ ARRAYSIZE(lifetimeManagerApplicationUserModelId) };
     PCWSTR c_packageRelativeApplicationId{ L"DDLM" };
-    THROW_IF_WIN32_ERROR(FormatApplicationUserModelId(packageFamilyName.c_str(), c_packageRelativeApplicationId, &lifetimeManagerApplicationUserModelIdLength, lifetimeManagerApplicationUserModelId));
+    THROW_IF_WIN32_ERROR(FormatApplicationUserModelId(ddlmPackageFamilyName, c_packageRelativeApplicationId, &lifetimeManagerApplicationUserModelIdLength, lifetimeManagerApplicationUserModelId));
 
     wil::com_ptr_nothrow<IApplicationActivationManager> aam{
         wil::CoCreateInstance<IApplicationActivationManager>(CLSID_ApplicationActivationManager, CLSCTX_INPROC_SERVER)
@@ -384,7 +465,6 @@ void CreateLifetimeManagerViaEnumeration(
     THROW_IF_FAILED(aam->ActivateApplication(lifetimeManagerApplicationUserModelId, arguments, c_options, &processId));
 
     endTheLifetimeManagerEvent = std::move(event);
-    ddlmPackageFullName = wil::make_cotaskmem_string(packageFullName.c_str());
 }
 
 CLSID FindDDLMViaAppExtension(
@@ -683,3 +763,142 @@ CLSID GetClsid(const winrt::Windows::ApplicationModel::AppExtensions::AppExtensi
     THROW_IF_WIN32_ERROR(UuidFromStringW(textRpcString, &clsid));
     return clsid;
 }
+
+MddBootstrap::DDLMResolutionCriteria GetDDLMResolutionCriteria(
+    UINT32 majorMinorVersion,
+    PCWSTR versionTag,
+    PACKAGE_VERSION minVersion,
+    bool viaEnumeration)
+{
+    MddBootstrap::DDLMResolutionCriteria criteria;
+    criteria.majorMinorVersion = majorMinorVersion;
+    criteria.versionTag = (!versionTag ? L"" : versionTag);
+    criteria.minVersion = minVersion.Version;
+    criteria.architecture = static_cast<uint32_t>(AppModel::Identity::GetCurrentArchitecture());
+    criteria.viaEnumeration = viaEnumeration;
+    criteria.ddlmPackageNamePrefix = g_test_ddlmPackageNamePrefix;
+    criteria.ddlmPackagePublisherId = g_test_ddlmPackagePublisherId;
+    return criteria;
+}
+
+// Persisted DDLM resolutions are stored per-user in the registry, one REG_SZ value per criteria
+static PCWSTR c_ddlmResolutionCacheKey{ L"Software\\Microsoft\\WindowsAppRuntime\\DDLMResolutionCache" };
+
+bool LoadDDLMResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::IDDLMPackageCatalog& catalog,
+    MddBootstrap::DDLMResolution& resolution)
+{
+    try
+    {
+        const auto valueName{ criteria.ToString() };
+        DWORD size{};
+        auto rc{ RegGetValueW(HKEY_CURRENT_USER, c_ddlmResolutionCacheKey, valueName.c_str(), RRF_RT_REG_SZ, nullptr, nullptr, &size) };
+        if (rc == ERROR_SUCCESS)
+        {
+            std::wstring text(size / sizeof(WCHAR), L'\0');
+            rc = RegGetValueW(HKEY_CURRENT_USER, c_ddlmResolutionCacheKey, valueName.c_str(), RRF_RT_REG_SZ, nullptr, text.data(), &size);
+            if (rc == ERROR_SUCCESS)
+            {
+                text.resize(wcslen(text.c_str()));
+                return MddBootstrap::DDLMResolutionCache::Deserialize(text, resolution) &&
+                       MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog);
+            }
+        }
+        if (rc != ERROR_FILE_NOT_FOUND)
+        {
+            (void)LOG_WIN32_MSG(rc, "DDLMResolutionCache: %ls", valueName.c_str());
+        }
+    }
+    CATCH_LOG();
+    return false;
+}
+
+void SaveDDLMResolution(
+    const MddBootstrap::DDLMResolutionCriteria& criteria,
+    MddBootstrap::IDDLMPackageCatalog& catalog,
+    MddBootstrap::DDLMResolution& resolution)
+{
+    try
+    {
+        // Best effort. If we can't remember it we'll just have to find it again next time
+        if (!catalog.TryGetPackagePath(resolution.ddlmPackageFullName, resolution.ddlmPackagePath))
+        {
+            return;
+        }
+        const auto valueName{ criteria.ToString() };
+        const auto text{ MddBootstrap::DDLMResolutionCache::Serialize(resolution) };
+        const auto size{ static_cast<DWORD>((text.length() + 1) * sizeof(WCHAR)) };
+        (void)LOG_IF_WIN32_ERROR_MSG(RegSetKeyValueW(HKEY_CURRENT_USER, c_ddlmResolutionCacheKey, valueName.c_str(), REG_SZ, text.c_str(), size),
+                               "DDLMResolutionCache: %ls", valueName.c_str());
+    }
+    CATCH_LOG();
+}
+
+void DeleteDDLMResolution(const MddBootstrap::DDLMResolutionCriteria& criteria)
+{
+    try
+    {
+        const auto valueName{ criteria.ToString() };
+        const auto rc{ RegDeleteKeyValueW(HKEY_CURRENT_USER, c_ddlmResolutionCacheKey, valueName.c_str()) };
+        if ((rc != ERROR_SUCCESS) && (rc != ERROR_FILE_NOT_FOUND))
+        {
+            (void)LOG_WIN32_MSG(rc, "DDLMResolutionCache: %ls", valueName.c_str());
+        }
+    }
+    CATCH_LOG();
+}
+
+uint64_t DDLMPackageCatalog::Stamp()
+{
+    // Registering (or unregistering) a package for the user adds (or removes) a subkey
+    // under the user's package repository key, which updates the key's last write time
+    PCWSTR c_packageRepositoryKey{ L"Software\\Classes\\Local Settings\\Software\\Microsoft\\Windows\\CurrentVersion\\AppModel\\Repository\\Packages" };
+    wil::unique_hkey key;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, c_packageRepositoryKey, 0, KEY_QUERY_VALUE, &key) != ERROR_SUCCESS)
+    {
+        return 0;
+    }
+    FILETIME lastWriteTime{};
+    if (RegQueryInfoKeyW(key.get(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &lastWriteTime) != ERROR_SUCCESS)
+    {
+        return 0;
+    }
+    return (static_cast<uint64_t>(lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime;
+}
+
+bool DDLMPackageCatalog::TryGetPackagePath(const std::wstring& packageFullName, std::wstring& packagePath)
+{
+    uint32_t packagePathLength{};
+    auto rc{ GetPackagePathByFullName(packageFullName.c_str(), &packagePathLength, nullptr) };
+    if (rc != ERROR_INSUFFICIENT_BUFFER)
+    {
+        return false;
+    }
+    std::wstring path(packagePathLength, L'\0');
+    rc = GetPackagePathByFullName(packageFullName.c_str(), &packagePathLength, path.data());
+    if (rc != ERROR_SUCCESS)
+    {
+        return false;
+    }
+    path.resize(wcslen(path.c_str()));
+    packagePath = std::move(path);
+    return true;
+}
+
+bool DDLMPackageCatalog::IsPackageStatusOK(const std::wstring& packageFullName, const std::wstring& packagePath)
+{
+    // PackageManager.FindPackageForUser().Status is a full package query, which costs more than the
+    // cache saves. The resolution's packages passed that check when the resolution was made and the
+    // catalog stamp says nothing was registered or unregistered since, so it's enough to verify the
+    // package is still registered for the user and its content is still present (e.g. its volume
+    // isn't offline). Anything subtler fails creating the lifetime manager and we search the hard way
+    wil::unique_package_info_reference packageInfoReference;
+    if (OpenPackageInfoByFullName(packageFullName.c_str(), 0, &packageInfoReference) != ERROR_SUCCESS)
+    {
+        return false;
+    }
+    const auto manifest{ std::filesystem::path(packagePath) / L"AppxManifest.xml" };
+    const auto attributes{ GetFileAttributesW(manifest.c_str()) };
+    return (attributes != INVALID_FILE_ATTRIBUTES) && !WI_IsFlagSet(attributes, FILE_ATTRIBUTE_DIRECTORY);
+}
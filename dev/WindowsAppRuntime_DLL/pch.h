@@ -18,6 +18,7 @@
 #include <thread>
 #include <mutex>
 #include <list>
+#include <algorithm>
 #include <stdexcept>
 #include <regex>
 #include <filesystem>
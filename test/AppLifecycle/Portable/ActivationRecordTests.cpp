@@ -0,0 +1,327 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ActivationRecord.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+
+using AppLifecycleCore::ActivationRecord;
+using AppLifecycleCore::ActivationRecordKind;
+
+namespace
+{
+    std::u16string Widen(const char* value)
+    {
+        std::u16string result;
+        for (; *value != '\0'; ++value)
+        {
+            result.push_back(static_cast<char16_t>(static_cast<unsigned char>(*value)));
+        }
+        return result;
+    }
+
+    ActivationRecord MakeRecord(ActivationRecordKind kind, std::u16string value)
+    {
+        ActivationRecord record;
+        record.kind = kind;
+        record.value = std::move(value);
+        return record;
+    }
+
+    ActivationRecord MakeFileRecord(std::u16string verb, std::vector<std::u16string> files)
+    {
+        ActivationRecord record;
+        record.kind = ActivationRecordKind::File;
+        record.verb = std::move(verb);
+        record.files = std::move(files);
+        return record;
+    }
+
+    std::vector<uint8_t> Encode(const ActivationRecord& record)
+    {
+        std::vector<uint8_t> buffer;
+        AppLifecycleCore::AppendActivationRecord(record, buffer);
+        return buffer;
+    }
+
+    bool Decode(const std::vector<uint8_t>& buffer, ActivationRecord& record)
+    {
+        return AppLifecycleCore::TryReadActivationRecord(buffer.data(), buffer.size(), record);
+    }
+
+    // What redirected activations usually carry
+    std::vector<ActivationRecord> SampleRecords()
+    {
+        std::u16string awkward{ u"a&b=c%20d?e#f " };
+        awkward.push_back(u'\0');
+        awkward += u"\u00e9\u4e2d\xd83d\xde00";
+        awkward.push_back(static_cast<char16_t>(0xDC00));   // Unpaired surrogates go through unchanged
+
+        return {
+            MakeRecord(ActivationRecordKind::Launch, u""),
+            MakeRecord(ActivationRecordKind::Launch, Widen("--profile \"C:\\Users\\someone\\My Documents\" -n 3")),
+            MakeRecord(ActivationRecordKind::Launch, awkward),
+            MakeRecord(ActivationRecordKind::Protocol, Widen("my-app://open?item=42&view=full")),
+            MakeRecord(ActivationRecordKind::StartupTask, Widen("StartupTaskId")),
+            MakeFileRecord(Widen("open"), { Widen("C:\\Users\\someone\\Documents\\Report (final).docx") }),
+            MakeFileRecord(Widen("edit"), {}),
+            MakeFileRecord(u"", { u"", awkward, Widen("D:\\a.txt"), Widen("D:\\b.txt") }),
+        };
+    }
+}
+
+PORTABLE_TEST(ActivationRecord_RoundTrips)
+{
+    for (const auto& record : SampleRecords())
+    {
+        const auto buffer{ Encode(record) };
+        ActivationRecord decoded;
+        PORTABLE_VERIFY(Decode(buffer, decoded));
+        PORTABLE_VERIFY(decoded == record);
+
+        // Appends after whatever's already there
+        std::vector<uint8_t> prefixed{ 0xAB };
+        AppLifecycleCore::AppendActivationRecord(record, prefixed);
+        PORTABLE_VERIFY_ARE_EQUAL(buffer.size() + 1, prefixed.size());
+        PORTABLE_VERIFY(AppLifecycleCore::TryReadActivationRecord(prefixed.data() + 1, prefixed.size() - 1, decoded));
+        PORTABLE_VERIFY(decoded == record);
+    }
+
+    // Only what the kind carries is written
+    auto launch{ MakeRecord(ActivationRecordKind::Launch, u"x") };
+    launch.verb = u"ignored";
+    launch.files.push_back(u"ignored");
+    ActivationRecord decoded;
+    PORTABLE_VERIFY(Decode(Encode(launch), decoded));
+    PORTABLE_VERIFY(decoded == MakeRecord(ActivationRecordKind::Launch, u"x"));
+}
+
+PORTABLE_TEST(ActivationRecord_RejectsMalformed)
+{
+    for (const auto& record : SampleRecords())
+    {
+        const auto buffer{ Encode(record) };
+        ActivationRecord decoded;
+
+        // Truncated anywhere
+        for (size_t size=0; size < buffer.size(); ++size)
+        {
+            PORTABLE_VERIFY(!AppLifecycleCore::TryReadActivationRecord(buffer.data(), size, decoded));
+        }
+
+        // Trailing bytes
+        auto extended{ buffer };
+        extended.push_back(0);
+        PORTABLE_VERIFY(!Decode(extended, decoded));
+    }
+
+    const auto buffer{ Encode(MakeRecord(ActivationRecordKind::Launch, u"args")) };
+    ActivationRecord decoded;
+    auto bad{ buffer };
+    bad[0] ^= 1;                                        // Magic
+    PORTABLE_VERIFY(!Decode(bad, decoded));
+    bad = buffer;
+    bad[4] = AppLifecycleCore::c_activationRecordVersion + 1;
+    PORTABLE_VERIFY(!Decode(bad, decoded));
+    for (uint8_t kind : { 0, 5, 0xFF })
+    {
+        bad = buffer;
+        bad[6] = kind;
+        PORTABLE_VERIFY(!Decode(bad, decoded));
+    }
+
+    // Lengths and counts that run past the end don't allocate what they claim
+    bad = buffer;
+    bad[8] = bad[9] = bad[10] = bad[11] = 0xFF;
+    PORTABLE_VERIFY(!Decode(bad, decoded));
+    auto files{ Encode(MakeFileRecord(u"v", { u"f" })) };
+    files[14] = files[15] = files[16] = files[17] = 0xFF;
+    PORTABLE_VERIFY(!Decode(files, decoded));
+
+    // A failed read leaves the record alone
+    decoded = MakeRecord(ActivationRecordKind::Protocol, u"unchanged");
+    PORTABLE_VERIFY(!Decode(bad, decoded));
+    PORTABLE_VERIFY(decoded == MakeRecord(ActivationRecordKind::Protocol, u"unchanged"));
+}
+
+PORTABLE_TEST(ActivationRecord_Fuzz)
+{
+    // Whatever the bytes, reading never runs off the buffer (run under a sanitizer to be sure)
+    // and anything accepted is exactly what it decodes to
+    std::mt19937 random{ 0x5EED };
+    const auto samples{ SampleRecords() };
+    std::vector<std::vector<uint8_t>> seeds;
+    for (const auto& record : samples)
+    {
+        seeds.push_back(Encode(record));
+    }
+
+    size_t accepted{};
+    for (uint32_t iteration=0; iteration < 200000; ++iteration)
+    {
+        auto buffer{ seeds[random() % seeds.size()] };
+        switch (random() % 4)
+        {
+        case 0:
+            // Flip some bits
+            for (uint32_t count=1 + random() % 4; count > 0; --count)
+            {
+                buffer[random() % buffer.size()] ^= static_cast<uint8_t>(1u << (random() % 8));
+            }
+            break;
+        case 1:
+            // Overwrite a (little endian) length or count with something near the end
+            if (buffer.size() >= 12)
+            {
+                const size_t offset{ 8 + (random() % ((buffer.size() - 8) / 2)) * 2 };
+                const uint32_t value{ static_cast<uint32_t>(random() % 64) };
+                for (size_t index=0; (index < 4) && (offset + index < buffer.size()); ++index)
+                {
+                    buffer[offset + index] = static_cast<uint8_t>(value >> (8 * index));
+                }
+            }
+            break;
+        case 2:
+            buffer.resize(random() % (buffer.size() + 8), static_cast<uint8_t>(random()));
+            break;
+        default:
+            // Anything at all, behind a valid header
+            buffer.resize(8 + random() % 64);
+            for (size_t index=8; index < buffer.size(); ++index)
+            {
+                buffer[index] = static_cast<uint8_t>(random());
+            }
+            break;
+        }
+
+        ActivationRecord decoded;
+        if (Decode(buffer, decoded))
+        {
+            ++accepted;
+            PORTABLE_VERIFY(Encode(decoded) == buffer);
+        }
+    }
+    PORTABLE_VERIFY(accepted > 0);
+}
+
+PORTABLE_BENCHMARK(ActivationRecord_Benchmark)
+{
+    // Against a stand in for the encoded launch Uri: the fields percent-escaped (as UTF-8)
+    // into a query string, then found and unescaped again. It leaves out creating and
+    // parsing the Uri objects, so flatters the Uri.
+    auto escape = [](const std::u16string& value, std::string& out) {
+        static const char c_hex[]{ "0123456789ABCDEF" };
+        for (char16_t ch : value)
+        {
+            if (((ch >= u'a') && (ch <= u'z')) || ((ch >= u'A') && (ch <= u'Z')) || ((ch >= u'0') && (ch <= u'9')) ||
+                (ch == u'-') || (ch == u'.') || (ch == u'_') || (ch == u'~'))
+            {
+                out.push_back(static_cast<char>(ch));
+                continue;
+            }
+            uint8_t utf8[3];
+            size_t count{};
+            if (ch < 0x80)
+            {
+                utf8[count++] = static_cast<uint8_t>(ch);
+            }
+            else if (ch < 0x800)
+            {
+                utf8[count++] = static_cast<uint8_t>(0xC0 | (ch >> 6));
+                utf8[count++] = static_cast<uint8_t>(0x80 | (ch & 0x3F));
+            }
+            else
+            {
+                utf8[count++] = static_cast<uint8_t>(0xE0 | (ch >> 12));
+                utf8[count++] = static_cast<uint8_t>(0x80 | ((ch >> 6) & 0x3F));
+                utf8[count++] = static_cast<uint8_t>(0x80 | (ch & 0x3F));
+            }
+            for (size_t index=0; index < count; ++index)
+            {
+                out.push_back('%');
+                out.push_back(c_hex[utf8[index] >> 4]);
+                out.push_back(c_hex[utf8[index] & 0xF]);
+            }
+        }
+    };
+    auto unescape = [](const std::string& query, size_t start, size_t end) {
+        auto hex = [](char ch) { return (ch <= '9') ? (ch - '0') : (ch - 'A' + 10); };
+        std::u16string result;
+        for (size_t index=start; index < end; ++index)
+        {
+            if (query[index] != '%')
+            {
+                result.push_back(static_cast<char16_t>(query[index]));
+                continue;
+            }
+            uint32_t byte{ static_cast<uint32_t>((hex(query[index + 1]) << 4) | hex(query[index + 2])) };
+            index += 2;
+            if (byte >= 0xE0)
+            {
+                byte = ((byte & 0xF) << 12) | ((((hex(query[index + 2]) << 4) | hex(query[index + 3])) & 0x3F) << 6) |
+                       (((hex(query[index + 5]) << 4) | hex(query[index + 6])) & 0x3F);
+                index += 6;
+            }
+            else if (byte >= 0xC0)
+            {
+                byte = ((byte & 0x1F) << 6) | (((hex(query[index + 2]) << 4) | hex(query[index + 3])) & 0x3F);
+                index += 3;
+            }
+            result.push_back(static_cast<char16_t>(byte));
+        }
+        return result;
+    };
+
+    struct Case
+    {
+        const char* name;
+        ActivationRecord record;
+    };
+    std::u16string longPath{ Widen("C:\\Users\\someone\\Documents\\Projects\\Quarterly Reports\\2024\\") };
+    longPath += u"R\u00e9sum\u00e9 \u2014 final (3).docx";
+    const Case c_cases[]{
+        { "launch", MakeRecord(ActivationRecordKind::Launch, Widen("--profile \"C:\\Users\\someone\\My Documents\" -n 3")) },
+        { "protocol", MakeRecord(ActivationRecordKind::Protocol, Widen("my-app://open?item=42&view=full&from=notification")) },
+        { "file", MakeFileRecord(Widen("open"), { longPath }) },
+    };
+
+    constexpr size_t c_iterations{ 100000 };
+    for (const auto& testCase : c_cases)
+    {
+        const auto& record{ testCase.record };
+        std::vector<uint8_t> buffer;
+        auto samples{ Test::Perf::Measure(c_iterations, [&](size_t) {
+            buffer.clear();
+            AppLifecycleCore::AppendActivationRecord(record, buffer);
+            ActivationRecord decoded;
+            PORTABLE_VERIFY(Decode(buffer, decoded));
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson((std::string("activationrecord.") + testCase.name).c_str(), buffer.size(), 1, samples).c_str());
+
+        const bool isFile{ record.kind == ActivationRecordKind::File };
+        std::string uri;
+        samples = Test::Perf::Measure(c_iterations, [&](size_t) {
+            uri = "ms-encodedlaunch:App/?ContractId=Windows.Launch";
+            uri += isFile ? "&Verb=" : "&Arguments=";
+            escape(isFile ? record.verb : record.value, uri);
+            if (isFile)
+            {
+                uri += "&File=";
+                escape(record.files.front(), uri);
+            }
+
+            const auto field{ uri.rfind('=') + 1 };
+            const auto decoded{ unescape(uri, field, uri.size()) };
+            PORTABLE_VERIFY(decoded == (isFile ? record.files.front() : record.value));
+        });
+        std::printf("%s\n", Test::Perf::ToJson((std::string("activationrecord.") + testCase.name + ".baseline").c_str(), uri.size(), 1, samples).c_str());
+    }
+}
@@ -0,0 +1,348 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RedirectionChannel.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+#include "SharedRegion.h"
+
+using AppLifecycleCore::RedirectionChannel;
+
+namespace
+{
+    // Not a process anyone's running
+    constexpr uint32_t c_deadProcessId{ 0x7FFFFFF0 };
+
+    // Payloads say who sent them and can be checked for damage
+    std::vector<uint8_t> MakePayload(uint32_t sender, uint32_t sequence, size_t size)
+    {
+        std::vector<uint8_t> payload(std::max<size_t>(size, 8));
+        std::memcpy(payload.data(), &sender, sizeof(sender));
+        std::memcpy(payload.data() + 4, &sequence, sizeof(sequence));
+        for (size_t index=8; index < payload.size(); ++index)
+        {
+            payload[index] = static_cast<uint8_t>(sender * 31 + sequence * 7 + index);
+        }
+        return payload;
+    }
+
+    bool IsValid(const RedirectionChannel::Request& request, uint32_t& sender, uint32_t& sequence)
+    {
+        if (request.size < 8)
+        {
+            return false;
+        }
+        std::memcpy(&sender, request.payload, sizeof(sender));
+        std::memcpy(&sequence, request.payload + 4, sizeof(sequence));
+        return MakePayload(sender, sequence, request.size) == std::vector<uint8_t>(request.payload, request.payload + request.size);
+    }
+
+    // Payload sizes seen when redirecting: a launch, a few files, lots of files
+    size_t PayloadSize(uint32_t sequence)
+    {
+        const size_t c_sizes[]{ 200, 1500, 24 * 1024 };
+        return c_sizes[sequence % 3];
+    }
+
+    // Send itemsPerSender requests one at a time, waiting for each to complete as
+    // AppInstance::RedirectActivationToAsync does
+    int Send(void* region, size_t size, uint32_t sender, uint32_t itemsPerSender)
+    {
+        RedirectionChannel channel;
+        if (!channel.Attach(region, size))
+        {
+            return 1;
+        }
+        for (uint32_t sequence=0; sequence < itemsPerSender; ++sequence)
+        {
+            const auto payload{ MakePayload(sender, sequence, PayloadSize(sequence)) };
+            RedirectionChannel::Ticket ticket;
+            while (!(ticket = channel.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId())))
+            {
+                std::this_thread::yield();
+            }
+            while (!channel.IsCompleted(ticket))
+            {
+                std::this_thread::yield();
+            }
+        }
+        return 0;
+    }
+
+    // Receive (in batches) and complete requests until every sender's are in, checking they
+    // arrive intact, once and in each sender's order
+    void Receive(RedirectionChannel& channel, uint32_t senderCount, uint32_t itemsPerSender, size_t batchSize)
+    {
+        std::vector<uint32_t> next(senderCount);
+        uint64_t remaining{ static_cast<uint64_t>(senderCount) * itemsPerSender };
+        const auto deadline{ std::chrono::steady_clock::now() + std::chrono::seconds(60) };
+        std::vector<RedirectionChannel::Request> requests;
+        while (remaining > 0)
+        {
+            requests.clear();
+            if (channel.Receive(requests, batchSize) == 0)
+            {
+                PORTABLE_VERIFY(std::chrono::steady_clock::now() < deadline);
+                std::this_thread::yield();
+                continue;
+            }
+            for (const auto& request : requests)
+            {
+                uint32_t sender{};
+                uint32_t sequence{};
+                PORTABLE_VERIFY(IsValid(request, sender, sequence));
+                PORTABLE_VERIFY(sender < senderCount);
+                PORTABLE_VERIFY_ARE_EQUAL(next[sender], sequence);
+                ++next[sender];
+                --remaining;
+                channel.Complete(request);
+            }
+        }
+    }
+
+    std::unique_ptr<Test::Shared::SharedRegion> MakeRegion()
+    {
+        return std::make_unique<Test::Shared::SharedRegion>(RedirectionChannel::RegionSize());
+    }
+}
+
+PORTABLE_TEST(RedirectionChannel_SendsAndCompletes)
+{
+    auto region{ MakeRegion() };
+    RedirectionChannel receiver;
+    RedirectionChannel sender;
+    PORTABLE_VERIFY(receiver.Attach(region->Get(), region->Size()));
+    PORTABLE_VERIFY(sender.Attach(region->Get(), region->Size()));
+
+    // Inline, overflow and by id, in order
+    const auto small{ MakePayload(1, 0, 100) };
+    const auto large{ MakePayload(1, 1, RedirectionChannel::c_inlineSlotSize + 1) };
+    const uint8_t id[16]{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    const auto smallTicket{ sender.TrySend(small.data(), small.size(), Test::Shared::CurrentProcessId()) };
+    const auto largeTicket{ sender.TrySend(large.data(), large.size(), Test::Shared::CurrentProcessId()) };
+    PORTABLE_VERIFY(!!smallTicket);
+    PORTABLE_VERIFY(!!largeTicket);
+    PORTABLE_VERIFY_ARE_EQUAL(RedirectionChannel::c_inlinePool, smallTicket.pool);
+    PORTABLE_VERIFY_ARE_EQUAL(RedirectionChannel::c_overflowPool, largeTicket.pool);
+    PORTABLE_VERIFY(sender.TrySendId(id, Test::Shared::CurrentProcessId()));
+    PORTABLE_VERIFY(!sender.IsCompleted(smallTicket));
+
+    // Too big for the channel
+    const auto tooLarge{ MakePayload(1, 2, RedirectionChannel::MaxPayloadSize() + 1) };
+    PORTABLE_VERIFY(!sender.TrySend(tooLarge.data(), tooLarge.size(), Test::Shared::CurrentProcessId()));
+
+    std::vector<RedirectionChannel::Request> requests;
+    PORTABLE_VERIFY_ARE_EQUAL(3u, receiver.Receive(requests, 16));
+    uint32_t senderId{};
+    uint32_t sequence{};
+    PORTABLE_VERIFY(IsValid(requests[0], senderId, sequence));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, sequence);
+    PORTABLE_VERIFY(IsValid(requests[1], senderId, sequence));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, sequence);
+    PORTABLE_VERIFY(requests[2].HasId());
+    PORTABLE_VERIFY(std::memcmp(id, requests[2].id, sizeof(id)) == 0);
+
+    const auto completions{ sender.CompletionCount() };
+    receiver.Complete(requests[1]);
+    PORTABLE_VERIFY(sender.IsCompleted(largeTicket));
+    PORTABLE_VERIFY(!sender.IsCompleted(smallTicket));
+    receiver.Complete(requests[0]);
+    receiver.Complete(requests[2]);
+    PORTABLE_VERIFY(sender.IsCompleted(smallTicket));
+    PORTABLE_VERIFY_ARE_EQUAL(completions + 3, sender.CompletionCount());
+
+    requests.clear();
+    PORTABLE_VERIFY_ARE_EQUAL(0u, receiver.Receive(requests, 16));
+
+    // Slots are reused once completed
+    for (uint32_t index=0; index < 1000; ++index)
+    {
+        const auto payload{ MakePayload(2, index, PayloadSize(index)) };
+        const auto ticket{ sender.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId()) };
+        PORTABLE_VERIFY(!!ticket);
+        requests.clear();
+        PORTABLE_VERIFY_ARE_EQUAL(1u, receiver.Receive(requests, 16));
+        PORTABLE_VERIFY(IsValid(requests[0], senderId, sequence));
+        PORTABLE_VERIFY_ARE_EQUAL(index, sequence);
+        receiver.Complete(requests[0]);
+        PORTABLE_VERIFY(sender.IsCompleted(ticket));
+    }
+}
+
+PORTABLE_TEST(RedirectionChannel_ReceivesInBatches)
+{
+    auto region{ MakeRegion() };
+    RedirectionChannel channel;
+    PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+
+    for (uint32_t index=0; index < 40; ++index)
+    {
+        const auto payload{ MakePayload(0, index, 64) };
+        PORTABLE_VERIFY(!!channel.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId()));
+    }
+
+    std::vector<RedirectionChannel::Request> requests;
+    PORTABLE_VERIFY_ARE_EQUAL(16u, channel.Receive(requests, 16));
+    PORTABLE_VERIFY_ARE_EQUAL(16u, channel.Receive(requests, 16));
+    PORTABLE_VERIFY_ARE_EQUAL(8u, channel.Receive(requests, 16));
+    PORTABLE_VERIFY_ARE_EQUAL(40u, requests.size());
+    for (uint32_t index=0; index < 40; ++index)
+    {
+        uint32_t sender{};
+        uint32_t sequence{};
+        PORTABLE_VERIFY(IsValid(requests[index], sender, sequence));
+        PORTABLE_VERIFY_ARE_EQUAL(index, sequence);
+        channel.Complete(requests[index]);
+    }
+}
+
+PORTABLE_TEST(RedirectionChannel_RunsOutOfSlots)
+{
+    auto region{ MakeRegion() };
+    RedirectionChannel channel;
+    PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+
+    // Small payloads spill into the overflow slots, and then there's no more room
+    const auto payload{ MakePayload(0, 0, 64) };
+    std::vector<RedirectionChannel::Ticket> tickets;
+    for (uint32_t index=0; index < RedirectionChannel::c_inlineSlotCount + RedirectionChannel::c_overflowSlotCount; ++index)
+    {
+        tickets.push_back(channel.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId()));
+        PORTABLE_VERIFY(!!tickets.back());
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(RedirectionChannel::c_overflowPool, tickets.back().pool);
+    PORTABLE_VERIFY(!channel.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId()));
+
+    // Ids don't need a slot
+    const uint8_t id[16]{};
+    PORTABLE_VERIFY(channel.TrySendId(id, Test::Shared::CurrentProcessId()));
+
+    std::vector<RedirectionChannel::Request> requests;
+    PORTABLE_VERIFY_ARE_EQUAL(1u, channel.Receive(requests, 1));
+    channel.Complete(requests[0]);
+    PORTABLE_VERIFY(!!channel.TrySend(payload.data(), payload.size(), Test::Shared::CurrentProcessId()));
+}
+
+PORTABLE_TEST(RedirectionChannel_ReclaimsSlotsOfDeadSenders)
+{
+    auto region{ MakeRegion() };
+    RedirectionChannel channel;
+    PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+
+    // Senders fill the channel and then die...
+    const auto payload{ MakePayload(0, 0, 64) };
+    for (uint32_t index=0; index < RedirectionChannel::c_inlineSlotCount + RedirectionChannel::c_overflowSlotCount; ++index)
+    {
+        PORTABLE_VERIFY(!!channel.TrySend(payload.data(), payload.size(), c_deadProcessId));
+    }
+    channel.SetIsProcessAlive([](uint32_t processId) { return processId != c_deadProcessId; });
+
+    // ...but their slots are taken back when needed, and the receiver skips what was taken
+    const auto live{ MakePayload(1, 7, 64) };
+    PORTABLE_VERIFY(!!channel.TrySend(live.data(), live.size(), Test::Shared::CurrentProcessId()));
+    std::vector<RedirectionChannel::Request> requests;
+    PORTABLE_VERIFY_ARE_EQUAL(RedirectionChannel::c_inlineSlotCount + RedirectionChannel::c_overflowSlotCount, channel.Receive(requests, 1000));
+    uint32_t sender{};
+    uint32_t sequence{};
+    PORTABLE_VERIFY(IsValid(requests.back(), sender, sequence));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, sender);
+    PORTABLE_VERIFY_ARE_EQUAL(7u, sequence);
+}
+
+PORTABLE_TEST(RedirectionChannel_SharesLayout)
+{
+    auto region{ MakeRegion() };
+    RedirectionChannel channel;
+    PORTABLE_VERIFY(!channel.Attach(region->Get(), RedirectionChannel::RegionSize() - 1));
+    PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+
+    // Something else stamped the region first
+    auto other{ MakeRegion() };
+    static_cast<std::atomic<uint64_t>*>(other->Get())->store(1);
+    PORTABLE_VERIFY(!channel.Attach(other->Get(), other->Size()));
+}
+
+PORTABLE_TEST(RedirectionChannel_ManySenderProcesses)
+{
+    constexpr uint32_t c_senders{ 12 };
+    constexpr uint32_t c_itemsPerSender{ 2000 };
+    auto region{ MakeRegion() };
+    RedirectionChannel channel;
+    PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+    channel.SetIsProcessAlive(&Test::Shared::IsProcessAlive);
+
+    const int failed{ Test::Shared::RunProcesses(c_senders,
+        [&](int index) { return Send(region->Get(), region->Size(), static_cast<uint32_t>(index), c_itemsPerSender); },
+        [&]() { Receive(channel, c_senders, c_itemsPerSender, 16); }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+    PORTABLE_VERIFY_ARE_EQUAL(0u, channel.AbandonedCount());
+}
+
+PORTABLE_BENCHMARK(RedirectionChannel_Benchmark)
+{
+    // Cost of getting one request's payload across: through the channel, or in a mapping of
+    // its own created by the sender and opened by the receiver (what every request used to do)
+    for (size_t size : { 256, 1500, 24 * 1024 })
+    {
+        constexpr size_t c_iterations{ 2000 };
+        auto region{ MakeRegion() };
+        RedirectionChannel channel;
+        PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+        const auto payload{ MakePayload(0, 0, size) };
+        std::vector<RedirectionChannel::Request> requests;
+
+        auto samples{ Test::Perf::Measure(c_iterations, [&](size_t) {
+            const auto ticket{ channel.TrySend(payload.data(), payload.size(), 1000) };
+            requests.clear();
+            channel.Receive(requests, 16);
+            channel.Complete(requests[0]);
+            (void)channel.IsCompleted(ticket);
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("redirectionchannel.roundtrip", size, 1, samples).c_str());
+
+        samples = Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+            const std::string name{ "request-" + std::to_string(iteration) };
+            Test::Shared::SharedRegion sent(name, payload.size());
+            std::memcpy(sent.Get(), payload.data(), payload.size());
+            Test::Shared::SharedRegion received(name, payload.size());
+            PORTABLE_VERIFY(std::memcmp(received.Get(), payload.data(), payload.size()) == 0);
+        });
+        std::printf("%s\n", Test::Perf::ToJson("redirectionchannel.roundtrip.baseline", size, 1, samples).c_str());
+    }
+
+    // Throughput with senders in separate processes (where possible), each waiting for its
+    // requests to complete, and the receiver draining in batches
+    for (int senders : { 1, 4, 16 })
+    {
+        constexpr uint32_t c_itemsPerSender{ 3000 };
+        auto region{ MakeRegion() };
+        RedirectionChannel channel;
+        PORTABLE_VERIFY(channel.Attach(region->Get(), region->Size()));
+
+        const auto start{ std::chrono::steady_clock::now() };
+        Test::Shared::RunProcesses(senders,
+            [&](int index) { return Send(region->Get(), region->Size(), static_cast<uint32_t>(index), c_itemsPerSender); },
+            [&]() { Receive(channel, static_cast<uint32_t>(senders), c_itemsPerSender, 16); });
+        const auto elapsed{ std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() };
+
+        // One sample per request, at the mean, so throughput comes from wall time
+        Test::Perf::Samples samples;
+        const auto items{ static_cast<int64_t>(senders) * c_itemsPerSender };
+        for (int64_t index=0; index < items; ++index)
+        {
+            samples.Add(elapsed / items);
+        }
+        std::printf("%s\n", Test::Perf::ToJson("redirectionchannel.throughput", RedirectionChannel::c_queueCapacity, static_cast<size_t>(senders), samples, elapsed).c_str());
+    }
+}
@@ -0,0 +1,353 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SharedKeyDirectory.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+#include "SharedRegion.h"
+
+using AppLifecycleCore::SharedKeyDirectory;
+
+namespace
+{
+    constexpr uint64_t c_startTime{ 0x01DA0000'12345678 };
+
+    std::u16string MakeKey(const std::string& prefix, uint32_t index)
+    {
+        const auto narrow{ prefix + std::to_string(index) };
+        return std::u16string(narrow.begin(), narrow.end());
+    }
+
+    std::unique_ptr<Test::Shared::SharedRegion> MakeRegion()
+    {
+        return std::make_unique<Test::Shared::SharedRegion>(SharedKeyDirectory::RegionSize());
+    }
+
+    AppLifecycleCore::details::KeySlot* Slots(Test::Shared::SharedRegion& region)
+    {
+        return reinterpret_cast<AppLifecycleCore::details::KeySlot*>(
+            static_cast<uint8_t*>(region.Get()) + sizeof(AppLifecycleCore::details::SharedKeyDirectoryHeader));
+    }
+
+    // Every process publishes the shared keys (racing to add them) and some of its own
+    int PublishKeys(void* region, size_t size, uint32_t index, uint32_t sharedKeys, uint32_t ownKeys)
+    {
+        SharedKeyDirectory directory;
+        if (!directory.Attach(region, size))
+        {
+            return 1;
+        }
+        const auto owner{ SharedKeyDirectory::MakeOwner(Test::Shared::CurrentProcessId(), c_startTime + index) };
+        for (uint32_t key=0; key < sharedKeys; ++key)
+        {
+            if (!directory.Publish(MakeKey("shared-", key), owner))
+            {
+                return 1;
+            }
+        }
+        for (uint32_t key=0; key < ownKeys; ++key)
+        {
+            const auto ownKey{ MakeKey("process-" + std::to_string(index) + "-", key) };
+            if (!directory.Publish(ownKey, owner) || (directory.Find(ownKey) != owner))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Every process publishes, finds and withdraws keys of its own, many more than there are
+    // slots, while checking that other processes' keys are never found with the wrong owner
+    int ChurnKeys(void* region, size_t size, uint32_t index, uint32_t processes, uint32_t keys)
+    {
+        SharedKeyDirectory directory;
+        if (!directory.Attach(region, size))
+        {
+            return 1;
+        }
+        const auto owner{ SharedKeyDirectory::MakeOwner(Test::Shared::CurrentProcessId(), c_startTime + index) };
+        for (uint32_t key=0; key < keys; ++key)
+        {
+            const auto ownKey{ MakeKey("process-" + std::to_string(index) + "-", key) };
+            if (!directory.Publish(ownKey, owner) || (directory.Find(ownKey) != owner))
+            {
+                return 1;
+            }
+
+            const auto other{ (index + 1 + key) % processes };
+            const auto otherOwner{ directory.Find(MakeKey("process-" + std::to_string(other) + "-", key)) };
+            if ((otherOwner != 0) && (SharedKeyDirectory::GetStartTag(otherOwner) != SharedKeyDirectory::GetStartTag(SharedKeyDirectory::MakeOwner(0, c_startTime + other))))
+            {
+                return 2;
+            }
+
+            directory.Withdraw(ownKey, owner);
+            if (directory.Find(ownKey) != 0)
+            {
+                return 3;
+            }
+        }
+        return 0;
+    }
+}
+
+PORTABLE_TEST(SharedKeyDirectory_PublishesAndFinds)
+{
+    auto region{ MakeRegion() };
+    SharedKeyDirectory first;
+    SharedKeyDirectory second;
+    PORTABLE_VERIFY(first.Attach(region->Get(), region->Size()));
+    PORTABLE_VERIFY(second.Attach(region->Get(), region->Size()));
+
+    const auto owner1{ SharedKeyDirectory::MakeOwner(100, c_startTime) };
+    const auto owner2{ SharedKeyDirectory::MakeOwner(200, c_startTime) };
+    PORTABLE_VERIFY_ARE_EQUAL(0u, second.Find(u"C:\\docs\\a.txt"));
+    PORTABLE_VERIFY(first.Publish(u"C:\\docs\\a.txt", owner1));
+    PORTABLE_VERIFY(first.Publish(u"", owner2));
+    PORTABLE_VERIFY_ARE_EQUAL(owner1, second.Find(u"C:\\docs\\a.txt"));
+    PORTABLE_VERIFY_ARE_EQUAL(owner2, second.Find(u""));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, second.Find(u"C:\\docs\\a.tx"));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, second.Find(u"c:\\docs\\a.txt"));
+    PORTABLE_VERIFY_ARE_EQUAL(100u, SharedKeyDirectory::GetProcessId(owner1));
+
+    // Only the owner can withdraw
+    second.Withdraw(u"C:\\docs\\a.txt", owner2);
+    PORTABLE_VERIFY_ARE_EQUAL(owner1, second.Find(u"C:\\docs\\a.txt"));
+    first.Withdraw(u"C:\\docs\\a.txt", owner1);
+    PORTABLE_VERIFY_ARE_EQUAL(0u, second.Find(u"C:\\docs\\a.txt"));
+
+    // Withdrawing freed the slot; publishing again takes one back
+    PORTABLE_VERIFY_ARE_EQUAL(1u, first.KeyCount());
+    PORTABLE_VERIFY(second.Publish(u"C:\\docs\\a.txt", owner2));
+    PORTABLE_VERIFY_ARE_EQUAL(owner2, first.Find(u"C:\\docs\\a.txt"));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, first.KeyCount());
+
+    // Keys share probe sequences; everything's still found
+    for (uint32_t index=0; index < 400; ++index)
+    {
+        PORTABLE_VERIFY(first.Publish(MakeKey("key-", index), SharedKeyDirectory::MakeOwner(1000 + index, c_startTime)));
+    }
+    for (uint32_t index=0; index < 400; ++index)
+    {
+        PORTABLE_VERIFY_ARE_EQUAL(SharedKeyDirectory::MakeOwner(1000 + index, c_startTime), second.Find(MakeKey("key-", index)));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(402u, first.KeyCount());
+}
+
+PORTABLE_TEST(SharedKeyDirectory_ForgetsOwnersThatAreGone)
+{
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+
+    // Process 100 is running, but not the one that started at c_startTime
+    const auto liveOwner{ SharedKeyDirectory::MakeOwner(100, c_startTime + 1) };
+    directory.SetIsOwnerAlive([&](uint32_t processId, uint32_t startTag) {
+        return (processId == SharedKeyDirectory::GetProcessId(liveOwner)) && (startTag == SharedKeyDirectory::GetStartTag(liveOwner));
+    });
+    PORTABLE_VERIFY(SharedKeyDirectory::GetStartTag(liveOwner) != SharedKeyDirectory::GetStartTag(SharedKeyDirectory::MakeOwner(100, c_startTime)));
+
+    PORTABLE_VERIFY(directory.Publish(u"reused", SharedKeyDirectory::MakeOwner(100, c_startTime)));
+    PORTABLE_VERIFY(directory.Publish(u"exited", SharedKeyDirectory::MakeOwner(300, c_startTime)));
+    PORTABLE_VERIFY(directory.Publish(u"running", liveOwner));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(u"reused"));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(u"exited"));
+    PORTABLE_VERIFY_ARE_EQUAL(liveOwner, directory.Find(u"running"));
+
+    // Cleared for everyone
+    SharedKeyDirectory other;
+    PORTABLE_VERIFY(other.Attach(region->Get(), region->Size()));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, other.Find(u"exited"));
+}
+
+PORTABLE_TEST(SharedKeyDirectory_RefusesWhatDoesntFit)
+{
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(!directory.Attach(region->Get(), SharedKeyDirectory::RegionSize() - 1));
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+    const auto owner{ SharedKeyDirectory::MakeOwner(100, c_startTime) };
+
+    const std::u16string longest(SharedKeyDirectory::c_maxKeyLength, u'x');
+    PORTABLE_VERIFY(directory.Publish(longest, owner));
+    PORTABLE_VERIFY_ARE_EQUAL(owner, directory.Find(longest));
+    PORTABLE_VERIFY(!directory.Publish(longest + u"x", owner));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(longest + u"x"));
+
+    for (uint32_t index=1; index < SharedKeyDirectory::c_slotCount; ++index)
+    {
+        PORTABLE_VERIFY(directory.Publish(MakeKey("key-", index), owner));
+    }
+    PORTABLE_VERIFY(!directory.Publish(u"one too many", owner));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(u"one too many"));
+    PORTABLE_VERIFY_ARE_EQUAL(owner, directory.Find(MakeKey("key-", SharedKeyDirectory::c_slotCount - 1)));
+    PORTABLE_VERIFY(directory.Publish(MakeKey("key-", 1), SharedKeyDirectory::MakeOwner(200, c_startTime)));
+}
+
+PORTABLE_TEST(SharedKeyDirectory_ReclaimsSlots)
+{
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+    const auto owner{ SharedKeyDirectory::MakeOwner(100, c_startTime) };
+    const auto exited{ SharedKeyDirectory::MakeOwner(300, c_startTime) };
+    directory.SetIsOwnerAlive([&](uint32_t processId, uint32_t) { return processId != SharedKeyDirectory::GetProcessId(exited); });
+
+    // A full directory: half the keys withdrawn, the other half owned by a process that's gone
+    for (uint32_t index=0; index < SharedKeyDirectory::c_slotCount; ++index)
+    {
+        PORTABLE_VERIFY(directory.Publish(MakeKey("old-", index), ((index % 2) == 0) ? owner : exited));
+    }
+    PORTABLE_VERIFY(!directory.Publish(u"new", owner));
+    for (uint32_t index=0; index < SharedKeyDirectory::c_slotCount; index += 2)
+    {
+        directory.Withdraw(MakeKey("old-", index), owner);
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(SharedKeyDirectory::c_slotCount / 2, directory.KeyCount());
+    for (uint32_t index=1; index < SharedKeyDirectory::c_slotCount; index += 2)
+    {
+        PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(MakeKey("old-", index)));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.KeyCount());
+
+    // Every slot can be had again, and none of the old keys come back
+    for (uint32_t index=0; index < SharedKeyDirectory::c_slotCount; ++index)
+    {
+        PORTABLE_VERIFY(directory.Publish(MakeKey("new-", index), owner));
+    }
+    for (uint32_t index=0; index < SharedKeyDirectory::c_slotCount; ++index)
+    {
+        PORTABLE_VERIFY_ARE_EQUAL(owner, directory.Find(MakeKey("new-", index)));
+        PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(MakeKey("old-", index)));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(SharedKeyDirectory::c_slotCount, directory.KeyCount());
+}
+
+PORTABLE_TEST(SharedKeyDirectory_RecoversFromDeadWriters)
+{
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+    directory.SetWriteTimeout(std::chrono::milliseconds(10));
+
+    // Every slot is mid-write by a process that's still running...
+    const auto writer{ SharedKeyDirectory::MakeOwner(500, c_startTime) };
+    bool writerAlive{ true };
+    directory.SetIsOwnerAlive([&](uint32_t, uint32_t) { return writerAlive; });
+    auto slots{ Slots(*region) };
+    for (uint32_t index=0; index < SharedKeyDirectory::c_slotCount; ++index)
+    {
+        slots[index].state.store(writer);
+    }
+    const auto owner{ SharedKeyDirectory::MakeOwner(100, c_startTime) };
+    const auto start{ std::chrono::steady_clock::now() };
+    PORTABLE_VERIFY(!directory.Publish(u"key", owner));
+    PORTABLE_VERIFY(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(10));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.Find(u"key"));
+
+    // ...and then isn't
+    writerAlive = false;
+    PORTABLE_VERIFY(directory.Publish(u"key", owner));
+    writerAlive = true;
+    PORTABLE_VERIFY_ARE_EQUAL(owner, directory.Find(u"key"));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, directory.KeyCount());
+}
+
+PORTABLE_TEST(SharedKeyDirectory_ManyProcesses)
+{
+    constexpr uint32_t c_processes{ 12 };
+    constexpr uint32_t c_sharedKeys{ 200 };
+    constexpr uint32_t c_ownKeys{ 20 };
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+
+    const int failed{ Test::Shared::RunProcesses(c_processes,
+        [&](int index) { return PublishKeys(region->Get(), region->Size(), static_cast<uint32_t>(index), c_sharedKeys, c_ownKeys); }, {}) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+
+    // However the races went, each key has one slot
+    PORTABLE_VERIFY_ARE_EQUAL(c_sharedKeys + c_processes * c_ownKeys, directory.KeyCount());
+    for (uint32_t key=0; key < c_sharedKeys; ++key)
+    {
+        PORTABLE_VERIFY(directory.Find(MakeKey("shared-", key)) != 0);
+    }
+    for (uint32_t index=0; index < c_processes; ++index)
+    {
+        for (uint32_t key=0; key < c_ownKeys; ++key)
+        {
+            const auto owner{ directory.Find(MakeKey("process-" + std::to_string(index) + "-", key)) };
+            PORTABLE_VERIFY_ARE_EQUAL(SharedKeyDirectory::GetStartTag(SharedKeyDirectory::MakeOwner(0, c_startTime + index)), SharedKeyDirectory::GetStartTag(owner));
+        }
+    }
+}
+
+PORTABLE_BENCHMARK(SharedKeyDirectory_Benchmark)
+{
+    // Finding a key's owner among n instances: through the directory, or by opening each
+    // instance's key (a named region per instance, as AppInstance::Key() reads it) and
+    // comparing, which is what FindForKey did. The baseline leaves out opening the
+    // process and the rest of constructing each AppInstance.
+    for (uint32_t instances : { 1u, 16u, 64u })
+    {
+        auto region{ MakeRegion() };
+        SharedKeyDirectory directory;
+        PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+        directory.SetIsOwnerAlive([](uint32_t, uint32_t) { return true; });
+
+        std::vector<std::unique_ptr<Test::Shared::SharedRegion>> keys;
+        for (uint32_t index=0; index < instances; ++index)
+        {
+            const auto key{ MakeKey("C:\\Users\\someone\\Documents\\document-", index) };
+            PORTABLE_VERIFY(directory.Publish(key, SharedKeyDirectory::MakeOwner(1000 + index, c_startTime)));
+            keys.push_back(std::make_unique<Test::Shared::SharedRegion>("key-" + std::to_string(index), 4096));
+            std::memcpy(keys.back()->Get(), key.c_str(), (key.size() + 1) * sizeof(char16_t));
+        }
+
+        // The owner's the last to be asked
+        const auto wanted{ MakeKey("C:\\Users\\someone\\Documents\\document-", instances - 1) };
+        constexpr size_t c_iterations{ 2000 };
+        auto samples{ Test::Perf::Measure(c_iterations, [&](size_t) {
+            PORTABLE_VERIFY_ARE_EQUAL(1000 + instances - 1, SharedKeyDirectory::GetProcessId(directory.Find(wanted)));
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("sharedkeydirectory.find", instances, 1, samples).c_str());
+
+        samples = Test::Perf::Measure(c_iterations, [&](size_t) {
+            uint32_t found{};
+            for (uint32_t index=0; index < instances; ++index)
+            {
+                Test::Shared::SharedRegion key("key-" + std::to_string(index), 4096);
+                if (std::u16string_view(static_cast<const char16_t*>(key.Get())) == wanted)
+                {
+                    found = 1000 + index;
+                }
+            }
+            PORTABLE_VERIFY_ARE_EQUAL(1000 + instances - 1, found);
+        });
+        std::printf("%s\n", Test::Perf::ToJson("sharedkeydirectory.find.baseline", instances, 1, samples).c_str());
+    }
+}
+
+PORTABLE_TEST(SharedKeyDirectory_ReclaimsSlotsAcrossProcesses)
+{
+    constexpr uint32_t c_processes{ 12 };
+    constexpr uint32_t c_keys{ 2000 };
+    auto region{ MakeRegion() };
+    SharedKeyDirectory directory;
+    PORTABLE_VERIFY(directory.Attach(region->Get(), region->Size()));
+
+    const int failed{ Test::Shared::RunProcesses(c_processes,
+        [&](int index) { return ChurnKeys(region->Get(), region->Size(), static_cast<uint32_t>(index), c_processes, c_keys); }, {}) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+    PORTABLE_VERIFY_ARE_EQUAL(0u, directory.KeyCount());
+}
@@ -0,0 +1,409 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "SharedProcessTable.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+#include "SharedRegion.h"
+
+using AppLifecycleCore::SharedProcessTable;
+
+namespace
+{
+    // The table's regions. Every segment is created up front so that processes started
+    // later share them; opening one just hands it out.
+    struct Regions
+    {
+        Regions()
+        {
+            first = std::make_unique<Test::Shared::SharedRegion>(SharedProcessTable::RegionSize());
+            for (uint32_t segment=1; segment < SharedProcessTable::c_maxSegmentCount; ++segment)
+            {
+                segments.push_back(std::make_unique<Test::Shared::SharedRegion>(SharedProcessTable::SegmentSize()));
+            }
+        }
+
+        bool Attach(SharedProcessTable& table, uint32_t availableSegments=SharedProcessTable::c_maxSegmentCount)
+        {
+            return table.Attach(first->Get(), first->Size(), [this, availableSegments](uint32_t segment) -> void* {
+                ++opened;
+                return (segment < availableSegments) ? segments[segment - 1]->Get() : nullptr;
+            });
+        }
+
+        std::unique_ptr<Test::Shared::SharedRegion> first;
+        std::vector<std::unique_ptr<Test::Shared::SharedRegion>> segments;
+        std::atomic<uint32_t> opened{};
+    };
+
+    // Fake process ids and creation times that say who wrote them, to spot torn reads
+    constexpr uint32_t c_processIdBase{ 0x10000 };
+
+    uint64_t CreationTime(uint32_t worker, uint32_t sequence)
+    {
+        return (static_cast<uint64_t>(worker) << 32) | sequence;
+    }
+
+    bool IsConsistent(const SharedProcessTable::Entry& entry)
+    {
+        return (entry.processId - c_processIdBase) == static_cast<uint32_t>(entry.creationTime >> 32);
+    }
+
+    // Instances coming and going: keep up to c_held registered, churning through the rest,
+    // and finish holding c_kept
+    constexpr uint32_t c_held{ 100 };
+    constexpr uint32_t c_kept{ 50 };
+
+    int Churn(Regions& regions, uint32_t worker, uint32_t iterations)
+    {
+        SharedProcessTable table;
+        if (!regions.Attach(table))
+        {
+            return 1;
+        }
+        std::vector<SharedProcessTable::Entry> held;
+        std::vector<SharedProcessTable::Entry> snapshot;
+        for (uint32_t sequence=0; sequence < iterations; ++sequence)
+        {
+            SharedProcessTable::Entry entry;
+            if (!table.Insert(c_processIdBase + worker, CreationTime(worker, sequence), entry))
+            {
+                return 1;
+            }
+            held.push_back(entry);
+            if (held.size() > c_held)
+            {
+                const auto victim{ held.begin() + (sequence % held.size()) };
+                if (!table.Remove(*victim) || table.Remove(*victim))
+                {
+                    return 1;
+                }
+                held.erase(victim);
+            }
+            if ((sequence % 97) == 0)
+            {
+                // Everything we hold is there
+                table.Snapshot(snapshot);
+                for (const auto& mine : held)
+                {
+                    if (std::none_of(snapshot.begin(), snapshot.end(), [&](const auto& entry) { return (entry.index == mine.index) && (entry.creationTime == mine.creationTime); }))
+                    {
+                        return 1;
+                    }
+                }
+            }
+        }
+        while (held.size() > c_kept)
+        {
+            if (!table.Remove(held.back()))
+            {
+                return 1;
+            }
+            held.pop_back();
+        }
+        return 0;
+    }
+
+    // What it replaced: a fixed array scanned under a lock
+    class LockedProcessList
+    {
+    public:
+        bool Insert(uint32_t processId)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto& slot : m_slots)
+            {
+                if (slot == 0)
+                {
+                    slot = processId;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Remove(uint32_t processId)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto& slot : m_slots)
+            {
+                if (slot == processId)
+                {
+                    slot = 0;
+                    return;
+                }
+            }
+        }
+
+        void Snapshot(std::vector<uint32_t>& processIds)
+        {
+            processIds.clear();
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto slot : m_slots)
+            {
+                if (slot != 0)
+                {
+                    processIds.push_back(slot);
+                }
+            }
+        }
+
+    private:
+        std::mutex m_lock;
+        uint32_t m_slots[512]{};
+    };
+}
+
+PORTABLE_TEST(SharedProcessTable_InsertsRemovesAndSnapshots)
+{
+    Regions regions;
+    SharedProcessTable table;
+    SharedProcessTable other;
+    PORTABLE_VERIFY(regions.Attach(table));
+    PORTABLE_VERIFY(regions.Attach(other));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, table.SegmentCount());
+
+    std::vector<SharedProcessTable::Entry> entries;
+    table.Snapshot(entries);
+    PORTABLE_VERIFY(entries.empty());
+
+    SharedProcessTable::Entry first;
+    SharedProcessTable::Entry second;
+    PORTABLE_VERIFY(table.Insert(100, 1000, first));
+    PORTABLE_VERIFY(other.Insert(200, 2000, second));
+    PORTABLE_VERIFY(first.index != second.index);
+    other.Snapshot(entries);
+    PORTABLE_VERIFY_ARE_EQUAL(2u, entries.size());
+    PORTABLE_VERIFY_ARE_EQUAL(100u, entries[0].processId);
+    PORTABLE_VERIFY_ARE_EQUAL(1000u, entries[0].creationTime);
+    PORTABLE_VERIFY_ARE_EQUAL(first.generation, entries[0].generation);
+    PORTABLE_VERIFY_ARE_EQUAL(200u, entries[1].processId);
+
+    // Removing is once only, and an old entry can't remove whoever's in its slot now
+    PORTABLE_VERIFY(other.Remove(entries[0]));
+    PORTABLE_VERIFY(!table.Remove(first));
+    SharedProcessTable::Entry reused;
+    PORTABLE_VERIFY(table.Insert(100, 3000, reused));
+    PORTABLE_VERIFY_ARE_EQUAL(first.index, reused.index);
+    PORTABLE_VERIFY(reused.generation != first.generation);
+    PORTABLE_VERIFY(!table.Remove(first));
+    table.Snapshot(entries);
+    PORTABLE_VERIFY_ARE_EQUAL(2u, entries.size());
+    PORTABLE_VERIFY_ARE_EQUAL(3000u, entries[0].creationTime);
+
+    // Nothing else was opened
+    PORTABLE_VERIFY_ARE_EQUAL(0u, regions.opened.load());
+}
+
+PORTABLE_TEST(SharedProcessTable_Grows)
+{
+    Regions regions;
+    SharedProcessTable table;
+    PORTABLE_VERIFY(regions.Attach(table, 4));
+
+    std::vector<SharedProcessTable::Entry> inserted(1500);
+    for (uint32_t index=0; index < inserted.size(); ++index)
+    {
+        PORTABLE_VERIFY(table.Insert(c_processIdBase + index, CreationTime(index, 0), inserted[index]));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(3u, table.SegmentCount());
+
+    // Another process sees them all, opening the new segments when it gets to them
+    SharedProcessTable other;
+    PORTABLE_VERIFY(regions.Attach(other, 4));
+    std::vector<SharedProcessTable::Entry> entries;
+    other.Snapshot(entries);
+    PORTABLE_VERIFY_ARE_EQUAL(inserted.size(), entries.size());
+    std::set<uint32_t> indexes;
+    for (const auto& entry : entries)
+    {
+        PORTABLE_VERIFY(IsConsistent(entry));
+        indexes.insert(entry.index);
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(inserted.size(), indexes.size());
+
+    // Freed slots are reused before growing again
+    for (uint32_t index=0; index < 600; ++index)
+    {
+        PORTABLE_VERIFY(other.Remove(inserted[index]));
+    }
+    for (uint32_t index=0; index < 600; ++index)
+    {
+        PORTABLE_VERIFY(table.Insert(c_processIdBase, CreationTime(0, index + 1), inserted[index]));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(3u, table.SegmentCount());
+
+    // Until it can't
+    SharedProcessTable::Entry entry;
+    for (uint32_t index=1500; index < 4 * SharedProcessTable::c_slotsPerSegment; ++index)
+    {
+        PORTABLE_VERIFY(table.Insert(c_processIdBase + index, CreationTime(index, 0), entry));
+    }
+    PORTABLE_VERIFY(!table.Insert(c_processIdBase, CreationTime(0, 0), entry));
+}
+
+PORTABLE_TEST(SharedProcessTable_HasALimit)
+{
+    Regions regions;
+    SharedProcessTable table;
+    PORTABLE_VERIFY(!table.Attach(regions.first->Get(), SharedProcessTable::RegionSize() - 1, {}));
+    PORTABLE_VERIFY(regions.Attach(table));
+
+    SharedProcessTable::Entry entry;
+    for (uint32_t index=0; index < SharedProcessTable::c_maxSegmentCount * SharedProcessTable::c_slotsPerSegment; ++index)
+    {
+        PORTABLE_VERIFY(table.Insert(c_processIdBase + index, CreationTime(index, 0), entry));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(SharedProcessTable::c_maxSegmentCount, table.SegmentCount());
+    PORTABLE_VERIFY(!table.Insert(c_processIdBase, CreationTime(0, 0), entry));
+}
+
+PORTABLE_TEST(SharedProcessTable_RecoversFromDeadWriters)
+{
+    Regions regions;
+    SharedProcessTable table;
+    PORTABLE_VERIFY(regions.Attach(table, 1));
+
+    // Every slot is mid-write by a process that's gone...
+    constexpr uint32_t c_deadProcessId{ 0x7FFFFFF0 };
+    auto slots{ reinterpret_cast<AppLifecycleCore::details::ProcessSlot*>(
+        static_cast<uint8_t*>(regions.first->Get()) + sizeof(AppLifecycleCore::details::SharedProcessTableHeader)) };
+    for (uint32_t index=0; index < SharedProcessTable::c_slotsPerSegment; ++index)
+    {
+        slots[index].state.store(c_deadProcessId);
+    }
+
+    // ...which can't be known without asking
+    SharedProcessTable::Entry entry;
+    PORTABLE_VERIFY(!table.Insert(100, 1000, entry));
+    table.SetIsProcessAlive([](uint32_t processId) { return processId != c_deadProcessId; });
+    PORTABLE_VERIFY(table.Insert(100, 1000, entry));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, entry.generation);
+
+    std::vector<SharedProcessTable::Entry> entries;
+    table.Snapshot(entries);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, entries.size());
+}
+
+PORTABLE_TEST(SharedProcessTable_ManyProcesses)
+{
+    constexpr uint32_t c_workers{ 12 };
+    constexpr uint32_t c_iterations{ 5000 };
+    Regions regions;
+    SharedProcessTable table;
+    PORTABLE_VERIFY(regions.Attach(table));
+
+    // Snapshots taken while they churn never show a torn entry, or one slot twice
+    std::atomic<bool> done{};
+    size_t snapshots{};
+    const int failed{ Test::Shared::RunProcesses(c_workers,
+        [&](int index) { return Churn(regions, static_cast<uint32_t>(index), c_iterations); },
+        [&]() {
+            std::vector<SharedProcessTable::Entry> entries;
+            std::set<uint32_t> indexes;
+            for (int round=0; round < 200; ++round)
+            {
+                table.Snapshot(entries);
+                indexes.clear();
+                for (const auto& entry : entries)
+                {
+                    PORTABLE_VERIFY(IsConsistent(entry));
+                    PORTABLE_VERIFY(indexes.insert(entry.index).second);
+                }
+                ++snapshots;
+                std::this_thread::yield();
+            }
+        }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+    PORTABLE_VERIFY(snapshots > 0);
+
+    // c_workers * c_held entries at the peak needed more than one segment
+    PORTABLE_VERIFY(table.SegmentCount() > 1);
+    std::vector<SharedProcessTable::Entry> entries;
+    table.Snapshot(entries);
+    PORTABLE_VERIFY_ARE_EQUAL(c_workers * c_kept, entries.size());
+    std::vector<uint32_t> perWorker(c_workers);
+    for (const auto& entry : entries)
+    {
+        PORTABLE_VERIFY(IsConsistent(entry));
+        ++perWorker[entry.processId - c_processIdBase];
+    }
+    for (auto count : perWorker)
+    {
+        PORTABLE_VERIFY_ARE_EQUAL(c_kept, count);
+    }
+}
+
+PORTABLE_BENCHMARK(SharedProcessTable_Benchmark)
+{
+    // Instances starting and exiting at once, against the locked array it replaced (with an
+    // in-process mutex rather than a named one, which flatters it)
+    for (size_t threads : { 1, 4, 16 })
+    {
+        constexpr size_t c_iterations{ 20000 };
+        Regions regions;
+        SharedProcessTable table;
+        PORTABLE_VERIFY(regions.Attach(table));
+        LockedProcessList baseline;
+
+        // Some instances are already running
+        SharedProcessTable::Entry entry;
+        for (uint32_t index=0; index < 64; ++index)
+        {
+            table.Insert(c_processIdBase + index, CreationTime(index, 0), entry);
+            baseline.Insert(c_processIdBase + index);
+        }
+
+        auto result{ Test::Perf::MeasureConcurrently(threads, c_iterations, [&](size_t thread, size_t iteration) {
+            SharedProcessTable::Entry mine;
+            table.Insert(static_cast<uint32_t>(c_processIdBase + 1000 + thread), CreationTime(static_cast<uint32_t>(thread), static_cast<uint32_t>(iteration)), mine);
+            table.Remove(mine);
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("sharedprocesstable.register", 64, threads, result.samples, result.elapsedNanoseconds).c_str());
+
+        result = Test::Perf::MeasureConcurrently(threads, c_iterations, [&](size_t thread, size_t) {
+            baseline.Insert(static_cast<uint32_t>(c_processIdBase + 1000 + thread));
+            baseline.Remove(static_cast<uint32_t>(c_processIdBase + 1000 + thread));
+        });
+        std::printf("%s\n", Test::Perf::ToJson("sharedprocesstable.register.baseline", 64, threads, result.samples, result.elapsedNanoseconds).c_str());
+
+        // GetInstances() racing them
+        std::atomic<bool> stop{};
+        std::vector<std::thread> churn;
+        for (size_t thread=1; thread < threads; ++thread)
+        {
+            churn.emplace_back([&, thread]() {
+                for (uint32_t iteration=0; !stop; ++iteration)
+                {
+                    SharedProcessTable::Entry mine;
+                    table.Insert(static_cast<uint32_t>(c_processIdBase + 1000 + thread), CreationTime(static_cast<uint32_t>(thread), iteration), mine);
+                    table.Remove(mine);
+                    baseline.Insert(static_cast<uint32_t>(c_processIdBase + 1000 + thread));
+                    baseline.Remove(static_cast<uint32_t>(c_processIdBase + 1000 + thread));
+                }
+            });
+        }
+        std::vector<SharedProcessTable::Entry> entries;
+        auto samples{ Test::Perf::Measure(c_iterations / 10, [&](size_t) { table.Snapshot(entries); }) };
+        std::vector<uint32_t> processIds;
+        auto baselineSamples{ Test::Perf::Measure(c_iterations / 10, [&](size_t) { baseline.Snapshot(processIds); }) };
+        stop = true;
+        for (auto& thread : churn)
+        {
+            thread.join();
+        }
+        std::printf("%s\n", Test::Perf::ToJson("sharedprocesstable.snapshot", 64, threads, samples).c_str());
+        std::printf("%s\n", Test::Perf::ToJson("sharedprocesstable.snapshot.baseline", 64, threads, baselineSamples).c_str());
+    }
+}
@@ -0,0 +1,453 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SharedRingBuffer.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+#include "SharedRegion.h"
+
+using AppLifecycleCore::SharedRingBuffer;
+
+namespace
+{
+    // What a redirection request id looks like to the queue
+    struct Item
+    {
+        uint32_t producer;
+        uint32_t sequence;
+        uint64_t check;
+    };
+
+    Item MakeItem(uint32_t producer, uint32_t sequence)
+    {
+        return Item{ producer, sequence, (static_cast<uint64_t>(producer) << 32) ^ (sequence * 0x9E3779B97F4A7C15ull) };
+    }
+
+    bool IsValid(const Item& item)
+    {
+        return item.check == MakeItem(item.producer, item.sequence).check;
+    }
+
+    // Not a process anyone's running
+    constexpr uint32_t c_deadProcessId{ 0x7FFFFFF0 };
+
+    // Drain the queue until each of producerCount producers' itemsPerProducer items has been
+    // seen, checking they arrive intact, once and in each producer's order
+    void Consume(SharedRingBuffer<Item>& queue, uint32_t producerCount, uint32_t itemsPerProducer)
+    {
+        std::vector<uint32_t> next(producerCount);
+        uint64_t remaining{ static_cast<uint64_t>(producerCount) * itemsPerProducer };
+        const auto deadline{ std::chrono::steady_clock::now() + std::chrono::seconds(60) };
+        Item item{};
+        while (remaining > 0)
+        {
+            if (!queue.TryDequeue(item))
+            {
+                PORTABLE_VERIFY(std::chrono::steady_clock::now() < deadline);
+                std::this_thread::yield();
+                continue;
+            }
+            PORTABLE_VERIFY(IsValid(item));
+            PORTABLE_VERIFY(item.producer < producerCount);
+            PORTABLE_VERIFY_ARE_EQUAL(next[item.producer], item.sequence);
+            ++next[item.producer];
+            --remaining;
+        }
+        PORTABLE_VERIFY(!queue.TryDequeue(item));
+    }
+
+    int Produce(void* region, size_t size, uint32_t producer, uint32_t itemsPerProducer)
+    {
+        SharedRingBuffer<Item> queue;
+        if (!queue.Attach(region, size))
+        {
+            return 1;
+        }
+        for (uint32_t sequence=0; sequence < itemsPerProducer; ++sequence)
+        {
+            while (!queue.TryEnqueue(MakeItem(producer, sequence), Test::Shared::CurrentProcessId()))
+            {
+                // Full; wait for the consumer
+                std::this_thread::yield();
+            }
+        }
+        return 0;
+    }
+
+    // The queue this replaced: a linked list in shared memory walked to the tail on every
+    // enqueue, with a linear scan for a free item, all under a (named) mutex
+    class LinkedListQueue
+    {
+        struct QueueItem
+        {
+            bool inUse;
+            size_t next;
+            Item item;
+        };
+
+    public:
+        explicit LinkedListQueue(size_t capacity) :
+            m_items(capacity + 1)
+        {
+        }
+
+        bool TryEnqueue(const Item& item)
+        {
+            auto lock{ std::lock_guard<std::mutex>(m_lock) };
+            size_t index{ 1 };
+            while ((index < m_items.size()) && m_items[index].inUse)
+            {
+                ++index;
+            }
+            if (index == m_items.size())
+            {
+                return false;
+            }
+            m_items[index] = QueueItem{ true, 0, item };
+            if (m_head == 0)
+            {
+                m_head = index;
+                return true;
+            }
+            auto tail{ m_head };
+            while (m_items[tail].next != 0)
+            {
+                tail = m_items[tail].next;
+            }
+            m_items[tail].next = index;
+            return true;
+        }
+
+        bool TryDequeue(Item& item)
+        {
+            auto lock{ std::lock_guard<std::mutex>(m_lock) };
+            if (m_head == 0)
+            {
+                return false;
+            }
+            auto& head{ m_items[m_head] };
+            item = head.item;
+            head.inUse = false;
+            m_head = head.next;
+            return true;
+        }
+
+    private:
+        std::mutex m_lock;
+        std::vector<QueueItem> m_items;
+        size_t m_head{};
+    };
+}
+
+PORTABLE_TEST(SharedRingBuffer_FirstInFirstOut)
+{
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(8));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY_ARE_EQUAL(8u, queue.Capacity());
+
+    Item item{};
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+
+    // Many laps around the ring, filling it each time
+    uint32_t sequence{};
+    for (int lap=0; lap < 100; ++lap)
+    {
+        for (uint32_t index=0; index < queue.Capacity(); ++index)
+        {
+            PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(0, sequence + index), Test::Shared::CurrentProcessId()));
+        }
+        PORTABLE_VERIFY(!queue.TryEnqueue(MakeItem(0, 0), Test::Shared::CurrentProcessId()));
+        PORTABLE_VERIFY_ARE_EQUAL(8u, queue.Count());
+
+        for (uint32_t index=0; index < queue.Capacity(); ++index)
+        {
+            PORTABLE_VERIFY(queue.TryDequeue(item));
+            PORTABLE_VERIFY_ARE_EQUAL(sequence++, item.sequence);
+        }
+        PORTABLE_VERIFY(!queue.TryDequeue(item));
+        PORTABLE_VERIFY_ARE_EQUAL(0u, queue.Count());
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(0u, queue.AbandonedCount());
+}
+
+PORTABLE_TEST(SharedRingBuffer_SharesLayout)
+{
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(64) + 8);
+
+    // Everyone attaching to the region sees the same queue
+    SharedRingBuffer<Item> producer;
+    SharedRingBuffer<Item> consumer;
+    PORTABLE_VERIFY(consumer.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY(producer.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY_ARE_EQUAL(64u, producer.Capacity());
+    PORTABLE_VERIFY(producer.TryEnqueue(MakeItem(1, 2), Test::Shared::CurrentProcessId()));
+    Item item{};
+    PORTABLE_VERIFY(consumer.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, item.sequence);
+
+    // ...unless they'd lay it out differently
+    SharedRingBuffer<Item> mismatched;
+    PORTABLE_VERIFY(!mismatched.Attach(region.Get(), SharedRingBuffer<Item>::RegionSize(32)));
+    PORTABLE_VERIFY(!mismatched.Attach(region.Get(), 64));
+    PORTABLE_VERIFY(!mismatched.Attach(nullptr, region.Size()));
+    PORTABLE_VERIFY(!mismatched.Attach(static_cast<uint8_t*>(region.Get()) + 1, region.Size() - 1));
+}
+
+PORTABLE_TEST(SharedRingBuffer_RecoversFromDeadWriter)
+{
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(8));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+    queue.SetIsProcessAlive([](uint32_t processId) { return processId != c_deadProcessId; });
+
+    // A producer that dies after claiming its slot, and another behind it
+    auto reservation{ queue.Reserve(c_deadProcessId) };
+    PORTABLE_VERIFY(!!reservation);
+    reservation.value = MakeItem(0, 0);
+    PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(1, 0), Test::Shared::CurrentProcessId()));
+
+    Item item{};
+    PORTABLE_VERIFY(queue.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, item.producer);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, queue.AbandonedCount());
+
+    // If it wasn't dead after all it finds out, and its value never shows up
+    PORTABLE_VERIFY(!queue.Commit(reservation));
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+
+    // Writers that are alive are waited for
+    reservation = queue.Reserve(Test::Shared::CurrentProcessId());
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+    reservation.value = MakeItem(2, 0);
+    PORTABLE_VERIFY(queue.Commit(reservation));
+    PORTABLE_VERIFY(queue.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, item.producer);
+}
+
+PORTABLE_TEST(SharedRingBuffer_RecoversFromStalledClaim)
+{
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(8));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+
+    // A producer that died between claiming a position and its slot
+    static_cast<AppLifecycleCore::details::SharedRingBufferHeader*>(region.Get())->tail.fetch_add(1);
+    PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(1, 0), Test::Shared::CurrentProcessId()));
+
+    // It's given a while...
+    Item item{};
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+
+    // ...and then skipped
+    queue.SetStallTimeout(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    PORTABLE_VERIFY(queue.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, item.producer);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, queue.AbandonedCount());
+
+    // The ring's still usable afterwards
+    for (uint32_t sequence=0; sequence < 20; ++sequence)
+    {
+        PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(2, sequence), Test::Shared::CurrentProcessId()));
+        PORTABLE_VERIFY(queue.TryDequeue(item));
+        PORTABLE_VERIFY_ARE_EQUAL(sequence, item.sequence);
+    }
+}
+
+PORTABLE_TEST(SharedRingBuffer_RecoversFromHungWriter)
+{
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(8));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+    queue.SetIsProcessAlive([](uint32_t) { return true; });
+
+    // A producer that died mid-write and whose process id was reused, so it looks alive
+    auto reservation{ queue.Reserve(c_deadProcessId) };
+    PORTABLE_VERIFY(!!reservation);
+    PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(1, 0), Test::Shared::CurrentProcessId()));
+
+    // It's given a while...
+    Item item{};
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, queue.AbandonedCount());
+
+    // ...and then skipped
+    queue.SetStallTimeout(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    PORTABLE_VERIFY(queue.TryDequeue(item));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, item.producer);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, queue.AbandonedCount());
+
+    // Its slot goes round to other producers...
+    for (uint32_t sequence=0; sequence < queue.Capacity(); ++sequence)
+    {
+        PORTABLE_VERIFY(queue.TryEnqueue(MakeItem(2, sequence), Test::Shared::CurrentProcessId()));
+    }
+
+    // ...so if it was merely slow it finds out without touching their values, and its own
+    // never shows up
+    reservation.value = MakeItem(0, 0);
+    PORTABLE_VERIFY(!queue.Commit(reservation));
+    for (uint32_t sequence=0; sequence < queue.Capacity(); ++sequence)
+    {
+        PORTABLE_VERIFY(queue.TryDequeue(item));
+        PORTABLE_VERIFY_ARE_EQUAL(2u, item.producer);
+        PORTABLE_VERIFY_ARE_EQUAL(sequence, item.sequence);
+    }
+    PORTABLE_VERIFY(!queue.TryDequeue(item));
+}
+
+PORTABLE_TEST(SharedRingBuffer_RecoversFromCrashedProcess)
+{
+    if constexpr (!Test::Shared::c_workersAreProcesses)
+    {
+        std::fprintf(stderr, "  skipped (needs separate processes)\n");
+        return;
+    }
+
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(8));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+    queue.SetIsProcessAlive(&Test::Shared::IsProcessAlive);
+
+    // Producers that exit partway through writing, with others around them
+    const int failed{ Test::Shared::RunProcesses(3, [&](int index) {
+        SharedRingBuffer<Item> producer;
+        if (!producer.Attach(region.Get(), region.Size()))
+        {
+            return 1;
+        }
+        auto reservation{ producer.Reserve(Test::Shared::CurrentProcessId()) };
+        reservation.value = MakeItem(static_cast<uint32_t>(index), 0);
+        if (index != 1)
+        {
+            producer.Commit(reservation);
+        }
+        return 0;
+    }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+
+    Item item{};
+    std::vector<uint32_t> producers;
+    while (queue.TryDequeue(item))
+    {
+        producers.push_back(item.producer);
+    }
+    std::sort(producers.begin(), producers.end());
+    PORTABLE_VERIFY(producers == (std::vector<uint32_t>{ 0, 2 }));
+    PORTABLE_VERIFY_ARE_EQUAL(1u, queue.AbandonedCount());
+}
+
+PORTABLE_TEST(SharedRingBuffer_ManyProducerThreads)
+{
+    constexpr uint32_t c_producers{ 8 };
+    constexpr uint32_t c_itemsPerProducer{ 20000 };
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(64));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+
+    std::vector<std::thread> producers;
+    std::vector<int> results(c_producers, -1);
+    for (uint32_t producer=0; producer < c_producers; ++producer)
+    {
+        producers.emplace_back([&, producer]() {
+            results[producer] = Produce(region.Get(), region.Size(), producer, c_itemsPerProducer);
+        });
+    }
+    Consume(queue, c_producers, c_itemsPerProducer);
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    PORTABLE_VERIFY(std::all_of(results.begin(), results.end(), [](int result) { return result == 0; }));
+}
+
+PORTABLE_TEST(SharedRingBuffer_ManyProducerProcesses)
+{
+    constexpr uint32_t c_producers{ 16 };
+    constexpr uint32_t c_itemsPerProducer{ 20000 };
+    Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(256));
+    SharedRingBuffer<Item> queue;
+    PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+    queue.SetIsProcessAlive(&Test::Shared::IsProcessAlive);
+
+    const int failed{ Test::Shared::RunProcesses(c_producers,
+        [&](int index) { return Produce(region.Get(), region.Size(), static_cast<uint32_t>(index), c_itemsPerProducer); },
+        [&]() { Consume(queue, c_producers, c_itemsPerProducer); }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+    PORTABLE_VERIFY_ARE_EQUAL(0u, queue.AbandonedCount());
+}
+
+PORTABLE_BENCHMARK(SharedRingBuffer_Benchmark)
+{
+    // A launch storm: requests redirected to one instance while it's busy, then drained.
+    // The queue it replaced had 4096 items.
+    for (size_t requests : { 16, 200, 2000 })
+    {
+        constexpr size_t c_iterations{ 50 };
+        Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(4096));
+        SharedRingBuffer<Item> queue;
+        PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+        LinkedListQueue baseline(4096);
+
+        Test::Perf::Samples enqueueSamples;
+        Test::Perf::Samples baselineSamples;
+        for (size_t iteration=0; iteration < c_iterations; ++iteration)
+        {
+            enqueueSamples.Add(Test::Perf::Measure(requests, [&](size_t index) {
+                queue.TryEnqueue(MakeItem(0, static_cast<uint32_t>(index)), 1000);
+            }));
+            Item item{};
+            while (queue.TryDequeue(item))
+            {
+            }
+
+            baselineSamples.Add(Test::Perf::Measure(requests, [&](size_t index) {
+                baseline.TryEnqueue(MakeItem(0, static_cast<uint32_t>(index)));
+            }));
+            while (baseline.TryDequeue(item))
+            {
+            }
+        }
+        std::printf("%s\n", Test::Perf::ToJson("redirectionqueue.enqueue", requests, 1, enqueueSamples).c_str());
+        std::printf("%s\n", Test::Perf::ToJson("redirectionqueue.enqueue.baseline", requests, 1, baselineSamples).c_str());
+    }
+
+    // Producers in separate processes (where possible) racing one consumer
+    for (int producers : { 1, 4, 16 })
+    {
+        constexpr uint32_t c_itemsPerProducer{ 20000 };
+        Test::Shared::SharedRegion region(SharedRingBuffer<Item>::RegionSize(4096));
+        SharedRingBuffer<Item> queue;
+        PORTABLE_VERIFY(queue.Attach(region.Get(), region.Size()));
+
+        const auto start{ std::chrono::steady_clock::now() };
+        Test::Shared::RunProcesses(producers,
+            [&](int index) { return Produce(region.Get(), region.Size(), static_cast<uint32_t>(index), c_itemsPerProducer); },
+            [&]() { Consume(queue, static_cast<uint32_t>(producers), c_itemsPerProducer); });
+        const auto elapsed{ std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() };
+
+        // One sample per item, at the mean, so throughput comes from wall time
+        Test::Perf::Samples samples;
+        const auto items{ static_cast<int64_t>(producers) * c_itemsPerProducer };
+        for (int64_t index=0; index < items; ++index)
+        {
+            samples.Add(elapsed / items);
+        }
+        std::printf("%s\n", Test::Perf::ToJson("redirectionqueue.storm", 4096, static_cast<size_t>(producers), samples, elapsed).c_str());
+    }
+}
@@ -0,0 +1,405 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Benchmarks and stress tests for DynamicDependency's package graph bookkeeping,
+// run against in-memory stand-ins for the package catalog, file system and PATH.
+//
+// The code measured is DynamicDependency's own: package resolution (MddCore::PackageResolution
+// via MddCore::IPackageCatalog, and MddCore::PackageResolutionCache), PATH maintenance
+// (MddCore::PathList) and the WinRT activatableClassId index and its lock
+// (MddCore::WinRTActivatableClassIndex, as used by WinRTModuleManager).
+//
+// Only depends on the C++ standard library (and DynamicDependency's std-only headers)
+// so it builds and runs anywhere, e.g.
+//
+//      g++ -std=c++17 -O2 -pthread -Idev/DynamicDependency/API test/DynamicDependency/Perf/DynamicDependencyPerf.cpp -o ddperf
+//      ./ddperf --iterations=1000 --max-graph-size=256 --max-threads=16 > results.jsonl
+//
+// Results are written to stdout as JSON Lines (see Test::Perf::ToJson()).
+//
+// PackageDependencyManager, PackageGraphManager (adding/removing nodes, GetCurrentPackageInfo)
+// and loading WinRT modules need Windows and installed test packages, so they're measured
+// (including under contention) through the real API; see Test_Win32_Perf.cpp.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "PackageResolution.h"
+#include "PackageResolutionCache.h"
+#include "PathList.h"
+#include "WinRTActivatableClassIndex.h"
+#include "WinRTManifestCacheFormat.h"
+
+#include "InMemoryPackageCatalog.h"
+#include "PerfHarness.h"
+
+namespace
+{
+struct Options
+{
+    size_t iterations{ 1000 };
+    size_t maxGraphSize{ 256 };
+    size_t maxThreads{ 16 };
+};
+
+// Graph sizes 1, 4, 16, ... maxGraphSize
+std::vector<size_t> GraphSizes(const Options& options)
+{
+    std::vector<size_t> sizes;
+    for (size_t size=1; size <= options.maxGraphSize; size *= 4)
+    {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+// Thread counts 1, 2, 4, ... maxThreads
+std::vector<size_t> ThreadCounts(const Options& options)
+{
+    std::vector<size_t> counts;
+    for (size_t count=1; count <= options.maxThreads; count *= 2)
+    {
+        counts.push_back(count);
+    }
+    return counts;
+}
+
+void Report(const std::string& json)
+{
+    std::printf("%s\n", json.c_str());
+    std::fflush(stdout);
+}
+
+// A typical PATH before we add to it
+std::wstring BasePath()
+{
+    std::wstring path;
+    for (int index=0; index < 20; ++index)
+    {
+        if (!path.empty())
+        {
+            path += L';';
+        }
+        path += L"C:\\Program Files\\Tool" + std::to_wstring(index) + L"\\bin";
+    }
+    return path;
+}
+
+std::wstring PathListEntry(Test::Perf::InMemoryPackageCatalog& catalog, size_t family)
+{
+    Test::Perf::InMemoryPackage package;
+    const auto packageFullNames{ catalog.FindPackagesByFamily(Test::Perf::InMemoryPackageCatalog::PackageFamilyName(family)) };
+    (void)catalog.FindPackage(packageFullNames.back(), package);
+    return package.path;
+}
+
+// The in-memory catalog's equivalent of PackageGraph::FindBestFit(): the highest version
+// satisfying minVersion. (The real one parses package full names via Windows' PackageIdFromFullName.)
+auto FindBestFit(Test::Perf::InMemoryPackageCatalog& catalog, uint64_t minVersion)
+{
+    return [&catalog, minVersion](const std::vector<std::wstring>& packageFullNames, const std::vector<bool>& excluded)
+    {
+        size_t bestFitIndex{ packageFullNames.size() };
+        uint64_t bestFitVersion{};
+        for (size_t index=0; index < packageFullNames.size(); ++index)
+        {
+            Test::Perf::InMemoryPackage package;
+            if (excluded[index] || !catalog.FindPackage(packageFullNames[index], package) || (package.version < minVersion))
+            {
+                continue;
+            }
+            if ((bestFitIndex == packageFullNames.size()) || (package.version > bestFitVersion))
+            {
+                bestFitIndex = index;
+                bestFitVersion = package.version;
+            }
+        }
+        return bestFitIndex;
+    };
+}
+
+// Package dependency resolution, with and without the resolution cache, and the cache under contention
+void BenchmarkResolve(const Options& options)
+{
+    for (const auto graphSize : GraphSizes(options))
+    {
+        Test::Perf::InMemoryPackageCatalog catalog;
+        catalog.Generate(graphSize, 4, 0);
+        const uint64_t c_minVersion{ static_cast<uint64_t>(1) << 48 };
+        const uint32_t c_architectures{};
+        std::vector<std::wstring> packageFamilyNames;
+        for (size_t family=0; family < graphSize; ++family)
+        {
+            packageFamilyNames.push_back(Test::Perf::InMemoryPackageCatalog::PackageFamilyName(family));
+        }
+
+        const auto findBestFit{ FindBestFit(catalog, c_minVersion) };
+
+        auto uncached{ Test::Perf::Measure(options.iterations, [&](size_t iteration) {
+            (void)MddCore::PackageResolution::Resolve(catalog, packageFamilyNames[iteration % graphSize], findBestFit);
+        }) };
+        Report(Test::Perf::ToJson("resolve.uncached", graphSize, 1, uncached));
+
+        MddCore::PackageResolutionCache cache;
+        auto cached{ Test::Perf::Measure(options.iterations, [&](size_t iteration) {
+            (void)MddCore::PackageResolution::Resolve(catalog, cache, packageFamilyNames[iteration % graphSize], c_minVersion, c_architectures, findBestFit);
+        }) };
+        Report(Test::Perf::ToJson("resolve.cached", graphSize, 1, cached));
+
+        // Many threads resolving while the catalog occasionally changes (invalidating the cache)
+        for (const auto threads : ThreadCounts(options))
+        {
+            auto contended{ Test::Perf::MeasureConcurrently(threads, options.iterations, [&](size_t threadIndex, size_t iteration) {
+                if ((threadIndex == 0) && (iteration % 256 == 255))
+                {
+                    Test::Perf::InMemoryPackage package;
+                    package.packageFamilyName = L"Test.Perf.Churn_8wekyb3d8bbwe";
+                    package.packageFullName = L"Test.Perf.Churn_1.0." + std::to_wstring(iteration) + L".0_x64__8wekyb3d8bbwe";
+                    catalog.Add(std::move(package));
+                }
+                const auto& packageFamilyName{ packageFamilyNames[(threadIndex + iteration) % graphSize] };
+                (void)MddCore::PackageResolution::Resolve(catalog, cache, packageFamilyName, c_minVersion, c_architectures, findBestFit);
+            }) };
+            Report(Test::Perf::ToJson("resolve.cached.contention", graphSize, threads, contended.samples, contended.elapsedNanoseconds));
+        }
+    }
+}
+
+// Adding and removing a package graph node's entry in PATH
+void BenchmarkPathList(const Options& options)
+{
+    for (const auto graphSize : GraphSizes(options))
+    {
+        Test::Perf::InMemoryPackageCatalog catalog;
+        catalog.Generate(graphSize + 1, 1, 0);
+
+        Test::Perf::InMemoryPathEnvironment path{ BasePath() };
+        MddCore::PathList pathList;
+        for (size_t index=0; index < graphSize; ++index)
+        {
+            pathList.Insert(index, PathListEntry(catalog, index), path);
+        }
+
+        // Add (and then remove) a node in the middle of the package graph
+        const auto entry{ PathListEntry(catalog, graphSize) };
+        const auto middle{ graphSize / 2 };
+        Test::Perf::Samples add;
+        Test::Perf::Samples remove;
+        for (size_t iteration=0; iteration < options.iterations; ++iteration)
+        {
+            add.Add(Test::Perf::Measure(1, [&](size_t) { pathList.Insert(middle, entry, path); }));
+            remove.Add(Test::Perf::Measure(1, [&](size_t) { pathList.Remove(middle, path); }));
+        }
+        Report(Test::Perf::ToJson("add.path", graphSize, 1, add));
+        Report(Test::Perf::ToJson("remove.path", graphSize, 1, remove));
+
+        // Same, but the app prepended to PATH since we last updated it (so our block's not where we left it)
+        Test::Perf::Samples addAfterExternalChange;
+        for (size_t iteration=0; iteration < options.iterations; ++iteration)
+        {
+            std::wstring value;
+            (void)path.Get(value);
+            path.Set(L"C:\\App;" + value);
+            addAfterExternalChange.Add(Test::Perf::Measure(1, [&](size_t) { pathList.Insert(middle, entry, path); }));
+            pathList.Remove(middle, path);
+            (void)path.Get(value);
+            value.erase(value.find(L"C:\\App;"), 7);
+            path.Set(value);
+        }
+        Report(Test::Perf::ToJson("add.path.externallymodified", graphSize, 1, addAfterExternalChange));
+    }
+}
+
+// Adding a batch of package graph nodes, updating PATH per node vs once for the batch (MddAddPackageDependencies)
+void BenchmarkAddMany(const Options& options)
+{
+    for (const auto graphSize : GraphSizes(options))
+    {
+        Test::Perf::InMemoryPackageCatalog catalog;
+        catalog.Generate(graphSize, 1, 0);
+        std::vector<std::wstring> entries;
+        for (size_t index=0; index < graphSize; ++index)
+        {
+            entries.push_back(PathListEntry(catalog, index));
+        }
+
+        const auto iterations{ std::max<size_t>(options.iterations / graphSize, 10) };
+        auto immediate{ Test::Perf::Measure(iterations, [&](size_t) {
+            Test::Perf::InMemoryPathEnvironment path{ BasePath() };
+            MddCore::PathList pathList;
+            for (size_t index=0; index < entries.size(); ++index)
+            {
+                pathList.Insert(index, entries[index], path);
+            }
+        }) };
+        Report(Test::Perf::ToJson("addmany.path.immediate", graphSize, 1, immediate));
+
+        auto deferred{ Test::Perf::Measure(iterations, [&](size_t) {
+            Test::Perf::InMemoryPathEnvironment path{ BasePath() };
+            MddCore::DeferredPathEnvironment deferredPath(path);
+            MddCore::PathList pathList;
+            for (size_t index=0; index < entries.size(); ++index)
+            {
+                pathList.Insert(index, entries[index], deferredPath);
+            }
+            deferredPath.Commit();
+        }) };
+        Report(Test::Perf::ToJson("addmany.path.deferred", graphSize, 1, deferred));
+    }
+}
+
+// WinRT activation: loading a package's cached inproc server table, (re)building the
+// activatableClassId index when the package graph changes, and looking up a class
+
+// The in-memory equivalent of WinRTModuleManager::InprocServer
+struct InprocServer
+{
+    const MddCore::WinRTManifestCacheFormat::InprocModule* inprocModule{};
+    uint32_t threadingModel{};
+};
+using ActivatableClassIndex = MddCore::WinRTActivatableClassIndex<InprocServer>;
+
+// As WinRTModuleManager::Insert() does, under the index's lock
+void RebuildIndex(ActivatableClassIndex& index, const std::vector<std::vector<MddCore::WinRTManifestCacheFormat::InprocModule>>& packages)
+{
+    auto lock{ index.Lock() };
+    index.Rebuild([&](auto&& add)
+    {
+        for (const auto& package : packages)
+        {
+            for (const auto& inprocModule : package)
+            {
+                for (const auto& activatableClass : inprocModule.activatableClasses)
+                {
+                    add(activatableClass.activatableClassId, InprocServer{ &inprocModule, activatableClass.threadingModel });
+                }
+            }
+        }
+    });
+}
+
+// As WinRTModuleManager::GetThreadingType() does, under the index's lock
+bool FindThreadingModel(ActivatableClassIndex& index, const std::wstring& activatableClassId, uint32_t& threadingModel)
+{
+    auto lock{ index.Lock() };
+    const auto inprocServer{ index.Find(activatableClassId) };
+    if (!inprocServer)
+    {
+        return false;
+    }
+    threadingModel = inprocServer->threadingModel;
+    return true;
+}
+
+void BenchmarkActivation(const Options& options)
+{
+    const size_t c_activatableClassesPerPackage{ 16 };
+    for (const auto graphSize : GraphSizes(options))
+    {
+        Test::Perf::InMemoryPackageCatalog catalog;
+        catalog.Generate(graphSize, 1, c_activatableClassesPerPackage);
+
+        // Cache every package's inproc server table
+        Test::Perf::InMemoryFileSystem fileSystem;
+        std::vector<MddCore::WinRTManifestCacheFormat::Key> keys;
+        for (size_t family=0; family < graphSize; ++family)
+        {
+            Test::Perf::InMemoryPackage package;
+            (void)catalog.FindPackage(catalog.FindPackagesByFamily(Test::Perf::InMemoryPackageCatalog::PackageFamilyName(family)).front(), package);
+            MddCore::WinRTManifestCacheFormat::Key key{ package.packageFullName, 4096, 132000000000000000ull };
+            fileSystem.Write(package.path + L"\\AppxManifest.cache", MddCore::WinRTManifestCacheFormat::Serialize(key, package.inprocModules));
+            keys.push_back(std::move(key));
+        }
+
+        // Add = load the table + rebuild the index
+        std::vector<std::vector<MddCore::WinRTManifestCacheFormat::InprocModule>> packages(graphSize);
+        auto load{ Test::Perf::Measure(options.iterations, [&](size_t iteration) {
+            const auto family{ iteration % graphSize };
+            std::vector<uint8_t> data;
+            (void)fileSystem.Read(L"C:\\Program Files\\WindowsApps\\" + keys[family].packageFullName + L"\\AppxManifest.cache", data);
+            (void)MddCore::WinRTManifestCacheFormat::Deserialize(data.data(), data.size(), keys[family], packages[family]);
+        }) };
+        Report(Test::Perf::ToJson("activation.table.load", graphSize, 1, load));
+
+        ActivatableClassIndex index;
+        const auto rebuildIterations{ std::max<size_t>(options.iterations / graphSize, 10) };
+        auto rebuild{ Test::Perf::Measure(rebuildIterations, [&](size_t) { RebuildIndex(index, packages); }) };
+        Report(Test::Perf::ToJson("activation.index.rebuild", graphSize, 1, rebuild));
+
+        // Lookup: hits spread across the graph, and misses (i.e. classes Windows has to find)
+        std::vector<std::wstring> activatableClassIds;
+        for (size_t family=0; family < graphSize; ++family)
+        {
+            for (size_t activatableClass=0; activatableClass < c_activatableClassesPerPackage; ++activatableClass)
+            {
+                activatableClassIds.push_back(Test::Perf::InMemoryPackageCatalog::ActivatableClassId(family, activatableClass));
+            }
+        }
+        uint32_t threadingModel{};
+        auto hit{ Test::Perf::Measure(options.iterations, [&](size_t iteration) {
+            (void)FindThreadingModel(index, activatableClassIds[iteration % activatableClassIds.size()], threadingModel);
+        }) };
+        Report(Test::Perf::ToJson("activation.lookup.hit", graphSize, 1, hit));
+        const std::wstring c_notInPackageGraph{ L"Windows.Foundation.Uri" };
+        auto miss{ Test::Perf::Measure(options.iterations, [&](size_t) {
+            (void)FindThreadingModel(index, c_notInPackageGraph, threadingModel);
+        }) };
+        Report(Test::Perf::ToJson("activation.lookup.miss", graphSize, 1, miss));
+
+        // Many threads activating while the package graph occasionally changes (rebuilding the index under its lock)
+        for (const auto threads : ThreadCounts(options))
+        {
+            auto contended{ Test::Perf::MeasureConcurrently(threads, options.iterations, [&](size_t threadIndex, size_t iteration) {
+                if ((threadIndex == 0) && (iteration % 256 == 255))
+                {
+                    RebuildIndex(index, packages);
+                    return;
+                }
+                uint32_t foundThreadingModel{};
+                (void)FindThreadingModel(index, activatableClassIds[(threadIndex * 7919 + iteration) % activatableClassIds.size()], foundThreadingModel);
+            }) };
+            Report(Test::Perf::ToJson("activation.lookup.contention", graphSize, threads, contended.samples, contended.elapsedNanoseconds));
+        }
+    }
+}
+
+bool ParseOption(const char* arg, const char* name, size_t& value)
+{
+    const auto nameLength{ std::strlen(name) };
+    if ((std::strncmp(arg, name, nameLength) != 0) || (arg[nameLength] != '='))
+    {
+        return false;
+    }
+    value = static_cast<size_t>(std::strtoull(arg + nameLength + 1, nullptr, 10));
+    return value > 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for (int index=1; index < argc; ++index)
+    {
+        const auto arg{ argv[index] };
+        if (!ParseOption(arg, "--iterations", options.iterations) &&
+            !ParseOption(arg, "--max-graph-size", options.maxGraphSize) &&
+            !ParseOption(arg, "--max-threads", options.maxThreads))
+        {
+            std::fprintf(stderr, "Usage: %s [--iterations=N] [--max-graph-size=N] [--max-threads=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    BenchmarkResolve(options);
+    BenchmarkPathList(options);
+    BenchmarkAddMany(options);
+    BenchmarkActivation(options);
+    return 0;
+}
@@ -0,0 +1,245 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(INMEMORYPACKAGECATALOG_H)
+#define INMEMORYPACKAGECATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "PackageCatalog.h"
+#include "PathList.h"
+#include "WinRTManifestCacheFormat.h"
+
+// In-memory stand-ins for what DynamicDependency gets from Windows: the user's
+// package catalog, the file system (for cached manifest tables) and PATH.
+// They let the benchmarks build package graphs of any size without installing
+// packages (or running on Windows).
+namespace Test::Perf
+{
+struct InMemoryPackage
+{
+    std::wstring packageFullName;
+    std::wstring packageFamilyName;
+    uint64_t version{};
+    std::wstring path;
+    bool statusOK{ true };
+    std::vector<MddCore::WinRTManifestCacheFormat::InprocModule> inprocModules;
+};
+
+/// The packages registered for a (simulated) user, for the code that consumes MddCore::IPackageCatalog.
+///
+/// @note Methods are thread safe.
+class InMemoryPackageCatalog : public MddCore::IPackageCatalog
+{
+public:
+    InMemoryPackageCatalog() = default;
+
+    ~InMemoryPackageCatalog() override = default;
+
+    /// Register familyCount package families of versionsPerFamily packages each. Every package
+    /// has one inproc module providing activatableClassesPerPackage WinRT classes.
+    ///
+    /// Family f is named Test.Perf.Framework<f>_8wekyb3d8bbwe and its packages are versions 1.0.<v>.0.
+    void Generate(size_t familyCount, size_t versionsPerFamily, size_t activatableClassesPerPackage)
+    {
+        for (size_t family=0; family < familyCount; ++family)
+        {
+            for (size_t version=0; version < versionsPerFamily; ++version)
+            {
+                InMemoryPackage package;
+                package.packageFamilyName = PackageFamilyName(family);
+                package.packageFullName = L"Test.Perf.Framework" + std::to_wstring(family) + L"_1.0." + std::to_wstring(version) + L".0_x64__8wekyb3d8bbwe";
+                package.version = (static_cast<uint64_t>(1) << 48) | (static_cast<uint64_t>(version) << 16);
+                package.path = L"C:\\Program Files\\WindowsApps\\" + package.packageFullName;
+
+                MddCore::WinRTManifestCacheFormat::InprocModule inprocModule;
+                inprocModule.path = L"Test.Perf.Framework" + std::to_wstring(family) + L".dll";
+                for (size_t activatableClass=0; activatableClass < activatableClassesPerPackage; ++activatableClass)
+                {
+                    inprocModule.activatableClasses.push_back({ ActivatableClassId(family, activatableClass), 1 });   // MddCore::WinRT::ThreadingModel::Both
+                }
+                package.inprocModules.push_back(std::move(inprocModule));
+
+                Add(std::move(package));
+            }
+        }
+    }
+
+    static std::wstring PackageFamilyName(size_t family)
+    {
+        return L"Test.Perf.Framework" + std::to_wstring(family) + L"_8wekyb3d8bbwe";
+    }
+
+    static std::wstring ActivatableClassId(size_t family, size_t activatableClass)
+    {
+        return L"Test.Perf.Framework" + std::to_wstring(family) + L".Class" + std::to_wstring(activatableClass);
+    }
+
+    void Add(InMemoryPackage package)
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        m_families[package.packageFamilyName].push_back(package.packageFullName);
+        const auto packageFullName{ package.packageFullName };
+        m_packages.insert_or_assign(packageFullName, std::move(package));
+        ++m_changeId;
+    }
+
+    void Remove(const std::wstring& packageFullName)
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        auto iterator{ m_packages.find(packageFullName) };
+        if (iterator == m_packages.end())
+        {
+            return;
+        }
+        auto& family{ m_families[iterator->second.packageFamilyName] };
+        for (auto member{ family.begin() }; member != family.end(); ++member)
+        {
+            if (*member == packageFullName)
+            {
+                family.erase(member);
+                break;
+            }
+        }
+        m_packages.erase(iterator);
+        ++m_changeId;
+    }
+
+    /// Return the full names of the packages in the family.
+    std::vector<std::wstring> FindPackagesByFamily(const std::wstring& packageFamilyName) override
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        auto iterator{ m_families.find(packageFamilyName) };
+        if (iterator == m_families.end())
+        {
+            return {};
+        }
+        return iterator->second;
+    }
+
+    /// Return true and a copy of the package if it's registered.
+    bool FindPackage(const std::wstring& packageFullName, InMemoryPackage& package) const
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        auto iterator{ m_packages.find(packageFullName) };
+        if (iterator == m_packages.end())
+        {
+            return false;
+        }
+        package = iterator->second;
+        return true;
+    }
+
+    bool IsPackageStatusOK(const std::wstring& packageFullName) override
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        ++m_statusChecks;
+        auto iterator{ m_packages.find(packageFullName) };
+        return (iterator != m_packages.end()) && iterator->second.statusOK;
+    }
+
+    /// Add() and Remove() always bump ChangeId().
+    bool IsTrackingChanges() override
+    {
+        return true;
+    }
+
+    /// Changes whenever a package is added or removed.
+    uint64_t ChangeId() override
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        return m_changeId;
+    }
+
+    /// Number of IsPackageStatusOK() calls so far (the expensive query on Windows).
+    uint64_t StatusChecks() const
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        return m_statusChecks;
+    }
+
+private:
+    mutable std::mutex m_lock;
+    uint64_t m_changeId{ 1 };
+    uint64_t m_statusChecks{};
+    std::map<std::wstring, std::vector<std::wstring>> m_families;
+    std::map<std::wstring, InMemoryPackage> m_packages;
+};
+
+/// Files, by path.
+///
+/// @note Methods are thread safe.
+class InMemoryFileSystem
+{
+public:
+    void Write(const std::wstring& path, std::vector<uint8_t> data)
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        m_files.insert_or_assign(path, std::move(data));
+    }
+
+    bool Read(const std::wstring& path, std::vector<uint8_t>& data) const
+    {
+        auto lock{ std::unique_lock<std::mutex>(m_lock) };
+        auto iterator{ m_files.find(path) };
+        if (iterator == m_files.end())
+        {
+            return false;
+        }
+        data = iterator->second;
+        return true;
+    }
+
+private:
+    mutable std::mutex m_lock;
+    std::map<std::wstring, std::vector<uint8_t>> m_files;
+};
+
+/// The PATH environment variable.
+class InMemoryPathEnvironment : public MddCore::IPathEnvironment
+{
+public:
+    InMemoryPathEnvironment() = default;
+
+    InMemoryPathEnvironment(const std::wstring& value) :
+        m_value(value),
+        m_exists(true)
+    {
+    }
+
+    bool Get(std::wstring& value) override
+    {
+        if (!m_exists)
+        {
+            return false;
+        }
+        value = m_value;
+        return true;
+    }
+
+    void Set(const std::wstring& value) override
+    {
+        m_value = value;
+        m_exists = !value.empty();
+        ++m_setCount;
+    }
+
+    size_t SetCount() const
+    {
+        return m_setCount;
+    }
+
+private:
+    std::wstring m_value;
+    bool m_exists{};
+    size_t m_setCount{};
+};
+}
+
+#endif // INMEMORYPACKAGECATALOG_H
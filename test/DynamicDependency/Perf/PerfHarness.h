@@ -0,0 +1,193 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PERFHARNESS_H)
+#define PERFHARNESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Timing, statistics and reporting for DynamicDependency benchmarks.
+//
+// This header only depends on the C++ standard library so the same harness
+// reports measurements from the portable benchmarks (DynamicDependencyPerf.cpp)
+// and the Windows tests driving the real API (Test_Win32_Perf.cpp).
+namespace Test::Perf
+{
+using Clock = std::chrono::steady_clock;
+
+/// Durations (in nanoseconds) of repeated operations.
+class Samples
+{
+public:
+    void Add(int64_t nanoseconds)
+    {
+        m_nanoseconds.push_back(nanoseconds);
+    }
+
+    void Add(const Samples& other)
+    {
+        m_nanoseconds.insert(m_nanoseconds.end(), other.m_nanoseconds.begin(), other.m_nanoseconds.end());
+    }
+
+    size_t Count() const
+    {
+        return m_nanoseconds.size();
+    }
+
+    struct Summary
+    {
+        size_t count{};
+        int64_t min{};
+        int64_t median{};
+        int64_t p90{};
+        int64_t p99{};
+        int64_t max{};
+        double mean{};
+    };
+
+    Summary Summarize() const
+    {
+        Summary summary;
+        summary.count = m_nanoseconds.size();
+        if (summary.count == 0)
+        {
+            return summary;
+        }
+
+        auto sorted{ m_nanoseconds };
+        std::sort(sorted.begin(), sorted.end());
+        summary.min = sorted.front();
+        summary.max = sorted.back();
+        summary.median = Percentile(sorted, 50);
+        summary.p90 = Percentile(sorted, 90);
+        summary.p99 = Percentile(sorted, 99);
+        double total{};
+        for (const auto nanoseconds : sorted)
+        {
+            total += static_cast<double>(nanoseconds);
+        }
+        summary.mean = total / static_cast<double>(summary.count);
+        return summary;
+    }
+
+private:
+    static int64_t Percentile(const std::vector<int64_t>& sorted, size_t percentile)
+    {
+        const auto index{ (sorted.size() - 1) * percentile / 100 };
+        return sorted[index];
+    }
+
+private:
+    std::vector<int64_t> m_nanoseconds;
+};
+
+/// Time each of iterations calls to operation(iteration).
+template <typename Operation>
+Samples Measure(size_t iterations, Operation&& operation)
+{
+    Samples samples;
+    for (size_t iteration=0; iteration < iterations; ++iteration)
+    {
+        const auto start{ Clock::now() };
+        operation(iteration);
+        const auto stop{ Clock::now() };
+        samples.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    }
+    return samples;
+}
+
+/// Result of running an operation on multiple threads at once.
+struct ConcurrentSamples
+{
+    Samples samples;
+    int64_t elapsedNanoseconds{};
+};
+
+/// Time iterationsPerThread calls to operation(threadIndex, iteration) on each of threadCount threads.
+/// The threads are released together so they contend for whatever the operation shares.
+template <typename Operation>
+ConcurrentSamples MeasureConcurrently(size_t threadCount, size_t iterationsPerThread, Operation&& operation)
+{
+    std::vector<Samples> samplesPerThread(threadCount);
+    std::atomic<size_t> ready{};
+    std::atomic<bool> go{};
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (size_t threadIndex=0; threadIndex < threadCount; ++threadIndex)
+    {
+        threads.emplace_back([&, threadIndex]() {
+            ++ready;
+            while (!go.load())
+            {
+                std::this_thread::yield();
+            }
+            samplesPerThread[threadIndex] = Measure(iterationsPerThread, [&](size_t iteration) {
+                operation(threadIndex, iteration);
+            });
+        });
+    }
+    while (ready.load() < threadCount)
+    {
+        std::this_thread::yield();
+    }
+
+    const auto start{ Clock::now() };
+    go = true;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const auto stop{ Clock::now() };
+
+    ConcurrentSamples result;
+    for (const auto& samples : samplesPerThread)
+    {
+        result.samples.Add(samples);
+    }
+    result.elapsedNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return result;
+}
+
+/// A benchmark result as one line of JSON (JSON Lines), e.g.
+///
+///     {"benchmark":"pathlist.insert","graphSize":64,"threads":1,"count":1000,"minNs":80,...,"opsPerSecond":1.2e+07}
+///
+/// @param graphSize the number of packages in the package graph (or catalog) the benchmark ran against.
+/// @param elapsedNanoseconds wall time to compute throughput, or 0 to compute it from the samples.
+inline std::string ToJson(
+    const char* benchmark,
+    size_t graphSize,
+    size_t threads,
+    const Samples& samples,
+    int64_t elapsedNanoseconds = 0)
+{
+    const auto summary{ samples.Summarize() };
+    if (elapsedNanoseconds == 0)
+    {
+        elapsedNanoseconds = static_cast<int64_t>(summary.mean * static_cast<double>(summary.count));
+    }
+    const double opsPerSecond{ elapsedNanoseconds > 0 ? static_cast<double>(summary.count) * 1e9 / static_cast<double>(elapsedNanoseconds) : 0.0 };
+
+    char buffer[512]{};
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"benchmark\":\"%s\",\"graphSize\":%zu,\"threads\":%zu,\"count\":%zu,"
+                  "\"minNs\":%lld,\"medianNs\":%lld,\"p90Ns\":%lld,\"p99Ns\":%lld,\"maxNs\":%lld,\"meanNs\":%.1f,"
+                  "\"opsPerSecond\":%.6g}",
+                  benchmark, graphSize, threads, summary.count,
+                  static_cast<long long>(summary.min), static_cast<long long>(summary.median),
+                  static_cast<long long>(summary.p90), static_cast<long long>(summary.p99),
+                  static_cast<long long>(summary.max), summary.mean, opsPerSecond);
+    return buffer;
+}
+}
+
+#endif // PERFHARNESS_H
@@ -0,0 +1,133 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// WinRT activation of classes in the process' SxS manifest (see SxSActivationPerf.exe.manifest),
+// with and without UrfwEnableFactoryCache. Only an exe's manifest declares SxS classes so this
+// runs as its own process; Test_Win32::Perf_Activation runs it and logs what it measures.
+//
+// Results are written to stdout as JSON Lines (see Test::Perf::ToJson()). Exits non-zero if
+// any activation failed, including while the factory cache was being turned on and off.
+
+#include <windows.h>
+#include <roapi.h>
+#include <winstring.h>
+
+#include <wil/com.h>
+#include <wil/resource.h>
+#include <wil/result.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <string>
+
+#include "..\PerfHarness.h"
+
+typedef void (WINAPI* UrfwEnableFactoryCacheFunction)(BOOL enable);
+
+namespace
+{
+std::atomic<HRESULT> g_firstFailure{ S_OK };
+
+void Report(const std::string& json)
+{
+    std::printf("%s\n", json.c_str());
+    std::fflush(stdout);
+}
+
+void Check(HRESULT hr, const void* result)
+{
+    if (FAILED(hr) || !result)
+    {
+        auto expected{ S_OK };
+        (void)g_firstFailure.compare_exchange_strong(expected, FAILED(hr) ? hr : E_POINTER);
+    }
+}
+
+void GetFactory(HSTRING activatableClassId)
+{
+    wil::com_ptr<IActivationFactory> factory;
+    Check(RoGetActivationFactory(activatableClassId, IID_PPV_ARGS(&factory)), factory.get());
+}
+
+void ActivateInstance(HSTRING activatableClassId)
+{
+    wil::com_ptr<IInspectable> instance;
+    Check(RoActivateInstance(activatableClassId, instance.put()), instance.get());
+}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    size_t iterations{ 1000 };
+    size_t maxThreads{ 8 };
+    for (int index=1; index < argc; ++index)
+    {
+        if (std::wcsncmp(argv[index], L"--iterations=", 13) == 0)
+        {
+            iterations = std::wcstoul(argv[index] + 13, nullptr, 10);
+        }
+        else if (std::wcsncmp(argv[index], L"--max-threads=", 14) == 0)
+        {
+            maxThreads = std::wcstoul(argv[index] + 14, nullptr, 10);
+        }
+    }
+    if ((iterations == 0) || (maxThreads == 0))
+    {
+        std::fwprintf(stderr, L"Usage: %ls [--iterations=N] [--max-threads=N]\n", argv[0]);
+        return 1;
+    }
+
+    auto roInitialize{ wil::RoInitialize_failfast(RO_INIT_MULTITHREADED) };
+
+    // Loading the runtime hooks activation and loads our SxS manifest
+    wil::unique_hmodule windowsAppRuntime{ LoadLibraryExW(L"Microsoft.WindowsAppRuntime.dll", nullptr, LOAD_LIBRARY_SEARCH_APPLICATION_DIR | LOAD_LIBRARY_SEARCH_SYSTEM32) };
+    FAIL_FAST_LAST_ERROR_IF_NULL(windowsAppRuntime);
+    auto enableFactoryCache{ reinterpret_cast<UrfwEnableFactoryCacheFunction>(GetProcAddress(windowsAppRuntime.get(), "UrfwEnableFactoryCache")) };
+    FAIL_FAST_LAST_ERROR_IF_NULL(enableFactoryCache);
+
+    wil::unique_hstring activatableClassIdString;
+    FAIL_FAST_IF_FAILED(WindowsCreateString(L"Microsoft.Test.DynamicDependency.Widgets.Widget1", 48, &activatableClassIdString));
+    const auto activatableClassId{ activatableClassIdString.get() };
+
+    // The first activation loads the component so it's measured separately from the steady state
+    Report(Test::Perf::ToJson("api.activation.sxs.first", 1, 1, Test::Perf::Measure(1, [&](size_t) { GetFactory(activatableClassId); })));
+
+    Report(Test::Perf::ToJson("api.activation.sxs", 1, 1, Test::Perf::Measure(iterations, [&](size_t) { GetFactory(activatableClassId); })));
+    Report(Test::Perf::ToJson("api.activateinstance.sxs", 1, 1, Test::Perf::Measure(iterations, [&](size_t) { ActivateInstance(activatableClassId); })));
+
+    enableFactoryCache(TRUE);
+    Report(Test::Perf::ToJson("api.activation.sxs.cached", 1, 1, Test::Perf::Measure(iterations, [&](size_t) { GetFactory(activatableClassId); })));
+    Report(Test::Perf::ToJson("api.activateinstance.sxs.cached", 1, 1, Test::Perf::Measure(iterations, [&](size_t) { ActivateInstance(activatableClassId); })));
+
+    // Many threads activating while the cache is turned off and on again (dropping and republishing the factory)
+    for (size_t threads=1; threads <= maxThreads; threads *= 2)
+    {
+        auto contended{ Test::Perf::MeasureConcurrently(threads, iterations, [&](size_t threadIndex, size_t iteration) {
+            if ((threadIndex == 0) && (iteration % 64 == 63))
+            {
+                enableFactoryCache(FALSE);
+                enableFactoryCache(TRUE);
+            }
+            if (iteration % 2 == 0)
+            {
+                GetFactory(activatableClassId);
+            }
+            else
+            {
+                ActivateInstance(activatableClassId);
+            }
+        }) };
+        Report(Test::Perf::ToJson("api.activation.sxs.cached.contention", 1, threads, contended.samples, contended.elapsedNanoseconds));
+    }
+    enableFactoryCache(FALSE);
+
+    const auto hr{ g_firstFailure.load() };
+    if (FAILED(hr))
+    {
+        std::fwprintf(stderr, L"Activation failed: 0x%08X\n", static_cast<unsigned int>(hr));
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "DDLMResolutionCache.h"
+
+#include "PerfHarness.h"
+#include "PortableTest.h"
+
+namespace
+{
+    /// A catalog whose packages and stamp the test controls, counting what's asked of it.
+    class FakeDDLMPackageCatalog : public MddBootstrap::IDDLMPackageCatalog
+    {
+    public:
+        struct Package
+        {
+            std::wstring packagePath;
+            bool isStatusOK{ true };
+        };
+
+        std::map<std::wstring, Package> packages;
+        uint64_t stamp{ 0x01D9000012345678 };
+
+        size_t stampCount{};
+        size_t pathCount{};
+        size_t statusCount{};
+
+        uint64_t Stamp() override
+        {
+            ++stampCount;
+            return stamp;
+        }
+
+        bool TryGetPackagePath(const std::wstring& packageFullName, std::wstring& packagePath) override
+        {
+            ++pathCount;
+            const auto package{ packages.find(packageFullName) };
+            if (package == packages.end())
+            {
+                return false;
+            }
+            packagePath = package->second.packagePath;
+            return true;
+        }
+
+        bool IsPackageStatusOK(const std::wstring& packageFullName, const std::wstring& packagePath) override
+        {
+            ++statusCount;
+            const auto package{ packages.find(packageFullName) };
+            return (package != packages.end()) && (package->second.packagePath == packagePath) && package->second.isStatusOK;
+        }
+    };
+
+    const std::wstring c_ddlmPackageFullName{ L"Microsoft.WinAppRuntime.DDLM.4.1-x6_4.1.0.0_x64__8wekyb3d8bbwe" };
+    const std::wstring c_ddlmPackagePath{ L"C:\\Program Files\\WindowsApps\\Microsoft.WinAppRuntime.DDLM.4.1-x6_4.1.0.0_x64__8wekyb3d8bbwe" };
+    const std::wstring c_frameworkPackageFullName{ L"Microsoft.WindowsAppRuntime.4.1_4.1.0.0_x64__8wekyb3d8bbwe" };
+    const std::wstring c_frameworkPackagePath{ L"C:\\Program Files\\WindowsApps\\Microsoft.WindowsAppRuntime.4.1_4.1.0.0_x64__8wekyb3d8bbwe" };
+
+    MddBootstrap::DDLMResolutionCriteria Criteria(bool viaEnumeration)
+    {
+        MddBootstrap::DDLMResolutionCriteria criteria;
+        criteria.majorMinorVersion = 0x00040001;
+        criteria.versionTag = L"preview";
+        criteria.minVersion = 0x0004000100000000;
+        criteria.architecture = 9;
+        criteria.viaEnumeration = viaEnumeration;
+        return criteria;
+    }
+
+    MddBootstrap::DDLMResolution Resolution(const FakeDDLMPackageCatalog& catalog)
+    {
+        MddBootstrap::DDLMResolution resolution;
+        resolution.catalogStamp = catalog.stamp;
+        resolution.ddlmPackageFamilyName = L"Microsoft.WinAppRuntime.DDLM.4.1-x6_8wekyb3d8bbwe";
+        resolution.ddlmPackageFullName = c_ddlmPackageFullName;
+        resolution.ddlmPackagePath = c_ddlmPackagePath;
+        resolution.ddlmClsid = L"{32E7CF70-038C-429A-BD49-88850F1B4A11}";
+        resolution.frameworkPackageFamilyName = L"Microsoft.WindowsAppRuntime.4.1_8wekyb3d8bbwe";
+        resolution.frameworkPackageFullName = c_frameworkPackageFullName;
+        resolution.frameworkPackagePath = c_frameworkPackagePath;
+        return resolution;
+    }
+
+    FakeDDLMPackageCatalog Catalog()
+    {
+        FakeDDLMPackageCatalog catalog;
+        catalog.packages[c_ddlmPackageFullName] = { c_ddlmPackagePath };
+        catalog.packages[c_frameworkPackageFullName] = { c_frameworkPackagePath };
+        return catalog;
+    }
+}
+
+PORTABLE_TEST(DDLMResolutionCache_RoundTrips)
+{
+    const auto catalog{ Catalog() };
+    const auto expected{ Resolution(catalog) };
+
+    MddBootstrap::DDLMResolution actual;
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::Deserialize(MddBootstrap::DDLMResolutionCache::Serialize(expected), actual));
+    PORTABLE_VERIFY_ARE_EQUAL(expected.catalogStamp, actual.catalogStamp);
+    PORTABLE_VERIFY(expected.ddlmPackageFamilyName == actual.ddlmPackageFamilyName);
+    PORTABLE_VERIFY(expected.ddlmPackageFullName == actual.ddlmPackageFullName);
+    PORTABLE_VERIFY(expected.ddlmPackagePath == actual.ddlmPackagePath);
+    PORTABLE_VERIFY(expected.ddlmClsid == actual.ddlmClsid);
+    PORTABLE_VERIFY(expected.frameworkPackageFamilyName == actual.frameworkPackageFamilyName);
+    PORTABLE_VERIFY(expected.frameworkPackageFullName == actual.frameworkPackageFullName);
+    PORTABLE_VERIFY(expected.frameworkPackagePath == actual.frameworkPackagePath);
+
+    // Fields the algorithm doesn't use are persisted empty
+    auto enumeration{ expected };
+    enumeration.ddlmClsid.clear();
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::Deserialize(MddBootstrap::DDLMResolutionCache::Serialize(enumeration), actual));
+    PORTABLE_VERIFY(actual.ddlmClsid.empty());
+    PORTABLE_VERIFY(actual.ddlmPackageFamilyName == enumeration.ddlmPackageFamilyName);
+}
+
+PORTABLE_TEST(DDLMResolutionCache_RejectsMalformedText)
+{
+    const auto catalog{ Catalog() };
+    const auto text{ MddBootstrap::DDLMResolutionCache::Serialize(Resolution(catalog)) };
+
+    // A failed parse leaves the output alone
+    MddBootstrap::DDLMResolution resolution;
+    resolution.ddlmClsid = L"untouched";
+
+    auto otherVersion{ text };
+    otherVersion[4] = L'2';
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(otherVersion, resolution));
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(L"", resolution));
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(text.substr(0, text.rfind(L'\n')), resolution));
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(text + L"\nextra", resolution));
+
+    auto badStamp{ text };
+    badStamp[6] = L'G';
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(badStamp, resolution));
+    auto shortStamp{ text };
+    shortStamp.erase(6, 1);
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::Deserialize(shortStamp, resolution));
+
+    PORTABLE_VERIFY(resolution.ddlmClsid == L"untouched");
+}
+
+PORTABLE_TEST(DDLMResolutionCache_IsUsableUntilTheCatalogChanges)
+{
+    auto catalog{ Catalog() };
+    const auto resolution{ Resolution(catalog) };
+
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), resolution, catalog));
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(true), resolution, catalog));
+
+    // A hit costs one stamp plus a path and a status check per package
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 2 }, catalog.stampCount);
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 4 }, catalog.pathCount);
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 4 }, catalog.statusCount);
+
+    // Packages registered (or unregistered) since may be a better fit
+    ++catalog.stamp;
+    catalog.statusCount = 0;
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), resolution, catalog));
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 0 }, catalog.statusCount);
+
+    // An unknown stamp never matches, even a resolution made without one
+    catalog.stamp = 0;
+    auto unstamped{ resolution };
+    unstamped.catalogStamp = 0;
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), unstamped, catalog));
+}
+
+PORTABLE_TEST(DDLMResolutionCache_RejectsMovedOrDamagedPackages)
+{
+    const auto criteria{ Criteria(false) };
+    {
+        auto catalog{ Catalog() };
+        const auto resolution{ Resolution(catalog) };
+        catalog.packages.erase(c_frameworkPackageFullName);
+        PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog));
+    }
+    {
+        auto catalog{ Catalog() };
+        const auto resolution{ Resolution(catalog) };
+        catalog.packages[c_ddlmPackageFullName].packagePath = L"D:\\WindowsApps\\Microsoft.WinAppRuntime.DDLM.4.1-x6_4.1.0.0_x64__8wekyb3d8bbwe";
+        PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog));
+        PORTABLE_VERIFY_ARE_EQUAL(size_t{ 0 }, catalog.statusCount);
+    }
+    {
+        auto catalog{ Catalog() };
+        const auto resolution{ Resolution(catalog) };
+        catalog.packages[c_frameworkPackageFullName].isStatusOK = false;
+        PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog));
+    }
+    {
+        // Paths are compared case-insensitively, and the status check sees the catalog's path
+        auto catalog{ Catalog() };
+        auto resolution{ Resolution(catalog) };
+        resolution.ddlmPackagePath = L"c:\\program files\\windowsapps\\microsoft.winappruntime.ddlm.4.1-x6_4.1.0.0_x64__8wekyb3d8bbwe";
+        PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog));
+    }
+}
+
+PORTABLE_TEST(DDLMResolutionCache_RequiresTheFieldsTheAlgorithmNeeds)
+{
+    auto catalog{ Catalog() };
+    const auto resolution{ Resolution(catalog) };
+
+    auto noClsid{ resolution };
+    noClsid.ddlmClsid.clear();
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), noClsid, catalog));
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(true), noClsid, catalog));
+
+    auto noFamily{ resolution };
+    noFamily.ddlmPackageFamilyName.clear();
+    PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(true), noFamily, catalog));
+    PORTABLE_VERIFY(MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), noFamily, catalog));
+
+    for (auto field : { &MddBootstrap::DDLMResolution::ddlmPackageFullName, &MddBootstrap::DDLMResolution::ddlmPackagePath,
+                        &MddBootstrap::DDLMResolution::frameworkPackageFamilyName, &MddBootstrap::DDLMResolution::frameworkPackageFullName,
+                        &MddBootstrap::DDLMResolution::frameworkPackagePath })
+    {
+        auto incomplete{ resolution };
+        (incomplete.*field).clear();
+        PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(false), incomplete, catalog));
+        PORTABLE_VERIFY(!MddBootstrap::DDLMResolutionCache::IsUsable(Criteria(true), incomplete, catalog));
+    }
+}
+
+PORTABLE_TEST(DDLMResolutionCriteria_DistinguishesEveryField)
+{
+    const auto criteria{ Criteria(false) };
+    PORTABLE_VERIFY(criteria.ToString() == L"4.1;preview;0004000100000000;9;X;;");
+
+    auto other{ criteria };
+    other.viaEnumeration = true;
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+    other = criteria;
+    other.versionTag.clear();
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+    other = criteria;
+    other.minVersion = 0;
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+    other = criteria;
+    other.architecture = 12;
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+    other = criteria;
+    other.ddlmPackageNamePrefix = L"Test.DDLM";
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+    other = criteria;
+    other.ddlmPackagePublisherId = L"8wekyb3d8bbwe";
+    PORTABLE_VERIFY(other.ToString() != criteria.ToString());
+}
+
+PORTABLE_BENCHMARK(DDLMResolutionCache_Benchmark)
+{
+    // The cache's own cost on a hit i.e. parsing the persisted text and validating it. The catalog's
+    // queries (a registry key's last write time, the packages' paths and status) come on top of this;
+    // Test_Win32's MddBootstrap tests measure those against installed packages
+    const size_t c_iterations{ 20000 };
+    auto catalog{ Catalog() };
+    const auto criteria{ Criteria(false) };
+    const auto text{ MddBootstrap::DDLMResolutionCache::Serialize(Resolution(catalog)) };
+
+    bool usable{ true };
+    auto samples{ Test::Perf::Measure(c_iterations, [&](size_t) {
+        MddBootstrap::DDLMResolution resolution;
+        usable = usable && MddBootstrap::DDLMResolutionCache::Deserialize(text, resolution) &&
+                 MddBootstrap::DDLMResolutionCache::IsUsable(criteria, resolution, catalog);
+    }) };
+    PORTABLE_VERIFY(usable);
+    std::printf("%s\n", Test::Perf::ToJson("ddlmresolutioncache.hit", 1, 1, samples).c_str());
+    std::fprintf(stderr, "  per hit: stamp=%zu path=%zu status=%zu\n",
+                 catalog.stampCount / c_iterations, catalog.pathCount / c_iterations, catalog.statusCount / c_iterations);
+}
@@ -0,0 +1,284 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <cstdint>
+#include <cwctype>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PackageDependencyLog.h"
+
+#include "PortableTest.h"
+
+namespace
+{
+    using RecordType = MddCore::PackageDependencyLog::RecordType;
+
+    std::wstring ToKey(const std::wstring& packageDependencyId)
+    {
+        std::wstring key{ packageDependencyId };
+        for (auto& c : key)
+        {
+            c = static_cast<wchar_t>(std::towupper(c));
+        }
+        return key;
+    }
+
+    /// A log file's contents, and a log replaying it the way PackageDependencyStore does
+    /// i.e. only what's been appended since the last time it looked.
+    struct LogFile
+    {
+        std::vector<uint8_t> data;
+        MddCore::PackageDependencyLog log{ &ToKey };
+        size_t invalidRecords{};
+        size_t unrecoverableRecords{};
+
+        void Append(RecordType type, const std::wstring& id, const std::string& json = std::string())
+        {
+            const auto record{ MddCore::PackageDependencyLog::MakeRecord(type, id, json) };
+            data.insert(data.end(), record.begin(), record.end());
+        }
+
+        size_t Refresh()
+        {
+            if (data.size() < log.Offset())
+            {
+                // Replaced
+                log.Reset();
+            }
+            return log.Replay(data.data() + log.Offset(), data.size() - static_cast<size_t>(log.Offset()), [&](uint64_t, bool isRecoverable) {
+                ++(isRecoverable ? invalidRecords : unrecoverableRecords);
+            });
+        }
+
+        std::string Find(const std::wstring& id) const
+        {
+            const auto json{ log.Find(id) };
+            return json ? *json : std::string();
+        }
+    };
+}
+
+PORTABLE_TEST(PackageDependencyLog_ReplaysTheLatestRecordPerId)
+{
+    LogFile file;
+    file.Append(RecordType::Save, L"a", "{1}");
+    file.Append(RecordType::Save, L"b", "{2}");
+    file.Append(RecordType::Save, L"a", "{3}");
+    file.Append(RecordType::Delete, L"b");
+    file.Append(RecordType::Delete, L"c");
+
+    PORTABLE_VERIFY_ARE_EQUAL(file.data.size(), file.Refresh());
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, file.log.Count());
+    PORTABLE_VERIFY(file.Find(L"a") == "{3}");
+    PORTABLE_VERIFY(file.log.Find(L"b") == nullptr);
+    PORTABLE_VERIFY(file.log.Find(L"c") == nullptr);
+
+    // Only the live record counts as live
+    PORTABLE_VERIFY_ARE_EQUAL(MddCore::PackageDependencyLog::MakeRecord(RecordType::Save, L"A", "{3}").size(), static_cast<size_t>(file.log.LiveSize()));
+
+    // Only what's appended since is replayed
+    file.Append(RecordType::Save, L"b", "{4}");
+    const auto appended{ MddCore::PackageDependencyLog::MakeRecord(RecordType::Save, L"b", "{4}").size() };
+    PORTABLE_VERIFY_ARE_EQUAL(appended, file.Refresh());
+    PORTABLE_VERIFY(file.Find(L"b") == "{4}");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 0 }, file.Refresh());
+}
+
+PORTABLE_TEST(PackageDependencyLog_WaitsForATornFinalRecord)
+{
+    LogFile file;
+    file.Append(RecordType::Save, L"a", "{1}");
+    const auto complete{ file.data.size() };
+    file.Append(RecordType::Save, L"b", "{2}");
+    const auto full{ file.data };
+
+    // Truncated anywhere in the last record (its header or its body) it's left for later
+    for (size_t size : { complete + 1, complete + sizeof(MddCore::PackageDependencyLog::RecordHeader) - 1,
+                         complete + sizeof(MddCore::PackageDependencyLog::RecordHeader), full.size() - 1 })
+    {
+        LogFile torn;
+        torn.data.assign(full.begin(), full.begin() + size);
+        PORTABLE_VERIFY_ARE_EQUAL(complete, torn.Refresh());
+        PORTABLE_VERIFY_ARE_EQUAL(static_cast<uint64_t>(complete), torn.log.Offset());
+        PORTABLE_VERIFY(torn.Find(L"a") == "{1}");
+        PORTABLE_VERIFY(torn.log.Find(L"b") == nullptr);
+        PORTABLE_VERIFY_ARE_EQUAL(size_t{ 0 }, torn.invalidRecords + torn.unrecoverableRecords);
+
+        // ...and replayed once the rest of it is written
+        torn.data = full;
+        PORTABLE_VERIFY_ARE_EQUAL(full.size() - complete, torn.Refresh());
+        PORTABLE_VERIFY(torn.Find(L"b") == "{2}");
+    }
+}
+
+PORTABLE_TEST(PackageDependencyLog_SkipsCorruptRecords)
+{
+    LogFile file;
+    file.Append(RecordType::Save, L"a", "{1}");
+    const auto corruptOffset{ file.data.size() };
+    file.Append(RecordType::Save, L"b", "{2}");
+    file.Append(RecordType::Save, L"c", "{3}");
+
+    // A bad checksum costs only that record
+    file.data[file.data.size() - 1 - MddCore::PackageDependencyLog::MakeRecord(RecordType::Save, L"c", "{3}").size()] ^= 0xFF;
+    PORTABLE_VERIFY_ARE_EQUAL(file.data.size(), file.Refresh());
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, file.invalidRecords);
+    PORTABLE_VERIFY(file.Find(L"a") == "{1}");
+    PORTABLE_VERIFY(file.log.Find(L"b") == nullptr);
+    PORTABLE_VERIFY(file.Find(L"c") == "{3}");
+
+    // Something that isn't a record stops the replay there
+    LogFile garbage;
+    garbage.Append(RecordType::Save, L"a", "{1}");
+    garbage.data.insert(garbage.data.end(), sizeof(MddCore::PackageDependencyLog::RecordHeader), 0xCC);
+    garbage.Append(RecordType::Save, L"b", "{2}");
+    PORTABLE_VERIFY_ARE_EQUAL(corruptOffset, garbage.Refresh());
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, garbage.unrecoverableRecords);
+    PORTABLE_VERIFY(garbage.log.Find(L"b") == nullptr);
+}
+
+PORTABLE_TEST(PackageDependencyLog_FoldsIdCase)
+{
+    LogFile file;
+    file.Append(RecordType::Save, L"MyPackageDependency", "{1}");
+    file.Refresh();
+    PORTABLE_VERIFY(file.Find(L"mypackagedependency") == "{1}");
+    PORTABLE_VERIFY(file.Find(L"MYPACKAGEDEPENDENCY") == "{1}");
+
+    // Records for the same id in a different case supersede (and delete) each other
+    file.Append(RecordType::Save, L"MYPACKAGEDEPENDENCY", "{2}");
+    file.Refresh();
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, file.log.Count());
+    PORTABLE_VERIFY(file.Find(L"MyPackageDependency") == "{2}");
+    file.Append(RecordType::Delete, L"mypackagedependency");
+    file.Refresh();
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 0 }, file.log.Count());
+    PORTABLE_VERIFY_ARE_EQUAL(uint64_t{ 0 }, file.log.LiveSize());
+}
+
+PORTABLE_TEST(PackageDependencyLog_CompactsWhenMostlyDead)
+{
+    LogFile file;
+    const std::string json(200, 'j');
+    for (int index=0; index < 16; ++index)
+    {
+        file.Append(RecordType::Save, L"live" + std::to_wstring(index), json);
+    }
+    file.Refresh();
+    PORTABLE_VERIFY(!file.log.IsCompactable());
+
+    // Big but mostly live isn't worth it
+    const std::string bigJson(MddCore::PackageDependencyLog::c_compactThreshold, 'b');
+    file.Append(RecordType::Save, L"big", bigJson);
+    file.Refresh();
+    PORTABLE_VERIFY(file.log.Offset() >= MddCore::PackageDependencyLog::c_compactThreshold);
+    PORTABLE_VERIFY(!file.log.IsCompactable());
+
+    // Mostly dead is
+    file.Append(RecordType::Delete, L"big");
+    file.Refresh();
+    PORTABLE_VERIFY(file.log.IsCompactable());
+
+    // The compacted log replaces the original and replays to the same package dependencies
+    file.data = file.log.Compact();
+    file.Refresh();
+    PORTABLE_VERIFY_ARE_EQUAL(static_cast<uint64_t>(file.data.size()), file.log.Offset());
+    PORTABLE_VERIFY_ARE_EQUAL(file.log.Offset(), file.log.LiveSize());
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 16 }, file.log.Count());
+    PORTABLE_VERIFY(file.log.Find(L"big") == nullptr);
+    for (int index=0; index < 16; ++index)
+    {
+        PORTABLE_VERIFY(file.Find(L"LIVE" + std::to_wstring(index)) == json);
+    }
+    PORTABLE_VERIFY(!file.log.IsCompactable());
+}
+
+namespace
+{
+    struct FakeStore
+    {
+        std::map<std::wstring, std::string> packageDependencies;
+        bool failSave{};
+        size_t saveCount{};
+
+        std::string Find(const std::wstring& id)
+        {
+            const auto iterator{ packageDependencies.find(ToKey(id)) };
+            return iterator != packageDependencies.end() ? iterator->second : std::string();
+        }
+
+        bool TrySave(const std::wstring& id, const std::string& json)
+        {
+            ++saveCount;
+            if (failSave)
+            {
+                return false;
+            }
+            packageDependencies[ToKey(id)] = json;
+            return true;
+        }
+    };
+
+    struct FakeLegacyFiles
+    {
+        std::map<std::wstring, std::string> files;
+        size_t loadCount{};
+
+        std::string Load(const std::wstring& id)
+        {
+            ++loadCount;
+            const auto iterator{ files.find(id) };
+            return iterator != files.end() ? iterator->second : std::string();
+        }
+
+        void Delete(const std::wstring& id)
+        {
+            files.erase(id);
+        }
+    };
+}
+
+PORTABLE_TEST(PackageDependencyLog_MigratesLegacyFiles)
+{
+    FakeStore store;
+    FakeLegacyFiles legacyFiles;
+    legacyFiles.files[L"legacy"] = "{legacy}";
+
+    // Moved into the store the first time it's loaded...
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"legacy") == "{legacy}");
+    PORTABLE_VERIFY(store.Find(L"LEGACY") == "{legacy}");
+    PORTABLE_VERIFY(legacyFiles.files.empty());
+
+    // ...and found there after
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"legacy") == "{legacy}");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, legacyFiles.loadCount);
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, store.saveCount);
+
+    // Not found anywhere
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"missing").empty());
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, store.saveCount);
+}
+
+PORTABLE_TEST(PackageDependencyLog_KeepsLegacyFilesUntilMigrated)
+{
+    FakeStore store;
+    FakeLegacyFiles legacyFiles;
+    legacyFiles.files[L"legacy"] = "{legacy}";
+
+    // The store's unavailable. Still found, but the legacy file's kept...
+    store.failSave = true;
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"legacy") == "{legacy}");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, legacyFiles.files.size());
+
+    // ...to try again next time
+    store.failSave = false;
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"legacy") == "{legacy}");
+    PORTABLE_VERIFY(legacyFiles.files.empty());
+    PORTABLE_VERIFY(store.Find(L"legacy") == "{legacy}");
+
+    // The store wins over a legacy file left behind
+    legacyFiles.files[L"legacy"] = "{stale}";
+    PORTABLE_VERIFY(MddCore::LoadAndMigrate(store, legacyFiles, L"legacy") == "{legacy}");
+}
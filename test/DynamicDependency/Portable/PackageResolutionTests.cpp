@@ -0,0 +1,241 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PackageCatalog.h"
+#include "PackageResolution.h"
+#include "PackageResolutionCache.h"
+
+#include "PortableTest.h"
+
+namespace
+{
+    constexpr uint32_t c_anyArchitecture{};
+
+    uint64_t Version(uint16_t major, uint16_t minor)
+    {
+        return (static_cast<uint64_t>(major) << 48) | (static_cast<uint64_t>(minor) << 32);
+    }
+
+    /// A catalog whose packages, versions and statuses the test controls, counting what's asked of it.
+    class FakePackageCatalog : public MddCore::IPackageCatalog
+    {
+    public:
+        struct Package
+        {
+            std::wstring packageFamilyName;
+            uint64_t version{};
+            bool isStatusOK{ true };
+        };
+
+        void Add(const std::wstring& packageFullName, const std::wstring& packageFamilyName, uint64_t version)
+        {
+            m_packages[packageFullName] = Package{ packageFamilyName, version };
+            ++m_changeId;
+        }
+
+        void Remove(const std::wstring& packageFullName)
+        {
+            m_packages.erase(packageFullName);
+            ++m_changeId;
+        }
+
+        void SetStatusOK(const std::wstring& packageFullName, bool isStatusOK)
+        {
+            m_packages[packageFullName].isStatusOK = isStatusOK;
+            ++m_changeId;
+        }
+
+        uint64_t Version(const std::wstring& packageFullName) const
+        {
+            return m_packages.at(packageFullName).version;
+        }
+
+        std::vector<std::wstring> FindPackagesByFamily(const std::wstring& packageFamilyName) override
+        {
+            ++findCount;
+            std::vector<std::wstring> packageFullNames;
+            for (const auto& [packageFullName, package] : m_packages)
+            {
+                if (package.packageFamilyName == packageFamilyName)
+                {
+                    packageFullNames.push_back(packageFullName);
+                }
+            }
+            return packageFullNames;
+        }
+
+        bool IsPackageStatusOK(const std::wstring& packageFullName) override
+        {
+            statusChecked.push_back(packageFullName);
+            return m_packages.at(packageFullName).isStatusOK;
+        }
+
+        bool IsTrackingChanges() override
+        {
+            return isTrackingChanges;
+        }
+
+        uint64_t ChangeId() override
+        {
+            PORTABLE_VERIFY(isTrackingChanges);
+            return m_changeId;
+        }
+
+    public:
+        bool isTrackingChanges{ true };
+        size_t findCount{};
+        std::vector<std::wstring> statusChecked;
+
+    private:
+        std::map<std::wstring, Package> m_packages;
+        uint64_t m_changeId{ 1 };
+    };
+
+    /// Highest version at or above minVersion (what PackageGraph::FindBestFit() does, minus architectures)
+    auto FindHighestVersion(FakePackageCatalog& catalog, uint64_t minVersion)
+    {
+        return [&catalog, minVersion](const std::vector<std::wstring>& packageFullNames, const std::vector<bool>& excluded)
+        {
+            size_t bestFitIndex{ packageFullNames.size() };
+            for (size_t index=0; index < packageFullNames.size(); ++index)
+            {
+                const auto version{ catalog.Version(packageFullNames[index]) };
+                if (!excluded[index] && (version >= minVersion) &&
+                    ((bestFitIndex == packageFullNames.size()) || (version > catalog.Version(packageFullNames[bestFitIndex]))))
+                {
+                    bestFitIndex = index;
+                }
+            }
+            return bestFitIndex;
+        };
+    }
+
+    FakePackageCatalog ContosoCatalog()
+    {
+        FakePackageCatalog catalog;
+        catalog.Add(L"Contoso_1.0", L"Contoso_8wekyb3d8bbwe", Version(1, 0));
+        catalog.Add(L"Contoso_1.2", L"Contoso_8wekyb3d8bbwe", Version(1, 2));
+        catalog.Add(L"Contoso_2.0", L"Contoso_8wekyb3d8bbwe", Version(2, 0));
+        catalog.Add(L"Fabrikam_3.0", L"Fabrikam_8wekyb3d8bbwe", Version(3, 0));
+        return catalog;
+    }
+}
+
+PORTABLE_TEST(PackageResolution_OnlyChecksTheBestFitsStatus)
+{
+    auto catalog{ ContosoCatalog() };
+    PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, L"Contoso_8wekyb3d8bbwe", FindHighestVersion(catalog, Version(1, 0))) == L"Contoso_2.0");
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.statusChecked.size());
+    PORTABLE_VERIFY(catalog.statusChecked[0] == L"Contoso_2.0");
+}
+
+PORTABLE_TEST(PackageResolution_FallsBackWhenTheBestFitIsNotOK)
+{
+    auto catalog{ ContosoCatalog() };
+    catalog.SetStatusOK(L"Contoso_2.0", false);
+    PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, L"Contoso_8wekyb3d8bbwe", FindHighestVersion(catalog, Version(1, 0))) == L"Contoso_1.2");
+    PORTABLE_VERIFY_ARE_EQUAL(2u, catalog.statusChecked.size());
+    PORTABLE_VERIFY(catalog.statusChecked[0] == L"Contoso_2.0");
+    PORTABLE_VERIFY(catalog.statusChecked[1] == L"Contoso_1.2");
+
+    // Nothing usable meets minVersion
+    catalog.statusChecked.clear();
+    PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, L"Contoso_8wekyb3d8bbwe", FindHighestVersion(catalog, Version(1, 5))).empty());
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.statusChecked.size());
+
+    // ...or nothing's usable at all
+    catalog.SetStatusOK(L"Contoso_1.2", false);
+    catalog.SetStatusOK(L"Contoso_1.0", false);
+    catalog.statusChecked.clear();
+    PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, L"Contoso_8wekyb3d8bbwe", FindHighestVersion(catalog, 0)).empty());
+    PORTABLE_VERIFY_ARE_EQUAL(3u, catalog.statusChecked.size());
+
+    // ...or the family has no packages
+    PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, L"Northwind_8wekyb3d8bbwe", FindHighestVersion(catalog, 0)).empty());
+}
+
+PORTABLE_TEST(PackageResolution_CachesUntilTheCatalogChanges)
+{
+    auto catalog{ ContosoCatalog() };
+    MddCore::PackageResolutionCache cache;
+    auto resolve = [&](const std::wstring& packageFamilyName, uint64_t minVersion)
+    {
+        return MddCore::PackageResolution::Resolve(catalog, cache, packageFamilyName, minVersion, c_anyArchitecture, FindHighestVersion(catalog, minVersion));
+    };
+
+    PORTABLE_VERIFY(resolve(L"Contoso_8wekyb3d8bbwe", Version(1, 0)) == L"Contoso_2.0");
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.findCount);
+    PORTABLE_VERIFY(resolve(L"Contoso_8wekyb3d8bbwe", Version(1, 0)) == L"Contoso_2.0");
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.findCount);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.statusChecked.size());
+
+    // Package family names are case-insensitive
+    PORTABLE_VERIFY(resolve(L"CONTOSO_8WEKYB3D8BBWE", Version(1, 0)) == L"Contoso_2.0");
+    PORTABLE_VERIFY_ARE_EQUAL(1u, catalog.findCount);
+
+    // ...but other criteria are a different resolution
+    PORTABLE_VERIFY(resolve(L"Contoso_8wekyb3d8bbwe", Version(1, 1)) == L"Contoso_2.0");
+    PORTABLE_VERIFY_ARE_EQUAL(2u, catalog.findCount);
+    PORTABLE_VERIFY_ARE_EQUAL(2u, cache.Size());
+
+    // Removing the package means resolving again, and forgetting everything resolved before
+    catalog.Remove(L"Contoso_2.0");
+    PORTABLE_VERIFY(resolve(L"Contoso_8wekyb3d8bbwe", Version(1, 0)) == L"Contoso_1.2");
+    PORTABLE_VERIFY_ARE_EQUAL(3u, catalog.findCount);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, cache.Size());
+
+    // So does a package becoming unusable
+    catalog.SetStatusOK(L"Contoso_1.2", false);
+    PORTABLE_VERIFY(resolve(L"Contoso_8wekyb3d8bbwe", Version(1, 0)) == L"Contoso_1.0");
+    PORTABLE_VERIFY_ARE_EQUAL(4u, catalog.findCount);
+
+    // Failures aren't cached
+    PORTABLE_VERIFY(resolve(L"Northwind_8wekyb3d8bbwe", 0).empty());
+    PORTABLE_VERIFY(resolve(L"Northwind_8wekyb3d8bbwe", 0).empty());
+    PORTABLE_VERIFY_ARE_EQUAL(6u, catalog.findCount);
+    catalog.Add(L"Northwind_1.0", L"Northwind_8wekyb3d8bbwe", Version(1, 0));
+    PORTABLE_VERIFY(resolve(L"Northwind_8wekyb3d8bbwe", 0) == L"Northwind_1.0");
+}
+
+PORTABLE_TEST(PackageResolution_DoesNotCacheWithoutChangeTracking)
+{
+    auto catalog{ ContosoCatalog() };
+    catalog.isTrackingChanges = false;
+    MddCore::PackageResolutionCache cache;
+    for (size_t count=1; count <= 3; ++count)
+    {
+        PORTABLE_VERIFY(MddCore::PackageResolution::Resolve(catalog, cache, L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, FindHighestVersion(catalog, 0)) == L"Contoso_2.0");
+        PORTABLE_VERIFY_ARE_EQUAL(count, catalog.findCount);
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(0u, cache.Size());
+}
+
+PORTABLE_TEST(PackageResolutionCache_IgnoresStaleResolutions)
+{
+    MddCore::PackageResolutionCache cache;
+    std::wstring packageFullName;
+    cache.Add(L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, 5, L"Contoso_2.0");
+    PORTABLE_VERIFY(cache.Find(L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, 5, packageFullName));
+    PORTABLE_VERIFY(packageFullName == L"Contoso_2.0");
+
+    // A resolution made against an older catalog (e.g. racing a change) isn't remembered or found
+    cache.Add(L"Contoso_8wekyb3d8bbwe", 1, c_anyArchitecture, 4, L"Contoso_1.0");
+    PORTABLE_VERIFY(!cache.Find(L"Contoso_8wekyb3d8bbwe", 1, c_anyArchitecture, 5, packageFullName));
+    PORTABLE_VERIFY(!cache.Find(L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, 4, packageFullName));
+
+    // A newer catalog forgets everything
+    PORTABLE_VERIFY(!cache.Find(L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, 6, packageFullName));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, cache.Size());
+    PORTABLE_VERIFY(!cache.Find(L"Contoso_8wekyb3d8bbwe", 0, c_anyArchitecture, 5, packageFullName));
+
+    // Architectures are part of the criteria
+    cache.Add(L"Contoso_8wekyb3d8bbwe", 0, 1, 6, L"Contoso_2.0_x86");
+    PORTABLE_VERIFY(!cache.Find(L"Contoso_8wekyb3d8bbwe", 0, 2, 6, packageFullName));
+    PORTABLE_VERIFY(cache.Find(L"Contoso_8wekyb3d8bbwe", 0, 1, 6, packageFullName));
+    PORTABLE_VERIFY(packageFullName == L"Contoso_2.0_x86");
+}
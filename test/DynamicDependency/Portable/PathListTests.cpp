@@ -0,0 +1,223 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <stdexcept>
+#include <string>
+
+#include "PathList.h"
+
+#include "PortableTest.h"
+
+namespace
+{
+    /// A PATH the test controls, counting reads and writes.
+    class FakePathEnvironment : public MddCore::IPathEnvironment
+    {
+    public:
+        FakePathEnvironment() = default;
+
+        FakePathEnvironment(const std::wstring& value) :
+            value(value),
+            exists(true)
+        {
+        }
+
+        bool Get(std::wstring& path) override
+        {
+            ++getCount;
+            path = value;
+            return exists;
+        }
+
+        void Set(const std::wstring& path) override
+        {
+            ++setCount;
+            if (failSet)
+            {
+                throw std::runtime_error("Set failed");
+            }
+            value = path;
+            exists = !path.empty();
+        }
+
+        std::wstring value;
+        bool exists{};
+        bool failSet{};
+        size_t getCount{};
+        size_t setCount{};
+    };
+}
+
+PORTABLE_TEST(PathList_InsertsAtHeadAndTail)
+{
+    FakePathEnvironment environment(L"C:\\Windows;C:\\Tools");
+    MddCore::PathList pathList;
+
+    pathList.Insert(0, L"C:\\B", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\Windows;C:\\Tools");
+    pathList.Insert(0, L"C:\\A", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\Windows;C:\\Tools");
+    pathList.Insert(2, L"C:\\D", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\D;C:\\Windows;C:\\Tools");
+    pathList.Insert(2, L"C:\\C1;C:\\C2", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\C1;C:\\C2;C:\\D;C:\\Windows;C:\\Tools");
+
+    // Past the end = append to our block
+    pathList.Insert(99, L"C:\\E", environment);
+    PORTABLE_VERIFY(pathList.Value() == L"C:\\A;C:\\B;C:\\C1;C:\\C2;C:\\D;C:\\E");
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\C1;C:\\C2;C:\\D;C:\\E;C:\\Windows;C:\\Tools");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 5 }, pathList.Count());
+}
+
+PORTABLE_TEST(PathList_RemovesAtHeadAndTail)
+{
+    FakePathEnvironment environment(L"C:\\Windows");
+    MddCore::PathList pathList;
+    for (const auto& entry : { L"C:\\A", L"C:\\B", L"C:\\C", L"C:\\D" })
+    {
+        pathList.Insert(pathList.Count(), entry, environment);
+    }
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\C;C:\\D;C:\\Windows");
+
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\C;C:\\D;C:\\Windows");
+    pathList.Remove(pathList.Count() - 1, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\C;C:\\Windows");
+    pathList.Remove(1, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\Windows");
+
+    // Out of range is a no-op
+    const auto setCount{ environment.setCount };
+    pathList.Remove(1, environment);
+    PORTABLE_VERIFY_ARE_EQUAL(setCount, environment.setCount);
+
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\Windows");
+    PORTABLE_VERIFY(pathList.Value().empty());
+}
+
+PORTABLE_TEST(PathList_CreatesAndDeletesAMissingPath)
+{
+    FakePathEnvironment environment;
+    MddCore::PathList pathList;
+
+    pathList.Insert(0, L"C:\\A", environment);
+    PORTABLE_VERIFY(environment.exists);
+    PORTABLE_VERIFY(environment.value == L"C:\\A");
+    pathList.Insert(1, L"C:\\B", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B");
+
+    pathList.Remove(1, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A");
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(!environment.exists);
+}
+
+PORTABLE_TEST(PathList_HandlesDuplicates)
+{
+    // The same path in our block twice, and already in PATH after it
+    FakePathEnvironment environment(L"C:\\A;C:\\Windows");
+    MddCore::PathList pathList;
+    pathList.Insert(0, L"C:\\A", environment);
+    pathList.Insert(1, L"C:\\B", environment);
+    pathList.Insert(2, L"C:\\A", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\A;C:\\A;C:\\Windows");
+
+    // Removing an entry removes that entry, not the first match
+    pathList.Remove(2, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\A;C:\\Windows");
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\A;C:\\Windows");
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\Windows");
+}
+
+PORTABLE_TEST(PathList_FollowsPathEditedExternally)
+{
+    FakePathEnvironment environment(L"C:\\Windows");
+    MddCore::PathList pathList;
+    pathList.Insert(0, L"C:\\A", environment);
+    pathList.Insert(1, L"C:\\B", environment);
+
+    // Appended to (after our block): our block's still where we left it
+    environment.value += L";C:\\Appended";
+    pathList.Insert(1, L"C:\\AB", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\AB;C:\\B;C:\\Windows;C:\\Appended");
+
+    // Prepended to: our block moves back to the front
+    environment.value = L"C:\\Prepended;" + environment.value;
+    pathList.Remove(1, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\Prepended;C:\\Windows;C:\\Appended");
+
+    // Something that merely starts like our block isn't our block
+    environment.value = L"C:\\A;C:\\Bx;C:\\Windows";
+    pathList.Insert(2, L"C:\\C", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\C;C:\\A;C:\\Bx;C:\\Windows");
+
+    // Replaced entirely: our block's prepended and nothing else is touched
+    environment.value = L"C:\\Other";
+    pathList.Remove(0, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\C;C:\\Other");
+
+    // Our block was modified: we won't remove it piecemeal, only prepend the new block
+    environment.value = L"C:\\B;C:\\Inserted;C:\\C;C:\\Other";
+    pathList.Remove(1, environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\B;C:\\B;C:\\Inserted;C:\\C;C:\\Other");
+
+    // Deleted: we are the PATH
+    environment.value.clear();
+    environment.exists = false;
+    pathList.Insert(0, L"C:\\A", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B");
+}
+
+PORTABLE_TEST(PathList_IsUnchangedIfUpdatingPathFails)
+{
+    FakePathEnvironment environment(L"C:\\Windows");
+    MddCore::PathList pathList;
+    pathList.Insert(0, L"C:\\A", environment);
+
+    environment.failSet = true;
+    bool threw{};
+    try
+    {
+        pathList.Insert(1, L"C:\\B", environment);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    PORTABLE_VERIFY(threw);
+    PORTABLE_VERIFY(pathList.Value() == L"C:\\A");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, pathList.Count());
+
+    environment.failSet = false;
+    pathList.Insert(1, L"C:\\B", environment);
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\B;C:\\Windows");
+}
+
+PORTABLE_TEST(DeferredPathEnvironment_ReadsAndWritesOnce)
+{
+    FakePathEnvironment environment(L"C:\\Windows");
+    MddCore::PathList pathList;
+    {
+        MddCore::DeferredPathEnvironment deferred(environment);
+        for (const auto& entry : { L"C:\\A", L"C:\\B", L"C:\\C" })
+        {
+            pathList.Insert(pathList.Count(), entry, deferred);
+        }
+        pathList.Remove(1, deferred);
+        PORTABLE_VERIFY(environment.value == L"C:\\Windows");
+        deferred.Commit();
+        deferred.Commit();
+    }
+    PORTABLE_VERIFY(environment.value == L"C:\\A;C:\\C;C:\\Windows");
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, environment.getCount);
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, environment.setCount);
+
+    // Nothing changed = nothing written
+    MddCore::DeferredPathEnvironment unchanged(environment);
+    pathList.Remove(99, unchanged);
+    unchanged.Commit();
+    PORTABLE_VERIFY_ARE_EQUAL(size_t{ 1 }, environment.setCount);
+}
@@ -0,0 +1,74 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "WinRTActivatableClassIndex.h"
+
+#include "PortableTest.h"
+
+namespace
+{
+    struct InprocServer
+    {
+        size_t package{};
+        int threadingModel{};
+    };
+
+    using Package = std::vector<std::pair<std::wstring, int>>;
+
+    void Rebuild(MddCore::WinRTActivatableClassIndex<InprocServer>& index, const std::vector<Package>& packages)
+    {
+        auto lock{ index.Lock() };
+        index.Rebuild([&](auto&& add)
+        {
+            for (size_t package=0; package < packages.size(); ++package)
+            {
+                for (const auto& [activatableClassId, threadingModel] : packages[package])
+                {
+                    add(activatableClassId, InprocServer{ package, threadingModel });
+                }
+            }
+        });
+    }
+}
+
+PORTABLE_TEST(WinRTActivatableClassIndex_FirstDefinitionWins)
+{
+    MddCore::WinRTActivatableClassIndex<InprocServer> index;
+    {
+        auto lock{ index.Lock() };
+        PORTABLE_VERIFY(index.Find(L"Contoso.Widget") == nullptr);
+    }
+
+    Rebuild(index, { { { L"Contoso.Widget", 1 }, { L"Contoso.Gadget", 2 } }, { { L"Contoso.Widget", 3 }, { L"Fabrikam.Widget", 1 } } });
+    auto lock{ index.Lock() };
+    PORTABLE_VERIFY_ARE_EQUAL(3u, index.Size());
+    auto widget{ index.Find(L"Contoso.Widget") };
+    PORTABLE_VERIFY(widget != nullptr);
+    PORTABLE_VERIFY_ARE_EQUAL(0u, widget->package);
+    PORTABLE_VERIFY_ARE_EQUAL(1, widget->threadingModel);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, index.Find(L"Fabrikam.Widget")->package);
+
+    // Lookups are exact (activatableClassIds are case-sensitive) and don't need a std::wstring
+    const std::wstring text{ L"Contoso.Gadget.Extra" };
+    PORTABLE_VERIFY(index.Find(std::wstring_view(text).substr(0, 14)) != nullptr);
+    PORTABLE_VERIFY(index.Find(L"contoso.gadget") == nullptr);
+}
+
+PORTABLE_TEST(WinRTActivatableClassIndex_RebuildReplacesEverything)
+{
+    MddCore::WinRTActivatableClassIndex<InprocServer> index;
+    Rebuild(index, { { { L"Contoso.Widget", 1 } }, { { L"Fabrikam.Widget", 1 } } });
+    const auto generation{ index.Generation() };
+
+    // The first package was removed so its classes go, and a package now ranked ahead takes over
+    Rebuild(index, { { { L"Fabrikam.Widget", 2 } }, { { L"Fabrikam.Widget", 1 } } });
+    auto lock{ index.Lock() };
+    PORTABLE_VERIFY(index.Generation() != generation);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, index.Size());
+    PORTABLE_VERIFY(index.Find(L"Contoso.Widget") == nullptr);
+    PORTABLE_VERIFY_ARE_EQUAL(2, index.Find(L"Fabrikam.Widget")->threadingModel);
+}
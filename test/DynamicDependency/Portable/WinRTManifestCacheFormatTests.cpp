@@ -0,0 +1,168 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "WinRTManifestCacheFormat.h"
+
+#include "PortableTest.h"
+
+namespace Format = MddCore::WinRTManifestCacheFormat;
+
+namespace
+{
+    constexpr uint8_t c_both{ 1 };
+    constexpr uint8_t c_sta{ 2 };
+    constexpr uint8_t c_mta{ 3 };
+
+    const Format::Key c_key{ L"Contoso.Widgets_1.2.3.4_x64__8wekyb3d8bbwe", 4096, 132000000000000000ull };
+
+    std::vector<Format::InprocModule> SampleInprocModules()
+    {
+        return {
+            { L"Contoso.Widgets.dll", { { L"Contoso.Widgets.Widget", c_both }, { L"Contoso.Widgets.Gadget", c_sta } } },
+            { L"bin\\Contoso.Gizmos.dll", { { L"Contoso.Gizmos.Gizmo", c_mta } } },
+            { L"Contoso.Empty.dll", {} },
+        };
+    }
+
+    void VerifyEqual(const std::vector<Format::InprocModule>& expected, const std::vector<Format::InprocModule>& actual)
+    {
+        PORTABLE_VERIFY_ARE_EQUAL(expected.size(), actual.size());
+        for (size_t index=0; index < expected.size(); ++index)
+        {
+            PORTABLE_VERIFY(expected[index].path == actual[index].path);
+            PORTABLE_VERIFY_ARE_EQUAL(expected[index].activatableClasses.size(), actual[index].activatableClasses.size());
+            for (size_t classIndex=0; classIndex < expected[index].activatableClasses.size(); ++classIndex)
+            {
+                PORTABLE_VERIFY(expected[index].activatableClasses[classIndex].activatableClassId == actual[index].activatableClasses[classIndex].activatableClassId);
+                PORTABLE_VERIFY_ARE_EQUAL(expected[index].activatableClasses[classIndex].threadingModel, actual[index].activatableClasses[classIndex].threadingModel);
+            }
+        }
+    }
+
+    void WriteUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+    {
+        for (int shift=0; shift < 32; shift += 8)
+        {
+            data[offset++] = static_cast<uint8_t>(value >> shift);
+        }
+    }
+
+    // Recompute the checksum after editing a table, so it's the edit that's rejected and not the checksum
+    void FixChecksum(std::vector<uint8_t>& data)
+    {
+        WriteUInt32(data, 8, Format::details::Checksum(data.data() + 12, data.size() - 12));
+    }
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RoundTrips)
+{
+    const auto inprocModules{ SampleInprocModules() };
+    const auto data{ Format::Serialize(c_key, inprocModules) };
+
+    std::vector<Format::InprocModule> found;
+    PORTABLE_VERIFY(Format::Deserialize(data.data(), data.size(), c_key, found));
+    VerifyEqual(inprocModules, found);
+
+    // Packages without inproc servers are cached too
+    const auto empty{ Format::Serialize(c_key, {}) };
+    PORTABLE_VERIFY(Format::Deserialize(empty.data(), empty.size(), c_key, found));
+    PORTABLE_VERIFY(found.empty());
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RejectsTruncated)
+{
+    const auto data{ Format::Serialize(c_key, SampleInprocModules()) };
+    std::vector<Format::InprocModule> found;
+    for (size_t size=0; size < data.size(); ++size)
+    {
+        PORTABLE_VERIFY(!Format::Deserialize(data.data(), size, c_key, found));
+        PORTABLE_VERIFY(found.empty());
+    }
+
+    // Truncated with a matching checksum, i.e. a record cut short when it was written
+    for (size_t size=12; size < data.size(); ++size)
+    {
+        std::vector<uint8_t> truncated(data.begin(), data.begin() + size);
+        FixChecksum(truncated);
+        PORTABLE_VERIFY(!Format::Deserialize(truncated.data(), truncated.size(), c_key, found));
+    }
+
+    // ...and trailing data
+    auto extended{ data };
+    extended.push_back(0);
+    FixChecksum(extended);
+    PORTABLE_VERIFY(!Format::Deserialize(extended.data(), extended.size(), c_key, found));
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RejectsOtherVersions)
+{
+    auto data{ Format::Serialize(c_key, SampleInprocModules()) };
+    std::vector<Format::InprocModule> found;
+
+    WriteUInt32(data, 4, Format::c_version + 1);
+    FixChecksum(data);
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), c_key, found));
+
+    WriteUInt32(data, 4, Format::c_version - 1);
+    FixChecksum(data);
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), c_key, found));
+
+    WriteUInt32(data, 4, Format::c_version);
+    WriteUInt32(data, 0, Format::c_magic + 1);
+    FixChecksum(data);
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), c_key, found));
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RejectsCorruptOrStale)
+{
+    const auto data{ Format::Serialize(c_key, SampleInprocModules()) };
+    std::vector<Format::InprocModule> found;
+    for (size_t offset=0; offset < data.size(); ++offset)
+    {
+        auto corrupt{ data };
+        corrupt[offset] ^= 0x04;
+        PORTABLE_VERIFY(!Format::Deserialize(corrupt.data(), corrupt.size(), c_key, found));
+    }
+
+    // The manifest changed (or it's another package's table)
+    auto key{ c_key };
+    ++key.manifestSize;
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), key, found));
+    key = c_key;
+    ++key.manifestLastWriteTime;
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), key, found));
+    key = c_key;
+    key.packageFullName = L"Contoso.Widgets_1.2.3.5_x64__8wekyb3d8bbwe";
+    PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), key, found));
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RejectsPathsOutsideThePackage)
+{
+    std::vector<Format::InprocModule> found;
+    for (const auto path : { L"C:\\Windows\\evil.dll", L"\\\\server\\share\\evil.dll", L"\\evil.dll", L"/evil.dll", L"C:evil.dll",
+                             L"..\\evil.dll", L"bin\\..\\..\\evil.dll", L"bin/../../evil.dll", L"bin\\.. \\evil.dll", L"bin\\...\\evil.dll",
+                             L"evil.dll:stream", L"" })
+    {
+        PORTABLE_VERIFY(!Format::IsPackageRelativePath(path));
+        const auto data{ Format::Serialize(c_key, { { path, { { L"Contoso.Widgets.Widget", c_both } } } }) };
+        PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), c_key, found));
+    }
+    for (const auto path : { L"Contoso.Widgets.dll", L"bin\\x64\\Contoso.Widgets.dll", L"bin/Contoso.Widgets.dll", L"Contoso..Widgets.dll" })
+    {
+        PORTABLE_VERIFY(Format::IsPackageRelativePath(path));
+    }
+}
+
+PORTABLE_TEST(WinRTManifestCacheFormat_RejectsUnknownThreadingModels)
+{
+    std::vector<Format::InprocModule> found;
+    for (const uint8_t threadingModel : { uint8_t{ 0 }, uint8_t{ 4 }, uint8_t{ 0xFF } })
+    {
+        const auto data{ Format::Serialize(c_key, { { L"Contoso.Widgets.dll", { { L"Contoso.Widgets.Widget", threadingModel } } } }) };
+        PORTABLE_VERIFY(!Format::Deserialize(data.data(), data.size(), c_key, found));
+    }
+}
@@ -5,6 +5,8 @@
 
 #include <MddBootstrap.h>
 
+#include "..\Perf\PerfHarness.h"
+
 namespace TF = ::Test::FileSystem;
 namespace TP = ::Test::Packages;
 
@@ -135,6 +137,30 @@ namespace Test::DynamicDependency
             MddBootstrapShutdown();
         }
 
+        TEST_METHOD(Initialize_Perf)
+        {
+            VERIFY_ARE_EQUAL(S_OK, MddBootstrapTestInitialize(Test::Packages::DynamicDependencyLifetimeManager::c_PackageNamePrefix, Test::Packages::DynamicDependencyLifetimeManager::c_PackagePublisherId));
+
+            const UINT32 c_Version_MajorMinor{ Test::Packages::DynamicDependencyLifetimeManager::c_Version_MajorMinor };
+            const PACKAGE_VERSION minVersion{};
+
+            // The first call finds the DDLM the hard way (the test's packages were just registered so
+            // any resolution remembered from before is stale). The rest reuse what it found
+            auto first{ Test::Perf::Measure(1, [&](size_t) {
+                VERIFY_ARE_EQUAL(S_OK, MddBootstrapInitialize(c_Version_MajorMinor, nullptr, minVersion));
+                MddBootstrapShutdown();
+            }) };
+            auto cached{ Test::Perf::Measure(20, [&](size_t) {
+                VERIFY_ARE_EQUAL(S_OK, MddBootstrapInitialize(c_Version_MajorMinor, nullptr, minVersion));
+                MddBootstrapShutdown();
+            }) };
+            for (const auto& json : { Test::Perf::ToJson("api.bootstrap.initialize.first", 1, 1, first),
+                                      Test::Perf::ToJson("api.bootstrap.initialize.cached", 1, 1, cached) })
+            {
+                WEX::Logging::Log::Comment(WEX::Common::String(std::wstring(json.begin(), json.end()).c_str()));
+            }
+        }
+
         TEST_METHOD(ShutdownWithoutInitialize)
         {
             MddBootstrapShutdown();
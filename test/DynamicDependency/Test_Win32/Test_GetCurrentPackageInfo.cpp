@@ -160,6 +160,250 @@ namespace Test::DynamicDependency
             MddDeletePackageDependency(packageDependencyId_FrameworkMathAdd.get());
         }
 
+        TEST_METHOD(Unpackaged_PackageGraphN_Benchmark)
+        {
+            if (!IsGetCurrentPackageInfo3Supported())
+            {
+                return;
+            }
+
+            // -- TryCreate
+            const PACKAGE_VERSION minVersion{};
+            const MddPackageDependencyProcessorArchitectures architectures{};
+            const auto lifetimeKind{ MddPackageDependencyLifetimeKind::Process };
+            PCWSTR lifetimeArtifact{};
+            const MddCreatePackageDependencyOptions createOptions{};
+            wil::unique_process_heap_string packageDependencyId_FrameworkMathAdd;
+            VERIFY_ARE_EQUAL(S_OK, MddTryCreatePackageDependency(nullptr, TP::FrameworkMathAdd::c_PackageFamilyName, minVersion, architectures, lifetimeKind, lifetimeArtifact, createOptions, &packageDependencyId_FrameworkMathAdd));
+
+            // Grow the package graph one node at a time (each Add creates a node, even for the
+            // same package dependency) and time GetCurrentPackageInfo3 at each size of interest
+            const UINT32 packageGraphSizes[]{ 1, 2, 5, 10, 20, 50 };
+            std::vector<MDD_PACKAGEDEPENDENCY_CONTEXT> packageDependencyContexts;
+            for (const auto packageGraphSize : packageGraphSizes)
+            {
+                while (packageDependencyContexts.size() < packageGraphSize)
+                {
+                    // -- Add
+                    const auto rank{ MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT };
+                    const MddAddPackageDependencyOptions addOptions{};
+                    MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext{};
+                    VERIFY_ARE_EQUAL(S_OK, MddAddPackageDependency(packageDependencyId_FrameworkMathAdd.get(), rank, addOptions, &packageDependencyContext, nullptr));
+                    packageDependencyContexts.push_back(packageDependencyContext);
+                }
+
+                BenchmarkGetCurrentPackageInfo3(packageGraphSize);
+            }
+
+            // -- Remove
+            for (const auto packageDependencyContext : packageDependencyContexts)
+            {
+                MddRemovePackageDependency(packageDependencyContext);
+            }
+
+            // -- Delete
+            MddDeletePackageDependency(packageDependencyId_FrameworkMathAdd.get());
+        }
+
+        TEST_METHOD(Unpackaged_PackageGraphN_ConcurrentReaders)
+        {
+            if (!IsGetCurrentPackageInfo3Supported())
+            {
+                return;
+            }
+
+            // -- TryCreate
+            const PACKAGE_VERSION minVersion{};
+            const MddPackageDependencyProcessorArchitectures architectures{};
+            const auto lifetimeKind{ MddPackageDependencyLifetimeKind::Process };
+            PCWSTR lifetimeArtifact{};
+            const MddCreatePackageDependencyOptions createOptions{};
+            wil::unique_process_heap_string packageDependencyId_FrameworkMathAdd;
+            VERIFY_ARE_EQUAL(S_OK, MddTryCreatePackageDependency(nullptr, TP::FrameworkMathAdd::c_PackageFamilyName, minVersion, architectures, lifetimeKind, lifetimeArtifact, createOptions, &packageDependencyId_FrameworkMathAdd));
+
+            // -- Add (keep 1 node in the package graph for the duration so readers always find something)
+            const auto rank{ MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT };
+            const MddAddPackageDependencyOptions addOptions{};
+            MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext_FrameworkMathAdd{};
+            VERIFY_ARE_EQUAL(S_OK, MddAddPackageDependency(packageDependencyId_FrameworkMathAdd.get(), rank, addOptions, &packageDependencyContext_FrameworkMathAdd, nullptr));
+
+            // Readers query the package graph while it's repeatedly changed out from under them.
+            // Every answer must be internally consistent: 1 or 2 packages, strings within the buffer.
+            // VERIFY_* can't be used off the test thread so readers count what they see for us to verify.
+            std::atomic<bool> stop{};
+            std::atomic<UINT32> reads{};
+            std::atomic<UINT32> failures{};
+            std::vector<std::thread> readers;
+            for (UINT32 reader=0; reader < 4; ++reader)
+            {
+                readers.emplace_back([&]() {
+                    while (!stop)
+                    {
+                        if (IsPackageInfoConsistent(PACKAGE_FILTER_DIRECT | PACKAGE_FILTER_DYNAMIC, PackageInfoType_PackageInfoInstallPath, 1, 2))
+                        {
+                            ++reads;
+                        }
+                        else
+                        {
+                            ++failures;
+                        }
+                    }
+                });
+            }
+
+            const UINT32 iterations{ 100 };
+            UINT32 addRemoveFailures{};
+            for (UINT32 iteration=0; iteration < iterations; ++iteration)
+            {
+                MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext{};
+                if (FAILED(MddAddPackageDependency(packageDependencyId_FrameworkMathAdd.get(), rank, addOptions, &packageDependencyContext, nullptr)))
+                {
+                    ++addRemoveFailures;
+                    continue;
+                }
+                MddRemovePackageDependency(packageDependencyContext);
+            }
+
+            stop = true;
+            for (auto& reader : readers)
+            {
+                reader.join();
+            }
+
+            auto message{ wil::str_printf<wil::unique_process_heap_string>(L"Concurrent readers: add/remove:%u reads:%u failures:%u\n",
+                                                                           iterations, reads.load(), failures.load()) };
+            VERIFY_IS_TRUE(true, message.get());
+            OutputDebugStringW(message.get());
+            VERIFY_ARE_EQUAL(0u, addRemoveFailures);
+            VERIFY_ARE_EQUAL(0u, failures.load());
+            VERIFY_IS_TRUE(reads.load() > 0);
+
+            // -- Remove
+            MddRemovePackageDependency(packageDependencyContext_FrameworkMathAdd);
+
+            // -- Delete
+            MddDeletePackageDependency(packageDependencyId_FrameworkMathAdd.get());
+        }
+
+        // Query the package info (size, then data) and check the answer hangs together.
+        // The package graph may change between the two calls; if so, try again.
+        bool IsPackageInfoConsistent(
+            const UINT32 flags,
+            const PackageInfoType packageInfoType,
+            const UINT32 minExpectedCount,
+            const UINT32 maxExpectedCount)
+        {
+            for (;;)
+            {
+                UINT32 bufferSize{};
+                UINT32 count{};
+                auto hr{ m_getCurrentPackageInfo3(flags, packageInfoType, &bufferSize, nullptr, &count) };
+                if (hr != HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER))
+                {
+                    return false;
+                }
+
+                std::vector<BYTE> buffer(bufferSize);
+                hr = m_getCurrentPackageInfo3(flags, packageInfoType, &bufferSize, buffer.data(), &count);
+                if (hr == HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER))
+                {
+                    continue;
+                }
+                if ((hr != S_OK) || (count < minExpectedCount) || (count > maxExpectedCount) || (bufferSize > buffer.size()))
+                {
+                    return false;
+                }
+
+                const BYTE* bufferBegin{ buffer.data() };
+                const BYTE* bufferEnd{ buffer.data() + bufferSize };
+                const auto packageInfo{ reinterpret_cast<const PACKAGE_INFO*>(bufferBegin) };
+                for (UINT32 index=0; index < count; ++index)
+                {
+                    const auto packageFullName{ reinterpret_cast<const BYTE*>(packageInfo[index].packageFullName) };
+                    const auto path{ reinterpret_cast<const BYTE*>(packageInfo[index].path) };
+                    if ((packageFullName < bufferBegin) || (packageFullName >= bufferEnd) || (path < bufferBegin) || (path >= bufferEnd))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+
+        void BenchmarkGetCurrentPackageInfo3(
+            const UINT32 expectedCount)
+        {
+            const UINT32 flags{ PACKAGE_FILTER_DIRECT | PACKAGE_FILTER_DYNAMIC };
+            const auto packageInfoType{ PackageInfoType_PackageInfoInstallPath };
+            const UINT32 iterations{ 1000 };
+
+            LARGE_INTEGER frequency{};
+            QueryPerformanceFrequency(&frequency);
+
+            // The first query after the package graph changes has to walk the graph
+            LARGE_INTEGER start{};
+            QueryPerformanceCounter(&start);
+            auto buffer{ GetCurrentPackageInfo3SizeThenData(flags, packageInfoType, expectedCount) };
+            LARGE_INTEGER stop{};
+            QueryPerformanceCounter(&stop);
+            const auto firstMicroseconds{ ((stop.QuadPart - start.QuadPart) * 1000000) / frequency.QuadPart };
+
+            // Every package is Framework.Math.Add so every entry must match the first. This also
+            // verifies all the strings point into the buffer we passed in
+            VerifyPackageInfoBuffer(buffer, expectedCount);
+
+            // Repeated queries with no change to the package graph
+            QueryPerformanceCounter(&start);
+            for (UINT32 iteration=0; iteration < iterations; ++iteration)
+            {
+                buffer = GetCurrentPackageInfo3SizeThenData(flags, packageInfoType, expectedCount);
+            }
+            QueryPerformanceCounter(&stop);
+            const auto repeatedNanoseconds{ ((stop.QuadPart - start.QuadPart) * 1000000000) / (frequency.QuadPart * iterations) };
+            VerifyPackageInfoBuffer(buffer, expectedCount);
+
+            auto message{ wil::str_printf<wil::unique_process_heap_string>(L"GetCurrentPackageInfo3 nodes:%u first:%lldus repeated:%lldns/call\n",
+                                                                           expectedCount, firstMicroseconds, repeatedNanoseconds) };
+            VERIFY_IS_TRUE(true, message.get());
+            OutputDebugStringW(message.get());
+        }
+
+        std::vector<BYTE> GetCurrentPackageInfo3SizeThenData(
+            const UINT32 flags,
+            const PackageInfoType packageInfoType,
+            const UINT32 expectedCount)
+        {
+            UINT32 bufferSize{};
+            UINT32 count{};
+            VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), m_getCurrentPackageInfo3(flags, packageInfoType, &bufferSize, nullptr, &count));
+            VERIFY_ARE_EQUAL(expectedCount, count);
+
+            std::vector<BYTE> buffer(bufferSize);
+            VERIFY_ARE_EQUAL(S_OK, m_getCurrentPackageInfo3(flags, packageInfoType, &bufferSize, buffer.data(), &count));
+            VERIFY_ARE_EQUAL(expectedCount, count);
+            VERIFY_ARE_EQUAL(static_cast<UINT32>(buffer.size()), bufferSize);
+            return buffer;
+        }
+
+        void VerifyPackageInfoBuffer(
+            const std::vector<BYTE>& buffer,
+            const UINT32 expectedCount)
+        {
+            const BYTE* bufferBegin{ buffer.data() };
+            const BYTE* bufferEnd{ buffer.data() + buffer.size() };
+            const auto packageInfo{ reinterpret_cast<const PACKAGE_INFO*>(bufferBegin) };
+            for (UINT32 index=0; index < expectedCount; ++index)
+            {
+                const auto packageFullName{ reinterpret_cast<const BYTE*>(packageInfo[index].packageFullName) };
+                VERIFY_IS_TRUE((packageFullName >= bufferBegin) && (packageFullName < bufferEnd));
+                VERIFY_ARE_EQUAL(std::wstring(packageInfo[0].packageFullName), std::wstring(packageInfo[index].packageFullName));
+
+                const auto path{ reinterpret_cast<const BYTE*>(packageInfo[index].path) };
+                VERIFY_IS_TRUE((path >= bufferBegin) && (path < bufferEnd));
+                VERIFY_ARE_EQUAL(std::wstring(packageInfo[0].path), std::wstring(packageInfo[index].path));
+            }
+        }
+
         void VerifyGetCurrentPackageInfo1(
             const UINT32 flags,
             const HRESULT expectedHR = HRESULT_FROM_WIN32(APPMODEL_ERROR_NO_PACKAGE),
@@ -31,6 +31,9 @@ namespace Test::DynamicDependency
         TEST_METHOD(Add_Rank_B0prepend_A0);
         TEST_METHOD(Add_Rank_Bneg10_A0);
 
+        TEST_METHOD(AddMany_MathAdd_Widgets);
+        TEST_METHOD(AddMany_AllOrNothing_NotFound);
+
         TEST_METHOD(Create_FilePathLifetime_NoExist);
         TEST_METHOD(Create_RegistryLifetime_NoExist);
         TEST_METHOD(Create_DoNotVerifyDependencyResolution);
@@ -46,6 +49,13 @@ namespace Test::DynamicDependency
 
         TEST_METHOD(WinRTReentrancy);
 
+        TEST_METHOD(CrossApartmentActivation);
+
+        TEST_METHOD(Perf_Create_Add_Remove);
+        TEST_METHOD(Perf_GetCurrentPackageInfo);
+        TEST_METHOD(Perf_Contention);
+        TEST_METHOD(Perf_Activation);
+
     private:
         static void VerifyPackageDependency(
             PCWSTR packageDependencyId,
@@ -294,6 +304,15 @@ namespace Test::DynamicDependency
             Add_Rank_Bneg10_A0();
         }
 
+        TEST_METHOD(AddMany_MathAdd_Widgets_Elevated)
+        {
+            AddMany_MathAdd_Widgets();
+        }
+        TEST_METHOD(AddMany_AllOrNothing_NotFound_Elevated)
+        {
+            AddMany_AllOrNothing_NotFound();
+        }
+
         TEST_METHOD(Create_FilePathLifetime_NoExist_Elevated)
         {
             Create_FilePathLifetime_NoExist();
@@ -338,5 +357,10 @@ namespace Test::DynamicDependency
         {
             WinRTReentrancy();
         }
+
+        TEST_METHOD(CrossApartmentActivation_Elevated)
+        {
+            CrossApartmentActivation();
+        }
     };
 }
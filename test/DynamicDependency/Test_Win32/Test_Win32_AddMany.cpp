@@ -0,0 +1,157 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include <MsixDynamicDependency.h>
+#include <wil_msixdynamicdependency.h>
+
+#include <Math.Add.h>
+
+#include "Test_Win32.h"
+
+namespace TF = ::Test::FileSystem;
+namespace TP = ::Test::Packages;
+
+void Test::DynamicDependency::Test_Win32::AddMany_MathAdd_Widgets()
+{
+    // Setup our dynamic dependencies
+
+    std::wstring expectedPackageFullName_WindowsAppRuntimeFramework{ TP::WindowsAppRuntimeFramework::c_PackageFullName };
+    std::wstring expectedPackageFullName_FrameworkMathAdd{ TP::FrameworkMathAdd::c_PackageFullName };
+    std::wstring expectedPackageFullName_FrameworkWidgets{ TP::FrameworkWidgets::c_PackageFullName };
+
+    VerifyPackageInPackageGraph(expectedPackageFullName_WindowsAppRuntimeFramework, S_OK);
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkWidgets, S_OK);
+    auto pathEnvironmentVariable{ GetPathEnvironmentVariableMinusWindowsAppRuntimeFramework() };
+    auto packagePath_WindowsAppRuntimeFramework{ TP::GetPackagePath(expectedPackageFullName_WindowsAppRuntimeFramework) };
+    VerifyPathEnvironmentVariable(packagePath_WindowsAppRuntimeFramework, pathEnvironmentVariable.c_str());
+
+    // -- TryCreate
+
+    wil::unique_process_heap_string packageDependencyId_FrameworkMathAdd{ Mdd_TryCreate_FrameworkMathAdd() };
+    wil::unique_process_heap_string packageDependencyId_FrameworkWidgets{ Mdd_TryCreate_FrameworkWidgets() };
+
+    // -- AddMany
+
+    const auto generationIdBefore{ MddGetGenerationId() };
+
+    MddAddPackageDependencyRequest requests[]{
+        { packageDependencyId_FrameworkMathAdd.get(), 10, MddAddPackageDependencyOptions::None },
+        { packageDependencyId_FrameworkWidgets.get(), -10, MddAddPackageDependencyOptions::None }
+    };
+    MddAddPackageDependencyResult results[ARRAYSIZE(requests)]{};
+    VERIFY_ARE_EQUAL(S_OK, MddAddPackageDependencies(ARRAYSIZE(requests), requests, MddAddPackageDependenciesOptions::None, results));
+    wil::unique_package_dependency_context packageDependencyContext_FrameworkMathAdd{ results[0].packageDependencyContext };
+    wil::unique_process_heap_string packageFullName_FrameworkMathAdd{ results[0].packageFullName };
+    wil::unique_package_dependency_context packageDependencyContext_FrameworkWidgets{ results[1].packageDependencyContext };
+    wil::unique_process_heap_string packageFullName_FrameworkWidgets{ results[1].packageFullName };
+    VERIFY_ARE_EQUAL(S_OK, results[0].hr);
+    VERIFY_ARE_EQUAL(S_OK, results[1].hr);
+    VERIFY_IS_NOT_NULL(packageDependencyContext_FrameworkMathAdd.get());
+    VERIFY_IS_NOT_NULL(packageDependencyContext_FrameworkWidgets.get());
+    VERIFY_ARE_EQUAL(std::wstring(packageFullName_FrameworkMathAdd.get()), expectedPackageFullName_FrameworkMathAdd);
+    VERIFY_ARE_EQUAL(std::wstring(packageFullName_FrameworkWidgets.get()), expectedPackageFullName_FrameworkWidgets);
+
+    // One update to the package graph
+    VERIFY_ARE_EQUAL(generationIdBefore + 1, MddGetGenerationId());
+
+    VerifyPackageInPackageGraph(expectedPackageFullName_WindowsAppRuntimeFramework, S_OK);
+    VerifyPackageInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+    VerifyPackageInPackageGraph(expectedPackageFullName_FrameworkWidgets, S_OK);
+    auto packagePath_FrameworkMathAdd{ TP::GetPackagePath(expectedPackageFullName_FrameworkMathAdd) };
+    auto packagePath_FrameworkWidgets{ TP::GetPackagePath(expectedPackageFullName_FrameworkWidgets) };
+    VerifyPathEnvironmentVariable(packagePath_FrameworkWidgets, packagePath_WindowsAppRuntimeFramework, packagePath_FrameworkMathAdd, pathEnvironmentVariable.c_str());
+
+    // -- Use it
+
+    // Let's use resources from the dynamically added package
+    auto mathAddDllFilename{ L"Framework.Math.Add.dll" };
+    wil::unique_hmodule mathAddDll(LoadLibrary(mathAddDllFilename));
+    {
+        const auto lastError{ GetLastError() };
+        auto message{ wil::str_printf<wil::unique_process_heap_string>(L"Error in LoadLibrary: %d (0x%X) loading %s", lastError, lastError, mathAddDllFilename) };
+        VERIFY_IS_NOT_NULL(mathAddDll.get(), message.get());
+    }
+
+    auto mathAdd{ GetProcAddressByFunctionDeclaration(mathAddDll.get(), Math_Add) };
+    VERIFY_IS_NOT_NULL(mathAdd);
+
+    const int expectedValue{ 2 + 3 };
+    const auto actualValue{ mathAdd(2, 3) };
+    VERIFY_ARE_EQUAL(expectedValue, actualValue);
+
+    // Tear down our dynamic dependencies
+
+    // -- Remove
+
+    packageDependencyContext_FrameworkWidgets.reset();
+    packageDependencyContext_FrameworkMathAdd.reset();
+
+    VerifyPackageInPackageGraph(expectedPackageFullName_WindowsAppRuntimeFramework, S_OK);
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkWidgets, S_OK);
+    VerifyPathEnvironmentVariable(packagePath_WindowsAppRuntimeFramework, pathEnvironmentVariable.c_str());
+
+    // -- Delete
+
+    MddDeletePackageDependency(packageDependencyId_FrameworkWidgets.get());
+    MddDeletePackageDependency(packageDependencyId_FrameworkMathAdd.get());
+}
+
+void Test::DynamicDependency::Test_Win32::AddMany_AllOrNothing_NotFound()
+{
+    std::wstring expectedPackageFullName_WindowsAppRuntimeFramework{ TP::WindowsAppRuntimeFramework::c_PackageFullName };
+    std::wstring expectedPackageFullName_FrameworkMathAdd{ TP::FrameworkMathAdd::c_PackageFullName };
+
+    auto pathEnvironmentVariable{ GetPathEnvironmentVariableMinusWindowsAppRuntimeFramework() };
+    auto packagePath_WindowsAppRuntimeFramework{ TP::GetPackagePath(expectedPackageFullName_WindowsAppRuntimeFramework) };
+
+    wil::unique_process_heap_string packageDependencyId_FrameworkMathAdd{ Mdd_TryCreate_FrameworkMathAdd() };
+    PCWSTR packageDependencyId_NotFound{ L"This.Does.Not.Exist" };
+
+    MddAddPackageDependencyRequest requests[]{
+        { packageDependencyId_FrameworkMathAdd.get(), MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT, MddAddPackageDependencyOptions::None },
+        { packageDependencyId_NotFound, MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT, MddAddPackageDependencyOptions::None }
+    };
+
+    // -- AddMany, all or nothing
+
+    const auto generationIdBefore{ MddGetGenerationId() };
+
+    MddAddPackageDependencyResult results[ARRAYSIZE(requests)]{};
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), MddAddPackageDependencies(ARRAYSIZE(requests), requests, MddAddPackageDependenciesOptions::AllOrNothing, results));
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_CANCELLED), results[0].hr);
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), results[1].hr);
+    VERIFY_IS_NULL(results[0].packageDependencyContext);
+    VERIFY_IS_NULL(results[1].packageDependencyContext);
+    VERIFY_IS_NULL(results[0].packageFullName);
+    VERIFY_IS_NULL(results[1].packageFullName);
+
+    VERIFY_ARE_EQUAL(generationIdBefore, MddGetGenerationId());
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+    VerifyPathEnvironmentVariable(packagePath_WindowsAppRuntimeFramework, pathEnvironmentVariable.c_str());
+
+    // -- AddMany, whatever we can
+
+    VERIFY_ARE_EQUAL(S_FALSE, MddAddPackageDependencies(ARRAYSIZE(requests), requests, MddAddPackageDependenciesOptions::None, results));
+    wil::unique_package_dependency_context packageDependencyContext_FrameworkMathAdd{ results[0].packageDependencyContext };
+    wil::unique_process_heap_string packageFullName_FrameworkMathAdd{ results[0].packageFullName };
+    VERIFY_ARE_EQUAL(S_OK, results[0].hr);
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), results[1].hr);
+    VERIFY_IS_NOT_NULL(packageDependencyContext_FrameworkMathAdd.get());
+    VERIFY_IS_NULL(results[1].packageDependencyContext);
+    VERIFY_ARE_EQUAL(std::wstring(packageFullName_FrameworkMathAdd.get()), expectedPackageFullName_FrameworkMathAdd);
+
+    VERIFY_ARE_EQUAL(generationIdBefore + 1, MddGetGenerationId());
+    VerifyPackageInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+
+    // -- Remove + Delete
+
+    packageDependencyContext_FrameworkMathAdd.reset();
+    VerifyPackageNotInPackageGraph(expectedPackageFullName_FrameworkMathAdd, S_OK);
+    VerifyPathEnvironmentVariable(packagePath_WindowsAppRuntimeFramework, pathEnvironmentVariable.c_str());
+
+    MddDeletePackageDependency(packageDependencyId_FrameworkMathAdd.get());
+}
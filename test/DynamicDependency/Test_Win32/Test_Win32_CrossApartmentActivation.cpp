@@ -0,0 +1,141 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include <MsixDynamicDependency.h>
+#include <wil_msixdynamicdependency.h>
+
+#include <roapi.h>
+
+#include "Test_Win32.h"
+
+#include "..\Perf\PerfHarness.h"
+
+namespace TF = ::Test::FileSystem;
+namespace TP = ::Test::Packages;
+
+typedef HRESULT (WINAPI* UrfwActivateInstancesFunction)(UINT32 count, const HSTRING* activatableClassIds, IInspectable** instances);
+
+void Test::DynamicDependency::Test_Win32::CrossApartmentActivation()
+{
+    wil::unique_process_heap_string packageDependencyId{ Mdd_TryCreate_FrameworkWidgets() };
+    wil::unique_package_dependency_context packageDependencyContext{ Mdd_Add(packageDependencyId.get()) };
+
+    auto activateInstances{ reinterpret_cast<UrfwActivateInstancesFunction>(GetProcAddress(GetModuleHandleW(L"Microsoft.WindowsAppRuntime.dll"), "UrfwActivateInstances")) };
+    VERIFY_IS_NOT_NULL(activateInstances);
+
+    // Widget3 is MTA-only so activating it from an STA is a cross-apartment activation.
+    // Activate it a few thousand times from an STA, one at a time and in batches, and make
+    // sure we're not leaking per activation (e.g. a threadpool each time)
+    const size_t c_activations{ 4096 };
+    const size_t c_batchSize{ 16 };
+    const winrt::hstring c_activatableClassId{ L"Microsoft.Test.DynamicDependency.Widgets.Widget3" };
+    auto activatableClassId{ static_cast<HSTRING>(winrt::get_abi(c_activatableClassId)) };
+
+    // VERIFY can't be used on our STA thread so remember the first failure and check it afterwards
+    HRESULT hr{ S_OK };
+    DWORD handleCountAfterFirst{};
+    DWORD handleCountAfterAll{};
+    Test::Perf::Samples single;
+    Test::Perf::Samples batched;
+    std::thread sta([&]() {
+        hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+        if (FAILED(hr))
+        {
+            return;
+        }
+        auto uninitialize{ wil::scope_exit([&]() { CoUninitialize(); }) };
+
+        auto activate{ [&]() {
+            wil::com_ptr<IInspectable> instance;
+            const auto activateHR{ RoActivateInstance(activatableClassId, instance.put()) };
+            if (FAILED(activateHR) || !instance)
+            {
+                hr = FAILED(activateHR) ? activateHR : E_POINTER;
+                return false;
+            }
+            try
+            {
+                // Calls go through the proxy to the MTA
+                winrt::Windows::Foundation::IInspectable inspectable{ instance.detach(), winrt::take_ownership_from_abi };
+                auto widget3{ inspectable.as<winrt::Microsoft::Test::DynamicDependency::Widgets::Widget3>() };
+                widget3.Value(42);
+                if (widget3.Value() != 42)
+                {
+                    hr = E_UNEXPECTED;
+                    return false;
+                }
+            }
+            catch (...)
+            {
+                hr = winrt::to_hresult();
+                return false;
+            }
+            return true;
+        } };
+
+        // The first one sets up the MTA
+        if (!activate())
+        {
+            return;
+        }
+        GetProcessHandleCount(GetCurrentProcess(), &handleCountAfterFirst);
+
+        for (size_t iteration=0; iteration < c_activations; ++iteration)
+        {
+            bool ok{};
+            single.Add(Test::Perf::Measure(1, [&](size_t) { ok = activate(); }));
+            if (!ok)
+            {
+                return;
+            }
+        }
+
+        std::vector<HSTRING> activatableClassIds(c_batchSize, activatableClassId);
+        for (size_t iteration=0; iteration < c_activations / c_batchSize; ++iteration)
+        {
+            IInspectable* instances[c_batchSize]{};
+            HRESULT activateHR{};
+            batched.Add(Test::Perf::Measure(1, [&](size_t) {
+                activateHR = activateInstances(static_cast<UINT32>(activatableClassIds.size()), activatableClassIds.data(), instances);
+            }));
+            if (FAILED(activateHR))
+            {
+                hr = activateHR;
+                return;
+            }
+            for (auto instance : instances)
+            {
+                if (!instance)
+                {
+                    hr = E_POINTER;
+                }
+                else
+                {
+                    instance->Release();
+                }
+            }
+            if (FAILED(hr))
+            {
+                return;
+            }
+        }
+        GetProcessHandleCount(GetCurrentProcess(), &handleCountAfterAll);
+    });
+    sta.join();
+    VERIFY_SUCCEEDED(hr);
+
+    auto Log{ [](const std::string& json) {
+        WEX::Logging::Log::Comment(WEX::Common::String(std::wstring(json.begin(), json.end()).c_str()));
+    } };
+    Log(Test::Perf::ToJson("api.activation.crossapartment", 1, 1, single));
+    Log(Test::Perf::ToJson("api.activation.crossapartment.batch16", c_batchSize, 1, batched));
+
+    // Some slack for handles the OS caches along the way, but nothing per activation
+    WEX::Logging::Log::Comment(WEX::Common::String().Format(L"Handles: %u after the first activation, %u after all", handleCountAfterFirst, handleCountAfterAll));
+    VERIFY_IS_LESS_THAN(handleCountAfterAll, handleCountAfterFirst + 64);
+
+    packageDependencyContext.reset();
+    MddDeletePackageDependency(packageDependencyId.get());
+}
@@ -0,0 +1,249 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "pch.h"
+
+#include <MsixDynamicDependency.h>
+#include <wil_msixdynamicdependency.h>
+
+#include <roapi.h>
+
+#include "Test_Win32.h"
+
+#include "..\Perf\PerfHarness.h"
+
+namespace TF = ::Test::FileSystem;
+namespace TP = ::Test::Packages;
+
+// Measurements of the real API against installed packages. Results are logged as
+// JSON Lines (see Test::Perf::ToJson()), same as the portable benchmarks in
+// test\DynamicDependency\Perf. Iterations are kept low so these also run as tests.
+
+static const size_t c_perfIterations{ 100 };
+static const size_t c_perfMaxGraphSize{ 64 };
+static const size_t c_perfMaxThreads{ 8 };
+
+static void LogPerf(const std::string& json)
+{
+    WEX::Logging::Log::Comment(WEX::Common::String(std::wstring(json.begin(), json.end()).c_str()));
+}
+
+// Run a benchmark exe (see test\DynamicDependency\Perf) and log the JSON Lines it writes to stdout
+static void RunPerfExe(const std::filesystem::path& exe, PCWSTR args)
+{
+    SECURITY_ATTRIBUTES securityAttributes{ sizeof(securityAttributes), nullptr, TRUE };
+    wil::unique_handle stdoutRead;
+    wil::unique_handle stdoutWrite;
+    VERIFY_WIN32_BOOL_SUCCEEDED(CreatePipe(&stdoutRead, &stdoutWrite, &securityAttributes, 0));
+    VERIFY_WIN32_BOOL_SUCCEEDED(SetHandleInformation(stdoutRead.get(), HANDLE_FLAG_INHERIT, 0));
+
+    STARTUPINFOW startupInfo{ sizeof(startupInfo) };
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdOutput = stdoutWrite.get();
+    startupInfo.hStdError = stdoutWrite.get();
+    startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    std::wstring commandLine{ L"\"" + exe.native() + L"\" " + args };
+    wil::unique_process_information processInformation;
+    VERIFY_WIN32_BOOL_SUCCEEDED(CreateProcessW(exe.c_str(), commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, exe.parent_path().c_str(), &startupInfo, &processInformation));
+    stdoutWrite.reset();
+
+    std::string output;
+    char buffer[4096];
+    DWORD bytesRead{};
+    while (ReadFile(stdoutRead.get(), buffer, sizeof(buffer), &bytesRead, nullptr) && (bytesRead > 0))
+    {
+        output.append(buffer, bytesRead);
+    }
+    VERIFY_ARE_EQUAL(WAIT_OBJECT_0, WaitForSingleObject(processInformation.hProcess, INFINITE));
+
+    for (size_t offset=0; offset < output.size();)
+    {
+        auto end{ output.find('\n', offset) };
+        if (end == std::string::npos)
+        {
+            end = output.size();
+        }
+        auto line{ output.substr(offset, end - offset) };
+        if (!line.empty() && (line.back() == '\r'))
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            LogPerf(line);
+        }
+        offset = end + 1;
+    }
+
+    DWORD exitCode{};
+    VERIFY_WIN32_BOOL_SUCCEEDED(GetExitCodeProcess(processInformation.hProcess, &exitCode));
+    VERIFY_ARE_EQUAL(0u, exitCode);
+}
+
+void Test::DynamicDependency::Test_Win32::Perf_Create_Add_Remove()
+{
+    const auto c_architectures{ MddPackageDependencyProcessorArchitectures::None };
+    const auto c_lifetimeKind{ MddPackageDependencyLifetimeKind::Process };
+    const PACKAGE_VERSION c_minVersion{};
+
+    Test::Perf::Samples create;
+    Test::Perf::Samples add;
+    Test::Perf::Samples remove;
+    Test::Perf::Samples del;
+    for (size_t iteration=0; iteration < c_perfIterations; ++iteration)
+    {
+        wil::unique_process_heap_string packageDependencyId;
+        create.Add(Test::Perf::Measure(1, [&](size_t) {
+            VERIFY_SUCCEEDED(MddTryCreatePackageDependency(nullptr, TP::FrameworkMathAdd::c_PackageFamilyName, c_minVersion, c_architectures, c_lifetimeKind, nullptr, MddCreatePackageDependencyOptions::None, &packageDependencyId));
+        }));
+
+        MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext{};
+        add.Add(Test::Perf::Measure(1, [&](size_t) {
+            VERIFY_SUCCEEDED(MddAddPackageDependency(packageDependencyId.get(), MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT, MddAddPackageDependencyOptions::None, &packageDependencyContext, nullptr));
+        }));
+
+        remove.Add(Test::Perf::Measure(1, [&](size_t) { MddRemovePackageDependency(packageDependencyContext); }));
+        del.Add(Test::Perf::Measure(1, [&](size_t) { MddDeletePackageDependency(packageDependencyId.get()); }));
+    }
+    LogPerf(Test::Perf::ToJson("api.create", 1, 1, create));
+    LogPerf(Test::Perf::ToJson("api.add", 1, 1, add));
+    LogPerf(Test::Perf::ToJson("api.remove", 1, 1, remove));
+    LogPerf(Test::Perf::ToJson("api.delete", 1, 1, del));
+}
+
+void Test::DynamicDependency::Test_Win32::Perf_GetCurrentPackageInfo()
+{
+    wil::unique_process_heap_string packageDependencyId{ Mdd_TryCreate_FrameworkMathAdd() };
+
+    // Every Add adds a node to the package graph, even for the same package dependency
+    std::vector<wil::unique_package_dependency_context> packageDependencyContexts;
+    for (size_t graphSize=1; graphSize <= c_perfMaxGraphSize; graphSize *= 4)
+    {
+        while (packageDependencyContexts.size() < graphSize)
+        {
+            packageDependencyContexts.emplace_back(Mdd_Add(packageDependencyId.get()));
+        }
+
+        auto getCurrentPackageInfo{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+            UINT32 packageInfoCount{};
+            const PACKAGE_INFO* packageInfo{};
+            wil::unique_cotaskmem_ptr<BYTE[]> buffer;
+            VERIFY_SUCCEEDED(GetCurrentPackageInfo(packageInfoCount, packageInfo, buffer));
+        }) };
+        LogPerf(Test::Perf::ToJson("api.getcurrentpackageinfo", graphSize, 1, getCurrentPackageInfo));
+
+        auto getCurrentPackageFullName{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+            WCHAR packageFullName[PACKAGE_FULL_NAME_MAX_LENGTH + 1]{};
+            UINT32 packageFullNameLength{ ARRAYSIZE(packageFullName) };
+            VERIFY_ARE_EQUAL(ERROR_SUCCESS, ::GetCurrentPackageFullName(&packageFullNameLength, packageFullName));
+        }) };
+        LogPerf(Test::Perf::ToJson("api.getcurrentpackagefullname", graphSize, 1, getCurrentPackageFullName));
+
+        // WinRT activation of a class not in the package graph is looked up in
+        // the package graph's WinRT index before Windows takes over
+        const winrt::hstring c_activatableClassId{ L"Windows.Foundation.Uri" };
+        auto activation{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+            wil::com_ptr<IActivationFactory> factory;
+            VERIFY_SUCCEEDED(RoGetActivationFactory(static_cast<HSTRING>(winrt::get_abi(c_activatableClassId)), IID_PPV_ARGS(&factory)));
+        }) };
+        LogPerf(Test::Perf::ToJson("api.activation.notinpackagegraph", graphSize, 1, activation));
+    }
+
+    packageDependencyContexts.clear();
+    MddDeletePackageDependency(packageDependencyId.get());
+}
+
+void Test::DynamicDependency::Test_Win32::Perf_Contention()
+{
+    wil::unique_process_heap_string packageDependencyId{ Mdd_TryCreate_FrameworkMathAdd() };
+    PCWSTR id{ packageDependencyId.get() };
+
+    // VERIFY can't be used on our worker threads so count failures and check them afterwards
+    std::atomic<size_t> failures{};
+    auto addRemove{ [&]() {
+        MDD_PACKAGEDEPENDENCY_CONTEXT packageDependencyContext{};
+        if (FAILED(MddAddPackageDependency(id, MDD_PACKAGE_DEPENDENCY_RANK_DEFAULT, MddAddPackageDependencyOptions::None, &packageDependencyContext, nullptr)))
+        {
+            ++failures;
+            return;
+        }
+        MddRemovePackageDependency(packageDependencyContext);
+    } };
+
+    for (size_t threads=1; threads <= c_perfMaxThreads; threads *= 2)
+    {
+        // Adds and removes serialize on the package graph
+        auto writers{ Test::Perf::MeasureConcurrently(threads, c_perfIterations, [&](size_t, size_t) {
+            addRemove();
+        }) };
+        LogPerf(Test::Perf::ToJson("api.addremove.contention", 1, threads, writers.samples, writers.elapsedNanoseconds));
+
+        // Readers shouldn't wait on them
+        auto readers{ Test::Perf::MeasureConcurrently(threads, c_perfIterations, [&](size_t threadIndex, size_t) {
+            if (threadIndex == 0)
+            {
+                addRemove();
+                return;
+            }
+            UINT32 packageInfoCount{};
+            const PACKAGE_INFO* packageInfo{};
+            wil::unique_cotaskmem_ptr<BYTE[]> buffer;
+            if (FAILED(GetCurrentPackageInfo(packageInfoCount, packageInfo, buffer)))
+            {
+                ++failures;
+            }
+        }) };
+        LogPerf(Test::Perf::ToJson("api.getcurrentpackageinfo.contention", 1, threads, readers.samples, readers.elapsedNanoseconds));
+    }
+    VERIFY_ARE_EQUAL(0u, failures.load());
+
+    MddDeletePackageDependency(packageDependencyId.get());
+}
+
+void Test::DynamicDependency::Test_Win32::Perf_Activation()
+{
+    wil::unique_process_heap_string packageDependencyId{ Mdd_TryCreate_FrameworkWidgets() };
+    wil::unique_package_dependency_context packageDependencyContext{ Mdd_Add(packageDependencyId.get()) };
+
+    // Activations per second through the reg-free WinRT detours. The first call
+    // loads the component so it's measured separately from the steady state
+    const winrt::hstring c_activatableClassId{ L"Microsoft.Test.DynamicDependency.Widgets.Widget2" };
+    auto activatableClassId{ static_cast<HSTRING>(winrt::get_abi(c_activatableClassId)) };
+    auto first{ Test::Perf::Measure(1, [&](size_t) {
+        wil::com_ptr<IActivationFactory> factory;
+        VERIFY_SUCCEEDED(RoGetActivationFactory(activatableClassId, IID_PPV_ARGS(&factory)));
+    }) };
+    LogPerf(Test::Perf::ToJson("api.activation.packagegraph.first", 1, 1, first));
+
+    auto hit{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+        wil::com_ptr<IActivationFactory> factory;
+        VERIFY_SUCCEEDED(RoGetActivationFactory(activatableClassId, IID_PPV_ARGS(&factory)));
+    }) };
+    LogPerf(Test::Perf::ToJson("api.activation.packagegraph", 1, 1, hit));
+
+    // Same lookup, plus creating an instance
+    auto activate{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+        wil::com_ptr<IInspectable> instance;
+        VERIFY_SUCCEEDED(RoActivateInstance(activatableClassId, instance.put()));
+        VERIFY_IS_NOT_NULL(instance.get());
+    }) };
+    LogPerf(Test::Perf::ToJson("api.activateinstance.packagegraph", 1, 1, activate));
+
+    // Not in the package graph or the SxS manifest, and not a Windows.* class
+    // so it's not short-circuited before the lookups
+    const winrt::hstring c_doesNotExist{ L"Does.Not.Exist" };
+    auto miss{ Test::Perf::Measure(c_perfIterations, [&](size_t) {
+        wil::com_ptr<IActivationFactory> factory;
+        VERIFY_ARE_EQUAL(REGDB_E_CLASSNOTREG, RoGetActivationFactory(static_cast<HSTRING>(winrt::get_abi(c_doesNotExist)), IID_PPV_ARGS(&factory)));
+    }) };
+    LogPerf(Test::Perf::ToJson("api.activation.notfound", 1, 1, miss));
+
+    packageDependencyContext.reset();
+    MddDeletePackageDependency(packageDependencyId.get());
+
+    // Classes in the SxS manifest (and UrfwEnableFactoryCache) only apply to an exe's manifest so they're
+    // measured in a process of their own
+    auto sxsActivationPerf{ TF::GetSolutionOutDirPath() / L"DynamicDependency_SxSActivationPerf" / L"SxSActivationPerf.exe" };
+    auto args{ wil::str_printf<wil::unique_process_heap_string>(L"--iterations=%zu --max-threads=%zu", c_perfIterations, c_perfMaxThreads) };
+    RunPerfExe(sxsActivationPerf, args.get());
+}
@@ -0,0 +1,15 @@
+#include "pch.h"
+#include "Microsoft.Test.DynamicDependency.Widgets.Widget3.h"
+#include "Microsoft.Test.DynamicDependency.Widgets.Widget3.g.cpp"
+
+namespace winrt::Microsoft::Test::DynamicDependency::Widgets::implementation
+{
+    int32_t Widget3::Value()
+    {
+        return m_value;
+    }
+    void Widget3::Value(int32_t value)
+    {
+        m_value = value;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Microsoft.Test.DynamicDependency.Widgets.Widget3.g.h"
+
+namespace winrt::Microsoft::Test::DynamicDependency::Widgets::implementation
+{
+    struct Widget3 : Widget3T<Widget3>
+    {
+        Widget3() = default;
+
+        int32_t Value();
+        void Value(int32_t value);
+
+    private:
+        int32_t m_value{};
+    };
+}
+namespace winrt::Microsoft::Test::DynamicDependency::Widgets::factory_implementation
+{
+    struct Widget3 : Widget3T<Widget3, implementation::Widget3>
+    {
+    };
+}
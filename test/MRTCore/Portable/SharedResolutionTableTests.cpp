@@ -0,0 +1,208 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#include "mrm/readers/SharedResolutionTable.h"
+
+#include "PortableTest.h"
+#include "SharedRegion.h"
+
+using Microsoft::Resources::SharedResolutionCacheKey;
+using Microsoft::Resources::SharedResolutionTable;
+
+namespace
+{
+    // The table over std and the test's process helpers instead of MRM's platform layer.
+    class PortableTable : public SharedResolutionTable
+    {
+    public:
+        explicit PortableTable(uint32_t abandonTimeoutInMs = DefaultAbandonTimeoutInMs)
+        {
+            m_abandonTimeoutInMs = abandonTimeoutInMs;
+        }
+
+        // Take every slot a write of the key could use and never release them, as writers that
+        // crash partway through do.
+        bool LockAndAbandon(const SharedResolutionCacheKey& key)
+        {
+            for (uint32_t probe=0; probe < ProbeLength; ++probe)
+            {
+                uint64_t lock{};
+                if (!TryLockSlot(FindSlotForWrite(&key), &lock))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::function<bool(uint32_t)> isProcessRunning{ &Test::Shared::IsProcessAlive };
+
+    protected:
+        uint32_t CurrentProcessId() const override
+        {
+            return Test::Shared::CurrentProcessId();
+        }
+
+        // steady_clock is system-wide (CLOCK_MONOTONIC, QueryPerformanceCounter), so every
+        // process sharing the region agrees on it.
+        uint64_t TickCountInMs() const override
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        bool IsProcessRunning(uint32_t processId) const override
+        {
+            return (processId == CurrentProcessId()) || isProcessRunning(processId);
+        }
+    };
+
+    constexpr size_t c_regionSize{ 256 * 1024 };
+
+    SharedResolutionCacheKey MakeKey(int resourceIndex)
+    {
+        SharedResolutionCacheKey key{};
+        key.fileIdentity = 0x1234567800000000ull | static_cast<uint32_t>(resourceIndex);
+        key.contextSignature = 0xfeedface;
+        key.mapIdentity = 7;
+        key.resourceIndex = resourceIndex;
+        return key;
+    }
+
+    // The candidate index every writer stores for a key, so any other value read back is wrong.
+    int ExpectedCandidateIndex(int resourceIndex)
+    {
+        return (resourceIndex * 31) % 1000;
+    }
+
+    // Writes and reads keys over and over. Returns how many reads came back with the wrong
+    // candidate, or -1 if it couldn't attach.
+    int WriteAndRead(void* region, size_t size, int worker, int keys, int iterations)
+    {
+        PortableTable table;
+        if (!table.Attach(region, size))
+        {
+            return -1;
+        }
+
+        int wrong{};
+        for (int iteration=0; iteration < iterations; ++iteration)
+        {
+            const int resourceIndex{ (iteration * 7 + worker * 13) % keys };
+            const auto key{ MakeKey(resourceIndex) };
+            table.SetCandidateIndex(&key, ExpectedCandidateIndex(resourceIndex));
+
+            const auto other{ MakeKey((resourceIndex + worker + 1) % keys) };
+            int candidateIndex{};
+            if (table.TryGetCandidateIndex(&other, &candidateIndex) && (candidateIndex != ExpectedCandidateIndex(other.resourceIndex)))
+            {
+                ++wrong;
+            }
+        }
+        return wrong;
+    }
+}
+
+PORTABLE_TEST(SharedResolutionTable_SharedAcrossTables)
+{
+    Test::Shared::SharedRegion region(c_regionSize);
+    PortableTable first;
+    PortableTable second;
+    PORTABLE_VERIFY(first.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY(second.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY_ARE_EQUAL(first.GetNumSlots(), second.GetNumSlots());
+
+    const auto key{ MakeKey(42) };
+    int candidateIndex{};
+    PORTABLE_VERIFY(!second.TryGetCandidateIndex(&key, &candidateIndex));
+    first.SetCandidateIndex(&key, 3);
+    PORTABLE_VERIFY(second.TryGetCandidateIndex(&key, &candidateIndex));
+    PORTABLE_VERIFY_ARE_EQUAL(3, candidateIndex);
+
+    // A region stamped for a different number of slots is someone else's
+    PortableTable smaller;
+    PORTABLE_VERIFY(!smaller.Attach(region.Get(), region.Size() / 2));
+}
+
+PORTABLE_TEST(SharedResolutionTable_ManyProcesses)
+{
+    // A small region so writers contend for (and evict) the same slots
+    constexpr int c_workers{ 8 };
+    constexpr int c_keys{ 256 };
+    constexpr int c_iterations{ 200000 };
+    Test::Shared::SharedRegion region(4096);
+
+    int wrong{};
+    const int failed{ Test::Shared::RunProcesses(c_workers,
+        [&](int index) { return WriteAndRead(region.Get(), region.Size(), index, c_keys, c_iterations); },
+        [&]() { wrong = WriteAndRead(region.Get(), region.Size(), c_workers, c_keys, c_iterations); }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+    PORTABLE_VERIFY_ARE_EQUAL(0, wrong);
+
+    // Once everyone's gone, every slot is usable again
+    PortableTable table;
+    PORTABLE_VERIFY(table.Attach(region.Get(), region.Size()));
+    for (int resourceIndex=0; resourceIndex < c_keys; ++resourceIndex)
+    {
+        const auto key{ MakeKey(resourceIndex) };
+        table.SetCandidateIndex(&key, ExpectedCandidateIndex(resourceIndex));
+        int candidateIndex{};
+        PORTABLE_VERIFY(table.TryGetCandidateIndex(&key, &candidateIndex));
+        PORTABLE_VERIFY_ARE_EQUAL(ExpectedCandidateIndex(resourceIndex), candidateIndex);
+    }
+}
+
+PORTABLE_TEST(SharedResolutionTable_RecoversFromCrashedProcess)
+{
+    if constexpr (!Test::Shared::c_workersAreProcesses)
+    {
+        std::fprintf(stderr, "  skipped (needs separate processes)\n");
+        return;
+    }
+
+    Test::Shared::SharedRegion region(c_regionSize);
+    const auto key{ MakeKey(42) };
+
+    // A writer that exits while it owns every slot the key could go in
+    const int failed{ Test::Shared::RunProcesses(1, [&](int) {
+        PortableTable writer;
+        return (writer.Attach(region.Get(), region.Size()) && writer.LockAndAbandon(key)) ? 0 : 1;
+    }) };
+    PORTABLE_VERIFY_ARE_EQUAL(0, failed);
+
+    // Never time out, so only noticing the writer has gone can free the slots
+    PortableTable table(UINT32_MAX);
+    PORTABLE_VERIFY(table.Attach(region.Get(), region.Size()));
+    table.SetCandidateIndex(&key, 5);
+    int candidateIndex{};
+    PORTABLE_VERIFY(table.TryGetCandidateIndex(&key, &candidateIndex));
+    PORTABLE_VERIFY_ARE_EQUAL(5, candidateIndex);
+}
+
+PORTABLE_TEST(SharedResolutionTable_RecoversFromHungWriter)
+{
+    constexpr uint32_t c_abandonTimeoutInMs{ 20 };
+    Test::Shared::SharedRegion region(c_regionSize);
+    PortableTable hung(c_abandonTimeoutInMs);
+    PortableTable table(c_abandonTimeoutInMs);
+    PORTABLE_VERIFY(hung.Attach(region.Get(), region.Size()));
+    PORTABLE_VERIFY(table.Attach(region.Get(), region.Size()));
+
+    // The writer's process is still running (it's this one) but it never finishes
+    const auto key{ MakeKey(42) };
+    PORTABLE_VERIFY(hung.LockAndAbandon(key));
+    table.SetCandidateIndex(&key, 5);
+    int candidateIndex{};
+    PORTABLE_VERIFY(!table.TryGetCandidateIndex(&key, &candidateIndex));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(c_abandonTimeoutInMs * 4));
+    table.SetCandidateIndex(&key, 5);
+    PORTABLE_VERIFY(table.TryGetCandidateIndex(&key, &candidateIndex));
+    PORTABLE_VERIFY_ARE_EQUAL(5, candidateIndex);
+}
@@ -0,0 +1,238 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "activationcatalog.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+
+namespace ActivationCatalog = UndockedRegFreeWinRT::ActivationCatalog;
+
+namespace
+{
+    constexpr uint8_t c_both{ 0 };
+    constexpr uint8_t c_sta{ 1 };
+    constexpr uint8_t c_mta{ 2 };
+
+    const char c_widgetsManifest[]{ R"(<?xml version="1.0" encoding="utf-8"?>
+<assembly manifestVersion="1.0" xmlns="urn:schemas-microsoft-com:asm.v1">
+  <assemblyIdentity version="1.0.0.0" name="Contoso.App"/>
+  <!-- <file name="Commented.dll"><activatableClass name="Commented.Out" threadingModel="both"/></file> -->
+  <file name="Contoso.Widgets.dll">
+    <activatableClass
+        name="Contoso.Widgets.Widget"
+        threadingModel="both"
+        xmlns="urn:schemas-microsoft-com:winrt.v1" />
+    <activatableClass name="Contoso.Widgets.Gadget" threadingModel="STA" xmlns="urn:schemas-microsoft-com:winrt.v1"/>
+  </file>
+  <FILE Name='Fabrikam.Gizmos.dll'>
+    <winrt:ActivatableClass winrt:name="Fabrikam.Gizmos.Gizmo&amp;Co" ThreadingModel="mta" xmlns:winrt="urn:schemas-microsoft-com:winrt.v1"></winrt:ActivatableClass>
+  </FILE>
+  <activatableClass name="Not.In.A.File" threadingModel="both"/>
+</assembly>
+)" };
+
+    // What c_widgetsManifest declares, as ParseRootManifestFromXmlReaderInput() reads it
+    const std::vector<ActivationCatalog::ActivatableClass> c_widgetsClasses{
+        { L"Contoso.Widgets.Widget", L"Contoso.Widgets.dll", c_both },
+        { L"Contoso.Widgets.Gadget", L"Contoso.Widgets.dll", c_sta },
+        { L"Fabrikam.Gizmos.Gizmo&Co", L"Fabrikam.Gizmos.dll", c_mta },
+    };
+
+    void VerifyClass(const ActivationCatalog::ActivatableClass& activatableClass, const wchar_t* activatableClassId, const wchar_t* moduleName, uint8_t threadingModel)
+    {
+        PORTABLE_VERIFY(activatableClass.activatableClassId == activatableClassId);
+        PORTABLE_VERIFY(activatableClass.moduleName == moduleName);
+        PORTABLE_VERIFY_ARE_EQUAL(threadingModel, activatableClass.threadingModel);
+    }
+
+    // A manifest declaring fileCount files with classesPerFile classes each
+    std::string GenerateManifest(size_t fileCount, size_t classesPerFile)
+    {
+        std::string manifest{ R"(<?xml version="1.0" encoding="utf-8"?>)" "\n" R"(<assembly manifestVersion="1.0" xmlns="urn:schemas-microsoft-com:asm.v1">)" "\n" };
+        for (size_t file=0; file < fileCount; ++file)
+        {
+            manifest += "  <file name=\"Contoso.Component" + std::to_string(file) + ".dll\">\n";
+            for (size_t index=0; index < classesPerFile; ++index)
+            {
+                manifest += "    <activatableClass name=\"Contoso.Component" + std::to_string(file) + ".Class" + std::to_string(index) +
+                            "\" threadingModel=\"both\" xmlns=\"urn:schemas-microsoft-com:winrt.v1\" />\n";
+            }
+            manifest += "  </file>\n";
+        }
+        manifest += "</assembly>\n";
+        return manifest;
+    }
+
+    // The classes GenerateManifest(fileCount, classesPerFile) declares with classesPerFile classes each would
+    std::vector<ActivationCatalog::ActivatableClass> GenerateClasses(size_t fileCount, size_t classesPerFile)
+    {
+        std::vector<ActivationCatalog::ActivatableClass> activatableClasses;
+        for (size_t file=0; file < fileCount; ++file)
+        {
+            const auto moduleName{ L"Contoso.Component" + std::to_wstring(file) + L".dll" };
+            for (size_t index=0; index < classesPerFile; ++index)
+            {
+                activatableClasses.push_back({ L"Contoso.Component" + std::to_wstring(file) + L".Class" + std::to_wstring(index), moduleName, c_both });
+            }
+        }
+        return activatableClasses;
+    }
+}
+
+PORTABLE_TEST(ActivationCatalog_CompilesAndFinds)
+{
+    const auto& activatableClasses{ c_widgetsClasses };
+    const std::vector<ActivationCatalog::Source> sources{
+        { L"C:\\app\\Contoso.App.exe", 0x0123456789ABCDEFull },
+        { L"C:\\app\\Contoso.Widgets.manifest", ActivationCatalog::HashManifest(reinterpret_cast<const uint8_t*>(c_widgetsManifest), sizeof(c_widgetsManifest) - 1) },
+    };
+
+    std::vector<uint8_t> catalog;
+    PORTABLE_VERIFY(ActivationCatalog::Compile(sources, activatableClasses, catalog));
+
+    ActivationCatalog::View view;
+    PORTABLE_VERIFY(view.Open(catalog.data(), catalog.size()));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, view.SourceCount());
+    PORTABLE_VERIFY(view.GetSource(0).path == sources[0].path);
+    PORTABLE_VERIFY_ARE_EQUAL(sources[0].hash, view.GetSource(0).hash);
+    PORTABLE_VERIFY_ARE_EQUAL(sources[1].hash, view.GetSource(1).hash);
+
+    // Module paths are stored once, however many classes they implement
+    PORTABLE_VERIFY_ARE_EQUAL(3u, view.ClassCount());
+    PORTABLE_VERIFY_ARE_EQUAL(2u, view.ModuleCount());
+
+    for (const auto& activatableClass : activatableClasses)
+    {
+        const auto index{ view.Find(activatableClass.activatableClassId) };
+        PORTABLE_VERIFY(index >= 0);
+        const auto found{ view.GetActivatableClass(static_cast<uint32_t>(index)) };
+        VerifyClass(found, activatableClass.activatableClassId.c_str(), activatableClass.moduleName.c_str(), activatableClass.threadingModel);
+    }
+
+    // Lookups are ordinal: exact case, no prefixes
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L"contoso.widgets.widget"));
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L"Contoso.Widgets.Widge"));
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L"Contoso.Widgets.WidgetX"));
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L""));
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L"Not.In.A.File"));
+
+    // Empty catalogs are fine too
+    PORTABLE_VERIFY(ActivationCatalog::Compile({}, {}, catalog));
+    PORTABLE_VERIFY(view.Open(catalog.data(), catalog.size()));
+    PORTABLE_VERIFY_ARE_EQUAL(0u, view.ClassCount());
+    PORTABLE_VERIFY_ARE_EQUAL(-1, view.Find(L"Contoso.Widgets.Widget"));
+}
+
+PORTABLE_TEST(ActivationCatalog_RejectsDuplicates)
+{
+    const std::vector<ActivationCatalog::ActivatableClass> activatableClasses{
+        { L"Contoso.Widgets.Widget", L"Contoso.Widgets.dll", c_both },
+        { L"Contoso.Widgets.Widget", L"Contoso.Widgets2.dll", c_sta },
+    };
+    std::vector<uint8_t> catalog;
+    PORTABLE_VERIFY(!ActivationCatalog::Compile({}, activatableClasses, catalog));
+    PORTABLE_VERIFY(catalog.empty());
+}
+
+PORTABLE_TEST(ActivationCatalog_RejectsCorruptCatalogs)
+{
+    const auto& activatableClasses{ c_widgetsClasses };
+    std::vector<uint8_t> catalog;
+    PORTABLE_VERIFY(ActivationCatalog::Compile({ { L"C:\\app\\Contoso.App.exe", 1 } }, activatableClasses, catalog));
+
+    ActivationCatalog::View view;
+    for (size_t size=0; size < catalog.size(); ++size)
+    {
+        PORTABLE_VERIFY(!view.Open(catalog.data(), size));
+    }
+    for (size_t offset=0; offset < catalog.size(); ++offset)
+    {
+        auto corrupt{ catalog };
+        corrupt[offset] ^= 0x20;
+        PORTABLE_VERIFY(!view.Open(corrupt.data(), corrupt.size()));
+    }
+    PORTABLE_VERIFY(!view.Open(nullptr, 0));
+    PORTABLE_VERIFY(view.Open(catalog.data(), catalog.size()));
+}
+
+PORTABLE_TEST(ActivationCatalog_ConfinesModulePaths)
+{
+    PORTABLE_VERIFY(ActivationCatalog::IsConfinedModulePath(L"Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(ActivationCatalog::IsConfinedModulePath(L"bin\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(ActivationCatalog::IsConfinedModulePath(L"bin/x64/Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(ActivationCatalog::IsConfinedModulePath(L"Contoso..Widgets.dll"));
+
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L""));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"C:\\evil\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"C:Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"\\\\server\\share\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"/Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"..\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"bin\\..\\..\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"bin/../Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"bin\\.. \\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"bin\\...\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"bin\\\\Contoso.Widgets.dll"));
+    PORTABLE_VERIFY(!ActivationCatalog::IsConfinedModulePath(L"Contoso.Widgets.dll:stream"));
+}
+
+PORTABLE_TEST(ActivationCatalog_RejectsUnknownThreadingModels)
+{
+    std::vector<uint8_t> catalog;
+    PORTABLE_VERIFY(ActivationCatalog::Compile({}, { { L"Contoso.Widgets.Widget", L"Contoso.Widgets.dll", 3 } }, catalog));
+    ActivationCatalog::View view;
+    PORTABLE_VERIFY(!view.Open(catalog.data(), catalog.size()));
+}
+
+PORTABLE_BENCHMARK(ActivationCatalog_Benchmark)
+{
+    for (size_t classCount : { 16, 256, 4096 })
+    {
+        const size_t c_classesPerFile{ 16 };
+        const auto manifest{ GenerateManifest(classCount / c_classesPerFile, c_classesPerFile) };
+        const auto* data{ reinterpret_cast<const uint8_t*>(manifest.data()) };
+        const size_t c_iterations{ std::max<size_t>(20, 20000 / classCount) };
+
+        // Startup without a catalog: build the lookup table (parsing the manifest with IXmlReader,
+        // which only runs on Windows, comes on top of this)
+        const auto activatableClasses{ GenerateClasses(classCount / c_classesPerFile, c_classesPerFile) };
+        auto samples{ Test::Perf::Measure(c_iterations, [&](size_t) {
+            std::unordered_map<std::wstring, const ActivationCatalog::ActivatableClass*> types;
+            for (const auto& activatableClass : activatableClasses)
+            {
+                types.emplace(activatableClass.activatableClassId, &activatableClass);
+            }
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("activationcatalog.index", classCount, 1, samples).c_str());
+
+        std::vector<uint8_t> catalog;
+        samples = Test::Perf::Measure(c_iterations, [&](size_t) {
+            ActivationCatalog::Compile({ { L"C:\\app\\Contoso.App.exe", 1 } }, activatableClasses, catalog);
+        });
+        std::printf("%s\n", Test::Perf::ToJson("activationcatalog.compile", classCount, 1, samples).c_str());
+
+        // Startup with a catalog: validate its source (hash the manifest) and open it in place
+        ActivationCatalog::View view;
+        samples = Test::Perf::Measure(c_iterations, [&](size_t) {
+            (void)ActivationCatalog::HashManifest(data, manifest.size());
+            view.Open(catalog.data(), catalog.size());
+        });
+        std::printf("%s\n", Test::Perf::ToJson("activationcatalog.open", classCount, 1, samples).c_str());
+
+        samples = Test::Perf::Measure(20000, [&](size_t iteration) {
+            view.Find(activatableClasses[iteration % activatableClasses.size()].activatableClassId);
+        });
+        std::printf("%s\n", Test::Perf::ToJson("activationcatalog.find", classCount, 1, samples).c_str());
+        std::fprintf(stderr, "  classes=%zu manifest=%zu bytes catalog=%zu bytes\n", classCount, manifest.size(), catalog.size());
+    }
+}
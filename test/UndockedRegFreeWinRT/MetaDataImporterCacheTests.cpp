@@ -0,0 +1,287 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metadataimportercache.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+
+using UndockedRegFreeWinRT::MetaDataImporterCache;
+
+namespace
+{
+    // Stands in for IMetaDataImport2; the cache only copies handles around
+    struct MockImporter
+    {
+        std::wstring path;
+    };
+
+    using MockImporterPtr = std::shared_ptr<MockImporter>;
+
+    // Stands in for IMetaDataDispenserEx::OpenScope()
+    class MockImporterFactory
+    {
+    public:
+        explicit MockImporterFactory(uint32_t openCost = 0) :
+            m_openCost(openCost)
+        {
+        }
+
+        int32_t operator()(const std::wstring& path, MockImporterPtr& importer)
+        {
+            ++m_opens;
+            {
+                auto lock{ std::lock_guard<std::mutex>(m_lock) };
+                if (m_missingFiles.count(path) != 0)
+                {
+                    return -1;
+                }
+            }
+
+            // Opening a scope reads and validates the file's headers; make it cost something
+            volatile uint32_t hash{ 2166136261u };
+            for (uint32_t index=0; index < m_openCost; ++index)
+            {
+                hash = (hash ^ index) * 16777619u;
+            }
+
+            importer = std::make_shared<MockImporter>(MockImporter{ path });
+            return 0;
+        }
+
+        void Missing(const std::wstring& path)
+        {
+            auto lock{ std::lock_guard<std::mutex>(m_lock) };
+            m_missingFiles.insert(path);
+        }
+
+        uint64_t Opens() const
+        {
+            return m_opens.load();
+        }
+
+    private:
+        uint32_t m_openCost{};
+        std::atomic<uint64_t> m_opens{};
+        std::mutex m_lock;
+        std::set<std::wstring> m_missingFiles;
+    };
+
+    std::wstring WinmdPath(size_t index)
+    {
+        return L"C:\\app\\Contoso.Component" + std::to_wstring(index) + L".winmd";
+    }
+
+    MockImporterPtr Get(MetaDataImporterCache<MockImporterPtr>& cache, MockImporterFactory& factory, const std::wstring& path)
+    {
+        MockImporterPtr importer;
+        PORTABLE_VERIFY_ARE_EQUAL(0, cache.GetOrOpen(path, factory, importer));
+        PORTABLE_VERIFY(importer);
+        PORTABLE_VERIFY(importer->path == path);
+        return importer;
+    }
+}
+
+PORTABLE_TEST(MetaDataImporterCache_OpensOnce)
+{
+    MetaDataImporterCache<MockImporterPtr> cache;
+    MockImporterFactory factory;
+
+    auto first{ Get(cache, factory, WinmdPath(1)) };
+    auto second{ Get(cache, factory, WinmdPath(1)) };
+    PORTABLE_VERIFY(first == second);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, factory.Opens());
+
+    const auto statistics{ cache.GetStatistics() };
+    PORTABLE_VERIFY_ARE_EQUAL(1u, statistics.hits);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, statistics.misses);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, statistics.size);
+}
+
+PORTABLE_TEST(MetaDataImporterCache_FailuresAreNotCached)
+{
+    MetaDataImporterCache<MockImporterPtr> cache;
+    MockImporterFactory factory;
+    factory.Missing(WinmdPath(1));
+
+    MockImporterPtr importer;
+    PORTABLE_VERIFY_ARE_EQUAL(-1, cache.GetOrOpen(WinmdPath(1), factory, importer));
+    PORTABLE_VERIFY(!importer);
+    PORTABLE_VERIFY_ARE_EQUAL(-1, cache.GetOrOpen(WinmdPath(1), factory, importer));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, factory.Opens());
+    PORTABLE_VERIFY_ARE_EQUAL(0u, cache.GetStatistics().size);
+}
+
+PORTABLE_TEST(MetaDataImporterCache_EvictsLeastRecentlyUsed)
+{
+    MetaDataImporterCache<MockImporterPtr> cache(2, 2);
+    MockImporterFactory factory;
+
+    auto a{ Get(cache, factory, WinmdPath(1)) };
+    Get(cache, factory, WinmdPath(2));
+    Get(cache, factory, WinmdPath(1));
+    Get(cache, factory, WinmdPath(3));
+    PORTABLE_VERIFY_ARE_EQUAL(3u, factory.Opens());
+    PORTABLE_VERIFY_ARE_EQUAL(1u, cache.GetStatistics().evictions);
+
+    // 1 was used more recently than 2 so it's still there
+    Get(cache, factory, WinmdPath(1));
+    PORTABLE_VERIFY_ARE_EQUAL(3u, factory.Opens());
+    Get(cache, factory, WinmdPath(2));
+    PORTABLE_VERIFY_ARE_EQUAL(4u, factory.Opens());
+
+    // Evicted importers live on while someone has them
+    Get(cache, factory, WinmdPath(3));
+    Get(cache, factory, WinmdPath(2));
+    Get(cache, factory, WinmdPath(4));
+    PORTABLE_VERIFY(a->path == WinmdPath(1));
+    PORTABLE_VERIFY_ARE_EQUAL(2u, cache.GetStatistics().size);
+}
+
+PORTABLE_TEST(MetaDataImporterCache_GrowsToWorkingSet)
+{
+    MetaDataImporterCache<MockImporterPtr> cache(2, 16);
+    MockImporterFactory factory;
+
+    // Cycling through more files than fit evicts each one just before it's needed again,
+    // which is what the capacity adapts to
+    const size_t c_workingSet{ 6 };
+    for (size_t round=0; round < 8; ++round)
+    {
+        for (size_t index=0; index < c_workingSet; ++index)
+        {
+            Get(cache, factory, WinmdPath(index));
+        }
+    }
+    const auto statistics{ cache.GetStatistics() };
+    PORTABLE_VERIFY(statistics.capacity >= c_workingSet);
+    PORTABLE_VERIFY(statistics.capacity <= 16);
+
+    // Once it's grown it's all hits
+    const auto opens{ factory.Opens() };
+    for (size_t index=0; index < c_workingSet; ++index)
+    {
+        Get(cache, factory, WinmdPath(index));
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(opens, factory.Opens());
+}
+
+PORTABLE_TEST(MetaDataImporterCache_FixedCapacity)
+{
+    MetaDataImporterCache<MockImporterPtr> cache(3, 3);
+    MockImporterFactory factory;
+    for (size_t round=0; round < 4; ++round)
+    {
+        for (size_t index=0; index < 5; ++index)
+        {
+            Get(cache, factory, WinmdPath(index));
+        }
+    }
+    const auto statistics{ cache.GetStatistics() };
+    PORTABLE_VERIFY_ARE_EQUAL(3u, statistics.capacity);
+    PORTABLE_VERIFY_ARE_EQUAL(3u, statistics.size);
+
+    cache.SetCapacity(1, 1);
+    PORTABLE_VERIFY_ARE_EQUAL(1u, cache.GetStatistics().size);
+
+    cache.Clear();
+    PORTABLE_VERIFY_ARE_EQUAL(0u, cache.GetStatistics().size);
+}
+
+PORTABLE_TEST(MetaDataImporterCache_Concurrent)
+{
+    MetaDataImporterCache<MockImporterPtr> cache(4, 32);
+    MockImporterFactory factory;
+
+    const size_t c_threads{ 8 };
+    const size_t c_iterations{ 2000 };
+    std::atomic<size_t> failures{};
+    std::vector<std::thread> threads;
+    for (size_t thread=0; thread < c_threads; ++thread)
+    {
+        threads.emplace_back([&, thread]() {
+            for (size_t iteration=0; iteration < c_iterations; ++iteration)
+            {
+                const auto path{ WinmdPath((thread + iteration) % 12) };
+                MockImporterPtr importer;
+                if ((cache.GetOrOpen(path, factory, importer) != 0) || !importer || (importer->path != path))
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(0u, failures.load());
+
+    const auto statistics{ cache.GetStatistics() };
+    PORTABLE_VERIFY_ARE_EQUAL(c_threads * c_iterations, statistics.hits + statistics.misses);
+    PORTABLE_VERIFY(statistics.size <= statistics.capacity);
+}
+
+PORTABLE_BENCHMARK(MetaDataImporterCache_Benchmark)
+{
+    const size_t c_iterations{ 20000 };
+    const uint32_t c_openCost{ 20000 };
+
+    // The old cache held 5 importers; compare that against the default adaptive capacity
+    for (size_t workingSet : { 4, 16, 64 })
+    {
+        for (bool adaptive : { false, true })
+        {
+            MetaDataImporterCache<MockImporterPtr> cache(adaptive ? MetaDataImporterCache<MockImporterPtr>::c_defaultInitialCapacity : 5,
+                                                         adaptive ? MetaDataImporterCache<MockImporterPtr>::c_defaultMaxCapacity : 5);
+            MockImporterFactory factory(c_openCost);
+            std::vector<std::wstring> paths;
+            for (size_t index=0; index < workingSet; ++index)
+            {
+                paths.push_back(WinmdPath(index));
+            }
+
+            auto samples{ Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+                MockImporterPtr importer;
+                cache.GetOrOpen(paths[iteration % workingSet], factory, importer);
+            }) };
+            const auto statistics{ cache.GetStatistics() };
+            std::printf("%s\n", Test::Perf::ToJson(adaptive ? "importercache.adaptive" : "importercache.fixed5", workingSet, 1, samples).c_str());
+            std::fprintf(stderr, "  workingSet=%zu %s: hits=%llu misses=%llu evictions=%llu capacity=%zu\n",
+                         workingSet, adaptive ? "adaptive" : "fixed5",
+                         static_cast<unsigned long long>(statistics.hits), static_cast<unsigned long long>(statistics.misses),
+                         static_cast<unsigned long long>(statistics.evictions), statistics.capacity);
+        }
+    }
+
+    // Hits under contention only take the shared lock
+    for (size_t threads=1; threads <= 8; threads *= 2)
+    {
+        MetaDataImporterCache<MockImporterPtr> cache;
+        MockImporterFactory factory(c_openCost);
+        std::vector<std::wstring> paths;
+        for (size_t index=0; index < 8; ++index)
+        {
+            paths.push_back(WinmdPath(index));
+            MockImporterPtr importer;
+            cache.GetOrOpen(paths.back(), factory, importer);
+        }
+
+        auto concurrent{ Test::Perf::MeasureConcurrently(threads, c_iterations / threads, [&](size_t threadIndex, size_t iteration) {
+            MockImporterPtr importer;
+            cache.GetOrOpen(paths[(threadIndex + iteration) % paths.size()], factory, importer);
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("importercache.hit.contention", paths.size(), threads, concurrent.samples, concurrent.elapsedNanoseconds).c_str());
+    }
+}
@@ -0,0 +1,476 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "winmdreader.h"
+#include "winmdtypeindex.h"
+
+#include "PerfHarness.h"
+
+#include "PortableTest.h"
+#include "WinMDWriter.h"
+
+using UndockedRegFreeWinRT::IWinMDDirectory;
+using UndockedRegFreeWinRT::WinMDTypeIndex;
+using UndockedRegFreeWinRT::WinMDTypeLocation;
+namespace WinMD = UndockedRegFreeWinRT::WinMD;
+
+namespace
+{
+    constexpr uint32_t c_publicRuntimeClass{ WinMD::c_tdWindowsRuntime | WinMD::c_tdPublic };
+    constexpr uint32_t c_privateClass{ 0 };
+
+    // Stands in for a directory of .winmd files
+    class MockDirectory : public IWinMDDirectory
+    {
+    public:
+        struct State
+        {
+            std::mutex lock;
+            uint64_t lastWriteTime{ 1 };
+            std::map<std::wstring, std::pair<IWinMDDirectory::File, std::vector<uint8_t>>> files;
+            std::atomic<uint64_t> reads{};
+
+            void Add(const std::wstring& name, const std::vector<Test::WinMD::TypeDefinition>& types)
+            {
+                auto lock{ std::lock_guard<std::mutex>(this->lock) };
+                ++lastWriteTime;
+                auto image{ Test::WinMD::WriteWinMD(types) };
+                files[name] = { IWinMDDirectory::File{ name, lastWriteTime, image.size() }, std::move(image) };
+            }
+
+            void Rewrite(const std::wstring& name, const std::vector<Test::WinMD::TypeDefinition>& types)
+            {
+                // Rewriting a file in place doesn't change the directory's last write time
+                auto lock{ std::lock_guard<std::mutex>(this->lock) };
+                auto& [file, image]{ files.at(name) };
+                image = Test::WinMD::WriteWinMD(types);
+                ++file.lastWriteTime;
+                file.size = image.size();
+            }
+
+            void Remove(const std::wstring& name)
+            {
+                auto lock{ std::lock_guard<std::mutex>(this->lock) };
+                ++lastWriteTime;
+                files.erase(name);
+            }
+        };
+
+        explicit MockDirectory(std::shared_ptr<State> state) :
+            m_state(std::move(state))
+        {
+        }
+
+        uint64_t GetLastWriteTime() override
+        {
+            auto lock{ std::lock_guard<std::mutex>(m_state->lock) };
+            return m_state->lastWriteTime;
+        }
+
+        std::vector<File> GetFiles() override
+        {
+            auto lock{ std::lock_guard<std::mutex>(m_state->lock) };
+            std::vector<File> files;
+            for (const auto& [name, file] : m_state->files)
+            {
+                files.push_back(file.first);
+            }
+            return files;
+        }
+
+        bool ReadTypeDefs(const std::wstring& fileName, std::vector<WinMD::TypeDef>& typeDefs) override
+        {
+            std::vector<uint8_t> image;
+            {
+                auto lock{ std::lock_guard<std::mutex>(m_state->lock) };
+                auto iterator{ m_state->files.find(fileName) };
+                if (iterator == m_state->files.end())
+                {
+                    return false;
+                }
+                image = iterator->second.second;
+            }
+            ++m_state->reads;
+            return WinMD::ReadTypeDefs(image.data(), image.size(), typeDefs);
+        }
+
+    private:
+        std::shared_ptr<State> m_state;
+    };
+
+    std::shared_ptr<MockDirectory::State> MakeContosoDirectory()
+    {
+        auto state{ std::make_shared<MockDirectory::State>() };
+        state->Add(L"Contoso.winmd", {
+            { "Contoso", "Thing", c_publicRuntimeClass },
+            { "Contoso", "Helper", c_privateClass },
+        });
+        state->Add(L"Contoso.Widgets.winmd", {
+            { "Contoso.Widgets", "Widget", c_publicRuntimeClass },
+            { "Contoso.Widgets", "IWidget", c_publicRuntimeClass | 0x000000A0 },    // tdInterface | tdAbstract
+            { "Contoso.Widgets.Controls", "Button", c_publicRuntimeClass },
+        });
+        state->Add(L"fabrikam.Gadgets.WINMD", {
+            { "Fabrikam.Gadgets", "Gadget", c_publicRuntimeClass },
+        });
+        state->Add(L"Unrelated.winmd", {
+            { "Contoso.Widgets", "Misplaced", c_publicRuntimeClass },
+        });
+        return state;
+    }
+
+    void VerifyType(WinMDTypeIndex& index, const std::wstring& name, const std::wstring& fileName, uint32_t token)
+    {
+        const auto location{ index.Find(name) };
+        PORTABLE_VERIFY(location.kind == WinMDTypeLocation::Kind::Type);
+        PORTABLE_VERIFY(location.fileName == fileName);
+        PORTABLE_VERIFY_ARE_EQUAL(token, location.token);
+    }
+
+    void VerifyKind(WinMDTypeIndex& index, const std::wstring& name, WinMDTypeLocation::Kind kind)
+    {
+        PORTABLE_VERIFY(index.Find(name).kind == kind);
+    }
+}
+
+PORTABLE_TEST(WinMDReader_ReadsTypeDefs)
+{
+    const auto image{ Test::WinMD::WriteWinMD({
+        { "Contoso.Widgets", "Widget", c_publicRuntimeClass },
+        { "", "NoNamespace", c_privateClass },
+        { "Contoso.Widgets", "Widget\xC3\xA9\xF0\x9F\x98\x80", c_publicRuntimeClass },
+    }) };
+
+    std::vector<WinMD::TypeDef> typeDefs;
+    PORTABLE_VERIFY(WinMD::ReadTypeDefs(image.data(), image.size(), typeDefs));
+    PORTABLE_VERIFY_ARE_EQUAL(4u, typeDefs.size());
+    PORTABLE_VERIFY(typeDefs[0].name == L"<Module>");
+    PORTABLE_VERIFY_ARE_EQUAL(0x02000001u, typeDefs[0].token);
+    PORTABLE_VERIFY(typeDefs[1].name == L"Contoso.Widgets.Widget");
+    PORTABLE_VERIFY_ARE_EQUAL(c_publicRuntimeClass, typeDefs[1].flags);
+    PORTABLE_VERIFY_ARE_EQUAL(0x02000002u, typeDefs[1].token);
+    PORTABLE_VERIFY(typeDefs[2].name == L"NoNamespace");
+    PORTABLE_VERIFY_ARE_EQUAL(0x02000003u, typeDefs[2].token);
+
+    // UTF-8 names come back as UTF-16 (or UTF-32, wherever wchar_t is 32 bits)
+    std::wstring expected{ L"Contoso.Widgets.Widgeté" };
+    if (sizeof(wchar_t) == 2)
+    {
+        expected += static_cast<wchar_t>(0xD83D);
+        expected += static_cast<wchar_t>(0xDE00);
+    }
+    else
+    {
+        expected += static_cast<wchar_t>(0x1F600);
+    }
+    PORTABLE_VERIFY(typeDefs[3].name == expected);
+}
+
+PORTABLE_TEST(WinMDReader_WideStringIndexes)
+{
+    // Over 64KB of names needs 4 byte #Strings indexes
+    std::vector<Test::WinMD::TypeDefinition> types;
+    for (size_t index=0; index < 2000; ++index)
+    {
+        types.push_back({ "Contoso.Widgets.With.A.Rather.Long.Namespace", "Widget" + std::to_string(index), c_publicRuntimeClass });
+    }
+    const auto image{ Test::WinMD::WriteWinMD(types) };
+
+    std::vector<WinMD::TypeDef> typeDefs;
+    PORTABLE_VERIFY(WinMD::ReadTypeDefs(image.data(), image.size(), typeDefs));
+    PORTABLE_VERIFY_ARE_EQUAL(types.size() + 1, typeDefs.size());
+    PORTABLE_VERIFY(typeDefs.back().name == L"Contoso.Widgets.With.A.Rather.Long.Namespace.Widget1999");
+    PORTABLE_VERIFY_ARE_EQUAL(static_cast<uint32_t>(0x02000001 + types.size()), typeDefs.back().token);
+}
+
+PORTABLE_TEST(WinMDReader_RejectsMalformed)
+{
+    const auto image{ Test::WinMD::WriteWinMD({ { "Contoso", "Thing", c_publicRuntimeClass } }) };
+    std::vector<WinMD::TypeDef> typeDefs;
+
+    // Every truncation must fail cleanly, never read out of bounds
+    size_t readable{};
+    for (size_t size=0; size < image.size(); ++size)
+    {
+        std::vector<uint8_t> truncated(image.begin(), image.begin() + size);
+        if (WinMD::ReadTypeDefs(truncated.data(), truncated.size(), typeDefs))
+        {
+            ++readable;
+        }
+    }
+    // ...except those that only cut off the section's padding
+    PORTABLE_VERIFY(readable < image.size());
+
+    const std::vector<uint8_t> notPE{ 'N', 'o', 't', ' ', 'a', ' ', 'P', 'E' };
+    PORTABLE_VERIFY(!WinMD::ReadTypeDefs(notPE.data(), notPE.size(), typeDefs));
+    PORTABLE_VERIFY(!WinMD::ReadTypeDefs(nullptr, 0, typeDefs));
+
+    // Corrupt the metadata signature
+    auto corrupt{ image };
+    corrupt[0x200 + 72] ^= 0xFF;
+    PORTABLE_VERIFY(!WinMD::ReadTypeDefs(corrupt.data(), corrupt.size(), typeDefs));
+}
+
+PORTABLE_TEST(WinMDTypeIndex_FindsTypes)
+{
+    WinMDTypeIndex index(std::make_unique<MockDirectory>(MakeContosoDirectory()));
+
+    VerifyType(index, L"Contoso.Thing", L"Contoso.winmd", 0x02000002);
+    VerifyType(index, L"Contoso.Widgets.Widget", L"Contoso.Widgets.winmd", 0x02000002);
+    VerifyType(index, L"Contoso.Widgets.IWidget", L"Contoso.Widgets.winmd", 0x02000003);
+
+    // Found in the file named for the closest enclosing namespace
+    VerifyType(index, L"Contoso.Widgets.Controls.Button", L"Contoso.Widgets.winmd", 0x02000004);
+
+    // File names are case insensitive; type names aren't
+    VerifyType(index, L"Fabrikam.Gadgets.Gadget", L"fabrikam.Gadgets.WINMD", 0x02000002);
+    VerifyKind(index, L"Fabrikam.Gadgets.gadget", WinMDTypeLocation::Kind::NotFound);
+
+    // Only Windows Runtime types count
+    VerifyKind(index, L"Contoso.Helper", WinMDTypeLocation::Kind::NotFound);
+
+    // Types in a file not named for them (or any of their namespaces) aren't found
+    VerifyKind(index, L"Contoso.Widgets.Misplaced", WinMDTypeLocation::Kind::NotFound);
+    VerifyKind(index, L"Unrelated", WinMDTypeLocation::Kind::NotFound);
+    VerifyKind(index, L"", WinMDTypeLocation::Kind::NotFound);
+}
+
+PORTABLE_TEST(WinMDTypeIndex_FindsNamespaces)
+{
+    WinMDTypeIndex index(std::make_unique<MockDirectory>(MakeContosoDirectory()));
+
+    VerifyKind(index, L"Contoso", WinMDTypeLocation::Kind::Namespace);
+    VerifyKind(index, L"Contoso.Widgets", WinMDTypeLocation::Kind::Namespace);
+    VerifyKind(index, L"Fabrikam", WinMDTypeLocation::Kind::Namespace);
+
+    // Namespaces are only found in files whose names start with them (Name*.winmd)
+    VerifyKind(index, L"Contoso.Widgets.Controls", WinMDTypeLocation::Kind::NotFound);
+    VerifyKind(index, L"Contoso.Widg", WinMDTypeLocation::Kind::NotFound);
+
+    PORTABLE_VERIFY(index.MayResolveNamespace(L"Contoso.Widgets.Controls"));
+    PORTABLE_VERIFY(index.MayResolveNamespace(L"Fabrikam"));
+    PORTABLE_VERIFY(index.MayResolveNamespace(L"Unrelated.Stuff"));
+    PORTABLE_VERIFY(index.MayResolveNamespace(L""));
+    PORTABLE_VERIFY(!index.MayResolveNamespace(L"Windows.Foundation"));
+    PORTABLE_VERIFY(!index.MayResolveNamespace(L"Contoso2"));
+}
+
+PORTABLE_TEST(WinMDTypeIndex_CachesResults)
+{
+    auto state{ MakeContosoDirectory() };
+    WinMDTypeIndex index(std::make_unique<MockDirectory>(state));
+
+    for (size_t iteration=0; iteration < 3; ++iteration)
+    {
+        VerifyType(index, L"Contoso.Widgets.Widget", L"Contoso.Widgets.winmd", 0x02000002);
+        VerifyKind(index, L"Contoso.Widgets.DoesNotExist", WinMDTypeLocation::Kind::NotFound);
+    }
+
+    // Each file was read once, and repeated lookups (found or not) were answered from the cache
+    const auto statistics{ index.GetStatistics() };
+    PORTABLE_VERIFY_ARE_EQUAL(1u, statistics.builds);
+    PORTABLE_VERIFY_ARE_EQUAL(state->files.size(), statistics.filesRead);
+    PORTABLE_VERIFY_ARE_EQUAL(state->files.size(), state->reads.load());
+    PORTABLE_VERIFY_ARE_EQUAL(2u, statistics.misses);
+    PORTABLE_VERIFY_ARE_EQUAL(4u, statistics.hits);
+    PORTABLE_VERIFY_ARE_EQUAL(state->files.size(), statistics.files);
+}
+
+PORTABLE_TEST(WinMDTypeIndex_RebuildsWhenDirectoryChanges)
+{
+    auto state{ MakeContosoDirectory() };
+    WinMDTypeIndex index(std::make_unique<MockDirectory>(state), std::chrono::hours(1));
+
+    VerifyKind(index, L"Contoso.Gizmos.Gizmo", WinMDTypeLocation::Kind::NotFound);
+
+    // A new file changes the directory's timestamp; only the new file is read
+    state->Add(L"Contoso.Gizmos.winmd", { { "Contoso.Gizmos", "Gizmo", c_publicRuntimeClass } });
+    VerifyType(index, L"Contoso.Gizmos.Gizmo", L"Contoso.Gizmos.winmd", 0x02000002);
+    auto statistics{ index.GetStatistics() };
+    PORTABLE_VERIFY_ARE_EQUAL(2u, statistics.builds);
+    PORTABLE_VERIFY_ARE_EQUAL(state->files.size(), statistics.filesRead);
+
+    state->Remove(L"Contoso.Gizmos.winmd");
+    VerifyKind(index, L"Contoso.Gizmos.Gizmo", WinMDTypeLocation::Kind::NotFound);
+    PORTABLE_VERIFY_ARE_EQUAL(3u, index.GetStatistics().builds);
+}
+
+PORTABLE_TEST(WinMDTypeIndex_RevalidatesFiles)
+{
+    auto state{ MakeContosoDirectory() };
+
+    // A file rewritten in place is only noticed when the files are revalidated...
+    {
+        WinMDTypeIndex index(std::make_unique<MockDirectory>(state), std::chrono::hours(1));
+        VerifyKind(index, L"Contoso.Widgets.Slider", WinMDTypeLocation::Kind::NotFound);
+        state->Rewrite(L"Contoso.Widgets.winmd", { { "Contoso.Widgets", "Slider", c_publicRuntimeClass } });
+        VerifyKind(index, L"Contoso.Widgets.Slider", WinMDTypeLocation::Kind::NotFound);
+
+        index.Invalidate();
+        VerifyType(index, L"Contoso.Widgets.Slider", L"Contoso.Widgets.winmd", 0x02000002);
+    }
+
+    // ...which happens at most once per interval
+    {
+        WinMDTypeIndex index(std::make_unique<MockDirectory>(state), std::chrono::milliseconds(0));
+        const auto reads{ state->reads.load() };
+        VerifyType(index, L"Contoso.Widgets.Slider", L"Contoso.Widgets.winmd", 0x02000002);
+        state->Rewrite(L"Contoso.Widgets.winmd", { { "Contoso.Widgets", "Knob", c_publicRuntimeClass } });
+        VerifyKind(index, L"Contoso.Widgets.Slider", WinMDTypeLocation::Kind::NotFound);
+        VerifyType(index, L"Contoso.Widgets.Knob", L"Contoso.Widgets.winmd", 0x02000002);
+        PORTABLE_VERIFY_ARE_EQUAL(2u, index.GetStatistics().builds);
+        PORTABLE_VERIFY_ARE_EQUAL(reads + state->files.size() + 1, state->reads.load());
+    }
+}
+
+PORTABLE_TEST(WinMDTypeIndex_Concurrent)
+{
+    auto state{ MakeContosoDirectory() };
+    WinMDTypeIndex index(std::make_unique<MockDirectory>(state), std::chrono::milliseconds(0));
+
+    const size_t c_threads{ 8 };
+    const size_t c_iterations{ 2000 };
+    std::atomic<size_t> failures{};
+    std::vector<std::thread> threads;
+    for (size_t thread=0; thread < c_threads; ++thread)
+    {
+        threads.emplace_back([&, thread]() {
+            for (size_t iteration=0; iteration < c_iterations; ++iteration)
+            {
+                const auto widget{ index.Find(L"Contoso.Widgets.Widget") };
+                const auto missing{ index.Find(L"Contoso.Missing" + std::to_wstring((thread + iteration) % 64)) };
+                if ((widget.kind != WinMDTypeLocation::Kind::Type) || (widget.fileName != L"Contoso.Widgets.winmd") ||
+                    (missing.kind != WinMDTypeLocation::Kind::NotFound))
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+
+    // Churn the directory while they look things up
+    for (size_t iteration=0; iteration < 50; ++iteration)
+    {
+        state->Add(L"Contoso.Gizmos.winmd", { { "Contoso.Gizmos", "Gizmo", c_publicRuntimeClass } });
+        state->Remove(L"Contoso.Gizmos.winmd");
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    PORTABLE_VERIFY_ARE_EQUAL(0u, failures.load());
+}
+
+PORTABLE_BENCHMARK(WinMDTypeIndex_Benchmark)
+{
+    const size_t c_iterations{ 20000 };
+    const size_t c_typesPerFile{ 256 };
+
+    for (size_t fileCount : { 4, 32 })
+    {
+        auto state{ std::make_shared<MockDirectory::State>() };
+        std::vector<std::wstring> typeNames;
+        for (size_t file=0; file < fileCount; ++file)
+        {
+            const std::string namespaceName{ "Contoso.Component" + std::to_string(file) };
+            std::vector<Test::WinMD::TypeDefinition> types;
+            for (size_t type=0; type < c_typesPerFile; ++type)
+            {
+                types.push_back({ namespaceName, "Type" + std::to_string(type), c_publicRuntimeClass });
+                typeNames.push_back(std::wstring(namespaceName.begin(), namespaceName.end()) + L".Type" + std::to_wstring(type));
+            }
+            state->Add(std::wstring(namespaceName.begin(), namespaceName.end()) + L".winmd", types);
+        }
+
+        // What FindTypeInDirectory() did per lookup, given importers already cached: a name lookup
+        // in each Name.winmd, Namespace.winmd, ... that exists, then (if that failed) a scan of every
+        // type in every Name*.winmd to see if it's a namespace. The lookups themselves are cheap; the
+        // cost was in the file system, as every candidate that doesn't exist was opened (failures
+        // weren't cached) and the Name*.winmd search enumerated the directory, so count those
+        uint64_t fileSystemCalls{};
+        std::unordered_map<std::wstring, std::vector<WinMD::TypeDef>> importers;
+        std::unordered_map<std::wstring, std::unordered_map<std::wstring, uint32_t>> typesByName;
+        for (const auto& [name, file] : state->files)
+        {
+            auto& typeDefs{ importers[name.substr(0, name.size() - 6)] };
+            WinMD::ReadTypeDefs(file.second.data(), file.second.size(), typeDefs);
+            for (const auto& typeDef : typeDefs)
+            {
+                typesByName[name.substr(0, name.size() - 6)].emplace(typeDef.name, typeDef.flags);
+            }
+        }
+        auto probe = [&](const std::wstring& name) -> bool
+        {
+            for (auto length{ name.size() }; length != std::wstring::npos; length = name.rfind(L'.', length - 1))
+            {
+                auto file{ typesByName.find(name.substr(0, length)) };
+                if (file == typesByName.end())
+                {
+                    ++fileSystemCalls;
+                }
+                if ((file != typesByName.end()) && (file->second.count(name) != 0))
+                {
+                    return true;
+                }
+            }
+            ++fileSystemCalls;
+            for (const auto& [stem, typeDefs] : importers)
+            {
+                if (stem.compare(0, name.size(), name) == 0)
+                {
+                    for (const auto& typeDef : typeDefs)
+                    {
+                        if (typeDef.name.compare(0, name.size(), name) == 0)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        };
+
+        auto samples{ Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+            probe(typeNames[iteration % typeNames.size()]);
+        }) };
+        std::printf("%s\n", Test::Perf::ToJson("winmdtypeindex.probing.hit", fileCount, 1, samples).c_str());
+        samples = Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+            probe(L"Contoso.Component" + std::to_wstring(iteration % fileCount) + L".Missing");
+        });
+        std::printf("%s\n", Test::Perf::ToJson("winmdtypeindex.probing.miss", fileCount, 1, samples).c_str());
+        std::fprintf(stderr, "  probing: %.1f file system calls per lookup (the index makes 1)\n",
+                     static_cast<double>(fileSystemCalls) / static_cast<double>(2 * c_iterations));
+
+        std::unique_ptr<WinMDTypeIndex> index;
+        samples = Test::Perf::Measure(10, [&](size_t) {
+            index = std::make_unique<WinMDTypeIndex>(std::make_unique<MockDirectory>(state));
+            index->Find(typeNames.front());
+        });
+        std::printf("%s\n", Test::Perf::ToJson("winmdtypeindex.build", fileCount, 1, samples).c_str());
+
+        samples = Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+            index->Find(typeNames[iteration % typeNames.size()]);
+        });
+        std::printf("%s\n", Test::Perf::ToJson("winmdtypeindex.hit", fileCount, 1, samples).c_str());
+        samples = Test::Perf::Measure(c_iterations, [&](size_t iteration) {
+            index->Find(L"Contoso.Component" + std::to_wstring(iteration % fileCount) + L".Missing");
+        });
+        std::printf("%s\n", Test::Perf::ToJson("winmdtypeindex.miss", fileCount, 1, samples).c_str());
+
+        const auto statistics{ index->GetStatistics() };
+        std::fprintf(stderr, "  files=%zu types=%zu builds=%llu hits=%llu misses=%llu\n",
+                     statistics.files, statistics.types, static_cast<unsigned long long>(statistics.builds),
+                     static_cast<unsigned long long>(statistics.hits), static_cast<unsigned long long>(statistics.misses));
+    }
+}
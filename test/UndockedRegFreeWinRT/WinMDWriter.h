@@ -0,0 +1,172 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(WINMDWRITER_H)
+#define WINMDWRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes just enough of a .winmd file (a PE image holding ECMA-335 metadata with Module and
+// TypeDef tables) to exercise WinMD::ReadTypeDefs() without checking in binaries.
+
+namespace Test::WinMD
+{
+    struct TypeDefinition
+    {
+        std::string namespaceName;
+        std::string name;
+        uint32_t flags;
+    };
+
+    namespace Details
+    {
+        inline void Write(std::vector<uint8_t>& bytes, size_t offset, uint64_t value, size_t length)
+        {
+            if (bytes.size() < offset + length)
+            {
+                bytes.resize(offset + length);
+            }
+            for (size_t index=0; index < length; ++index)
+            {
+                bytes[offset + index] = static_cast<uint8_t>(value >> (8 * index));
+            }
+        }
+
+        inline void Append(std::vector<uint8_t>& bytes, uint64_t value, size_t length)
+        {
+            Write(bytes, bytes.size(), value, length);
+        }
+
+        inline void Align(std::vector<uint8_t>& bytes, size_t alignment)
+        {
+            bytes.resize((bytes.size() + alignment - 1) / alignment * alignment);
+        }
+    }
+
+    /// A .winmd image defining the types, in order (the first gets token 0x02000002; 0x02000001 is <Module>).
+    inline std::vector<uint8_t> WriteWinMD(const std::vector<TypeDefinition>& types)
+    {
+        using Details::Append;
+        using Details::Align;
+        using Details::Write;
+
+        // #Strings
+        std::vector<uint8_t> strings{ 0 };
+        auto addString = [&](const std::string& string) -> uint32_t
+        {
+            if (string.empty())
+            {
+                return 0;
+            }
+            const auto index{ static_cast<uint32_t>(strings.size()) };
+            strings.insert(strings.end(), string.begin(), string.end());
+            strings.push_back(0);
+            return index;
+        };
+        const uint32_t moduleName{ addString("Test.winmd") };
+        std::vector<uint32_t> names;
+        for (const auto& type : types)
+        {
+            names.push_back(addString(type.name));
+            names.push_back(addString(type.namespaceName));
+        }
+        const uint32_t moduleTypeName{ addString("<Module>") };
+        Align(strings, 4);
+        const size_t stringIndex{ (strings.size() >= 0x10000) ? 4u : 2u };
+
+        // #~ with Module and TypeDef tables
+        std::vector<uint8_t> tables;
+        Append(tables, 0, 4);                                   // Reserved
+        Append(tables, 2, 1);                                   // MajorVersion
+        Append(tables, 0, 1);                                   // MinorVersion
+        Append(tables, (stringIndex == 4) ? 0x01 : 0x00, 1);    // HeapSizes
+        Append(tables, 1, 1);                                   // Reserved
+        Append(tables, (1ull << 0x00) | (1ull << 0x02), 8);     // Valid
+        Append(tables, 0, 8);                                   // Sorted
+        Append(tables, 1, 4);                                   // Module rows
+        Append(tables, types.size() + 1, 4);                    // TypeDef rows
+
+        Append(tables, 0, 2);                                   // Module: Generation
+        Append(tables, moduleName, stringIndex);                //         Name
+        Append(tables, 0, 2 * 3);                               //         Mvid, EncId, EncBaseId
+
+        auto appendTypeDef = [&](uint32_t flags, uint32_t name, uint32_t namespaceName)
+        {
+            Append(tables, flags, 4);
+            Append(tables, name, stringIndex);
+            Append(tables, namespaceName, stringIndex);
+            Append(tables, 0, 2);                               // Extends
+            Append(tables, 1, 2);                               // FieldList
+            Append(tables, 1, 2);                               // MethodList
+        };
+        appendTypeDef(0, moduleTypeName, 0);
+        for (size_t index=0; index < types.size(); ++index)
+        {
+            appendTypeDef(types[index].flags, names[2 * index], names[2 * index + 1]);
+        }
+        Align(tables, 4);
+
+        // Metadata root, stream headers and streams
+        const std::string version{ "WindowsRuntime 1.4" };
+        std::vector<uint8_t> metadata;
+        Append(metadata, 0x424A5342, 4);                        // "BSJB"
+        Append(metadata, 1, 2);
+        Append(metadata, 1, 2);
+        Append(metadata, 0, 4);
+        Append(metadata, (version.size() + 4) & ~size_t{ 3 }, 4);
+        metadata.insert(metadata.end(), version.begin(), version.end());
+        Append(metadata, 0, 1);
+        Align(metadata, 4);
+        Append(metadata, 0, 2);                                 // Flags
+        Append(metadata, 2, 2);                                 // Streams
+        const size_t streamsOffset{ metadata.size() + (8 + 4) + (8 + 12) };
+        Append(metadata, streamsOffset, 4);
+        Append(metadata, tables.size(), 4);
+        metadata.insert(metadata.end(), { '#', '~', 0, 0 });
+        Append(metadata, streamsOffset + tables.size(), 4);
+        Append(metadata, strings.size(), 4);
+        metadata.insert(metadata.end(), { '#', 'S', 't', 'r', 'i', 'n', 'g', 's', 0, 0, 0, 0 });
+        metadata.insert(metadata.end(), tables.begin(), tables.end());
+        metadata.insert(metadata.end(), strings.begin(), strings.end());
+
+        // PE32 image with one section holding the CLI header followed by the metadata
+        const uint32_t c_sectionRva{ 0x2000 };
+        const uint32_t c_sectionOffset{ 0x200 };
+        const uint32_t c_cliHeaderSize{ 72 };
+        std::vector<uint8_t> image;
+        Write(image, 0, 0x5A4D, 2);                             // "MZ"
+        Write(image, 0x3C, 0x40, 4);                            // e_lfanew
+        Write(image, 0x40, 0x00004550, 4);                      // "PE\0\0"
+        Write(image, 0x44, 0x014C, 2);                          // Machine
+        Write(image, 0x46, 1, 2);                               // NumberOfSections
+        Write(image, 0x54, 0xE0, 2);                            // SizeOfOptionalHeader
+        Write(image, 0x56, 0x2102, 2);                          // Characteristics
+        Write(image, 0x58, 0x10B, 2);                           // Magic (PE32)
+        Write(image, 0x58 + 92, 16, 4);                         // NumberOfRvaAndSizes
+        Write(image, 0x58 + 96 + 14 * 8, c_sectionRva, 4);      // CLI header directory
+        Write(image, 0x58 + 96 + 14 * 8 + 4, c_cliHeaderSize, 4);
+
+        const size_t sectionSize{ c_cliHeaderSize + metadata.size() };
+        const size_t sectionHeader{ 0x58 + 0xE0 };
+        Write(image, sectionHeader, 0x747865742E, 8);           // ".text"
+        Write(image, sectionHeader + 8, sectionSize, 4);        // VirtualSize
+        Write(image, sectionHeader + 12, c_sectionRva, 4);      // VirtualAddress
+        Write(image, sectionHeader + 16, (sectionSize + 0x1FF) & ~size_t{ 0x1FF }, 4);
+        Write(image, sectionHeader + 20, c_sectionOffset, 4);   // PointerToRawData
+
+        Write(image, c_sectionOffset, c_cliHeaderSize, 4);      // cb
+        Write(image, c_sectionOffset + 4, 2, 2);                // MajorRuntimeVersion
+        Write(image, c_sectionOffset + 6, 5, 2);                // MinorRuntimeVersion
+        Write(image, c_sectionOffset + 8, c_sectionRva + c_cliHeaderSize, 4);
+        Write(image, c_sectionOffset + 12, metadata.size(), 4);
+        Write(image, c_sectionOffset + 16, 1, 4);               // Flags (IL only)
+        image.resize(c_sectionOffset + c_cliHeaderSize);
+        image.insert(image.end(), metadata.begin(), metadata.end());
+        Align(image, 0x200);
+        return image;
+    }
+}
+
+#endif // WINMDWRITER_H
@@ -0,0 +1,62 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(PORTABLETEST_H)
+#define PORTABLETEST_H
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal test registry for std-only code (e.g. in UndockedRegFreeWinRT, AppLifecycle and MRTCore).
+// These don't need Windows (or TAEF) so they build and run anywhere with a C++17 compiler.
+// PortableTestMain.cpp runs them; projects get both by importing PortableTests.props.
+
+namespace Test::Portable
+{
+    struct TestCase
+    {
+        const char* name;
+        std::function<void()> test;
+        bool isBenchmark;
+    };
+
+    inline std::vector<TestCase>& TestCases()
+    {
+        static std::vector<TestCase> testCases;
+        return testCases;
+    }
+
+    struct Register
+    {
+        Register(const char* name, std::function<void()> test, bool isBenchmark = false)
+        {
+            TestCases().push_back(TestCase{ name, std::move(test), isBenchmark });
+        }
+    };
+
+    inline void Verify(bool condition, const char* expression, const char* file, int line)
+    {
+        if (!condition)
+        {
+            throw std::runtime_error(std::string(file) + "(" + std::to_string(line) + "): VERIFY(" + expression + ")");
+        }
+    }
+}
+
+#define PORTABLE_TEST(name) \
+    static void name(); \
+    static ::Test::Portable::Register s_register_##name{ #name, name }; \
+    static void name()
+
+#define PORTABLE_BENCHMARK(name) \
+    static void name(); \
+    static ::Test::Portable::Register s_register_##name{ #name, name, true }; \
+    static void name()
+
+#define PORTABLE_VERIFY(condition) ::Test::Portable::Verify(!!(condition), #condition, __FILE__, __LINE__)
+
+#define PORTABLE_VERIFY_ARE_EQUAL(expected, actual) ::Test::Portable::Verify((expected) == (actual), #expected " == " #actual, __FILE__, __LINE__)
+
+#endif // PORTABLETEST_H
@@ -0,0 +1,66 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runner for the portable tests (and benchmarks) registered with PortableTest.h. Every
+// portable test project compiles this file along with its tests (see PortableTests.props).
+//
+// Usage: <project> [--benchmark] [--filter=<substring>]
+//
+// Tests run by default. --benchmark runs the benchmarks instead; they print JSON Lines
+// (see Test::Perf::ToJson()).
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "PortableTest.h"
+
+int main(int argc, char* argv[])
+{
+    bool benchmarks{};
+    std::string filter;
+    for (int index=1; index < argc; ++index)
+    {
+        if (std::strcmp(argv[index], "--benchmark") == 0)
+        {
+            benchmarks = true;
+        }
+        else if (std::strncmp(argv[index], "--filter=", 9) == 0)
+        {
+            filter = argv[index] + 9;
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--benchmark] [--filter=<substring>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int passed{};
+    int failed{};
+    for (const auto& testCase : Test::Portable::TestCases())
+    {
+        if ((testCase.isBenchmark != benchmarks) || (std::string(testCase.name).find(filter) == std::string::npos))
+        {
+            continue;
+        }
+
+        try
+        {
+            testCase.test();
+            ++passed;
+            if (!benchmarks)
+            {
+                std::fprintf(stderr, "PASS %s\n", testCase.name);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            ++failed;
+            std::fprintf(stderr, "FAIL %s: %s\n", testCase.name, e.what());
+        }
+    }
+    std::fprintf(stderr, "%d passed, %d failed\n", passed, failed);
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+﻿// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#if !defined(SHAREDREGION_H)
+#define SHAREDREGION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include "ProcessLiveness.h" // dev\AppLifecycle
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Shared memory and multi-process helpers for the portable tests of data structures that live
+// in memory shared between processes (AppLifecycle's shared tables, MRM's shared resolution cache).
+//
+// On POSIX the region is a POSIX shm object and "processes" are real (forked) processes,
+// so tests exercise the same cross-process behavior as named file mappings on Windows.
+// On Windows they're threads sharing an unnamed file mapping.
+namespace Test::Shared
+{
+    /// A zero-filled region of shared memory, unmapped on destruction.
+    class SharedRegion
+    {
+    public:
+        /// An unnamed region, shared with the processes started by RunProcesses()
+        explicit SharedRegion(size_t size) :
+            SharedRegion(std::string{}, size)
+        {
+        }
+
+        /// A named region, created by the first to open it (and removed when it closes it), as the
+        /// per-request mappings of redirection requests are
+        SharedRegion(const std::string& name, size_t size) :
+            m_size(size)
+        {
+#if defined(_WIN32)
+            const std::wstring mappingName(name.begin(), name.end());
+            m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                           static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size),
+                                           mappingName.empty() ? nullptr : mappingName.c_str());
+            if (!m_mapping)
+            {
+                throw std::runtime_error("CreateFileMapping failed");
+            }
+            m_region = MapViewOfFile(m_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+            if (!m_region)
+            {
+                CloseHandle(m_mapping);
+                throw std::runtime_error("MapViewOfFile failed");
+            }
+#else
+            static std::atomic<unsigned> s_count{};
+            const std::string shmName{ "/portable-test-" + (name.empty() ? std::to_string(getpid()) + "-" + std::to_string(s_count++) : name) };
+            int fd{ shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600) };
+            const bool created{ fd >= 0 };
+            if (!created && !name.empty())
+            {
+                fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+            }
+            if (fd < 0)
+            {
+                throw std::runtime_error("shm_open failed");
+            }
+
+            if (name.empty())
+            {
+                // Children inherit the mapping so the name's no longer needed
+                shm_unlink(shmName.c_str());
+            }
+            else if (created)
+            {
+                m_name = shmName;
+            }
+            if (created && (ftruncate(fd, static_cast<off_t>(size)) != 0))
+            {
+                close(fd);
+                throw std::runtime_error("ftruncate failed");
+            }
+            m_region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (m_region == MAP_FAILED)
+            {
+                throw std::runtime_error("mmap failed");
+            }
+#endif
+        }
+
+        ~SharedRegion()
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(m_region);
+            CloseHandle(m_mapping);
+#else
+            munmap(m_region, m_size);
+            if (!m_name.empty())
+            {
+                shm_unlink(m_name.c_str());
+            }
+#endif
+        }
+
+        SharedRegion(const SharedRegion&) = delete;
+        SharedRegion& operator=(const SharedRegion&) = delete;
+
+        void* Get() const
+        {
+            return m_region;
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+    private:
+        void* m_region{};
+        size_t m_size{};
+#if defined(_WIN32)
+        HANDLE m_mapping{};
+#else
+        std::string m_name;
+#endif
+    };
+
+    /// True if each worker of RunProcesses() is its own process.
+    constexpr bool c_workersAreProcesses
+    {
+#if defined(_WIN32)
+        false
+#else
+        true
+#endif
+    };
+
+    inline uint32_t CurrentProcessId()
+    {
+#if defined(_WIN32)
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    inline bool IsProcessAlive(uint32_t processId)
+    {
+#if defined(_WIN32)
+        return AppLifecycleCore::IsProcessAlive(processId);
+#else
+        return (kill(static_cast<pid_t>(processId), 0) == 0) || (errno == EPERM);
+#endif
+    }
+
+    /// Run worker(index) for index in [0, count) concurrently, each in its own process where
+    /// possible, and wait for all of them. concurrently() runs in the caller meanwhile.
+    /// Returns how many workers failed (returned non-zero, threw or crashed).
+    inline int RunProcesses(int count, const std::function<int(int index)>& worker, const std::function<void()>& concurrently = {})
+    {
+        int failed{};
+#if defined(_WIN32)
+        std::atomic<int> failures{};
+        std::vector<std::thread> threads;
+        for (int index=0; index < count; ++index)
+        {
+            threads.emplace_back([&, index]() {
+                try
+                {
+                    if (worker(index) != 0)
+                    {
+                        ++failures;
+                    }
+                }
+                catch (...)
+                {
+                    ++failures;
+                }
+            });
+        }
+        if (concurrently)
+        {
+            concurrently();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        failed = failures;
+#else
+        std::vector<pid_t> children;
+        for (int index=0; index < count; ++index)
+        {
+            const pid_t child{ fork() };
+            if (child < 0)
+            {
+                throw std::runtime_error("fork failed");
+            }
+            if (child == 0)
+            {
+                int exitCode{ 1 };
+                try
+                {
+                    exitCode = worker(index);
+                }
+                catch (...)
+                {
+                }
+                _exit(exitCode);
+            }
+            children.push_back(child);
+        }
+        if (concurrently)
+        {
+            concurrently();
+        }
+        for (const auto child : children)
+        {
+            int status{};
+            if ((waitpid(child, &status, 0) != child) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+            {
+                ++failed;
+            }
+        }
+#endif
+        return failed;
+    }
+}
+
+#endif // SHAREDREGION_H